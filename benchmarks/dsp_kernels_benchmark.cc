@@ -0,0 +1,206 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the core DSP kernels of ViSQOL, at the sizes that the
+// audio and speech modes run them at.
+//
+// Run with:
+//   bazel run :dsp_kernels_benchmark -c opt
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <valarray>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "benchmark/benchmark.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "convolution_2d.h"
+#include "envelope.h"
+#include "equivalent_rectangular_bandwidth.h"
+#include "fast_fourier_transform.h"
+#include "fft_manager.h"
+#include "gammatone_filterbank.h"
+#include "neurogram_similiarity_index_measure.h"
+#include "patch_view.h"
+#include "signal_filter.h"
+#include "xcorr.h"
+
+namespace Visqol {
+namespace {
+
+// The sample rates of the audio and speech modes.
+const size_t kAudioSampleRate = 48000;
+const size_t kSpeechSampleRate = 16000;
+
+// The number of bands and the patch size of the audio and speech modes.
+const size_t kAudioNumBands = 32;
+const size_t kAudioPatchSize = 30;
+const size_t kSpeechNumBands = 21;
+const size_t kSpeechPatchSize = 20;
+
+const double kMinFreq = 50.0;
+const double kOverlap = 0.25;
+
+// The number of samples of an analysis window at a sample rate.
+size_t WindowSize(const size_t sample_rate) {
+  return AnalysisWindow(sample_rate, kOverlap).size;
+}
+
+std::vector<double> RandomSignal(const size_t num_samples) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> signal(num_samples);
+  for (auto &sample : signal) {
+    sample = dist(gen);
+  }
+  return signal;
+}
+
+AMatrix<double> RandomMatrix(const size_t rows, const size_t cols) {
+  return AMatrix<double>(rows, cols, RandomSignal(rows * cols));
+}
+
+// Filter one analysis window with the gammatone filter bank.
+// Args: the number of bands, the sample rate.
+void BM_GammatoneApplyFilter(benchmark::State &state) {
+  const size_t num_bands = state.range(0);
+  const size_t sample_rate = state.range(1);
+  GammatoneFilterBank filter_bank(num_bands, kMinFreq);
+  const auto erb = EquivalentRectangularBandwidth::MakeFilters(
+      sample_rate, num_bands, kMinFreq, sample_rate / 2);
+  filter_bank.SetFilterCoefficients(
+      AMatrix<double>(erb.filterCoeffs).FlipUpDown());
+  const std::vector<double> window = RandomSignal(WindowSize(sample_rate));
+  const std::valarray<double> signal(window.data(), window.size());
+  for (auto _ : state) {
+    filter_bank.ResetFilterConditions();
+    benchmark::DoNotOptimize(filter_bank.ApplyFilter(signal));
+  }
+  state.SetItemsProcessed(state.iterations() * signal.size() * num_bands);
+}
+BENCHMARK(BM_GammatoneApplyFilter)
+    ->Args({kSpeechNumBands, kSpeechSampleRate})
+    ->Args({kAudioNumBands, kAudioSampleRate});
+
+// Filter one analysis window with a single biquad stage.
+// Args: the sample rate.
+void BM_SignalFilter(benchmark::State &state) {
+  const size_t sample_rate = state.range(0);
+  const std::valarray<double> numer_coeffs{0.02, 0.04, 0.02};
+  const std::valarray<double> denom_coeffs{1.0, -1.56, 0.64};
+  const std::valarray<double> init_conditions{0.0, 0.0};
+  const std::vector<double> window = RandomSignal(WindowSize(sample_rate));
+  const std::valarray<double> signal(window.data(), window.size());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SignalFilter::Filter(numer_coeffs, denom_coeffs,
+                                                  signal, init_conditions));
+  }
+  state.SetItemsProcessed(state.iterations() * signal.size());
+}
+BENCHMARK(BM_SignalFilter)->Arg(kSpeechSampleRate)->Arg(kAudioSampleRate);
+
+// Smooth a patch with the 3x3 window of the NSIM.
+// Args: the number of bands, the patch size.
+void BM_Valid2DConvWithBoundary(benchmark::State &state) {
+  const AMatrix<double> filter(3, 3, std::vector<double>{
+      0.0113, 0.0838, 0.0113, 0.0838, 0.6193, 0.0838, 0.0113, 0.0838,
+      0.0113});
+  const AMatrix<double> patch = RandomMatrix(state.range(0), state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        Convolution2D<double>::Valid2DConvWithBoundary(filter, patch));
+  }
+  state.SetItemsProcessed(state.iterations() * patch.NumElements());
+}
+BENCHMARK(BM_Valid2DConvWithBoundary)
+    ->Args({kSpeechNumBands, kSpeechPatchSize})
+    ->Args({kAudioNumBands, kAudioPatchSize});
+
+// Measure the similarity of a pair of patches, with the loops specialized for
+// the shape of the mode.
+// Args: the number of bands, the patch size.
+void BM_MeasurePatchSimilarity(benchmark::State &state) {
+  const size_t num_bands = state.range(0);
+  const size_t patch_size = state.range(1);
+  const NeurogramSimiliarityIndexMeasure nsim(
+      false, NsimPatchShapeOf(num_bands, patch_size));
+  const AMatrix<double> ref_patch = RandomMatrix(num_bands, patch_size);
+  const AMatrix<double> deg_patch = RandomMatrix(num_bands, patch_size);
+  const PatchView ref_view(ref_patch);
+  const PatchView deg_view(deg_patch);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(nsim.MeasurePatchSimilarity(ref_view, deg_view));
+  }
+  state.SetItemsProcessed(state.iterations() * ref_patch.NumElements());
+}
+BENCHMARK(BM_MeasurePatchSimilarity)
+    ->Args({kSpeechNumBands, kSpeechPatchSize})
+    ->Args({kAudioNumBands, kAudioPatchSize});
+
+// Find the lag between two signals by cross correlation.
+// Args: the number of samples of each signal.
+void BM_CalcBestLag(benchmark::State &state) {
+  const std::vector<double> samples = RandomSignal(state.range(0) + 100);
+  const AMatrix<double> signal_1(std::vector<double>(samples.begin() + 100,
+                                                     samples.end()));
+  const AMatrix<double> signal_2(std::vector<double>(samples.begin(),
+                                                     samples.end() - 100));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(XCorr::CalcBestLag(signal_1, signal_2));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalcBestLag)
+    ->Arg(kSpeechSampleRate)
+    ->Arg(kAudioSampleRate)
+    ->Arg(10 * kAudioSampleRate)
+    ->Unit(benchmark::kMillisecond);
+
+// Calculate the upper envelope of a signal.
+// Args: the number of samples.
+void BM_CalcUpperEnv(benchmark::State &state) {
+  const AMatrix<double> signal(RandomSignal(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Envelope::CalcUpperEnv(signal));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalcUpperEnv)
+    ->Arg(kSpeechSampleRate)
+    ->Arg(kAudioSampleRate)
+    ->Arg(10 * kAudioSampleRate)
+    ->Unit(benchmark::kMillisecond);
+
+// Transform one analysis window to the frequency domain.
+// Args: the sample rate.
+void BM_Forward1d(benchmark::State &state) {
+  const AMatrix<double> window(RandomSignal(WindowSize(state.range(0))));
+  const std::unique_ptr<FftManager> fft_manager =
+      absl::make_unique<FftManager>(window.NumRows());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        FastFourierTransform::Forward1d(fft_manager, window));
+  }
+  state.SetItemsProcessed(state.iterations() * window.NumRows());
+}
+BENCHMARK(BM_Forward1d)->Arg(kSpeechSampleRate)->Arg(kAudioSampleRate);
+}  // namespace
+}  // namespace Visqol
+
+BENCHMARK_MAIN();
@@ -0,0 +1,295 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// A harness that measures what each of the fast options of ViSQOL costs in
+// accuracy, and what it gains in speed. The conformance pairs are compared
+// with the exact options and then with each fast option on its own, and the
+// MOS-LQO and the FVNSIM of each band are compared with the exact results.
+//
+// Run with:
+//   bazel run :fast_mode_validation -c opt -- --output_csv=$PWD/modes.csv
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_split.h"
+
+#include "batch_runner.h"
+#include "commandline_parser.h"
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+
+ABSL_FLAG(std::string, modes, "",
+"A comma separated list of the fast modes to validate. All of them are\n"
+"validated if this is empty.");
+ABSL_FLAG(bool, use_speech_mode, false,
+"Validate the modes in speech mode, with the pairs resampled to 16k, rather\n"
+"than in audio mode.");
+ABSL_FLAG(int, repetitions, 3,
+"The number of times that the pairs are compared in each mode. The fastest\n"
+"run is used for the speedup.");
+ABSL_FLAG(std::string, output_csv, "",
+"A path to write the deltas of each mode to as CSV, including the maximum\n"
+"and mean FVNSIM delta of each band.");
+
+namespace Visqol {
+namespace {
+
+const char kConformanceDir[] = "/testdata/conformance_testdata_subset/";
+
+// The reference and degraded files of the conformance pairs.
+const std::vector<std::pair<std::string, std::string>> kConformancePairs = {
+    {"castanets48_stereo.wav", "castanets48_stereo.wav"},
+    {"contrabassoon48_stereo.wav", "contrabassoon48_stereo_24kbps_aac.wav"},
+    {"glock48_stereo.wav", "glock48_stereo_48kbps_aac.wav"},
+    {"guitar48_stereo.wav", "guitar48_stereo_64kbps_aac.wav"},
+    {"harpsichord48_stereo.wav", "harpsichord48_stereo_96kbps_mp3.wav"},
+    {"moonlight48_stereo.wav", "moonlight48_stereo_128kbps_aac.wav"},
+    {"ravel48_stereo.wav", "ravel48_stereo_128kbps_opus.wav"},
+    {"sopr48_stereo.wav", "sopr48_stereo_256kbps_aac.wav"},
+    {"steely48_stereo.wav", "steely48_stereo_lp7.wav"},
+    {"strauss48_stereo.wav", "strauss48_stereo_lp35.wav"},
+};
+
+// A fast mode, as the change that it makes to the exact options.
+struct FastMode {
+  const char *name;
+  std::function<void(VisqolConfig::VisqolOptions *)> apply;
+};
+
+const std::vector<FastMode> &FastModes() {
+  using Options = VisqolConfig::VisqolOptions;
+  static const std::vector<FastMode> modes = {
+      {"streaming_gammatone", [](Options *options) {
+        options->set_spectrogram_mode(Options::STREAMING_GAMMATONE);
+      }},
+      {"multirate_gammatone", [](Options *options) {
+        options->set_spectrogram_mode(Options::MULTIRATE_GAMMATONE);
+      }},
+      {"erb_stft", [](Options *options) {
+        options->set_spectrogram_mode(Options::ERB_STFT);
+      }},
+      {"fixed_point_gammatone", [](Options *options) {
+        options->set_spectrogram_mode(Options::FIXED_POINT_GAMMATONE);
+      }},
+      {"coarse_to_fine", [](Options *options) {
+        options->set_patch_search(Options::COARSE_TO_FINE);
+      }},
+      {"float_patch_search", [](Options *options) {
+        options->set_use_float_patch_search(true);
+      }},
+      {"bounded_patch_realignment", [](Options *options) {
+        options->set_use_bounded_patch_realignment(true);
+      }},
+      {"realign_skip_similarity", [](Options *options) {
+        options->set_realign_skip_similarity(0.95);
+      }},
+      {"multi_resolution_alignment", [](Options *options) {
+        options->set_global_alignment(Options::MULTI_RESOLUTION);
+      }},
+      {"fingerprint_alignment", [](Options *options) {
+        options->set_global_alignment(Options::FINGERPRINT);
+      }},
+      {"max_patches", [](Options *options) {
+        options->set_max_patches(10);
+      }},
+      {"target_vnsim_stderr", [](Options *options) {
+        options->set_target_vnsim_stderr(0.01);
+      }},
+      {"silent_patch_threshold", [](Options *options) {
+        options->set_silent_patch_threshold(-60.0);
+      }},
+  };
+  return modes;
+}
+
+// The accuracy and speed of a mode, relative to the exact options.
+struct ModeReport {
+  std::string name;
+  double speedup = 0.0;
+  double max_mos_delta = 0.0;
+  double mean_mos_delta = 0.0;
+  std::vector<double> max_fvnsim_delta;
+  std::vector<double> mean_fvnsim_delta;
+};
+
+// Compare the pairs with some options, keeping the results of the fastest
+// of the repetitions. Fails unless every pair is compared.
+bool RunPairs(const FilePath &model,
+              const VisqolConfig::VisqolOptions &options,
+              const std::vector<ReferenceDegradedPathPair> &pairs,
+              int repetitions, std::vector<SimilarityResultMsg> *results,
+              double *seconds) {
+  *seconds = 0.0;
+  for (int r = 0; r < repetitions; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    auto results_or = BatchRunner::Run(model, options, pairs, 1);
+    const double run_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!results_or.ok() || results_or.ValueOrDie().size() != pairs.size()) {
+      return false;
+    }
+    if (r == 0 || run_seconds < *seconds) {
+      *seconds = run_seconds;
+      *results = std::move(results_or.ValueOrDie());
+    }
+  }
+  return true;
+}
+
+// Compare the results of a mode with the exact results.
+ModeReport CompareResults(const std::string &name,
+                          const std::vector<SimilarityResultMsg> &exact,
+                          const std::vector<SimilarityResultMsg> &results,
+                          double speedup) {
+  ModeReport report;
+  report.name = name;
+  report.speedup = speedup;
+  const size_t num_bands = exact.front().fvnsim_size();
+  report.max_fvnsim_delta.assign(num_bands, 0.0);
+  report.mean_fvnsim_delta.assign(num_bands, 0.0);
+  for (size_t i = 0; i < exact.size(); i++) {
+    const double mos_delta = std::abs(results[i].moslqo() - exact[i].moslqo());
+    report.max_mos_delta = std::max(report.max_mos_delta, mos_delta);
+    report.mean_mos_delta += mos_delta / exact.size();
+    for (size_t b = 0; b < num_bands; b++) {
+      const double fvnsim_delta =
+          std::abs(results[i].fvnsim(b) - exact[i].fvnsim(b));
+      report.max_fvnsim_delta[b] =
+          std::max(report.max_fvnsim_delta[b], fvnsim_delta);
+      report.mean_fvnsim_delta[b] += fvnsim_delta / exact.size();
+    }
+  }
+  return report;
+}
+
+void PrintReports(const std::vector<ModeReport> &reports) {
+  std::printf("%-28s %8s %10s %10s %12s\n", "Mode", "Speedup", "Max dMOS",
+              "Mean dMOS", "Max dFVNSIM");
+  for (const auto &report : reports) {
+    std::printf("%-28s %7.2fx %10.4f %10.4f %12.4f\n", report.name.c_str(),
+                report.speedup, report.max_mos_delta, report.mean_mos_delta,
+                *std::max_element(report.max_fvnsim_delta.begin(),
+                                  report.max_fvnsim_delta.end()));
+  }
+  std::printf("\nMax FVNSIM delta of each band:\n");
+  for (const auto &report : reports) {
+    std::printf("%-28s", report.name.c_str());
+    for (const double delta : report.max_fvnsim_delta) {
+      std::printf(" %.3f", delta);
+    }
+    std::printf("\n");
+  }
+}
+
+bool WriteCsv(const std::string &path, const std::vector<ModeReport> &reports) {
+  std::ofstream out(path);
+  const size_t num_bands = reports.front().max_fvnsim_delta.size();
+  out << "mode,speedup,max_mos_delta,mean_mos_delta";
+  for (size_t b = 0; b < num_bands; b++) {
+    out << ",max_fvnsim_delta_" << b;
+  }
+  for (size_t b = 0; b < num_bands; b++) {
+    out << ",mean_fvnsim_delta_" << b;
+  }
+  out << "\n";
+  for (const auto &report : reports) {
+    out << report.name << "," << report.speedup << ","
+        << report.max_mos_delta << "," << report.mean_mos_delta;
+    for (const double delta : report.max_fvnsim_delta) {
+      out << "," << delta;
+    }
+    for (const double delta : report.mean_fvnsim_delta) {
+      out << "," << delta;
+    }
+    out << "\n";
+  }
+  return static_cast<bool>(out);
+}
+
+int RunValidation() {
+  const bool speech_mode = absl::GetFlag(FLAGS_use_speech_mode);
+  const int repetitions = std::max(1, absl::GetFlag(FLAGS_repetitions));
+  const FilePath model(FilePath::currentWorkingDir() + (speech_mode ?
+      kDefaultSpeechModelFile : kDefaultAudioModelFile));
+  const std::string dir = FilePath::currentWorkingDir() + kConformanceDir;
+  std::vector<ReferenceDegradedPathPair> pairs;
+  for (const auto &pair : kConformancePairs) {
+    pairs.push_back({FilePath(dir + pair.first), FilePath(dir + pair.second)});
+  }
+
+  VisqolConfig::VisqolOptions exact_options;
+  exact_options.set_use_speech_scoring(speech_mode);
+  exact_options.set_resample_to_mode_rate(speech_mode);
+  std::vector<SimilarityResultMsg> exact;
+  double exact_seconds;
+  if (!RunPairs(model, exact_options, pairs, repetitions, &exact,
+                &exact_seconds)) {
+    ABSL_RAW_LOG(ERROR, "The pairs failed with the exact options.");
+    return 1;
+  }
+
+  const std::string modes_flag = absl::GetFlag(FLAGS_modes);
+  const std::vector<std::string> selected = absl::StrSplit(
+      modes_flag, ',', absl::SkipEmpty());
+  std::vector<ModeReport> reports;
+  bool all_ok = true;
+  for (const auto &mode : FastModes()) {
+    if (!selected.empty() && std::find(selected.begin(), selected.end(),
+                                       mode.name) == selected.end()) {
+      continue;
+    }
+    VisqolConfig::VisqolOptions options = exact_options;
+    mode.apply(&options);
+    std::vector<SimilarityResultMsg> results;
+    double seconds;
+    if (!RunPairs(model, options, pairs, repetitions, &results, &seconds)) {
+      ABSL_RAW_LOG(ERROR, "The pairs failed in the %s mode.", mode.name);
+      all_ok = false;
+      continue;
+    }
+    reports.push_back(CompareResults(mode.name, exact, results,
+                                     exact_seconds / seconds));
+  }
+  if (reports.empty()) {
+    ABSL_RAW_LOG(ERROR, "No mode was validated.");
+    return 1;
+  }
+
+  PrintReports(reports);
+  const std::string output_csv = absl::GetFlag(FLAGS_output_csv);
+  if (!output_csv.empty() && !WriteCsv(output_csv, reports)) {
+    ABSL_RAW_LOG(ERROR, "Could not write %s.", output_csv.c_str());
+    return 1;
+  }
+  return all_ok ? 0 : 1;
+}
+}  // namespace
+}  // namespace Visqol
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  return Visqol::RunValidation();
+}
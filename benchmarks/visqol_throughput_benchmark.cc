@@ -0,0 +1,501 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// An end-to-end throughput benchmark of ViSQOL. The conformance pairs and a
+// set of synthetic long pairs are compared in audio and speech mode on 1 to
+// --max_threads worker threads, and the pairs per second, real-time factor
+// and peak RSS of each run are written as JSON. A set of --num_clips short
+// clips cut from the conformance pairs is compared in memory through
+// VisqolApi::MeasureBatch, and its pairs per second are clips per second.
+// A run whose pairs per second fall more than --max_regression_percent below
+// the matching run of the baseline fails the benchmark. Runs without a match
+// in the baseline are reported, and fail the benchmark with
+// --require_baseline.
+//
+// Throughput depends on the machine, so the gating baseline is recorded on
+// the machine that gates the runs, with the same --max_threads:
+//   bazel run :visqol_throughput_benchmark -c opt -- --write_baseline \
+//       --baseline=$PWD/benchmarks/throughput_baseline.json
+// and later runs on that machine are gated with:
+//   bazel run :visqol_throughput_benchmark -c opt -- --require_baseline \
+//       --baseline=$PWD/benchmarks/throughput_baseline.json
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/types/span.h"
+#include "boost/filesystem.hpp"
+#include "google/protobuf/util/json_util.h"
+
+#include "batch_runner.h"
+#include "commandline_parser.h"
+#include "file_path.h"
+#include "misc_audio.h"
+#include "throughput_report.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_api.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "wav_reader.h"
+
+ABSL_FLAG(int, max_threads, 4,
+"Each set of pairs is compared on 1 to this many worker threads.");
+ABSL_FLAG(double, long_file_duration, 60.0,
+"The duration, in seconds, of the synthetic long files.");
+ABSL_FLAG(int, num_clips, 600,
+"The number of short clips, of 3 to 8 seconds, that are cut from the\n"
+"conformance pairs.");
+ABSL_FLAG(std::string, baseline, "",
+"The JSON baseline that the run is compared to. No comparison is made if it\n"
+"is empty.");
+ABSL_FLAG(double, max_regression_percent, 10.0,
+"A run whose pairs per second are more than this percentage below the\n"
+"baseline fails the benchmark.");
+ABSL_FLAG(std::string, output_json, "",
+"The path that the JSON report is written to. It is written to stdout if\n"
+"this is empty.");
+ABSL_FLAG(bool, write_baseline, false,
+"Write the report to the --baseline path instead of comparing to it.");
+ABSL_FLAG(bool, require_baseline, false,
+"Fail the benchmark if a run has no matching run in the --baseline, such as\n"
+"when the baseline was not recorded on this machine.");
+
+namespace Visqol {
+namespace {
+
+const char kConformanceDir[] = "/testdata/conformance_testdata_subset/";
+
+// The reference and degraded files of the conformance pairs.
+const std::vector<std::pair<std::string, std::string>> kConformancePairs = {
+    {"castanets48_stereo.wav", "castanets48_stereo.wav"},
+    {"contrabassoon48_stereo.wav", "contrabassoon48_stereo_24kbps_aac.wav"},
+    {"glock48_stereo.wav", "glock48_stereo_48kbps_aac.wav"},
+    {"guitar48_stereo.wav", "guitar48_stereo_64kbps_aac.wav"},
+    {"harpsichord48_stereo.wav", "harpsichord48_stereo_96kbps_mp3.wav"},
+    {"moonlight48_stereo.wav", "moonlight48_stereo_128kbps_aac.wav"},
+    {"ravel48_stereo.wav", "ravel48_stereo_128kbps_opus.wav"},
+    {"sopr48_stereo.wav", "sopr48_stereo_256kbps_aac.wav"},
+    {"steely48_stereo.wav", "steely48_stereo_lp7.wav"},
+    {"strauss48_stereo.wav", "strauss48_stereo_lp35.wav"},
+};
+
+// The conformance pairs that the long pairs are tiled from. Each long pair
+// has its own reference, so the pairs are spread over the workers.
+const std::vector<size_t> kLongPairSources = {3, 5, 6, 9};
+
+// Write a mono signal to a 16 bit PCM wav file.
+bool WriteMonoWav(const std::string &path, const AudioSignal &signal) {
+  std::ofstream out(path, std::ios::binary);
+  const auto write_u32 = [&out](uint32_t v) {
+    const char bytes[] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                          static_cast<char>(v >> 16),
+                          static_cast<char>(v >> 24)};
+    out.write(bytes, sizeof(bytes));
+  };
+  const auto write_u16 = [&out](uint16_t v) {
+    const char bytes[] = {static_cast<char>(v), static_cast<char>(v >> 8)};
+    out.write(bytes, sizeof(bytes));
+  };
+  const uint32_t num_samples = signal.data_matrix.NumRows();
+  const uint32_t data_size = num_samples * 2;
+  const uint32_t sample_rate = signal.sample_rate;
+  out.write("RIFF", 4);
+  write_u32(36 + data_size);
+  out.write("WAVEfmt ", 8);
+  write_u32(16);
+  write_u16(1);  // PCM.
+  write_u16(1);  // Mono.
+  write_u32(sample_rate);
+  write_u32(sample_rate * 2);
+  write_u16(2);
+  write_u16(16);
+  out.write("data", 4);
+  write_u32(data_size);
+  for (uint32_t i = 0; i < num_samples; i++) {
+    const double sample = std::round(signal.data_matrix(i) * 32768.0);
+    write_u16(static_cast<int16_t>(
+        std::min(32767.0, std::max(-32768.0, sample))));
+  }
+  return static_cast<bool>(out);
+}
+
+// Tile a signal until it lasts at least a duration.
+AudioSignal Tile(const AudioSignal &signal, double duration) {
+  const size_t num_samples = signal.data_matrix.NumRows();
+  const size_t num_tiled = std::max(num_samples,
+      static_cast<size_t>(std::ceil(duration * signal.sample_rate)));
+  AudioSignal tiled;
+  tiled.sample_rate = signal.sample_rate;
+  tiled.data_matrix = AMatrix<double>(num_tiled, 1);
+  for (size_t i = 0; i < num_tiled; i++) {
+    tiled.data_matrix(i) = signal.data_matrix(i % num_samples);
+  }
+  return tiled;
+}
+
+// The conformance pairs.
+std::vector<ReferenceDegradedPathPair> ConformancePairs() {
+  const std::string dir = FilePath::currentWorkingDir() + kConformanceDir;
+  std::vector<ReferenceDegradedPathPair> pairs;
+  for (const auto &pair : kConformancePairs) {
+    pairs.push_back({FilePath(dir + pair.first), FilePath(dir + pair.second)});
+  }
+  return pairs;
+}
+
+// Write the long pairs to a directory, tiling the reference and degraded
+// file of each source pair alike so that they stay aligned.
+bool WriteLongPairs(const std::vector<ReferenceDegradedPathPair> &conformance,
+                    const std::string &dir, double duration,
+                    std::vector<ReferenceDegradedPathPair> *pairs) {
+  for (const size_t source : kLongPairSources) {
+    const auto &pair = conformance[source];
+    const std::string stem = dir + "/long_" + std::to_string(source);
+    const ReferenceDegradedPathPair long_pair = {
+        FilePath(stem + "_ref.wav"), FilePath(stem + "_deg.wav")};
+    const AudioSignal ref = MiscAudio::LoadAsMono(pair.reference);
+    const AudioSignal deg = MiscAudio::LoadAsMono(pair.degraded);
+    if (ref.data_matrix.NumRows() == 0 || deg.data_matrix.NumRows() == 0 ||
+        !WriteMonoWav(long_pair.reference.Path(), Tile(ref, duration)) ||
+        !WriteMonoWav(long_pair.degraded.Path(), Tile(deg, duration))) {
+      ABSL_RAW_LOG(ERROR, "Could not write the long pair of %s.",
+                   pair.reference.Path().c_str());
+      return false;
+    }
+    pairs->push_back(long_pair);
+  }
+  return true;
+}
+
+// The mono samples of the conformance pairs that the short clips are cut
+// from, and the spans of each clip.
+struct ClipSet {
+  std::vector<std::vector<double>> references;
+  std::vector<std::vector<double>> degraded;
+  std::vector<VisqolApi::SignalPair> clips;
+  double duration = 0.0;
+};
+
+// Cut short clips from the conformance pairs. Clip i lasts 3 to 8 seconds,
+// and starts a quarter of a second later than the last clip of the same pair
+// and duration, so that each clip has a reference of its own.
+bool MakeClips(const std::vector<ReferenceDegradedPathPair> &conformance,
+               size_t num_clips, ClipSet *clip_set) {
+  for (const auto &pair : conformance) {
+    const AudioSignal ref = MiscAudio::LoadAsMono(pair.reference);
+    const AudioSignal deg = MiscAudio::LoadAsMono(pair.degraded);
+    if (ref.data_matrix.NumRows() == 0 || deg.data_matrix.NumRows() == 0 ||
+        ref.sample_rate != VisqolApi::k48kSampleRate) {
+      ABSL_RAW_LOG(ERROR, "Could not load the clips of %s.",
+                   pair.reference.Path().c_str());
+      return false;
+    }
+    clip_set->references.push_back(ref.data_matrix.ToVector());
+    clip_set->degraded.push_back(deg.data_matrix.ToVector());
+  }
+  const size_t num_sources = conformance.size();
+  const size_t sample_rate = VisqolApi::k48kSampleRate;
+  for (size_t i = 0; i < num_clips; i++) {
+    std::vector<double> &ref = clip_set->references[i % num_sources];
+    std::vector<double> &deg = clip_set->degraded[i % num_sources];
+    const size_t max_samples = std::min(ref.size(), deg.size());
+    const size_t num_samples = std::min(max_samples,
+        (3 + (i / num_sources) % 6) * sample_rate);
+    const size_t start = ((i / (num_sources * 6)) * sample_rate / 4) %
+        (max_samples - num_samples + 1);
+    clip_set->clips.push_back({absl::Span<double>(&ref[start], num_samples),
+                               absl::Span<double>(&deg[start], num_samples)});
+    clip_set->duration += static_cast<double>(num_samples) / sample_rate;
+  }
+  return true;
+}
+
+// The total duration of the degraded files of a set of pairs, from their
+// headers.
+double DegradedDuration(const std::vector<ReferenceDegradedPathPair> &pairs) {
+  double duration = 0.0;
+  for (const auto &pair : pairs) {
+    std::ifstream wav_file(pair.degraded.Path().c_str(), std::ios::binary);
+    const WavReader wav_reader(&wav_file);
+    if (wav_reader.IsHeaderValid()) {
+      duration += wav_reader.GetDuration();
+    }
+  }
+  return duration;
+}
+
+// The peak resident set size of the process, in kilobytes.
+uint64_t PeakRssKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  // macOS reports the peak in bytes.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// Compare a set of pairs on a number of threads and measure the run. Fails
+// if any pair could not be compared.
+bool MeasureRun(const std::string &mode, const std::string &dataset,
+                const std::vector<ReferenceDegradedPathPair> &pairs,
+                size_t num_threads, ThroughputReportMsg::RunMsg *run) {
+  const bool speech_mode = mode == "speech";
+  const FilePath model(FilePath::currentWorkingDir() + (speech_mode ?
+      kDefaultSpeechModelFile : kDefaultAudioModelFile));
+  VisqolConfig::VisqolOptions options;
+  options.set_use_speech_scoring(speech_mode);
+  options.set_resample_to_mode_rate(true);
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto results_or = BatchRunner::Run(model, options, pairs,
+                                           num_threads);
+  const std::chrono::duration<double> wall_time =
+      std::chrono::steady_clock::now() - start;
+  if (!results_or.ok() || results_or.ValueOrDie().size() != pairs.size()) {
+    ABSL_RAW_LOG(ERROR, "The %s pairs failed in %s mode on %zu threads.",
+                 dataset.c_str(), mode.c_str(), num_threads);
+    return false;
+  }
+
+  run->set_mode(mode);
+  run->set_dataset(dataset);
+  run->set_num_threads(num_threads);
+  run->set_num_pairs(pairs.size());
+  run->set_wall_time(wall_time.count());
+  run->set_pairs_per_sec(pairs.size() / wall_time.count());
+  run->set_real_time_factor(wall_time.count() / DegradedDuration(pairs));
+  run->set_peak_rss_kb(PeakRssKb());
+  return true;
+}
+
+// Compare a set of short clips in memory on a number of threads and measure
+// the run. Fails if any clip could not be compared.
+bool MeasureClipsRun(const std::string &mode, const ClipSet &clip_set,
+                     size_t num_threads, ThroughputReportMsg::RunMsg *run) {
+  const bool speech_mode = mode == "speech";
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(VisqolApi::k48kSampleRate);
+  auto options = config.mutable_options();
+  options->set_svr_model_path(FilePath::currentWorkingDir() + (speech_mode ?
+      kDefaultSpeechModelFile : kDefaultAudioModelFile));
+  options->set_use_speech_scoring(speech_mode);
+  options->set_resample_to_mode_rate(true);
+  VisqolApi visqol;
+  if (!visqol.Create(config).ok()) {
+    ABSL_RAW_LOG(ERROR, "Could not create ViSQOL in %s mode.", mode.c_str());
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto results = visqol.MeasureBatch(clip_set.clips, num_threads);
+  const std::chrono::duration<double> wall_time =
+      std::chrono::steady_clock::now() - start;
+  for (const auto &result : results) {
+    if (!result.ok()) {
+      ABSL_RAW_LOG(ERROR, "The clips failed in %s mode on %zu threads.",
+                   mode.c_str(), num_threads);
+      return false;
+    }
+  }
+
+  run->set_mode(mode);
+  run->set_dataset("clips");
+  run->set_num_threads(num_threads);
+  run->set_num_pairs(clip_set.clips.size());
+  run->set_wall_time(wall_time.count());
+  run->set_pairs_per_sec(clip_set.clips.size() / wall_time.count());
+  run->set_real_time_factor(wall_time.count() / clip_set.duration);
+  run->set_peak_rss_kb(PeakRssKb());
+  return true;
+}
+
+// Compare the pairs per second of each run to the matching run of the
+// baseline. Runs without a match are reported, and fail the check if the
+// baseline is required.
+bool CheckBaseline(const ThroughputReportMsg &report,
+                   const ThroughputReportMsg &baseline,
+                   double max_regression_percent, bool require_baseline) {
+  bool passed = true;
+  for (const auto &run : report.runs()) {
+    bool matched = false;
+    for (const auto &base : baseline.runs()) {
+      if (run.mode() != base.mode() || run.dataset() != base.dataset() ||
+          run.num_threads() != base.num_threads()) {
+        continue;
+      }
+      matched = true;
+      const double change = 100.0 *
+          (run.pairs_per_sec() - base.pairs_per_sec()) / base.pairs_per_sec();
+      if (change < -max_regression_percent) {
+        ABSL_RAW_LOG(ERROR, "%s %s pairs on %u threads: %.3f pairs/sec is "
+                     "%.1f%% below the baseline of %.3f.", run.mode().c_str(),
+                     run.dataset().c_str(), run.num_threads(),
+                     run.pairs_per_sec(), -change, base.pairs_per_sec());
+        passed = false;
+      }
+    }
+    if (!matched) {
+      if (require_baseline) {
+        ABSL_RAW_LOG(ERROR, "%s %s pairs on %u threads: no run in the "
+                     "baseline.", run.mode().c_str(), run.dataset().c_str(),
+                     run.num_threads());
+        passed = false;
+      } else {
+        ABSL_RAW_LOG(WARNING, "%s %s pairs on %u threads: no run in the "
+                     "baseline, so it is not compared.", run.mode().c_str(),
+                     run.dataset().c_str(), run.num_threads());
+      }
+    }
+  }
+  return passed;
+}
+
+bool ReadFile(const std::string &path, std::string *contents) {
+  std::ifstream in(path, std::ios_base::binary);
+  if (!in) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool WriteFile(const std::string &path, const std::string &contents) {
+  std::ofstream out(path, std::ios_base::binary);
+  out << contents;
+  return static_cast<bool>(out);
+}
+
+int RunBenchmark() {
+  const size_t max_threads = std::max(1, absl::GetFlag(FLAGS_max_threads));
+  const std::string baseline_path = absl::GetFlag(FLAGS_baseline);
+  const bool write_baseline = absl::GetFlag(FLAGS_write_baseline);
+  if ((write_baseline || absl::GetFlag(FLAGS_require_baseline)) &&
+      baseline_path.empty()) {
+    ABSL_RAW_LOG(ERROR,
+                 "--write_baseline and --require_baseline need a --baseline.");
+    return 1;
+  }
+
+  // The long pairs are written to a temporary directory, which is removed
+  // once the runs are done.
+  const boost::filesystem::path work_dir =
+      boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path("visqol_throughput_%%%%%%%%");
+  boost::filesystem::create_directories(work_dir);
+  const std::vector<ReferenceDegradedPathPair> conformance =
+      ConformancePairs();
+  std::vector<ReferenceDegradedPathPair> long_pairs;
+  if (!WriteLongPairs(conformance, work_dir.string(),
+                      absl::GetFlag(FLAGS_long_file_duration), &long_pairs)) {
+    boost::filesystem::remove_all(work_dir);
+    return 1;
+  }
+
+  ClipSet clip_set;
+  if (!MakeClips(conformance, std::max(0, absl::GetFlag(FLAGS_num_clips)),
+                 &clip_set)) {
+    boost::filesystem::remove_all(work_dir);
+    return 1;
+  }
+
+  const std::vector<std::pair<std::string,
+      const std::vector<ReferenceDegradedPathPair> *>> datasets = {
+          {"conformance", &conformance}, {"long", &long_pairs}};
+  ThroughputReportMsg report;
+  bool runs_ok = true;
+  for (const std::string mode : {"audio", "speech"}) {
+    for (const auto &dataset : datasets) {
+      for (size_t num_threads = 1; num_threads <= max_threads;
+           num_threads++) {
+        runs_ok &= MeasureRun(mode, dataset.first, *dataset.second,
+                              num_threads, report.add_runs());
+      }
+    }
+    if (clip_set.clips.empty()) {
+      continue;
+    }
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads++) {
+      runs_ok &= MeasureClipsRun(mode, clip_set, num_threads,
+                                 report.add_runs());
+    }
+  }
+  boost::filesystem::remove_all(work_dir);
+  if (!runs_ok) {
+    return 1;
+  }
+
+  std::string json;
+  google::protobuf::util::JsonPrintOptions print_options;
+  print_options.add_whitespace = true;
+  print_options.preserve_proto_field_names = true;
+  if (!google::protobuf::util::MessageToJsonString(report, &json,
+                                                   print_options).ok()) {
+    ABSL_RAW_LOG(ERROR, "Could not convert the report to JSON.");
+    return 1;
+  }
+  const std::string output_json = absl::GetFlag(FLAGS_output_json);
+  if (output_json.empty()) {
+    std::cout << json;
+  } else if (!WriteFile(output_json, json)) {
+    ABSL_RAW_LOG(ERROR, "Could not write %s.", output_json.c_str());
+    return 1;
+  }
+
+  if (baseline_path.empty()) {
+    return 0;
+  }
+  if (write_baseline) {
+    if (!WriteFile(baseline_path, json)) {
+      ABSL_RAW_LOG(ERROR, "Could not write %s.", baseline_path.c_str());
+      return 1;
+    }
+    return 0;
+  }
+  std::string baseline_json;
+  ThroughputReportMsg baseline;
+  if (!ReadFile(baseline_path, &baseline_json) ||
+      !google::protobuf::util::JsonStringToMessage(baseline_json,
+                                                   &baseline).ok()) {
+    ABSL_RAW_LOG(ERROR, "Could not read the baseline %s.",
+                 baseline_path.c_str());
+    return 1;
+  }
+  return CheckBaseline(report, baseline,
+                       absl::GetFlag(FLAGS_max_regression_percent),
+                       absl::GetFlag(FLAGS_require_baseline)) ? 0 : 1;
+}
+}  // namespace
+}  // namespace Visqol
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  return Visqol::RunBenchmark();
+}
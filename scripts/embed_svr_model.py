@@ -0,0 +1,116 @@
+# Copyright 2019 Google LLC, Andrew Hines
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Embeds a LIBSVM model file in a C++ source file.
+
+Takes as input a LIBSVM SVR model file with an RBF kernel, and prints a C++
+source file that defines the kEmbeddedSvrModel declared in
+src/include/embedded_svr_model.h. The support vectors are written out as a
+dense matrix with a row per support vector, in the layout of DenseRbfModel.
+
+The values are copied as they are written in the model file, so the compiler
+converts them to the same doubles that LIBSVM parses them to.
+
+Usage:
+  embed_svr_model.py model/libsvm_nu_svr_model.txt > embedded_svr_model.cc
+"""
+import sys
+
+_HEADER = """\
+// Generated by scripts/embed_svr_model.py from {source}. Do not edit.
+
+#include "embedded_svr_model.h"
+
+namespace Visqol {{
+namespace {{
+constexpr double kCoefficients[] = {{
+{coefficients}
+}};
+
+constexpr double kSupportVectors[] = {{
+{support_vectors}
+}};
+}}  // namespace
+
+const EmbeddedSvrModel kEmbeddedSvrModel = {{
+    {num_features}, {num_support_vectors}, {gamma}, {rho}, kCoefficients,
+    kSupportVectors}};
+}}  // namespace Visqol
+"""
+
+_VALUES_PER_LINE = 4
+
+
+def format_values(values):
+  lines = []
+  for i in range(0, len(values), _VALUES_PER_LINE):
+    lines.append('    ' + ', '.join(values[i:i + _VALUES_PER_LINE]) + ',')
+  return '\n'.join(lines)
+
+
+def read_model(path):
+  """Reads the header, coefficients and sparse support vectors of a model."""
+  header = {}
+  coefficients = []
+  support_vectors = []
+  with open(path) as model_file:
+    for line in model_file:
+      fields = line.split()
+      if fields == ['SV']:
+        break
+      if fields:
+        header[fields[0]] = fields[1:]
+    for line in model_file:
+      fields = line.split()
+      if not fields:
+        continue
+      coefficients.append(fields[0])
+      support_vectors.append(
+          [(int(node.split(':')[0]), node.split(':')[1]) for node in fields[1:]])
+  return header, coefficients, support_vectors
+
+
+def main(argv):
+  if len(argv) != 2:
+    sys.exit('Usage: embed_svr_model.py <path/to/libsvm_model.txt>')
+  header, coefficients, support_vectors = read_model(argv[1])
+  if (header.get('svm_type') not in (['epsilon_svr'], ['nu_svr']) or
+      header.get('kernel_type') != ['rbf']):
+    sys.exit('Only SVR models with an RBF kernel can be embedded: ' + argv[1])
+  if int(header['total_sv'][0]) != len(coefficients):
+    sys.exit('The model file has the wrong number of support vectors: ' +
+             argv[1])
+
+  # The feature indices are 1-indexed, and the missing features are 0.
+  num_features = max(
+      [index for nodes in support_vectors for index, _ in nodes] + [0])
+  dense = []
+  for nodes in support_vectors:
+    row = ['0.0'] * num_features
+    for index, value in nodes:
+      row[index - 1] = value
+    dense.extend(row)
+
+  sys.stdout.write(_HEADER.format(
+      source=argv[1],
+      coefficients=format_values(coefficients),
+      support_vectors=format_values(dense),
+      num_features=num_features,
+      num_support_vectors=len(coefficients),
+      gamma=header['gamma'][0],
+      rho=header['rho'][0]))
+
+
+if __name__ == '__main__':
+  main(sys.argv)
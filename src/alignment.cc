@@ -14,45 +14,126 @@
 
 #include "alignment.h"
 
+#include <algorithm>
 #include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "amatrix.h"
 #include "audio_signal.h"
+#include "audio_signal_view.h"
 #include "envelope.h"
+#include "parallel_executor.h"
 #include "xcorr.h"
 
 namespace Visqol {
+const size_t Alignment::kDecimationPerLevel = 8;
+const size_t Alignment::kNumDecimatedLevels = 2;
+const size_t Alignment::kMinDecimatedSamples = 1024;
+
 std::tuple<AudioSignal, AudioSignal, double> Alignment::AlignAndTruncate(
     const AudioSignal &ref_signal, const AudioSignal &deg_signal) {
-  auto alignment_result = Alignment::GloballyAlign(ref_signal, deg_signal);
-  AudioSignal aligned_deg_signal = std::get<0>(alignment_result);
+  auto aligned_result = AlignAndTruncate(AudioSignalView(ref_signal),
+                                         AudioSignalView(deg_signal));
+  return std::make_tuple(std::get<0>(aligned_result).ToAudioSignal(),
+                         std::get<1>(aligned_result).ToAudioSignal(),
+                         std::get<2>(aligned_result));
+}
+
+std::tuple<AudioSignalView, AudioSignalView, double>
+Alignment::AlignAndTruncate(const AudioSignalView &ref_signal,
+                            const AudioSignalView &deg_signal) {
+  auto ref_upper_env = Envelope::CalcUpperEnv(ref_signal);
+  auto deg_upper_env = Envelope::CalcUpperEnv(deg_signal);
+  auto best_lag = XCorr::CalcBestLag(ref_upper_env, deg_upper_env);
+  return Truncate(ref_signal, ShiftByLag(deg_signal, best_lag,
+                                         ref_signal.NumSamples()));
+}
+
+std::tuple<AudioSignalView, AudioSignalView, double>
+Alignment::AlignAndTruncateBounded(const AudioSignalView &ref_signal,
+                                   const AudioSignalView &deg_signal) {
+  auto ref_upper_env = Envelope::CalcUpperEnv(ref_signal);
+  auto deg_upper_env = Envelope::CalcUpperEnv(deg_signal);
+  auto best_lag = XCorr::CalcBestLagWithin(ref_upper_env, deg_upper_env,
+                                           ref_signal.NumSamples() / 2);
+  return Truncate(ref_signal, ShiftByLag(deg_signal, best_lag,
+                                         ref_signal.NumSamples()));
+}
+
+std::vector<std::tuple<AudioSignalView, AudioSignalView, double>>
+Alignment::AlignAndTruncateBatch(
+    const std::vector<std::pair<AudioSignalView, AudioSignalView>>
+        &signal_pairs,
+    bool bounded, size_t num_workers) {
+  const size_t num_pairs = signal_pairs.size();
+  const size_t num_chunks = std::max<size_t>(1,
+                                             std::min(num_workers, num_pairs));
+  const size_t chunk_size = (num_pairs + num_chunks - 1) / num_chunks;
+  std::vector<int64_t> best_lags(num_pairs, 0);
+  ParallelExecutor::ForEach(num_chunks, num_workers, [&](size_t chunk) {
+    const size_t begin = std::min(chunk * chunk_size, num_pairs);
+    const size_t end = std::min(begin + chunk_size, num_pairs);
+    std::vector<AMatrix<double>> ref_upper_envs;
+    std::vector<AMatrix<double>> deg_upper_envs;
+    ref_upper_envs.reserve(end - begin);
+    deg_upper_envs.reserve(end - begin);
+    for (size_t i = begin; i < end; i++) {
+      ref_upper_envs.push_back(Envelope::CalcUpperEnv(signal_pairs[i].first));
+      deg_upper_envs.push_back(Envelope::CalcUpperEnv(signal_pairs[i].second));
+    }
+    if (bounded) {
+      for (size_t i = begin; i < end; i++) {
+        best_lags[i] = XCorr::CalcBestLagWithin(
+            ref_upper_envs[i - begin], deg_upper_envs[i - begin],
+            signal_pairs[i].first.NumSamples() / 2);
+      }
+    } else {
+      const auto chunk_lags = XCorr::CalcBestLags(ref_upper_envs,
+                                                  deg_upper_envs);
+      std::copy(chunk_lags.begin(), chunk_lags.end(),
+                best_lags.begin() + begin);
+    }
+  });
+
+  std::vector<std::tuple<AudioSignalView, AudioSignalView, double>> results;
+  results.reserve(num_pairs);
+  for (size_t i = 0; i < num_pairs; i++) {
+    const AudioSignalView &ref_signal = signal_pairs[i].first;
+    results.push_back(Truncate(ref_signal,
+                               ShiftByLag(signal_pairs[i].second, best_lags[i],
+                                          ref_signal.NumSamples())));
+  }
+  return results;
+}
+
+std::tuple<AudioSignalView, AudioSignalView, double> Alignment::Truncate(
+    const AudioSignalView &ref_signal,
+    const std::tuple<AudioSignalView, double> &alignment_result) {
+  // Take the aligned degraded signal.
+  const AudioSignalView &deg_signal = std::get<0>(alignment_result);
   double lag = std::get<1>(alignment_result);
-  auto &ref_matrix = ref_signal.data_matrix;
-  // Take the aligned degraded matrix.
-  auto &deg_matrix = aligned_deg_signal.data_matrix;
-  AMatrix<double> new_ref_matrix = ref_matrix;
-  AMatrix<double> new_deg_matrix = deg_matrix;
+  const int64_t ref_num_samples = ref_signal.NumSamples();
+  const int64_t deg_num_samples = deg_signal.NumSamples();
 
   // Truncate the two aligned signals to match lengths.
   // If the lag is positive or negative, the starts are aligned.
   // (The front of deg_signal is zero padded or truncated).
-  if (ref_matrix.NumRows() > deg_matrix.NumRows()) {
-    new_ref_matrix = ref_matrix.GetRows(0, deg_matrix.NumRows() - 1);
-  } else if (ref_matrix.NumRows() < deg_matrix.NumRows()) {
+  if (ref_num_samples > deg_num_samples) {
+    return std::make_tuple(ref_signal.SubView(0, deg_num_samples), deg_signal,
+                           lag);
+  } else if (ref_num_samples < deg_num_samples) {
     // For positive lag, the beginning of ref is now aligned with zeros, so
     // that amount should be truncated.
-    new_ref_matrix = ref_matrix.GetRows(int(lag * ref_signal.sample_rate),
-                                        ref_matrix.NumRows() - 1);
-    // Truncate the zeros off the deg matrix as well.
-    new_deg_matrix = deg_matrix.GetRows((int)(lag * deg_signal.sample_rate),
-                                        ref_matrix.NumRows() - 1);
+    const int64_t ref_start = int(lag * ref_signal.SampleRate());
+    // Truncate the zeros off the deg signal as well.
+    const int64_t deg_start = (int)(lag * deg_signal.SampleRate());
+    return std::make_tuple(
+        ref_signal.SubView(ref_start, ref_num_samples - ref_start),
+        deg_signal.SubView(deg_start, ref_num_samples - deg_start), lag);
   }
-
-  AudioSignal new_deg_signal{new_deg_matrix, deg_signal.sample_rate};
-  AudioSignal new_ref_signal{new_ref_matrix, ref_signal.sample_rate};
-  return std::make_tuple(new_ref_signal, new_deg_signal, lag);
+  return std::make_tuple(ref_signal, deg_signal, lag);
 }
 
 std::tuple<AudioSignal, double> Alignment::GloballyAlign(
@@ -62,27 +143,124 @@ std::tuple<AudioSignal, double> Alignment::GloballyAlign(
   auto ref_upper_env = Envelope::CalcUpperEnv(ref_matrix);
   auto deg_upper_env = Envelope::CalcUpperEnv(deg_matrix);
   auto best_lag = XCorr::CalcBestLag(ref_upper_env, deg_upper_env);
+  return ApplyGlobalLag(deg_signal, best_lag, ref_matrix.NumRows());
+}
 
-  // Limit the lag to half a patch.
-  if (best_lag == 0 || std::abs(best_lag) > (double) ref_matrix.NumRows() / 2) {
-    return std::make_tuple(deg_signal, 0);
-  } else {
-    // align degraded matrix
-    AMatrix<double> new_deg_matrix;
-    // If the same point of the reference comes after the degraded
-    // (negative lag), truncate the rows before the refrence.
-    // If the reference comes before the degraded, prepend zeros
-    // to the degraded.
-    if (best_lag < 0) {
-      new_deg_matrix = deg_matrix.GetRows(std::abs(best_lag),
-                                          deg_matrix.NumRows() - 1);
-    } else {
-      new_deg_matrix = AMatrix<double>::Filled(best_lag, 1, 0.0);
-      new_deg_matrix = new_deg_matrix.JoinVertically(deg_matrix);
+std::tuple<AudioSignal, double> Alignment::GloballyAlignBounded(
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal) {
+  auto &ref_matrix = ref_signal.data_matrix;
+  auto ref_upper_env = Envelope::CalcUpperEnv(ref_matrix);
+  auto deg_upper_env = Envelope::CalcUpperEnv(deg_signal.data_matrix);
+  auto best_lag = XCorr::CalcBestLagWithin(ref_upper_env, deg_upper_env,
+                                           ref_matrix.NumRows() / 2);
+  return ApplyGlobalLag(deg_signal, best_lag, ref_matrix.NumRows());
+}
+
+std::tuple<AudioSignal, double> Alignment::GloballyAlignAroundLag(
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+    int64_t lag_hint, int64_t max_offset) {
+  auto &ref_matrix = ref_signal.data_matrix;
+  auto ref_upper_env = Envelope::CalcUpperEnv(ref_matrix);
+  auto deg_upper_env = Envelope::CalcUpperEnv(deg_signal.data_matrix);
+  const int64_t deg_num_samples = deg_upper_env.NumRows();
+
+  int64_t best_lag = 0;
+  bool found_lag = false;
+  if (-lag_hint < deg_num_samples) {
+    // Shift the degraded envelope by the hint, so that the lags around the
+    // hint are the lags around 0 of the shifted envelope. For a positive
+    // hint, zeros are prepended. For a negative one, samples are dropped.
+    std::vector<double> deg_shifted_env(std::max<int64_t>(lag_hint, 0), 0.0);
+    deg_shifted_env.insert(deg_shifted_env.end(),
+                           deg_upper_env.cbegin() +
+                               std::max<int64_t>(-lag_hint, 0),
+                           deg_upper_env.cend());
+    const int64_t offset = XCorr::CalcBestLagWithin(
+        ref_upper_env, AMatrix<double>(deg_shifted_env), max_offset);
+    best_lag = lag_hint + offset;
+    found_lag = std::abs(offset) < max_offset;
+  }
+  if (!found_lag) {
+    best_lag = XCorr::CalcBestLag(ref_upper_env, deg_upper_env);
+  }
+  return ApplyGlobalLag(deg_signal, best_lag, ref_matrix.NumRows());
+}
+
+std::tuple<AudioSignal, double> Alignment::GloballyAlignMultiResolution(
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal) {
+  auto &ref_matrix = ref_signal.data_matrix;
+  auto &deg_matrix = deg_signal.data_matrix;
+  // Level 0 is at the native sample rate. Each level above is decimated by
+  // kDecimationPerLevel.
+  std::vector<std::vector<double>> ref_levels{
+      Envelope::CalcUpperEnv(ref_matrix).ToVector()};
+  std::vector<std::vector<double>> deg_levels{
+      Envelope::CalcUpperEnv(deg_matrix).ToVector()};
+  for (size_t level = 1; level <= kNumDecimatedLevels; level++) {
+    ref_levels.push_back(Decimate(ref_levels.back(), kDecimationPerLevel));
+    deg_levels.push_back(Decimate(deg_levels.back(), kDecimationPerLevel));
+  }
+  if (std::min(ref_levels.back().size(), deg_levels.back().size()) <
+      kMinDecimatedSamples) {
+    return GloballyAlign(ref_signal, deg_signal);
+  }
+
+  // Search the full lag range on the coarsest level only.
+  int64_t best_lag = XCorr::CalcBestLag(
+      AMatrix<double>(ref_levels.back()), AMatrix<double>(deg_levels.back()));
+  for (int level = static_cast<int>(kNumDecimatedLevels) - 1; level >= 0;
+       level--) {
+    const auto &ref_env = ref_levels[level];
+    const auto &deg_env = deg_levels[level];
+    // A lag on the level above spans kDecimationPerLevel lags on this level.
+    const int64_t step = kDecimationPerLevel;
+    const int64_t max_lag = static_cast<int64_t>(
+        std::max(ref_env.size(), deg_env.size())) - 1;
+    const int64_t center = best_lag * step;
+    best_lag = XCorr::CalcBestLagInRange(ref_env, deg_env,
+                                         std::max(center - step, -max_lag),
+                                         std::min(center + step, max_lag));
+  }
+  return ApplyGlobalLag(deg_signal, best_lag, ref_matrix.NumRows());
+}
+
+std::vector<double> Alignment::Decimate(const std::vector<double> &envelope,
+                                        size_t factor) {
+  std::vector<double> decimated;
+  decimated.reserve((envelope.size() + factor - 1) / factor);
+  for (size_t start = 0; start < envelope.size(); start += factor) {
+    const size_t end = std::min(start + factor, envelope.size());
+    double sum = 0.0;
+    for (size_t i = start; i < end; i++) {
+      sum += envelope[i];
     }
-    AudioSignal new_deg_signal{std::move(new_deg_matrix),
-                               deg_signal.sample_rate};
-    return std::make_tuple(new_deg_signal, best_lag / (double) deg_signal.sample_rate);
+    decimated.push_back(sum / (end - start));
+  }
+  return decimated;
+}
+
+std::tuple<AudioSignal, double> Alignment::ApplyGlobalLag(
+    const AudioSignal &deg_signal, int64_t best_lag, size_t ref_num_samples) {
+  auto shifted = ShiftByLag(AudioSignalView(deg_signal), best_lag,
+                            ref_num_samples);
+  return std::make_tuple(std::get<0>(shifted).ToAudioSignal(),
+                         std::get<1>(shifted));
+}
+
+std::tuple<AudioSignalView, double> Alignment::ShiftByLag(
+    const AudioSignalView &deg_signal, int64_t best_lag,
+    size_t ref_num_samples) {
+  // Limit the lag to half a patch.
+  if (best_lag == 0 || std::abs(best_lag) > (double) ref_num_samples / 2) {
+    return std::make_tuple(deg_signal, 0.0);
   }
+  // If the same point of the reference comes after the degraded
+  // (negative lag), truncate the samples before the refrence.
+  // If the reference comes before the degraded, prepend zeros
+  // to the degraded. Both are expressed by the start of the view.
+  auto shifted = deg_signal.SubView(
+      -best_lag, static_cast<int64_t>(deg_signal.NumSamples()) + best_lag);
+  return std::make_tuple(shifted,
+                         best_lag / (double) deg_signal.SampleRate());
 }
 }  // namespace Visqol
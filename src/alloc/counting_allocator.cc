@@ -0,0 +1,75 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Replaces the global operator new and delete with versions that count each
+// allocation into the AllocationCounter of the calling thread. Linked into
+// the visqol binary, so that --record_memory_usage can report the bytes and
+// number of allocations of each comparison. Binaries that do not link it in
+// keep the default allocator, and only report the peak RSS.
+
+#include <cstdlib>
+#include <new>
+
+#include "memory_usage.h"
+
+namespace {
+const bool kHooked = Visqol::AllocationCounter::MarkHooked();
+
+void *CountedAlloc(std::size_t size) {
+  Visqol::AllocationCounter::RecordAllocation(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void *CountedAllocOrThrow(std::size_t size) {
+  void *ptr = CountedAlloc(size);
+  while (ptr == nullptr) {
+    const std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+    ptr = std::malloc(size == 0 ? 1 : size);
+  }
+  return ptr;
+}
+}  // namespace
+
+void *operator new(std::size_t size) { return CountedAllocOrThrow(size); }
+
+void *operator new[](std::size_t size) { return CountedAllocOrThrow(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return CountedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return CountedAlloc(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
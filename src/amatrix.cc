@@ -15,6 +15,7 @@
 #include "amatrix.h"
 
 #include <complex>
+#include <new>
 #include <utility>
 #include <valarray>
 #include <vector>
@@ -28,6 +29,20 @@ inline AMatrix<T>::AMatrix(const AMatrix<T>& other) {
   matrix_ = arma::Mat<T>(other.matrix_);
 }
 
+// The buffer of the other matrix is taken rather than copied. Armadillo
+// still copies matrices small enough to be held in their local buffer. A
+// borrowed matrix is wrapped again rather than moved, as armadillo may copy
+// borrowed values on a move.
+template <typename T>
+inline AMatrix<T>::AMatrix(AMatrix<T>&& other) noexcept {
+  if (other.matrix_.mem_state == 1) {
+    BorrowInPlace(other.matrix_.memptr(), other.matrix_.n_rows,
+                  other.matrix_.n_cols);
+  } else {
+    matrix_ = std::move(other.matrix_);
+  }
+}
+
 template <typename T>
 inline AMatrix<T>::AMatrix(const arma::Mat<T>& mat) {
   matrix_ = mat;
@@ -96,6 +111,24 @@ inline AMatrix<T> AMatrix<T>::Filled(size_t rows, size_t cols, T initialValue) {
   return am;
 }
 
+template <typename T>
+inline AMatrix<T> AMatrix<T>::Borrow(absl::Span<T> col) {
+  AMatrix<T> borrowed;
+  borrowed.BorrowInPlace(col.data(), col.size(), 1);
+  return borrowed;
+}
+
+template <typename T>
+inline void AMatrix<T>::BorrowInPlace(T* values, size_t rows, size_t cols) {
+  // Armadillo can only bind a matrix to memory that it does not own when the
+  // matrix is constructed, so the matrix is constructed again in place. The
+  // memory is not bound strictly, so armadillo moves the matrix into memory
+  // of its own if it is ever resized.
+  matrix_.~Mat();
+  new (&matrix_) arma::Mat<T>(values, (arma::uword)rows, (arma::uword)cols,
+                              false, false);
+}
+
 template <typename T>
 inline T& AMatrix<T>::operator()(size_t row, size_t column) {
   return matrix_((arma::uword)row, (arma::uword)column);
@@ -118,10 +151,29 @@ inline T AMatrix<T>::operator()(size_t elementIndex) const {
 
 template <typename T>
 inline AMatrix<T>& AMatrix<T>::operator=(const AMatrix<T>& other) {
+  // Armadillo assigns into the existing memory when the sizes match, which
+  // would write to borrowed values.
+  if (matrix_.mem_state == 1) {
+    matrix_.reset();
+  }
   matrix_ = other.matrix_;
   return *this;
 }
 
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator=(AMatrix<T>&& other) noexcept {
+  if (other.matrix_.mem_state == 1) {
+    BorrowInPlace(other.matrix_.memptr(), other.matrix_.n_rows,
+                  other.matrix_.n_cols);
+    return *this;
+  }
+  if (matrix_.mem_state == 1) {
+    matrix_.reset();
+  }
+  matrix_ = std::move(other.matrix_);
+  return *this;
+}
+
 template <typename T>
 inline bool AMatrix<T>::operator==(const AMatrix<T>& other) const {
   if (matrix_.n_rows != other.matrix_.n_rows) return false;
@@ -161,6 +213,42 @@ inline AMatrix<T> AMatrix<T>::operator-(const AMatrix<T>& m) const {
   return AMatrix<T>(matrix_ - m.matrix_);
 }
 
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator+=(const AMatrix<T>& other) {
+  matrix_ += other.matrix_;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator-=(const AMatrix<T>& other) {
+  matrix_ -= other.matrix_;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator+=(T v) {
+  matrix_ += v;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator-=(T v) {
+  matrix_ -= v;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator*=(T v) {
+  matrix_ *= v;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::operator/=(T v) {
+  matrix_ /= v;
+  return *this;
+}
+
 template <typename T>
 inline AMatrix<T> AMatrix<T>::PointWiseProduct(const AMatrix<T>& m) const {
   return AMatrix<T>(std::move(matrix_ % m.matrix_));
@@ -171,6 +259,18 @@ inline AMatrix<T> AMatrix<T>::PointWiseDivide(const AMatrix<T>& m) const {
   return AMatrix<T>(std::move(matrix_ / m.matrix_));
 }
 
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::PointWiseMultiplyInPlace(const AMatrix<T>& m) {
+  matrix_ %= m.matrix_;
+  return *this;
+}
+
+template <typename T>
+inline AMatrix<T>& AMatrix<T>::PointWiseDivideInPlace(const AMatrix<T>& m) {
+  matrix_ /= m.matrix_;
+  return *this;
+}
+
 template <typename T>
 inline AMatrix<T> AMatrix<T>::Transpose() const {
   return AMatrix<T>{std::move(trans(matrix_))};
@@ -395,6 +495,7 @@ inline T* AMatrix<T>::mutData() const {
 }
 
 template class AMatrix<double>;
+template class AMatrix<float>;
 template class AMatrix<std::complex<double>>;
 
 }  // namespace Visqol
@@ -0,0 +1,428 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "arrow_results_writer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+// The values of the Arrow flatbuffer schema (format/Message.fbs and
+// format/Schema.fbs of the Arrow repository) that the writer uses.
+constexpr int16_t kMetadataVersionV5 = 4;
+constexpr uint8_t kMessageHeaderSchema = 1;
+constexpr uint8_t kMessageHeaderRecordBatch = 3;
+constexpr uint8_t kTypeInt = 2;
+constexpr uint8_t kTypeFloatingPoint = 3;
+constexpr uint8_t kTypeUtf8 = 5;
+constexpr int16_t kPrecisionDouble = 2;
+constexpr uint32_t kContinuation = 0xFFFFFFFF;
+
+size_t AlignUp(size_t pos, size_t alignment) {
+  return (pos + alignment - 1) / alignment * alignment;
+}
+
+// Builds a flatbuffer front to back: each table is written before the
+// tables, vectors and strings that it points to, which are then written and
+// patched into its offset fields. Flatbuffers only need the targets of
+// offsets to come after them, so this is simpler than the usual back to front
+// building, for the few small messages of a stream.
+class FlatBuffer {
+ public:
+  // A field of a table: a scalar of 1, 2, 4 or 8 bytes, or an offset (of 4
+  // bytes) that is patched once its target is written.
+  struct Field {
+    uint16_t id;
+    uint8_t size;
+    uint64_t value;
+  };
+
+  static Field Offset(uint16_t id) { return {id, 4, 0}; }
+
+  // Reserves the offset to the root table.
+  FlatBuffer() { Put<uint32_t>(0); }
+
+  // Writes a table, with its vtable before it.
+  //
+  // Returns the position of the table, and sets the positions of its fields,
+  // in the order of the fields.
+  size_t AddTable(const std::vector<Field> &fields,
+                  std::vector<size_t> *positions = nullptr) {
+    size_t num_slots = 0;
+    for (const auto &field : fields) {
+      num_slots = std::max<size_t>(num_slots, field.id + 1);
+    }
+    Align(2);
+    const size_t vtable = buffer_.size();
+    const size_t vtable_size = 4 + 2 * num_slots;
+    const size_t table = AlignUp(vtable + vtable_size, 8);
+
+    // Lay out the fields after the offset to the vtable, each aligned to its
+    // size.
+    std::vector<uint16_t> slots(num_slots, 0);
+    std::vector<size_t> field_positions;
+    size_t end = table + 4;
+    for (const auto &field : fields) {
+      end = AlignUp(end, field.size);
+      slots[field.id] = static_cast<uint16_t>(end - table);
+      field_positions.push_back(end);
+      end += field.size;
+    }
+
+    Put<uint16_t>(static_cast<uint16_t>(vtable_size));
+    Put<uint16_t>(static_cast<uint16_t>(end - table));
+    for (const uint16_t slot : slots) {
+      Put<uint16_t>(slot);
+    }
+    Pad(table);
+    Put<int32_t>(static_cast<int32_t>(table - vtable));
+    for (size_t i = 0; i < fields.size(); i++) {
+      Pad(field_positions[i]);
+      const uint64_t value = fields[i].value;
+      buffer_.append(reinterpret_cast<const char *>(&value), fields[i].size);
+    }
+    if (positions != nullptr) {
+      *positions = std::move(field_positions);
+    }
+    return table;
+  }
+
+  // Writes a string and returns its position.
+  size_t AddString(const std::string &str) {
+    Align(4);
+    const size_t pos = buffer_.size();
+    Put<uint32_t>(static_cast<uint32_t>(str.size()));
+    buffer_.append(str);
+    buffer_.push_back('\0');
+    return pos;
+  }
+
+  // Writes a vector of offsets to tables, to be patched, and returns its
+  // position. The positions of the offsets are set.
+  size_t AddOffsetVector(size_t size, std::vector<size_t> *positions) {
+    Align(4);
+    const size_t pos = buffer_.size();
+    Put<uint32_t>(static_cast<uint32_t>(size));
+    positions->clear();
+    for (size_t i = 0; i < size; i++) {
+      positions->push_back(buffer_.size());
+      Put<uint32_t>(0);
+    }
+    return pos;
+  }
+
+  // Writes a vector of structs of two 64 bit integers (the FieldNode and
+  // Buffer structs of a record batch) and returns its position.
+  size_t AddStructVector(const std::vector<std::pair<int64_t, int64_t>> &v) {
+    // The structs are 8 byte aligned, and follow the 4 byte size.
+    Align(4);
+    if (buffer_.size() % 8 == 0) {
+      Put<uint32_t>(0);
+    }
+    const size_t pos = buffer_.size();
+    Put<uint32_t>(static_cast<uint32_t>(v.size()));
+    for (const auto &element : v) {
+      Put<int64_t>(element.first);
+      Put<int64_t>(element.second);
+    }
+    return pos;
+  }
+
+  // Points the offset at a position to a target that was written after it.
+  void Patch(size_t offset_pos, size_t target) {
+    const uint32_t offset = static_cast<uint32_t>(target - offset_pos);
+    std::memcpy(&buffer_[offset_pos], &offset, sizeof(offset));
+  }
+
+  void SetRoot(size_t table) { Patch(0, table); }
+
+  // Returns the buffer, padded to 8 bytes so that a message body that
+  // follows it is aligned.
+  std::string Finish() {
+    Align(8);
+    return std::move(buffer_);
+  }
+
+ private:
+  template <typename T>
+  void Put(T value) {
+    buffer_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void Align(size_t alignment) { Pad(AlignUp(buffer_.size(), alignment)); }
+
+  void Pad(size_t pos) { buffer_.resize(pos, '\0'); }
+
+  std::string buffer_;
+};
+
+// Appends a buffer to a message body, padded to 8 bytes, and records its
+// offset and length.
+void AppendBuffer(const void *data, size_t size, std::string *body,
+                  std::vector<std::pair<int64_t, int64_t>> *buffers) {
+  buffers->emplace_back(body->size(), size);
+  if (size > 0) {
+    body->append(static_cast<const char *>(data), size);
+  }
+  body->resize(AlignUp(body->size(), 8), '\0');
+}
+
+// The stage timings of a result, in the order of their fields. The memory
+// usage fields are skipped.
+std::vector<const google::protobuf::FieldDescriptor *> TimingFields(
+    google::protobuf::FieldDescriptor::CppType cpp_type) {
+  const auto *descriptor = SimilarityResultMsg::StageTimingsMsg::descriptor();
+  std::vector<const google::protobuf::FieldDescriptor *> fields;
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    if (descriptor->field(i)->cpp_type() == cpp_type) {
+      fields.push_back(descriptor->field(i));
+    }
+  }
+  return fields;
+}
+}  // namespace
+
+ArrowResultsWriter::ArrowResultsWriter(const FilePath &path,
+                                       size_t rows_per_batch)
+    : file_(path.Path(), std::ios_base::binary | std::ios_base::trunc),
+      rows_per_batch_(std::max<size_t>(rows_per_batch, 1)) {}
+
+ArrowResultsWriter::~ArrowResultsWriter() {
+  Flush();
+  if (!columns_.empty()) {
+    // The end of stream marker.
+    const uint32_t eos[2] = {kContinuation, 0};
+    file_.write(reinterpret_cast<const char *>(eos), sizeof(eos));
+  }
+}
+
+SimilarityResultMsg ArrowResultsWriter::RowFields(
+    const SimilarityResultMsg &sim_res_msg) {
+  SimilarityResultMsg row;
+  row.set_reference_filepath(sim_res_msg.reference_filepath());
+  row.set_degraded_filepath(sim_res_msg.degraded_filepath());
+  row.set_moslqo(sim_res_msg.moslqo());
+  row.set_vnsim(sim_res_msg.vnsim());
+  *row.mutable_fvnsim() = sim_res_msg.fvnsim();
+  if (sim_res_msg.has_timings()) {
+    *row.mutable_timings() = sim_res_msg.timings();
+  }
+  return row;
+}
+
+void ArrowResultsWriter::Append(const SimilarityResultMsg &sim_res_msg) {
+  if (!file_) {
+    return;
+  }
+  if (columns_.empty()) {
+    WriteSchema(sim_res_msg);
+  }
+  auto column = columns_.begin();
+  for (const std::string *path : {&sim_res_msg.reference_filepath(),
+                                  &sim_res_msg.degraded_filepath()}) {
+    column->chars.append(*path);
+    column->offsets.push_back(static_cast<int32_t>(column->chars.size()));
+    ++column;
+  }
+  (column++)->doubles.push_back(sim_res_msg.moslqo());
+  (column++)->doubles.push_back(sim_res_msg.vnsim());
+  for (size_t band = 0; band < num_fvnsim_; band++) {
+    (column++)->doubles.push_back(
+        band < static_cast<size_t>(sim_res_msg.fvnsim_size())
+            ? sim_res_msg.fvnsim(band)
+            : std::numeric_limits<double>::quiet_NaN());
+  }
+  const auto *reflection =
+      SimilarityResultMsg::StageTimingsMsg::GetReflection();
+  if (timings_) {
+    for (const auto *field : TimingFields(
+             google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)) {
+      (column++)->doubles.push_back(
+          reflection->GetDouble(sim_res_msg.timings(), field));
+    }
+  }
+  if (memory_usage_) {
+    for (const auto *field : TimingFields(
+             google::protobuf::FieldDescriptor::CPPTYPE_UINT64)) {
+      (column++)->ints.push_back(
+          reflection->GetUInt64(sim_res_msg.timings(), field));
+    }
+  }
+  if (++num_rows_ == rows_per_batch_) {
+    WriteRecordBatch();
+  }
+}
+
+void ArrowResultsWriter::Flush() {
+  if (num_rows_ > 0) {
+    WriteRecordBatch();
+  }
+  file_.flush();
+}
+
+void ArrowResultsWriter::WriteSchema(const SimilarityResultMsg &first) {
+  columns_.push_back({"reference", ColumnType::kUtf8});
+  columns_.push_back({"degraded", ColumnType::kUtf8});
+  columns_.push_back({"moslqo", ColumnType::kFloat64});
+  columns_.push_back({"vnsim", ColumnType::kFloat64});
+  num_fvnsim_ = first.fvnsim_size();
+  for (size_t band = 0; band < num_fvnsim_; band++) {
+    columns_.push_back({"fvnsim" + std::to_string(band),
+                        ColumnType::kFloat64});
+  }
+  const auto *reflection =
+      SimilarityResultMsg::StageTimingsMsg::GetReflection();
+  for (const auto *field : TimingFields(
+           google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)) {
+    timings_ |= reflection->GetDouble(first.timings(), field) > 0;
+  }
+  if (timings_) {
+    for (const auto *field : TimingFields(
+             google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)) {
+      columns_.push_back({field->name() + "_sec", ColumnType::kFloat64});
+    }
+  }
+  memory_usage_ = first.timings().peak_rss_kb() > 0;
+  if (memory_usage_) {
+    for (const auto *field : TimingFields(
+             google::protobuf::FieldDescriptor::CPPTYPE_UINT64)) {
+      columns_.push_back({field->name(), ColumnType::kUInt64});
+    }
+  }
+  for (auto &column : columns_) {
+    if (column.type == ColumnType::kUtf8) {
+      column.offsets.push_back(0);
+    }
+  }
+
+  FlatBuffer fb;
+  std::vector<size_t> message_fields;
+  fb.SetRoot(fb.AddTable({{0, 2, kMetadataVersionV5},
+                          {1, 1, kMessageHeaderSchema},
+                          FlatBuffer::Offset(2),
+                          {3, 8, 0}},
+                         &message_fields));
+  std::vector<size_t> schema_fields;
+  fb.Patch(message_fields[2],
+           fb.AddTable({FlatBuffer::Offset(1)}, &schema_fields));
+  std::vector<size_t> field_offsets;
+  fb.Patch(schema_fields[0],
+           fb.AddOffsetVector(columns_.size(), &field_offsets));
+  for (size_t i = 0; i < columns_.size(); i++) {
+    uint8_t type_type = kTypeUtf8;
+    if (columns_[i].type == ColumnType::kFloat64) {
+      type_type = kTypeFloatingPoint;
+    } else if (columns_[i].type == ColumnType::kUInt64) {
+      type_type = kTypeInt;
+    }
+    std::vector<size_t> field_fields;
+    fb.Patch(field_offsets[i],
+             fb.AddTable({FlatBuffer::Offset(0),
+                          {1, 1, 0},
+                          {2, 1, type_type},
+                          FlatBuffer::Offset(3),
+                          FlatBuffer::Offset(5)},
+                         &field_fields));
+    fb.Patch(field_fields[0], fb.AddString(columns_[i].name));
+    if (columns_[i].type == ColumnType::kFloat64) {
+      fb.Patch(field_fields[3], fb.AddTable({{0, 2, kPrecisionDouble}}));
+    } else if (columns_[i].type == ColumnType::kUInt64) {
+      // A bit width of 64, unsigned.
+      fb.Patch(field_fields[3], fb.AddTable({{0, 4, 64}, {1, 1, 0}}));
+    } else {
+      fb.Patch(field_fields[3], fb.AddTable({}));
+    }
+    std::vector<size_t> no_children;
+    fb.Patch(field_fields[4], fb.AddOffsetVector(0, &no_children));
+  }
+  WriteMessage(fb.Finish(), "");
+}
+
+void ArrowResultsWriter::WriteRecordBatch() {
+  // The body holds the buffers of each column in order: an empty validity
+  // buffer, as no value is null, then the offsets and characters of a string
+  // column, or the values of any other column.
+  std::string body;
+  std::vector<std::pair<int64_t, int64_t>> nodes;
+  std::vector<std::pair<int64_t, int64_t>> buffers;
+  for (auto &column : columns_) {
+    nodes.emplace_back(num_rows_, 0);
+    AppendBuffer(nullptr, 0, &body, &buffers);
+    switch (column.type) {
+      case ColumnType::kUtf8:
+        AppendBuffer(column.offsets.data(),
+                     column.offsets.size() * sizeof(int32_t), &body,
+                     &buffers);
+        AppendBuffer(column.chars.data(), column.chars.size(), &body,
+                     &buffers);
+        column.offsets.assign(1, 0);
+        column.chars.clear();
+        break;
+      case ColumnType::kFloat64:
+        AppendBuffer(column.doubles.data(),
+                     column.doubles.size() * sizeof(double), &body, &buffers);
+        column.doubles.clear();
+        break;
+      case ColumnType::kUInt64:
+        AppendBuffer(column.ints.data(), column.ints.size() * sizeof(uint64_t),
+                     &body, &buffers);
+        column.ints.clear();
+        break;
+    }
+  }
+
+  FlatBuffer fb;
+  std::vector<size_t> message_fields;
+  fb.SetRoot(fb.AddTable({{0, 2, kMetadataVersionV5},
+                          {1, 1, kMessageHeaderRecordBatch},
+                          FlatBuffer::Offset(2),
+                          {3, 8, body.size()}},
+                         &message_fields));
+  std::vector<size_t> batch_fields;
+  fb.Patch(message_fields[2],
+           fb.AddTable({{0, 8, num_rows_},
+                        FlatBuffer::Offset(1),
+                        FlatBuffer::Offset(2)},
+                       &batch_fields));
+  fb.Patch(batch_fields[1], fb.AddStructVector(nodes));
+  fb.Patch(batch_fields[2], fb.AddStructVector(buffers));
+  WriteMessage(fb.Finish(), body);
+  num_rows_ = 0;
+}
+
+void ArrowResultsWriter::WriteMessage(const std::string &metadata,
+                                      const std::string &body) {
+  const uint32_t prefix[2] = {kContinuation,
+                              static_cast<uint32_t>(metadata.size())};
+  file_.write(reinterpret_cast<const char *>(prefix), sizeof(prefix));
+  file_.write(metadata.data(), metadata.size());
+  file_.write(body.data(), body.size());
+}
+}  // namespace Visqol
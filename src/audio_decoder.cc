@@ -0,0 +1,146 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_decoder.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/strings/ascii.h"
+#include "absl/synchronization/mutex.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+// The registered decoders, keyed by their lower case extensions. They are
+// never freed, so that the pointers that Find returns stay valid. The
+// registry is built on first use, as decoders register themselves during
+// static initialization.
+struct Registry {
+  absl::Mutex mutex;
+  std::map<std::string, std::unique_ptr<AudioDecoder>> decoders;
+};
+
+Registry &GetRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+// The lower case extension of a path, without its dot, or an empty string if
+// the file name has none.
+std::string ExtensionOf(const FilePath &path) {
+  const std::string path_str = path.Path();
+  const size_t dot = path_str.find_last_of('.');
+  if (dot == std::string::npos ||
+      path_str.find_first_of("/\\", dot) != std::string::npos) {
+    return "";
+  }
+  return absl::AsciiStrToLower(path_str.substr(dot + 1));
+}
+}  // namespace
+
+DecodedSignalBuilder::DecodedSignalBuilder(size_t num_channels,
+                                           size_t num_frames, bool downmix)
+    : num_channels_(num_channels),
+      num_declared_frames_(num_frames),
+      downmix_(downmix) {
+  const size_t num_columns = downmix ? 1 : num_channels;
+  if (num_declared_frames_ > 0) {
+    samples_ = AMatrix<double>::Filled(num_declared_frames_, num_columns,
+                                       0.0);
+  } else {
+    columns_.resize(num_columns);
+  }
+}
+
+AudioSignal DecodedSignalBuilder::Build(size_t sample_rate,
+                                        const FilePath &path) {
+  AudioSignal signal;
+  signal.sample_rate = sample_rate;
+  if (num_frames_ == 0) {
+    ABSL_RAW_LOG(ERROR, "Error reading data for file %s.",
+                 path.Path().c_str());
+    return signal;
+  }
+  if (num_declared_frames_ > 0) {
+    if (num_frames_ < num_declared_frames_) {
+      ABSL_RAW_LOG(WARNING,
+                   "Number of frames decoded (%zu) from %s was less than the"
+                   " declared number (%zu).",
+                   num_frames_, path.Path().c_str(), num_declared_frames_);
+    } else if (num_dropped_frames_ > 0) {
+      ABSL_RAW_LOG(WARNING,
+                   "Dropped %zu frames of %s past the declared number (%zu).",
+                   num_dropped_frames_, path.Path().c_str(),
+                   num_declared_frames_);
+    }
+    signal.data_matrix = std::move(samples_);
+    return signal;
+  }
+  // The matrix is column major, so the channels are laid out one after
+  // another.
+  std::vector<double> samples;
+  samples.reserve(num_frames_ * columns_.size());
+  for (auto &column : columns_) {
+    samples.insert(samples.end(), column.begin(), column.end());
+    std::vector<double>().swap(column);
+  }
+  signal.data_matrix = AMatrix<double>(num_frames_, columns_.size(),
+                                       samples);
+  return signal;
+}
+
+bool AudioDecoderRegistry::Register(const std::string &extension,
+                                    std::unique_ptr<AudioDecoder> decoder) {
+  const std::string key = absl::AsciiStrToLower(extension);
+  if (key.empty() || key == "wav") {
+    return false;
+  }
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  return registry.decoders.emplace(key, std::move(decoder)).second;
+}
+
+const AudioDecoder *AudioDecoderRegistry::Find(const FilePath &path) {
+  const std::string extension = ExtensionOf(path);
+  if (extension.empty()) {
+    return nullptr;
+  }
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  const auto it = registry.decoders.find(extension);
+  return it == registry.decoders.end() ? nullptr : it->second.get();
+}
+
+std::vector<std::string> AudioDecoderRegistry::Extensions() {
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  std::vector<std::string> extensions;
+  extensions.reserve(registry.decoders.size());
+  for (const auto &entry : registry.decoders) {
+    extensions.push_back(entry.first);
+  }
+  return extensions;
+}
+}  // namespace Visqol
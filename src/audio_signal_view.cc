@@ -0,0 +1,94 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "audio_signal_view.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+AudioSignalView::AudioSignalView(const AudioSignal &signal)
+    : AudioSignalView(signal, 0, signal.data_matrix.NumRows()) {}
+
+AudioSignalView::AudioSignalView(const AudioSignal &signal,
+                                 int64_t first_sample, size_t num_samples)
+    : AudioSignalView(signal.data_matrix.data(),
+                      signal.data_matrix.NumRows(), first_sample,
+                      num_samples, signal.sample_rate) {}
+
+AudioSignalView::AudioSignalView(const double *data, int64_t num_data_samples,
+                                 int64_t first_sample, size_t num_samples,
+                                 size_t sample_rate)
+    : data_(data),
+      num_data_samples_(num_data_samples),
+      first_sample_(first_sample),
+      num_samples_(num_samples),
+      sample_rate_(sample_rate) {}
+
+AudioSignalView AudioSignalView::SubView(int64_t first_sample,
+                                         size_t num_samples) const {
+  // Restrict the samples that can be seen to those visible in this view.
+  const int64_t visible_begin = std::max<int64_t>(first_sample_, 0);
+  const int64_t visible_end = std::min<int64_t>(
+      first_sample_ + static_cast<int64_t>(num_samples_), num_data_samples_);
+  const int64_t num_visible = std::max<int64_t>(visible_end - visible_begin,
+                                                0);
+  return AudioSignalView(data_ + visible_begin, num_visible,
+                         first_sample_ + first_sample - visible_begin,
+                         num_samples, sample_rate_);
+}
+
+std::vector<double> AudioSignalView::ToVector() const {
+  std::vector<double> samples(num_samples_);
+  CopyTo(absl::MakeSpan(samples));
+  return samples;
+}
+
+absl::Span<const double> AudioSignalView::ToSpan(
+    VisqolWorkspace *workspace) const {
+  if (first_sample_ >= 0 &&
+      first_sample_ + static_cast<int64_t>(num_samples_) <= num_data_samples_) {
+    return absl::Span<const double>(data_ + first_sample_, num_samples_);
+  }
+  const absl::Span<double> samples = workspace->Allocate<double>(num_samples_);
+  CopyTo(samples);
+  return samples;
+}
+
+void AudioSignalView::CopyTo(absl::Span<double> samples) const {
+  std::fill(samples.begin(), samples.end(), 0.0);
+  // Only copy the range of the view that overlaps the visible samples.
+  const int64_t begin = std::max<int64_t>(-first_sample_, 0);
+  const int64_t end = std::min<int64_t>(num_samples_,
+                                        num_data_samples_ - first_sample_);
+  if (begin < end) {
+    std::copy(data_ + first_sample_ + begin, data_ + first_sample_ + end,
+              samples.begin() + begin);
+  }
+}
+
+AMatrix<double> AudioSignalView::ToMatrix() const {
+  return AMatrix<double>(num_samples_, 1, ToVector());
+}
+
+AudioSignal AudioSignalView::ToAudioSignal() const {
+  return AudioSignal{ToMatrix(), sample_rate_};
+}
+}  // namespace Visqol
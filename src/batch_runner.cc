@@ -0,0 +1,292 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/status_macros.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "batch_sharder.h"
+#include "file_path.h"
+#include "metrics.h"
+#include "pair_source.h"
+#include "parallel_executor.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "thread_pinning.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+
+#include "google/protobuf/port_def.inc"
+// This 'using' declaration is necessary for the RETURN_IF_ERROR macro.
+using namespace google::protobuf::util;
+
+namespace Visqol {
+namespace {
+// A run of consecutive pairs with the same reference.
+struct Task {
+  size_t first_pair;
+  size_t num_pairs;
+  double estimated_cost;
+};
+
+// The pairs of a PairSource that have been discovered but not yet taken by a
+// worker.
+struct DiscoveredPairs {
+  bool HasRoom() const {
+    return queue.size() < BatchRunner::kMaxQueuedPairs;
+  }
+
+  bool HasPairsOrDone() const { return !queue.empty() || done; }
+
+  absl::Mutex mutex;
+  std::deque<ReferenceDegradedPathPair> queue;
+  // The index of the pair at the front of the queue.
+  size_t num_taken = 0;
+  // Set once the source has no more pairs.
+  bool done = false;
+};
+
+// The CPUs that each worker of a batch is pinned to, which are empty when the
+// workers are not pinned. A batch on a single worker runs on the calling
+// thread, which is not pinned.
+std::vector<std::vector<int>> CpusOfWorkers(
+    const VisqolConfig::VisqolOptions &options, size_t num_workers) {
+  std::vector<std::vector<int>> worker_cpus(num_workers);
+  if (num_workers > 1 &&
+      options.thread_pinning() != VisqolConfig::VisqolOptions::NO_PINNING) {
+    const auto node_cpus = ThreadPinning::NodeCpus();
+    for (size_t worker = 0; worker < num_workers; worker++) {
+      worker_cpus[worker] = ThreadPinning::WorkerCpus(
+          worker, options.thread_pinning(), node_cpus);
+    }
+  }
+  return worker_cpus;
+}
+
+// Create and initialize the manager of each worker. The manager of a pinned
+// worker is initialized on a thread that is pinned to the CPUs of the
+// worker, so that its memory is allocated on the node of the worker.
+Status InitManagers(const FilePath &sim_to_quality_mapper_model,
+                    const VisqolConfig::VisqolOptions &options,
+                    const std::vector<std::vector<int>> &worker_cpus,
+                    std::vector<std::unique_ptr<VisqolManager>> *managers) {
+  const size_t num_workers = worker_cpus.size();
+  std::vector<Status> statuses(num_workers);
+  managers->resize(num_workers);
+  const bool pinned = std::any_of(worker_cpus.begin(), worker_cpus.end(),
+      [](const std::vector<int> &cpus) { return !cpus.empty(); });
+  ParallelExecutor::ForEach(num_workers, pinned ? num_workers : 1,
+                            [&](size_t worker) {
+    const ScopedThreadPin pin(worker_cpus[worker]);
+    (*managers)[worker] = absl::make_unique<VisqolManager>();
+    statuses[worker] = (*managers)[worker]->Init(sim_to_quality_mapper_model,
+                                                 options);
+  });
+  for (const auto &status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return Status();
+}
+}  // namespace
+
+const size_t BatchRunner::kMaxPairsPerTask = 16;
+const size_t BatchRunner::kMaxQueuedPairs = 1024;
+
+StatusOr<std::vector<SimilarityResultMsg>> BatchRunner::Run(
+    const FilePath &sim_to_quality_mapper_model,
+    const VisqolConfig::VisqolOptions &options,
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    size_t num_threads, bool log_pair_costs) {
+  // Each pair has its own slot, so the workers can fill them concurrently.
+  std::vector<std::unique_ptr<SimilarityResultMsg>> pair_results(
+      pairs.size());
+  RETURN_IF_ERROR(Stream(sim_to_quality_mapper_model, options, pairs,
+      num_threads, [&pair_results](size_t i,
+                                   StatusOr<SimilarityResultMsg> &&status_or) {
+        if (status_or.ok()) {
+          pair_results[i] = absl::make_unique<SimilarityResultMsg>(
+              std::move(status_or.ValueOrDie()));
+        }
+      }, log_pair_costs));
+
+  std::vector<SimilarityResultMsg> results;
+  results.reserve(pairs.size());
+  for (auto &result : pair_results) {
+    if (result != nullptr) {
+      results.push_back(std::move(*result));
+    }
+  }
+  return results;
+}
+
+Status BatchRunner::Stream(
+    const FilePath &sim_to_quality_mapper_model,
+    const VisqolConfig::VisqolOptions &options,
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    size_t num_threads, const VisqolManager::ResultHandler &handler,
+    bool log_pair_costs) {
+  const size_t num_workers = std::max<size_t>(
+      std::min(num_threads, pairs.size()), 1);
+  const auto worker_cpus = CpusOfWorkers(options, num_workers);
+  std::vector<std::unique_ptr<VisqolManager>> managers;
+  RETURN_IF_ERROR(InitManagers(sim_to_quality_mapper_model, options,
+                               worker_cpus, &managers));
+  if (num_workers == 1) {
+    managers[0]->RunBatch(pairs, handler);
+    return Status();
+  }
+
+  // The cost of a pair is estimated as the duration of both of its files,
+  // which is read from their headers without decoding them.
+  const std::vector<double> pair_costs = BatchSharder::EstimatePairCosts(
+      pairs, num_workers);
+
+  // Split the batch into runs of consecutive pairs with the same reference,
+  // and start the most costly runs first so that no long run is left to
+  // finish on its own at the end.
+  std::vector<Task> tasks;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (tasks.empty() || tasks.back().num_pairs >= kMaxPairsPerTask ||
+        pairs[i - 1].reference.Path() != pairs[i].reference.Path()) {
+      tasks.push_back(Task{i, 0, 0.0});
+    }
+    tasks.back().num_pairs++;
+    tasks.back().estimated_cost += pair_costs[i];
+  }
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](const Task &a, const Task &b) {
+                     return a.estimated_cost > b.estimated_cost;
+                   });
+
+  // Each worker takes the next task from the shared queue whenever it is
+  // idle, so the workers stay busy however far the estimates are out.
+  std::vector<double> pair_seconds(pairs.size());
+  std::atomic<size_t> next_task(0);
+  ParallelExecutor::ForEach(num_workers, num_workers, [&](size_t worker) {
+    const ScopedThreadPin pin(worker_cpus[worker]);
+    for (size_t t = next_task++; t < tasks.size(); t = next_task++) {
+      for (size_t i = tasks[t].first_pair;
+           i < tasks[t].first_pair + tasks[t].num_pairs; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        auto status_or = managers[worker]->Run(pairs[i].reference,
+                                               pairs[i].degraded);
+        pair_seconds[i] = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        Metrics::ReportPair(status_or.status().error_code(), pair_seconds[i]);
+        if (!status_or.ok()) {
+          ABSL_RAW_LOG(ERROR, "Error executing ViSQOL: %s.",
+                       status_or.status().ToString().c_str());
+        }
+        handler(i, std::move(status_or));
+      }
+    }
+  });
+
+  double total_cost = 0.0;
+  double total_seconds = 0.0;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (log_pair_costs) {
+      ABSL_RAW_LOG(INFO, "Pair %zu (%s): estimated cost %.2f sec of audio,"
+                   " compared in %.3f sec.", i,
+                   pairs[i].degraded.Path().c_str(), pair_costs[i],
+                   pair_seconds[i]);
+    }
+    total_cost += pair_costs[i];
+    total_seconds += pair_seconds[i];
+  }
+  if (log_pair_costs) {
+    ABSL_RAW_LOG(INFO, "Compared %zu pairs with %.2f sec of audio in %.3f sec"
+                 " of worker time.", pairs.size(), total_cost, total_seconds);
+  }
+  return Status();
+}
+
+Status BatchRunner::StreamFrom(
+    const FilePath &sim_to_quality_mapper_model,
+    const VisqolConfig::VisqolOptions &options, PairSource *source,
+    size_t num_threads, const VisqolManager::ResultHandler &handler) {
+  const size_t num_workers = std::max<size_t>(num_threads, 1);
+  const auto worker_cpus = CpusOfWorkers(options, num_workers);
+  std::vector<std::unique_ptr<VisqolManager>> managers;
+  RETURN_IF_ERROR(InitManagers(sim_to_quality_mapper_model, options,
+                               worker_cpus, &managers));
+
+  DiscoveredPairs discovered;
+  std::thread discovery([source, &discovered]() {
+    ReferenceDegradedPathPair pair;
+    while (source->Next(&pair)) {
+      absl::MutexLock lock(&discovered.mutex);
+      discovered.mutex.Await(absl::Condition(&discovered,
+                                             &DiscoveredPairs::HasRoom));
+      discovered.queue.push_back(pair);
+    }
+    absl::MutexLock lock(&discovered.mutex);
+    discovered.done = true;
+  });
+
+  ParallelExecutor::ForEach(num_workers, num_workers, [&](size_t worker) {
+    const ScopedThreadPin pin(worker_cpus[worker]);
+    std::vector<ReferenceDegradedPathPair> task;
+    while (true) {
+      // Take the queued run of consecutive pairs with the same reference.
+      size_t first_pair;
+      task.clear();
+      {
+        absl::MutexLock lock(&discovered.mutex);
+        discovered.mutex.Await(absl::Condition(
+            &discovered, &DiscoveredPairs::HasPairsOrDone));
+        if (discovered.queue.empty()) {
+          return;
+        }
+        first_pair = discovered.num_taken;
+        do {
+          task.push_back(discovered.queue.front());
+          discovered.queue.pop_front();
+        } while (task.size() < kMaxPairsPerTask && !discovered.queue.empty() &&
+                 discovered.queue.front().reference.Path() ==
+                     task.front().reference.Path());
+        discovered.num_taken += task.size();
+      }
+      for (size_t i = 0; i < task.size(); i++) {
+        const auto start = std::chrono::steady_clock::now();
+        auto status_or = managers[worker]->Run(task[i].reference,
+                                               task[i].degraded);
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        Metrics::ReportPair(status_or.status().error_code(), seconds);
+        if (!status_or.ok()) {
+          ABSL_RAW_LOG(ERROR, "Error executing ViSQOL: %s.",
+                       status_or.status().ToString().c_str());
+        }
+        handler(first_pair + i, std::move(status_or));
+      }
+    }
+  });
+  discovery.join();
+  return Status();
+}
+}  // namespace Visqol
@@ -0,0 +1,105 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "batch_sharder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "file_path.h"
+#include "parallel_executor.h"
+#include "wav_reader.h"
+
+namespace Visqol {
+namespace {
+// A run of consecutive pairs with the same reference.
+struct Group {
+  size_t first_pair;
+  size_t num_pairs;
+  double cost;
+};
+
+// The duration of a wav file from its header, or 0 if it cannot be read.
+double ReadDuration(const FilePath &path) {
+  std::ifstream wav_file(path.Path().c_str(), std::ios::binary);
+  if (!wav_file) {
+    return 0.0;
+  }
+  const WavReader wav_reader(&wav_file);
+  return wav_reader.IsHeaderValid() ? wav_reader.GetDuration() : 0.0;
+}
+}  // namespace
+
+const size_t BatchSharder::kMaxPairsPerGroup = 16;
+
+std::vector<double> BatchSharder::EstimatePairCosts(
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    size_t num_threads) {
+  std::vector<double> pair_costs(pairs.size());
+  ParallelExecutor::ForEach(pairs.size(), num_threads, [&](size_t i) {
+    pair_costs[i] = ReadDuration(pairs[i].reference) +
+        ReadDuration(pairs[i].degraded);
+  });
+  return pair_costs;
+}
+
+std::vector<size_t> BatchSharder::AssignShards(
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    const std::vector<double> &pair_costs, size_t num_shards) {
+  num_shards = std::max<size_t>(num_shards, 1);
+  std::vector<Group> groups;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (groups.empty() || groups.back().num_pairs >= kMaxPairsPerGroup ||
+        pairs[i - 1].reference.Path() != pairs[i].reference.Path()) {
+      groups.push_back(Group{i, 0, 0.0});
+    }
+    groups.back().num_pairs++;
+    groups.back().cost += pair_costs[i];
+  }
+  // The sort is stable, so groups of equal cost keep their batch order and
+  // every process sorts them the same way.
+  std::stable_sort(groups.begin(), groups.end(),
+                   [](const Group &a, const Group &b) {
+                     return a.cost > b.cost;
+                   });
+
+  std::vector<size_t> shards(pairs.size());
+  std::vector<double> shard_costs(num_shards, 0.0);
+  for (const Group &group : groups) {
+    const size_t shard = std::min_element(shard_costs.begin(),
+        shard_costs.end()) - shard_costs.begin();
+    shard_costs[shard] += group.cost;
+    std::fill_n(shards.begin() + group.first_pair, group.num_pairs, shard);
+  }
+  return shards;
+}
+
+std::vector<ReferenceDegradedPathPair> BatchSharder::SelectShard(
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    size_t shard_index, size_t num_shards, size_t num_threads) {
+  if (num_shards <= 1) {
+    return pairs;
+  }
+  const std::vector<size_t> shards = AssignShards(pairs,
+      EstimatePairCosts(pairs, num_threads), num_shards);
+  std::vector<ReferenceDegradedPathPair> shard_pairs;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (shards[i] == shard_index) {
+      shard_pairs.push_back(pairs[i]);
+    }
+  }
+  return shard_pairs;
+}
+}  // namespace Visqol
@@ -15,6 +15,7 @@
 #include "commandline_parser.h"
 
 #include <fstream>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -24,8 +25,14 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
+#include "absl/memory/memory.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include "batch_sharder.h"
+#include "pair_source.h"
+#include "results_checkpoint.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+
 ABSL_FLAG(std::string, reference_file, "",
           "The wav file path used as the reference audio.");
 ABSL_FLAG(std::string, degraded_file, "",
@@ -39,6 +46,22 @@ ABSL_FLAG(std::string, batch_input_csv, "",
           "------------------\n"
           "If the `batch_input_csv` flag is used, the `reference_file` \n"
           "and `degraded_file` flags will be ignored.");
+ABSL_FLAG(bool, stream_batch_input, false,
+"Read the --batch_input_csv a line at a time as its pairs are compared,\n"
+"rather than reading it whole before the first comparison. The pairs are\n"
+"compared in the order of the file rather than longest first. Not\n"
+"compatible with --num_shards above 1 or --resume.");
+ABSL_FLAG(std::string, reference_dir, "",
+"A directory of reference files to compare with the files of the same name\n"
+"in --degraded_dir, instead of --batch_input_csv. The directories are\n"
+"listed as the pairs are compared, in the order that the file system lists\n"
+"them. Not compatible with --num_shards above 1, --resume or\n"
+"--training_data_output.");
+ABSL_FLAG(std::string, degraded_dir, "",
+"The directory of the degraded files of the --reference_dir.");
+ABSL_FLAG(std::string, file_pattern, "*.wav",
+"The pattern that the names of the files of the --reference_dir must match,\n"
+"in which * matches any run of characters and ? any one character.");
 ABSL_FLAG(std::string, results_csv, "",
 "Used to specify a path that the similarity score results will be output to \n"
 ". This will be a CSV file with the format:\n"
@@ -56,7 +79,7 @@ ABSL_FLAG(std::string, output_debug, "",
 ABSL_FLAG(std::string, similarity_to_quality_model, "",
 "The libsvm model to use during comparison. Use this only if you want to\n"
 "explicitly specify the model file location, otherwise the default model will\n"
-"be used.");
+"be used. The default audio model is compiled into ViSQOL.");
 ABSL_FLAG(bool, use_speech_mode, false,
 "Use a wideband model (sensitive up to 8kHz) with voice activity detection\n"
 "that normalizes the polynomial NSIM->MOS mapping so that a perfect NSIM\n"
@@ -65,6 +88,209 @@ ABSL_FLAG(bool, use_unscaled_speech_mos_mapping, false,
 "When used in conjunction with --use_speech_mode, this flag will prevent a\n"
 "perfect NSIM score of 1.0 being translated to a MOS score of 5.0. Perfect\n"
 "NSIM scores will instead result in MOS scores of ~4.x.");
+ABSL_FLAG(std::string, spectrogram_mode, "gammatone",
+"The method used to build the spectrograms that are compared. One of:\n"
+"  gammatone: filter each analysis window independently (default).\n"
+"  streaming_gammatone: filter the whole signal once with continuous filter\n"
+"    state. Roughly 4x cheaper. Shifts the MOS-LQO of the conformance set by\n"
+"    up to -1.69 (contrabassoon), most for bass heavy content. Intended for\n"
+"    bulk screening runs.\n"
+"  multirate_gammatone: filter each analysis window independently, with the\n"
+"    low frequency bands filtered at a reduced sample rate. Cheaper, and\n"
+"    within 0.001 MOS-LQO of gammatone on the conformance set.\n"
+"  erb_stft: project the FFT of each analysis window onto the ERB bands. An\n"
+"    order of magnitude cheaper, and within 0.1 MOS-LQO of gammatone on the\n"
+"    conformance set. Intended for triage of large collections.\n"
+"The conformance expectations of each mode are in src/include/conformance.h.");
+ABSL_FLAG(int, num_patch_workers, 1,
+"The number of threads that the patches of a single comparison are searched\n"
+"and realigned on. The scores do not depend on this value.");
+ABSL_FLAG(int, num_segment_workers, 1,
+"The number of threads that a comparison is processed on, in as many\n"
+"contiguous segments of its spectrogram columns. The patches are searched\n"
+"and realigned on at least as many threads. The scores do not depend on\n"
+"this value.");
+ABSL_FLAG(std::string, patch_search, "exhaustive",
+"The strategy used to search the degraded signal for the patch that best\n"
+"matches each reference patch. One of:\n"
+"  exhaustive: compare every offset within the search range (default).\n"
+"  coarse_to_fine: compare a strided subset of the offsets, then every\n"
+"    offset around the most similar of those. Cheaper, but may shift the\n"
+"    MOS-LQO.");
+ABSL_FLAG(double, realign_skip_similarity, 0.0,
+"The patches whose coarse NSIM is above this value are not finely realigned,\n"
+"which saves building their spectrograms again. 0 (the default) realigns\n"
+"every patch. For example, 0.98 skips most patches of high bitrate codecs.");
+ABSL_FLAG(bool, use_float_patch_search, false,
+"Search for the degraded patches that best match the reference patches in\n"
+"single precision. The selected patches are still compared in double\n"
+"precision, so the MOS-LQO only shifts where a different patch is selected.");
+
+ABSL_FLAG(std::string, global_alignment, "full_rate",
+"The method used to globally align the degraded signal to the reference. One\n"
+"of:\n"
+"  full_rate: cross correlate the signal envelopes at the native sample rate\n"
+"    (default).\n"
+"  multi_resolution: cross correlate decimated envelopes, then refine the lag\n"
+"    at finer resolutions. Much cheaper for long signals.\n"
+"  fingerprint: vote on the offset with landmarks of the band energies, then\n"
+"    refine it on an excerpt. Suits hour long recordings.");
+ABSL_FLAG(bool, use_bounded_patch_realignment, false,
+"Only search lags of up to half a patch when finely realigning each patch,\n"
+"which makes the realignment cheaper. The MOS-LQO only shifts for patches\n"
+"whose best lag overall is beyond half the patch.");
+ABSL_FLAG(double, global_lag_hint, 0.0,
+"The expected lag (in seconds) of the degraded signal, as reported in the\n"
+"global_lag field of a previous result. Only used with\n"
+"--global_lag_search_window.");
+ABSL_FLAG(double, global_lag_search_window, 0.0,
+"If above 0, the global alignment only searches the lags within this many\n"
+"seconds of --global_lag_hint. If the best lag is at the edge of the window,\n"
+"every lag is searched after all. 0 (the default) searches every lag.");
+ABSL_FLAG(bool, reuse_global_lag, false,
+"Use the lag applied to each degraded file as the lag hint of the next one,\n"
+"e.g. for a batch of encodes of the same reference by the same codec. The\n"
+"lag is only carried on between the pairs compared on the same thread.");
+ABSL_FLAG(int, num_threads, 1,
+"The number of threads that the pairs of a --batch_input_csv are compared\n"
+"on, each with its own copy of ViSQOL. The results are written in the order\n"
+"of the pairs, unless --unordered_results is set.");
+ABSL_FLAG(std::string, pin_threads, "none",
+"How the --num_threads workers of a batch are pinned to the CPUs of the NUMA\n"
+"nodes of the machine. The workers are placed on the nodes in turn, and each\n"
+"allocates the buffers of its comparisons on its own node. Only supported on\n"
+"Linux. One of:\n"
+"  none: leave the workers free to run on any CPU (default).\n"
+"  node: pin each worker to all of the CPUs of its node.\n"
+"  core: pin each worker to a single CPU of its node, which the threads of\n"
+"    its --num_patch_workers share.");
+ABSL_FLAG(bool, unordered_results, false,
+"Write the results of a --batch_input_csv as soon as each pair is compared,\n"
+"rather than in the order of the pairs.");
+ABSL_FLAG(int, num_shards, 1,
+"The number of shards that a --batch_input_csv is split into, so that the\n"
+"shards can be compared by separate processes. The pairs are split by the\n"
+"durations in the headers of their files, the same way in every process.");
+ABSL_FLAG(int, shard_index, 0,
+"The index of the shard of the --batch_input_csv to compare, from 0 to\n"
+"--num_shards - 1.");
+ABSL_FLAG(bool, resume, false,
+"Skip the pairs that already have a result in the --results_csv, such as\n"
+"when resuming a batch that was interrupted. New results are appended.");
+ABSL_FLAG(std::string, training_data_output, "",
+"A path prefix to write the FVNSIM and MOS-LQS of each pair of the\n"
+"--batch_input_csv to, as <prefix>_fvnsims.txt and <prefix>_moslqs.txt, for\n"
+"training an SVR model. The MOS-LQS of each pair is read from a third\n"
+"column of the --batch_input_csv.");
+ABSL_FLAG(std::string, results_proto, "",
+"A path to append the full result of each comparison to, as length-delimited\n"
+"binary SimilarityResultMsg records. This is much cheaper to write and parse\n"
+"than --output_debug for large batches. visqol_read_results prints the\n"
+"records of the file.");
+ABSL_FLAG(std::string, results_arrow, "",
+"A path to write the scores of each comparison to as an Apache Arrow IPC\n"
+"stream, with a row per pair and a column per score, FVNSIM band and, if\n"
+"recorded, stage timing. The file is replaced if it exists.");
+ABSL_FLAG(std::string, trace_output, "",
+"A path to write a trace of the comparisons to, in the Chrome trace format\n"
+"that chrome://tracing and Perfetto show. Each pair, each stage of its\n"
+"comparison and each file decode is an event on the thread that ran it.");
+ABSL_FLAG(std::string, metrics_output, "",
+"A path to write the metrics of the run to once it is done: the pairs by\n"
+"result code, the latency histograms of the pairs and their stages, the\n"
+"dropped patches and the reference cache lookups.");
+ABSL_FLAG(std::string, metrics_format, "text",
+"The format of the --metrics_output: 'text' or 'prometheus'.");
+ABSL_FLAG(int, num_prefetch_pairs, 0,
+"The number of upcoming pairs of a --batch_input_csv that are loaded on\n"
+"background threads while the current pair is compared. 0 (the default)\n"
+"loads each pair just before it is compared. Only used with a single\n"
+"thread.");
+ABSL_FLAG(int, reference_cache_size, 0,
+"The number of recently compared reference files of a --batch_input_csv\n"
+"that are kept in memory along with their spectrograms and patches, so that\n"
+"each is only loaded and analysed once. 0 (the default) keeps none.");
+ABSL_FLAG(std::string, ref_features_dir, "",
+"The directory that the features of reference files are saved in. Saved\n"
+"features are loaded rather than built again, unless they were built with\n"
+"other options or the reference file has since been modified.");
+ABSL_FLAG(bool, write_ref_features, false,
+"Save the features of the reference files that have none saved in the\n"
+"--ref_features_dir once they are built.");
+ABSL_FLAG(std::string, result_cache, "",
+"A file that the results are cached in, by the content of the decoded files\n"
+"and the options, model and version that they depend on. A pair that was\n"
+"compared before is only decoded, so reruns after a partial refresh of the\n"
+"data are almost free. The file is created if it does not exist.");
+ABSL_FLAG(bool, record_block_hashes, false,
+"Record a hash of each block of the degraded signal in the result of each\n"
+"pair, so that a later run can be given the results as --previous_results.\n"
+"Only pairs that are compared whole and in mono record them.");
+ABSL_FLAG(std::string, previous_results, "",
+"A --results_proto file of an earlier run with --record_block_hashes. A pair\n"
+"with an earlier result for the same files only compares the patches that\n"
+"read the parts of the degraded file that changed, and reuses the earlier\n"
+"results of the others. Reused patches keep their earlier level scaling.");
+ABSL_FLAG(double, timeline_window, 0.0,
+"If greater than 0, the duration (in sec) of the windows of a timeline of\n"
+"the MOS-LQO of each comparison, which is computed from the patches of the\n"
+"whole comparison. 0 (the default) gives no timeline.");
+ABSL_FLAG(int, max_patches, 0,
+"If greater than 0, the maximum number of reference patches that are\n"
+"compared, evenly spaced over the reference, to cap the cost of long files.\n"
+"0 (the default) compares every patch.");
+ABSL_FLAG(double, target_vnsim_stderr, 0.0,
+"If greater than 0, stop comparing the patches of a pair once the standard\n"
+"error of its VNSIM is below this target. 0 (the default) compares every\n"
+"patch.");
+ABSL_FLAG(bool, lazy_degraded_spectrogram, false,
+"Only build the columns of the degraded spectrogram that the patch search\n"
+"reads, which skips the silences without patches in speech mode.");
+ABSL_FLAG(double, silent_patch_threshold, 0.0,
+"If negative, the level in dB relative to the peak of the reference, such as\n"
+"-60, below which reference patches are not compared in audio mode. 0 (the\n"
+"default) compares every patch.");
+ABSL_FLAG(bool, multichannel, false,
+"Score each channel of the files on its own, concurrently, after aligning\n"
+"the files once by their downmix. The mean of the channels is reported.");
+ABSL_FLAG(bool, record_stage_timings, false,
+"Record the time spent in each stage of each comparison in its result. The\n"
+"stages are listed with --verbose.");
+ABSL_FLAG(bool, record_memory_usage, false,
+"Record the bytes and number of allocations of each comparison, and the peak\n"
+"RSS of the process by its end, in its result. They are listed with\n"
+"--verbose, and the largest of a batch is listed once the batch is done.");
+ABSL_FLAG(std::string, result_detail, "",
+"How much of the detail of each comparison is kept in its result: 'summary'\n"
+"for the scores, 'bands' for the FVNSIM of each band as well, or 'full' for\n"
+"the similarity of each patch as well. By default, 'full' if --verbose,\n"
+"--output_debug or --results_proto is set, as they output the patches,\n"
+"'bands' if --results_arrow or --training_data_output is set, and\n"
+"'summary' otherwise.");
+ABSL_FLAG(bool, detect_identical_signals, false,
+"Skip the comparison of a degraded file that matches its reference once\n"
+"aligned and scaled to the level of the reference, such as a pass-through\n"
+"transcode, and report the perfect similarity, flagged as identical.");
+ABSL_FLAG(double, identical_signal_tolerance, 0.0,
+"With --detect_identical_signals, the largest difference between a scaled\n"
+"degraded sample and its reference sample that still matches. 0 (the\n"
+"default) only matches equal samples.");
+ABSL_FLAG(std::string, compute_backend, "",
+"The compute backend that builds the gammatone spectrograms and compares the\n"
+"patches, such as 'cuda' for the visqol_cuda binary. By default, the CPU.");
+ABSL_FLAG(double, tile_duration, 0.0,
+"Compare pairs whose reference is longer than a tile in tiles of this many\n"
+"seconds, keeping only the results of their patches, so that files of\n"
+"any duration are compared in bounded memory. The tiles are at least 10\n"
+"seconds. The scores are close to, but not the same as, those of comparing\n"
+"the whole files. By default, files are compared whole.");
+ABSL_FLAG(int, max_memory_mb, 0,
+"The memory in megabytes that the comparison of a pair should stay within.\n"
+"Pairs that are estimated to need more are compared in tiles, as with\n"
+"--tile_duration. By default, there is no limit.");
+ABSL_FLAG(bool, resample_to_mode_rate, false,
+"Resample the input files to 48k for audio mode, or to 16k for speech mode\n"
+"files above 16k, as they are loaded.");
 
 namespace Visqol {
 ABSL_CONST_INIT const char kDefaultAudioModelFile[] =
@@ -91,7 +317,17 @@ google::protobuf::util::StatusOr<CommandLineArgs> VisqolCommandLineParser::Parse
   bool use_unscaled_mapping = false;
 
   batch_input = absl::GetFlag(FLAGS_batch_input_csv);
-  if (!batch_input.empty()) {
+  const std::string reference_dir = absl::GetFlag(FLAGS_reference_dir);
+  const std::string degraded_dir = absl::GetFlag(FLAGS_degraded_dir);
+  if (!reference_dir.empty() || !degraded_dir.empty()) {
+    if (!batch_input.empty()) {
+      ABSL_RAW_LOG(ERROR,
+                   "--reference_dir can not be used with --batch_input_csv.");
+      errorFound = true;
+    }
+    errorFound |= !FileExists(reference_dir);
+    errorFound |= !FileExists(degraded_dir);
+  } else if (!batch_input.empty()) {
       errorFound |= !FileExists(batch_input);
   } else {
       ref_file = absl::GetFlag(FLAGS_reference_file);
@@ -113,18 +349,239 @@ google::protobuf::util::StatusOr<CommandLineArgs> VisqolCommandLineParser::Parse
 
   debug_output = absl::GetFlag(FLAGS_output_debug);
 
+  auto spectrogram_mode = VisqolConfig::VisqolOptions::GAMMATONE;
+  const std::string spectrogram_mode_flag = absl::GetFlag(
+      FLAGS_spectrogram_mode);
+  if (spectrogram_mode_flag == "streaming_gammatone") {
+    spectrogram_mode = VisqolConfig::VisqolOptions::STREAMING_GAMMATONE;
+  } else if (spectrogram_mode_flag == "multirate_gammatone") {
+    spectrogram_mode = VisqolConfig::VisqolOptions::MULTIRATE_GAMMATONE;
+  } else if (spectrogram_mode_flag == "erb_stft") {
+    spectrogram_mode = VisqolConfig::VisqolOptions::ERB_STFT;
+  } else if (spectrogram_mode_flag != "gammatone") {
+    ABSL_RAW_LOG(ERROR, "Unknown spectrogram mode: %s",
+                 spectrogram_mode_flag.c_str());
+    errorFound = true;
+  }
+
+  const int num_patch_workers = absl::GetFlag(FLAGS_num_patch_workers);
+  if (num_patch_workers < 1) {
+    ABSL_RAW_LOG(ERROR, "The number of patch workers must be at least 1: %d",
+                 num_patch_workers);
+    errorFound = true;
+  }
+
+  const int num_segment_workers = absl::GetFlag(FLAGS_num_segment_workers);
+  if (num_segment_workers < 1) {
+    ABSL_RAW_LOG(ERROR, "The number of segment workers must be at least 1: %d",
+                 num_segment_workers);
+    errorFound = true;
+  }
+
+  auto thread_pinning = VisqolConfig::VisqolOptions::NO_PINNING;
+  const std::string pin_threads_flag = absl::GetFlag(FLAGS_pin_threads);
+  if (pin_threads_flag == "node") {
+    thread_pinning = VisqolConfig::VisqolOptions::PIN_TO_NODE;
+  } else if (pin_threads_flag == "core") {
+    thread_pinning = VisqolConfig::VisqolOptions::PIN_TO_CORE;
+  } else if (pin_threads_flag != "none") {
+    ABSL_RAW_LOG(ERROR, "Unknown thread pinning: %s",
+                 pin_threads_flag.c_str());
+    errorFound = true;
+  }
+
+  const int num_threads = absl::GetFlag(FLAGS_num_threads);
+  if (num_threads < 1) {
+    ABSL_RAW_LOG(ERROR, "The number of threads must be at least 1: %d",
+                 num_threads);
+    errorFound = true;
+  }
+
+  const int num_prefetch_pairs = absl::GetFlag(FLAGS_num_prefetch_pairs);
+  if (num_prefetch_pairs < 0) {
+    ABSL_RAW_LOG(ERROR, "The number of prefetch pairs must not be negative:"
+                 " %d", num_prefetch_pairs);
+    errorFound = true;
+  }
+
+  const int reference_cache_size = absl::GetFlag(FLAGS_reference_cache_size);
+  if (reference_cache_size < 0) {
+    ABSL_RAW_LOG(ERROR, "The reference cache size must not be negative: %d",
+                 reference_cache_size);
+    errorFound = true;
+  }
+
+  const std::string ref_features_dir = absl::GetFlag(FLAGS_ref_features_dir);
+  const bool write_ref_features = absl::GetFlag(FLAGS_write_ref_features);
+  if (write_ref_features && ref_features_dir.empty()) {
+    ABSL_RAW_LOG(ERROR, "--write_ref_features requires --ref_features_dir.");
+    errorFound = true;
+  }
+
+  const double timeline_window = absl::GetFlag(FLAGS_timeline_window);
+  if (timeline_window < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The timeline window must not be negative: %f",
+                 timeline_window);
+    errorFound = true;
+  }
+
+  const int max_patches = absl::GetFlag(FLAGS_max_patches);
+  if (max_patches < 0) {
+    ABSL_RAW_LOG(ERROR, "The maximum number of patches must not be negative:"
+                 " %d", max_patches);
+    errorFound = true;
+  }
+
+  const double target_vnsim_stderr =
+      absl::GetFlag(FLAGS_target_vnsim_stderr);
+  if (target_vnsim_stderr < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The target VNSIM standard error must not be"
+                 " negative: %f", target_vnsim_stderr);
+    errorFound = true;
+  }
+
+  const double silent_patch_threshold =
+      absl::GetFlag(FLAGS_silent_patch_threshold);
+  if (silent_patch_threshold > 0.0) {
+    ABSL_RAW_LOG(ERROR, "The silent patch threshold must not be positive: %f",
+                 silent_patch_threshold);
+    errorFound = true;
+  }
+
+  const double identical_signal_tolerance =
+      absl::GetFlag(FLAGS_identical_signal_tolerance);
+  if (identical_signal_tolerance < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The identical signal tolerance must not be"
+                 " negative: %f", identical_signal_tolerance);
+    errorFound = true;
+  }
+
+  const double tile_duration = absl::GetFlag(FLAGS_tile_duration);
+  if (tile_duration < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The tile duration must not be negative: %f",
+                 tile_duration);
+    errorFound = true;
+  }
+
+  const int max_memory_mb = absl::GetFlag(FLAGS_max_memory_mb);
+  if (max_memory_mb < 0) {
+    ABSL_RAW_LOG(ERROR, "The memory limit must not be negative: %d",
+                 max_memory_mb);
+    errorFound = true;
+  }
+
+  const int num_shards = absl::GetFlag(FLAGS_num_shards);
+  const int shard_index = absl::GetFlag(FLAGS_shard_index);
+  if (num_shards < 1) {
+    ABSL_RAW_LOG(ERROR, "The number of shards must be at least 1: %d",
+                 num_shards);
+    errorFound = true;
+  } else if (shard_index < 0 || shard_index >= num_shards) {
+    ABSL_RAW_LOG(ERROR, "The shard index must be from 0 to %d: %d",
+                 num_shards - 1, shard_index);
+    errorFound = true;
+  }
+
+  const bool resume = absl::GetFlag(FLAGS_resume);
+  if (resume && result_output_csv.empty()) {
+    ABSL_RAW_LOG(ERROR, "--resume requires --results_csv.");
+    errorFound = true;
+  }
+
+  // The pairs of a streamed batch are compared as they are discovered, so
+  // the batch can not be split into shards or checked for results up front.
+  const bool stream_batch_input = absl::GetFlag(FLAGS_stream_batch_input);
+  if ((stream_batch_input || !reference_dir.empty()) &&
+      (num_shards > 1 || resume)) {
+    ABSL_RAW_LOG(ERROR, "A streamed batch can not be used with --num_shards"
+                 " above 1 or --resume.");
+    errorFound = true;
+  }
+
+  const std::string metrics_format = absl::GetFlag(FLAGS_metrics_format);
+  if (metrics_format != "text" && metrics_format != "prometheus") {
+    ABSL_RAW_LOG(ERROR, "--metrics_format must be 'text' or 'prometheus': %s",
+                 metrics_format.c_str());
+    errorFound = true;
+  }
+
+  const std::string training_data_output = absl::GetFlag(
+      FLAGS_training_data_output);
+  if (!training_data_output.empty() && batch_input.empty()) {
+    ABSL_RAW_LOG(ERROR, "--training_data_output requires --batch_input_csv.");
+    errorFound = true;
+  }
+
+  auto patch_search = VisqolConfig::VisqolOptions::EXHAUSTIVE;
+  const std::string patch_search_flag = absl::GetFlag(FLAGS_patch_search);
+  if (patch_search_flag == "coarse_to_fine") {
+    patch_search = VisqolConfig::VisqolOptions::COARSE_TO_FINE;
+  } else if (patch_search_flag != "exhaustive") {
+    ABSL_RAW_LOG(ERROR, "Unknown patch search strategy: %s",
+                 patch_search_flag.c_str());
+    errorFound = true;
+  }
+
+  const double realign_skip_similarity = absl::GetFlag(
+      FLAGS_realign_skip_similarity);
+  if (realign_skip_similarity < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The realign skip similarity must not be negative: %f",
+                 realign_skip_similarity);
+    errorFound = true;
+  }
+
+  const std::string previous_results = absl::GetFlag(FLAGS_previous_results);
+  if (!previous_results.empty()) {
+    errorFound |= !FileExists(FilePath(previous_results));
+  }
+
+  auto global_alignment = VisqolConfig::VisqolOptions::FULL_RATE;
+  const std::string global_alignment_flag = absl::GetFlag(
+      FLAGS_global_alignment);
+  if (global_alignment_flag == "multi_resolution") {
+    global_alignment = VisqolConfig::VisqolOptions::MULTI_RESOLUTION;
+  } else if (global_alignment_flag == "fingerprint") {
+    global_alignment = VisqolConfig::VisqolOptions::FINGERPRINT;
+  } else if (global_alignment_flag != "full_rate") {
+    ABSL_RAW_LOG(ERROR, "Unknown global alignment method: %s",
+                 global_alignment_flag.c_str());
+    errorFound = true;
+  }
+
+  const double global_lag_search_window = absl::GetFlag(
+      FLAGS_global_lag_search_window);
+  if (global_lag_search_window < 0.0) {
+    ABSL_RAW_LOG(ERROR, "The global lag search window must not be negative: %f",
+                 global_lag_search_window);
+    errorFound = true;
+  }
+
+  const std::string results_proto = absl::GetFlag(FLAGS_results_proto);
+  const std::string results_arrow = absl::GetFlag(FLAGS_results_arrow);
+  auto result_detail = VisqolConfig::VisqolOptions::SUMMARY;
+  const std::string result_detail_flag = absl::GetFlag(FLAGS_result_detail);
+  if (result_detail_flag == "full" || (result_detail_flag.empty() &&
+      (verbose || !debug_output.empty() || !results_proto.empty()))) {
+    result_detail = VisqolConfig::VisqolOptions::FULL;
+  } else if (result_detail_flag == "bands" || (result_detail_flag.empty() &&
+      (!results_arrow.empty() || !training_data_output.empty()))) {
+    result_detail = VisqolConfig::VisqolOptions::BANDS;
+  } else if (!result_detail_flag.empty() && result_detail_flag != "summary") {
+    ABSL_RAW_LOG(ERROR, "Unknown result detail: %s",
+                 result_detail_flag.c_str());
+    errorFound = true;
+  }
+
   if (errorFound) {
     return google::protobuf::util::Status(
         google::protobuf::util::error::Code::INVALID_ARGUMENT,
         "Invalid command line arg detected. Run with --helpfull for usage.");
   }
-  if (sim_to_qual_model.empty()) {
-    if (use_speech) {
-      sim_to_qual_model = FilePath::currentWorkingDir() + kDefaultSpeechModelFile;
-    } else {
-      sim_to_qual_model = FilePath::currentWorkingDir() + kDefaultAudioModelFile;
-    }
-    if (!sim_to_qual_model.empty() && !FileExists(sim_to_qual_model)) {
+  // The default audio model is compiled into the library, and is used when
+  // the model path is left empty.
+  if (sim_to_qual_model.empty() && use_speech) {
+    sim_to_qual_model = FilePath::currentWorkingDir() + kDefaultSpeechModelFile;
+    if (!FileExists(sim_to_qual_model)) {
       return google::protobuf::util::Status(
           google::protobuf::util::error::Code::INVALID_ARGUMENT,
           "Failed to load the default SVR model " + sim_to_qual_model + ". "
@@ -135,6 +592,63 @@ google::protobuf::util::StatusOr<CommandLineArgs> VisqolCommandLineParser::Parse
   auto cmd_line_results = CommandLineArgs{ref_file, deg_file, sim_to_qual_model,
       result_output_csv, batch_input, verbose, debug_output, use_speech,
       use_unscaled_mapping};
+  cmd_line_results.spectrogram_mode = spectrogram_mode;
+  cmd_line_results.num_patch_workers = num_patch_workers;
+  cmd_line_results.num_segment_workers = num_segment_workers;
+  cmd_line_results.patch_search = patch_search;
+  cmd_line_results.realign_skip_similarity = realign_skip_similarity;
+  cmd_line_results.use_float_patch_search = absl::GetFlag(
+      FLAGS_use_float_patch_search);
+  cmd_line_results.global_alignment = global_alignment;
+  cmd_line_results.use_bounded_patch_realignment = absl::GetFlag(
+      FLAGS_use_bounded_patch_realignment);
+  cmd_line_results.global_lag_hint = absl::GetFlag(FLAGS_global_lag_hint);
+  cmd_line_results.global_lag_search_window = global_lag_search_window;
+  cmd_line_results.reuse_global_lag = absl::GetFlag(FLAGS_reuse_global_lag);
+  cmd_line_results.resample_to_mode_rate = absl::GetFlag(
+      FLAGS_resample_to_mode_rate);
+  cmd_line_results.num_prefetch_pairs = num_prefetch_pairs;
+  cmd_line_results.num_threads = num_threads;
+  cmd_line_results.thread_pinning = thread_pinning;
+  cmd_line_results.reference_cache_size = reference_cache_size;
+  cmd_line_results.ref_features_dir = ref_features_dir;
+  cmd_line_results.result_cache_path = absl::GetFlag(FLAGS_result_cache);
+  cmd_line_results.record_block_hashes =
+      absl::GetFlag(FLAGS_record_block_hashes);
+  cmd_line_results.previous_results_path = previous_results;
+  cmd_line_results.write_ref_features = write_ref_features;
+  cmd_line_results.timeline_window = timeline_window;
+  cmd_line_results.max_patches = max_patches;
+  cmd_line_results.target_vnsim_stderr = target_vnsim_stderr;
+  cmd_line_results.lazy_degraded_spectrogram =
+      absl::GetFlag(FLAGS_lazy_degraded_spectrogram);
+  cmd_line_results.silent_patch_threshold = silent_patch_threshold;
+  cmd_line_results.multichannel = absl::GetFlag(FLAGS_multichannel);
+  cmd_line_results.record_stage_timings =
+      absl::GetFlag(FLAGS_record_stage_timings);
+  cmd_line_results.record_memory_usage =
+      absl::GetFlag(FLAGS_record_memory_usage);
+  cmd_line_results.detect_identical_signals =
+      absl::GetFlag(FLAGS_detect_identical_signals);
+  cmd_line_results.identical_signal_tolerance = identical_signal_tolerance;
+  cmd_line_results.compute_backend = absl::GetFlag(FLAGS_compute_backend);
+  cmd_line_results.tile_duration = tile_duration;
+  cmd_line_results.max_memory_mb = max_memory_mb;
+  cmd_line_results.unordered_results = absl::GetFlag(FLAGS_unordered_results);
+  cmd_line_results.num_shards = num_shards;
+  cmd_line_results.shard_index = shard_index;
+  cmd_line_results.resume = resume;
+  cmd_line_results.stream_batch_input = stream_batch_input;
+  cmd_line_results.reference_dir = reference_dir;
+  cmd_line_results.degraded_dir = degraded_dir;
+  cmd_line_results.file_pattern = absl::GetFlag(FLAGS_file_pattern);
+  cmd_line_results.training_data_output = training_data_output;
+  cmd_line_results.result_detail = result_detail;
+  cmd_line_results.results_proto = results_proto;
+  cmd_line_results.results_arrow = results_arrow;
+  cmd_line_results.trace_output = absl::GetFlag(FLAGS_trace_output);
+  cmd_line_results.metrics_output = absl::GetFlag(FLAGS_metrics_output);
+  cmd_line_results.prometheus_metrics = metrics_format == "prometheus";
   return cmd_line_results;
 }
 
@@ -183,12 +697,75 @@ VisqolCommandLineParser::BuildFilePairPaths(
     const CommandLineArgs &cmd_res) {
   std::vector<ReferenceDegradedPathPair> pairs;
   if (cmd_res.batch_input_csv.Path() != "") {
-    pairs = ReadFilesToCompare(cmd_res.batch_input_csv.Path());
+    pairs = BatchSharder::SelectShard(
+        ReadFilesToCompare(cmd_res.batch_input_csv.Path()),
+        cmd_res.shard_index, cmd_res.num_shards, cmd_res.num_threads);
   } else if (cmd_res.reference_signal_path.Exists() &&
              cmd_res.degraded_signal_path.Exists()) {
     pairs.push_back({cmd_res.reference_signal_path,
                      cmd_res.degraded_signal_path});
   }
+  if (cmd_res.resume) {
+    pairs = ResultsCheckpoint::RemoveScoredPairs(pairs,
+                                                 cmd_res.results_output_csv);
+  }
   return pairs;
 }
+
+std::unique_ptr<PairSource> VisqolCommandLineParser::BuildPairSource(
+    const CommandLineArgs &cmd_res) {
+  if (!cmd_res.reference_dir.Path().empty()) {
+    return absl::make_unique<DirectoryPairSource>(cmd_res.reference_dir,
+        cmd_res.degraded_dir, cmd_res.file_pattern);
+  }
+  if (cmd_res.stream_batch_input && !cmd_res.batch_input_csv.Path().empty()) {
+    return absl::make_unique<ManifestPairSource>(cmd_res.batch_input_csv);
+  }
+  return nullptr;
+}
+
+VisqolConfig::VisqolOptions VisqolCommandLineParser::BuildVisqolOptions(
+    const CommandLineArgs &cmd_res) {
+  VisqolConfig::VisqolOptions options;
+  options.set_svr_model_path(cmd_res.sim_to_quality_mapper_model.Path());
+  options.set_use_speech_scoring(cmd_res.use_speech_mode);
+  options.set_use_unscaled_speech_mos_mapping(
+      cmd_res.use_unscaled_speech_mos_mapping);
+  options.set_spectrogram_mode(cmd_res.spectrogram_mode);
+  options.set_num_patch_workers(cmd_res.num_patch_workers);
+  options.set_num_segment_workers(cmd_res.num_segment_workers);
+  options.set_thread_pinning(cmd_res.thread_pinning);
+  options.set_patch_search(cmd_res.patch_search);
+  options.set_realign_skip_similarity(cmd_res.realign_skip_similarity);
+  options.set_use_float_patch_search(cmd_res.use_float_patch_search);
+  options.set_global_alignment(cmd_res.global_alignment);
+  options.set_use_bounded_patch_realignment(
+      cmd_res.use_bounded_patch_realignment);
+  options.set_global_lag_hint(cmd_res.global_lag_hint);
+  options.set_global_lag_search_window(cmd_res.global_lag_search_window);
+  options.set_reuse_global_lag(cmd_res.reuse_global_lag);
+  options.set_resample_to_mode_rate(cmd_res.resample_to_mode_rate);
+  options.set_num_prefetch_pairs(cmd_res.num_prefetch_pairs);
+  options.set_reference_cache_size(cmd_res.reference_cache_size);
+  options.set_ref_features_dir(cmd_res.ref_features_dir);
+  options.set_result_cache_path(cmd_res.result_cache_path);
+  options.set_record_block_hashes(cmd_res.record_block_hashes);
+  options.set_previous_results_path(cmd_res.previous_results_path);
+  options.set_write_ref_features(cmd_res.write_ref_features);
+  options.set_timeline_window(cmd_res.timeline_window);
+  options.set_max_patches(cmd_res.max_patches);
+  options.set_target_vnsim_stderr(cmd_res.target_vnsim_stderr);
+  options.set_lazy_degraded_spectrogram(cmd_res.lazy_degraded_spectrogram);
+  options.set_silent_patch_threshold(cmd_res.silent_patch_threshold);
+  options.set_multichannel(cmd_res.multichannel);
+  options.set_record_stage_timings(cmd_res.record_stage_timings);
+  options.set_record_memory_usage(cmd_res.record_memory_usage);
+  options.set_result_detail(cmd_res.result_detail);
+  options.set_detect_identical_signals(cmd_res.detect_identical_signals);
+  options.set_identical_signal_tolerance(cmd_res.identical_signal_tolerance);
+  options.set_compute_backend(cmd_res.compute_backend);
+  options.set_tile_duration(cmd_res.tile_duration);
+  options.set_max_memory_mb(cmd_res.max_memory_mb);
+  return options;
+}
 }  // namespace Visqol
@@ -16,8 +16,11 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -28,48 +31,146 @@
 #include "alignment.h"
 #include "amatrix.h"
 #include "audio_signal.h"
+#include "audio_signal_view.h"
 #include "image_patch_creator.h"
+#include "metrics.h"
 #include "misc_audio.h"
+#include "parallel_executor.h"
+#include "patch_view.h"
 #include "patch_similarity_comparator.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
+const int ComparisonPatchesSelector::kCoarseSearchStride = 4;
+const size_t ComparisonPatchesSelector::kNumRefinedCandidates = 2;
+
 ComparisonPatchesSelector::ComparisonPatchesSelector(
-    std::unique_ptr<PatchSimilarityComparator> sim_comparator)
-    : sim_comparator_{std::move(sim_comparator)} {}
+    std::unique_ptr<PatchSimilarityComparator> sim_comparator,
+    size_t num_workers, SearchStrategy search_strategy,
+    double realign_skip_similarity, bool use_bounded_realignment)
+    : sim_comparator_{std::move(sim_comparator)}, num_workers_{num_workers},
+      search_strategy_{search_strategy},
+      realign_skip_similarity_{realign_skip_similarity},
+      use_bounded_realignment_{use_bounded_realignment} {}
+
+std::vector<PatchSimilarityResult> ComparisonPatchesSelector::MeasureOffsets(
+    const AMatrix<double>& spectrogram_data,
+    const SlidingPatchComparator* sliding_comparator,
+    const PatchView& ref_patch, const std::vector<int>& offsets,
+    VisqolWorkspace* workspace) const {
+  if (sliding_comparator != nullptr) {
+    return sliding_comparator->MeasurePatchSimilarityAtOffsets(ref_patch,
+                                                               offsets,
+                                                               workspace);
+  }
+  std::vector<PatchView> deg_patches;
+  deg_patches.reserve(offsets.size());
+  for (const int slide_offset : offsets) {
+    deg_patches.emplace_back(spectrogram_data, slide_offset,
+                             ref_patch.NumCols());
+  }
+  return sim_comparator_->MeasurePatchSimilarities(ref_patch, deg_patches);
+}
 
 PatchSimilarityResult ComparisonPatchesSelector::FindMostSimilarDegPatch(
-    const AMatrix<double>& spectrogram_data, const ImagePatch& ref_patch,
-    int ref_frame_index, const double frame_duration) const {
-  ImagePatch deg_patch;
-  PatchSimilarityResult sim_result;
+    const AMatrix<double>& spectrogram_data,
+    const SlidingPatchComparator* sliding_comparator,
+    const PatchView& ref_patch, int ref_frame_index,
+    const double frame_duration, VisqolWorkspace* workspace) const {
   PatchSimilarityResult best_sim_result;
   int best_slide_offset = 0;
   const int num_frames_per_patch = ref_patch.NumCols();
   const double patch_duration = frame_duration * num_frames_per_patch;
   double highest_sim = std::numeric_limits<double>::lowest();
 
-  // For each possible index in the given range, build a degraded patch and
-  // check it for similarity to the given reference patch.
-
   // The ref_frame_index means ref patch minus half a patch, and the end index
-  // if ref patch + half.  This means we may need to add silence.
-  for (int slide_offset = ref_frame_index - (num_frames_per_patch / 2);
-       slide_offset <= ref_frame_index + (num_frames_per_patch / 2);
-       slide_offset++) {
-    if (slide_offset > (int)spectrogram_data.NumCols() - 1) {
-      // The start of the degraded is past the end of the spectrogram, so
-      // nothing left to compare.
-      break;
+  // if ref patch + half.  This means we may need to add silence. A degraded
+  // patch that starts past the end of the spectrogram has nothing left to
+  // compare.
+  const int first_offset = ref_frame_index - (num_frames_per_patch / 2);
+  const int last_offset = std::min(ref_frame_index + (num_frames_per_patch / 2),
+      (int)spectrogram_data.NumCols() - 1);
+
+  // For each possible index in the given range, compare the degraded patch
+  // to the given reference patch. The degraded patches are views of the
+  // spectrogram, which are silent where they extend past either end of it.
+  std::vector<int> offsets;
+  std::vector<PatchSimilarityResult> sim_results;
+  if (search_strategy_ == SearchStrategy::kCoarseToFine &&
+      last_offset - first_offset >= kCoarseSearchStride) {
+    // Score every kCoarseSearchStride offsets, including the last one.
+    for (int slide_offset = first_offset; slide_offset <= last_offset;
+         slide_offset += kCoarseSearchStride) {
+      offsets.push_back(slide_offset);
+    }
+    if (offsets.back() != last_offset) {
+      offsets.push_back(last_offset);
+    }
+    sim_results = MeasureOffsets(spectrogram_data, sliding_comparator,
+                                 ref_patch, offsets, workspace);
+
+    // Rank the coarse offsets, preferring the earlier offset on a tie as the
+    // exhaustive search does.
+    std::vector<size_t> ranking(offsets.size());
+    for (size_t i = 0; i < ranking.size(); i++) {
+      ranking[i] = i;
+    }
+    const size_t num_candidates = std::min(kNumRefinedCandidates,
+                                           ranking.size());
+    std::partial_sort(ranking.begin(), ranking.begin() + num_candidates,
+        ranking.end(), [&](size_t a, size_t b) {
+          return sim_results[a].similarity > sim_results[b].similarity ||
+              (sim_results[a].similarity == sim_results[b].similarity &&
+               a < b);
+        });
+
+    // Refine the neighbourhood of each candidate, up to the neighbouring
+    // coarse offsets, skipping the offsets that have already been scored.
+    const size_t search_size = last_offset - first_offset + 1;
+    std::vector<bool> is_coarse(search_size, false);
+    std::vector<bool> is_refined(search_size, false);
+    for (const int slide_offset : offsets) {
+      is_coarse[slide_offset - first_offset] = true;
+    }
+    for (size_t i = 0; i < num_candidates; i++) {
+      const int candidate = offsets[ranking[i]];
+      const int refine_begin = std::max(candidate - kCoarseSearchStride + 1,
+                                        first_offset);
+      const int refine_end = std::min(candidate + kCoarseSearchStride - 1,
+                                      last_offset);
+      for (int slide_offset = refine_begin; slide_offset <= refine_end;
+           slide_offset++) {
+        is_refined[slide_offset - first_offset] = true;
+      }
     }
-    deg_patch = BuildDegradedPatch(spectrogram_data, slide_offset,
-        slide_offset + ref_patch.NumCols() - 1, ref_patch.NumRows(),
-        ref_patch.NumCols());
-    sim_result = sim_comparator_->MeasurePatchSimilarity(ref_patch, deg_patch);
-
-    if (sim_result.similarity > highest_sim) {
-      highest_sim = sim_result.similarity;
-      best_sim_result = sim_result;
-      best_slide_offset = slide_offset;
+    std::vector<int> fine_offsets;
+    for (size_t i = 0; i < search_size; i++) {
+      if (is_refined[i] && !is_coarse[i]) {
+        fine_offsets.push_back(first_offset + i);
+      }
+    }
+    std::vector<PatchSimilarityResult> fine_results = MeasureOffsets(
+        spectrogram_data, sliding_comparator, ref_patch, fine_offsets,
+        workspace);
+    offsets.insert(offsets.end(), fine_offsets.begin(), fine_offsets.end());
+    std::move(fine_results.begin(), fine_results.end(),
+              std::back_inserter(sim_results));
+  } else {
+    for (int slide_offset = first_offset; slide_offset <= last_offset;
+         slide_offset++) {
+      offsets.push_back(slide_offset);
+    }
+    sim_results = MeasureOffsets(spectrogram_data, sliding_comparator,
+                                 ref_patch, offsets, workspace);
+  }
+
+  for (size_t i = 0; i < sim_results.size(); i++) {
+    if (sim_results[i].similarity > highest_sim ||
+        (sim_results[i].similarity == highest_sim &&
+         offsets[i] < best_slide_offset)) {
+      highest_sim = sim_results[i].similarity;
+      best_sim_result = std::move(sim_results[i]);
+      best_slide_offset = offsets[i];
     }
   }
 
@@ -83,10 +184,10 @@ PatchSimilarityResult ComparisonPatchesSelector::FindMostSimilarDegPatch(
 
 google::protobuf::util::StatusOr<std::vector<PatchSimilarityResult>>
 ComparisonPatchesSelector::FindMostSimilarDegPatches(
-    const std::vector<ImagePatch>& ref_patches,
+    const std::vector<PatchView>& ref_patches,
     const std::vector<size_t>& ref_patch_indices,
     const AMatrix<double>& spectrogram_data,
-    const double frame_duration) const {
+    const double frame_duration, VisqolWorkspace* workspace) const {
   const size_t num_frames_per_patch = ref_patches[0].NumCols();
   const size_t num_frames_in_deg_spectro = spectrogram_data.NumCols();
   const double patch_duration = frame_duration * num_frames_per_patch;
@@ -104,17 +205,29 @@ ComparisonPatchesSelector::FindMostSimilarDegPatches(
         "due to the degraded file being misaligned or too short. If too many "
         "patches are dropped, the score will be less meaningful.",
         ref_patch_indices.size() - num_patches, ref_patch_indices.size());
+    Metrics::ReportDroppedPatches(ref_patch_indices.size() - num_patches);
   }
 
   std::vector<PatchSimilarityResult> bestDegPatches(num_patches);
 
-  // Attempt to get a good alignment without backtracking.
-  for (size_t patch_index = 0; patch_index < num_patches; patch_index++) {
+  // The statistics of the degraded spectrogram are shared by the searches for
+  // all of the reference patches.
+  const std::unique_ptr<SlidingPatchComparator> sliding_comparator =
+      sim_comparator_->CreateSlidingComparator(spectrogram_data,
+                                               num_frames_per_patch);
+
+  // Attempt to get a good alignment without backtracking. Each patch only
+  // reads the shared inputs and writes its own result, so the patches are
+  // searched concurrently.
+  ParallelExecutor::ForEach(num_patches, num_workers_,
+                            [&](size_t patch_index) {
     // Find the best alignment to the ref patch within 1 patch length of the
     // hard-aligned deg signal.
     bestDegPatches[patch_index] =
-        FindMostSimilarDegPatch(spectrogram_data, ref_patches[patch_index],
-                                ref_patch_indices[patch_index], frame_duration);
+        FindMostSimilarDegPatch(spectrogram_data, sliding_comparator.get(),
+                                ref_patches[patch_index],
+                                ref_patch_indices[patch_index], frame_duration,
+                                workspace);
 
     // Set the reference patch start and end time.
     bestDegPatches[patch_index].ref_patch_start_time =
@@ -122,7 +235,7 @@ ComparisonPatchesSelector::FindMostSimilarDegPatches(
 
     bestDegPatches[patch_index].ref_patch_end_time =
         bestDegPatches[patch_index].ref_patch_start_time + patch_duration;
-  }
+  });
   return bestDegPatches;
 }
 
@@ -142,56 +255,43 @@ size_t ComparisonPatchesSelector::CalcMaxNumPatches(
   return num_patches;
 }
 
-ImagePatch ComparisonPatchesSelector::BuildDegradedPatch(
-    const AMatrix<double>& spectrogram_data, int window_beginning,
-    size_t window_end, size_t window_height, size_t window_width) const {
-  ImagePatch deg_patch{window_height, window_width};
-  std::vector<double> row;
-
-  // We should allow negative starts to allow the degraded signal to come first.
-  // Each row is a frequency band.
-
-  int first_real_frame = std::max(0, window_beginning);
-  // This is an inclusive end, so subtract 1.
-  int last_real_frame =  std::min(window_end, spectrogram_data.NumCols() - 1);
-  for (size_t rowIndex = 0; rowIndex < spectrogram_data.NumRows(); rowIndex++) {
-    row = spectrogram_data.RowSubset(rowIndex, first_real_frame,
-                                     last_real_frame);
-
-    // Insert silence at front for negative indices.
-    if (window_beginning < 0) {
-      row.insert(row.begin(), 0 - window_beginning, 0.0);
-    }
-
-    if (window_end > spectrogram_data.NumCols() - 1) {
-      row.insert(row.end(), window_end - (spectrogram_data.NumCols() - 1), 0.0);
-    }
-
-    deg_patch.SetRow(rowIndex, std::move(row));
-  }
-  return deg_patch;
-}
-
-AudioSignal ComparisonPatchesSelector::Slice(
+AudioSignalView ComparisonPatchesSelector::Slice(
     const AudioSignal &in_signal, double start_time, double end_time)
 {
   int start_index = std::max(0, (int)(start_time * in_signal.sample_rate));
-  // The end_index is inclusive for GetRows().
+  // The slice ends before end_index.
   int end_index = std::min((int)(in_signal.data_matrix.NumRows() - 1),
                            (int)(end_time * in_signal.sample_rate));
+  const size_t num_sliced = std::max(0, end_index - start_index);
 
-  // Note that the underlying armadillo rows() uses an unconventional inclusive
-  // end index.
-  auto sliced_matrix = in_signal.data_matrix.GetRows(
-       start_index, end_index - 1);
+  // A negative start time is expressed as leading silence before the first
+  // sample of the signal.
+  size_t num_presilence = 0;
   if (start_time < 0) {
-    auto presilence_matrix = AMatrix<double>::Filled(-1 * start_time *
-                                                     in_signal.sample_rate,
-                                                     1, 0.0);
-    sliced_matrix = presilence_matrix.JoinVertically(sliced_matrix);
+    num_presilence = -1 * start_time * in_signal.sample_rate;
+  }
+  const AudioSignalView sliced_signal(in_signal, start_index, num_sliced);
+  return sliced_signal.SubView(-static_cast<int64_t>(num_presilence),
+                               num_presilence + num_sliced);
+}
+
+SpectrogramColumnRanges ComparisonPatchesSelector::SearchedColumns(
+    const std::vector<size_t> &ref_patch_indices,
+    size_t num_frames_per_patch) {
+  // Each degraded patch starts within half a patch of its reference patch,
+  // and is a patch long. Overlapping ranges are merged.
+  SpectrogramColumnRanges columns;
+  const size_t half_patch = num_frames_per_patch / 2;
+  for (const size_t index : ref_patch_indices) {
+    const size_t first_col = index > half_patch ? index - half_patch : 0;
+    const size_t end_col = index + half_patch + num_frames_per_patch;
+    if (!columns.empty() && first_col <= columns.back().second) {
+      columns.back().second = std::max(columns.back().second, end_col);
+    } else {
+      columns.emplace_back(first_col, end_col);
+    }
   }
-  AudioSignal sliced_signal{sliced_matrix, in_signal.sample_rate};
-  return sliced_signal;
+  return columns;
 }
 
 google::protobuf::util::StatusOr<std::vector<PatchSimilarityResult>>
@@ -199,77 +299,137 @@ ComparisonPatchesSelector::FinelyAlignAndRecreatePatches(
     const std::vector<PatchSimilarityResult>& sim_results,
     const AudioSignal &ref_signal,
     const AudioSignal &deg_signal,
-    SpectrogramBuilder *spect_builder,
-    const AnalysisWindow &window) const {
+    const SpectrogramBuilder *spect_builder,
+    const AnalysisWindow &window,
+    size_t *num_skipped,
+    VisqolWorkspace *workspace) const {
   std::vector<PatchSimilarityResult> realigned_results(sim_results.size());
-
-  // The patches are already matched.  Iterate over each pair.
-  for (size_t i = 0; i < sim_results.size(); ++i) {
-    auto sim_result = sim_results[i];
-    // 1. The sim results keep track of the start and end points of each matched
-    // pair.  Extract the audio for this segment.
-    auto ref_patch_audio = Slice(ref_signal, sim_result.ref_patch_start_time,
-                                 sim_result.ref_patch_end_time);
-    auto deg_patch_audio = Slice(deg_signal, sim_result.deg_patch_start_time,
-                                 sim_result.deg_patch_end_time);
-    // 2. For any pair, we want to shift the degraded signal to be maximally
-    // aligned.
-    auto aligned_result = Alignment::AlignAndTruncate(ref_patch_audio,
-                                                      deg_patch_audio);
-    AudioSignal ref_audio_aligned = std::get<0>(aligned_result);
-    AudioSignal deg_audio_aligned = std::get<1>(aligned_result);
-    double lag = std::get<2>(aligned_result);
-
-    double new_ref_duration = ref_audio_aligned.GetDuration();
-    double new_deg_duration = deg_audio_aligned.GetDuration();
-    // 3. Compute a new spectrogram for the degraded audio.
-    const auto ref_spectro_result = spect_builder->Build(ref_audio_aligned,
-                                                         window);
-    if (!ref_spectro_result.ok()) {
-      ABSL_RAW_LOG(ERROR, "Error building ref spectrogram: %s",
-                   ref_spectro_result.status().ToString().c_str());
-      return ref_spectro_result.status();
-    }
-    Spectrogram ref_spectrogram = ref_spectro_result.ValueOrDie();
-
-    const auto deg_spectro_result = spect_builder->Build(deg_audio_aligned,
-                                                         window);
-    if (!deg_spectro_result.ok()) {
-      ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
-                   deg_spectro_result.status().ToString().c_str());
-      return deg_spectro_result.status();
+  std::vector<google::protobuf::util::Status> statuses(sim_results.size());
+
+  // The realignment only ever keeps a better match, so a coarse match that is
+  // already close to perfect is kept as it is.
+  std::vector<size_t> to_realign;
+  for (size_t i = 0; i < sim_results.size(); i++) {
+    if (realign_skip_similarity_ > 0.0 &&
+        sim_results[i].similarity > realign_skip_similarity_) {
+      realigned_results[i] = sim_results[i];
+    } else {
+      to_realign.push_back(i);
     }
-    Spectrogram deg_spectrogram = deg_spectro_result.ValueOrDie();
-
-    MiscAudio::PrepareSpectrogramsForComparison(ref_spectrogram,
-                                                deg_spectrogram);
-    // 4. Recreate an aligned degraded patch from the new spectrogram.
-    auto new_ref_patch = ref_spectrogram.Data();
-
-    auto new_deg_patch = deg_spectrogram.Data();
-    // 5. Update the similarity result with the new patch.
-    auto new_sim_result = sim_comparator_->MeasurePatchSimilarity(
-        new_ref_patch, new_deg_patch);
-    // Compare to the old result and take the max.
-    if (new_sim_result.similarity < sim_result.similarity) {
-      realigned_results[i] = sim_result;
+  }
+  if (num_skipped != nullptr) {
+    *num_skipped = sim_results.size() - to_realign.size();
+  }
+
+  // 1. The sim results keep track of the start and end points of each matched
+  // pair.  Extract the audio for each pair.
+  std::vector<std::pair<AudioSignalView, AudioSignalView>> patch_audio;
+  patch_audio.reserve(to_realign.size());
+  for (size_t i : to_realign) {
+    patch_audio.emplace_back(
+        Slice(ref_signal, sim_results[i].ref_patch_start_time,
+              sim_results[i].ref_patch_end_time),
+        Slice(deg_signal, sim_results[i].deg_patch_start_time,
+              sim_results[i].deg_patch_end_time));
+  }
+  // 2. For any pair, we want to shift the degraded signal to be maximally
+  // aligned. All of the pairs are aligned as one batch, which shares the FFT
+  // setup and buffers between the pairs. The slices and the aligned signals
+  // are views of the input signals, so no samples are copied until the
+  // spectrograms are built.
+  const auto aligned_results = Alignment::AlignAndTruncateBatch(
+      patch_audio, use_bounded_realignment_, num_workers_);
+
+  // The pairs are independent, and the spectrogram builder is thread safe, so
+  // the pairs are recreated concurrently. Each task keeps its own
+  // spectrograms, and builds them in turn on its worker.
+  ParallelExecutor::ForEach(to_realign.size(), num_workers_,
+                            [&](size_t task_index) {
+    const size_t i = to_realign[task_index];
+    auto realigned_result = FinelyAlignAndRecreatePatch(sim_results[i],
+        aligned_results[task_index], spect_builder, window, workspace);
+    if (realigned_result.ok()) {
+      realigned_results[i] = std::move(realigned_result.ValueOrDie());
     } else {
-      if (lag > 0.) {
-        new_sim_result.ref_patch_start_time = sim_result.ref_patch_start_time
-                                              + lag;
-        new_sim_result.deg_patch_start_time = sim_result.deg_patch_start_time;
-      } else {
-        new_sim_result.ref_patch_start_time = sim_result.ref_patch_start_time;
-        new_sim_result.deg_patch_start_time = sim_result.deg_patch_start_time
-                                              - lag;
-      }
-      new_sim_result.ref_patch_end_time = new_sim_result.ref_patch_start_time
-                                          + new_ref_duration;
-      new_sim_result.deg_patch_end_time = new_sim_result.deg_patch_start_time
-                                          + new_deg_duration;
-      realigned_results[i] = new_sim_result;
+      statuses[i] = realigned_result.status();
+    }
+  });
+
+  // Report the error of the first pair that failed, as if the pairs had been
+  // realigned in order.
+  for (const auto &status : statuses) {
+    if (!status.ok()) {
+      return status;
     }
   }
   return realigned_results;
 }
+
+google::protobuf::util::StatusOr<PatchSimilarityResult>
+ComparisonPatchesSelector::FinelyAlignAndRecreatePatch(
+    const PatchSimilarityResult &sim_result,
+    const std::tuple<AudioSignalView, AudioSignalView, double> &aligned_result,
+    const SpectrogramBuilder *spect_builder,
+    const AnalysisWindow &window,
+    VisqolWorkspace *workspace) const {
+  const AudioSignalView &ref_audio_aligned = std::get<0>(aligned_result);
+  const AudioSignalView &deg_audio_aligned = std::get<1>(aligned_result);
+  double lag = std::get<2>(aligned_result);
+
+  double new_ref_duration = ref_audio_aligned.GetDuration();
+  double new_deg_duration = deg_audio_aligned.GetDuration();
+  // 3. Compute new spectrograms for the aligned audio.
+  // The patches are short, so the pair is built on the calling thread.
+  auto spectro_results = spect_builder->BuildPair(
+      ref_audio_aligned, deg_audio_aligned, window, workspace);
+  auto &ref_spectro_result = spectro_results.first;
+  if (!ref_spectro_result.ok()) {
+    ABSL_RAW_LOG(ERROR, "Error building ref spectrogram: %s",
+                 ref_spectro_result.status().ToString().c_str());
+    return ref_spectro_result.status();
+  }
+  Spectrogram ref_spectrogram = std::move(ref_spectro_result.ValueOrDie());
+
+  auto &deg_spectro_result = spectro_results.second;
+  if (!deg_spectro_result.ok()) {
+    ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
+                 deg_spectro_result.status().ToString().c_str());
+    return deg_spectro_result.status();
+  }
+  Spectrogram deg_spectrogram = std::move(deg_spectro_result.ValueOrDie());
+
+  MiscAudio::PrepareSpectrogramsForComparison(ref_spectrogram,
+                                              deg_spectrogram);
+  // 4. Recreate an aligned degraded patch from the new spectrogram.
+  const AMatrix<double> &new_ref_patch = ref_spectrogram.Data();
+
+  const AMatrix<double> &new_deg_patch = deg_spectrogram.Data();
+  // 5. Update the similarity result with the new patch.
+  auto new_sim_result = sim_comparator_->MeasurePatchSimilarity(
+      new_ref_patch, new_deg_patch);
+  // The spectrograms are no longer used, so their matrices are kept for the
+  // next patch.
+  if (workspace != nullptr) {
+    workspace->RecycleMatrix(ref_spectrogram.ReleaseData());
+    workspace->RecycleMatrix(deg_spectrogram.ReleaseData());
+  }
+  // Compare to the old result and take the max.
+  if (new_sim_result.similarity < sim_result.similarity) {
+    return sim_result;
+  }
+  if (lag > 0.) {
+    new_sim_result.ref_patch_start_time = sim_result.ref_patch_start_time
+                                          + lag;
+    new_sim_result.deg_patch_start_time = sim_result.deg_patch_start_time;
+  } else {
+    new_sim_result.ref_patch_start_time = sim_result.ref_patch_start_time;
+    new_sim_result.deg_patch_start_time = sim_result.deg_patch_start_time
+                                          - lag;
+  }
+  new_sim_result.ref_patch_end_time = new_sim_result.ref_patch_start_time
+                                      + new_ref_duration;
+  new_sim_result.deg_patch_end_time = new_sim_result.deg_patch_start_time
+                                      + new_deg_duration;
+  return new_sim_result;
+}
 }  // namespace Visqol
@@ -0,0 +1,68 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "compute_backend.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+namespace Visqol {
+namespace {
+// The registered backends. They are never freed, so that the pointers that
+// Find returns stay valid. The registry is built on first use, as backends
+// register themselves during static initialization.
+struct Registry {
+  absl::Mutex mutex;
+  std::map<std::string, std::unique_ptr<ComputeBackend>> backends;
+};
+
+Registry &GetRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+}  // namespace
+
+bool ComputeBackendRegistry::Register(const std::string &name,
+                                      ComputeBackend backend) {
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  return registry.backends.emplace(name, absl::make_unique<ComputeBackend>(
+      std::move(backend))).second;
+}
+
+const ComputeBackend *ComputeBackendRegistry::Find(const std::string &name) {
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  const auto it = registry.backends.find(name);
+  return it == registry.backends.end() ? nullptr : it->second.get();
+}
+
+std::vector<std::string> ComputeBackendRegistry::Names() {
+  Registry &registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  std::vector<std::string> names;
+  names.reserve(registry.backends.size());
+  for (const auto &entry : registry.backends) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+}  // namespace Visqol
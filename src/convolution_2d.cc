@@ -87,4 +87,5 @@ AMatrix<T> Convolution2D<T>::CopyMatrixWithinPadding(
 }
 
 template class Convolution2D<double>;
+template class Convolution2D<float>;
 }  // namespace Visqol
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Registers the decoder of FLAC files with libFLAC. It is linked into the
+// binaries that are built with --define=visqol_flac=1.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "FLAC/stream_decoder.h"
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+
+#include "audio_decoder.h"
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+// The state of a decode, which libFLAC passes to the callbacks.
+struct FlacDecode {
+  bool downmix;
+  size_t sample_rate = 0;
+  bool failed = false;
+  std::unique_ptr<DecodedSignalBuilder> builder;
+};
+
+// Create the builder of the signal from the STREAMINFO block, which libFLAC
+// reports before the first frame.
+void OnMetadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *meta,
+                void *client_data) {
+  auto *decode = static_cast<FlacDecode *>(client_data);
+  if (meta->type != FLAC__METADATA_TYPE_STREAMINFO) {
+    return;
+  }
+  const FLAC__StreamMetadata_StreamInfo &info = meta->data.stream_info;
+  decode->sample_rate = info.sample_rate;
+  decode->builder = absl::make_unique<DecodedSignalBuilder>(
+      info.channels, static_cast<size_t>(info.total_samples),
+      decode->downmix);
+}
+
+// Normalize the samples of a frame to [-1, 1), as those of a WAV file of
+// the same bit depth are, and append them to the signal.
+FLAC__StreamDecoderWriteStatus OnFrame(const FLAC__StreamDecoder *,
+                                       const FLAC__Frame *frame,
+                                       const FLAC__int32 *const buffer[],
+                                       void *client_data) {
+  auto *decode = static_cast<FlacDecode *>(client_data);
+  if (decode->builder == nullptr) {
+    return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+  }
+  const double scale = 1.0 / static_cast<double>(
+      int64_t{1} << (frame->header.bits_per_sample - 1));
+  decode->builder->Append(frame->header.blocksize,
+      [&](size_t i, size_t channel) { return buffer[channel][i] * scale; });
+  return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void OnError(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus status,
+             void *client_data) {
+  static_cast<FlacDecode *>(client_data)->failed = true;
+  ABSL_RAW_LOG(ERROR, "Error decoding FLAC frame: %s",
+               FLAC__StreamDecoderErrorStatusString[status]);
+}
+
+class FlacDecoder : public AudioDecoder {
+ public:
+  AudioSignal Decode(const FilePath &path, bool downmix) const override {
+    std::unique_ptr<FLAC__StreamDecoder, void (*)(FLAC__StreamDecoder *)>
+        decoder(FLAC__stream_decoder_new(), FLAC__stream_decoder_delete);
+    FlacDecode decode;
+    decode.downmix = downmix;
+    if (decoder == nullptr ||
+        FLAC__stream_decoder_init_file(decoder.get(), path.Path().c_str(),
+                                       OnFrame, OnMetadata, OnError,
+                                       &decode) !=
+            FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+      ABSL_RAW_LOG(ERROR, "Could not open FLAC file %s.", path.Path().c_str());
+      return AudioSignal{};
+    }
+    const bool ok =
+        FLAC__stream_decoder_process_until_end_of_stream(decoder.get());
+    FLAC__stream_decoder_finish(decoder.get());
+    if (!ok || decode.builder == nullptr) {
+      ABSL_RAW_LOG(ERROR, "Error decoding FLAC file %s.", path.Path().c_str());
+      return AudioSignal{};
+    }
+    // Frames that fail their checksum are reported and skipped by libFLAC,
+    // which leaves the rest of the signal misaligned, so such files are not
+    // compared.
+    if (decode.failed) {
+      ABSL_RAW_LOG(ERROR, "Corrupt frames in FLAC file %s.",
+                   path.Path().c_str());
+      return AudioSignal{};
+    }
+    return decode.builder->Build(decode.sample_rate, path);
+  }
+};
+
+const bool kRegistered = AudioDecoderRegistry::Register(
+    "flac", absl::make_unique<FlacDecoder>());
+}  // namespace
+}  // namespace Visqol
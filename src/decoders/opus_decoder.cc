@@ -0,0 +1,83 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Registers the decoder of Ogg Opus files with libopusfile. It is linked into
+// the binaries that are built with --define=visqol_opus=1.
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+#include "opusfile.h"
+
+#include "audio_decoder.h"
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+// Opus always decodes at 48 kHz, whatever the rate of the encoded signal.
+const size_t kOpusSampleRate = 48000;
+
+// The most frames that an Opus packet decodes to, 120 ms at 48 kHz.
+const int kMaxPacketFrames = 5760;
+
+class OggOpusDecoder : public AudioDecoder {
+ public:
+  AudioSignal Decode(const FilePath &path, bool downmix) const override {
+    int error = 0;
+    std::unique_ptr<OggOpusFile, void (*)(OggOpusFile *)> file(
+        op_open_file(path.Path().c_str(), &error), op_free);
+    if (file == nullptr) {
+      ABSL_RAW_LOG(ERROR, "Could not open Opus file %s: %d.",
+                   path.Path().c_str(), error);
+      return AudioSignal{};
+    }
+    // The channels of every link of a chained stream must match, as they
+    // are compared as the columns of a single signal.
+    const int num_channels = op_channel_count(file.get(), -1);
+    const ogg_int64_t num_frames = op_pcm_total(file.get(), -1);
+    DecodedSignalBuilder builder(
+        num_channels, num_frames > 0 ? static_cast<size_t>(num_frames) : 0,
+        downmix);
+    std::vector<float> block(kMaxPacketFrames * num_channels);
+    while (true) {
+      int link = 0;
+      const int num_read = op_read_float(file.get(), block.data(),
+                                         static_cast<int>(block.size()),
+                                         &link);
+      if (num_read == 0) {
+        break;
+      }
+      if (num_read < 0 || op_channel_count(file.get(), link) != num_channels) {
+        ABSL_RAW_LOG(ERROR, "Error decoding Opus file %s: %d.",
+                     path.Path().c_str(), num_read);
+        return AudioSignal{};
+      }
+      builder.Append(num_read, [&](size_t i, size_t channel) {
+        return static_cast<double>(block[i * num_channels + channel]);
+      });
+    }
+    return builder.Build(kOpusSampleRate, path);
+  }
+};
+
+const bool kRegistered = AudioDecoderRegistry::Register(
+    "opus", absl::make_unique<OggOpusDecoder>());
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,260 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dense_rbf_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "absl/types/span.h"
+#include "svm.h"
+
+#include "embedded_svr_model.h"
+
+namespace Visqol {
+namespace {
+// The squared Euclidean distance between two arrays of n values.
+inline double SquaredDistance(const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  double sum = 0.0;
+#if defined(__AVX__)
+  __m256d lanes_sum = _mm256_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    const __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                       _mm256_loadu_pd(b + i));
+    lanes_sum = _mm256_add_pd(lanes_sum, _mm256_mul_pd(diff, diff));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, lanes_sum);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+  __m128d lanes_sum = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2) {
+    const __m128d diff = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    lanes_sum = _mm_add_pd(lanes_sum, _mm_mul_pd(diff, diff));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, lanes_sum);
+  sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  float64x2_t lanes_sum = vdupq_n_f64(0.0);
+  for (; i + 2 <= n; i += 2) {
+    const float64x2_t diff = vsubq_f64(vld1q_f64(a + i), vld1q_f64(b + i));
+    lanes_sum = vaddq_f64(lanes_sum, vmulq_f64(diff, diff));
+  }
+  sum = vgetq_lane_f64(lanes_sum, 0) + vgetq_lane_f64(lanes_sum, 1);
+#endif
+  for (; i < n; i++) {
+    const double diff = a[i] - b[i];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+// The header of a compiled model file. It is followed by the coefficient of
+// each support vector, and then by the rows of the support vectors. The
+// values are in the byte order of the machine that compiled the model, which
+// the version detects.
+struct CompiledHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_features;
+  uint64_t num_support_vectors;
+  uint64_t source_size;
+  uint64_t source_hash;
+  double gamma;
+  double rho;
+};
+static_assert(sizeof(CompiledHeader) == 56,
+              "Padding in CompiledHeader struct detected");
+
+const char kCompiledMagic[8] = {'V', 'Q', 'S', 'V', 'R', 0, 0, 0};
+const uint32_t kCompiledVersion = 1;
+}  // namespace
+
+const size_t DenseRbfModel::kObservationsPerBlock = 16;
+
+DenseRbfModel::DenseRbfModel(size_t num_features, double gamma, double rho)
+    : num_features_(num_features), gamma_(gamma), rho_(rho) {}
+
+std::unique_ptr<DenseRbfModel> DenseRbfModel::FromSvmModel(
+    const svm_model *model) {
+  if (model == nullptr || model->param.kernel_type != RBF ||
+      (model->param.svm_type != EPSILON_SVR &&
+       model->param.svm_type != NU_SVR)) {
+    return nullptr;
+  }
+  const size_t num_support_vectors = model->l;
+  size_t num_features = 0;
+  for (size_t sv = 0; sv < num_support_vectors; sv++) {
+    for (const svm_node *node = model->SV[sv]; node->index != -1; node++) {
+      num_features = std::max<size_t>(num_features, node->index);
+    }
+  }
+
+  std::unique_ptr<DenseRbfModel> dense(new DenseRbfModel(num_features,
+      model->param.gamma, model->rho[0]));
+  dense->support_vectors_.assign(num_support_vectors * num_features, 0.0);
+  dense->coefficients_.assign(model->sv_coef[0],
+                              model->sv_coef[0] + num_support_vectors);
+  for (size_t sv = 0; sv < num_support_vectors; sv++) {
+    double *row = dense->support_vectors_.data() + sv * num_features;
+    // The feature indices are 1-indexed.
+    for (const svm_node *node = model->SV[sv]; node->index != -1; node++) {
+      row[node->index - 1] = node->value;
+    }
+  }
+  return dense;
+}
+
+std::unique_ptr<DenseRbfModel> DenseRbfModel::FromEmbedded(
+    const EmbeddedSvrModel &model) {
+  std::unique_ptr<DenseRbfModel> dense(new DenseRbfModel(model.num_features,
+      model.gamma, model.rho));
+  dense->coefficients_.assign(model.coefficients,
+                              model.coefficients + model.num_support_vectors);
+  dense->support_vectors_.assign(model.support_vectors, model.support_vectors +
+      model.num_support_vectors * model.num_features);
+  return dense;
+}
+
+std::unique_ptr<DenseRbfModel> DenseRbfModel::Load(const std::string &path,
+                                                   uint64_t *source_size,
+                                                   uint64_t *source_hash) {
+  std::ifstream in(path, std::ios_base::binary);
+  CompiledHeader header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !std::equal(kCompiledMagic, kCompiledMagic + sizeof(kCompiledMagic),
+                  header.magic) ||
+      header.version != kCompiledVersion) {
+    return nullptr;
+  }
+  // The rest of the file holds a coefficient and num_features values for
+  // each support vector. The count in the header is checked against the size
+  // of the file before anything is allocated, as a corrupt file may claim any
+  // count.
+  const std::streamoff values_start = in.tellg();
+  in.seekg(0, std::ios_base::end);
+  const std::streamoff values_end = in.tellg();
+  if (values_start < 0 || values_end < values_start ||
+      !in.seekg(values_start)) {
+    return nullptr;
+  }
+  const uint64_t num_bytes = values_end - values_start;
+  const uint64_t num_values = num_bytes / sizeof(double);
+  const uint64_t values_per_vector = uint64_t{header.num_features} + 1;
+  if (num_bytes % sizeof(double) != 0 ||
+      num_values % values_per_vector != 0 ||
+      header.num_support_vectors != num_values / values_per_vector) {
+    return nullptr;
+  }
+  std::unique_ptr<DenseRbfModel> dense(new DenseRbfModel(header.num_features,
+      header.gamma, header.rho));
+  dense->coefficients_.resize(header.num_support_vectors);
+  dense->support_vectors_.resize(header.num_support_vectors *
+                                 header.num_features);
+  if (!in.read(reinterpret_cast<char *>(dense->coefficients_.data()),
+               dense->coefficients_.size() * sizeof(double)) ||
+      !in.read(reinterpret_cast<char *>(dense->support_vectors_.data()),
+               dense->support_vectors_.size() * sizeof(double))) {
+    return nullptr;
+  }
+  *source_size = header.source_size;
+  *source_hash = header.source_hash;
+  return dense;
+}
+
+bool DenseRbfModel::Save(const std::string &path, uint64_t source_size,
+                         uint64_t source_hash) const {
+  CompiledHeader header;
+  std::copy(kCompiledMagic, kCompiledMagic + sizeof(kCompiledMagic),
+            header.magic);
+  header.version = kCompiledVersion;
+  header.num_features = num_features_;
+  header.num_support_vectors = coefficients_.size();
+  header.source_size = source_size;
+  header.source_hash = source_hash;
+  header.gamma = gamma_;
+  header.rho = rho_;
+  std::ofstream out(path, std::ios_base::binary | std::ios_base::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(coefficients_.data()),
+            coefficients_.size() * sizeof(double));
+  out.write(reinterpret_cast<const char *>(support_vectors_.data()),
+            support_vectors_.size() * sizeof(double));
+  return static_cast<bool>(out);
+}
+
+double DenseRbfModel::Predict(absl::Span<const double> observation) const {
+  if (observation.size() == num_features_) {
+    return PredictFeatures(observation.data(), 0.0);
+  }
+  std::vector<double> features(num_features_, 0.0);
+  const size_t num_shared = std::min(observation.size(), num_features_);
+  std::copy(observation.begin(), observation.begin() + num_shared,
+            features.begin());
+  double extra_distance = 0.0;
+  for (size_t i = num_shared; i < observation.size(); i++) {
+    extra_distance += observation[i] * observation[i];
+  }
+  return PredictFeatures(features.data(), extra_distance);
+}
+
+double DenseRbfModel::PredictFeatures(const double *observation,
+                                      double extra_distance) const {
+  double sum = 0.0;
+  for (size_t sv = 0; sv < coefficients_.size(); sv++) {
+    const double distance = SquaredDistance(observation,
+        support_vectors_.data() + sv * num_features_, num_features_) +
+        extra_distance;
+    sum += coefficients_[sv] * std::exp(-gamma_ * distance);
+  }
+  return sum - rho_;
+}
+
+std::vector<double> DenseRbfModel::PredictBatch(
+    absl::Span<const std::vector<double>> observations) const {
+  std::vector<double> sums(observations.size(), 0.0);
+  for (size_t begin = 0; begin < observations.size();
+       begin += kObservationsPerBlock) {
+    const size_t end = std::min(begin + kObservationsPerBlock,
+                                observations.size());
+    for (size_t sv = 0; sv < coefficients_.size(); sv++) {
+      const double *row = support_vectors_.data() + sv * num_features_;
+      for (size_t i = begin; i < end; i++) {
+        const double distance = SquaredDistance(observations[i].data(), row,
+                                                num_features_);
+        sums[i] += coefficients_[sv] * std::exp(-gamma_ * distance);
+      }
+    }
+  }
+  for (double &sum : sums) {
+    sum -= rho_;
+  }
+  return sums;
+}
+}  // namespace Visqol
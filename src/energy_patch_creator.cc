@@ -0,0 +1,87 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "energy_patch_creator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "google/protobuf/stubs/statusor.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal.h"
+
+namespace Visqol {
+
+google::protobuf::util::StatusOr<std::vector<size_t>>
+    EnergyPatchCreator::CreateRefPatchIndices(
+        const AMatrix<double> &spectrogram, const AudioSignal &ref_signal,
+        const AnalysisWindow &window) const {
+  auto indices_result = ImagePatchCreator::CreateRefPatchIndices(
+      spectrogram, ref_signal, window);
+  if (!indices_result.ok()) {
+    return indices_result.status();
+  }
+  const std::vector<size_t> &all_indices = indices_result.ValueOrDie();
+  const std::vector<double> levels = CalcPatchLevels(ref_signal, all_indices,
+                                                     window);
+  std::vector<size_t> indices;
+  indices.reserve(all_indices.size());
+  for (size_t i = 0; i < all_indices.size(); i++) {
+    if (levels[i] >= silence_threshold_db_) {
+      indices.push_back(all_indices[i]);
+    }
+  }
+  if (indices.empty()) {
+    return all_indices;
+  }
+  return indices;
+}
+
+std::vector<double> EnergyPatchCreator::CalcPatchLevels(
+    const AudioSignal &signal, const std::vector<size_t> &patch_indices,
+    const AnalysisWindow &window) const {
+  const size_t num_samples = signal.data_matrix.NumRows();
+  const double *samples = signal.data_matrix.data();
+  double peak = 0.0;
+  for (size_t i = 0; i < num_samples; i++) {
+    peak = std::max(peak, std::abs(samples[i]));
+  }
+
+  // Each patch covers the samples of its frames, from the start of its first
+  // frame to the end of its last frame.
+  const size_t hop_size = window.size * window.overlap;
+  const size_t patch_samples = (patch_size_ - 1) * hop_size + window.size;
+  std::vector<double> levels;
+  levels.reserve(patch_indices.size());
+  for (const size_t index : patch_indices) {
+    const size_t first = std::min(index * hop_size, num_samples);
+    const size_t end = std::min(first + patch_samples, num_samples);
+    double sum_sq = 0.0;
+    for (size_t i = first; i < end; i++) {
+      sum_sq += samples[i] * samples[i];
+    }
+    if (end == first || sum_sq == 0.0 || peak == 0.0) {
+      levels.push_back(std::numeric_limits<double>::lowest());
+    } else {
+      levels.push_back(10 * std::log10(sum_sq / (end - first) /
+                                       (peak * peak)));
+    }
+  }
+  return levels;
+}
+}  // namespace Visqol
@@ -14,61 +14,67 @@
 
 #include "envelope.h"
 
-#include <algorithm>
-#include <complex>
-#include <cstdio>
-#include <vector>
+#include <cmath>
+#include <memory>
 
-#include "absl/memory/memory.h"
-
-#include "fast_fourier_transform.h"
+#include "audio_channel.h"
+#include "fft_manager_pool.h"
 #include "misc_vector.h"
 
 namespace Visqol {
 AMatrix<double> Envelope::CalcUpperEnv(const AMatrix<double> &signal) {
-  double mean = MiscVector::Mean(signal);
-  const auto signal_centered = signal - mean;
-  AMatrix<std::complex<double>> hilbert = Hilbert(signal_centered);
-  AMatrix<double> hilbert_amp(hilbert.NumRows(), hilbert.NumCols());
-  // to amplitude
-  for (size_t i = 0; i < hilbert.NumRows(); i++) {
-    hilbert_amp(i) = std::abs(hilbert(i));
+  const size_t num_samples = signal.NumRows();
+  const double mean = MiscVector::Mean(signal);
+  const FftManagerPool::Lease fft_lease(signal.NumElements());
+  const auto &fft_manager = fft_lease.Get();
+
+  // The signal is centered as it is copied into the zero padded FFT buffer.
+  AudioChannel signal_centered;
+  signal_centered.Init(fft_manager->GetFftSize());
+  signal_centered.Clear();
+  for (size_t i = 0; i < num_samples; i++) {
+    signal_centered[i] = signal(i) - mean;
   }
 
-  return hilbert_amp + mean;
+  AudioChannel analytic_signal;
+  analytic_signal.Init(fft_manager->GetFftSize());
+  CalcAnalyticSignal(fft_manager, num_samples, &signal_centered,
+                     &analytic_signal);
+
+  // to amplitude
+  AMatrix<double> upper_env(num_samples, 1);
+  for (size_t i = 0; i < num_samples; i++) {
+    upper_env(i) = std::abs(static_cast<double>(analytic_signal[i])) + mean;
+  }
+  return upper_env;
 }
 
-AMatrix<std::complex<double>> Envelope::Hilbert(const AMatrix<double> &signal) {
-  auto fft_manager = absl::make_unique<FftManager>(signal.NumElements());
-  AMatrix<std::complex<double>> freq_domain_signal =
-      FastFourierTransform::Forward1d(fft_manager, signal);
+AMatrix<double> Envelope::CalcUpperEnv(const AudioSignalView &signal) {
+  return CalcUpperEnv(signal.ToMatrix());
+}
 
-  const bool is_odd = signal.NumRows() % 2 == 1;
-  const bool is_non_empty = signal.NumRows() > 0;
-  const double kInitVal = 0.0;
-  std::vector<double> hilbert_scaling(freq_domain_signal.NumRows(), kInitVal);
-  hilbert_scaling[0] = 1;
+void Envelope::CalcAnalyticSignal(
+    const std::unique_ptr<FftManager> &fft_manager, size_t num_samples,
+    AudioChannel *buffer, AudioChannel *analytic_signal) {
+  // The spectrum is ordered as the 0Hz bin, the Nyquist bin, and then the
+  // real and imaginary parts of each positive frequency bin. There are no
+  // negative frequency bins to zero in the half spectrum.
+  AudioChannel &spectrum = *analytic_signal;
+  fft_manager->FreqFromTimeDomain(*buffer, &spectrum);
 
-  // even and nonempty, used for scaling
-  if (!is_odd && is_non_empty) {
-    hilbert_scaling[signal.NumRows() / 2] = 1.0;
-  } else if (is_odd && is_non_empty) {
-    hilbert_scaling[signal.NumRows() / 2] = 2.0;
+  // The positive frequencies are doubled, and the 0Hz bin is kept. The
+  // Nyquist bin is only kept when the signal fills the whole FFT, as it then
+  // holds the Nyquist frequency of the signal. Otherwise, it is zeroed.
+  if (num_samples != fft_manager->GetFftSize()) {
+    spectrum[1] = 0.0f;
   }
-  const size_t n = (is_odd) ? (freq_domain_signal.NumRows() + 1) / 2 :
-                         ((freq_domain_signal.NumRows()) / 2);
-  for (size_t row_index = 1; row_index < n; row_index++) {
-    hilbert_scaling[row_index] = 2.0;
+  for (size_t i = 2; i < fft_manager->GetFftSize(); i++) {
+    spectrum[i] *= 2.0f;
   }
 
-  AMatrix<std::complex<double>> element_wise_prod(
-      freq_domain_signal.NumElements(),
-      1);
-  for (size_t i = 0; i < freq_domain_signal.NumRows(); i++) {
-    element_wise_prod(i) = freq_domain_signal(i) * hilbert_scaling[i];
-  }
-  auto hilbert = FastFourierTransform::Inverse1d(fft_manager,
-                                                 element_wise_prod);
-  return hilbert;
+  // Convert the scaled spectrum to pffft order and back to the time domain.
+  fft_manager->GetPffftFormatFreqBuffer(spectrum, buffer);
+  fft_manager->TimeFromFreqDomain(*buffer, analytic_signal);
+  fft_manager->ApplyReverseFftScaling(analytic_signal);
 }
 }  // namespace Visqol
@@ -38,7 +38,13 @@ ErbFiltersResult EquivalentRectangularBandwidth::MakeFilters(
   }
   auto cf1 = EquivalentRectangularBandwidth::CalcUniformCenterFreqs(
       low_freq, high_freq, num_channels);
-  auto cf = ComplexValArray{cf1};
+  return MakeFiltersForCenterFreqs(sample_rate, cf1);
+}
+
+ErbFiltersResult EquivalentRectangularBandwidth::MakeFiltersForCenterFreqs(
+    std::size_t sample_rate, const std::vector<double> &center_freqs) {
+  const std::size_t num_channels = center_freqs.size();
+  auto cf = ComplexValArray{center_freqs};
 
   double earQ = 9.26449;  // Glasberg and Moore Parameters
   double minBW = 24.7;
@@ -0,0 +1,78 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "erb_filter_cache.h"
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+#include "amatrix.h"
+#include "equivalent_rectangular_bandwidth.h"
+#include "multirate_gammatone_filterbank.h"
+
+namespace Visqol {
+
+absl::Mutex ErbFilterCache::cache_mutex_{};
+std::map<ErbFilterCache::CacheKey, std::shared_ptr<const ErbFilterSet>>
+    ErbFilterCache::cache_{};
+std::map<ErbFilterCache::CacheKey, std::shared_ptr<const MultirateErbFilterSet>>
+    ErbFilterCache::multirate_cache_{};
+
+std::shared_ptr<const ErbFilterSet> ErbFilterCache::GetFilters(
+    size_t sample_rate, size_t num_bands, double min_freq, double max_freq) {
+  const CacheKey key{sample_rate, num_bands, min_freq, max_freq};
+  absl::MutexLock lock(&cache_mutex_);
+  auto itr = cache_.find(key);
+  if (itr != cache_.end()) {
+    return itr->second;
+  }
+
+  ErbFiltersResult erb_rslt = EquivalentRectangularBandwidth::MakeFilters(
+      sample_rate, num_bands, min_freq, max_freq);
+  auto filter_set = std::make_shared<ErbFilterSet>();
+  filter_set->filter_coeffs =
+      AMatrix<double>(erb_rslt.filterCoeffs).FlipUpDown();
+
+  // Order the center freq bands from lowest to highest.
+  filter_set->center_freqs.assign(erb_rslt.centerFreqs.rbegin(),
+                                  erb_rslt.centerFreqs.rend());
+
+  cache_.emplace(key, filter_set);
+  return filter_set;
+}
+
+std::shared_ptr<const MultirateErbFilterSet>
+ErbFilterCache::GetMultirateFilters(size_t sample_rate, size_t num_bands,
+                                    double min_freq, double max_freq) {
+  const std::shared_ptr<const ErbFilterSet> filters = GetFilters(
+      sample_rate, num_bands, min_freq, max_freq);
+  const CacheKey key{sample_rate, num_bands, min_freq, max_freq};
+  absl::MutexLock lock(&cache_mutex_);
+  auto itr = multirate_cache_.find(key);
+  if (itr != multirate_cache_.end()) {
+    return itr->second;
+  }
+
+  auto filter_set = std::make_shared<MultirateErbFilterSet>(
+      MultirateGammatoneFilterBank::DesignStages(sample_rate,
+                                                 filters->center_freqs));
+  multirate_cache_.emplace(key, filter_set);
+  return filter_set;
+}
+}  // namespace Visqol
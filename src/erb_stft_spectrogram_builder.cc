@@ -0,0 +1,210 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "erb_stft_spectrogram_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal_view.h"
+#include "erb_filter_cache.h"
+#include "fft_manager.h"
+#include "fft_manager_pool.h"
+#include "gammatone_spectrogram_builder.h"
+#include "misc_math.h"
+#include "spectrogram.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+const double ErbStftSpectrogramBuilder::kMinWeight = 1e-6;
+
+ErbStftSpectrogramBuilder::ErbStftSpectrogramBuilder(const size_t num_bands,
+    const double min_freq, const bool use_speech_mode) :
+    num_bands_(num_bands), min_freq_(min_freq), speech_mode_(use_speech_mode) {}
+
+double ErbStftSpectrogramBuilder::FilterPowerResponse(
+    const AMatrix<double> &filter_coeffs, size_t band, double freq,
+    size_t sample_rate) {
+  // The columns of the ERB filter coefficients are:
+  // A0, A11, A12, A13, A14, A2, B0, B1, B2, gain.
+  const std::complex<double> z1 = std::polar(1.0, -2.0 * M_PI * freq /
+                                             sample_rate);
+  const std::complex<double> z2 = z1 * z1;
+  const double a0 = filter_coeffs(band, 0);
+  const double a2 = filter_coeffs(band, 5);
+  const std::complex<double> denom = filter_coeffs(band, 6) +
+      filter_coeffs(band, 7) * z1 + filter_coeffs(band, 8) * z2;
+  const double gain = filter_coeffs(band, 9);
+  double response = 1.0 / (gain * gain);
+  for (size_t s = 0; s < 4; s++) {
+    const std::complex<double> numer = a0 + filter_coeffs(band, 1 + s) * z1 +
+        a2 * z2;
+    response *= std::norm(numer / denom);
+  }
+  return response;
+}
+
+std::shared_ptr<const ErbStftSpectrogramBuilder::StftTables>
+ErbStftSpectrogramBuilder::GetTables(size_t sample_rate, size_t window_size,
+    size_t hop_size, const AMatrix<double> &filter_coeffs) const {
+  absl::MutexLock lock(&tables_mutex_);
+  if (tables_ != nullptr && tables_->sample_rate == sample_rate &&
+      tables_->window_size == window_size && tables_->hop_size == hop_size) {
+    return tables_;
+  }
+  auto tables = std::make_shared<StftTables>();
+  tables->sample_rate = sample_rate;
+  tables->window_size = window_size;
+  tables->hop_size = hop_size;
+  // each window is zero padded up to the FFT size.
+  const size_t fft_size = std::max(MiscMath::NextPowTwo(window_size),
+                                   FftManager::kMinFftSize);
+  tables->fft_size = fft_size;
+
+  // The weights also fold in the scaling that turns the one sided power
+  // spectrum into the energy of the frame (Parseval's theorem).
+  const size_t num_bins = fft_size / 2 + 1;
+  for (size_t b = 0; b < filter_coeffs.NumRows(); b++) {
+    std::vector<double> weights(num_bins);
+    size_t first_bin = num_bins;
+    size_t end_bin = 0;
+    for (size_t k = 0; k < num_bins; k++) {
+      const double freq = static_cast<double>(k) * sample_rate / fft_size;
+      const double response = FilterPowerResponse(filter_coeffs, b, freq,
+                                                  sample_rate);
+      if (response >= kMinWeight) {
+        first_bin = std::min(first_bin, k);
+        end_bin = k + 1;
+      }
+      const double num_images = (k == 0 || k == num_bins - 1) ? 1.0 : 2.0;
+      weights[k] = response * num_images / fft_size;
+    }
+    BandWeights band;
+    band.first_bin = first_bin < end_bin ? first_bin : 0;
+    if (first_bin < end_bin) {
+      band.weights.assign(weights.begin() + first_bin,
+                          weights.begin() + end_bin);
+    }
+    tables->band_weights.push_back(std::move(band));
+  }
+
+  // The gammatone filters are restarted at the start of each window, so the
+  // reference spectrogram includes the response to the abrupt start of the
+  // window, but not to its end. The start of each window is kept abrupt,
+  // while the last hop is faded out to avoid counting the response to the
+  // abrupt end. The band energies are scaled by the window power.
+  tables->taper.assign(window_size, 1.0);
+  const size_t fade_size = std::min(hop_size, window_size);
+  for (size_t j = 0; j < fade_size; j++) {
+    tables->taper[window_size - fade_size + j] =
+        0.5 + 0.5 * cos(M_PI * (j + 0.5) / fade_size);
+  }
+  double taper_power = 0.0;
+  for (const double w : tables->taper) {
+    taper_power += w * w;
+  }
+  tables->taper_scale = 1.0 / taper_power;
+
+  tables_ = tables;
+  return tables_;
+}
+
+google::protobuf::util::StatusOr<Spectrogram>
+ErbStftSpectrogramBuilder::Build(const AudioSignalView &signal,
+                                 const AnalysisWindow &window,
+                                 VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  size_t sample_rate = signal.SampleRate();
+  double max_freq = speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
+
+  // use the same filters as the gammatone filter bank, so that the spectrogram
+  // layout is unchanged.
+  std::shared_ptr<const ErbFilterSet> erb_filters = ErbFilterCache::GetFilters(
+      sample_rate, num_bands_, min_freq_, max_freq);
+
+  // set up the windowing
+  size_t hop_size = window.size * window.overlap;
+
+  // ensure that the signal is large enough.
+  if (num_samples <= window.size) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::INVALID_ARGUMENT,
+        "Too few samples ("+std::to_string(num_samples)+") in signal to build"
+        " spectrogram ("+std::to_string(hop_size)+" required minimum).");
+  }
+  size_t num_cols = 1 + floor((num_samples - window.size) / hop_size);
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  AMatrix<double> out_matrix = scratch->TakeMatrix(num_bands_, num_cols);
+
+  std::shared_ptr<const StftTables> tables = GetTables(sample_rate,
+      window.size, hop_size, erb_filters->filter_coeffs);
+  const size_t fft_size = tables->fft_size;
+  // the FFT buffers are leased to this call, so that several signals can be
+  // built concurrently, and later builds reuse the plan.
+  const FftManagerPool::Lease fft_lease(fft_size);
+  FftManager &fft_manager = *fft_lease.Get();
+
+  AudioChannel &time_channel = fft_manager.GetTimeChannel();
+  AudioChannel &freq_channel = fft_manager.GetFreqChannel();
+  const absl::Span<double> power = scratch->Allocate<double>(fft_size / 2 + 1);
+  for (size_t i = 0; i < num_cols; i++) {
+    const size_t start_row = i * hop_size;
+    time_channel.Clear();
+    for (size_t j = 0; j < window.size; j++) {
+      time_channel[j] = signal[start_row + j] * tables->taper[j];
+    }
+    fft_manager.FreqFromTimeDomain(time_channel, &freq_channel);
+
+    // the ordered pffft output holds the 0Hz and Nyquist bins in the first
+    // two values, followed by interleaved real and imaginary parts.
+    power[0] = freq_channel[0] * freq_channel[0];
+    power[fft_size / 2] = freq_channel[1] * freq_channel[1];
+    for (size_t k = 1; k < fft_size / 2; k++) {
+      const double re = freq_channel[2 * k];
+      const double im = freq_channel[2 * k + 1];
+      power[k] = re * re + im * im;
+    }
+
+    // project the power spectrum onto the ERB bands, straight into the
+    // column of the spectrogram.
+    double *band_rms = out_matrix.mutData() + i * num_bands_;
+    for (size_t band = 0; band < num_bands_; band++) {
+      const BandWeights &bw = tables->band_weights[band];
+      double energy = 0.0;
+      for (size_t k = 0; k < bw.weights.size(); k++) {
+        energy += bw.weights[k] * power[bw.first_bin + k];
+      }
+      band_rms[band] = std::sqrt(energy * tables->taper_scale);
+    }
+  }
+
+  Spectrogram spectro(std::move(out_matrix));
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
+  return spectro;
+}
+}  // namespace Visqol
@@ -14,6 +14,7 @@
 
 #include "fast_fourier_transform.h"
 
+#include <algorithm>
 #include <complex>
 #include <iterator>
 #include <memory>
@@ -142,4 +143,26 @@ AMatrix<double> FastFourierTransform::Inverse1dConjSym(
     in_matrix.NumCols(), out_double_vector);
   return out_matrix;
 }
+
+void FastFourierTransform::ForwardReal1d(
+    const std::unique_ptr<FftManager> &fft_manager,
+    const std::vector<double> &signal, AudioChannel *spectrum) {
+  // The signal may fill the whole FFT, e.g. when it holds negative lags that
+  // wrap around, so it is zero padded to the FFT size rather than copied into
+  // the time channel of the manager.
+  AudioChannel time_channel;
+  time_channel.Init(fft_manager->GetFftSize());
+  time_channel.Clear();
+  std::copy(signal.begin(), signal.end(), time_channel.begin());
+  fft_manager->ZDomainFromTimeDomain(time_channel, spectrum);
+}
+
+std::vector<double> FastFourierTransform::InverseReal1d(
+    const std::unique_ptr<FftManager> &fft_manager,
+    const AudioChannel &spectrum) {
+  AudioChannel &time_channel = fft_manager->GetTimeChannel();
+  fft_manager->TimeFromFreqDomain(spectrum, &time_channel);
+  fft_manager->ApplyReverseFftScaling(&time_channel);
+  return std::vector<double>(time_channel.begin(), time_channel.end());
+}
 }  // namespace Visqol
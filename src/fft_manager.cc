@@ -76,6 +76,36 @@ void FftManager::FreqFromTimeDomain(const AudioChannel& time_channel,
   }
 }
 
+void FftManager::ZDomainFromTimeDomain(const AudioChannel& time_channel,
+    AudioChannel* z_channel) {
+
+  assert(z_channel->size() == fft_size_);
+  assert(time_channel.size() <= fft_size_);
+
+  // Perform forward FFT transform, without reordering the output.
+  if (time_channel.size() == fft_size_) {
+    pffft_transform(fft_, time_channel.begin(), z_channel->begin(),
+        pffft_workspace_, PFFFT_FORWARD);
+  } else {
+    AudioChannel temp_zeropad_buffer_;
+    temp_zeropad_buffer_.Init(fft_size_);
+    temp_zeropad_buffer_.Clear();
+    std::copy_n(time_channel.begin(), samples_per_channel_,
+        temp_zeropad_buffer_.begin());
+    pffft_transform(fft_, temp_zeropad_buffer_.begin(), z_channel->begin(),
+        pffft_workspace_, PFFFT_FORWARD);
+  }
+}
+
+void FftManager::ZConvolveAccumulate(const AudioChannel& a,
+    const AudioChannel& b, AudioChannel* ab, float scaling) {
+  assert(a.size() == fft_size_);
+  assert(b.size() == fft_size_);
+  assert(ab->size() == fft_size_);
+
+  pffft_zconvolve_accumulate(fft_, a.begin(), b.begin(), ab->begin(), scaling);
+}
+
 void FftManager::TimeFromFreqDomain(const AudioChannel& freq_channel,
     AudioChannel* time_channel) {
 
@@ -0,0 +1,85 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fft_manager_pool.h"
+
+#include <iterator>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+#include "fft_manager.h"
+
+namespace Visqol {
+
+const size_t FftManagerPool::kMaxIdleBytes = 64 * 1024 * 1024;
+
+absl::Mutex FftManagerPool::pool_mutex_{};
+std::list<std::unique_ptr<FftManager>> FftManagerPool::idle_managers_{};
+size_t FftManagerPool::idle_bytes_ = 0;
+
+size_t FftManagerPool::BufferBytes(const FftManager &manager) {
+  const size_t fft_size = manager.GetFftSize();
+  // The time and frequency domain buffers, and the PFFFT setup, which holds
+  // about two floats per point of the FFT.
+  size_t num_floats = manager.GetSamplesPerChannel() + 3 * fft_size;
+  if (fft_size > FftManager::kPffftMaxStackSize) {
+    // The PFFFT workspace is allocated on the heap for the long FFTs.
+    num_floats += 2 * fft_size;
+  }
+  return num_floats * sizeof(float);
+}
+
+FftManagerPool::Lease::Lease(size_t samples_per_channel)
+    : manager_(Acquire(samples_per_channel)) {}
+
+FftManagerPool::Lease::~Lease() { Release(std::move(manager_)); }
+
+std::unique_ptr<FftManager> FftManagerPool::Acquire(
+    size_t samples_per_channel) {
+  {
+    absl::MutexLock lock(&pool_mutex_);
+    for (auto itr = idle_managers_.begin(); itr != idle_managers_.end();
+         itr++) {
+      if ((*itr)->GetSamplesPerChannel() == samples_per_channel) {
+        std::unique_ptr<FftManager> manager = std::move(*itr);
+        idle_managers_.erase(itr);
+        idle_bytes_ -= BufferBytes(*manager);
+        return manager;
+      }
+    }
+  }
+  // The plan is set up outside of the lock.
+  return absl::make_unique<FftManager>(samples_per_channel);
+}
+
+void FftManagerPool::Release(std::unique_ptr<FftManager> manager) {
+  std::list<std::unique_ptr<FftManager>> evicted;
+  {
+    absl::MutexLock lock(&pool_mutex_);
+    idle_bytes_ += BufferBytes(*manager);
+    idle_managers_.push_front(std::move(manager));
+    while (idle_bytes_ > kMaxIdleBytes) {
+      idle_bytes_ -= BufferBytes(*idle_managers_.back());
+      evicted.splice(evicted.end(), idle_managers_,
+                     std::prev(idle_managers_.end()));
+    }
+  }
+  // The evicted managers, if any, are destroyed outside of the lock.
+}
+}  // namespace Visqol
@@ -0,0 +1,247 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fingerprint_aligner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "alignment.h"
+#include "audio_channel.h"
+#include "audio_signal_view.h"
+#include "envelope.h"
+#include "fft_manager_pool.h"
+#include "xcorr.h"
+
+namespace Visqol {
+const size_t FingerprintAligner::kFrameSize = 1024;
+const size_t FingerprintAligner::kHopSize = 512;
+const size_t FingerprintAligner::kNumBands = 32;
+const size_t FingerprintAligner::kPeakFrameRadius = 8;
+const size_t FingerprintAligner::kPeakBandRadius = 2;
+const size_t FingerprintAligner::kFanOut = 4;
+const size_t FingerprintAligner::kMaxPairFrames = 32;
+const size_t FingerprintAligner::kMinVotes = 10;
+const double FingerprintAligner::kMinVoteRatio = 2.0;
+const size_t FingerprintAligner::kRefineSamples = 1 << 18;
+
+std::tuple<AudioSignal, double> FingerprintAligner::GloballyAlign(
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal) {
+  int64_t frame_offset = 0;
+  int64_t best_lag = 0;
+  if (!VoteFrameOffset(ref_signal, deg_signal, &frame_offset) ||
+      !RefineLag(ref_signal, deg_signal,
+                 frame_offset * static_cast<int64_t>(kHopSize), &best_lag)) {
+    return Alignment::GloballyAlign(ref_signal, deg_signal);
+  }
+  return Alignment::ApplyGlobalLag(deg_signal, best_lag,
+                                   ref_signal.data_matrix.NumRows());
+}
+
+bool FingerprintAligner::VoteFrameOffset(const AudioSignal &ref_signal,
+                                         const AudioSignal &deg_signal,
+                                         int64_t *frame_offset) {
+  const auto ref_landmarks = FindLandmarks(FindPeaks(
+      CalcBandEnergies(ref_signal)));
+  const auto deg_landmarks = FindLandmarks(FindPeaks(
+      CalcBandEnergies(deg_signal)));
+  std::unordered_map<uint32_t, std::vector<int64_t>> ref_frames_by_hash;
+  for (const auto &landmark : ref_landmarks) {
+    ref_frames_by_hash[landmark.first].push_back(landmark.second);
+  }
+
+  // A degraded landmark at frame t that matches a reference landmark at
+  // frame t + offset votes for the offset.
+  std::map<int64_t, size_t> votes;
+  for (const auto &landmark : deg_landmarks) {
+    const auto ref_frames = ref_frames_by_hash.find(landmark.first);
+    if (ref_frames == ref_frames_by_hash.end()) {
+      continue;
+    }
+    for (int64_t ref_frame : ref_frames->second) {
+      votes[ref_frame - landmark.second]++;
+    }
+  }
+  if (votes.empty()) {
+    return false;
+  }
+
+  // The votes of a lag between two frame offsets are split between them, so
+  // only the offsets that are not next to the best one compete with it.
+  auto best = votes.begin();
+  for (auto itr = votes.begin(); itr != votes.end(); itr++) {
+    if (itr->second > best->second) {
+      best = itr;
+    }
+  }
+  size_t runner_up_votes = 0;
+  for (const auto &vote : votes) {
+    if (std::abs(vote.first - best->first) > 1) {
+      runner_up_votes = std::max(runner_up_votes, vote.second);
+    }
+  }
+  *frame_offset = best->first;
+  return best->second >= kMinVotes &&
+      best->second >= kMinVoteRatio * runner_up_votes;
+}
+
+bool FingerprintAligner::RefineLag(const AudioSignal &ref_signal,
+                                   const AudioSignal &deg_signal,
+                                   int64_t coarse_lag, int64_t *best_lag) {
+  const int64_t ref_num_samples = ref_signal.data_matrix.NumRows();
+  const int64_t deg_num_samples = deg_signal.data_matrix.NumRows();
+  const int64_t max_offset = 2 * kHopSize;
+  // The excerpt is taken from the middle of the samples of the reference that
+  // the degraded signal overlaps at the coarse lag.
+  const int64_t overlap_start = std::max<int64_t>(0, coarse_lag);
+  const int64_t overlap_end = std::min(ref_num_samples,
+                                       deg_num_samples + coarse_lag);
+  const int64_t excerpt_size = std::min<int64_t>(kRefineSamples,
+                                                 overlap_end - overlap_start);
+  if (excerpt_size <= 2 * max_offset) {
+    return false;
+  }
+  const int64_t ref_start = overlap_start +
+      (overlap_end - overlap_start - excerpt_size) / 2;
+  const AudioSignalView ref_excerpt(ref_signal, ref_start, excerpt_size);
+  const AudioSignalView deg_excerpt(deg_signal, ref_start - coarse_lag,
+                                    excerpt_size);
+
+  const int64_t offset = XCorr::CalcBestLagWithin(
+      Envelope::CalcUpperEnv(ref_excerpt), Envelope::CalcUpperEnv(deg_excerpt),
+      max_offset);
+  *best_lag = coarse_lag + offset;
+  return std::abs(offset) < max_offset;
+}
+
+std::vector<float> FingerprintAligner::CalcBandEnergies(
+    const AudioSignal &signal) {
+  const auto &samples = signal.data_matrix;
+  const size_t num_samples = samples.NumRows();
+  const size_t num_frames = num_samples < kFrameSize ? 0 :
+      (num_samples - kFrameSize) / kHopSize + 1;
+  std::vector<float> band_energies(num_frames * kNumBands, 0.0f);
+  if (num_frames == 0) {
+    return band_energies;
+  }
+
+  const FftManagerPool::Lease fft_lease(kFrameSize);
+  const auto &fft_manager = fft_lease.Get();
+  const size_t fft_size = fft_manager->GetFftSize();
+  const size_t num_bins = fft_size / 2;
+  // The bands are log spaced from the second bin up to the Nyquist bin, and
+  // each is at least one bin wide.
+  std::vector<size_t> band_edges(kNumBands + 1);
+  for (size_t band = 0; band <= kNumBands; band++) {
+    band_edges[band] = std::lround(2.0 * std::pow(num_bins / 2.0,
+        band / static_cast<double>(kNumBands)));
+    if (band > 0) {
+      band_edges[band] = std::max(band_edges[band], band_edges[band - 1] + 1);
+    }
+  }
+  band_edges[kNumBands] = num_bins;
+
+  std::vector<float> window(kFrameSize);
+  for (size_t i = 0; i < kFrameSize; i++) {
+    window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / (kFrameSize - 1));
+  }
+  AudioChannel frame;
+  frame.Init(fft_size);
+  AudioChannel spectrum;
+  spectrum.Init(fft_size);
+  for (size_t frame_index = 0; frame_index < num_frames; frame_index++) {
+    frame.Clear();
+    const size_t start = frame_index * kHopSize;
+    for (size_t i = 0; i < kFrameSize; i++) {
+      frame[i] = window[i] * samples(start + i);
+    }
+    fft_manager->FreqFromTimeDomain(frame, &spectrum);
+
+    // The ordered spectrum holds the real and imaginary parts of each bin k
+    // at 2k and 2k + 1. Only the 0Hz and Nyquist bins, which are not in any
+    // band, share the first two.
+    float *energies = &band_energies[frame_index * kNumBands];
+    for (size_t band = 0; band < kNumBands; band++) {
+      for (size_t bin = band_edges[band]; bin < band_edges[band + 1]; bin++) {
+        energies[band] += spectrum[2 * bin] * spectrum[2 * bin] +
+            spectrum[2 * bin + 1] * spectrum[2 * bin + 1];
+      }
+    }
+  }
+  return band_energies;
+}
+
+std::vector<FingerprintAligner::Peak> FingerprintAligner::FindPeaks(
+    const std::vector<float> &band_energies) {
+  const int64_t num_frames = band_energies.size() / kNumBands;
+  const int64_t frame_radius = kPeakFrameRadius;
+  const int64_t band_radius = kPeakBandRadius;
+  const int64_t num_bands = kNumBands;
+  std::vector<Peak> peaks;
+  for (int64_t frame = 0; frame < num_frames; frame++) {
+    for (int64_t band = 0; band < num_bands; band++) {
+      const float energy = band_energies[frame * num_bands + band];
+      // Silence has no peaks, as the energies of its bands are all equal.
+      bool is_peak = energy > 0.0f;
+      for (int64_t other_frame = std::max<int64_t>(0, frame - frame_radius);
+           is_peak && other_frame <= std::min(num_frames - 1,
+                                              frame + frame_radius);
+           other_frame++) {
+        for (int64_t other_band = std::max<int64_t>(0, band - band_radius);
+             other_band <= std::min(num_bands - 1, band + band_radius);
+             other_band++) {
+          if ((other_frame != frame || other_band != band) &&
+              band_energies[other_frame * num_bands + other_band] >= energy) {
+            is_peak = false;
+            break;
+          }
+        }
+      }
+      if (is_peak) {
+        peaks.push_back(Peak{frame, static_cast<size_t>(band)});
+      }
+    }
+  }
+  return peaks;
+}
+
+std::vector<std::pair<uint32_t, int64_t>> FingerprintAligner::FindLandmarks(
+    const std::vector<Peak> &peaks) {
+  // Each landmark is hashed from the bands of its peaks and the number of
+  // frames between them, which do not depend on where the landmark is.
+  std::vector<std::pair<uint32_t, int64_t>> landmarks;
+  for (size_t i = 0; i < peaks.size(); i++) {
+    size_t num_pairs = 0;
+    for (size_t j = i + 1; j < peaks.size() && num_pairs < kFanOut; j++) {
+      const int64_t frame_delta = peaks[j].frame - peaks[i].frame;
+      if (frame_delta == 0) {
+        continue;
+      }
+      if (frame_delta > static_cast<int64_t>(kMaxPairFrames)) {
+        break;
+      }
+      const uint32_t hash = (peaks[i].band * kNumBands + peaks[j].band) *
+          (kMaxPairFrames + 1) + frame_delta;
+      landmarks.emplace_back(hash, peaks[i].frame);
+      num_pairs++;
+    }
+  }
+  return landmarks;
+}
+}  // namespace Visqol
@@ -0,0 +1,193 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fixed_point_gammatone_filterbank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+
+namespace Visqol {
+namespace {
+
+// The number of filter stages in the cascade.
+constexpr size_t kNumStages = 4;
+
+// The number of coefficients per band. The numerator coefficients for stage s
+// are at (s * 3) to (s * 3 + 2), followed by the two shared denominator
+// coefficients.
+constexpr size_t kNumCoeffs = kNumStages * 3 + 2;
+constexpr size_t kDenom1 = kNumStages * 3;
+constexpr size_t kDenom2 = kDenom1 + 1;
+
+// The number of state values per band. The two delay elements for stage s are
+// at (s * 3) and (s * 3 + 1), and the rounding error of its last output at
+// (s * 3 + 2).
+constexpr size_t kNumStates = kNumStages * 3;
+
+// Round a value to a 32 bit integer, saturating values that are out of range.
+int32_t SaturateToInt32(const double value) {
+  const double clamped = std::max(
+      static_cast<double>(std::numeric_limits<int32_t>::min()),
+      std::min(static_cast<double>(std::numeric_limits<int32_t>::max()),
+               std::round(value)));
+  return static_cast<int32_t>(clamped);
+}
+
+// The magnitude response of one stage of the cascade at the given angular
+// frequency, for a numerator of n0 + n1 z^-1 + n2 z^-2 and a denominator of
+// 1 + d1 z^-1 + d2 z^-2.
+double StageGain(const double n0, const double n1, const double n2,
+                 const double d1, const double d2, const double omega) {
+  const std::complex<double> z1 = std::polar(1.0, -omega);
+  const std::complex<double> z2 = z1 * z1;
+  return std::abs((n0 + n1 * z1 + n2 * z2) / (1.0 + d1 * z1 + d2 * z2));
+}
+
+// The integer square root of a value, rounded down.
+uint64_t SquareRoot(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = uint64_t{1} << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+}  // namespace
+
+const int FixedPointGammatoneFilterBank::kSignalFracBits = 27;
+const int FixedPointGammatoneFilterBank::kCoeffFracBits = 28;
+
+FixedPointGammatoneFilterBank::FixedPointGammatoneFilterBank(
+    const size_t num_bands, const double min_freq)
+    : num_bands_(num_bands), min_freq_(min_freq),
+      coeffs_(kNumCoeffs * num_bands, 0),
+      state_(kNumStates * num_bands, 0) {}
+
+size_t FixedPointGammatoneFilterBank::GetNumBands() const {
+  return num_bands_;
+}
+
+double FixedPointGammatoneFilterBank::GetMinFreq() const { return min_freq_; }
+
+void FixedPointGammatoneFilterBank::ResetFilterConditions() {
+  std::fill(state_.begin(), state_.end(), 0);
+}
+
+void FixedPointGammatoneFilterBank::SetFilterCoefficients(
+    const AMatrix<double> &filter_coeffs,
+    const std::vector<double> &center_freqs, size_t sample_rate) {
+  // The columns of the ERB filter coefficients are:
+  // A0, A11, A12, A13, A14, A2, B0, B1, B2, gain.
+  const double coeff_scale = std::ldexp(1.0, kCoeffFracBits);
+  for (size_t band = 0; band < num_bands_; band++) {
+    int32_t *c = coeffs_.data() + band * kNumCoeffs;
+    const double a0 = filter_coeffs(band, 0);
+    const double a2 = filter_coeffs(band, 5);
+    const double d1 = filter_coeffs(band, 7);
+    const double d2 = filter_coeffs(band, 8);
+    const double omega = 2.0 * M_PI * center_freqs[band] / sample_rate;
+    // The first three stages are scaled to unity gain at the center
+    // frequency, and the last stage takes the remaining gain of the cascade,
+    // which includes the normalisation by the gain column.
+    double remaining_gain = 1.0 / filter_coeffs(band, 9);
+    for (size_t s = 0; s < kNumStages; s++) {
+      const double a1 = filter_coeffs(band, 1 + s);
+      double scale = remaining_gain;
+      if (s + 1 < kNumStages) {
+        const double stage_gain = StageGain(a0, a1, a2, d1, d2, omega);
+        scale = 1.0 / stage_gain;
+        remaining_gain *= stage_gain;
+      }
+      c[s * 3] = SaturateToInt32(a0 * scale * coeff_scale);
+      c[s * 3 + 1] = SaturateToInt32(a1 * scale * coeff_scale);
+      c[s * 3 + 2] = SaturateToInt32(a2 * scale * coeff_scale);
+    }
+    c[kDenom1] = SaturateToInt32(d1 * coeff_scale);
+    c[kDenom2] = SaturateToInt32(d2 * coeff_scale);
+  }
+}
+
+int32_t FixedPointGammatoneFilterBank::ToFixedPoint(const double sample) {
+  return SaturateToInt32(std::ldexp(sample, kSignalFracBits));
+}
+
+void FixedPointGammatoneFilterBank::ApplyFilterRms(
+    absl::Span<const int32_t> signal, absl::Span<double> rms) {
+  std::fill(rms.begin(), rms.end(), 0.0);
+  const size_t num_samples = signal.size();
+  if (num_samples == 0) {
+    return;
+  }
+  // The squares of the outputs are rounded off by just enough bits that their
+  // sum cannot overflow, even if every output saturates.
+  int energy_shift = 1;
+  while ((uint64_t{1} << (energy_shift + 1)) < num_samples) {
+    energy_shift++;
+  }
+  const uint64_t energy_half = uint64_t{1} << (energy_shift - 1);
+  const int64_t one = int64_t{1} << kCoeffFracBits;
+  const int64_t int32_min = std::numeric_limits<int32_t>::min();
+  const int64_t int32_max = std::numeric_limits<int32_t>::max();
+  for (size_t band = 0; band < num_bands_; band++) {
+    const int32_t *c = coeffs_.data() + band * kNumCoeffs;
+    int64_t *z = state_.data() + band * kNumStates;
+    const int64_t d1 = c[kDenom1];
+    const int64_t d2 = c[kDenom2];
+    uint64_t energy = 0;
+    for (size_t i = 0; i < num_samples; i++) {
+      int64_t x = signal[i];
+      for (size_t s = 0; s < kNumStages; s++) {
+        int64_t *stage = z + s * 3;
+        // the accumulator has kSignalFracBits + kCoeffFracBits fractional
+        // bits. The rounding error of the last output is added back in.
+        const int64_t acc = c[s * 3] * x + stage[0] + stage[2];
+        int64_t y = acc >> kCoeffFracBits;
+        if (y < int32_min || y > int32_max) {
+          y = std::max(int32_min, std::min(int32_max, y));
+          stage[2] = 0;
+        } else {
+          stage[2] = acc - y * one;
+        }
+        stage[0] = c[s * 3 + 1] * x + stage[1] - d1 * y;
+        stage[1] = c[s * 3 + 2] * x - d2 * y;
+        x = y;
+      }
+      energy += (static_cast<uint64_t>(x * x) + energy_half) >> energy_shift;
+    }
+    // The mean square has 2 * kSignalFracBits - energy_shift fractional bits,
+    // so restoring the shift before the square root leaves kSignalFracBits.
+    const uint64_t mean_square = energy / num_samples;
+    rms[band] = std::ldexp(
+        static_cast<double>(SquareRoot(mean_square << energy_shift)),
+        -kSignalFracBits);
+  }
+}
+}  // namespace Visqol
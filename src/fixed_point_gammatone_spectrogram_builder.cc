@@ -0,0 +1,99 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fixed_point_gammatone_spectrogram_builder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal_view.h"
+#include "erb_filter_cache.h"
+#include "gammatone_spectrogram_builder.h"
+#include "spectrogram.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+FixedPointGammatoneSpectrogramBuilder::FixedPointGammatoneSpectrogramBuilder(
+    const FixedPointGammatoneFilterBank &filter_bank,
+    const bool use_speech_mode) :
+    filter_bank_(filter_bank), speech_mode_(use_speech_mode) {}
+
+google::protobuf::util::StatusOr<Spectrogram>
+FixedPointGammatoneSpectrogramBuilder::Build(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  size_t sample_rate = signal.SampleRate();
+  double max_freq = speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
+
+  // quantize the same ERB filters that the floating point filter bank uses.
+  // The filter bank is local to this call.
+  std::shared_ptr<const ErbFilterSet> erb_filters = ErbFilterCache::GetFilters(
+      sample_rate, filter_bank_.GetNumBands(), filter_bank_.GetMinFreq(),
+      max_freq);
+  FixedPointGammatoneFilterBank filter_bank = filter_bank_;
+  filter_bank.SetFilterCoefficients(erb_filters->filter_coeffs,
+                                    erb_filters->center_freqs, sample_rate);
+
+  // set up the windowing
+  size_t hop_size = window.size * window.overlap;
+
+  // ensure that the signal is large enough.
+  if (num_samples <= window.size) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::INVALID_ARGUMENT,
+        "Too few samples ("+std::to_string(num_samples)+") in signal to build"
+        " spectrogram ("+std::to_string(hop_size)+" required minimum).");
+  }
+  size_t num_cols = 1 + floor((num_samples - window.size) / hop_size);
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  AMatrix<double> out_matrix = scratch->TakeMatrix(filter_bank.GetNumBands(),
+                                                   num_cols);
+
+  // convert the signal to fixed point once, as the analysis windows overlap.
+  const absl::Span<const double> sig_span = signal.ToSpan(scratch);
+  std::vector<int32_t> fixed_signal(sig_span.size());
+  for (size_t i = 0; i < sig_span.size(); i++) {
+    fixed_signal[i] = FixedPointGammatoneFilterBank::ToFixedPoint(sig_span[i]);
+  }
+
+  // run the windowing, writing the RMS of each band straight into the columns
+  // of the spectrogram.
+  const absl::Span<const int32_t> fixed_span(fixed_signal);
+  const size_t num_bands = filter_bank.GetNumBands();
+  for (size_t i = 0; i < num_cols; i++) {
+    const auto frame = fixed_span.subspan(i * hop_size, window.size);
+    filter_bank.ResetFilterConditions();
+    filter_bank.ApplyFilterRms(frame, absl::Span<double>(
+        out_matrix.mutData() + i * num_bands, num_bands));
+  }
+
+  Spectrogram spectro(std::move(out_matrix));
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
+  return spectro;
+}
+}  // namespace Visqol
@@ -14,82 +14,120 @@
 
 #include "gammatone_filterbank.h"
 
-#include <utility>
+#include <algorithm>
+#include <cmath>
 #include <valarray>
+#include <vector>
+
+#include "absl/types/span.h"
 
 #include "amatrix.h"
-#include "signal_filter.h"
+#include "simd_dispatch.h"
+#include "simd_kernels.h"
 
 namespace Visqol {
+namespace {
+
+// The number of filter stages in the cascade.
+constexpr size_t kNumStages = kGammatoneCascadeStages;
+
+// Row offsets of the shared denominator coefficients in the packed cascade
+// coefficients. The numerator coefficients for stage s are held in rows
+// (s * 3) to (s * 3 + 2).
+constexpr size_t kDenom1Row = kNumStages * 3;
+constexpr size_t kDenom2Row = kDenom1Row + 1;
+}  // namespace
+
+const size_t GammatoneFilterBank::kNumCascadeCoeffs = kNumStages * 3 + 2;
+const size_t GammatoneFilterBank::kNumCascadeStates = kNumStages * 2;
+
 GammatoneFilterBank::GammatoneFilterBank(const size_t num_bands,
                                          const double min_freq)
     : num_bands_(num_bands), min_freq_(min_freq),
-      fltr_cond_1_({0.0, 0.0}, num_bands), fltr_cond_2_({0.0, 0.0}, num_bands),
-      fltr_cond_3_({0.0, 0.0}, num_bands), fltr_cond_4_({0.0, 0.0}, num_bands)
-      {}
+      cascade_coeffs_(kNumCascadeCoeffs * num_bands, 0.0),
+      cascade_state_(kNumCascadeStates * num_bands, 0.0) {}
 
 size_t GammatoneFilterBank::GetNumBands() const { return num_bands_; }
 
 double GammatoneFilterBank::GetMinFreq() const { return min_freq_; }
 
 void GammatoneFilterBank::ResetFilterConditions() {
-  fltr_cond_1_ = {{0.0, 0.0}, num_bands_};
-  fltr_cond_2_ = {{0.0, 0.0}, num_bands_};
-  fltr_cond_3_ = {{0.0, 0.0}, num_bands_};
-  fltr_cond_4_ = {{0.0, 0.0}, num_bands_};
+  std::fill(cascade_state_.begin(), cascade_state_.end(), 0.0);
 }
 
 void GammatoneFilterBank::SetFilterCoefficients(
     const AMatrix<double> &filter_coeffs) {
-  fltr_coeff_A0_ = filter_coeffs.GetColumn(0).ToValArray();
-  fltr_coeff_A11_ = filter_coeffs.GetColumn(1).ToValArray();
-  fltr_coeff_A12_ = filter_coeffs.GetColumn(2).ToValArray();
-  fltr_coeff_A13_ = filter_coeffs.GetColumn(3).ToValArray();
-  fltr_coeff_A14_ = filter_coeffs.GetColumn(4).ToValArray();
-  fltr_coeff_A2_ = filter_coeffs.GetColumn(5).ToValArray();
-  fltr_coeff_B0_ = filter_coeffs.GetColumn(6).ToValArray();
-  fltr_coeff_B1_ = filter_coeffs.GetColumn(7).ToValArray();
-  fltr_coeff_B2_ = filter_coeffs.GetColumn(8).ToValArray();
-  fltr_coeff_gain_ = filter_coeffs.GetColumn(9).ToValArray();
+  // The columns of the ERB filter coefficients are:
+  // A0, A11, A12, A13, A14, A2, B0, B1, B2, gain.
+  // The first stage has its numerator normalised by the gain.
+  double *c = cascade_coeffs_.data();
+  for (size_t band = 0; band < num_bands_; band++) {
+    const double a0 = filter_coeffs(band, 0);
+    const double a2 = filter_coeffs(band, 5);
+    const double gain = filter_coeffs(band, 9);
+    for (size_t s = 0; s < kNumStages; s++) {
+      const double a1 = filter_coeffs(band, 1 + s);
+      c[(s * 3) * num_bands_ + band] = (s == 0) ? a0 / gain : a0;
+      c[(s * 3 + 1) * num_bands_ + band] = (s == 0) ? a1 / gain : a1;
+      c[(s * 3 + 2) * num_bands_ + band] = (s == 0) ? a2 / gain : a2;
+    }
+    c[kDenom1Row * num_bands_ + band] = filter_coeffs(band, 7);
+    c[kDenom2Row * num_bands_ + band] = filter_coeffs(band, 8);
+  }
+}
+
+const std::vector<double> &GammatoneFilterBank::GetCascadeCoefficients()
+    const {
+  return cascade_coeffs_;
 }
 
 AMatrix<double> GammatoneFilterBank::ApplyFilter(
     const std::valarray<double> &signal) {
-AMatrix<double> output(num_bands_, signal.size());
-std::valarray<double> a1, a2, a3, a4, b;
-
-// Loop over each filter coefficient now to produce a filtered column.
-for (size_t chan = 0; chan < num_bands_; chan++) {
-  a1 = {fltr_coeff_A0_[chan] / fltr_coeff_gain_[chan],
-        fltr_coeff_A11_[chan] / fltr_coeff_gain_[chan],
-        fltr_coeff_A2_[chan] / fltr_coeff_gain_[chan]};
-  a2 = {fltr_coeff_A0_[chan], fltr_coeff_A12_[chan], fltr_coeff_A2_[chan]};
-  a3 = {fltr_coeff_A0_[chan], fltr_coeff_A13_[chan], fltr_coeff_A2_[chan]};
-  a4 = {fltr_coeff_A0_[chan], fltr_coeff_A14_[chan], fltr_coeff_A2_[chan]};
-  b = {fltr_coeff_B0_[chan], fltr_coeff_B1_[chan], fltr_coeff_B2_[chan]};
-
-  // First filter
-  auto fltr_rslt = SignalFilter::Filter(a1, b, signal,
-    fltr_cond_1_[chan]);
-  fltr_cond_1_[chan] = fltr_rslt.finalConditions;
-
-  // Second filter
-  fltr_rslt = SignalFilter::Filter(a2, b,
-    std::move(fltr_rslt.filteredSignal), fltr_cond_2_[chan]);
-  fltr_cond_2_[chan] = fltr_rslt.finalConditions;
-
-  // Third filter
-  fltr_rslt = SignalFilter::Filter(a3, b,
-    std::move(fltr_rslt.filteredSignal), fltr_cond_3_[chan]);
-  fltr_cond_3_[chan] = fltr_rslt.finalConditions;
-
-  // Fourth filter
-  fltr_rslt = SignalFilter::Filter(a4, b,
-    std::move(fltr_rslt.filteredSignal), fltr_cond_4_[chan]);
-  fltr_cond_4_[chan] = fltr_rslt.finalConditions;
-
-  output.SetRow(chan, std::move(fltr_rslt.filteredSignal));
-}
+  AMatrix<double> output(num_bands_, signal.size());
+  if (signal.size() == 0) {
+    return output;
+  }
+  // The output is column major, so the bands of each sample are contiguous
+  // and can be written straight from the SIMD lanes.
+  SimdDispatch::Kernels().gammatone_filter(
+      cascade_coeffs_.data(), cascade_state_.data(), num_bands_,
+      std::begin(signal), signal.size(), output.mutData());
   return output;
 }
+
+std::vector<double> GammatoneFilterBank::ApplyFilterRms(
+    absl::Span<const double> signal) {
+  std::vector<double> rms(num_bands_);
+  ApplyFilterRms(signal, absl::MakeSpan(rms));
+  return rms;
+}
+
+void GammatoneFilterBank::ApplyFilterRms(absl::Span<const double> signal,
+                                         absl::Span<double> rms) {
+  ApplyFilterEnergy(signal, rms);
+  if (signal.empty()) {
+    return;
+  }
+  for (auto &r : rms) {
+    r = std::sqrt(r / signal.size());
+  }
+}
+
+std::vector<double> GammatoneFilterBank::ApplyFilterEnergy(
+    absl::Span<const double> signal) {
+  std::vector<double> energy(num_bands_);
+  ApplyFilterEnergy(signal, absl::MakeSpan(energy));
+  return energy;
+}
+
+void GammatoneFilterBank::ApplyFilterEnergy(absl::Span<const double> signal,
+                                            absl::Span<double> energy) {
+  std::fill(energy.begin(), energy.end(), 0.0);
+  if (signal.empty()) {
+    return;
+  }
+  SimdDispatch::Kernels().gammatone_energy(
+      cascade_coeffs_.data(), cascade_state_.data(), num_bands_, signal.data(),
+      signal.size(), energy.data());
+}
 }  // namespace Visqol
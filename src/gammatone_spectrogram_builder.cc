@@ -15,86 +15,172 @@
 #include "gammatone_spectrogram_builder.h"
 
 #include <algorithm>
+#include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/types/span.h"
+
 #include "amatrix.h"
 #include "analysis_window.h"
-#include "audio_signal.h"
-#include "equivalent_rectangular_bandwidth.h"
+#include "audio_signal_view.h"
+#include "erb_filter_cache.h"
+#include "parallel_executor.h"
 #include "signal_filter.h"
 #include "spectrogram.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 
 const double GammatoneSpectrogramBuilder::kSpeechModeMaxFreq = 8000.0;
 
 GammatoneSpectrogramBuilder::GammatoneSpectrogramBuilder(
-    const GammatoneFilterBank &filter_bank, const bool use_speech_mode) :
-    filter_bank_(filter_bank), speech_mode_(use_speech_mode) {}
+    const GammatoneFilterBank &filter_bank, const bool use_speech_mode,
+    const size_t num_threads) :
+    filter_bank_(filter_bank), speech_mode_(use_speech_mode),
+    num_threads_(num_threads) {}
 
 google::protobuf::util::StatusOr<Spectrogram> GammatoneSpectrogramBuilder::Build
-    (const AudioSignal &signal,
-     const AnalysisWindow &window) {
-  const auto &sig = signal.data_matrix;
-  size_t sample_rate = signal.sample_rate;
+    (const AudioSignalView &signal, const AnalysisWindow &window,
+     VisqolWorkspace *workspace) const {
+  return BuildSelectedColumns(signal, window, nullptr, workspace);
+}
+
+google::protobuf::util::StatusOr<Spectrogram>
+GammatoneSpectrogramBuilder::BuildColumnRanges(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    const SpectrogramColumnRanges &columns,
+    VisqolWorkspace *workspace) const {
+  return BuildSelectedColumns(signal, window, &columns, workspace);
+}
+
+google::protobuf::util::StatusOr<Spectrogram>
+GammatoneSpectrogramBuilder::BuildSelectedColumns(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    const SpectrogramColumnRanges *columns,
+    VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  size_t sample_rate = signal.SampleRate();
   double max_freq = speech_mode_ ? kSpeechModeMaxFreq : sample_rate / 2.0;
 
-  // get gammatone coeffients
-  ErbFiltersResult erb_rslt = EquivalentRectangularBandwidth::MakeFilters(
+  // get gammatone coeffients. These are shared across all builds with the
+  // same configuration.
+  std::shared_ptr<const ErbFilterSet> erb_filters = ErbFilterCache::GetFilters(
       sample_rate, filter_bank_.GetNumBands(), filter_bank_.GetMinFreq(),
       max_freq);
-  AMatrix<double> filter_coeffs = AMatrix<double>(erb_rslt.filterCoeffs);
-  filter_coeffs = filter_coeffs.FlipUpDown();
-
-  // set the filter coefficients and init the filter conditions to 0.
-  filter_bank_.SetFilterCoefficients(filter_coeffs);
-  filter_bank_.ResetFilterConditions();
 
   // set up the windowing
   size_t hop_size = window.size * window.overlap;
 
   // ensure that the signal is large enough.
-  if (sig.NumRows() <= window.size) {
+  if (num_samples <= window.size) {
     return google::protobuf::util::Status(
         google::protobuf::util::error::INVALID_ARGUMENT,
-        "Too few samples ("+std::to_string(sig.NumRows())+") in signal to build"
+        "Too few samples ("+std::to_string(num_samples)+") in signal to build"
         " spectrogram ("+std::to_string(hop_size)+" required minimum).");
   }
-  size_t num_cols = 1 + floor((sig.NumRows() - window.size) / hop_size);
-  AMatrix<double> out_matrix(filter_bank_.GetNumBands(), num_cols);
+  size_t num_cols = 1 + floor((num_samples - window.size) / hop_size);
 
-  // run the windowing
-  auto sig_val_arr = sig.GetColumn(0).ToValArray();
-  for (size_t i = 0; i < out_matrix.NumCols(); i++) {
-    const size_t start_col = i * hop_size;
-    // select the next frame from the input signal to filter.
-    const auto frame = sig_val_arr[std::slice(start_col, window.size, 1)];
-    // apply the filter
-    filter_bank_.ResetFilterConditions();
-    auto filtered_signal = filter_bank_.ApplyFilter(frame);
-    // calculate the mean of each row
-    std::transform(filtered_signal.begin(), filtered_signal.end(),
-                   filtered_signal.begin(),
-                   [](decltype(*filtered_signal.begin()) &d) { return d * d; });
-    AMatrix<double> row_means = filtered_signal.Mean(kDimension::ROW);
-    std::transform(row_means.begin(), row_means.end(), row_means.begin(),
-                   [](decltype(*row_means.begin()) &d) { return sqrt(d); });
-    // set this filtered frame as a column in the spectrogram
-    out_matrix.SetColumn(i, std::move(row_means));
+  // the filter conditions are local to this call, so that several signals can
+  // be built concurrently. Set the filter coefficients and init the filter
+  // conditions to 0. The filter bank and the spectrogram matrix are reused
+  // from the workspace where possible.
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  GammatoneFilterBank filter_bank = scratch->TakeFilterBank(filter_bank_);
+  filter_bank.SetFilterCoefficients(erb_filters->filter_coeffs);
+  filter_bank.ResetFilterConditions();
+  AMatrix<double> out_matrix = scratch->TakeMatrix(filter_bank.GetNumBands(),
+                                                   num_cols);
+
+  // Frames are filtered independently, so any subset of the columns can be
+  // filled. The columns that are not filled are cleared, as the matrix may
+  // have been reused.
+  SpectrogramColumnRanges ranges;
+  size_t num_filled_cols = 0;
+  if (columns == nullptr) {
+    ranges.emplace_back(0, num_cols);
+    num_filled_cols = num_cols;
+  } else {
+    for (const auto &range : *columns) {
+      const size_t end_col = std::min(range.second, num_cols);
+      if (range.first < end_col) {
+        ranges.emplace_back(range.first, end_col);
+        num_filled_cols += end_col - range.first;
+      }
+    }
+    if (num_filled_cols < num_cols) {
+      std::fill(out_matrix.begin(), out_matrix.end(), 0.0);
+    }
   }
 
-  // Order the center freq bands from lowest to highest.
-  std::vector<double> ordered_cfb;
-  ordered_cfb.reserve(erb_rslt.centerFreqs.size());
-  for (auto itr = erb_rslt.centerFreqs.rbegin();
-       itr != erb_rslt.centerFreqs.rend();
-       ++itr) {
-    ordered_cfb.push_back(*itr);
+  // run the windowing. The signal is only copied if the view has silent
+  // samples.
+  const absl::Span<const double> sig_span = signal.ToSpan(scratch);
+  const size_t num_workers = std::min(std::max(num_threads_, size_t{1}),
+                                      std::max(num_filled_cols, size_t{1}));
+  if (num_workers == 1) {
+    BuildRangeColumns(&filter_bank, sig_span, window.size, hop_size, ranges,
+                      0, num_filled_cols, &out_matrix);
+  } else {
+    // Each worker gets its own copy of the filter bank, so that the filter
+    // conditions are not shared between threads.
+    std::vector<GammatoneFilterBank> worker_banks;
+    worker_banks.reserve(num_workers);
+    for (size_t w = 0; w < num_workers; w++) {
+      worker_banks.push_back(scratch->TakeFilterBank(filter_bank));
+    }
+    ParallelExecutor::ForEach(num_workers, num_workers, [&](size_t w) {
+      const size_t first = w * num_filled_cols / num_workers;
+      const size_t end = (w + 1) * num_filled_cols / num_workers;
+      BuildRangeColumns(&worker_banks[w], sig_span, window.size, hop_size,
+                        ranges, first, end, &out_matrix);
+    });
+    for (auto &worker_bank : worker_banks) {
+      scratch->RecycleFilterBank(std::move(worker_bank));
+    }
   }
+  scratch->RecycleFilterBank(std::move(filter_bank));
 
   Spectrogram spectro(std::move(out_matrix));
-  spectro.SetCenterFreqBands(ordered_cfb);
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
   return spectro;
 }
+
+void GammatoneSpectrogramBuilder::BuildRangeColumns(
+    GammatoneFilterBank *filter_bank, absl::Span<const double> signal,
+    size_t window_size, size_t hop_size, const SpectrogramColumnRanges &ranges,
+    size_t first, size_t end, AMatrix<double> *out_matrix) {
+  size_t range_start = 0;
+  for (const auto &range : ranges) {
+    const size_t range_size = range.second - range.first;
+    const size_t share_first = std::max(first, range_start);
+    const size_t share_end = std::min(end, range_start + range_size);
+    if (share_first < share_end) {
+      BuildColumns(filter_bank, signal, window_size, hop_size,
+                   range.first + share_first - range_start,
+                   range.first + share_end - range_start, out_matrix);
+    }
+    range_start += range_size;
+  }
+}
+
+void GammatoneSpectrogramBuilder::BuildColumns(
+    GammatoneFilterBank *filter_bank, absl::Span<const double> signal,
+    size_t window_size, size_t hop_size, size_t first_col, size_t end_col,
+    AMatrix<double> *out_matrix) {
+  const size_t num_bands = out_matrix->NumRows();
+  for (size_t i = first_col; i < end_col; i++) {
+    const size_t start_col = i * hop_size;
+    // select the next frame from the input signal to filter.
+    const auto frame = signal.subspan(start_col, window_size);
+    // apply the filter, accumulating the energy of each band as it goes, and
+    // write the RMS of each band straight into the column of the spectrogram.
+    filter_bank->ResetFilterConditions();
+    filter_bank->ApplyFilterRms(frame, absl::Span<double>(
+        out_matrix->mutData() + i * num_bands, num_bands));
+  }
+}
 }  // namespace Visqol
@@ -0,0 +1,43 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Registers the "cuda" compute backend, which builds the gammatone
+// spectrograms and searches for the patches on a CUDA device. It is linked
+// into the binaries that offer it, which select it with the compute_backend
+// option.
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+
+#include "compute_backend.h"
+#include "cuda_nsim_comparator.h"
+#include "cuda_spectrogram_builder.h"
+#include "gammatone_filterbank.h"
+
+namespace Visqol {
+namespace {
+const bool kRegistered = ComputeBackendRegistry::Register("cuda", {
+    [](size_t num_bands, double min_freq, bool speech_mode)
+        -> std::unique_ptr<SpectrogramBuilder> {
+      return absl::make_unique<CudaSpectrogramBuilder>(
+          GammatoneFilterBank{num_bands, min_freq}, speech_mode);
+    },
+    [](NsimPatchShape patch_shape)
+        -> std::unique_ptr<PatchSimilarityComparator> {
+      return absl::make_unique<CudaNsimComparator>(patch_shape);
+    }});
+}  // namespace
+}  // namespace Visqol
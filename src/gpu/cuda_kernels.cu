@@ -0,0 +1,292 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cuda_kernels.h"
+
+#include <cmath>
+#include <cstddef>
+
+#include <cuda_runtime.h>
+
+namespace Visqol {
+namespace cuda {
+namespace {
+// The number of threads of each block. Neighbouring threads work on
+// neighbouring bands, so their reads of the coefficients and spectrograms are
+// coalesced.
+constexpr int kThreadsPerBlock = 128;
+
+// The layout of the packed cascade coefficients of GammatoneFilterBank: three
+// numerator rows per stage, followed by the two shared denominator rows.
+constexpr int kNumStages = 4;
+constexpr int kDenom1Row = kNumStages * 3;
+constexpr int kDenom2Row = kDenom1Row + 1;
+
+int NumBlocks(size_t num_threads) {
+  return static_cast<int>((num_threads + kThreadsPerBlock - 1) /
+                          kThreadsPerBlock);
+}
+
+// Each thread filters one band of one frame, from silent filter conditions,
+// as GammatoneSpectrogramBuilder does on the CPU. The stages are direct-form
+// II transposed biquads, evaluated in the order of the SIMD kernels.
+__global__ void GammatoneFrameRmsKernel(const double *coeffs, int num_bands,
+                                        const double *signal, int window_size,
+                                        int hop_size, int num_cols,
+                                        double *out) {
+  const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+  if (idx >= num_bands * num_cols) {
+    return;
+  }
+  const int band = idx % num_bands;
+  const int col = idx / num_bands;
+  double n0[kNumStages], n1[kNumStages], n2[kNumStages];
+  double z0[kNumStages], z1[kNumStages];
+  for (int s = 0; s < kNumStages; s++) {
+    n0[s] = coeffs[(s * 3) * num_bands + band];
+    n1[s] = coeffs[(s * 3 + 1) * num_bands + band];
+    n2[s] = coeffs[(s * 3 + 2) * num_bands + band];
+    z0[s] = 0.0;
+    z1[s] = 0.0;
+  }
+  const double d1 = coeffs[kDenom1Row * num_bands + band];
+  const double d2 = coeffs[kDenom2Row * num_bands + band];
+
+  const double *frame = signal + static_cast<size_t>(col) * hop_size;
+  double energy = 0.0;
+  for (int i = 0; i < window_size; i++) {
+    double x = frame[i];
+    for (int s = 0; s < kNumStages; s++) {
+      const double y = n0[s] * x + z0[s];
+      z0[s] = (n1[s] * x + z1[s]) - d1 * y;
+      z1[s] = n2[s] * x - d2 * y;
+      x = y;
+    }
+    energy = energy + x * x;
+  }
+  out[idx] = sqrt(energy / window_size);
+}
+
+// The separable 3x3 gaussian window of NSIM: the taps [a b a] of each pass,
+// and the excess weight of their outer product at the center.
+struct NsimFilter {
+  double a;
+  double b;
+  double center_excess;
+};
+
+// The five local sums that NSIM is calculated from, at one point of a patch
+// pair.
+struct NsimTerms {
+  double ref;
+  double deg;
+  double ref_sq;
+  double deg_sq;
+  double ref_deg;
+};
+
+// A degraded patch at an offset of the degraded spectrogram, which is silent
+// outside of the spectrogram.
+struct DegPatch {
+  const double *deg;
+  int num_rows;
+  int num_deg_cols;
+  int offset;
+
+  __device__ double operator()(int row, int col) const {
+    const int deg_col = offset + col;
+    return (deg_col < 0 || deg_col >= num_deg_cols) ? 0.0 :
+        deg[deg_col * num_rows + row];
+  }
+};
+
+// The column pass at one point, with the first and last bands replicated, in
+// the order of ColumnTerms of the CPU comparator.
+__device__ NsimTerms ColumnTerms(const double *ref, const DegPatch &deg,
+                                 const NsimFilter &filter, int row, int col) {
+  const int num_rows = deg.num_rows;
+  const double taps[3] = {filter.a, filter.b, filter.a};
+  NsimTerms t{0, 0, 0, 0, 0};
+  for (int k = 0; k < 3; k++) {
+    const int in_row = min(max(row + k - 1, 0), num_rows - 1);
+    const double x_r = ref[col * num_rows + in_row];
+    const double x_d = deg(in_row, col);
+    const double tap = taps[2 - k];
+    t.ref += x_r * tap;
+    t.deg += x_d * tap;
+    t.ref_sq += (x_r * x_r) * tap;
+    t.deg_sq += (x_d * x_d) * tap;
+    t.ref_deg += (x_r * x_d) * tap;
+  }
+  return t;
+}
+
+// The row pass over the column terms of the neighbouring columns, less the
+// excess weight at the center.
+__device__ double RowPass(double before, double at, double after,
+                          double center, const NsimFilter &filter) {
+  double sum = 0;
+  sum += before * filter.a;
+  sum += at * filter.b;
+  sum += after * filter.a;
+  return sum - filter.center_excess * center;
+}
+
+__device__ double PointSimilarity(const NsimTerms &local, double c1,
+                                  double c3) {
+  const double ref_mu_sq = local.ref * local.ref;
+  const double deg_mu_sq = local.deg * local.deg;
+  const double mu_r_mu_d = local.ref * local.deg;
+  const double sigma_r_sq = local.ref_sq - ref_mu_sq;
+  const double sigma_d_sq = local.deg_sq - deg_mu_sq;
+  const double sigma_r_d = local.ref_deg - mu_r_mu_d;
+  const double intensity = (mu_r_mu_d * 2 + c1) /
+      (ref_mu_sq + deg_mu_sq + c1);
+  const double d = sigma_r_sq * sigma_d_sq;
+  const double structure_denom = (d < 0) ? c3 : (sqrt(d) + c3);
+  const double structure = (sigma_r_d + c3) / structure_denom;
+  return intensity * structure;
+}
+
+// Each thread measures the mean similarity of one band of the patch pair at
+// one offset, with the patch boundary replicated.
+__global__ void NsimAtOffsetsKernel(const double *ref, int num_rows,
+                                    int num_cols, const double *deg,
+                                    int num_deg_cols, const int *offsets,
+                                    int num_offsets, NsimFilter filter,
+                                    double c1, double c3,
+                                    double *band_means) {
+  const int idx = blockIdx.x * blockDim.x + threadIdx.x;
+  if (idx >= num_rows * num_offsets) {
+    return;
+  }
+  const int row = idx % num_rows;
+  const DegPatch deg_patch{deg, num_rows, num_deg_cols,
+                           offsets[idx / num_rows]};
+  NsimTerms before = ColumnTerms(ref, deg_patch, filter, row, 0);
+  NsimTerms at = before;
+  double row_sum = 0;
+  for (int c = 0; c < num_cols; c++) {
+    const NsimTerms after = c + 1 < num_cols ?
+        ColumnTerms(ref, deg_patch, filter, row, c + 1) : at;
+    const double x_r = ref[c * num_rows + row];
+    const double x_d = deg_patch(row, c);
+    NsimTerms local;
+    local.ref = RowPass(before.ref, at.ref, after.ref, x_r, filter);
+    local.deg = RowPass(before.deg, at.deg, after.deg, x_d, filter);
+    local.ref_sq = RowPass(before.ref_sq, at.ref_sq, after.ref_sq, x_r * x_r,
+                           filter);
+    local.deg_sq = RowPass(before.deg_sq, at.deg_sq, after.deg_sq, x_d * x_d,
+                           filter);
+    local.ref_deg = RowPass(before.ref_deg, at.ref_deg, after.ref_deg,
+                            x_r * x_d, filter);
+    row_sum += PointSimilarity(local, c1, c3);
+    before = at;
+    at = after;
+  }
+  band_means[idx] = row_sum / num_cols;
+}
+}  // namespace
+
+bool IsAvailable() {
+  static const bool available = [] {
+    int num_devices = 0;
+    return cudaGetDeviceCount(&num_devices) == cudaSuccess && num_devices > 0;
+  }();
+  return available;
+}
+
+template <typename T>
+DeviceBuffer<T>::~DeviceBuffer() {
+  cudaFree(data_);
+}
+
+template <typename T>
+bool DeviceBuffer<T>::Reserve(size_t size) {
+  if (size <= capacity_) {
+    return true;
+  }
+  cudaFree(data_);
+  data_ = nullptr;
+  capacity_ = 0;
+  if (cudaMalloc(&data_, size * sizeof(T)) != cudaSuccess) {
+    data_ = nullptr;
+    return false;
+  }
+  capacity_ = size;
+  return true;
+}
+
+template <typename T>
+bool DeviceBuffer<T>::Upload(const T *values, size_t size) {
+  return Reserve(size) && (size == 0 || cudaMemcpy(data_, values,
+      size * sizeof(T), cudaMemcpyHostToDevice) == cudaSuccess);
+}
+
+template <typename T>
+bool DeviceBuffer<T>::Download(T *values, size_t size) const {
+  return size <= capacity_ && (size == 0 || cudaMemcpy(values, data_,
+      size * sizeof(T), cudaMemcpyDeviceToHost) == cudaSuccess);
+}
+
+template class DeviceBuffer<double>;
+template class DeviceBuffer<int>;
+
+bool GammatoneFrameRms(const DeviceBuffer<double> &coeffs, size_t num_bands,
+                       const DeviceBuffer<double> &signal, size_t window_size,
+                       size_t hop_size, size_t num_cols,
+                       DeviceBuffer<double> *out) {
+  const size_t num_threads = num_bands * num_cols;
+  if (num_threads == 0) {
+    return true;
+  }
+  if (!out->Reserve(num_threads)) {
+    return false;
+  }
+  GammatoneFrameRmsKernel<<<NumBlocks(num_threads), kThreadsPerBlock>>>(
+      coeffs.data(), static_cast<int>(num_bands), signal.data(),
+      static_cast<int>(window_size), static_cast<int>(hop_size),
+      static_cast<int>(num_cols), out->data());
+  return cudaGetLastError() == cudaSuccess;
+}
+
+bool NsimAtOffsets(const DeviceBuffer<double> &ref_patch, size_t num_rows,
+                   size_t num_cols, const DeviceBuffer<double> &deg,
+                   size_t num_deg_cols, const DeviceBuffer<int> &offsets,
+                   size_t num_offsets, double c1, double c3,
+                   DeviceBuffer<double> *band_means) {
+  const size_t num_threads = num_rows * num_offsets;
+  if (num_threads == 0 || num_cols == 0) {
+    return true;
+  }
+  if (!band_means->Reserve(num_threads)) {
+    return false;
+  }
+  // The taps are derived from the window exactly as on the CPU.
+  const double corner = 0.0113033910173052;
+  const double edge = 0.0838251475442633;
+  const double center = 0.619485845753726;
+  const double a = std::sqrt(corner);
+  const double b = edge / a;
+  const NsimFilter filter{a, b, b * b - center};
+  NsimAtOffsetsKernel<<<NumBlocks(num_threads), kThreadsPerBlock>>>(
+      ref_patch.data(), static_cast<int>(num_rows),
+      static_cast<int>(num_cols), deg.data(), static_cast<int>(num_deg_cols),
+      offsets.data(), static_cast<int>(num_offsets), filter, c1, c3,
+      band_means->data());
+  return cudaGetLastError() == cudaSuccess;
+}
+}  // namespace cuda
+}  // namespace Visqol
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_GPU_CUDA_KERNELS_H
+#define VISQOL_GPU_CUDA_KERNELS_H
+
+#include <cstddef>
+
+namespace Visqol {
+namespace cuda {
+/**
+ * Whether a CUDA device can be used by this process. The kernels below fail
+ * if it cannot, and their callers fall back to the CPU.
+ *
+ * @return True if there is a device.
+ */
+bool IsAvailable();
+
+/**
+ * A buffer in the memory of the CUDA device. The buffer only grows, so that a
+ * buffer that is reused for inputs of the same size is allocated once.
+ *
+ * @tparam T The type of the values, either double or int.
+ */
+template <typename T>
+class DeviceBuffer {
+ public:
+  DeviceBuffer() = default;
+  ~DeviceBuffer();
+  DeviceBuffer(const DeviceBuffer &) = delete;
+  DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+  /**
+   * Make the buffer hold at least the given number of values. The values are
+   * not kept if the buffer grows.
+   *
+   * @param size The number of values.
+   *
+   * @return True if the buffer could be allocated.
+   */
+  bool Reserve(size_t size);
+
+  /**
+   * Copy values from the host into the start of the buffer, growing it if
+   * needed.
+   *
+   * @param values The values to copy.
+   * @param size The number of values.
+   *
+   * @return True if the values were copied.
+   */
+  bool Upload(const T *values, size_t size);
+
+  /**
+   * Copy values from the start of the buffer to the host.
+   *
+   * @param values The host memory to copy the values to.
+   * @param size The number of values.
+   *
+   * @return True if the values were copied.
+   */
+  bool Download(T *values, size_t size) const;
+
+  /**
+   * @return The device pointer to the values.
+   */
+  T *data() const { return data_; }
+
+ private:
+  /**
+   * The values, in device memory.
+   */
+  T *data_ = nullptr;
+
+  /**
+   * The number of values that the buffer can hold.
+   */
+  size_t capacity_ = 0;
+};
+
+/**
+ * Filter each frame of a signal with the gammatone filter cascade, starting
+ * from silent filter conditions, and write the RMS of each band of each
+ * frame. Each band of each frame is filtered by its own thread. The cascade
+ * is evaluated in the same order as SimdKernels::gammatone_energy, so the
+ * values only differ from those of the CPU by the rounding of the device.
+ *
+ * @param coeffs The packed cascade coefficients of
+ *    GammatoneFilterBank::GetCascadeCoefficients.
+ * @param num_bands The number of bands.
+ * @param signal The samples of the signal.
+ * @param window_size The number of samples of each frame.
+ * @param hop_size The number of samples between the starts of the frames.
+ * @param num_cols The number of frames.
+ * @param out The RMS of each band of each frame, column major with a row per
+ *    band. It must hold num_bands * num_cols values.
+ *
+ * @return True if the kernel ran.
+ */
+bool GammatoneFrameRms(const DeviceBuffer<double> &coeffs, size_t num_bands,
+                       const DeviceBuffer<double> &signal, size_t window_size,
+                       size_t hop_size, size_t num_cols,
+                       DeviceBuffer<double> *out);
+
+/**
+ * Measure the NSIM of a reference patch with the degraded patch at each of
+ * the given offsets of a degraded spectrogram, as
+ * NeurogramSimiliarityIndexMeasure does. Each band of each offset is compared
+ * by its own thread, so every offset of a patch is compared at once. The
+ * degraded patches are silent where they extend past either end of the
+ * spectrogram.
+ *
+ * @param ref_patch The reference patch, column major.
+ * @param num_rows The number of bands of the patches and the spectrogram.
+ * @param num_cols The number of frames of the patches.
+ * @param deg The degraded spectrogram, column major.
+ * @param num_deg_cols The number of frames of the degraded spectrogram.
+ * @param offsets The columns of the degraded spectrogram that the degraded
+ *    patches start at, which may be negative.
+ * @param num_offsets The number of offsets.
+ * @param c1 The constant that stabilizes the intensity term.
+ * @param c3 The constant that stabilizes the structure term.
+ * @param band_means The mean similarity of each band of each offset, with
+ *    num_rows values per offset. It must hold num_rows * num_offsets values.
+ *
+ * @return True if the kernel ran.
+ */
+bool NsimAtOffsets(const DeviceBuffer<double> &ref_patch, size_t num_rows,
+                   size_t num_cols, const DeviceBuffer<double> &deg,
+                   size_t num_deg_cols, const DeviceBuffer<int> &offsets,
+                   size_t num_offsets, double c1, double c3,
+                   DeviceBuffer<double> *band_means);
+}  // namespace cuda
+}  // namespace Visqol
+
+#endif  // VISQOL_GPU_CUDA_KERNELS_H
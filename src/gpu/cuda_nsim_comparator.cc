@@ -0,0 +1,133 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cuda_nsim_comparator.h"
+
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+
+namespace Visqol {
+
+CudaNsimComparator::CudaNsimComparator(NsimPatchShape patch_shape)
+    : cpu_comparator_(false, patch_shape) {}
+
+PatchSimilarityResult CudaNsimComparator::MeasurePatchSimilarity(
+    const PatchView &ref_patch, const PatchView &deg_patch) const {
+  return cpu_comparator_.MeasurePatchSimilarity(ref_patch, deg_patch);
+}
+
+std::vector<PatchSimilarityResult> CudaNsimComparator::MeasurePatchSimilarities(
+    const PatchView &ref_patch, absl::Span<const PatchView> deg_patches) const {
+  return cpu_comparator_.MeasurePatchSimilarities(ref_patch, deg_patches);
+}
+
+std::unique_ptr<SlidingPatchComparator>
+CudaNsimComparator::CreateSlidingComparator(
+    const AMatrix<double> &deg_spectrogram, size_t num_patch_frames) const {
+  std::unique_ptr<SlidingPatchComparator> cpu_sliding =
+      cpu_comparator_.CreateSlidingComparator(deg_spectrogram,
+                                              num_patch_frames);
+  if (!cuda::IsAvailable()) {
+    return cpu_sliding;
+  }
+  auto sliding = absl::make_unique<CudaSlidingNsimComparator>(
+      deg_spectrogram, std::move(cpu_sliding));
+  if (!sliding->ok()) {
+    ABSL_RAW_LOG(WARNING, "The degraded spectrogram could not be copied to"
+                 " the CUDA device, so it is searched on the CPU.");
+    return cpu_comparator_.CreateSlidingComparator(deg_spectrogram,
+                                                   num_patch_frames);
+  }
+  return sliding;
+}
+
+CudaSlidingNsimComparator::CudaSlidingNsimComparator(
+    const AMatrix<double> &deg_spectrogram,
+    std::unique_ptr<SlidingPatchComparator> cpu_comparator)
+    : num_rows_(deg_spectrogram.NumRows()),
+      num_cols_(deg_spectrogram.NumCols()),
+      cpu_comparator_(std::move(cpu_comparator)) {
+  ok_ = deg_spectrogram_.Upload(deg_spectrogram.data(),
+                                deg_spectrogram.NumElements());
+  std::vector<double> k{0.01, 0.03};
+  const double intensity_range = 1.0;
+  c1_ = pow(k[0] * intensity_range, 2);
+  c3_ = pow(k[1] * intensity_range, 2) / 2;
+}
+
+std::vector<PatchSimilarityResult>
+CudaSlidingNsimComparator::MeasurePatchSimilarityAtOffsets(
+    const PatchView &ref_patch, const std::vector<int> &offsets,
+    VisqolWorkspace *workspace) const {
+  std::vector<PatchSimilarityResult> results;
+  if (offsets.empty()) {
+    return results;
+  }
+  const size_t num_rows = ref_patch.NumRows();
+  const size_t num_cols = ref_patch.NumCols();
+  if (num_rows != num_rows_) {
+    return cpu_comparator_->MeasurePatchSimilarityAtOffsets(ref_patch,
+                                                            offsets,
+                                                            workspace);
+  }
+
+  // The reference patch is copied out column major, with silence where it
+  // extends past its spectrogram, as the view reads it.
+  std::vector<double> ref_values(num_rows * num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_values[c * num_rows + r] = ref_patch(r, c);
+    }
+  }
+
+  // The device buffers of each thread are kept for its next patch.
+  thread_local cuda::DeviceBuffer<double> ref_buffer;
+  thread_local cuda::DeviceBuffer<int> offsets_buffer;
+  thread_local cuda::DeviceBuffer<double> band_means_buffer;
+  std::vector<double> band_means(num_rows * offsets.size());
+  if (!ref_buffer.Upload(ref_values.data(), ref_values.size()) ||
+      !offsets_buffer.Upload(offsets.data(), offsets.size()) ||
+      !cuda::NsimAtOffsets(ref_buffer, num_rows, num_cols, deg_spectrogram_,
+                           num_cols_, offsets_buffer, offsets.size(), c1_,
+                           c3_, &band_means_buffer) ||
+      !band_means_buffer.Download(band_means.data(), band_means.size())) {
+    ABSL_RAW_LOG(WARNING, "The CUDA patch search failed, so the patch is"
+                 " searched for on the CPU.");
+    return cpu_comparator_->MeasurePatchSimilarityAtOffsets(ref_patch,
+                                                            offsets,
+                                                            workspace);
+  }
+
+  results.reserve(offsets.size());
+  for (size_t i = 0; i < offsets.size(); i++) {
+    AMatrix<double> freq_band_means(num_rows, 1);  // A.K.A. FVNSIM
+    double freq_band_sim_sum = 0;
+    for (size_t r = 0; r < num_rows; r++) {
+      freq_band_means(r) = band_means[i * num_rows + r];
+      freq_band_sim_sum += freq_band_means(r);
+    }
+    PatchSimilarityResult result;
+    result.similarity = freq_band_sim_sum / num_rows;  // A.K.A. NSIM
+    result.freq_band_means = std::move(freq_band_means);
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+}  // namespace Visqol
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_GPU_CUDA_NSIM_COMPARATOR_H
+#define VISQOL_GPU_CUDA_NSIM_COMPARATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "amatrix.h"
+#include "cuda_kernels.h"
+#include "neurogram_similiarity_index_measure.h"
+#include "patch_similarity_comparator.h"
+#include "patch_view.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+/**
+ * An NSIM patch comparator whose patch search runs on a CUDA device. Every
+ * offset of a reference patch is compared at once, a thread per band of each
+ * offset. The single patch pairs of the fine realignment are compared on the
+ * CPU, by NeurogramSimiliarityIndexMeasure. The similarities match those of
+ * the CPU up to the rounding of the device.
+ */
+class CudaNsimComparator : public PatchSimilarityComparator {
+ public:
+  /**
+   * Constructs the comparator.
+   *
+   * @param patch_shape The shape of the patches that are compared, which the
+   *    loops of the CPU comparator are specialized for.
+   */
+  explicit CudaNsimComparator(NsimPatchShape patch_shape);
+
+  // Docs inherited from parent.
+  PatchSimilarityResult MeasurePatchSimilarity(const PatchView &ref_patch,
+                                               const PatchView &deg_patch)
+                                               const override;
+
+  // Docs inherited from parent.
+  std::vector<PatchSimilarityResult> MeasurePatchSimilarities(
+      const PatchView &ref_patch, absl::Span<const PatchView> deg_patches)
+      const override;
+
+  /**
+   * Create a comparator that searches the degraded spectrogram on the device,
+   * or on the CPU if there is no device or the spectrogram could not be
+   * copied to it.
+   */
+  std::unique_ptr<SlidingPatchComparator> CreateSlidingComparator(
+      const AMatrix<double> &deg_spectrogram,
+      size_t num_patch_frames = 0) const override;
+
+ private:
+  /**
+   * Compares the single patch pairs, and searches when the device cannot.
+   */
+  const NeurogramSimiliarityIndexMeasure cpu_comparator_;
+};
+
+/**
+ * A sliding NSIM comparator over a degraded spectrogram that is copied to the
+ * CUDA device once, when it is created.
+ */
+class CudaSlidingNsimComparator : public SlidingPatchComparator {
+ public:
+  /**
+   * Constructs the comparator. Use ok() to check that the spectrogram was
+   * copied to the device.
+   *
+   * @param deg_spectrogram The degraded spectrogram.
+   * @param cpu_comparator The comparator that the offsets are compared with
+   *    if a kernel fails.
+   */
+  CudaSlidingNsimComparator(
+      const AMatrix<double> &deg_spectrogram,
+      std::unique_ptr<SlidingPatchComparator> cpu_comparator);
+
+  /**
+   * @return True if the degraded spectrogram is on the device.
+   */
+  bool ok() const { return ok_; }
+
+  // Docs inherited from parent.
+  std::vector<PatchSimilarityResult> MeasurePatchSimilarityAtOffsets(
+      const PatchView &ref_patch, const std::vector<int> &offsets,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The degraded spectrogram, in device memory.
+   */
+  cuda::DeviceBuffer<double> deg_spectrogram_;
+
+  /**
+   * The numbers of bands and frames of the degraded spectrogram.
+   */
+  size_t num_rows_;
+  size_t num_cols_;
+
+  /**
+   * True if the degraded spectrogram was copied to the device.
+   */
+  bool ok_;
+
+  /**
+   * The CPU comparator of the same spectrogram.
+   */
+  std::unique_ptr<SlidingPatchComparator> cpu_comparator_;
+
+  /**
+   * The constants that stabilize the intensity and structure terms.
+   */
+  double c1_;
+  double c3_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_GPU_CUDA_NSIM_COMPARATOR_H
@@ -0,0 +1,88 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cuda_spectrogram_builder.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/types/span.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "cuda_kernels.h"
+#include "erb_filter_cache.h"
+#include "spectrogram.h"
+
+namespace Visqol {
+
+CudaSpectrogramBuilder::CudaSpectrogramBuilder(
+    const GammatoneFilterBank &filter_bank, bool use_speech_mode)
+    : filter_bank_(filter_bank), speech_mode_(use_speech_mode),
+      cpu_builder_(filter_bank, use_speech_mode) {}
+
+google::protobuf::util::StatusOr<Spectrogram> CudaSpectrogramBuilder::Build(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  const size_t hop_size = window.size * window.overlap;
+  // The CPU builder reports the signals that are too short.
+  if (!cuda::IsAvailable() || num_samples <= window.size) {
+    return cpu_builder_.Build(signal, window, workspace);
+  }
+  const size_t sample_rate = signal.SampleRate();
+  const double max_freq = speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
+  std::shared_ptr<const ErbFilterSet> erb_filters = ErbFilterCache::GetFilters(
+      sample_rate, filter_bank_.GetNumBands(), filter_bank_.GetMinFreq(),
+      max_freq);
+  GammatoneFilterBank filter_bank = filter_bank_;
+  filter_bank.SetFilterCoefficients(erb_filters->filter_coeffs);
+  const std::vector<double> &coeffs = filter_bank.GetCascadeCoefficients();
+  const size_t num_bands = filter_bank.GetNumBands();
+  const size_t num_cols = 1 + (num_samples - window.size) / hop_size;
+
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  const absl::Span<const double> samples = signal.ToSpan(scratch);
+  AMatrix<double> out_matrix = scratch->TakeMatrix(num_bands, num_cols);
+
+  // The device buffers of each thread are kept for its next build, so that
+  // builds of signals of the same length do not reallocate them.
+  thread_local cuda::DeviceBuffer<double> coeffs_buffer;
+  thread_local cuda::DeviceBuffer<double> signal_buffer;
+  thread_local cuda::DeviceBuffer<double> out_buffer;
+  if (!coeffs_buffer.Upload(coeffs.data(), coeffs.size()) ||
+      !signal_buffer.Upload(samples.data(), samples.size()) ||
+      !cuda::GammatoneFrameRms(coeffs_buffer, num_bands, signal_buffer,
+                               window.size, hop_size, num_cols,
+                               &out_buffer) ||
+      !out_buffer.Download(out_matrix.mutData(), num_bands * num_cols)) {
+    ABSL_RAW_LOG(WARNING, "The CUDA spectrogram build failed, so it is built"
+                 " on the CPU.");
+    scratch->RecycleMatrix(std::move(out_matrix));
+    return cpu_builder_.Build(signal, window, workspace);
+  }
+
+  Spectrogram spectro(std::move(out_matrix));
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
+  return spectro;
+}
+}  // namespace Visqol
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_GPU_CUDA_SPECTROGRAM_BUILDER_H
+#define VISQOL_GPU_CUDA_SPECTROGRAM_BUILDER_H
+
+#include "gammatone_filterbank.h"
+#include "gammatone_spectrogram_builder.h"
+#include "spectrogram_builder.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+/**
+ * Builds gammatone spectrograms on a CUDA device. The frames are filtered
+ * independently, so every band of every frame is filtered by its own thread.
+ * The spectrograms match those of GammatoneSpectrogramBuilder up to the
+ * rounding of the device. If there is no device, or a kernel fails, the
+ * spectrogram is built on the CPU instead.
+ */
+class CudaSpectrogramBuilder : public SpectrogramBuilder {
+ public:
+  /**
+   * Constructs the builder.
+   *
+   * @param filter_bank The gammatone filter bank to apply to the signal.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   */
+  CudaSpectrogramBuilder(const GammatoneFilterBank &filter_bank,
+                         bool use_speech_mode);
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The filter bank that the coefficients of each build are set on.
+   */
+  const GammatoneFilterBank filter_bank_;
+
+  /**
+   * If true, the spectrograms are built for speech mode.
+   */
+  const bool speech_mode_;
+
+  /**
+   * Builds the spectrograms when the device cannot.
+   */
+  const GammatoneSpectrogramBuilder cpu_builder_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_GPU_CUDA_SPECTROGRAM_BUILDER_H
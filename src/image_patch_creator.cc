@@ -14,7 +14,6 @@
 
 #include "image_patch_creator.h"
 
-#include <utility>
 #include <vector>
 
 #include "absl/base/internal/raw_logging.h"
@@ -23,6 +22,7 @@
 #include "amatrix.h"
 #include "analysis_window.h"
 #include "audio_signal.h"
+#include "patch_view.h"
 
 namespace Visqol {
 google::protobuf::util::StatusOr<std::vector<size_t>>
@@ -32,22 +32,32 @@ google::protobuf::util::StatusOr<std::vector<size_t>>
   return CreateRefPatchIndices(spectrogram);
 }
 
-std::vector<ImagePatch> ImagePatchCreator::CreatePatchesFromIndices(
+std::vector<PatchView> ImagePatchCreator::CreatePatchesFromIndices(
     const AMatrix<double> &spectrogram,
     const std::vector<size_t> &patch_indices) const {
-  size_t start_col, end_col;
-  size_t num_patches = patch_indices.size();
-  std::vector<ImagePatch> patches;
-  ImagePatch patch;
-  for (size_t i = 0; i < num_patches; i++) {
-    start_col = *(patch_indices.begin() + i);
-    end_col = start_col + patch_size_ - 1;
-    patch = spectrogram.GetColumns(start_col, end_col);
-    patches.push_back(std::move(patch));
+  std::vector<PatchView> patches;
+  patches.reserve(patch_indices.size());
+  for (const size_t start_col : patch_indices) {
+    patches.emplace_back(spectrogram, start_col, patch_size_);
   }
   return patches;
 }
 
+std::vector<size_t> ImagePatchCreator::SelectPatchIndices(
+    const std::vector<size_t> &patch_indices) const {
+  if (max_patches_ == 0 || patch_indices.size() <= max_patches_) {
+    return patch_indices;
+  }
+  // Take the patch at the middle of each of max_patches_ equal stretches.
+  std::vector<size_t> selected;
+  selected.reserve(max_patches_);
+  for (size_t i = 0; i < max_patches_; i++) {
+    selected.push_back(patch_indices[(2 * i + 1) * patch_indices.size() /
+                                     (2 * max_patches_)]);
+  }
+  return selected;
+}
+
 google::protobuf::util::StatusOr<std::vector<size_t>>
     ImagePatchCreator::CreateRefPatchIndices(
         const AMatrix<double> &spectrogram) const {
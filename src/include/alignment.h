@@ -17,7 +17,13 @@
 #ifndef VISQOL_INCLUDE_ALIGNMENT_H
 #define VISQOL_INCLUDE_ALIGNMENT_H
 
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
 #include <utility>
+#include <vector>
+
+#include "audio_signal_view.h"
 
 namespace Visqol {
 struct AudioSignal;
@@ -28,6 +34,24 @@ struct AudioSignal;
  */
 class Alignment {
  public:
+  /**
+   * The factor that the envelopes are decimated by between two levels of the
+   * multi-resolution alignment.
+   */
+  static const size_t kDecimationPerLevel;
+
+  /**
+   * The number of decimated levels of the multi-resolution alignment.
+   */
+  static const size_t kNumDecimatedLevels;
+
+  /**
+   * The minimum number of samples in the most decimated envelope for the
+   * multi-resolution alignment to be used. Shorter signals are aligned at the
+   * native sample rate.
+   */
+  static const size_t kMinDecimatedSamples;
+
   /**
    * For a given reference signal, align a second degraded signal with it,
    * returning a new aligned degraded signal.
@@ -38,6 +62,41 @@ class Alignment {
    */
   static std::tuple<AudioSignal, double> GloballyAlign(
       const AudioSignal &ref_signal, const AudioSignal &deg_signal);
+  /**
+   * For a given reference signal, align a second degraded signal with it,
+   * searching for the lag coarse to fine. The upper envelopes are decimated
+   * by kDecimationPerLevel per level, and the lag is searched over the full
+   * range on the most decimated envelopes only. Each finer level only
+   * searches the lags around the lag of the level above, down to the native
+   * sample rate. This avoids the full length cross correlation FFT, which
+   * dominates the time and memory of GloballyAlign for long signals. The lag
+   * found may differ from that of GloballyAlign when the correlation has
+   * several peaks of similar height.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal to align.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  static std::tuple<AudioSignal, double> GloballyAlignMultiResolution(
+      const AudioSignal &ref_signal, const AudioSignal &deg_signal);
+
+  /**
+   * For a given reference signal, align a second degraded signal with it,
+   * only searching the lags around an expected lag. If the best lag found is
+   * at the edge of the searched lags, the best lag may lie beyond them, so
+   * every lag is searched as GloballyAlign does.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal to align.
+   * @param lag_hint The expected lag of the degraded signal, in samples.
+   * @param max_offset The maximum difference from the expected lag that is
+   *   searched, in samples. Must be above 0.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  static std::tuple<AudioSignal, double> GloballyAlignAroundLag(
+      const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+      int64_t lag_hint, int64_t max_offset);
+
   /**
    * Aligns a degraded signal to the reference signal, truncating them to
    * be the same length.
@@ -50,6 +109,122 @@ class Alignment {
    **/
   static std::tuple<AudioSignal, AudioSignal, double> AlignAndTruncate(
       const AudioSignal &ref_signal, const AudioSignal &deg_signal);
+
+  /**
+   * Aligns a degraded signal to the reference signal, truncating them to
+   * be the same length, without copying the samples of either signal.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @return A std::tuple of two views of the aligned and truncated signals
+   *   and the lag of the degraded, as for the AudioSignal overload. The views
+   *   see the same signals as the input views.
+   **/
+  static std::tuple<AudioSignalView, AudioSignalView, double> AlignAndTruncate(
+      const AudioSignalView &ref_signal, const AudioSignalView &deg_signal);
+
+  /**
+   * For a given reference signal, align a second degraded signal with it,
+   * only searching lags of up to half the reference. GloballyAlign ignores
+   * the larger lags anyway, so this is cheaper, as the correlation is
+   * computed directly or with an FFT sized for the lag range. It only differs
+   * from GloballyAlign where the best lag overall is beyond half the
+   * reference, in which case GloballyAlign does not align, while this aligns
+   * to the best lag within the range.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal to align.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  static std::tuple<AudioSignal, double> GloballyAlignBounded(
+      const AudioSignal &ref_signal, const AudioSignal &deg_signal);
+
+  /**
+   * Aligns a degraded signal to the reference signal, only searching lags of
+   * up to half the reference as GloballyAlignBounded does, and truncates them
+   * to be the same length as AlignAndTruncate does.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @return A std::tuple of two views of the aligned and truncated signals
+   *   and the lag of the degraded.
+   **/
+  static std::tuple<AudioSignalView, AudioSignalView, double>
+      AlignAndTruncateBounded(const AudioSignalView &ref_signal,
+                              const AudioSignalView &deg_signal);
+
+  /**
+   * Aligns and truncates each pair in a batch of reference and degraded
+   * signal pairs, with the same result as calling AlignAndTruncate (or
+   * AlignAndTruncateBounded) on each pair. The pairs are split into one chunk
+   * per worker, and the correlations of each chunk are calculated as a batch
+   * that shares its FFT managers and buffers.
+   *
+   * @param signal_pairs The reference and degraded signal of each pair.
+   * @param bounded If true, only lags of up to half the reference are
+   *   searched, as for AlignAndTruncateBounded.
+   * @param num_workers The maximum number of threads to align the pairs on.
+   * @return A std::tuple of two views of the aligned and truncated signals
+   *   and the lag of the degraded for each pair, in the order of the pairs.
+   **/
+  static std::vector<std::tuple<AudioSignalView, AudioSignalView, double>>
+      AlignAndTruncateBatch(
+          const std::vector<std::pair<AudioSignalView, AudioSignalView>>
+              &signal_pairs,
+          bool bounded, size_t num_workers);
+
+  /**
+   * Shift a degraded signal by the best lag found against a reference signal.
+   * Lags of more than half the reference are ignored.
+   *
+   * @param deg_signal The degraded signal to align.
+   * @param best_lag The lag of the degraded signal, in samples.
+   * @param ref_num_samples The number of samples in the reference signal.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  static std::tuple<AudioSignal, double> ApplyGlobalLag(
+      const AudioSignal &deg_signal, int64_t best_lag,
+      size_t ref_num_samples);
+
+ private:
+  /**
+   * Truncate a reference signal and its aligned degraded signal to be the
+   * same length.
+   *
+   * @param ref_signal The reference signal.
+   * @param alignment_result The aligned degraded signal and its lag in
+   *    seconds.
+   * @return A std::tuple of two views of the truncated signals and the lag of
+   *    the degraded.
+   */
+  static std::tuple<AudioSignalView, AudioSignalView, double> Truncate(
+      const AudioSignalView &ref_signal,
+      const std::tuple<AudioSignalView, double> &alignment_result);
+
+  /**
+   * Shift a view of a degraded signal by the best lag found against a
+   * reference signal, as ApplyGlobalLag does, without copying the samples.
+   *
+   * @param deg_signal The degraded signal to align.
+   * @param best_lag The lag of the degraded signal, in samples.
+   * @param ref_num_samples The number of samples in the reference signal.
+   * @return A tuple of the view of the aligned degraded signal and its lag in
+   *    seconds.
+   */
+  static std::tuple<AudioSignalView, double> ShiftByLag(
+      const AudioSignalView &deg_signal, int64_t best_lag,
+      size_t ref_num_samples);
+
+  /**
+   * Decimate an envelope by averaging each block of samples. The envelope is
+   * band limited, so the averaging is enough to prevent aliasing.
+   *
+   * @param envelope The envelope to decimate.
+   * @param factor The decimation factor.
+   * @return The decimated envelope.
+   */
+  static std::vector<double> Decimate(const std::vector<double> &envelope,
+                                      size_t factor);
 };
 }  // namespace Visqol
 
@@ -45,6 +45,7 @@ class AMatrix {
   AMatrix<T>() {}
   AMatrix<T>(const arma::Mat<T> &mat);
   AMatrix<T>(const AMatrix<T> &other);
+  AMatrix<T>(AMatrix<T> &&other) noexcept;
   AMatrix<T>(const std::vector<T> &col);
   AMatrix<T>(const absl::Span<T>& col);
   AMatrix<T>(const std::valarray<T> &va);
@@ -59,16 +60,35 @@ class AMatrix {
   T operator()(size_t elementIndex) const;
   bool operator==(const AMatrix<T> &other) const;
   AMatrix<T> &operator=(const AMatrix<T> &other);
+  AMatrix<T> &operator=(AMatrix<T> &&other) noexcept;
   AMatrix<T> operator+(const AMatrix<T> &other) const;
   AMatrix<T> operator+(T v) const;
   AMatrix<T> operator*(T v) const;
   AMatrix<T> operator-(T v) const;
   AMatrix<T> operator/(T v) const;
   AMatrix<T> operator-(const AMatrix<T> &m) const;
+
+  // The compound operators update the values in place rather than allocating
+  // a new matrix. A borrowed matrix writes to the values that it borrows.
+  AMatrix<T> &operator+=(const AMatrix<T> &other);
+  AMatrix<T> &operator-=(const AMatrix<T> &other);
+  AMatrix<T> &operator+=(T v);
+  AMatrix<T> &operator-=(T v);
+  AMatrix<T> &operator*=(T v);
+  AMatrix<T> &operator/=(T v);
+
   static AMatrix<T> Filled(size_t rows, size_t cols, T initialValue);
 
+  // Wraps a column of values that is owned elsewhere, without copying it. The
+  // values must outlive the matrix and any matrix that it is moved into.
+  // Copies of the matrix own their values, and assigning to the matrix
+  // releases the borrowed values rather than writing to them.
+  static AMatrix<T> Borrow(absl::Span<T> col);
+
   AMatrix<T> PointWiseProduct(const AMatrix<T> &m) const;
   AMatrix<T> PointWiseDivide(const AMatrix<T> &m) const;
+  AMatrix<T> &PointWiseMultiplyInPlace(const AMatrix<T> &m);
+  AMatrix<T> &PointWiseDivideInPlace(const AMatrix<T> &m);
   AMatrix<T> Transpose() const;
   AMatrix<double> Abs() const;
   std::vector<T> RowSubset(size_t row, size_t startColumnIndex,
@@ -117,6 +137,10 @@ class AMatrix {
   T *mutData() const;  // bit of a hack
 
  private:
+  // Constructs the matrix again in place as a view of values that are owned
+  // elsewhere.
+  void BorrowInPlace(T *values, size_t rows, size_t cols);
+
   arma::Mat<T> matrix_;
 };
 }  // namespace Visqol
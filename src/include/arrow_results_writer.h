@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_ARROW_RESULTS_WRITER_H
+#define VISQOL_INCLUDE_ARROW_RESULTS_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * Writes comparison results to a file in the Apache Arrow IPC streaming
+ * format, which pyarrow (pyarrow.ipc.open_stream), polars
+ * (polars.read_ipc_stream) and DuckDB read directly, and which pyarrow can
+ * turn into Parquet with a single call.
+ *
+ * Each result is a row with the columns:
+ *  - reference, degraded: the file paths, as UTF-8 strings.
+ *  - moslqo, vnsim: the scores, as doubles.
+ *  - fvnsim0 to fvnsimN: the FVNSIM of each band, as doubles.
+ *  - If the first result has stage timings, <stage>_sec for each stage, as
+ *    doubles.
+ *  - If the first result has memory usage, bytes_allocated, num_allocations
+ *    and peak_rss_kb, as unsigned 64 bit integers.
+ *
+ * The columns are fixed by the first result, which the schema is written for.
+ * A band or timing that a later result lacks is written as NaN or 0. The rows
+ * are buffered and written as a record batch once there are rows_per_batch
+ * of them, so the memory used does not grow with the size of the batch.
+ *
+ * The values are written in the byte order of the host, which the schema
+ * declares as little-endian, so the writer is only for little-endian hosts.
+ *
+ * Not thread-safe.
+ */
+class ArrowResultsWriter {
+ public:
+  /**
+   * The default number of rows of each record batch.
+   */
+  static constexpr size_t kDefaultRowsPerBatch = 16384;
+
+  /**
+   * Opens the file, replacing it if it exists, as a stream has a single
+   * schema and cannot be appended to.
+   *
+   * @param path The path of the file.
+   * @param rows_per_batch The number of rows of each record batch.
+   */
+  explicit ArrowResultsWriter(const FilePath &path,
+                              size_t rows_per_batch = kDefaultRowsPerBatch);
+
+  /**
+   * Writes the buffered rows and the end of the stream, and closes the file.
+   */
+  ~ArrowResultsWriter();
+
+  ArrowResultsWriter(const ArrowResultsWriter &) = delete;
+  ArrowResultsWriter &operator=(const ArrowResultsWriter &) = delete;
+
+  /**
+   * @return True if the file is open and no write has failed.
+   */
+  bool ok() const { return static_cast<bool>(file_); }
+
+  /**
+   * Add a result as a row. The schema is written with the first row.
+   *
+   * @param sim_res_msg The result to add.
+   */
+  void Append(const SimilarityResultMsg &sim_res_msg);
+
+  /**
+   * Copy the fields of a result that are written as a row, so that a caller
+   * can copy them out of the result before it takes the lock that guards the
+   * writer, rather than copying the whole result.
+   *
+   * @param sim_res_msg The result.
+   *
+   * @return The result with only the fields of its row.
+   */
+  static SimilarityResultMsg RowFields(const SimilarityResultMsg &sim_res_msg);
+
+  /**
+   * Write the buffered rows as a record batch, and flush the file.
+   */
+  void Flush();
+
+ private:
+  /**
+   * The Arrow types of the columns.
+   */
+  enum class ColumnType { kUtf8, kFloat64, kUInt64 };
+
+  /**
+   * A column and its values for the rows of the current record batch.
+   */
+  struct Column {
+    std::string name;
+    ColumnType type;
+    // The character data and the offsets of the rows into it, for kUtf8.
+    std::string chars;
+    std::vector<int32_t> offsets;
+    // The values of the rows, for kFloat64 and kUInt64.
+    std::vector<double> doubles;
+    std::vector<uint64_t> ints;
+  };
+
+  /**
+   * Set up the columns for the first result and write the schema.
+   */
+  void WriteSchema(const SimilarityResultMsg &first);
+
+  /**
+   * Write the buffered rows as a record batch and clear them.
+   */
+  void WriteRecordBatch();
+
+  /**
+   * Write an encapsulated message: its metadata, then its body.
+   */
+  void WriteMessage(const std::string &metadata, const std::string &body);
+
+  std::ofstream file_;
+  const size_t rows_per_batch_;
+  std::vector<Column> columns_;
+  size_t num_fvnsim_ = 0;
+  bool timings_ = false;
+  bool memory_usage_ = false;
+  size_t num_rows_ = 0;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_ARROW_RESULTS_WRITER_H
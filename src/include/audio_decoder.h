@@ -0,0 +1,177 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_INCLUDE_AUDIODECODER_H
+#define VISQOL_INCLUDE_AUDIODECODER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Decodes the audio files of a format other than WAV in process, so that
+ * they do not need to be decoded to a temporary WAV file first.
+ */
+class AudioDecoder {
+ public:
+  virtual ~AudioDecoder() {}
+
+  /**
+   * Decode an audio file. The samples are normalized to [-1, 1), as those of
+   * WAV files are.
+   *
+   * @param path The path to the audio file to decode.
+   * @param downmix If true, the channels are averaged into a single channel
+   *    as they are decoded.
+   *
+   * @return The decoded signal, with a column per channel, or a signal
+   *    without samples if the file could not be decoded.
+   */
+  virtual AudioSignal Decode(const FilePath &path, bool downmix) const = 0;
+
+};
+
+/**
+ * Gathers the samples of a signal as they are decoded, averaging its
+ * channels into one if asked to. When the number of frames is known up
+ * front, the samples are written straight into the matrix of the signal.
+ */
+class DecodedSignalBuilder {
+ public:
+  /**
+   * @param num_channels The number of channels of the decoded frames.
+   * @param num_frames The number of frames that the file declares, or 0 if
+   *    it does not declare them, in which case the samples are gathered per
+   *    channel and copied into the signal once they are all decoded. Frames
+   *    past the declared number are dropped.
+   * @param downmix If true, the channels are averaged into a single channel.
+   */
+  DecodedSignalBuilder(size_t num_channels, size_t num_frames, bool downmix);
+
+  /**
+   * Append decoded frames.
+   *
+   * @param num_frames The number of frames to append.
+   * @param sample_of A function of a frame and a channel that returns the
+   *    normalized sample of the channel in that frame.
+   */
+  template <typename SampleFn>
+  void Append(size_t num_frames, SampleFn sample_of);
+
+  /**
+   * Make the signal of the appended frames. Declared frames that were not
+   * decoded are silent. The builder must not be used afterwards.
+   *
+   * @param sample_rate The sample rate of the frames.
+   * @param path The path of the file, which warnings are logged with.
+   *
+   * @return The signal, or a signal without samples if no frames were
+   *    appended.
+   */
+  AudioSignal Build(size_t sample_rate, const FilePath &path);
+
+ private:
+  void Push(size_t column, double sample);
+
+  size_t num_channels_;
+  size_t num_declared_frames_;
+  bool downmix_;
+  size_t num_frames_ = 0;
+  size_t num_dropped_frames_ = 0;
+  AMatrix<double> samples_;
+  std::vector<std::vector<double>> columns_;
+};
+
+template <typename SampleFn>
+void DecodedSignalBuilder::Append(size_t num_frames, SampleFn sample_of) {
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    if (num_declared_frames_ > 0 && num_frames_ == num_declared_frames_) {
+      num_dropped_frames_ += num_frames - frame;
+      return;
+    }
+    if (downmix_) {
+      // The channels are summed in order and then averaged, which gives the
+      // same result as MiscAudio::ToMono.
+      double sum = sample_of(frame, 0);
+      for (size_t channel = 1; channel < num_channels_; channel++) {
+        sum += sample_of(frame, channel);
+      }
+      Push(0, num_channels_ == 1 ? sum : sum / num_channels_);
+    } else {
+      for (size_t channel = 0; channel < num_channels_; channel++) {
+        Push(channel, sample_of(frame, channel));
+      }
+    }
+    num_frames_++;
+  }
+}
+
+inline void DecodedSignalBuilder::Push(size_t column, double sample) {
+  if (num_declared_frames_ > 0) {
+    samples_.mutData()[column * num_declared_frames_ + num_frames_] = sample;
+  } else {
+    columns_[column].push_back(sample);
+  }
+}
+
+/**
+ * A process-wide registry of the audio decoders that are linked into the
+ * binary, keyed by the file extensions that they decode. Decoders are built
+ * as separate libraries that register themselves when they are linked in, so
+ * the library itself does not depend on their codecs. WAV files are always
+ * read by WavReader. This class is thread safe.
+ */
+class AudioDecoderRegistry {
+ public:
+  /**
+   * Register a decoder. Decoders usually register themselves with the
+   * result of this initializing a static variable.
+   *
+   * @param extension The file extension that the decoder decodes, such as
+   *    "flac". The case of the extension is ignored.
+   * @param decoder The decoder.
+   *
+   * @return True if the decoder was registered, or false if the extension
+   *    was already taken or is "wav", in which case the decoder is dropped.
+   */
+  static bool Register(const std::string &extension,
+                       std::unique_ptr<AudioDecoder> decoder);
+
+  /**
+   * Find the decoder of a file.
+   *
+   * @param path The path to the audio file.
+   *
+   * @return The decoder that is registered for the extension of the file, or
+   *    null if there is none. The decoder lives as long as the process.
+   */
+  static const AudioDecoder *Find(const FilePath &path);
+
+  /**
+   * @return The registered extensions, in order.
+   */
+  static std::vector<std::string> Extensions();
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_AUDIODECODER_H
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_INCLUDE_AUDIO_SIGNAL_VIEW_H
+#define VISQOL_INCLUDE_AUDIO_SIGNAL_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+/**
+ * A non-owning, read only view of a range of samples of a mono audio signal.
+ *
+ * The view may start before the first sample or end after the last sample
+ * that it can see. Those samples of the view are silent, i.e. they read as 0,
+ * without the signal being copied or padded. This expresses slicing, leading
+ * silence and truncation without copying the samples. The viewed signal must
+ * outlive the view.
+ */
+class AudioSignalView {
+ public:
+  /**
+   * Constructs a view of a whole signal. This is implicit so that a signal
+   * can be passed wherever a view is expected.
+   *
+   * @param signal The signal to view.
+   */
+  AudioSignalView(const AudioSignal &signal);
+
+  /**
+   * Constructs a view of a range of samples of a signal.
+   *
+   * @param signal The signal to view.
+   * @param first_sample The sample of the signal that the first sample of the
+   *    view corresponds to. This may be negative.
+   * @param num_samples The number of samples in the view. The view may extend
+   *    past the last sample of the signal.
+   */
+  AudioSignalView(const AudioSignal &signal, int64_t first_sample,
+                  size_t num_samples);
+
+  /**
+   * Get a sample of the view.
+   *
+   * @param index The index of the sample, relative to the start of the view.
+   *
+   * @return The sample, or 0 if it is outside of the samples that the view
+   *    can see.
+   */
+  double operator[](size_t index) const {
+    const int64_t data_index = first_sample_ + static_cast<int64_t>(index);
+    if (data_index < 0 || data_index >= num_data_samples_) {
+      return 0.0;
+    }
+    return data_[data_index];
+  }
+
+  /**
+   * Constructs a view of a range of the samples of this view. Samples of this
+   * view that are silent are also silent in the new view, and the new view
+   * can not see the samples of the signal outside of this view.
+   *
+   * @param first_sample The sample of this view that the first sample of the
+   *    new view corresponds to. This may be negative.
+   * @param num_samples The number of samples in the new view. The new view may
+   *    extend past the last sample of this view.
+   *
+   * @return The new view.
+   */
+  AudioSignalView SubView(int64_t first_sample, size_t num_samples) const;
+
+  /**
+   * Get the number of samples in the view.
+   *
+   * @return The number of samples in the view.
+   */
+  size_t NumSamples() const { return num_samples_; }
+
+  /**
+   * Get the sample rate of the viewed signal.
+   *
+   * @return The sample rate.
+   */
+  size_t SampleRate() const { return sample_rate_; }
+
+  /**
+   * Get the duration (in seconds) of the view.
+   *
+   * @return The duration of the view.
+   */
+  double GetDuration() const {
+    return num_samples_ / static_cast<double>(sample_rate_);
+  }
+
+  /**
+   * Copy the samples of the view into a vector, with the silent samples
+   * filled with 0.
+   *
+   * @return A vector holding the samples of the view.
+   */
+  std::vector<double> ToVector() const;
+
+  /**
+   * Get the samples of the view as a contiguous span. If every sample of the
+   * view can be seen, the span points into the viewed signal. Else the
+   * samples are copied into a buffer from the workspace, with the silent
+   * samples filled with 0.
+   *
+   * @param workspace The workspace to copy the samples into, if needed.
+   *
+   * @return A span of the samples of the view. It is valid while both the
+   *    viewed signal and the workspace buffer are.
+   */
+  absl::Span<const double> ToSpan(VisqolWorkspace *workspace) const;
+
+  /**
+   * Copy the samples of the view into a single column matrix, with the silent
+   * samples filled with 0.
+   *
+   * @return A matrix holding the samples of the view.
+   */
+  AMatrix<double> ToMatrix() const;
+
+  /**
+   * Copy the view into a new audio signal, with the silent samples filled
+   * with 0.
+   *
+   * @return An audio signal holding the samples of the view.
+   */
+  AudioSignal ToAudioSignal() const;
+
+ private:
+  /**
+   * Copy the samples of the view into a buffer, with the silent samples
+   * filled with 0.
+   *
+   * @param samples The buffer to copy into. It must hold NumSamples() values.
+   */
+  void CopyTo(absl::Span<double> samples) const;
+
+  /**
+   * Constructs a view from its raw fields.
+   */
+  AudioSignalView(const double *data, int64_t num_data_samples,
+                  int64_t first_sample, size_t num_samples,
+                  size_t sample_rate);
+
+  /**
+   * The first sample that the view can see.
+   */
+  const double *data_;
+
+  /**
+   * The number of samples, starting at data_, that the view can see.
+   */
+  int64_t num_data_samples_;
+
+  /**
+   * The sample, relative to data_, that the first sample of the view
+   * corresponds to.
+   */
+  int64_t first_sample_;
+
+  /**
+   * The number of samples in the view.
+   */
+  size_t num_samples_;
+
+  /**
+   * The sample rate of the viewed signal.
+   */
+  size_t sample_rate_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_AUDIO_SIGNAL_VIEW_H
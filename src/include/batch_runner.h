@@ -0,0 +1,149 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_BATCH_RUNNER_H
+#define VISQOL_INCLUDE_BATCH_RUNNER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "file_path.h"
+#include "pair_source.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+
+namespace Visqol {
+/**
+ * Compares a batch of reference/degraded file pairs on a number of worker
+ * threads, each with its own VisqolManager.
+ */
+class BatchRunner {
+ public:
+  /**
+   * The maximum number of consecutive pairs that are handed to a worker at
+   * once.
+   */
+  static const size_t kMaxPairsPerTask;
+
+  /**
+   * The maximum number of discovered pairs that wait for a worker, when the
+   * pairs are discovered as they are compared.
+   */
+  static const size_t kMaxQueuedPairs;
+
+  /**
+   * Compare a batch of file pairs, handing the result of each pair to a
+   * handler as soon as it is compared.
+   *
+   * The pairs are handed to the workers in tasks of consecutive pairs with the
+   * same reference file, so each worker reuses the alignment spectrum of the
+   * reference within a task. The cost of each pair is estimated from the
+   * durations in the headers of its files, and the tasks are started longest
+   * first, so that the batch does not end with a long task running on its
+   * own. Idle workers take the next task from a shared queue.
+   *
+   * With more than one thread, the handler is called from the workers, in
+   * the order that the pairs complete, and is called concurrently. A pair
+   * that fails is logged and its error is handed to the handler, as with
+   * VisqolManager::RunBatch.
+   *
+   * When the lag of each comparison is reused as the hint of the next one,
+   * the lag is only carried on within each worker.
+   *
+   * When the thread_pinning option is set and there is more than one
+   * worker, each worker is pinned to the CPUs of a NUMA node, and its
+   * manager is initialized on that node. See ThreadPinning.
+   *
+   * @param sim_to_quality_mapper_model The path to the model file of the
+   *    similarity to quality mapper of each manager.
+   * @param options The options that each manager is initialized with.
+   * @param pairs The pairs of files to compare.
+   * @param num_threads The number of worker threads. Values of 0 and 1
+   *    compare every pair on the calling thread, with a single manager.
+   * @param handler Handles the result of each pair.
+   * @param log_pair_costs If true, the estimated cost and the comparison time
+   *    of each pair are logged when more than one thread is used, so that
+   *    the estimates can be checked.
+   *
+   * @return An OK status, or the error status if a manager could not be
+   *    initialized.
+   */
+  static google::protobuf::util::Status Stream(
+      const FilePath &sim_to_quality_mapper_model,
+      const VisqolConfig::VisqolOptions &options,
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      size_t num_threads, const VisqolManager::ResultHandler &handler,
+      bool log_pair_costs = false);
+
+  /**
+   * Compare the pairs of a source as they are discovered, handing the result
+   * of each pair to a handler as soon as it is compared.
+   *
+   * The pairs are discovered on a background thread, up to kMaxQueuedPairs
+   * ahead of the workers, so the latency of listing or reading the batch
+   * overlaps the comparisons. Idle workers take the next run of up to
+   * kMaxPairsPerTask consecutive discovered pairs with the same reference.
+   * As the batch is not known up front, the pairs are compared in the order
+   * that they are discovered rather than longest first.
+   *
+   * The pairs are indexed in the order that they are discovered. With more
+   * than one thread, the handler is called from the workers, in the order
+   * that the pairs complete, and is called concurrently.
+   *
+   * @param sim_to_quality_mapper_model The path to the model file of the
+   *    similarity to quality mapper of each manager.
+   * @param options The options that each manager is initialized with.
+   * @param source Discovers the pairs of files to compare.
+   * @param num_threads The number of worker threads. Values of 0 and 1
+   *    compare every pair on the calling thread, with a single manager.
+   * @param handler Handles the result of each pair.
+   *
+   * @return An OK status, or the error status if a manager could not be
+   *    initialized.
+   */
+  static google::protobuf::util::Status StreamFrom(
+      const FilePath &sim_to_quality_mapper_model,
+      const VisqolConfig::VisqolOptions &options, PairSource *source,
+      size_t num_threads, const VisqolManager::ResultHandler &handler);
+
+  /**
+   * Compare a batch of file pairs, as Stream does, and collect the results.
+   *
+   * @param sim_to_quality_mapper_model The path to the model file of the
+   *    similarity to quality mapper of each manager.
+   * @param options The options that each manager is initialized with.
+   * @param pairs The pairs of files to compare.
+   * @param num_threads The number of worker threads.
+   * @param log_pair_costs If true, the estimated cost and the comparison time
+   *    of each pair are logged.
+   *
+   * @return The results of the pairs that were compared successfully, in the
+   *    order of the pairs, or the error status if a manager could not be
+   *    initialized.
+   */
+  static google::protobuf::util::StatusOr<std::vector<SimilarityResultMsg>>
+  Run(const FilePath &sim_to_quality_mapper_model,
+      const VisqolConfig::VisqolOptions &options,
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      size_t num_threads, bool log_pair_costs = false);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_BATCH_RUNNER_H
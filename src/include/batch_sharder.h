@@ -0,0 +1,95 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_BATCH_SHARDER_H
+#define VISQOL_INCLUDE_BATCH_SHARDER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Splits a batch of reference/degraded file pairs into shards of similar
+ * cost, so that the shards can be compared by separate processes or
+ * machines.
+ *
+ * The split only depends on the pairs and on the durations in the headers of
+ * their files, so every process that is given the same batch computes the
+ * same split, and each can select its own shard without any coordination.
+ */
+class BatchSharder {
+ public:
+  /**
+   * The maximum number of consecutive pairs with the same reference that are
+   * kept together in a shard.
+   */
+  static const size_t kMaxPairsPerGroup;
+
+  /**
+   * Estimate the cost of comparing each pair, as the duration of both of its
+   * files, which is read from their headers without decoding them. A file
+   * that cannot be read counts as 0 seconds.
+   *
+   * @param pairs The pairs to estimate the cost of.
+   * @param num_threads The number of threads that the headers are read on.
+   *
+   * @return The cost of each pair, in seconds of audio.
+   */
+  static std::vector<double> EstimatePairCosts(
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      size_t num_threads);
+
+  /**
+   * Assign each pair to a shard.
+   *
+   * Runs of up to kMaxPairsPerGroup consecutive pairs with the same
+   * reference are kept together, so that the reference is only processed
+   * once for them. The runs are assigned most costly first, each to the shard
+   * with the lowest total cost so far, with ties going to the lowest shard
+   * index.
+   *
+   * @param pairs The pairs of the batch.
+   * @param pair_costs The estimated cost of each pair.
+   * @param num_shards The number of shards.
+   *
+   * @return The index of the shard of each pair.
+   */
+  static std::vector<size_t> AssignShards(
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      const std::vector<double> &pair_costs, size_t num_shards);
+
+  /**
+   * Select the pairs of a shard of a batch, in the order that they have in
+   * the batch.
+   *
+   * @param pairs The pairs of the batch.
+   * @param shard_index The index of the shard to select.
+   * @param num_shards The number of shards. A value of 0 or 1 selects every
+   *    pair.
+   * @param num_threads The number of threads that the headers of the files
+   *    are read on.
+   *
+   * @return The pairs of the shard.
+   */
+  static std::vector<ReferenceDegradedPathPair> SelectShard(
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      size_t shard_index, size_t num_shards, size_t num_threads);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_BATCH_SHARDER_H
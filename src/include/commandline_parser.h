@@ -17,6 +17,7 @@
 #ifndef VISQOL_INCLUDE_COMMANDLINE_PARSER_H
 #define VISQOL_INCLUDE_COMMANDLINE_PARSER_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
@@ -24,6 +25,8 @@
 #include "google/protobuf/stubs/statusor.h"
 
 #include "file_path.h"
+#include "pair_source.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
 
 namespace Visqol {
 
@@ -32,6 +35,11 @@ namespace Visqol {
  */
 extern const char kDefaultAudioModelFile[];
 
+/**
+ * The relative location of the default speech model file.
+ */
+extern const char kDefaultSpeechModelFile[];
+
 /**
  * This struct is used for storing args provided at the command line.
  */
@@ -91,6 +99,291 @@ struct CommandLineArgs {
    */
   bool use_unscaled_speech_mos_mapping;
 
+  /**
+   * The method used to build the spectrograms that are compared.
+   */
+  VisqolConfig::VisqolOptions::SpectrogramMode spectrogram_mode =
+      VisqolConfig::VisqolOptions::GAMMATONE;
+
+  /**
+   * The number of threads that the patches of a single comparison are
+   * searched and realigned on.
+   */
+  int num_patch_workers = 1;
+
+  /**
+   * The number of threads that a comparison is processed on, in as many
+   * contiguous segments of its spectrogram columns.
+   */
+  int num_segment_workers = 1;
+
+  /**
+   * The strategy used to search for the degraded patch that best matches each
+   * reference patch.
+   */
+  VisqolConfig::VisqolOptions::PatchSearch patch_search =
+      VisqolConfig::VisqolOptions::EXHAUSTIVE;
+
+  /**
+   * The patches whose coarse similarity is above this value are not finely
+   * realigned. 0 realigns every patch.
+   */
+  double realign_skip_similarity = 0.0;
+
+  /**
+   * If true, the patches are searched for in single precision.
+   */
+  bool use_float_patch_search = false;
+
+  /**
+   * The method used to globally align the degraded signal to the reference.
+   */
+  VisqolConfig::VisqolOptions::GlobalAlignment global_alignment =
+      VisqolConfig::VisqolOptions::FULL_RATE;
+
+  /**
+   * If true, the fine realignment of each patch only searches lags of up to
+   * half the patch.
+   */
+  bool use_bounded_patch_realignment = false;
+
+  /**
+   * The expected lag (in sec) of the degraded signal.
+   */
+  double global_lag_hint = 0.0;
+
+  /**
+   * If above 0, the global alignment only searches the lags within this many
+   * seconds of the lag hint.
+   */
+  double global_lag_search_window = 0.0;
+
+  /**
+   * If true, the lag applied by each comparison becomes the lag hint of the
+   * next one.
+   */
+  bool reuse_global_lag = false;
+
+  /**
+   * If true, the input files are resampled to the native sample rate of the
+   * mode as they are loaded.
+   */
+  bool resample_to_mode_rate = false;
+
+  /**
+   * The number of upcoming pairs of a batch that are loaded while the
+   * current pair is compared.
+   */
+  size_t num_prefetch_pairs = 0;
+
+  /**
+   * The number of threads that the pairs of a batch are compared on.
+   */
+  size_t num_threads = 1;
+
+  /**
+   * How the worker threads of a batch are pinned to the CPUs of the NUMA
+   * nodes.
+   */
+  VisqolConfig::VisqolOptions::ThreadPinning thread_pinning =
+      VisqolConfig::VisqolOptions::NO_PINNING;
+
+  /**
+   * The number of recently compared reference files of a batch that are
+   * kept in memory along with their features.
+   */
+  size_t reference_cache_size = 0;
+
+  /**
+   * The directory that the features of reference files are saved in, or
+   * empty.
+   */
+  std::string ref_features_dir;
+
+  /**
+   * If true, the features of reference files are saved to ref_features_dir
+   * once they are built.
+   */
+  bool write_ref_features = false;
+
+  /**
+   * If not empty, the path of the file that the results are cached in.
+   */
+  std::string result_cache_path;
+
+  /**
+   * If true, the hashes of the blocks of each degraded signal are recorded
+   * in its result.
+   */
+  bool record_block_hashes = false;
+
+  /**
+   * If not empty, the path of a results proto file of an earlier run, whose
+   * patches are reused where the degraded files did not change.
+   */
+  std::string previous_results_path;
+
+  /**
+   * If greater than 0, the duration (in sec) of the windows of the timeline
+   * of each comparison.
+   */
+  double timeline_window = 0.0;
+
+  /**
+   * The maximum number of reference patches that are compared, or 0 to
+   * compare them all.
+   */
+  size_t max_patches = 0;
+
+  /**
+   * If greater than 0, the standard error of the VNSIM that the comparison of
+   * the patches stops at.
+   */
+  double target_vnsim_stderr = 0.0;
+
+  /**
+   * If true, only the columns of the degraded spectrogram that the patch
+   * search reads are built.
+   */
+  bool lazy_degraded_spectrogram = false;
+
+  /**
+   * If negative, the level in dB relative to the peak of the reference below
+   * which reference patches are not compared in audio mode.
+   */
+  double silent_patch_threshold = 0.0;
+
+  /**
+   * If true, each channel of the files is scored on its own.
+   */
+  bool multichannel = false;
+
+  /**
+   * If true, the time spent in each stage of each comparison is recorded.
+   */
+  bool record_stage_timings = false;
+
+  /**
+   * If true, the memory used by each comparison is recorded.
+   */
+  bool record_memory_usage = false;
+
+  /**
+   * How much of the detail of each comparison is kept in its result.
+   */
+  VisqolConfig::VisqolOptions::ResultDetail result_detail =
+      VisqolConfig::VisqolOptions::FULL;
+
+  /**
+   * If true, a degraded signal that matches the reference once it is aligned
+   * and scaled is not compared.
+   */
+  bool detect_identical_signals = false;
+
+  /**
+   * The largest difference between an aligned and scaled degraded sample and
+   * its reference sample for the signals to match.
+   */
+  double identical_signal_tolerance = 0.0;
+
+  /**
+   * If not empty, the name of the backend that builds the gammatone
+   * spectrograms and compares the patches.
+   */
+  std::string compute_backend;
+
+  /**
+   * If above 0, the duration in seconds of the tiles that long pairs are
+   * compared in.
+   */
+  double tile_duration = 0.0;
+
+  /**
+   * If above 0, the memory in megabytes that the comparison of a pair should
+   * stay within.
+   */
+  int max_memory_mb = 0;
+
+  /**
+   * If true, the results of a batch are written as soon as each pair is
+   * compared, rather than in the order of the pairs.
+   */
+  bool unordered_results = false;
+
+  /**
+   * The number of shards that a batch is split into.
+   */
+  size_t num_shards = 1;
+
+  /**
+   * The index of the shard of a batch that is compared.
+   */
+  size_t shard_index = 0;
+
+  /**
+   * If true, the pairs that already have a result in the results CSV file
+   * are skipped.
+   */
+  bool resume = false;
+
+  /**
+   * If true, the batch CSV file is read a line at a time as its pairs are
+   * compared.
+   */
+  bool stream_batch_input = false;
+
+  /**
+   * If not empty, the directory of the reference files of a batch that pairs
+   * them with the files of the same name in the degraded directory.
+   */
+  FilePath reference_dir;
+
+  /**
+   * The directory of the degraded files of the reference directory.
+   */
+  FilePath degraded_dir;
+
+  /**
+   * The pattern that the names of the files of the reference directory must
+   * match.
+   */
+  std::string file_pattern = "*.wav";
+
+  /**
+   * If not empty, the path prefix of the files that the FVNSIM and MOS-LQS of
+   * the pairs of a batch are written to for training an SVR model.
+   */
+  std::string training_data_output;
+
+  /**
+   * If not empty, the path of the file that the results are appended to as
+   * length-delimited binary SimilarityResultMsg records.
+   */
+  std::string results_proto;
+
+  /**
+   * If not empty, the path of the file that the scores are written to as an
+   * Arrow IPC stream.
+   */
+  std::string results_arrow;
+
+  /**
+   * If not empty, the path that a Chrome trace of the pairs and stages of the
+   * comparisons is written to.
+   */
+  std::string trace_output;
+
+  /**
+   * If not empty, the path that the metrics of the run are written to.
+   */
+  std::string metrics_output;
+
+  /**
+   * If true, the metrics are written in the Prometheus text format, else as
+   * plain text.
+   */
+  bool prometheus_metrics = false;
+
   /**
    * Constructs the parsed command line args struct.
    */
@@ -135,7 +428,10 @@ class VisqolCommandLineParser {
 
   /**
    * Takes the files to be compared (either individual or batch) that were
-   * provided at the command line and constructs a vector of path pairs.
+   * provided at the command line and constructs a vector of path pairs. When
+   * a batch is split into shards, only the pairs of the selected shard are
+   * included. When resuming, the pairs that already have a result are left
+   * out.
    *
    * @param cmd_res The parsed command line args.
    *
@@ -144,6 +440,30 @@ class VisqolCommandLineParser {
   static std::vector<ReferenceDegradedPathPair> BuildFilePairPaths(
       const CommandLineArgs &cmd_res);
 
+  /**
+   * Build the source of the pairs of a batch that is compared as its pairs
+   * are discovered, which is either a reference directory or a streamed
+   * batch CSV file.
+   *
+   * @param cmd_res The parsed command line args.
+   *
+   * @return The source of the pairs, or null if the pairs are built up front
+   *    with BuildFilePairPaths.
+   */
+  static std::unique_ptr<PairSource> BuildPairSource(
+      const CommandLineArgs &cmd_res);
+
+  /**
+   * Build the ViSQOL config options that correspond to the parsed command
+   * line args.
+   *
+   * @param cmd_res The parsed command line args.
+   *
+   * @return The config options to initialize ViSQOL with.
+   */
+  static VisqolConfig::VisqolOptions BuildVisqolOptions(
+      const CommandLineArgs &cmd_res);
+
  private:
   /**
    * For a given file path, check if the file exists.
@@ -18,14 +18,19 @@
 #define VISQOL_INCLUDE_COMPARISON_PATCHES_SELECTOR_H
 
 #include <memory>
+#include <tuple>
 #include <vector>
 
 #include "google/protobuf/stubs/statusor.h"
 
 #include "amatrix.h"
+#include "audio_signal_view.h"
 #include "image_patch_creator.h"
 #include "patch_similarity_comparator.h"
+#include "patch_view.h"
+#include "spectrogram.h"
 #include "spectrogram_builder.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 struct PatchSimilarityResult;
@@ -36,17 +41,66 @@ struct PatchSimilarityResult;
  */
 class ComparisonPatchesSelector {
  public:
+  /**
+   * The strategies for searching the degraded spectrogram for the patch that
+   * best matches a reference patch.
+   */
+  enum class SearchStrategy {
+    /**
+     * Compare the reference patch with the degraded patch at every offset
+     * within the search range.
+     */
+    kExhaustive,
+
+    /**
+     * First compare the reference patch with the degraded patches at every
+     * kCoarseSearchStride offsets, then compare it at every offset around the
+     * kNumRefinedCandidates most similar of those. This may miss the best
+     * match when the similarity has several narrow peaks.
+     */
+    kCoarseToFine
+  };
+
   /**
    * Constructor that takes a patch similarity comparator for performing the
    * patch comparison.
+   *
+   * @param sim_comparator The patch similarity comparator.
+   * @param num_workers The number of threads that the patches of a single
+   *    comparison are searched and realigned on. 0 or 1 processes them on the
+   *    calling thread.
+   * @param search_strategy The strategy for searching for the degraded patch
+   *    that best matches each reference patch.
+   * @param realign_skip_similarity The patches whose coarse similarity is
+   *    above this value are not finely realigned. 0 or less realigns every
+   *    patch.
+   * @param use_bounded_realignment If true, the fine realignment of each
+   *    patch only searches lags of up to half the patch.
    */
   ComparisonPatchesSelector(
-      std::unique_ptr<PatchSimilarityComparator> sim_comparator);
+      std::unique_ptr<PatchSimilarityComparator> sim_comparator,
+      size_t num_workers = 1,
+      SearchStrategy search_strategy = SearchStrategy::kExhaustive,
+      double realign_skip_similarity = 0.0,
+      bool use_bounded_realignment = false);
+
+  /**
+   * The distance between the offsets that are compared in the first pass of
+   * the coarse to fine search.
+   */
+  static const int kCoarseSearchStride;
+
+  /**
+   * The number of the most similar offsets from the first pass of the coarse
+   * to fine search that are refined in the second pass.
+   */
+  static const size_t kNumRefinedCandidates;
 
   /**
    * For each patch provided (from the reference spectrogram) find the most
    * similar degraded patch that matches it and compare the two patches. Return
-   * the set of all such comparisons.
+   * the set of all such comparisons. The patches are searched concurrently on
+   * the configured number of workers.
    *
    * @param ref_patches A vector containing all of the patches created from the
    *    reference spectrogram.
@@ -55,20 +109,27 @@ class ComparisonPatchesSelector {
    *    spectrogram where this patch starts from.
    * @param spectrogram_data The spectrogram that represents the degraded
    *    signal.
+   * @param workspace If not null, the scratch buffers of the search are taken
+   *    from this workspace rather than from the heap.
    *
    * @return A vector of similarity results. Each similary result is the result
    *    of the comparison between a patch from the reference spectrogram with
    *    its corresponding patch in the degraded spectrogram.
    */
   google::protobuf::util::StatusOr<std::vector<PatchSimilarityResult>>
-      FindMostSimilarDegPatches(const std::vector<ImagePatch> &ref_patches,
+      FindMostSimilarDegPatches(const std::vector<PatchView> &ref_patches,
           const std::vector<size_t> &ref_patch_indices,
           const AMatrix<double> &spectrogram_data,
-          const double frame_duration) const;
+          const double frame_duration,
+          VisqolWorkspace *workspace = nullptr) const;
 
   /**
    * Given roughly aligned ref/deg patches, realign the original audio within
-   * the patch size so that they are maximally locally aligned.
+   * the patch size so that they are maximally locally aligned. The patches
+   * are realigned concurrently on the configured number of workers, and the
+   * results are returned in the order of the input. The patches whose coarse
+   * similarity is above the configured realign skip similarity are returned
+   * unchanged.
    *
    * @param sim_results A vector of PatchSimilarityResults
    * @param ref_signal The reference signal used to create the
@@ -77,6 +138,10 @@ class ComparisonPatchesSelector {
    *    PatchSimilarityResults.
    * @param spect_builder A pointer to a SpectrogramBuilder.
    * @param window An AnalysisWindow used to create the spectrogram
+   * @param num_skipped If not nullptr, the number of patches that were not
+   *    realigned because of their coarse similarity is written here.
+   * @param workspace If not null, the scratch buffers of the spectrograms of
+   *    the patches are taken from this workspace rather than from the heap.
    *
    * @return A StatusOr that may contain a vector of new, finely aligned
    *    PatchSimilarityResults.
@@ -86,40 +151,61 @@ class ComparisonPatchesSelector {
           const std::vector<PatchSimilarityResult>& sim_results,
           const AudioSignal &ref_signal,
           const AudioSignal &deg_signal,
-          SpectrogramBuilder *spect_builder,
-          const AnalysisWindow &window) const;
+          const SpectrogramBuilder *spect_builder,
+          const AnalysisWindow &window,
+          size_t *num_skipped = nullptr,
+          VisqolWorkspace *workspace = nullptr) const;
 
- private:
   /**
-   * Extract a subregion of an audio signal.
+   * Get the columns of the degraded spectrogram that FindMostSimilarDegPatches
+   * reads when searching for the given reference patches, which are those
+   * within half a patch of each reference patch.
    *
-   * @param in_signal An AudioSignal.
-   * @param start_time The start time of the sliced audio in seconds.
-   * @param end_time The end time of the sliced audio in seconds.
-   * @return A new AudioSignal containing the subregion.
+   * @param ref_patch_indices The sorted indices of the reference patches.
+   * @param num_frames_per_patch The number of frames in each patch.
+   *
+   * @return The columns that are read. These may extend past the end of the
+   *    degraded spectrogram.
    */
-  static AudioSignal Slice(const AudioSignal &in_signal, double start_time,
-                           double end_time);
+  static SpectrogramColumnRanges SearchedColumns(
+      const std::vector<size_t> &ref_patch_indices,
+      size_t num_frames_per_patch);
 
+ private:
   /**
-   * Based on the input locations and dimensions, build a patch from the input
-   * degraded spectrogram.
+   * Recreate a single roughly aligned ref/deg patch pair from its finely
+   * aligned audio, as for FinelyAlignAndRecreatePatches.
    *
-   * @param spectrogram_data The spectrogram that represents the degraded
-   *    signal.
-   * @param window_beginning The index of the column in the degraded spectrogram
-   *    where this patch should start from. This column index is inclusive.
-   * @param window_end The index of the column in the degraded spectrogram
-   *    where this patch should end. This column index is inclusive.
-   * @param window_height The number of rows needed in the output patch.
-   * @param window_width The number of columns needed in the output patch.
+   * @param sim_result The PatchSimilarityResult of the roughly aligned pair.
+   * @param aligned_result The views of the aligned and truncated reference
+   *    and degraded audio of the pair, and the lag of the degraded, as
+   *    returned by Alignment::AlignAndTruncate.
+   * @param spect_builder A pointer to a SpectrogramBuilder.
+   * @param window An AnalysisWindow used to create the spectrogram
+   * @param workspace The workspace for the scratch buffers of the
+   *    spectrograms, or nullptr to use the heap.
    *
-   * @return The patch built from the degraded spectrogram.
+   * @return A StatusOr that may contain the finely aligned
+   *    PatchSimilarityResult.
    */
-  ImagePatch BuildDegradedPatch(const AMatrix<double> &spectrogram_data,
-                                int window_beginning, size_t window_end,
-                                size_t window_height, size_t window_width)
-                                const;
+  google::protobuf::util::StatusOr<PatchSimilarityResult>
+      FinelyAlignAndRecreatePatch(const PatchSimilarityResult &sim_result,
+          const std::tuple<AudioSignalView, AudioSignalView, double>
+              &aligned_result,
+          const SpectrogramBuilder *spect_builder,
+          const AnalysisWindow &window, VisqolWorkspace *workspace) const;
+
+  /**
+   * Extract a subregion of an audio signal, without copying it. A negative
+   * start time is expressed as leading silence.
+   *
+   * @param in_signal An AudioSignal. It must outlive the returned view.
+   * @param start_time The start time of the sliced audio in seconds.
+   * @param end_time The end time of the sliced audio in seconds.
+   * @return A view of the subregion.
+   */
+  static AudioSignalView Slice(const AudioSignal &in_signal,
+                               double start_time, double end_time);
 
   /**
    * For a given patch from the reference spectrogram, find the most similar
@@ -129,21 +215,51 @@ class ComparisonPatchesSelector {
    * occur before and after, comparing it to the provided reference patch. This
    * process is repreated until the patch that starts at the provided end index
    * has been crated and compared. The result of the most similar patch
-   * comparison is returned.
+   * comparison is returned. With the coarse to fine search strategy, only a
+   * subset of the patches is compared.
    *
    * @param spectrogram_data The spectrogram that represents the degraded
    *    signal.
+   * @param sliding_comparator The sliding comparator over the spectrogram
+   *    data, or nullptr to build and compare each degraded patch in turn.
    * @param ref_patch The reference patch to find the best match for.
    * @param ref_frame_index The index of the column in the spectrogram data from
    *    around which to construct patches for comparison.
    * @param frame_duration The duration of a frame in seconds.
+   * @param workspace The workspace for the scratch buffers of the search, or
+   *    nullptr to use the heap.
    *
    * @return The similarity result from the comparison of the most similar
    *    degraded patch with the reference patch.
    */
   PatchSimilarityResult FindMostSimilarDegPatch(
-      const AMatrix<double> &spectrogram_data, const ImagePatch &ref_patch,
-      int ref_frame_index, const double frame_duration) const;
+      const AMatrix<double> &spectrogram_data,
+      const SlidingPatchComparator *sliding_comparator,
+      const PatchView &ref_patch, int ref_frame_index,
+      const double frame_duration, VisqolWorkspace *workspace) const;
+
+  /**
+   * Measure the similarity of the reference patch with the degraded patches
+   * that start at each of the given offsets.
+   *
+   * @param spectrogram_data The spectrogram that represents the degraded
+   *    signal.
+   * @param sliding_comparator The sliding comparator over the spectrogram
+   *    data, or nullptr to build and compare each degraded patch in turn.
+   * @param ref_patch The reference patch.
+   * @param offsets The indices of the spectrogram columns that the degraded
+   *    patches start at.
+   * @param workspace The workspace for the scratch buffers of the sliding
+   *    comparator, or nullptr to use the heap.
+   *
+   * @return The similarity results, one per offset, in the order of the
+   *    offsets.
+   */
+  std::vector<PatchSimilarityResult> MeasureOffsets(
+      const AMatrix<double> &spectrogram_data,
+      const SlidingPatchComparator *sliding_comparator,
+      const PatchView &ref_patch, const std::vector<int> &offsets,
+      VisqolWorkspace *workspace) const;
 
   /**
    * Calculate the maximum number of patches that the degraded spectrogram can
@@ -170,6 +286,30 @@ class ComparisonPatchesSelector {
    * The patch comparator to use for comparisons.
    */
   const std::unique_ptr<PatchSimilarityComparator> sim_comparator_;
+
+  /**
+   * The number of threads that the patches of a single comparison are
+   * searched and realigned on.
+   */
+  const size_t num_workers_;
+
+  /**
+   * The strategy for searching for the degraded patch that best matches each
+   * reference patch.
+   */
+  const SearchStrategy search_strategy_;
+
+  /**
+   * The patches whose coarse similarity is above this value are not finely
+   * realigned.
+   */
+  const double realign_skip_similarity_;
+
+  /**
+   * If true, the fine realignment of each patch only searches lags of up to
+   * half the patch.
+   */
+  const bool use_bounded_realignment_;
 };
 }  // namespace Visqol
 
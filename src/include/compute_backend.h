@@ -0,0 +1,96 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_INCLUDE_COMPUTEBACKEND_H
+#define VISQOL_INCLUDE_COMPUTEBACKEND_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "neurogram_similiarity_index_measure.h"
+#include "patch_similarity_comparator.h"
+#include "spectrogram_builder.h"
+
+namespace Visqol {
+/**
+ * The factories of a backend that runs the hot stages of a comparison on
+ * other hardware, such as a GPU. Either factory may be empty, in which case
+ * that stage runs on the CPU. Global alignment and the mapping to quality
+ * scores always run on the CPU.
+ */
+struct ComputeBackend {
+  /**
+   * Create the builder of the gammatone spectrograms.
+   *
+   * @param num_bands The number of frequency bands.
+   * @param min_freq The lowest center frequency.
+   * @param speech_mode If true, the highest center frequency is that of the
+   *    speech mode, rather than half of the sample rate.
+   */
+  std::function<std::unique_ptr<SpectrogramBuilder>(size_t num_bands,
+      double min_freq, bool speech_mode)> spectrogram_builder;
+
+  /**
+   * Create the NSIM comparator of the patches.
+   *
+   * @param patch_shape The shape of the patches that are compared.
+   */
+  std::function<std::unique_ptr<PatchSimilarityComparator>(
+      NsimPatchShape patch_shape)> patch_comparator;
+};
+
+/**
+ * A process-wide registry of the compute backends that are linked into the
+ * binary. Backends are built as separate libraries that register themselves
+ * when they are linked in, so the library itself does not depend on them.
+ * This class is thread safe.
+ */
+class ComputeBackendRegistry {
+ public:
+  /**
+   * Register a backend. Backends usually register themselves with the
+   * result of this initializing a static variable.
+   *
+   * @param name The name that the backend is selected by.
+   * @param backend The factories of the backend.
+   *
+   * @return True if the backend was registered, or false if the name was
+   *    already taken, in which case the earlier backend is kept.
+   */
+  static bool Register(const std::string &name, ComputeBackend backend);
+
+  /**
+   * Find a registered backend.
+   *
+   * @param name The name of the backend.
+   *
+   * @return The backend, or null if no backend is registered under the name.
+   *    The backend lives as long as the process.
+   */
+  static const ComputeBackend *Find(const std::string &name);
+
+  /**
+   * @return The names of the registered backends, in order.
+   */
+  static std::vector<std::string> Names();
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_COMPUTEBACKEND_H
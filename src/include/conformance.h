@@ -53,4 +53,76 @@
 
 #define kConformanceCastanetsIdentity (4.7321012530423481)
 
+// The single precision patch search (use_float_patch_search) is tested against
+// the scores above. Across the conformance set, it stays within 1e-5 of them.
+
+// Known scores for a subset of the files above when the spectrograms are built
+// in the STREAMING_GAMMATONE mode. This mode is an approximation, and these
+// scores are tracked separately from the conformance scores above. The MOS-LQO
+// shift relative to the GAMMATONE mode depends on the low frequency content of
+// the signal: it is small for most material (castanets 0.00, guitar -0.14),
+// but large for bass heavy content (strauss -0.51, contrabassoon -1.69).
+#define kStreamingConformanceSpeechCA01Transcoded (2.4433858700827900)
+
+#define kStreamingConformanceStraussLp35 (1.4774740739348688)
+
+#define kStreamingConformanceGuitar64aac (4.3761129174084363)
+
+#define kStreamingConformanceContrabassoon24aac (2.3601258781944550)
+
+#define kStreamingConformanceCastanetsIdentity (4.7321012530423481)
+
+// Known scores for the same subset when the spectrograms are built in the
+// MULTIRATE_GAMMATONE mode. The MOS-LQO stays within 0.001 of the GAMMATONE
+// mode for all of the files above.
+#define kMultirateConformanceSpeechCA01Transcoded (2.4736182201537456)
+
+#define kMultirateConformanceStraussLp35 (1.9905341944797605)
+
+#define kMultirateConformanceGuitar64aac (4.5123345011259035)
+
+#define kMultirateConformanceContrabassoon24aac (4.0502316578615654)
+
+#define kMultirateConformanceCastanetsIdentity (4.7321012530423481)
+
+// Known scores for the same subset when the spectrograms are built in the
+// ERB_STFT mode. The MOS-LQO stays within 0.1 of the GAMMATONE mode across
+// the conformance set. The largest shifts are for low-passed material
+// (strauss +0.08, steely +0.09) and bass heavy content (contrabassoon -0.05).
+#define kErbStftConformanceSpeechCA01Transcoded (2.4864959971264815)
+
+#define kErbStftConformanceStraussLp35 (2.0728776410462322)
+
+#define kErbStftConformanceGuitar64aac (4.5195052825855537)
+
+#define kErbStftConformanceContrabassoon24aac (4.0032809474845470)
+
+#define kErbStftConformanceCastanetsIdentity (4.7321012530423481)
+
+// Known scores for the same subset when the patches are searched with the
+// COARSE_TO_FINE strategy. Across the conformance set, 8 of the 11 files match
+// the same patches as the EXHAUSTIVE search and score identically. The others
+// match a worse patch for some reference patches (sopr -0.13, glock -0.13,
+// contrabassoon -0.18).
+#define kCoarseToFineConformanceSpeechCA01Transcoded (2.4728342405129107)
+
+#define kCoarseToFineConformanceStraussLp35 (1.9905729378864512)
+
+#define kCoarseToFineConformanceGuitar64aac (4.5123244380958951)
+
+#define kCoarseToFineConformanceContrabassoon24aac (3.8745979125163523)
+
+#define kCoarseToFineConformanceCastanetsIdentity (4.7321012530423481)
+
+// How far the MOS-LQO of a pair compared in tiles (tile_duration) may be from
+// that of the pair compared whole, and how far its global lag (in seconds)
+// may be. Every tile is scaled by the spl of the whole signal, but its
+// spectrograms are normalized on their own, so the scores are close but not
+// equal. These bounds are checked by tests/long_duration_test on the 1 minute
+// guitar files with 20 second tiles. They are not measured shifts: they
+// should be tightened to the measured worst case of that test.
+#define kTiledMoslqoTolerance (0.2)
+
+#define kTiledGlobalLagTolerance (0.001)
+
 #endif // VISQOL_INCLUDE_CONFORMANCE_H
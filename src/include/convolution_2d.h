@@ -17,6 +17,10 @@
 #ifndef VISQOL_INCLUDE_CONVOLUTION_2D_H
 #define VISQOL_INCLUDE_CONVOLUTION_2D_H
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
 #include "amatrix.h"
 
 namespace Visqol {
@@ -38,6 +42,102 @@ class Convolution2D {
   static AMatrix<T> Valid2DConvWithBoundary(const AMatrix<T> &fir_filter,
       AMatrix<T> input_matrix);
 
+  /**
+   * Perform a 2D convolution with a separable filter, i.e. the outer product
+   * of the given taps with themselves, on an input with a replicated
+   * boundary. The convolution result will be the same shape as the input.
+   *
+   * The boundary is handled by clamping the indices, so the input is never
+   * copied. For a 3 tap filter the result matches Valid2DConvWithBoundary with
+   * the outer product filter, to within rounding.
+   *
+   * @tparam N The number of taps, which must be odd.
+   * @tparam Input The type of the input. It must provide NumRows(), NumCols()
+   *    and an operator()(row, col), e.g. an AMatrix or a PatchView.
+   *
+   * @param taps The taps of the filter along each dimension.
+   * @param input The input with which to perform the convolution.
+   *
+   * @return The resulting 2d convolution.
+   */
+  template <size_t N, typename Input>
+  static AMatrix<T> SeparableConvWithBoundary(const std::array<T, N> &taps,
+                                              const Input &input) {
+    return RowConvWithBoundary(taps, ColumnConvWithBoundary(taps, input));
+  }
+
+  /**
+   * Convolve each column of an input with the given taps, with the first and
+   * last rows replicated beyond the input. This is the first pass of
+   * SeparableConvWithBoundary.
+   *
+   * @tparam N The number of taps, which must be odd.
+   * @tparam Input The type of the input, as for SeparableConvWithBoundary.
+   *
+   * @param taps The taps of the filter.
+   * @param input The input with which to perform the convolution.
+   *
+   * @return The resulting convolution, the same shape as the input.
+   */
+  template <size_t N, typename Input>
+  static AMatrix<T> ColumnConvWithBoundary(const std::array<T, N> &taps,
+                                           const Input &input) {
+    static_assert(N % 2 == 1, "The filter must have an odd number of taps.");
+    const int reach = N / 2;
+    const int num_rows = input.NumRows();
+    const int num_cols = input.NumCols();
+    AMatrix<T> out_matrix(num_rows, num_cols);
+    for (int col = 0; col < num_cols; col++) {
+      for (int row = 0; row < num_rows; row++) {
+        T sum = 0;
+        for (int k = 0; k < static_cast<int>(N); k++) {
+          const int in_row = std::min(std::max(row + k - reach, 0),
+                                      num_rows - 1);
+          sum += input(in_row, col) * taps[N - 1 - k];
+        }
+        out_matrix(row, col) = sum;
+      }
+    }
+    return out_matrix;
+  }
+
+  /**
+   * Convolve each row of an input with the given taps, with the first and
+   * last columns replicated beyond the input. This is the second pass of
+   * SeparableConvWithBoundary.
+   *
+   * @tparam N The number of taps, which must be odd.
+   * @tparam Input The type of the input, as for SeparableConvWithBoundary.
+   *
+   * @param taps The taps of the filter.
+   * @param input The input with which to perform the convolution.
+   *
+   * @return The resulting convolution, the same shape as the input.
+   */
+  template <size_t N, typename Input>
+  static AMatrix<T> RowConvWithBoundary(const std::array<T, N> &taps,
+                                        const Input &input) {
+    static_assert(N % 2 == 1, "The filter must have an odd number of taps.");
+    const int reach = N / 2;
+    const int num_rows = input.NumRows();
+    const int num_cols = input.NumCols();
+    AMatrix<T> out_matrix(num_rows, num_cols);
+    for (int col = 0; col < num_cols; col++) {
+      int in_cols[N];
+      for (int k = 0; k < static_cast<int>(N); k++) {
+        in_cols[k] = std::min(std::max(col + k - reach, 0), num_cols - 1);
+      }
+      for (int row = 0; row < num_rows; row++) {
+        T sum = 0;
+        for (int k = 0; k < static_cast<int>(N); k++) {
+          sum += input(row, in_cols[k]) * taps[N - 1 - k];
+        }
+        out_matrix(row, col) = sum;
+      }
+    }
+    return out_matrix;
+  }
+
  private:
   /**
    * Add a padded boundary to a matrix.
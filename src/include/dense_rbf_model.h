@@ -0,0 +1,169 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_DENSE_RBF_MODEL_H
+#define VISQOL_INCLUDE_DENSE_RBF_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "svm.h"
+
+#include "embedded_svr_model.h"
+
+namespace Visqol {
+/**
+ * A dense copy of a LIBSVM regression model with an RBF kernel, which
+ * predicts the same values as svm_predict without converting each observation
+ * to a list of sparse nodes.
+ *
+ * The support vectors are held as a contiguous matrix with a row per support
+ * vector, so the kernel of an observation is evaluated with SIMD over each
+ * row rather than by walking the sparse nodes of each support vector.
+ *
+ * The model can be saved to a compiled file, which holds the same values in
+ * the same layout behind a fixed header, so it is loaded with a single read
+ * rather than by parsing the text of a LIBSVM model file.
+ */
+class DenseRbfModel {
+ public:
+  /**
+   * The number of observations that PredictBatch evaluates against each
+   * support vector at a time.
+   */
+  static const size_t kObservationsPerBlock;
+
+  /**
+   * Build a dense copy of a LIBSVM model.
+   *
+   * @param model The LIBSVM model, which need not outlive the copy.
+   *
+   * @return The dense model, or null if the model is not an epsilon or nu
+   *    SVR model with an RBF kernel.
+   */
+  static std::unique_ptr<DenseRbfModel> FromSvmModel(const svm_model *model);
+
+  /**
+   * Build a model from the constant arrays of a model that is compiled into
+   * the library.
+   *
+   * @param model The embedded model.
+   *
+   * @return The model.
+   */
+  static std::unique_ptr<DenseRbfModel> FromEmbedded(
+      const EmbeddedSvrModel &model);
+
+  /**
+   * Load a model from a compiled file.
+   *
+   * @param path The path to the compiled file.
+   * @param source_size Set to the size of the LIBSVM model file that the
+   *    model was compiled from.
+   * @param source_hash Set to the hash of the LIBSVM model file that the
+   *    model was compiled from.
+   *
+   * @return The model, or null if the file could not be read or is not a
+   *    compiled model of this version.
+   */
+  static std::unique_ptr<DenseRbfModel> Load(const std::string &path,
+                                             uint64_t *source_size,
+                                             uint64_t *source_hash);
+
+  /**
+   * Save the model to a compiled file.
+   *
+   * @param path The path to the compiled file.
+   * @param source_size The size of the LIBSVM model file that the model was
+   *    built from.
+   * @param source_hash The hash of the LIBSVM model file that the model was
+   *    built from.
+   *
+   * @return True if the model was saved.
+   */
+  bool Save(const std::string &path, uint64_t source_size,
+            uint64_t source_hash) const;
+
+  /**
+   * Predict a value for an observation, as svm_predict does.
+   *
+   * @param observation The features of the observation. As in LIBSVM, the
+   *    features beyond those of the support vectors are compared with 0, and
+   *    the missing features are 0. Observations of NumFeatures() features
+   *    are predicted without copying them.
+   *
+   * @return The predicted value.
+   */
+  double Predict(absl::Span<const double> observation) const;
+
+  /**
+   * Predict a value for each of a number of observations, as Predict does.
+   * The observations are taken in blocks that stay in the cache, and each
+   * support vector is loaded once per block, so the support vectors are
+   * streamed once per block rather than once per observation. The distances
+   * are accumulated in the same order as by Predict, so the values are the
+   * same.
+   *
+   * @param observations The observations, each of NumFeatures() features.
+   *
+   * @return The predicted value for each observation, in order.
+   */
+  std::vector<double> PredictBatch(
+      absl::Span<const std::vector<double>> observations) const;
+
+  /**
+   * @return The number of features of the observations, which is the highest
+   *    feature index of the support vectors.
+   */
+  size_t NumFeatures() const { return num_features_; }
+
+ private:
+  DenseRbfModel(size_t num_features, double gamma, double rho);
+
+  /**
+   * Predict a value for an observation of NumFeatures() features.
+   *
+   * @param observation The features of the observation.
+   * @param extra_distance The squared distance of the features beyond those
+   *    of the support vectors, which is added to the distance to each one.
+   *
+   * @return The predicted value.
+   */
+  double PredictFeatures(const double *observation,
+                         double extra_distance) const;
+
+  size_t num_features_;
+  double gamma_;
+  double rho_;
+
+  /**
+   * The support vectors, NumFeatures() values per row. The features that are
+   * left out of a sparse support vector are 0.
+   */
+  std::vector<double> support_vectors_;
+
+  /**
+   * The coefficient of each support vector.
+   */
+  std::vector<double> coefficients_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_DENSE_RBF_MODEL_H
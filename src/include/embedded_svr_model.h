@@ -0,0 +1,68 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_EMBEDDED_SVR_MODEL_H
+#define VISQOL_INCLUDE_EMBEDDED_SVR_MODEL_H
+
+#include <cstddef>
+
+namespace Visqol {
+/**
+ * A dense SVR model with an RBF kernel, held in constant arrays that are
+ * compiled into the library.
+ */
+struct EmbeddedSvrModel {
+  /**
+   * The number of features of each support vector.
+   */
+  size_t num_features;
+
+  /**
+   * The number of support vectors.
+   */
+  size_t num_support_vectors;
+
+  /**
+   * The gamma of the RBF kernel.
+   */
+  double gamma;
+
+  /**
+   * The rho of the model, which is subtracted from each prediction.
+   */
+  double rho;
+
+  /**
+   * The coefficient of each support vector.
+   */
+  const double *coefficients;
+
+  /**
+   * The support vectors, num_features values per row.
+   */
+  const double *support_vectors;
+};
+
+/**
+ * The default audio mode model, model/libsvm_nu_svr_model.txt. It is defined
+ * in a source file that the build generates from the model file with
+ * scripts/embed_svr_model.py, so the default model is used without reading
+ * or parsing any file.
+ */
+extern const EmbeddedSvrModel kEmbeddedSvrModel;
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_EMBEDDED_SVR_MODEL_H
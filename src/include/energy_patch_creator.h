@@ -0,0 +1,97 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_ENERGY_PATCH_CREATOR_H
+#define VISQOL_INCLUDE_ENERGY_PATCH_CREATOR_H
+
+#include <cstddef>
+#include <vector>
+
+#include "google/protobuf/stubs/statusor.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal.h"
+#include "image_patch_creator.h"
+
+namespace Visqol {
+/**
+ * A patch creator for audio mode that drops the near-silent reference
+ * patches, such as the silent lead-ins and tails of music masters, before
+ * they are searched for and aligned, as the VadPatchCreator does for speech.
+ *
+ * The level of each patch is the RMS of the reference samples that its frames
+ * cover, relative to the peak sample of the reference, so the threshold does
+ * not depend on the gain of the reference.
+ */
+class EnergyPatchCreator : public ImagePatchCreator {
+ public:
+  /**
+   * Constructs a patch creator.
+   *
+   * @param patch_size The required patch size.
+   * @param silence_threshold_db The level, in dB relative to the peak sample
+   *    of the reference, that a patch must reach to be compared, such as -60.
+   * @param max_patches The maximum number of reference patches that are
+   *    compared, or 0 to compare them all.
+   */
+  EnergyPatchCreator(size_t patch_size, double silence_threshold_db,
+                     size_t max_patches = 0)
+      : ImagePatchCreator(patch_size, max_patches),
+        silence_threshold_db_(silence_threshold_db) {}
+
+  /**
+   * Create the patch indices as ImagePatchCreator does, and drop the patches
+   * below the silence threshold. If every patch is below it, such as for a
+   * silent reference, every patch is kept, so that the comparison can still
+   * be scored.
+   *
+   * @param spectrogram The spectrogram to create patch indices for.
+   * @param ref_signal The reference audio signal.
+   * @param window The analysis window that was used when building the
+   *    spectrogram.
+   *
+   * @return If successful, the vector of patch indices is returned. Else, an
+   *    error status.
+   */
+  google::protobuf::util::StatusOr<std::vector<size_t>> CreateRefPatchIndices(
+      const AMatrix<double> &spectrogram, const AudioSignal &ref_signal,
+      const AnalysisWindow &window) const override;
+
+  /**
+   * Calculate the level of each patch of a signal.
+   *
+   * @param signal The reference signal.
+   * @param patch_indices The indices of the patches.
+   * @param window The analysis window of the spectrogram.
+   *
+   * @return The RMS of the samples of each patch, in dB relative to the peak
+   *    sample of the signal, in the order of the indices.
+   */
+  std::vector<double> CalcPatchLevels(
+      const AudioSignal &signal, const std::vector<size_t> &patch_indices,
+      const AnalysisWindow &window) const;
+
+ private:
+  /**
+   * The level, in dB relative to the peak sample of the reference, that a
+   * patch must reach to be compared.
+   */
+  double silence_threshold_db_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_ENERGY_PATCH_CREATOR_H
@@ -17,9 +17,13 @@
 #ifndef VISQOL_INCLUDE_ENVELOPE_H
 #define VISQOL_INCLUDE_ENVELOPE_H
 
-#include <complex>
+#include <cstddef>
+#include <memory>
 
 #include "amatrix.h"
+#include "audio_channel.h"
+#include "audio_signal_view.h"
+#include "fft_manager.h"
 
 namespace Visqol {
 
@@ -36,17 +40,32 @@ class Envelope {
    * @return The upper envelope for the input signal.
    */
   static AMatrix<double> CalcUpperEnv(const AMatrix<double> &signal);
+
+  /**
+   * For a given view of a signal, calculate the upper envelope.
+   *
+   * @param signal The view of the signal.
+   * @return The upper envelope for the viewed signal.
+   */
+  static AMatrix<double> CalcUpperEnv(const AudioSignalView &signal);
  private:
   /**
-   * Perform a Hilbert Transform on a given single dimensional input signal.
-   * Based on the Matlab implementation for Hilbert.
+   * Apply the Hilbert transform weights of the Matlab implementation to the
+   * spectrum of a centered signal, and transform it back to the real signal
+   * that the upper envelope is the magnitude of. The weights are applied
+   * within the half spectrum, so no complex spectrum or weight vector is
+   * formed.
    *
-   * @param signal The input single dimensional signal to perform the Hilbert
-   *               transform on.
-   * @return The matrix of complex doubles containing the result of the Hilbert
-   *         Transform.
+   * @param fft_manager The FFT manager for the length of the signal.
+   * @param num_samples The number of samples in the signal.
+   * @param buffer The centered signal, zero padded to the FFT size. It is
+   *    overwritten.
+   * @param analytic_signal The output, which must hold the FFT size. The
+   *    first num_samples samples hold the result.
    */
-  static AMatrix<std::complex<double>> Hilbert(const AMatrix<double> &signal);
+  static void CalcAnalyticSignal(
+      const std::unique_ptr<FftManager> &fft_manager, size_t num_samples,
+      AudioChannel *buffer, AudioChannel *analytic_signal);
 };
 }  // namespace Visqol
 
@@ -62,6 +62,21 @@ class EquivalentRectangularBandwidth {
   static ErbFiltersResult MakeFilters(std::size_t sample_rate,
       std::size_t num_channels, double low_freq, double high_freq);
 
+  /**
+   * Calculate the ERB filter coefficients for a given set of center
+   * frequencies. This allows a filter to be designed for a lower sample rate
+   * than the one its center frequency was chosen for, e.g. when filtering a
+   * decimated signal.
+   *
+   * @param sample_rate The sample rate of the signals to be filtered.
+   * @param center_freqs The center frequencies of the filters. Each must be
+   *    below half the sample rate.
+   *
+   * @return The given center frequencies and their filter coefficients.
+   */
+  static ErbFiltersResult MakeFiltersForCenterFreqs(std::size_t sample_rate,
+      const std::vector<double> &center_freqs);
+
  private:
   /**
    * Compute N center frequencies that are uniformly spaced between the given
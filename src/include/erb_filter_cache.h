@@ -0,0 +1,155 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_ERBFILTERCACHE_H
+#define VISQOL_INCLUDE_ERBFILTERCACHE_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+#include "amatrix.h"
+
+namespace Visqol {
+
+/**
+ * A set of ERB filter coefficients that is ready to be handed to a
+ * GammatoneFilterBank.
+ */
+struct ErbFilterSet {
+  /**
+   * The filter coefficients, flipped so that the first row holds the lowest
+   * frequency band.
+   */
+  AMatrix<double> filter_coeffs;
+
+  /**
+   * The center frequencies of the bands, ordered from lowest to highest.
+   */
+  std::vector<double> center_freqs;
+};
+
+/**
+ * A contiguous group of bands of a MultirateGammatoneFilterBank that is
+ * filtered at the same rate.
+ */
+struct MultirateErbStage {
+  /**
+   * The number of times the signal is halved in rate for this stage.
+   */
+  size_t decimation_level;
+
+  /**
+   * The index of the lowest frequency band in this stage.
+   */
+  size_t first_band;
+
+  /**
+   * The filter coefficients of the bands in this stage, designed for the
+   * decimated sample rate.
+   */
+  AMatrix<double> filter_coeffs;
+};
+
+/**
+ * The stages of a MultirateGammatoneFilterBank, designed for a sample rate
+ * and a set of center frequencies.
+ */
+struct MultirateErbFilterSet {
+  /**
+   * The sample rate that the stages are designed for.
+   */
+  size_t sample_rate;
+
+  /**
+   * The center frequencies of the bands, ordered from lowest to highest.
+   */
+  std::vector<double> center_freqs;
+
+  /**
+   * The stages, ordered from the highest frequency to the lowest, so that the
+   * decimation level increases from one stage to the next.
+   */
+  std::vector<MultirateErbStage> stages;
+};
+
+/**
+ * A process-wide cache of ERB filter sets. Building the coefficients with
+ * EquivalentRectangularBandwidth::MakeFilters is relatively expensive, and the
+ * same set is needed for every spectrogram built with a given configuration.
+ * This class is thread safe.
+ */
+class ErbFilterCache {
+ public:
+  /**
+   * Get the ERB filter set for the given configuration, creating it on the
+   * first request.
+   *
+   * @param sample_rate The sample rate of the input signals.
+   * @param num_bands The number of frequency bands in the filter set.
+   * @param min_freq The lowest center frequency to use in the filter set.
+   * @param max_freq The highest center frequency to use in the filter set.
+   *
+   * @return A shared, immutable pointer to the cached filter set.
+   */
+  static std::shared_ptr<const ErbFilterSet> GetFilters(size_t sample_rate,
+      size_t num_bands, double min_freq, double max_freq);
+
+  /**
+   * Get the stages of a MultirateGammatoneFilterBank for the given
+   * configuration, designing them on the first request. The bands have the
+   * center frequencies of the filter set of GetFilters.
+   *
+   * @param sample_rate The sample rate of the input signals.
+   * @param num_bands The number of frequency bands in the filter set.
+   * @param min_freq The lowest center frequency to use in the filter set.
+   * @param max_freq The highest center frequency to use in the filter set.
+   *
+   * @return A shared, immutable pointer to the cached stages.
+   */
+  static std::shared_ptr<const MultirateErbFilterSet> GetMultirateFilters(
+      size_t sample_rate, size_t num_bands, double min_freq, double max_freq);
+
+ private:
+  /**
+   * The key that a filter set is cached under: (sample rate, number of bands,
+   * min frequency, max frequency).
+   */
+  typedef std::tuple<size_t, size_t, double, double> CacheKey;
+
+  /**
+   * Guards access to the cache.
+   */
+  static absl::Mutex cache_mutex_;
+
+  /**
+   * The cached filter sets.
+   */
+  static std::map<CacheKey, std::shared_ptr<const ErbFilterSet>> cache_;
+
+  /**
+   * The cached multirate stages.
+   */
+  static std::map<CacheKey, std::shared_ptr<const MultirateErbFilterSet>>
+      multirate_cache_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_ERBFILTERCACHE_H
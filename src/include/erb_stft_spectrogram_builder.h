@@ -0,0 +1,187 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_ERBSTFTSPECTROGRAMBUILDER_H
+#define VISQOL_INCLUDE_ERBSTFTSPECTROGRAMBUILDER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+#include "amatrix.h"
+#include "spectrogram_builder.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+/**
+ * A fast, approximate alternative to the GammatoneSpectrogramBuilder, intended
+ * for bulk triage.
+ *
+ * Instead of running the gammatone filters over each analysis window, this
+ * builder takes the FFT of each window and sums the power of the FFT bins
+ * into the ERB bands, weighted by the squared magnitude response of the
+ * gammatone filter of each band. The responses are precomputed from the same
+ * ERB filter coefficients that the GammatoneFilterBank uses. The spectrogram
+ * has the same dimensions and center frequencies as the one produced by the
+ * GammatoneSpectrogramBuilder.
+ *
+ * The FFT only approximates the filter ramp up at the start of each window,
+ * so the resulting MOS-LQO differs from the reference mode. The known scores
+ * for this mode are listed in conformance.h. Scores from this mode should only
+ * be compared with other scores from this mode.
+ */
+class ErbStftSpectrogramBuilder : public SpectrogramBuilder {
+ public:
+  /**
+   * Constructs an instance of this ErbStftSpectrogramBuilder.
+   *
+   * @param num_bands The number of frequency bands in the spectrogram.
+   * @param min_freq The lowest center frequency to use.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   */
+  ErbStftSpectrogramBuilder(const size_t num_bands, const double min_freq,
+                            const bool use_speech_mode);
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+  /**
+   * Calculate the squared magnitude response of one band of the gammatone
+   * filter bank, i.e. of its four stage cascade including the gain.
+   *
+   * @param filter_coeffs The ERB filter coefficients, one row per band, as
+   *    passed to GammatoneFilterBank::SetFilterCoefficients.
+   * @param band The row of the band to evaluate.
+   * @param freq The frequency to evaluate the response at.
+   * @param sample_rate The sample rate that the filters were designed for.
+   *
+   * @return The squared magnitude response at the given frequency.
+   */
+  static double FilterPowerResponse(const AMatrix<double> &filter_coeffs,
+                                    size_t band, double freq,
+                                    size_t sample_rate);
+
+ private:
+  /**
+   * The weights that project the FFT bins onto a single band. Only the bins
+   * with a non-negligible weight are stored.
+   */
+  struct BandWeights {
+    /**
+     * The index of the FFT bin that the first weight applies to.
+     */
+    size_t first_bin;
+
+    /**
+     * The weights of consecutive FFT bins, starting at first_bin.
+     */
+    std::vector<double> weights;
+  };
+
+  /**
+   * The lookup tables for a given signal configuration. These are shared by
+   * all builds with that configuration, and are never modified once created.
+   */
+  struct StftTables {
+    /**
+     * The sample rate that the tables were calculated for.
+     */
+    size_t sample_rate;
+
+    /**
+     * The analysis window size that the tables were calculated for.
+     */
+    size_t window_size;
+
+    /**
+     * The hop size that the tables were calculated for.
+     */
+    size_t hop_size;
+
+    /**
+     * The size of the FFT that each window is zero padded to.
+     */
+    size_t fft_size;
+
+    /**
+     * The weights for each band, ordered from the lowest band to the highest.
+     */
+    std::vector<BandWeights> band_weights;
+
+    /**
+     * The taper that is applied to each analysis window before the FFT.
+     */
+    std::vector<double> taper;
+
+    /**
+     * The reciprocal of the power of the taper.
+     */
+    double taper_scale;
+  };
+
+  /**
+   * Get the lookup tables for the given configuration, calculating them
+   * unless the most recently used tables match it.
+   *
+   * @param sample_rate The sample rate of the signal.
+   * @param window_size The number of samples in each analysis window.
+   * @param hop_size The number of samples between the start of each window.
+   * @param filter_coeffs The ERB filter coefficients, one row per band.
+   *
+   * @return The lookup tables.
+   */
+  std::shared_ptr<const StftTables> GetTables(size_t sample_rate,
+      size_t window_size, size_t hop_size,
+      const AMatrix<double> &filter_coeffs) const;
+
+  /**
+   * The weights below which FFT bins are ignored.
+   */
+  static const double kMinWeight;
+
+  /**
+   * The number of frequency bands in the spectrogram.
+   */
+  size_t num_bands_;
+
+  /**
+   * The lowest center frequency to use.
+   */
+  double min_freq_;
+
+  /**
+   * If true, build the spectrogram for speech mode.
+   */
+  bool speech_mode_;
+
+  /**
+   * Guards access to the most recently used lookup tables.
+   */
+  mutable absl::Mutex tables_mutex_;
+
+  /**
+   * The most recently used lookup tables.
+   */
+  mutable std::shared_ptr<const StftTables> tables_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_ERBSTFTSPECTROGRAMBUILDER_H
@@ -19,8 +19,10 @@
 
 #include <complex>
 #include <memory>
+#include <vector>
 
 #include "amatrix.h"
+#include "audio_channel.h"
 #include "fft_manager.h"
 
 namespace Visqol {
@@ -85,6 +87,37 @@ class FastFourierTransform {
   static AMatrix<double> Inverse1dConjSym(
       const std::unique_ptr<FftManager> &fft_manager,
       const AMatrix<std::complex<double>> &in_matrix);
+
+  /**
+   * For a given real signal, perform a forward Fast Fourier Transform and keep
+   * the N/2+1 bins of the half spectrum, in single precision and in the
+   * native PFFFT ordering. The spectrum can be passed to
+   * FftManager::ZConvolveAccumulate and InverseReal1d without reordering.
+   *
+   * @param fft_manager The manager required for performing the FFT.
+   * @param signal The input signal. It is zero padded to the FFT size, and
+   *    must not be longer than the FFT size.
+   * @param spectrum The half spectrum is written here. It must have been
+   *    initialised to the FFT size of the manager.
+   */
+  static void ForwardReal1d(const std::unique_ptr<FftManager> &fft_manager,
+                            const std::vector<double> &signal,
+                            AudioChannel *spectrum);
+
+  /**
+   * For a given half spectrum in the native PFFFT ordering, as produced by
+   * ForwardReal1d, perform the inverse Fast Fourier Transform and return the
+   * real signal.
+   *
+   * @param fft_manager The manager required for performing the FFT.
+   * @param spectrum The half spectrum.
+   *
+   * @return The first samples per channel values of the real signal, as
+   *    returned by Inverse1dConjSym.
+   */
+  static std::vector<double> InverseReal1d(
+      const std::unique_ptr<FftManager> &fft_manager,
+      const AudioChannel &spectrum);
 };
 }  // namespace Visqol
 
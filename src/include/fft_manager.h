@@ -78,6 +78,31 @@ class FftManager {
   void FreqFromTimeDomain(const AudioChannel& time_channel,
       AudioChannel* freq_channel);
 
+  /**
+   * For a given input AudioChannel in the time domain perform a forward fft
+   * and convert it to the frequency domain, in the native pffft ordering.
+   * This skips the reordering of FreqFromTimeDomain, for spectra that are only
+   * passed to ZConvolveAccumulate and TimeFromFreqDomain.
+   *
+   * @param time_channel The input time domain channel.
+   * @param z_channel The output frequency domain channel, in the native pffft
+   *    ordering.
+   */
+  void ZDomainFromTimeDomain(const AudioChannel& time_channel,
+      AudioChannel* z_channel);
+
+  /**
+   * Multiply two spectra in the native pffft ordering, point by point, and
+   * add the scaled product to a third.
+   *
+   * @param a The first spectrum, in the native pffft ordering.
+   * @param b The second spectrum, in the native pffft ordering.
+   * @param ab The spectrum that the product is added to.
+   * @param scaling The scaling applied to the product.
+   */
+  void ZConvolveAccumulate(const AudioChannel& a, const AudioChannel& b,
+      AudioChannel* ab, float scaling);
+
   /**
    * For a given input AudioChannel in the frequency domain, canonically
    * ordered, perform an inverse fft and convert it to the time domain.
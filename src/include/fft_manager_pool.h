@@ -0,0 +1,131 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_FFT_MANAGER_POOL_H
+#define VISQOL_INCLUDE_FFT_MANAGER_POOL_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+
+#include "fft_manager.h"
+
+namespace Visqol {
+
+/**
+ * A process-wide pool of FftManagers. Creating an FftManager sets up the PFFFT
+ * plan and allocates its buffers, which is a noticeable part of the cost of
+ * the short FFTs that are run for every patch. The pool keeps the managers
+ * that are no longer in use, so that later FFTs of the same size reuse them.
+ *
+ * A manager is leased to a single user at a time, so its buffers and
+ * workspace are never shared between threads. This class is thread safe.
+ */
+class FftManagerPool {
+ public:
+  /**
+   * Exclusive use of an FftManager from the pool. The manager is returned to
+   * the pool when the lease is destroyed.
+   */
+  class Lease {
+   public:
+    /**
+     * Lease a manager for the given number of samples, reusing an idle one if
+     * the pool has one for that number of samples.
+     *
+     * @param samples_per_channel The number of samples in the input time
+     *    domain channel, as for the FftManager constructor.
+     */
+    explicit Lease(size_t samples_per_channel);
+
+    /**
+     * Return the manager to the pool.
+     */
+    ~Lease();
+
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    /**
+     * Get the leased manager.
+     *
+     * @return The leased manager. It may only be used while the lease exists.
+     */
+    const std::unique_ptr<FftManager> &Get() const { return manager_; }
+
+   private:
+    /**
+     * The leased manager.
+     */
+    std::unique_ptr<FftManager> manager_;
+  };
+
+  /**
+   * The maximum total size in bytes of the buffers of the idle managers that
+   * the pool keeps. The least recently returned managers are destroyed when
+   * the pool is full, so a manager larger than this is not kept at all.
+   */
+  static const size_t kMaxIdleBytes;
+
+  /**
+   * Estimate the size in bytes of the buffers that a manager holds.
+   *
+   * @param manager The manager.
+   *
+   * @return The estimated size of its buffers, in bytes.
+   */
+  static size_t BufferBytes(const FftManager &manager);
+
+ private:
+  /**
+   * Take an idle manager for the given number of samples from the pool, or
+   * create one if there is none.
+   *
+   * @param samples_per_channel The number of samples in the input time domain
+   *    channel.
+   *
+   * @return The manager.
+   */
+  static std::unique_ptr<FftManager> Acquire(size_t samples_per_channel);
+
+  /**
+   * Return a manager to the pool.
+   *
+   * @param manager The manager that is no longer in use.
+   */
+  static void Release(std::unique_ptr<FftManager> manager);
+
+  /**
+   * Guards access to the idle managers.
+   */
+  static absl::Mutex pool_mutex_;
+
+  /**
+   * The idle managers, ordered from the most recently returned.
+   */
+  static std::list<std::unique_ptr<FftManager>> idle_managers_;
+
+  /**
+   * The total size of the buffers of the idle managers, as estimated by
+   * BufferBytes.
+   */
+  static size_t idle_bytes_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_FFT_MANAGER_POOL_H
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_FINGERPRINT_ALIGNER_H
+#define VISQOL_INCLUDE_FINGERPRINT_ALIGNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "audio_signal.h"
+
+namespace Visqol {
+
+/**
+ * Globally aligns a degraded signal to a reference signal by matching
+ * landmarks, i.e. pairs of spectro-temporal energy peaks, of the two signals.
+ * Each pair of matching landmarks votes for the frame offset between the
+ * signals. The offset with the most votes is refined to the sample with a
+ * bounded envelope cross correlation of an excerpt of the signals.
+ *
+ * The memory and time taken grow linearly with the length of the signals, so
+ * hour long recordings can be aligned without a cross correlation FFT of
+ * their whole length. If the vote or the refinement is not confident, the
+ * signals are aligned with Alignment::GloballyAlign instead.
+ */
+class FingerprintAligner {
+ public:
+  /**
+   * The number of samples in each frame that the band energies are
+   * calculated for.
+   */
+  static const size_t kFrameSize;
+
+  /**
+   * The number of samples between the starts of consecutive frames.
+   */
+  static const size_t kHopSize;
+
+  /**
+   * The number of log spaced frequency bands that the energies are
+   * calculated for.
+   */
+  static const size_t kNumBands;
+
+  /**
+   * A band energy is a peak if it is higher than every other band energy
+   * within this many frames of it.
+   */
+  static const size_t kPeakFrameRadius;
+
+  /**
+   * A band energy is a peak if it is higher than every other band energy
+   * within this many bands of it.
+   */
+  static const size_t kPeakBandRadius;
+
+  /**
+   * The maximum number of later peaks that each peak is paired with.
+   */
+  static const size_t kFanOut;
+
+  /**
+   * The maximum number of frames between the two peaks of a landmark.
+   */
+  static const size_t kMaxPairFrames;
+
+  /**
+   * The minimum number of votes for the frame offset to be trusted.
+   */
+  static const size_t kMinVotes;
+
+  /**
+   * The minimum ratio of the votes for the best frame offset to the votes for
+   * any offset that is not next to it, for the frame offset to be trusted.
+   */
+  static const double kMinVoteRatio;
+
+  /**
+   * The maximum number of samples of the excerpt that the frame offset is
+   * refined with.
+   */
+  static const size_t kRefineSamples;
+
+  /**
+   * For a given reference signal, align a second degraded signal with it.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal to align.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  static std::tuple<AudioSignal, double> GloballyAlign(
+      const AudioSignal &ref_signal, const AudioSignal &deg_signal);
+
+ private:
+  /**
+   * A peak of the band energies.
+   */
+  struct Peak {
+    int64_t frame;
+    size_t band;
+  };
+
+  /**
+   * Find the frame offset between two signals by voting with their matching
+   * landmarks.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @param frame_offset Set to the number of frames that the degraded signal
+   *    lags the reference, in the sense of XCorr::CalcBestLag.
+   * @return True if the vote is confident.
+   */
+  static bool VoteFrameOffset(const AudioSignal &ref_signal,
+                              const AudioSignal &deg_signal,
+                              int64_t *frame_offset);
+
+  /**
+   * Refine a coarse lag to the sample by cross correlating the upper
+   * envelopes of an excerpt of each signal, only for lags of up to two hops
+   * from the coarse lag.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @param coarse_lag The coarse lag of the degraded signal, in samples.
+   * @param best_lag Set to the refined lag of the degraded signal, in samples.
+   * @return True if the refined lag is within the searched lags, rather than
+   *    at their edge.
+   */
+  static bool RefineLag(const AudioSignal &ref_signal,
+                        const AudioSignal &deg_signal, int64_t coarse_lag,
+                        int64_t *best_lag);
+
+  /**
+   * Calculate the energy of each band of each frame of a signal.
+   *
+   * @param signal The signal.
+   * @return The band energies, kNumBands for each frame in turn.
+   */
+  static std::vector<float> CalcBandEnergies(const AudioSignal &signal);
+
+  /**
+   * Find the peaks of the band energies of a signal.
+   *
+   * @param band_energies The band energies, kNumBands for each frame in turn.
+   * @return The peaks, ordered by frame.
+   */
+  static std::vector<Peak> FindPeaks(const std::vector<float> &band_energies);
+
+  /**
+   * Pair each peak with the following peaks into landmarks.
+   *
+   * @param peaks The peaks, ordered by frame.
+   * @return The hash of each landmark and the frame of its first peak.
+   */
+  static std::vector<std::pair<uint32_t, int64_t>> FindLandmarks(
+      const std::vector<Peak> &peaks);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_FINGERPRINT_ALIGNER_H
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_FIXEDPOINTGAMMATONEFILTERBANK_H
+#define VISQOL_INCLUDE_FIXEDPOINTGAMMATONEFILTERBANK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+
+namespace Visqol {
+
+/**
+ * A fixed-point variant of the GammatoneFilterBank, for targets without fast
+ * double precision arithmetic.
+ *
+ * The samples and the filter outputs are 32 bit integers with
+ * kSignalFracBits fractional bits, and the coefficients are 32 bit integers
+ * with kCoeffFracBits fractional bits. The filter state is held in 64 bit
+ * accumulators, so that the only rounding is of the output of each stage.
+ * That rounding error is fed back into the next sample of the stage, which
+ * keeps it from being amplified by the poles of the low frequency bands.
+ *
+ * The numerator of each stage is scaled to unity gain at the center frequency
+ * of its band, so that every stage has the same headroom. The gain of the
+ * whole cascade is that of the GammatoneFilterBank. Only the filter design is
+ * done in floating point, once per configuration.
+ */
+class FixedPointGammatoneFilterBank {
+ public:
+  /**
+   * Constructs the FixedPointGammatoneFilterBank with the specified number of
+   * bands and the minimum frequency to utilise.
+   *
+   * @param num_bands The number of frequency bands to filter with. There will
+   *    be this number of bands in the spectrogram that is produced.
+   * @param min_freq The lowest frequency value to include in the filter.
+   */
+  FixedPointGammatoneFilterBank(const size_t num_bands, const double min_freq);
+
+  /**
+   * Get the number of bands in this filter bank.
+   *
+   * @return The number of bands in this filter bank.
+   */
+  size_t GetNumBands() const;
+
+  /**
+   * Get the lowest frequency that is used in this filter bank.
+   *
+   * @return The lowest frequency that is used in this filter bank.
+   */
+  double GetMinFreq() const;
+
+  /**
+   * Quantize the equivalent rectangular bandwidth filter coefficients that
+   * are to be used.
+   *
+   * @param filter_coeffs The input filter coefficients, as passed to
+   *    GammatoneFilterBank::SetFilterCoefficients.
+   * @param center_freqs The center frequencies of the bands, in the order of
+   *    the rows of filter_coeffs.
+   * @param sample_rate The sample rate that the filters were designed for.
+   */
+  void SetFilterCoefficients(const AMatrix<double> &filter_coeffs,
+                             const std::vector<double> &center_freqs,
+                             size_t sample_rate);
+
+  /**
+   * Convert a sample to the fixed-point format of the filter bank, saturating
+   * samples that are out of its range. A 16 bit sample s that was normalized
+   * to s / 32768, as the WavReader samples are, converts exactly to
+   * s << (kSignalFracBits - 15).
+   *
+   * @param sample The sample to convert.
+   *
+   * @return The fixed-point sample.
+   */
+  static int32_t ToFixedPoint(double sample);
+
+  /**
+   * Apply the filter bank to a fixed-point signal and calculate the root mean
+   * square of the filtered output in each band. The sum of squares is
+   * accumulated in integers while filtering, and only the root mean square of
+   * each band is converted to floating point.
+   *
+   * @param signal The fixed-point signal to be filtered.
+   * @param rms The root mean square of the filtered output is written here,
+   *    one value per band.
+   */
+  void ApplyFilterRms(absl::Span<const int32_t> signal, absl::Span<double> rms);
+
+  /**
+   * Reset the filter conditions to zero before filtering a signal. If the
+   * filter bank is to be used for multiple signals, this must be called before
+   * starting to filter each signal.
+   */
+  void ResetFilterConditions();
+
+  /**
+   * The number of fractional bits of the samples and of the filter outputs.
+   * This leaves 16x headroom above a full scale sample.
+   */
+  static const int kSignalFracBits;
+
+  /**
+   * The number of fractional bits of the filter coefficients.
+   */
+  static const int kCoeffFracBits;
+
+ private:
+  /**
+   * The number of frequency bands to filter with.
+   */
+  size_t num_bands_;
+
+  /**
+   * The lowest frequency value to include in the filter.
+   */
+  double min_freq_;
+
+  /**
+   * The fixed-point coefficients of the four stage cascade, kNumCoeffs values
+   * per band. Each stage has three numerator coefficients, and the stages
+   * share two denominator coefficients.
+   */
+  std::vector<int32_t> coeffs_;
+
+  /**
+   * The filter conditions of the four stage cascade, kNumStates values per
+   * band. Each stage has two delay elements and the rounding error of its
+   * last output.
+   */
+  std::vector<int64_t> state_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_FIXEDPOINTGAMMATONEFILTERBANK_H
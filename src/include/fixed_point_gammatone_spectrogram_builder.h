@@ -0,0 +1,70 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_FIXEDPOINTGAMMATONESPECTROGRAMBUILDER_H
+#define VISQOL_INCLUDE_FIXEDPOINTGAMMATONESPECTROGRAMBUILDER_H
+
+#include "fixed_point_gammatone_filterbank.h"
+#include "spectrogram_builder.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+/**
+ * Builds a gammatone spectrogram with a FixedPointGammatoneFilterBank.
+ *
+ * The signal is converted to fixed point once, and each analysis window is
+ * then filtered independently in integer arithmetic, as with the
+ * GammatoneSpectrogramBuilder. The spectrogram has the same dimensions and
+ * center frequencies as the one produced by the GammatoneSpectrogramBuilder,
+ * and its band levels are within a fraction of a dB of it down to the noise
+ * floor of 16 bit audio. Scores from this mode should only be compared with
+ * other scores from this mode.
+ */
+class FixedPointGammatoneSpectrogramBuilder : public SpectrogramBuilder {
+ public:
+  /**
+   * Constructs an instance of this FixedPointGammatoneSpectrogramBuilder
+   * using the provided FixedPointGammatoneFilterBank.
+   *
+   * @param filter_bank The fixed-point gammatone filter bank to apply to the
+   *    signal.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   */
+  FixedPointGammatoneSpectrogramBuilder(
+      const FixedPointGammatoneFilterBank &filter_bank,
+      const bool use_speech_mode);
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The configuration of the fixed-point gammatone filter bank to apply to
+   * the signal. Each call to Build filters with its own copy of it.
+   */
+  FixedPointGammatoneFilterBank filter_bank_;
+
+  /**
+   * If true, build the spectrogram for speech mode.
+   */
+  bool speech_mode_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_FIXEDPOINTGAMMATONESPECTROGRAMBUILDER_H
@@ -19,6 +19,9 @@
 
 #include <cstddef>
 #include <valarray>
+#include <vector>
+
+#include "absl/types/span.h"
 
 #include "amatrix.h"
 
@@ -68,6 +71,53 @@ class GammatoneFilterBank {
    */
   AMatrix<double> ApplyFilter(const std::valarray<double>& signal);
 
+  /**
+   * Apply the filter bank to the signal and calculate the root mean square of
+   * the filtered output in each band. The sum of squares is accumulated while
+   * filtering, so the filtered output is never stored.
+   *
+   * This produces the same values as squaring the output of ApplyFilter and
+   * taking the square root of the mean of each row.
+   *
+   * @param signal The signal to be filtered.
+   *
+   * @return The root mean square of the filtered output, one value per band.
+   */
+  std::vector<double> ApplyFilterRms(absl::Span<const double> signal);
+
+  /**
+   * As ApplyFilterRms, but writes the root mean square of each band into a
+   * buffer of the caller, such as a column of the spectrogram, rather than
+   * allocating a new vector.
+   *
+   * @param signal The signal to be filtered.
+   * @param rms The root mean square of the filtered output is written here,
+   *    one value per band.
+   */
+  void ApplyFilterRms(absl::Span<const double> signal, absl::Span<double> rms);
+
+  /**
+   * Apply the filter bank to the signal and calculate the sum of squares of
+   * the filtered output in each band. The filter conditions carry over from
+   * the previous call, so a long signal can be filtered in consecutive blocks.
+   *
+   * @param signal The signal to be filtered.
+   *
+   * @return The sum of squares of the filtered output, one value per band.
+   */
+  std::vector<double> ApplyFilterEnergy(absl::Span<const double> signal);
+
+  /**
+   * As ApplyFilterEnergy, but writes the sum of squares of each band into a
+   * buffer of the caller rather than allocating a new vector.
+   *
+   * @param signal The signal to be filtered.
+   * @param energy The sum of squares of the filtered output is written here,
+   *    one value per band.
+   */
+  void ApplyFilterEnergy(absl::Span<const double> signal,
+                         absl::Span<double> energy);
+
   /**
    * Set the equivalent rectangular bandwidth filter coefficients that are to
    * be used.
@@ -76,6 +126,15 @@ class GammatoneFilterBank {
    */
   void SetFilterCoefficients(const AMatrix<double> &filter_coeffs);
 
+  /**
+   * Get the packed coefficients of the filter cascade, in the layout that
+   * SimdKernels::gammatone_filter takes, for the filters that run elsewhere,
+   * such as on a GPU.
+   *
+   * @return The coefficients set by SetFilterCoefficients.
+   */
+  const std::vector<double> &GetCascadeCoefficients() const;
+
   /**
    * Reset the filter conditions to zero before filtering a signal. If the
    * filter bank is to be used for multiple signals, this must be called before
@@ -95,20 +154,32 @@ class GammatoneFilterBank {
    */
   double min_freq_;
 
-  std::valarray<std::valarray<double>> fltr_cond_1_;
-  std::valarray<std::valarray<double>> fltr_cond_2_;
-  std::valarray<std::valarray<double>> fltr_cond_3_;
-  std::valarray<std::valarray<double>> fltr_cond_4_;
-  std::valarray<double> fltr_coeff_A0_;
-  std::valarray<double> fltr_coeff_A11_;
-  std::valarray<double> fltr_coeff_A12_;
-  std::valarray<double> fltr_coeff_A13_;
-  std::valarray<double> fltr_coeff_A14_;
-  std::valarray<double> fltr_coeff_A2_;
-  std::valarray<double> fltr_coeff_B0_;
-  std::valarray<double> fltr_coeff_B1_;
-  std::valarray<double> fltr_coeff_B2_;
-  std::valarray<double> fltr_coeff_gain_;
+  /**
+   * The number of coefficient rows in the packed cascade coefficients. Each of
+   * the four filter stages has three numerator coefficients, and the stages
+   * share two denominator coefficients.
+   */
+  static const size_t kNumCascadeCoeffs;
+
+  /**
+   * The number of state values held per band. Each of the four filter stages
+   * has two delay elements.
+   */
+  static const size_t kNumCascadeStates;
+
+  /**
+   * The filter coefficients for the four stage cascade, packed as
+   * kNumCascadeCoeffs rows of num_bands_ values. Keeping the values for
+   * neighbouring bands contiguous allows several bands to be filtered at once
+   * in SIMD lanes.
+   */
+  std::vector<double> cascade_coeffs_;
+
+  /**
+   * The filter conditions for the four stage cascade, packed as
+   * kNumCascadeStates rows of num_bands_ values.
+   */
+  std::vector<double> cascade_state_;
 };
 }  // namespace Visqol
 
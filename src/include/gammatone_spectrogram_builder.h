@@ -17,8 +17,14 @@
 #ifndef VISQOL_INCLUDE_GAMMATONESPECTROGRAMBUILDER_H
 #define VISQOL_INCLUDE_GAMMATONESPECTROGRAMBUILDER_H
 
+#include <cstddef>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
 #include "gammatone_filterbank.h"
 #include "spectrogram_builder.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 
@@ -42,18 +48,80 @@ class GammatoneSpectrogramBuilder : public SpectrogramBuilder {
    * provided GammatoneFilterBank.
    *
    * @param filter_bank The gamatone filter bank to apply to the signal.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   * @param num_threads The number of threads to build the spectrogram columns
+   *    with. Frames are filtered independently, so each thread works on its
+   *    own contiguous range of columns with its own copy of the filter bank
+   *    state. A value of 1 (the default) builds all columns on the calling
+   *    thread.
    */
   explicit GammatoneSpectrogramBuilder(const GammatoneFilterBank &filter_bank,
-      const bool use_speech_mode);
+      const bool use_speech_mode, const size_t num_threads = 1);
 
   // Docs inherited from parent.
   google::protobuf::util::StatusOr<Spectrogram> Build(
-      const AudioSignal &signal,
-      const AnalysisWindow &window) override;
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> BuildColumnRanges(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      const SpectrogramColumnRanges &columns,
+      VisqolWorkspace *workspace = nullptr) const override;
 
  private:
   /**
-   * The gammatone filter bank to apply to the signal.
+   * Build the spectrogram of a signal, filling the given columns, or every
+   * column if they are null.
+   */
+  google::protobuf::util::StatusOr<Spectrogram> BuildSelectedColumns(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      const SpectrogramColumnRanges *columns,
+      VisqolWorkspace *workspace) const;
+
+  /**
+   * Fill a share of the columns of a set of column ranges, counting the
+   * columns of the ranges in order, so that the columns can be split evenly
+   * between threads.
+   *
+   * @param filter_bank The filter bank to filter the frames with.
+   * @param signal The signal to build the spectrogram from.
+   * @param window_size The number of samples in each frame.
+   * @param hop_size The number of samples between the start of each frame.
+   * @param ranges The column ranges.
+   * @param first The position of the first column of the share.
+   * @param end One past the position of the last column of the share.
+   * @param out_matrix The spectrogram matrix to write the columns into.
+   */
+  static void BuildRangeColumns(GammatoneFilterBank *filter_bank,
+                                absl::Span<const double> signal,
+                                size_t window_size, size_t hop_size,
+                                const SpectrogramColumnRanges &ranges,
+                                size_t first, size_t end,
+                                AMatrix<double> *out_matrix);
+
+  /**
+   * Fill a range of spectrogram columns. Each column is the per band RMS of
+   * the filtered frame that starts at (column * hop_size).
+   *
+   * @param filter_bank The filter bank to filter the frames with. Its filter
+   *    conditions are reset before each frame.
+   * @param signal The signal to build the spectrogram from.
+   * @param window_size The number of samples in each frame.
+   * @param hop_size The number of samples between the start of each frame.
+   * @param first_col The first column to fill.
+   * @param end_col One past the last column to fill.
+   * @param out_matrix The spectrogram matrix to write the columns into.
+   */
+  static void BuildColumns(GammatoneFilterBank *filter_bank,
+                           absl::Span<const double> signal,
+                           size_t window_size, size_t hop_size,
+                           size_t first_col, size_t end_col,
+                           AMatrix<double> *out_matrix);
+
+  /**
+   * The configuration of the gammatone filter bank to apply to the signal.
+   * Each call to Build filters with its own copy of it.
    */
   GammatoneFilterBank filter_bank_;
 
@@ -61,6 +129,11 @@ class GammatoneSpectrogramBuilder : public SpectrogramBuilder {
    * If true, build the spectrogram for speech mode.
    */
   bool speech_mode_;
+
+  /**
+   * The number of threads to build the spectrogram columns with.
+   */
+  size_t num_threads_;
 };
 }  // namespace Visqol
 
@@ -24,6 +24,7 @@
 #include "amatrix.h"
 #include "analysis_window.h"
 #include "audio_signal.h"
+#include "patch_view.h"
 
 namespace Visqol {
 using ImagePatch = AMatrix<double>;
@@ -37,8 +38,11 @@ class ImagePatchCreator {
    * Constructor for the patch creator for patches of the specified size.
    *
    * @param patch_size The required patch size.
+   * @param max_patches The maximum number of reference patches that are
+   *    compared, or 0 to compare them all.
    */
-  explicit ImagePatchCreator(size_t patch_size) : patch_size_(patch_size) {}
+  explicit ImagePatchCreator(size_t patch_size, size_t max_patches = 0)
+      : patch_size_(patch_size), max_patches_(max_patches) {}
 
   virtual ~ImagePatchCreator() {}
 
@@ -62,19 +66,38 @@ class ImagePatchCreator {
 
   /**
    * For a given spectrogram and vector of patch indices, create a vector of
-   * patches.
+   * patches. The patches are views of the spectrogram, so no data is copied.
    *
-   * @param spectrogram The spectrogram to create patches from.
+   * @param spectrogram The spectrogram to create patches from. This must
+   *    outlive the patches.
    * @param patch_indices The indices for the set of patches. Each index
    *    corresponds to the index of the column in the spectrogram where this
    *    patch starts from.
    *
    * @return The vector of patches.
    */
-  std::vector<ImagePatch> CreatePatchesFromIndices(
+  std::vector<PatchView> CreatePatchesFromIndices(
       const AMatrix<double> &spectrogram,
       const std::vector<size_t> &patch_indices) const;
 
+  /**
+   * Select the reference patches that are compared, if there are more than
+   * the maximum number of patches. The selected patches are evenly spaced
+   * over all of the patches, so the same patches are always selected.
+   *
+   * @param patch_indices The indices of all of the reference patches, in
+   *    order.
+   *
+   * @return The indices of the patches to compare, in order.
+   */
+  std::vector<size_t> SelectPatchIndices(
+      const std::vector<size_t> &patch_indices) const;
+
+  /**
+   * @return The number of frames in each patch.
+   */
+  size_t PatchSize() const { return patch_size_; }
+
  protected:
   /**
    * The number of frames that each patch should contain. A single frame is
@@ -82,6 +105,12 @@ class ImagePatchCreator {
    */
   size_t patch_size_;
 
+  /**
+   * The maximum number of reference patches that are compared, or 0 to
+   * compare them all.
+   */
+  size_t max_patches_;
+
  private:
   /**
    * For the given spectrogram, create a vector of patch indices. Each index
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_MEMORY_USAGE_H
+#define VISQOL_INCLUDE_MEMORY_USAGE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Visqol {
+/**
+ * The memory used by a comparison.
+ */
+struct MemoryUsage {
+  /**
+   * The total number of bytes allocated, including the bytes that were
+   * freed again. Only counted when the counting allocator is linked in.
+   */
+  uint64_t bytes_allocated = 0;
+
+  /**
+   * The number of allocations. Only counted when the counting allocator is
+   * linked in.
+   */
+  uint64_t num_allocations = 0;
+
+  /**
+   * The peak resident set size of the process (in KB) by the end of the
+   * comparison. As the peak is shared by every thread of the process, it
+   * covers any comparisons that ran concurrently.
+   */
+  uint64_t peak_rss_kb = 0;
+};
+
+/**
+ * Counts the allocations made by the calling thread, and by the threads that
+ * it starts for the comparison, from its construction to its destruction.
+ *
+ * Allocations are only counted when the counting allocator, which replaces
+ * the global operator new, is linked into the binary. The peak RSS is always
+ * recorded.
+ */
+class AllocationCounter {
+ public:
+  /**
+   * Makes a thread count its allocations into a counter, for as long as it is
+   * in scope. Used by the threads that a comparison starts, so that their
+   * allocations are counted with the comparison.
+   */
+  class ThreadScope {
+   public:
+    /**
+     * @param counter The counter to count into, or null to not count.
+     */
+    explicit ThreadScope(AllocationCounter *counter);
+    ~ThreadScope();
+
+    ThreadScope(const ThreadScope &) = delete;
+    ThreadScope &operator=(const ThreadScope &) = delete;
+
+   private:
+    AllocationCounter *previous_;
+  };
+
+  /**
+   * Starts counting the allocations of the calling thread.
+   *
+   * @param usage The usage to add the counts to, or null to not count.
+   */
+  explicit AllocationCounter(MemoryUsage *usage);
+  ~AllocationCounter();
+
+  /**
+   * Stops counting before the counter goes out of scope, and adds the counts
+   * and the peak RSS to the usage. The counts are only added once.
+   */
+  void Stop();
+
+  AllocationCounter(const AllocationCounter &) = delete;
+  AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+  /**
+   * @return The counter that the calling thread counts into, or null. Threads
+   *    that are started for a comparison pass it to a ThreadScope.
+   */
+  static AllocationCounter *Current();
+
+  /**
+   * Counts an allocation of the calling thread. Called by the counting
+   * allocator, so it must not allocate.
+   *
+   * @param size The number of bytes allocated.
+   */
+  static void RecordAllocation(size_t size);
+
+  /**
+   * Records that the counting allocator is linked in.
+   *
+   * @return True.
+   */
+  static bool MarkHooked();
+
+  /**
+   * @return True if the counting allocator is linked in, so allocations are
+   *    counted.
+   */
+  static bool IsHooked();
+
+  /**
+   * @return The peak resident set size of the process (in KB), or 0 if it
+   *    cannot be read on this platform.
+   */
+  static uint64_t PeakRssKb();
+
+ private:
+  MemoryUsage *usage_;
+  AllocationCounter *previous_;
+  std::atomic<uint64_t> bytes_allocated_{0};
+  std::atomic<uint64_t> num_allocations_{0};
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_MEMORY_USAGE_H
@@ -0,0 +1,245 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_METRICS_H
+#define VISQOL_INCLUDE_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace Visqol {
+/**
+ * The labels of a metric, as name/value pairs.
+ */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Receives the metrics of the comparisons of a process: counters, such as
+ * the number of pairs compared, and latencies, such as the time spent in each
+ * stage. Implementations must allow calls from any thread.
+ */
+class MetricsSink {
+ public:
+  virtual ~MetricsSink() {}
+
+  /**
+   * Add to a counter.
+   *
+   * @param name The name of the counter.
+   * @param labels The labels of the counter.
+   * @param delta The amount to add.
+   */
+  virtual void IncrementCounter(const std::string &name,
+                                const MetricLabels &labels,
+                                uint64_t delta) = 0;
+
+  /**
+   * Record a latency.
+   *
+   * @param name The name of the latency.
+   * @param labels The labels of the latency.
+   * @param seconds The latency (in sec).
+   */
+  virtual void ObserveLatency(const std::string &name,
+                              const MetricLabels &labels,
+                              double seconds) = 0;
+};
+
+/**
+ * The metrics that ViSQOL reports, and the sink that they are reported to.
+ * No metrics are reported until a sink is set, and each metric then costs a
+ * single check of the sink.
+ *
+ * The metrics are:
+ *  - visqol_pairs_total{code}: the pairs compared, by the name of the
+ *    google::protobuf::util::error::Code of their result.
+ *  - visqol_pair_seconds: the latency of each pair.
+ *  - visqol_stage_seconds{stage}: the latency of each stage of a comparison.
+ *  - visqol_dropped_patches_total: the reference patches that were dropped
+ *    because the degraded file was misaligned or too short.
+ *  - visqol_reference_cache_lookups_total{result}: the lookups of the
+ *    reference cache, with a result of "hit" or "miss".
+ *  - visqol_server_requests_total{code}: the requests handled by the server,
+ *    by the name of the code of their response.
+ *  - visqol_server_request_seconds: the latency of each server request,
+ *    including the wait for a free slot.
+ */
+class Metrics {
+ public:
+  /**
+   * Set the sink that metrics are reported to.
+   *
+   * @param sink The sink, which must outlive its use, or null to stop
+   *    reporting metrics.
+   */
+  static void SetSink(MetricsSink *sink);
+
+  /**
+   * @return True if metrics are reported to a sink.
+   */
+  static bool IsEnabled();
+
+  /**
+   * Add to a counter of the sink, if there is one.
+   */
+  static void IncrementCounter(const std::string &name,
+                               const MetricLabels &labels = MetricLabels(),
+                               uint64_t delta = 1);
+
+  /**
+   * Record a latency in the sink, if there is one.
+   */
+  static void ObserveLatency(const std::string &name,
+                             const MetricLabels &labels, double seconds);
+
+  /**
+   * Report a compared pair to visqol_pairs_total and visqol_pair_seconds.
+   *
+   * @param error_code The google::protobuf::util::error::Code of its result.
+   * @param seconds The latency of the pair (in sec).
+   */
+  static void ReportPair(int error_code, double seconds);
+
+  /**
+   * Report the latency of a stage of a comparison to visqol_stage_seconds.
+   *
+   * @param stage The name of the stage.
+   * @param seconds The latency of the stage (in sec).
+   */
+  static void ReportStage(const char *stage, double seconds);
+
+  /**
+   * Report reference patches that were dropped to
+   * visqol_dropped_patches_total.
+   *
+   * @param num_patches The number of patches that were dropped.
+   */
+  static void ReportDroppedPatches(size_t num_patches);
+
+  /**
+   * Report a lookup of the reference cache to
+   * visqol_reference_cache_lookups_total.
+   *
+   * @param hit True if the reference was found in the cache.
+   */
+  static void ReportReferenceCacheLookup(bool hit);
+
+  /**
+   * Report a lookup of the result cache to visqol_result_cache_lookups_total.
+   *
+   * @param hit True if the result was found in the cache.
+   */
+  static void ReportResultCacheLookup(bool hit);
+
+  /**
+   * Report a request handled by the server to visqol_server_requests_total
+   * and visqol_server_request_seconds.
+   *
+   * @param error_code The google::protobuf::util::error::Code of its
+   *    response.
+   * @param seconds The latency of the request (in sec).
+   */
+  static void ReportServerRequest(int error_code, double seconds);
+
+  /**
+   * @param code A google::protobuf::util::error::Code.
+   *
+   * @return The name of the code, such as "OK" or "CANCELLED".
+   */
+  static const char *ErrorCodeName(int code);
+};
+
+/**
+ * A MetricsSink that aggregates the metrics in memory, so that they can be
+ * exported as plain text or in the Prometheus text format. Each latency is
+ * kept as a histogram with fixed buckets.
+ */
+class MetricsRegistry : public MetricsSink {
+ public:
+  /**
+   * The upper bounds (in sec) of the buckets of the latency histograms. A
+   * last bucket holds the larger latencies.
+   */
+  static const std::vector<double> kLatencyBuckets;
+
+  void IncrementCounter(const std::string &name, const MetricLabels &labels,
+                        uint64_t delta) override;
+
+  void ObserveLatency(const std::string &name, const MetricLabels &labels,
+                      double seconds) override;
+
+  /**
+   * Export the metrics as plain text, with a line per counter and a line
+   * with the count, mean and maximum of each latency.
+   *
+   * @return The metrics as plain text.
+   */
+  std::string FormatText() const;
+
+  /**
+   * Export the metrics in the Prometheus text exposition format.
+   *
+   * @return The metrics in the Prometheus format.
+   */
+  std::string FormatPrometheus() const;
+
+  /**
+   * Write the metrics to a file, replacing it at once so that readers never
+   * see a partly written file, as the textfile collector of the Prometheus
+   * node exporter requires.
+   *
+   * @param path The path of the file.
+   * @param prometheus If true, the metrics are written in the Prometheus
+   *    format, else as plain text.
+   *
+   * @return True if the file was written.
+   */
+  bool WriteToFile(const std::string &path, bool prometheus) const;
+
+ private:
+  struct Histogram {
+    std::vector<uint64_t> bucket_counts =
+        std::vector<uint64_t>(kLatencyBuckets.size() + 1);
+    uint64_t count = 0;
+    double sum = 0.0;
+    double max = 0.0;
+  };
+
+  /**
+   * Format the labels of a metric, with an extra label if it is not empty,
+   * as {name="value",...}, or an empty string if there are no labels.
+   */
+  static std::string FormatLabels(const std::string &labels,
+                                  const std::string &extra_label);
+
+  mutable absl::Mutex mutex_;
+
+  /**
+   * The counters and histograms by name, then by their formatted labels.
+   */
+  std::map<std::string, std::map<std::string, uint64_t>> counters_;
+  std::map<std::string, std::map<std::string, Histogram>> histograms_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_METRICS_H
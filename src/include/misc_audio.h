@@ -59,11 +59,44 @@ class MiscAudio {
   static AudioSignal ScaleToMatchSoundPressureLevel(
       const AudioSignal &reference, const AudioSignal &degraded);
 
+  /**
+   * Scale the degraded signal in place so that its spl matches the spl of the
+   * reference signal, as the copying overload does, without allocating a
+   * scaled copy of it.
+   *
+   * The degraded signal must own its samples, as a borrowed matrix would have
+   * the samples that it borrows scaled.
+   *
+   * @param reference The reference signal whose spl is to be matched.
+   * @param degraded The degraded signal to scale.
+   */
+  static void ScaleToMatchSoundPressureLevel(const AudioSignal &reference,
+                                             AudioSignal *degraded);
+
+  /**
+   * Whether the degraded signal matches the reference signal once its spl is
+   * scaled to match that of the reference, as ScaleToMatchSoundPressureLevel
+   * would scale it. The degraded signal is not modified.
+   *
+   * @param reference The reference signal.
+   * @param degraded The degraded signal.
+   * @param tolerance The largest difference between a scaled degraded sample
+   *    and the reference sample that still matches. If 0, the scaled samples
+   *    must equal the reference samples.
+   *
+   * @return True if the signals have the same rate and shape, and every
+   *    scaled degraded sample is within the tolerance of its reference sample.
+   */
+  static bool MatchesAfterScaling(const AudioSignal &reference,
+                                  const AudioSignal &degraded,
+                                  double tolerance);
+
   /**
    * For a given audio file, load it in mono. Files with more than 1 channel
    * will be downmixed to mono.
    *
-   * Currently only WAV files are supported.
+   * WAV files are read by WavReader, and the files of other formats by the
+   * AudioDecoder that is registered for their extension.
    *
    * @param path The path to the audio file to load.
    *
@@ -71,6 +104,19 @@ class MiscAudio {
    */
   static AudioSignal LoadAsMono(const FilePath &path);
 
+  /**
+   * For a given audio file, load each of its channels, without downmixing
+   * them.
+   *
+   * WAV files are read by WavReader, and the files of other formats by the
+   * AudioDecoder that is registered for their extension.
+   *
+   * @param path The path to the audio file to load.
+   *
+   * @return The audio signal, with a column per channel.
+   */
+  static AudioSignal LoadChannels(const FilePath &path);
+
  /**
    * Performs some basic preparation on the input spectrograms so that they are
    * suitable for comparison to each other.
@@ -81,7 +127,28 @@ class MiscAudio {
   static void PrepareSpectrogramsForComparison(Spectrogram &reference,
                                                Spectrogram &degraded);
 
- private:
+  /**
+   * Prepare only the given columns of the input spectrograms for comparison,
+   * as PrepareSpectrogramsForComparison does, leaving the other columns as
+   * they are.
+   *
+   * The spectrograms are normalized to the lowest value of the prepared
+   * columns. This is the global floor of the whole spectrograms if it is the
+   * absolute noise floor, which is the usual case, as quiet bands fall below
+   * it. Otherwise, the other columns might be lower, so the spectrograms are
+   * left unnormalized and must be prepared in full instead.
+   *
+   * @param reference The reference spectrogram.
+   * @param degraded The degraded spectrogram.
+   * @param columns The columns to prepare.
+   *
+   * @return True if the columns were prepared as they would be by
+   *    PrepareSpectrogramsForComparison.
+   */
+  static bool PrepareSpectrogramColumnsForComparison(
+      Spectrogram &reference, Spectrogram &degraded,
+      const SpectrogramColumnRanges &columns);
+
   /**
    * For a given audio signal, downmix it to mono. If already mono, no work is
    * performed. The downmixing is performed by simply averaging the value of
@@ -95,6 +162,7 @@ class MiscAudio {
    */
   static AudioSignal ToMono(const AudioSignal &signal);
 
+ private:
   /**
    * For a given data matrix, downmix it to mono. If already mono, no work is
    * performed. The downmixing is performed by simply averaging the value of
@@ -17,8 +17,11 @@
 #ifndef VISQOL_INCLUDE_MISCMATH_H
 #define VISQOL_INCLUDE_MISCMATH_H
 
+#include <cstddef>
 #include <vector>
 
+#include "absl/types/span.h"
+
 #include "amatrix.h"
 
 namespace Visqol {
@@ -43,6 +46,34 @@ class MiscMath {
   static AMatrix<double> Mean(const AMatrix<double>& mat);
   static std::vector<double> NormalizeInt16ToDouble(std::vector<int16_t>
     &input_vec);
+
+  /**
+   * A fast approximation of std::log10, based on a polynomial approximation
+   * of the natural log of the mantissa. For positive, normal inputs the
+   * absolute error is below kFastLog10MaxError. Other inputs (zero, negative,
+   * subnormal, infinite or NaN values) fall back to std::log10.
+   *
+   * @param x The value to take the log of.
+   *
+   * @return The base 10 log of the value.
+   */
+  static double FastLog10(const double x);
+
+  /**
+   * Apply FastLog10 to each value of the input, using SIMD lanes where they
+   * are available.
+   *
+   * @param input The values to take the log of.
+   * @param output The base 10 log of each input value is written here. It must
+   *    be the same size as the input, and may be the same span.
+   */
+  static void FastLog10(absl::Span<const double> input,
+                        absl::Span<double> output);
+
+  /**
+   * The maximum absolute error of FastLog10 for positive, normal inputs.
+   */
+  static const double kFastLog10MaxError;
 };
 }  // namespace Visqol
 
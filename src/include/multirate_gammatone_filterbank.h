@@ -0,0 +1,219 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_MULTIRATEGAMMATONEFILTERBANK_H
+#define VISQOL_INCLUDE_MULTIRATEGAMMATONEFILTERBANK_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "erb_filter_cache.h"
+#include "gammatone_filterbank.h"
+
+namespace Visqol {
+
+/**
+ * A multirate variant of the GammatoneFilterBank.
+ *
+ * The bands are grouped into octave stages. The signal is repeatedly halved in
+ * rate through a chain of half-band lowpass filters, and each stage of bands
+ * is filtered at the lowest rate that still comfortably covers its center
+ * frequencies. The low frequency bands, which make up most of the filter bank,
+ * are therefore filtered with a fraction of the samples.
+ *
+ * The filter coefficients of each stage are designed for the decimated rate,
+ * so this is an approximation of the full rate GammatoneFilterBank. The
+ * designed stages are immutable and can be shared between filter banks, which
+ * then only hold their own filter conditions.
+ */
+class MultirateGammatoneFilterBank {
+ public:
+  /**
+   * Constructs the MultirateGammatoneFilterBank with the specified number of
+   * bands and the minimum frequency to utilise.
+   *
+   * @param num_bands The number of frequency bands to filter with. There will
+   *    be this number of bands in the spectrogram that is produced.
+   * @param min_freq The lowest frequency value to include in the filter.
+   */
+  MultirateGammatoneFilterBank(const size_t num_bands, const double min_freq);
+
+  /**
+   * Get the number of bands in this filter bank.
+   *
+   * @return The number of bands in this filter bank.
+   */
+  size_t GetNumBands() const;
+
+  /**
+   * Get the lowest frequency that is used in this filter bank.
+   *
+   * @return The lowest frequency that is used in this filter bank.
+   */
+  double GetMinFreq() const;
+
+  /**
+   * Get the number of times the signal is halved in rate before the given
+   * band is filtered.
+   *
+   * @param band The index of the band, counting from the lowest frequency.
+   *
+   * @return The decimation level of the band, where 0 is the full rate.
+   */
+  size_t GetDecimationLevel(size_t band) const;
+
+  /**
+   * Group the bands into stages and design the filter coefficients for each
+   * stage. This does nothing if the filter bank is already set up for the
+   * given sample rate and center frequencies.
+   *
+   * @param sample_rate The sample rate of the signals to be filtered.
+   * @param center_freqs The center frequencies of the bands, ordered from
+   *    lowest to highest. There must be one per band.
+   */
+  void SetCenterFrequencies(size_t sample_rate,
+                            const std::vector<double> &center_freqs);
+
+  /**
+   * Set up the filter bank with stages that have already been designed, such
+   * as those of ErbFilterCache::GetMultirateFilters. The coefficients are
+   * not designed again, and the filter conditions are reset to zero. This
+   * does nothing if the filter bank is already set up with the same stages.
+   *
+   * @param filters The designed stages, with one band per band of this
+   *    filter bank.
+   */
+  void SetFilters(std::shared_ptr<const MultirateErbFilterSet> filters);
+
+  /**
+   * Group the bands into stages and design the filter coefficients for each
+   * stage.
+   *
+   * @param sample_rate The sample rate of the signals to be filtered.
+   * @param center_freqs The center frequencies of the bands, ordered from
+   *    lowest to highest.
+   *
+   * @return The designed stages.
+   */
+  static MultirateErbFilterSet DesignStages(
+      size_t sample_rate, const std::vector<double> &center_freqs);
+
+  /**
+   * Apply the filter bank to the signal and calculate the root mean square of
+   * the filtered output in each band.
+   *
+   * @param signal The signal to be filtered.
+   *
+   * @return The root mean square of the filtered output, one value per band,
+   *    ordered from the lowest frequency band to the highest.
+   */
+  std::vector<double> ApplyFilterRms(absl::Span<const double> signal);
+
+  /**
+   * As ApplyFilterRms, but writes the root mean square of each band into a
+   * buffer of the caller rather than allocating a new vector.
+   *
+   * @param signal The signal to be filtered.
+   * @param rms The root mean square of the filtered output is written here,
+   *    one value per band, ordered from the lowest frequency band to the
+   *    highest.
+   */
+  void ApplyFilterRms(absl::Span<const double> signal, absl::Span<double> rms);
+
+  /**
+   * Reset the filter conditions of every stage to zero before filtering a
+   * signal.
+   */
+  void ResetFilterConditions();
+
+  /**
+   * The maximum number of times that the signal is halved in rate.
+   */
+  static const size_t kMaxDecimationLevel;
+
+  /**
+   * A band is only filtered at a given rate if its center frequency is at
+   * most this fraction of that rate. This keeps the passband of each band well
+   * clear of the half-band filter transition and of the Nyquist frequency.
+   */
+  static const double kMaxCenterFreqRatio;
+
+ private:
+  /**
+   * The filter bank of a designed stage, which holds the filter conditions of
+   * its bands.
+   */
+  struct Stage {
+    /**
+     * The number of times the signal is halved in rate for this stage.
+     */
+    size_t decimation_level;
+
+    /**
+     * The index of the lowest frequency band in this stage.
+     */
+    size_t first_band;
+
+    /**
+     * The filter bank for the bands in this stage, set up with the
+     * coefficients of the designed stage.
+     */
+    GammatoneFilterBank filter_bank;
+  };
+
+  /**
+   * Halve the rate of a signal with a zero phase half-band lowpass filter.
+   *
+   * @param signal The signal to decimate.
+   * @param decimated The decimated signal is written here. It will hold
+   *    ceil(signal.size() / 2) samples.
+   */
+  static void Decimate(absl::Span<const double> signal,
+                       std::vector<double> *decimated);
+
+  /**
+   * The number of frequency bands to filter with.
+   */
+  size_t num_bands_;
+
+  /**
+   * The lowest frequency value to include in the filter.
+   */
+  double min_freq_;
+
+  /**
+   * The designed stages that the filter bank is set up with, or null if it
+   * has not been set up.
+   */
+  std::shared_ptr<const MultirateErbFilterSet> filters_;
+
+  /**
+   * The stages of the filter bank, in the order of the designed stages.
+   */
+  std::vector<Stage> stages_;
+
+  /**
+   * Working buffers for the decimated signal, one per decimation level above
+   * 0. These are kept between calls to avoid reallocating for every frame.
+   */
+  std::vector<std::vector<double>> decimated_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_MULTIRATEGAMMATONEFILTERBANK_H
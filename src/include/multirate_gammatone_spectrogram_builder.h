@@ -0,0 +1,69 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_MULTIRATEGAMMATONESPECTROGRAMBUILDER_H
+#define VISQOL_INCLUDE_MULTIRATEGAMMATONESPECTROGRAMBUILDER_H
+
+#include "multirate_gammatone_filterbank.h"
+#include "spectrogram_builder.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+/**
+ * Builds a gammatone spectrogram with a MultirateGammatoneFilterBank.
+ *
+ * As with the GammatoneSpectrogramBuilder, each analysis window is filtered
+ * independently, but the low frequency bands are filtered at a reduced sample
+ * rate. The spectrogram has the same dimensions and center frequencies as the
+ * one produced by the GammatoneSpectrogramBuilder. The decimation slightly
+ * changes the band energies, so the MOS-LQO differs a little from the
+ * reference mode. The known scores for this mode are listed in conformance.h.
+ */
+class MultirateGammatoneSpectrogramBuilder : public SpectrogramBuilder {
+ public:
+  /**
+   * Constructs an instance of this MultirateGammatoneSpectrogramBuilder using
+   * the provided MultirateGammatoneFilterBank.
+   *
+   * @param filter_bank The multirate gamatone filter bank to apply to the
+   *    signal.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   */
+  MultirateGammatoneSpectrogramBuilder(
+      const MultirateGammatoneFilterBank &filter_bank,
+      const bool use_speech_mode);
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The configuration of the multirate gammatone filter bank to apply to the
+   * signal. Each call to Build filters with its own copy of it.
+   */
+  MultirateGammatoneFilterBank filter_bank_;
+
+  /**
+   * If true, build the spectrogram for speech mode.
+   */
+  bool speech_mode_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_MULTIRATEGAMMATONESPECTROGRAMBUILDER_H
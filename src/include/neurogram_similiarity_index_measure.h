@@ -17,13 +17,51 @@
 #ifndef VISQOL_INCLUDE_NEUROGRAMSIMILARITYINDEXMEASURE_H
 #define VISQOL_INCLUDE_NEUROGRAMSIMILARITYINDEXMEASURE_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+#include "absl/types/span.h"
+
 #include "amatrix.h"
-#include "image_patch_creator.h"
 #include "patch_similarity_comparator.h"
+#include "patch_view.h"
+#include "spectrogram_store.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
+/**
+ * The shapes of patch pairs that the NSIM loops are specialized for. The loops
+ * of a specialized shape have its numbers of bands and frames as compile time
+ * constants, and hold the local terms of a reference patch on the stack.
+ */
+enum class NsimPatchShape {
+  /**
+   * The numbers of bands and frames are read from each patch.
+   */
+  kDynamic,
+
+  /**
+   * The 32 bands by 30 frames of the patches of the audio mode.
+   */
+  kAudio,
+
+  /**
+   * The 21 bands by 20 frames of the patches of the speech mode.
+   */
+  kSpeech,
+};
+
+/**
+ * Find the specialized shape of the patches of a mode.
+ *
+ * @param num_bands The number of bands of the spectrograms.
+ * @param patch_size The number of frames of each patch.
+ *
+ * @return The specialized shape, or kDynamic if the shape is not specialized.
+ */
+NsimPatchShape NsimPatchShapeOf(size_t num_bands, size_t patch_size);
+
 /**
  * Provides a neurogram similarity index measure (NSIM) implementation for a
  * patch similarity comparator. NSIM is a distance metric, adapted from the
@@ -33,15 +71,132 @@ namespace Visqol {
  */
 class NeurogramSimiliarityIndexMeasure : public PatchSimilarityComparator {
  public:
+  /**
+   * Constructs the NSIM comparator.
+   *
+   * @param use_float_search If true, the sliding comparators that search the
+   *    degraded spectrogram calculate the similarity in single precision.
+   *    The degraded patches are still selected by similarity, so this only
+   *    affects the final similarities through the patches that are selected.
+   *    Else, the search is in double precision.
+   * @param patch_shape The shape of the patches that are compared, which the
+   *    loops are specialized for. A patch pair of any other shape is still
+   *    compared, by the loops that read its shape, and the similarities are
+   *    identical whichever loops compare a pair.
+   */
+  explicit NeurogramSimiliarityIndexMeasure(
+      bool use_float_search = false,
+      NsimPatchShape patch_shape = NsimPatchShape::kDynamic);
+
   // Docs inherited from parent.
-  PatchSimilarityResult MeasurePatchSimilarity(const ImagePatch &ref_patch,
-                                               const ImagePatch &deg_patch)
+  PatchSimilarityResult MeasurePatchSimilarity(const PatchView &ref_patch,
+                                               const PatchView &deg_patch)
                                                const override;
+
+  // Docs inherited from parent.
+  std::vector<PatchSimilarityResult> MeasurePatchSimilarities(
+      const PatchView &ref_patch, absl::Span<const PatchView> deg_patches)
+      const override;
+
+  // Docs inherited from parent.
+  std::unique_ptr<SlidingPatchComparator> CreateSlidingComparator(
+      const AMatrix<double> &deg_spectrogram,
+      size_t num_patch_frames = 0) const override;
+
  private:
   /**
    * The intensity range used during NSIM calculations.
    */
   const double intensity_range_ = 1.0;
+
+  /**
+   * If true, the sliding comparators calculate the similarity in single
+   * precision.
+   */
+  const bool use_float_search_;
+
+  /**
+   * The shape of the patches that are compared.
+   */
+  const NsimPatchShape patch_shape_;
+};
+
+/**
+ * A sliding NSIM comparator over a single degraded spectrogram.
+ *
+ * The local means are calculated with a separable filter. The columns of the
+ * degraded spectrogram and of its square are convolved once, over the whole
+ * spectrogram, so each offset only needs to convolve the rows of those maps,
+ * as well as the cross term with the reference patch. In double precision,
+ * the results are identical to calling
+ * NeurogramSimiliarityIndexMeasure::MeasurePatchSimilarity with a view of each
+ * degraded patch.
+ *
+ * The maps are kept in spectrogram stores, so the search reads each band of a
+ * degraded patch contiguously. A patch that extends past the pad frames of
+ * the stores is read a frame at a time instead.
+ *
+ * @tparam T The precision that the maps are stored and the similarity is
+ *    calculated in, either double or float. The float maps take half of the
+ *    memory bandwidth of the search.
+ */
+template <typename T>
+class SlidingNeurogramSimiliarityIndexMeasure : public SlidingPatchComparator {
+ public:
+  /**
+   * Constructs the sliding comparator and calculates the local mean maps of
+   * the degraded spectrogram.
+   *
+   * @param deg_spectrogram The degraded spectrogram. It is copied in the
+   *    precision of the comparator.
+   * @param intensity_range The intensity range used during NSIM calculations.
+   * @param num_patch_frames The number of silent frames that the maps are
+   *    padded with on each side.
+   * @param patch_shape The shape of the reference patches that are compared,
+   *    which the loops are specialized for.
+   */
+  SlidingNeurogramSimiliarityIndexMeasure(
+      const AMatrix<double> &deg_spectrogram, double intensity_range,
+      size_t num_patch_frames = 0,
+      NsimPatchShape patch_shape = NsimPatchShape::kDynamic);
+
+  // Docs inherited from parent.
+  std::vector<PatchSimilarityResult> MeasurePatchSimilarityAtOffsets(
+      const PatchView &ref_patch, const std::vector<int> &offsets,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The degraded spectrogram, in the precision of the comparator.
+   */
+  BasicSpectrogramStore<T> deg_spectrogram_;
+
+  /**
+   * The degraded spectrogram, with each column convolved with the separable
+   * NSIM filter taps.
+   */
+  BasicSpectrogramStore<T> deg_col_mean_;
+
+  /**
+   * The square of the degraded spectrogram, with each column convolved with
+   * the separable NSIM filter taps.
+   */
+  BasicSpectrogramStore<T> deg_sq_col_mean_;
+
+  /**
+   * The constant that stabilizes the intensity term.
+   */
+  T c1_;
+
+  /**
+   * The constant that stabilizes the structure term.
+   */
+  T c3_;
+
+  /**
+   * The shape of the reference patches that are compared.
+   */
+  NsimPatchShape patch_shape_;
 };
 }  // namespace Visqol
 
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_PAIR_PREFETCHER_H
+#define VISQOL_INCLUDE_PAIR_PREFETCHER_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Loads the signals of a batch of reference/degraded pairs in order, keeping
+ * up to a given number of the upcoming pairs loading on background threads.
+ *
+ * The pairs are read one at a time with Next(). While the caller compares
+ * one pair, the next ones are already being read and decoded, so the latency
+ * of the storage that they are read from is hidden behind the comparison.
+ * The signals of every pair that is loading or loaded are held in memory at
+ * once.
+ */
+class PairPrefetcher {
+ public:
+  /**
+   * The loaded signals of a pair.
+   */
+  struct LoadedPair {
+    /**
+     * The reference signal.
+     */
+    AudioSignal reference;
+
+    /**
+     * The degraded signal.
+     */
+    AudioSignal degraded;
+  };
+
+  /**
+   * Loads the signal of a file. It must be safe to call concurrently.
+   */
+  using Loader = std::function<AudioSignal(const FilePath &)>;
+
+  /**
+   * Constructs a prefetcher and starts loading the first pairs.
+   *
+   * @param pairs The pairs to load, which must outlive the prefetcher.
+   * @param num_prefetch_pairs The maximum number of pairs that are loaded
+   *    ahead of the pair that is read by Next(). A value of 0 loads each pair
+   *    on the calling thread when it is read.
+   * @param loader Loads the signal of each file.
+   */
+  PairPrefetcher(const std::vector<ReferenceDegradedPathPair> &pairs,
+                 size_t num_prefetch_pairs, Loader loader);
+
+  /**
+   * Waits for the pairs that are still loading, whose signals are discarded.
+   */
+  ~PairPrefetcher();
+
+  /**
+   * Get whether there are pairs that have not been read yet.
+   *
+   * @return True if Next() can be called.
+   */
+  bool HasNext() const;
+
+  /**
+   * Read the signals of the next pair, waiting for it to load if needed, and
+   * start loading another pair in its place.
+   *
+   * @return The signals of the next pair.
+   */
+  LoadedPair Next();
+
+ private:
+  /**
+   * Load the signals of a pair.
+   *
+   * @param pair_index The index of the pair to load.
+   *
+   * @return The signals of the pair.
+   */
+  LoadedPair Load(size_t pair_index) const;
+
+  /**
+   * Start loading pairs on background threads until num_prefetch_pairs_ are
+   * loading, or every pair has been started.
+   */
+  void StartLoads();
+
+  /**
+   * The pairs to load.
+   */
+  const std::vector<ReferenceDegradedPathPair> &pairs_;
+
+  /**
+   * The maximum number of pairs that are loaded ahead of the next pair.
+   */
+  size_t num_prefetch_pairs_;
+
+  /**
+   * Loads the signal of each file.
+   */
+  Loader loader_;
+
+  /**
+   * The index of the next pair to be read.
+   */
+  size_t next_pair_ = 0;
+
+  /**
+   * The index of the next pair to start loading.
+   */
+  size_t next_load_ = 0;
+
+  /**
+   * The pairs that are loading or loaded, in order, starting at next_pair_.
+   */
+  std::deque<std::future<LoadedPair>> loads_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_PAIR_PREFETCHER_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_PAIR_SOURCE_H
+#define VISQOL_INCLUDE_PAIR_SOURCE_H
+
+#include <fstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Discovers the reference/degraded pairs of a batch one at a time, so that
+ * they can be compared while the rest are still being discovered.
+ */
+class PairSource {
+ public:
+  virtual ~PairSource() {}
+
+  /**
+   * Discover the next pair.
+   *
+   * @param pair Set to the next pair.
+   *
+   * @return True if a pair was discovered, or false once there are no more.
+   */
+  virtual bool Next(ReferenceDegradedPathPair *pair) = 0;
+};
+
+/**
+ * Reads the pairs of a batch CSV file, with the format of --batch_input_csv,
+ * a line at a time. The file is not checked for the existence of the files
+ * of its pairs, which is left to the comparison of each pair.
+ */
+class ManifestPairSource : public PairSource {
+ public:
+  /**
+   * Open a batch CSV file and skip its header.
+   *
+   * @param manifest_path The path to the batch CSV file.
+   */
+  explicit ManifestPairSource(const FilePath &manifest_path);
+
+  bool Next(ReferenceDegradedPathPair *pair) override;
+
+ private:
+  std::ifstream manifest_;
+};
+
+/**
+ * Pairs each file of a reference directory whose name matches a pattern with
+ * the file of the same name in a degraded directory. The directory entries
+ * are read one at a time, in the order that the file system lists them.
+ * Reference files without a degraded file are logged and skipped.
+ */
+class DirectoryPairSource : public PairSource {
+ public:
+  /**
+   * Start listing a reference directory.
+   *
+   * @param reference_dir The directory of the reference files.
+   * @param degraded_dir The directory of the degraded files.
+   * @param file_pattern The pattern that the names of the reference files
+   *    must match. See MatchesPattern.
+   */
+  DirectoryPairSource(const FilePath &reference_dir,
+                      const FilePath &degraded_dir,
+                      const std::string &file_pattern);
+
+  bool Next(ReferenceDegradedPathPair *pair) override;
+
+  /**
+   * Match a file name against a pattern, in which `*` matches any run of
+   * characters and `?` matches any one character.
+   *
+   * @param name The file name.
+   * @param pattern The pattern.
+   *
+   * @return True if the whole name matches the pattern.
+   */
+  static bool MatchesPattern(const std::string &name,
+                             const std::string &pattern);
+
+ private:
+  boost::filesystem::path degraded_dir_;
+  std::string file_pattern_;
+  boost::filesystem::directory_iterator next_entry_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_PAIR_SOURCE_H
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_PARALLEL_EXECUTOR_H
+#define VISQOL_INCLUDE_PARALLEL_EXECUTOR_H
+
+#include <cstddef>
+#include <functional>
+
+namespace Visqol {
+/**
+ * Runs independent tasks on a number of worker threads, which are taken from
+ * the shared WorkerPool.
+ */
+class ParallelExecutor {
+ public:
+  /**
+   * Run a task for each index from 0 to num_tasks - 1, and wait for all of
+   * them to complete. The indices are handed out to the workers one at a
+   * time, so tasks of uneven cost are balanced across the workers.
+   *
+   * The calling thread is one of the workers, so a worker count of 0 or 1
+   * runs every task on the calling thread, in order. The other workers are
+   * the threads of the shared pool that are free to join in, so a call that
+   * is nested in the tasks of another never starts threads of its own, and
+   * may run every task on the calling thread when the pool is busy. The
+   * tasks must be safe to run concurrently with each other, and must not
+   * wait for each other.
+   *
+   * @param num_tasks The number of tasks to run.
+   * @param num_workers The maximum number of threads to run the tasks on.
+   * @param task The task to run, which is passed the index of each task.
+   */
+  static void ForEach(size_t num_tasks, size_t num_workers,
+                      const std::function<void(size_t)> &task);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_PARALLEL_EXECUTOR_H
@@ -17,7 +17,15 @@
 #ifndef VISQOL_INCLUDE_PATCHSIMILARITYCOMPARATOR_H
 #define VISQOL_INCLUDE_PATCHSIMILARITYCOMPARATOR_H
 
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
 #include "image_patch_creator.h"
+#include "patch_view.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 class Spectrogram;
@@ -76,6 +84,62 @@ struct BestPatchSimilarityMatch {
   PatchSimilarityResult result;
 };
 
+/**
+ * Compares reference patches against the degraded patches that start at
+ * many offsets in a single degraded spectrogram. Implementations can share
+ * the work that is common to overlapping degraded patches.
+ */
+class SlidingPatchComparator {
+ public:
+  /**
+   * Destructor for the sliding patch comparator.
+   */
+  virtual ~SlidingPatchComparator() {}
+
+  /**
+   * Measure the similarity of the reference patch with each degraded patch
+   * that starts at one of the given offsets. The degraded patches are taken
+   * from the degraded spectrogram, with silence wherever they extend past
+   * either end of it.
+   *
+   * @param ref_patch The reference patch.
+   * @param offsets The indices of the degraded spectrogram columns that the
+   *    degraded patches start at. These may be negative.
+   * @param workspace If not null, the scratch buffers of the comparison are
+   *    taken from this workspace rather than from the heap.
+   *
+   * @return The patch comparison similarity results, one per offset, in the
+   *    order of the offsets.
+   */
+  virtual std::vector<PatchSimilarityResult> MeasurePatchSimilarityAtOffsets(
+      const PatchView &ref_patch, const std::vector<int> &offsets,
+      VisqolWorkspace *workspace = nullptr) const = 0;
+
+  /**
+   * Measure the similarity of the reference patch with each degraded patch
+   * that starts at an offset in the given range, as for
+   * MeasurePatchSimilarityAtOffsets.
+   *
+   * @param ref_patch The reference patch.
+   * @param first_offset The index of the degraded spectrogram column that the
+   *    first degraded patch starts at. This may be negative.
+   * @param last_offset The index of the degraded spectrogram column that the
+   *    last degraded patch starts at. This offset is inclusive.
+   *
+   * @return The patch comparison similarity results, one per offset, ordered
+   *    from the first offset to the last. This is empty if last_offset is
+   *    less than first_offset.
+   */
+  std::vector<PatchSimilarityResult> MeasureSlidingPatchSimilarity(
+      const PatchView &ref_patch, int first_offset, int last_offset) const {
+    std::vector<int> offsets;
+    for (int offset = first_offset; offset <= last_offset; offset++) {
+      offsets.push_back(offset);
+    }
+    return MeasurePatchSimilarityAtOffsets(ref_patch, offsets);
+  }
+};
+
 /**
  * This class provided the logic for comparing two patches.
  */
@@ -95,7 +159,50 @@ class PatchSimilarityComparator {
    * @return The patch comparison similarity result.
    */
   virtual PatchSimilarityResult MeasurePatchSimilarity(
-      const ImagePatch &ref_patch, const ImagePatch &deg_patch) const = 0;
+      const PatchView &ref_patch, const PatchView &deg_patch) const = 0;
+
+  /**
+   * Measure the similarity of a reference patch with each of the given
+   * degraded patches. Implementations can share the work that only depends on
+   * the reference patch. By default, each pair is measured in turn.
+   *
+   * @param ref_patch The reference patch.
+   * @param deg_patches The degraded patches to compare the reference patch
+   *    with.
+   *
+   * @return The patch comparison similarity results, one per degraded patch,
+   *    in the order of the degraded patches.
+   */
+  virtual std::vector<PatchSimilarityResult> MeasurePatchSimilarities(
+      const PatchView &ref_patch, absl::Span<const PatchView> deg_patches)
+      const {
+    std::vector<PatchSimilarityResult> results;
+    results.reserve(deg_patches.size());
+    for (const PatchView &deg_patch : deg_patches) {
+      results.push_back(MeasurePatchSimilarity(ref_patch, deg_patch));
+    }
+    return results;
+  }
+
+  /**
+   * Create a comparator that measures the similarity of reference patches
+   * against patches at many offsets in the given degraded spectrogram.
+   *
+   * @param deg_spectrogram The degraded spectrogram. This must outlive the
+   *    returned comparator.
+   * @param num_patch_frames The number of frames in the patches that will be
+   *    compared, if known. The comparator may prepare for patches that extend
+   *    this far past either end of the degraded spectrogram.
+   *
+   * @return The sliding comparator, or nullptr if this comparator does not
+   *    provide one. In that case each degraded patch should be built and
+   *    compared with MeasurePatchSimilarity.
+   */
+  virtual std::unique_ptr<SlidingPatchComparator> CreateSlidingComparator(
+      const AMatrix<double> &deg_spectrogram,
+      size_t num_patch_frames = 0) const {
+    return nullptr;
+  }
 };
 }  // namespace Visqol
 
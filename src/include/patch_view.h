@@ -0,0 +1,140 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_PATCH_VIEW_H
+#define VISQOL_INCLUDE_PATCH_VIEW_H
+
+#include <cstddef>
+
+#include "amatrix.h"
+
+namespace Visqol {
+/**
+ * A non-owning, read only view of a range of columns of a spectrogram.
+ *
+ * The view may start before the first column of the spectrogram or end after
+ * its last column. Those columns of the view are silent, i.e. they read as 0,
+ * without the spectrogram being copied or padded. The viewed matrix must
+ * outlive the view.
+ *
+ * The view is templated on the element type of the viewed matrix. PatchView
+ * views the double precision spectrograms that ViSQOL builds, while the
+ * single precision views are used by the float32 patch search.
+ */
+template <typename T>
+class BasicPatchView {
+ public:
+  /**
+   * The type of the values of the view.
+   */
+  using value_type = T;
+
+  /**
+   * Constructs a view of a whole matrix. This is implicit so that a matrix can
+   * be passed wherever a view is expected.
+   *
+   * @param matrix The matrix to view.
+   */
+  BasicPatchView(const AMatrix<T> &matrix);
+
+  /**
+   * Constructs a view of a range of columns of a matrix.
+   *
+   * @param matrix The matrix to view.
+   * @param first_col The column of the matrix that the first column of the
+   *    view corresponds to. This may be negative.
+   * @param num_cols The number of columns in the view. The view may extend
+   *    past the last column of the matrix.
+   */
+  BasicPatchView(const AMatrix<T> &matrix, int first_col, size_t num_cols);
+
+  /**
+   * Get a value of the view.
+   *
+   * @param row The row of the value.
+   * @param col The column of the value, relative to the start of the view.
+   *
+   * @return The value, or 0 if the column is outside of the viewed matrix.
+   */
+  T operator()(size_t row, size_t col) const {
+    const int matrix_col = first_col_ + static_cast<int>(col);
+    if (matrix_col < 0 || matrix_col >= num_data_cols_) {
+      return T(0);
+    }
+    return data_[matrix_col * stride_ + row];
+  }
+
+  /**
+   * Get the number of rows in the view.
+   *
+   * @return The number of rows in the view.
+   */
+  size_t NumRows() const { return num_rows_; }
+
+  /**
+   * Get the number of columns in the view.
+   *
+   * @return The number of columns in the view.
+   */
+  size_t NumCols() const { return num_cols_; }
+
+  /**
+   * Copy the view into a matrix, with the silent columns filled with 0.
+   *
+   * @return A matrix holding the values of the view.
+   */
+  AMatrix<T> ToMatrix() const;
+
+ private:
+  /**
+   * The column major data of the viewed matrix.
+   */
+  const T *data_;
+
+  /**
+   * The distance between the starts of neighbouring columns in data_.
+   */
+  size_t stride_;
+
+  /**
+   * The number of rows in the view.
+   */
+  size_t num_rows_;
+
+  /**
+   * The number of columns in the view.
+   */
+  size_t num_cols_;
+
+  /**
+   * The column of the viewed matrix that the first column of the view
+   * corresponds to.
+   */
+  int first_col_;
+
+  /**
+   * The number of columns in the viewed matrix.
+   */
+  int num_data_cols_;
+};
+
+/**
+ * A view of a double precision spectrogram.
+ */
+using PatchView = BasicPatchView<double>;
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_PATCH_VIEW_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_PREVIOUS_COMPARISON_H
+#define VISQOL_INCLUDE_PREVIOUS_COMPARISON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "patch_similarity_comparator.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * The result of an earlier comparison of the same files, for rescoring a
+ * degraded signal of which only a part has changed since.
+ *
+ * The blocks of the degraded signal that changed are found by comparing the
+ * hashes of its blocks with those recorded in the earlier result. A patch is
+ * then only compared again if the degraded columns that its search reads, or
+ * the samples that its realignment reads, overlap a changed block. The other
+ * patches reuse their earlier results.
+ */
+class PreviousComparison {
+ public:
+  /**
+   * The number of samples in each hashed block of the degraded signal.
+   */
+  static const size_t kBlockSamples;
+
+  /**
+   * Prepare the reuse of an earlier result.
+   *
+   * @param previous_result The earlier result of the same reference and
+   *    degraded files.
+   * @param deg_block_hashes The hashes of the blocks of kBlockSamples samples
+   *    of the degraded signal as it is now, as
+   *    ResultCache::HashSignalBlocks gives them.
+   * @param ref_hash The hash of the reference signal as it is now, as
+   *    ResultCache::HashSignal gives it.
+   * @param config_hash The hash of the options, model and version of the
+   *    comparison.
+   * @param sample_rate The sample rate of the degraded signal.
+   *
+   * @return The previous comparison, or null if the earlier result has no
+   *    block hashes or no patches to reuse, or if its reference or its
+   *    options differ from those of the comparison, which may compare a
+   *    different number of bands.
+   */
+  static std::unique_ptr<PreviousComparison> Create(
+      const SimilarityResultMsg &previous_result,
+      const std::vector<uint64_t> &deg_block_hashes, uint64_t ref_hash,
+      uint64_t config_hash, size_t sample_rate);
+
+  /**
+   * The patches can only be reused if the degraded signal is aligned by the
+   * same lag as before, so that their degraded times still hold.
+   *
+   * @param global_lag The lag that the degraded signal is aligned by now, in
+   *    seconds.
+   *
+   * @return True if the lag is within half a sample of the earlier lag.
+   */
+  bool MatchesGlobalLag(double global_lag) const;
+
+  /**
+   * Split the reference patches of a comparison into those to compare again
+   * and those whose earlier results are reused.
+   *
+   * @param ref_patch_indices The sorted indices of the reference patches.
+   * @param num_frames_per_patch The number of frames in each patch.
+   * @param frame_duration The duration of a frame, in seconds.
+   * @param window_duration The duration of the analysis window, in seconds.
+   * @param reused_patches If not null, the earlier results of the patches
+   *    that are not compared again are appended here.
+   *
+   * @return The indices of the reference patches to compare again, in
+   *    order.
+   */
+  std::vector<size_t> SplitPatches(
+      const std::vector<size_t> &ref_patch_indices,
+      size_t num_frames_per_patch, double frame_duration,
+      double window_duration,
+      std::vector<PatchSimilarityResult> *reused_patches) const;
+
+  /**
+   * @return The ranges of the degraded signal that changed, as the start and
+   *    end times in seconds of the signal as it was loaded.
+   */
+  const std::vector<std::pair<double, double>> &ChangedRanges() const;
+
+ private:
+  PreviousComparison() = default;
+
+  /**
+   * The lag that the degraded signal was aligned by in the earlier
+   * comparison, in seconds.
+   */
+  double global_lag_ = 0.0;
+
+  /**
+   * The sample rate of the degraded signal.
+   */
+  size_t sample_rate_ = 0;
+
+  /**
+   * The ranges of the degraded signal that changed, in seconds.
+   */
+  std::vector<std::pair<double, double>> changed_ranges_;
+
+  /**
+   * The earlier results of the patches, sorted by their reference start
+   * times.
+   */
+  std::vector<SimilarityResultMsg::PatchSimilarityMsg> patches_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_PREVIOUS_COMPARISON_H
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VISQOL_INCLUDE_REFERENCE_ALIGNER_H
+#define VISQOL_INCLUDE_REFERENCE_ALIGNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "amatrix.h"
+#include "audio_channel.h"
+#include "audio_signal.h"
+#include "fft_manager.h"
+
+namespace Visqol {
+
+/**
+ * Globally aligns degraded signals to a single reference signal. The upper
+ * envelope of the reference and its spectrum are computed once and kept, so
+ * that aligning each degraded signal only costs the envelope of the degraded
+ * signal, one forward FFT, one pointwise product and one inverse FFT.
+ *
+ * The lags found are the same as those of Alignment::GloballyAlign. The
+ * conjugate of the cross spectrum is obtained by circularly reversing the
+ * degraded envelope, as in XCorr, so the kept reference spectrum is the plain
+ * one.
+ *
+ * This class is not thread safe.
+ */
+class ReferenceAligner {
+ public:
+  /**
+   * Prepare the alignment of degraded signals to the given reference.
+   *
+   * @param ref_signal The reference signal.
+   */
+  explicit ReferenceAligner(const AudioSignal &ref_signal);
+
+  /**
+   * Prepare the alignment of degraded signals to a reference whose upper
+   * envelope has already been calculated.
+   *
+   * @param ref_upper_env The upper envelope of the reference signal.
+   * @param ref_num_samples The number of samples in the reference signal.
+   * @param ref_sample_rate The sample rate of the reference signal.
+   */
+  ReferenceAligner(std::vector<double> ref_upper_env, size_t ref_num_samples,
+                   size_t ref_sample_rate);
+
+  /**
+   * @return The upper envelope of the reference signal.
+   */
+  const std::vector<double> &UpperEnvelope() const { return ref_upper_env_; }
+
+  /**
+   * Align a degraded signal with the reference, as Alignment::GloballyAlign
+   * does.
+   *
+   * @param deg_signal The degraded signal to align.
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  std::tuple<AudioSignal, double> GloballyAlign(const AudioSignal &deg_signal);
+
+  /**
+   * Calculate the best lag of a degraded upper envelope against the upper
+   * envelope of the reference, as XCorr::CalcBestLag does.
+   *
+   * @param deg_upper_env The upper envelope of the degraded signal.
+   * @return The lag of the degraded envelope, in samples.
+   */
+  int64_t CalcBestLag(const AMatrix<double> &deg_upper_env);
+
+  /**
+   * Check whether a signal has the length and sample rate of the reference
+   * that this aligner was prepared for.
+   *
+   * @param signal The signal to check.
+   * @return True if the signal could be the reference of this aligner.
+   */
+  bool MatchesReference(const AudioSignal &signal) const;
+
+ private:
+  /**
+   * Make sure the kept reference spectrum has the given number of FFT points,
+   * computing it if the number of points changed.
+   *
+   * @param fft_points The number of FFT points.
+   */
+  void PrepareReferenceSpectrum(size_t fft_points);
+
+  /**
+   * The upper envelope of the reference signal.
+   */
+  std::vector<double> ref_upper_env_;
+
+  /**
+   * The number of samples in the reference signal.
+   */
+  size_t ref_num_samples_;
+
+  /**
+   * The sample rate of the reference signal.
+   */
+  size_t ref_sample_rate_;
+
+  /**
+   * The manager for the FFT size of the kept reference spectrum.
+   */
+  std::unique_ptr<FftManager> fft_manager_;
+
+  /**
+   * The half spectrum of the reference envelope, in the native pffft
+   * ordering.
+   */
+  std::unique_ptr<AudioChannel> ref_spectrum_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_REFERENCE_ALIGNER_H
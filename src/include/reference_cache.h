@@ -0,0 +1,125 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_REFERENCE_CACHE_H
+#define VISQOL_INCLUDE_REFERENCE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "reference_features.h"
+
+namespace Visqol {
+/**
+ * A least recently used cache of the reference files of a batch, so that a
+ * batch that compares one reference against many degraded files only loads
+ * the reference and builds its features once.
+ *
+ * Entries are keyed by the path of the file along with its size and the time
+ * it was last modified, so a file that is rewritten during a batch is loaded
+ * afresh. The cache can be used from several threads at once.
+ */
+class ReferenceCache {
+ public:
+  /**
+   * A loaded reference file and its features.
+   */
+  struct Entry {
+    /**
+     * The reference signal, as it is compared.
+     */
+    AudioSignal signal;
+
+    /**
+     * The features of the reference signal.
+     */
+    std::shared_ptr<const ReferenceFeatures> features;
+  };
+
+  /**
+   * Constructs a cache.
+   *
+   * @param capacity The maximum number of references that are kept. A value
+   *    of 0 keeps none.
+   */
+  explicit ReferenceCache(size_t capacity);
+
+  ReferenceCache(const ReferenceCache &) = delete;
+  ReferenceCache &operator=(const ReferenceCache &) = delete;
+
+  /**
+   * Get the key of a file, from its path, its size and the time it was last
+   * modified.
+   *
+   * @param path The path of the file.
+   *
+   * @return The key of the file, or an empty string if the file cannot be
+   *    read, in which case it is not cached.
+   */
+  static std::string KeyOf(const FilePath &path);
+
+  /**
+   * Find a cached reference, and mark it as the most recently used.
+   *
+   * @param key The key of the reference file.
+   *
+   * @return The cached reference, or null if it is not cached.
+   */
+  std::shared_ptr<const Entry> Find(const std::string &key);
+
+  /**
+   * Cache a reference as the most recently used, replacing any entry with the
+   * same key. The least recently used reference is dropped if the cache is
+   * full.
+   *
+   * @param key The key of the reference file.
+   * @param entry The reference to cache.
+   */
+  void Insert(const std::string &key, std::shared_ptr<const Entry> entry);
+
+  /**
+   * @return The number of cached references.
+   */
+  size_t Size();
+
+ private:
+  using KeyedEntry = std::pair<std::string, std::shared_ptr<const Entry>>;
+
+  const size_t capacity_;
+
+  absl::Mutex mutex_;
+
+  /**
+   * The cached references, from the most to the least recently used.
+   */
+  std::list<KeyedEntry> entries_;
+
+  /**
+   * The position of each cached reference in the list, by its key.
+   */
+  std::map<std::string, std::list<KeyedEntry>::iterator> index_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_REFERENCE_CACHE_H
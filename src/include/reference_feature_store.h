@@ -0,0 +1,137 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_REFERENCE_FEATURE_STORE_H
+#define VISQOL_INCLUDE_REFERENCE_FEATURE_STORE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "reference_features.h"
+#include "reference_features.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * Saves the features of reference files to a directory, and loads them on
+ * later runs, so that references that are compared against new degraded files
+ * day after day only have their features built once.
+ *
+ * The features of each reference are saved as a serialized
+ * ReferenceFeaturesMsg, in a file named after a hash of the path of the
+ * reference. Saved features are only used if they were built with the same
+ * options, from the same version of the reference file.
+ */
+class ReferenceFeatureStore {
+ public:
+  /**
+   * The extension of the files of saved features.
+   */
+  static const char kFileExtension[];
+
+  /**
+   * Constructs a store.
+   *
+   * @param dir The directory that the features are saved in.
+   * @param config_hash The hash of the options that the features depend on.
+   */
+  ReferenceFeatureStore(std::string dir, uint64_t config_hash);
+
+  /**
+   * Hash a string with the 64 bit FNV-1a hash, which does not change between
+   * platforms or builds.
+   *
+   * @param str The string to hash.
+   *
+   * @return The hash of the string.
+   */
+  static uint64_t Hash(const std::string &str);
+
+  /**
+   * Get the path that the features of a reference are saved at.
+   *
+   * @param reference The path of the reference file.
+   *
+   * @return The path of the saved features.
+   */
+  std::string PathFor(const FilePath &reference) const;
+
+  /**
+   * Load the saved features of a reference.
+   *
+   * @param reference The path of the reference file.
+   * @param reference_key The key of the reference file, as given by
+   *    ReferenceCache::KeyOf.
+   * @param ref_signal The reference signal.
+   *
+   * @return The features, or null if none are saved, or if they were built
+   *    with other options, from another version of the file or from a signal
+   *    of another length.
+   */
+  std::unique_ptr<ReferenceFeatures> Load(const FilePath &reference,
+                                          const std::string &reference_key,
+                                          const AudioSignal &ref_signal) const;
+
+  /**
+   * Save the features of a reference, replacing any that were saved before.
+   * The file is written under a temporary name and then renamed, so that
+   * concurrent runs never load a partial file.
+   *
+   * @param reference The path of the reference file.
+   * @param reference_key The key of the reference file.
+   * @param ref_signal The reference signal.
+   * @param features The features of the reference signal.
+   *
+   * @return True if the features were saved.
+   */
+  bool Save(const FilePath &reference, const std::string &reference_key,
+            const AudioSignal &ref_signal,
+            const ReferenceFeatures &features) const;
+
+  /**
+   * Convert the features of a reference signal to a message.
+   *
+   * @param reference_key The key of the reference file.
+   * @param ref_signal The reference signal.
+   * @param features The features of the reference signal.
+   *
+   * @return The message, without its config hash.
+   */
+  static ReferenceFeaturesMsg ToMsg(const std::string &reference_key,
+                                    const AudioSignal &ref_signal,
+                                    const ReferenceFeatures &features);
+
+  /**
+   * Convert a message back to the features of a reference signal.
+   *
+   * @param msg The message.
+   *
+   * @return The features, or null if the spectrogram of the message does not
+   *    have the size that it claims, if it does not have a center frequency
+   *    for each band, or if a patch starts beyond its last frame.
+   */
+  static std::unique_ptr<ReferenceFeatures> FromMsg(
+      const ReferenceFeaturesMsg &msg);
+
+ private:
+  const std::string dir_;
+  const uint64_t config_hash_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_REFERENCE_FEATURE_STORE_H
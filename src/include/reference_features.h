@@ -0,0 +1,53 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_REFERENCE_FEATURES_H
+#define VISQOL_INCLUDE_REFERENCE_FEATURES_H
+
+#include <cstddef>
+#include <vector>
+
+#include "spectrogram.h"
+
+namespace Visqol {
+/**
+ * The features of a reference signal that do not depend on the degraded
+ * signal that it is compared to. They can be built once and shared by every
+ * comparison against the reference, as only the degraded signal is scaled to
+ * match the sound pressure level of the other.
+ */
+struct ReferenceFeatures {
+  /**
+   * The spectrogram of the reference signal, before it is prepared for a
+   * comparison.
+   */
+  Spectrogram spectrogram;
+
+  /**
+   * The start columns of the patches of the reference spectrogram.
+   */
+  std::vector<size_t> patch_indices;
+
+  /**
+   * The upper envelope of the reference signal, which degraded signals are
+   * globally aligned to, or empty if the global alignment does not use it.
+   * It is not used by CalculateSimilarity.
+   */
+  std::vector<double> upper_envelope;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_REFERENCE_FEATURES_H
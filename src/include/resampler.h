@@ -0,0 +1,147 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_RESAMPLER_H
+#define VISQOL_INCLUDE_RESAMPLER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+
+namespace Visqol {
+
+/**
+ * A polyphase resampler for converting a signal between two sample rates
+ * whose ratio is rational.
+ *
+ * The rates are reduced to an upsampling factor L and a downsampling factor
+ * M. The windowed sinc lowpass filter of the conceptual L times upsampled
+ * signal is split into L phases, each of which holds the taps that fall on
+ * the input samples for one fractional output position. Each output sample is
+ * then a single dot product of one phase with the neighbouring input
+ * samples. The signal is zero padded at the edges.
+ */
+class Resampler {
+ public:
+  /**
+   * The number of zero crossings of the sinc filter on each side of its
+   * center, at the lower of the two rates.
+   */
+  static const size_t kZeroCrossings;
+
+  /**
+   * The cutoff of the lowpass filter, relative to the Nyquist frequency of
+   * the lower of the two rates.
+   */
+  static const double kCutoff;
+
+  /**
+   * Constructs a resampler and designs its filter phases.
+   *
+   * @param input_rate The sample rate of the signals to resample.
+   * @param output_rate The sample rate to resample the signals to.
+   */
+  Resampler(size_t input_rate, size_t output_rate);
+
+  /**
+   * Get the sample rate of the signals to resample.
+   *
+   * @return The input sample rate.
+   */
+  size_t GetInputRate() const { return input_rate_; }
+
+  /**
+   * Get the sample rate that the signals are resampled to.
+   *
+   * @return The output sample rate.
+   */
+  size_t GetOutputRate() const { return output_rate_; }
+
+  /**
+   * Get the number of samples that a signal is resampled to.
+   *
+   * @param num_input_samples The number of samples in the input signal.
+   *
+   * @return The number of samples in the output signal.
+   */
+  size_t GetNumOutputSamples(size_t num_input_samples) const;
+
+  /**
+   * Resample a signal.
+   *
+   * @param signal The samples of the signal, at the input rate.
+   * @param output The samples of the signal at the output rate are written
+   *    here. It must hold GetNumOutputSamples(signal.size()) samples.
+   */
+  void Process(absl::Span<const double> signal,
+               absl::Span<double> output) const;
+
+  /**
+   * Resample a mono audio signal from its sample rate to the given rate. The
+   * signal is returned as is if it is already at that rate.
+   *
+   * @param signal The signal to resample.
+   * @param output_rate The sample rate to resample the signal to.
+   *
+   * @return The resampled signal.
+   */
+  static AudioSignal Resample(AudioSignal signal, size_t output_rate);
+
+ private:
+  /**
+   * The sample rate of the signals to resample.
+   */
+  size_t input_rate_;
+
+  /**
+   * The sample rate that the signals are resampled to.
+   */
+  size_t output_rate_;
+
+  /**
+   * The upsampling factor, which is also the number of phases.
+   */
+  size_t up_factor_;
+
+  /**
+   * The downsampling factor.
+   */
+  size_t down_factor_;
+
+  /**
+   * The number of input samples before the output position that each phase
+   * starts at.
+   */
+  size_t num_taps_before_;
+
+  /**
+   * The number of taps of each phase, rounded up to a whole number of SIMD
+   * lanes with trailing zero taps.
+   */
+  size_t num_taps_;
+
+  /**
+   * The taps of the phases, one phase after the other.
+   */
+  std::vector<double> taps_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_RESAMPLER_H
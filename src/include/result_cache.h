@@ -0,0 +1,177 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_RESULT_CACHE_H
+#define VISQOL_INCLUDE_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+#include "audio_signal.h"
+#include "results_proto_stream.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * A persistent cache of comparison results, keyed by the content of the
+ * decoded signals that were compared, so that nightly runs that score many
+ * unchanged pairs again only decode them.
+ *
+ * A result is found by a hash of the samples of the reference signal, a hash
+ * of the samples of the degraded signal, and a hash of everything else that
+ * the result depends on: the options, the model and the conformance version
+ * (see VisqolManager). As the key is the content, a pair is found even if its
+ * files have been copied or renamed, and a file that was replaced is not.
+ *
+ * The results are kept in a single file of length-delimited
+ * ResultCacheEntryMsg records, which is read in full when the cache is opened
+ * and appended to as results are added. Results of any options can share a
+ * file. The file should only be written by one process at a time.
+ *
+ * Thread-safe.
+ */
+class ResultCache {
+ public:
+  /**
+   * The key of a result.
+   */
+  struct Key {
+    uint64_t reference_hash;
+    uint64_t degraded_hash;
+    uint64_t config_hash;
+
+    bool operator==(const Key &other) const {
+      return std::tie(reference_hash, degraded_hash, config_hash) ==
+             std::tie(other.reference_hash, other.degraded_hash,
+                      other.config_hash);
+    }
+  };
+
+  /**
+   * Open the cache of a file, or create the file if it does not exist. The
+   * instances of VisqolManager in a process that use the same file share one
+   * cache, so that the worker threads of a batch see each other's results.
+   *
+   * @param path The path of the file.
+   *
+   * @return The cache, or null if the file could not be opened.
+   */
+  static std::shared_ptr<ResultCache> Open(const std::string &path);
+
+  /**
+   * Hash the samples and sample rate of a signal. The hash is the same on
+   * every platform and build.
+   *
+   * @param signal The signal.
+   *
+   * @return The hash of the signal.
+   */
+  static uint64_t HashSignal(const AudioSignal &signal);
+
+  /**
+   * Hash each block of consecutive samples of a mono signal, in the same way
+   * as HashSignal, so that the blocks that differ between two versions of a
+   * signal can be found.
+   *
+   * @param signal The mono signal.
+   * @param block_samples The number of samples in each block. The last block
+   *    may be shorter.
+   *
+   * @return The hash of each block, in order.
+   */
+  static std::vector<uint64_t> HashSignalBlocks(const AudioSignal &signal,
+                                                size_t block_samples);
+
+  /**
+   * Get the key of a pair of signals.
+   *
+   * @param config_hash The hash of the options, model and version.
+   * @param ref_signal The reference signal, as it is compared.
+   * @param deg_signal The degraded signal, as it is compared.
+   *
+   * @return The key.
+   */
+  static Key KeyOf(uint64_t config_hash, const AudioSignal &ref_signal,
+                   const AudioSignal &deg_signal);
+
+  /**
+   * Find a result.
+   *
+   * @param key The key of the result.
+   * @param sim_res_msg Set to the result, if it is found.
+   *
+   * @return True if the result was found.
+   */
+  bool Find(const Key &key, SimilarityResultMsg *sim_res_msg) const;
+
+  /**
+   * Add a result, and append it to the file. The file paths and timings of
+   * the result are not saved.
+   *
+   * @param key The key of the result.
+   * @param sim_res_msg The result.
+   */
+  void Insert(const Key &key, const SimilarityResultMsg &sim_res_msg);
+
+  /**
+   * @return The number of results in the cache.
+   */
+  size_t size() const;
+
+  /**
+   * Opens the cache of a file. Use Open to share the cache of a file.
+   *
+   * @param path The path of the file.
+   */
+  explicit ResultCache(const std::string &path);
+
+  /**
+   * @return True if the file could be opened for writing.
+   */
+  bool ok() const;
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return static_cast<size_t>(key.reference_hash ^
+                                 (key.degraded_hash * 31) ^
+                                 (key.config_hash * 961));
+    }
+  };
+
+  mutable absl::Mutex mutex_;
+
+  /**
+   * The serialized results, by key.
+   */
+  std::unordered_map<Key, std::string, KeyHash> results_
+      ABSL_GUARDED_BY(mutex_);
+
+  /**
+   * Appends the results that are added to the file.
+   */
+  std::unique_ptr<ResultsProtoWriter> writer_ ABSL_GUARDED_BY(mutex_);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_RESULT_CACHE_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_RESULTS_CHECKPOINT_H
+#define VISQOL_INCLUDE_RESULTS_CHECKPOINT_H
+
+#include <vector>
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Resumes an interrupted batch from the results CSV file that it was writing,
+ * which serves as its checkpoint.
+ */
+class ResultsCheckpoint {
+ public:
+  /**
+   * Remove the pairs that already have a result in a results CSV file.
+   *
+   * A pair has a result if a row of the file has its reference and degraded
+   * paths and a score. A pair that is listed n times in the batch needs n
+   * rows to be removed entirely.
+   *
+   * If the file ends with a partial row, such as one cut short when the
+   * process that wrote it was stopped, the partial row is truncated from the
+   * file so that new results are appended to it cleanly.
+   *
+   * @param pairs The pairs of the batch.
+   * @param results_csv The results CSV file. If it does not exist, every pair
+   *    is kept.
+   *
+   * @return The pairs that have no result yet, in their batch order.
+   */
+  static std::vector<ReferenceDegradedPathPair> RemoveScoredPairs(
+      const std::vector<ReferenceDegradedPathPair> &pairs,
+      const FilePath &results_csv);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_RESULTS_CHECKPOINT_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_RESULTS_MERGER_H
+#define VISQOL_INCLUDE_RESULTS_MERGER_H
+
+#include <vector>
+
+#include "google/protobuf/stubs/status.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Combines the outputs of the shards of a batch, as split by BatchSharder,
+ * into a single output.
+ */
+class ResultsMerger {
+ public:
+  /**
+   * Merge the results CSV files of the shards of a batch into one results
+   * CSV file.
+   *
+   * Every shard file must have the same header, which is written once. A
+   * shard file that is empty, such as for a shard with no pairs, is allowed.
+   *
+   * @param shard_csvs The results CSV files of the shards.
+   * @param batch_input_csv If this path is not empty, the batch CSV file that
+   *    was split into the shards. The results are then written in the order
+   *    of its pairs, and any result that is not for one of its pairs is
+   *    written after them. Otherwise, the results are written in the order of
+   *    the shards.
+   * @param merged_csv The path to write the merged results CSV file to. An
+   *    existing file is overwritten.
+   *
+   * @return An OK status, or an error status if a file could not be read or
+   *    written, or the headers of the shard files differ.
+   */
+  static google::protobuf::util::Status MergeResultsCSVs(
+      const std::vector<FilePath> &shard_csvs,
+      const FilePath &batch_input_csv, const FilePath &merged_csv);
+
+  /**
+   * Concatenate the debug JSON files of the shards of a batch into one file,
+   * in the order of the shards.
+   *
+   * @param shard_files The debug JSON files of the shards.
+   * @param merged_file The path to write the merged file to. An existing file
+   *    is overwritten.
+   *
+   * @return An OK status, or an error status if a file could not be read or
+   *    written.
+   */
+  static google::protobuf::util::Status ConcatenateFiles(
+      const std::vector<FilePath> &shard_files, const FilePath &merged_file);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_RESULTS_MERGER_H
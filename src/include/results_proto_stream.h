@@ -0,0 +1,131 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_RESULTS_PROTO_STREAM_H
+#define VISQOL_INCLUDE_RESULTS_PROTO_STREAM_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message_lite.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Writes comparison results to a file as length-delimited binary
+ * SimilarityResultMsg records: each record is the varint size of the message
+ * followed by the serialized message, as with
+ * google::protobuf::util::SerializeDelimitedToOstream. The records go
+ * through one buffered CodedOutputStream that is kept open for the whole
+ * batch. Other messages, such as the entries of the ResultCache, can be
+ * written in the same way.
+ *
+ * Not thread-safe. Callers that write from several threads serialize the
+ * results on their own threads, and only write the records under a lock.
+ */
+class ResultsProtoWriter {
+ public:
+  /**
+   * Opens the file. Records are appended to it if it exists.
+   *
+   * @param path The path of the file.
+   */
+  explicit ResultsProtoWriter(const FilePath &path);
+
+  /**
+   * Flushes the records and closes the file.
+   */
+  ~ResultsProtoWriter();
+
+  ResultsProtoWriter(const ResultsProtoWriter &) = delete;
+  ResultsProtoWriter &operator=(const ResultsProtoWriter &) = delete;
+
+  /**
+   * @return True if the file is open and no write has failed.
+   */
+  bool ok() const;
+
+  /**
+   * Write a message, usually a SimilarityResultMsg, as a record.
+   *
+   * @param msg The message to write.
+   */
+  void Write(const google::protobuf::MessageLite &msg);
+
+  /**
+   * Write a result that was already serialized, so that the caller can
+   * serialize it without holding the lock that guards the writer.
+   *
+   * @param serialized The serialized message.
+   */
+  void WriteSerialized(const std::string &serialized);
+
+  /**
+   * Write the buffered records to the file.
+   */
+  void Flush();
+
+ private:
+  std::ofstream file_;
+  std::unique_ptr<google::protobuf::io::OstreamOutputStream> output_;
+  std::unique_ptr<google::protobuf::io::CodedOutputStream> coded_output_;
+};
+
+/**
+ * Reads the records of a file written by ResultsProtoWriter, one at a time.
+ */
+class ResultsProtoReader {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @param path The path of the file.
+   */
+  explicit ResultsProtoReader(const FilePath &path);
+
+  ResultsProtoReader(const ResultsProtoReader &) = delete;
+  ResultsProtoReader &operator=(const ResultsProtoReader &) = delete;
+
+  /**
+   * Read the next record.
+   *
+   * @param msg Set to the message of the record, usually a
+   *    SimilarityResultMsg.
+   *
+   * @return True if a record was read, or false at the end of the file, or
+   *    if the file could not be opened or holds a malformed record, in which
+   *    case ok() is false.
+   */
+  bool Next(google::protobuf::MessageLite *msg);
+
+  /**
+   * @return True unless the file could not be opened or a malformed record
+   *    was found.
+   */
+  bool ok() const { return ok_; }
+
+ private:
+  std::ifstream file_;
+  std::unique_ptr<google::protobuf::io::IstreamInputStream> input_;
+  bool ok_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_RESULTS_PROTO_STREAM_H
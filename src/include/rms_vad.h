@@ -17,9 +17,12 @@
 #ifndef VISQOL_INCLUDE_RMS_VAD_H
 #define VISQOL_INCLUDE_RMS_VAD_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#include "absl/types/span.h"
+
 namespace Visqol {
 
 /**
@@ -30,6 +33,10 @@ namespace Visqol {
  * sequentially to the ProcessChunk function. Once all chunks have been
  * processed, GetVadResults can be called to get the results of which chunks
  * have voice activity.
+ *
+ * The chunks are either 16 bit samples, or samples of a normalized signal,
+ * which are measured as the 16 bit samples that they convert to without
+ * copying them.
  */
 class RmsVad {
  public:
@@ -64,6 +71,14 @@ class RmsVad {
    */
   RmsVad();
 
+  /**
+   * Allocate the results of a number of chunks up front, so that processing
+   * them does not allocate.
+   *
+   * @param num_chunks The number of chunks that will be processed.
+   */
+  void Reserve(std::size_t num_chunks);
+
   /**
    * For a given input signal chunk, calculate the RMS value for the chunk and
    * compare to the threshold RMS value.
@@ -75,7 +90,22 @@ class RmsVad {
    *
    * @return The RMS value for this chunk.
    */
-  double ProcessChunk(std::vector<int16_t> chunk);
+  double ProcessChunk(absl::Span<const int16_t> chunk);
+
+  /**
+   * Process a chunk of a normalized signal, as ProcessChunk does for the 16
+   * bit samples that it converts to. Each sample is divided by the peak,
+   * scaled by 2^15, clamped to the range of 16 bit samples and truncated, so
+   * the RMS is the same as that of the converted chunk.
+   *
+   * @param chunk The chunk to process, with samples from -peak to peak.
+   * @param peak The value that the signal is normalized by. Passing the peak
+   *    of an unnormalized signal measures it as its normalized copy would be
+   *    measured, without making the copy.
+   *
+   * @return The RMS value of the converted chunk.
+   */
+  double ProcessChunk(absl::Span<const double> chunk, double peak = 1.0);
 
   /**
    * Get the results for VAD for each chunk.
@@ -86,9 +116,9 @@ class RmsVad {
 
  private:
   /**
-   * The results of the RMS threshold comparison for each chunk.
+   * Whether each chunk is at or above the RMS threshold.
    */
-  std::vector<double> each_chunk_result_;
+  std::vector<bool> each_chunk_result_;
 
   /**
    * The results for the VAD for each chunk.
@@ -96,13 +126,13 @@ class RmsVad {
   std::vector<double> vad_results_;
 
   /**
-   * Helper function for calculating the RMS of a chunk.
+   * Record the result of the RMS threshold comparison for a chunk.
    *
-   * @param chunk The chunk to calculate the RMS for.
+   * @param rms The RMS of the chunk.
    *
-   * @return The RMS for the chunk.
+   * @return The RMS of the chunk.
    */
-  double CalcRootMeanSquare(std::vector<int16_t> chunk);
+  double AddChunkResult(double rms);
 
   /**
    * If we detect a chunk with a RMS below the threshold, we only mark it as
@@ -17,21 +17,33 @@
 #ifndef VISQOL_INCLUDE_SIMRESULTSWRITER_H
 #define VISQOL_INCLUDE_SIMRESULTSWRITER_H
 
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
 #include "google/protobuf/util/json_util.h"
 
 #include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "arrow_results_writer.h"
 #include "conformance.h"
 #include "file_path.h"
+#include "results_proto_stream.h"
+#include "simd_dispatch.h"
 
 
 namespace Visqol {
+class SimilarityResultsStream;
+
 class SimilarityResultsWriter {
  public:
   /**
@@ -62,6 +74,8 @@ class SimilarityResultsWriter {
   }
 
  private:
+  friend class SimilarityResultsStream;
+
   /**
    * Write the results of the comparison, along with some basic debug info, to
    * console.
@@ -71,22 +85,49 @@ class SimilarityResultsWriter {
   static void WriteToConsole(const SimilarityResultMsg &sim_res_msg,
                              bool verbose,
                              const bool use_speech_mode) {
-    std::cout << "ViSQOL conformance version: " << kVisqolConformanceNumber <<
-        std::endl;
-    std::cout << (use_speech_mode ? "Speech mode" : "Audio mode") << std::endl;
+    std::cout << FormatConsole(sim_res_msg, verbose, use_speech_mode)
+              << std::flush;
+  }
+
+  /**
+   * Format the results of the comparison, along with some basic debug info,
+   * as they are written to console.
+   *
+   * @param sim_res_msg The comparison result to format.
+   *
+   * @return A string containing the formatted results.
+   */
+  static std::string FormatConsole(const SimilarityResultMsg &sim_res_msg,
+                                   bool verbose,
+                                   const bool use_speech_mode) {
+    std::stringstream ss;
+    ss << "ViSQOL conformance version: " << kVisqolConformanceNumber << "\n";
+    ss << (use_speech_mode ? "Speech mode" : "Audio mode") << "\n";
     if (verbose) {
-      std::cout << std::endl;
-      std::cout << "Reference Filepath:\t" << sim_res_msg.reference_filepath()
-                << std::endl;
-      std::cout << "Degraded Filepath:\t" << sim_res_msg.degraded_filepath()
-                << std::endl;
+      ss << "\n";
+      ss << "Reference Filepath:\t" << sim_res_msg.reference_filepath() << "\n";
+      ss << "Degraded Filepath:\t" << sim_res_msg.degraded_filepath() << "\n";
+      ss << "SIMD kernels:\t\t"
+         << SimdDispatch::IsaName(SimdDispatch::Kernels().isa) << "\n";
     }
-    std::cout << "MOS-LQO:\t\t" << sim_res_msg.moslqo() << std::endl;
+    ss << "MOS-LQO:\t\t" << sim_res_msg.moslqo() << "\n";
     if (verbose) {
-      std::cout << std::endl << FormatFVNSIM(sim_res_msg) << std::endl;
-      std::cout << FormatPatchSimilarity(sim_res_msg)
-                << std::endl;
+      ss << "\n" << FormatFVNSIM(sim_res_msg) << "\n";
+      ss << FormatPatchSimilarity(sim_res_msg) << "\n";
+      if (sim_res_msg.timeline_size() > 0) {
+        ss << FormatTimeline(sim_res_msg) << "\n";
+      }
+      if (sim_res_msg.has_timings()) {
+        const std::string stage_timings = FormatStageTimings(sim_res_msg);
+        if (!stage_timings.empty()) {
+          ss << stage_timings << "\n";
+        }
+        if (sim_res_msg.timings().peak_rss_kb() > 0) {
+          ss << FormatMemoryUsage(sim_res_msg.timings()) << "\n";
+        }
+      }
     }
+    return ss.str();
   }
 
   /**
@@ -164,6 +205,94 @@ class SimilarityResultsWriter {
     return ss.str();
   }
 
+  /**
+   * Format the MOS-LQO of each window of the timeline.
+   *
+   * @param sim_res_msg The similarity result containing the timeline.
+   *
+   * @return A string containing the formatted timeline.
+   */
+  static std::string FormatTimeline(const SimilarityResultMsg &sim_res_msg) {
+    std::stringstream ss;
+    ss << "--------------------------------------------" << std::endl;
+    ss << "| Window: Start - End |  MOS-LQO | Patches |" << std::endl;
+    ss << "--------------------------------------------" << std::endl;
+    for (const auto &window : sim_res_msg.timeline()) {
+      ss << std::fixed << std::setprecision(3)
+         << "| " << std::setw(11) << std::right << window.start_time()
+         << "  - " << std::setw(5) << std::right << window.end_time()
+         << " | " << std::setw(8) << std::right << window.moslqo()
+         << " | " << std::setw(7) << std::right << window.num_patches()
+         << " |" << std::endl;
+    }
+    ss << "--------------------------------------------\n" << std::endl;
+    return ss.str();
+  }
+
+  /**
+   * Format the time spent in each stage of the comparison, and their total.
+   *
+   * @param sim_res_msg The similarity result containing the stage timings.
+   *
+   * @return A string containing the formatted stage timings, or an empty
+   *    string if the stages were not timed.
+   */
+  static std::string FormatStageTimings(
+      const SimilarityResultMsg &sim_res_msg) {
+    const SimilarityResultMsg::StageTimingsMsg &timings =
+        sim_res_msg.timings();
+    const std::pair<const char *, double> stages[] = {
+        {"Load", timings.load()},
+        {"Global alignment", timings.global_alignment()},
+        {"SPL scaling", timings.spl_scaling()},
+        {"Spectrograms", timings.spectrograms()},
+        {"Spectrogram prep", timings.spectrogram_prep()},
+        {"Patch indices", timings.patch_indices()},
+        {"Coarse search", timings.coarse_search()},
+        {"Fine alignment", timings.fine_alignment()},
+        {"Mapping", timings.mapping()},
+    };
+    double total = 0.0;
+    for (const auto &stage : stages) {
+      total += stage.second;
+    }
+    if (total == 0.0) {
+      return "";
+    }
+    std::stringstream ss;
+    ss << "-----------------------------------" << std::endl;
+    ss << "| Stage            |  Time (sec)  |" << std::endl;
+    ss << "-----------------------------------" << std::endl;
+    for (const auto &stage : stages) {
+      ss << std::fixed << std::setprecision(6)
+         << "| " << std::setw(16) << std::left << stage.first
+         << " | " << std::setw(12) << std::right << stage.second
+         << " |" << std::endl;
+    }
+    ss << "-----------------------------------" << std::endl;
+    ss << "| " << std::setw(16) << std::left << "Total"
+       << " | " << std::setw(12) << std::right << total << " |" << std::endl;
+    ss << "-----------------------------------\n" << std::endl;
+    return ss.str();
+  }
+
+  /**
+   * Format the memory used by a comparison, or the largest memory used by
+   * the comparisons of a batch.
+   *
+   * @param timings The timings containing the memory usage.
+   *
+   * @return A string containing the formatted memory usage.
+   */
+  static std::string FormatMemoryUsage(
+      const SimilarityResultMsg::StageTimingsMsg &timings) {
+    std::stringstream ss;
+    ss << "Bytes allocated:\t" << timings.bytes_allocated() << "\n";
+    ss << "Allocations:\t\t" << timings.num_allocations() << "\n";
+    ss << "Peak RSS (KB):\t\t" << timings.peak_rss_kb() << "\n";
+    return ss.str();
+  }
+
   /**
    * Write the ViSQOL comparison result, including all debug info, to the given
    * file path. The data will be written in JSON format.
@@ -175,17 +304,30 @@ class SimilarityResultsWriter {
    */
   static void WriteDebugJSON(const FilePath &debug_output_path,
       const SimilarityResultMsg &sim_res_msg) {
+    std::ofstream outFile;
+    outFile.open(debug_output_path.Path(), std::ios_base::app);
+    outFile << FormatDebugJSON(sim_res_msg);
+    outFile.close();
+  }
+
+  /**
+   * Format the ViSQOL comparison result, including all debug info, in JSON
+   * format.
+   *
+   * @param sim_res_msg The comparison result to format.
+   *
+   * @return The JSON string, or an empty string if the result could not be
+   *    converted, in which case an error is logged.
+   */
+  static std::string FormatDebugJSON(const SimilarityResultMsg &sim_res_msg) {
     std::string debug_json;
-    if (google::protobuf::util::MessageToJsonString(sim_res_msg,
+    if (!google::protobuf::util::MessageToJsonString(sim_res_msg,
             &debug_json).ok()) {
-      std::ofstream outFile;
-      outFile.open(debug_output_path.Path(), std::ios_base::app);
-      outFile << debug_json;
-      outFile.close();
-    } else {
       ABSL_RAW_LOG(ERROR, "Error writing debug JSON: %s ",
           sim_res_msg.ShortDebugString().c_str());
+      debug_json.clear();
     }
+    return debug_json;
   }
 
   /**
@@ -206,35 +348,306 @@ class SimilarityResultsWriter {
     out_file.open(csv_res_path.Path(), std::ios_base::app);
 
     if (write_header) {
-      out_file << "reference,degraded";
-      if (output_moslqo) {
-        out_file << ",moslqo";
-      }
+      const size_t num_fvnsim = output_fvnsim ? sim_res_msg.fvnsim_size() : 0;
+      out_file << FormatCSVHeader(output_moslqo, num_fvnsim);
+    }
+    out_file << FormatCSVRow(sim_res_msg, output_moslqo, output_fvnsim);
+    out_file.close();
+  }
 
-      if (output_fvnsim) {
-        for (size_t i = 0; i < sim_res_msg.fvnsim_size(); i++) {
-          out_file << ",fvnsim" << i;
-        }
-      }
-      out_file << std::endl;
+  /**
+   * Format the header line of the results CSV file.
+   *
+   * @param output_moslqo If true, the file has a MOS-LQO column.
+   * @param num_fvnsim The number of FVNSIM columns of the file.
+   *
+   * @return The header line.
+   */
+  static std::string FormatCSVHeader(const bool output_moslqo,
+                                     const size_t num_fvnsim) {
+    std::stringstream ss;
+    ss << "reference,degraded";
+    if (output_moslqo) {
+      ss << ",moslqo";
     }
+    for (size_t i = 0; i < num_fvnsim; i++) {
+      ss << ",fvnsim" << i;
+    }
+    ss << "\n";
+    return ss.str();
+  }
 
-    out_file << sim_res_msg.reference_filepath() << ","
-             << sim_res_msg.degraded_filepath();
+  /**
+   * Format a line of the results CSV file with the reference and degraded
+   * filepath, along with the resulting MOS-LQO from their comparison.
+   *
+   * @param sim_res_msg The comparison result to format.
+   * @param output_moslqo If true, the MOS-LQO is included.
+   * @param output_fvnsim If true, the FVNSIM of each band is included.
+   *
+   * @return The CSV line.
+   */
+  static std::string FormatCSVRow(const SimilarityResultMsg &sim_res_msg,
+                                  const bool output_moslqo=true,
+                                  const bool output_fvnsim=false) {
+    std::stringstream ss;
+    ss << sim_res_msg.reference_filepath() << ","
+       << sim_res_msg.degraded_filepath();
 
     if (output_moslqo) {
-      out_file << "," << std::setprecision(9) << sim_res_msg.moslqo();
+      ss << "," << std::setprecision(9) << sim_res_msg.moslqo();
     }
 
     if (output_fvnsim) {
       for (size_t i = 0; i < sim_res_msg.fvnsim_size(); i++) {
-        out_file << "," << std::setprecision(9) << sim_res_msg.fvnsim(i);
+        ss << "," << std::setprecision(9) << sim_res_msg.fvnsim(i);
       }
     }
+    ss << "\n";
+    return ss.str();
+  }
+};
 
-    out_file << std::endl;
-    out_file.close();
+/**
+ * Writes the results of a batch of ViSQOL comparisons as they complete,
+ * keeping the output files open and buffered for the whole batch rather than
+ * reopening them for each result.
+ *
+ * The results are identified by the index of their pair in the batch. In
+ * ordered mode, a result that completes before the results of earlier pairs
+ * is held back until they have been written or skipped, so the output is in
+ * the order of the pairs whatever order they complete in. In unordered mode,
+ * each result is written as soon as it is received.
+ *
+ * Write and Skip can be called concurrently.
+ */
+class SimilarityResultsStream {
+ public:
+  /**
+   * Opens the output files of the batch.
+   *
+   * @param verbose If true, write the results to console in verbose form.
+   * @param results_output_csv If this path is not empty, the basic comparison
+   *    results will be written here in CSV format. If the file does not exist
+   *    yet, the header is written to it first.
+   * @param debug_output_path If this path is not empty, the comparison results
+   *    will be written to this file in JSON format.
+   * @param use_speech_mode If true, the results are labelled as speech mode
+   *    results on console.
+   * @param ordered If true, the results are written in the order of their
+   *    pairs, else in the order that they are received.
+   * @param results_proto If this path is not empty, the comparison results
+   *    will be appended to this file as length-delimited binary
+   *    SimilarityResultMsg records. See ResultsProtoWriter.
+   * @param results_arrow If this path is not empty, the scores of the
+   *    comparisons will be written to this file as an Arrow IPC stream. See
+   *    ArrowResultsWriter.
+   */
+  SimilarityResultsStream(const bool verbose,
+                          const FilePath &results_output_csv,
+                          const FilePath &debug_output_path,
+                          const bool use_speech_mode,
+                          const bool ordered = true,
+                          const FilePath &results_proto = FilePath(),
+                          const FilePath &results_arrow = FilePath())
+      : verbose_(verbose), use_speech_mode_(use_speech_mode),
+        ordered_(ordered) {
+    if (!results_output_csv.Path().empty()) {
+      const bool write_header = !results_output_csv.Exists();
+      csv_file_.open(results_output_csv.Path(), std::ios_base::app);
+      if (write_header) {
+        csv_file_ << SimilarityResultsWriter::FormatCSVHeader(true, 0);
+      }
+    }
+    if (!debug_output_path.Path().empty()) {
+      json_file_.open(debug_output_path.Path(), std::ios_base::app);
+    }
+    if (!results_proto.Path().empty()) {
+      proto_writer_ = absl::make_unique<ResultsProtoWriter>(results_proto);
+      if (!proto_writer_->ok()) {
+        ABSL_RAW_LOG(ERROR, "Unable to open results proto file: %s",
+                     results_proto.Path().c_str());
+      }
+    }
+    if (!results_arrow.Path().empty()) {
+      arrow_writer_ = absl::make_unique<ArrowResultsWriter>(results_arrow);
+      if (!arrow_writer_->ok()) {
+        ABSL_RAW_LOG(ERROR, "Unable to open results Arrow file: %s",
+                     results_arrow.Path().c_str());
+      }
+    }
   }
+
+  /**
+   * Writes any results that are still held back and closes the files. If the
+   * memory usage of the comparisons was recorded, the largest usage of the
+   * batch is written to console.
+   */
+  ~SimilarityResultsStream() {
+    Flush();
+    if (max_memory_usage_.peak_rss_kb() > 0) {
+      std::cout << "\nLargest memory usage of a comparison:\n"
+                << SimilarityResultsWriter::FormatMemoryUsage(
+                       max_memory_usage_) << std::flush;
+    }
+  }
+
+  SimilarityResultsStream(const SimilarityResultsStream &) = delete;
+  SimilarityResultsStream &operator=(const SimilarityResultsStream &) = delete;
+
+  /**
+   * Write the result of a pair.
+   *
+   * @param index The index of the pair in the batch.
+   * @param sim_res_msg The comparison result to write.
+   */
+  void Write(const size_t index, const SimilarityResultMsg &sim_res_msg) {
+    // The result is formatted before the lock is taken, so that the threads
+    // that write results only wait for each other to copy the text out.
+    Entry entry;
+    entry.skipped = false;
+    entry.console = SimilarityResultsWriter::FormatConsole(sim_res_msg,
+        verbose_, use_speech_mode_);
+    if (json_file_.is_open()) {
+      entry.json = SimilarityResultsWriter::FormatDebugJSON(sim_res_msg);
+    }
+    if (csv_file_.is_open()) {
+      entry.csv = SimilarityResultsWriter::FormatCSVRow(sim_res_msg);
+    }
+    if (proto_writer_ != nullptr) {
+      entry.proto = sim_res_msg.SerializeAsString();
+    }
+    if (arrow_writer_ != nullptr) {
+      entry.arrow_row = ArrowResultsWriter::RowFields(sim_res_msg);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sim_res_msg.timings().peak_rss_kb() > 0) {
+      const auto &usage = sim_res_msg.timings();
+      max_memory_usage_.set_bytes_allocated(std::max(
+          max_memory_usage_.bytes_allocated(), usage.bytes_allocated()));
+      max_memory_usage_.set_num_allocations(std::max(
+          max_memory_usage_.num_allocations(), usage.num_allocations()));
+      max_memory_usage_.set_peak_rss_kb(std::max(
+          max_memory_usage_.peak_rss_kb(), usage.peak_rss_kb()));
+    }
+    Add(index, std::move(entry));
+  }
+
+  /**
+   * Record that the pair has no result, such as when its comparison failed,
+   * so that the results of later pairs are no longer held back for it.
+   *
+   * @param index The index of the pair in the batch.
+   */
+  void Skip(const size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Add(index, Entry());
+  }
+
+  /**
+   * Write any results that are still held back, in the order of their pairs,
+   * and flush the output files.
+   */
+  void Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &pending : pending_) {
+      Emit(pending.second);
+    }
+    pending_.clear();
+    std::cout << std::flush;
+    csv_file_.flush();
+    json_file_.flush();
+    if (proto_writer_ != nullptr) {
+      proto_writer_->Flush();
+    }
+    if (arrow_writer_ != nullptr) {
+      arrow_writer_->Flush();
+    }
+  }
+
+ private:
+  /**
+   * The formatted output of a pair. The strings are empty for a pair that is
+   * skipped.
+   */
+  struct Entry {
+    std::string console;
+    std::string csv;
+    std::string json;
+    std::string proto;
+    SimilarityResultMsg arrow_row;
+    bool skipped = true;
+  };
+
+  /**
+   * Write the entry of a pair, or hold it back until the entries of the
+   * earlier pairs have been added. The mutex must be held.
+   */
+  void Add(const size_t index, Entry &&entry) {
+    if (!ordered_) {
+      Emit(entry);
+      return;
+    }
+    pending_.emplace(index, std::move(entry));
+    for (auto next = pending_.find(next_index_); next != pending_.end();
+         next = pending_.find(next_index_)) {
+      Emit(next->second);
+      pending_.erase(next);
+      next_index_++;
+    }
+  }
+
+  /**
+   * Write an entry to the outputs. The mutex must be held.
+   *
+   * Each CSV row is flushed as it is written, so that an interrupted batch
+   * can be resumed from the rows in the file with little work repeated.
+   */
+  void Emit(const Entry &entry) {
+    std::cout << entry.console;
+    if (csv_file_.is_open() && !entry.csv.empty()) {
+      csv_file_ << entry.csv << std::flush;
+    }
+    if (json_file_.is_open()) {
+      json_file_ << entry.json;
+    }
+    if (proto_writer_ != nullptr && !entry.skipped) {
+      proto_writer_->WriteSerialized(entry.proto);
+    }
+    if (arrow_writer_ != nullptr && !entry.skipped) {
+      arrow_writer_->Append(entry.arrow_row);
+    }
+  }
+
+  const bool verbose_;
+  const bool use_speech_mode_;
+  const bool ordered_;
+  std::ofstream csv_file_;
+  std::ofstream json_file_;
+  std::unique_ptr<ResultsProtoWriter> proto_writer_;
+  std::unique_ptr<ArrowResultsWriter> arrow_writer_;
+
+  /**
+   * Guards the outputs and the held back entries.
+   */
+  std::mutex mutex_;
+
+  /**
+   * The index of the next pair to write in ordered mode.
+   */
+  size_t next_index_ = 0;
+
+  /**
+   * The entries that are held back in ordered mode, by the index of their
+   * pair.
+   */
+  std::map<size_t, Entry> pending_;
+
+  /**
+   * The largest bytes allocated, allocations and peak RSS of the comparisons
+   * so far, each taken on its own.
+   */
+  SimilarityResultMsg::StageTimingsMsg max_memory_usage_;
 };
 }  // namespace Visqol
 
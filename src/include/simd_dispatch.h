@@ -0,0 +1,54 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_SIMD_DISPATCH_H
+#define VISQOL_INCLUDE_SIMD_DISPATCH_H
+
+#include "simd_kernels.h"
+
+namespace Visqol {
+/**
+ * Picks the set of SIMD kernels to use for the instruction sets that the host
+ * CPU supports, so that a single build runs the widest kernels on every host
+ * in a mixed fleet.
+ */
+class SimdDispatch {
+ public:
+  /**
+   * @return The widest instruction set that the host CPU supports, of those
+   *    that kernels can be compiled for.
+   */
+  static SimdIsa HostIsa();
+
+  /**
+   * The kernels for the host CPU. They are picked on the first call, from the
+   * sets included in the build that the host supports, and the same set is
+   * returned on every later call.
+   *
+   * @return The kernels to use.
+   */
+  static const SimdKernels &Kernels();
+
+  /**
+   * @param isa An instruction set.
+   *
+   * @return The name of the instruction set, for reporting.
+   */
+  static const char *IsaName(SimdIsa isa);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_SIMD_DISPATCH_H
@@ -17,10 +17,12 @@
 #ifndef VISQOL_INCLUDE_SIMILARITYRESULT_H
 #define VISQOL_INCLUDE_SIMILARITYRESULT_H
 
+#include <cstddef>
 #include <vector>
 
 #include "file_path.h"
 #include "patch_similarity_comparator.h"
+#include "stage_timer.h"
 
 
 namespace Visqol {
@@ -34,6 +36,48 @@ struct SimilarityDebugInfo {
    * pair.
    */
   std::vector<PatchSimilarityResult> patch_sims;
+
+  /**
+   * The number of patches that were not finely realigned, because their
+   * coarse similarity was already above the realign skip similarity.
+   */
+  size_t num_realign_skipped_patches = 0;
+
+  /**
+   * The number of reference patches that were available, of which the
+   * patches in patch_sims were compared.
+   */
+  size_t num_available_patches = 0;
+};
+
+/**
+ * Struct used for storing the quality of a window of time of a comparison.
+ */
+struct SimilarityWindow {
+  /**
+   * The time (in sec) that the window starts at in the reference signal.
+   */
+  double start_time;
+
+  /**
+   * The time (in sec) that the window ends at in the reference signal.
+   */
+  double end_time;
+
+  /**
+   * The predicted MOS-LQO of the patches that start in the window.
+   */
+  double moslqo;
+
+  /**
+   * The mean of the FVNSIM values of the patches that start in the window.
+   */
+  double vnsim;
+
+  /**
+   * The number of patches that start in the window.
+   */
+  size_t num_patches;
 };
 
 /**
@@ -59,6 +103,13 @@ struct SimilarityResult {
    */
   std::vector<double> fvnsim;
 
+  /**
+   * The standard error of each FVNSIM score, estimating how much it would
+   * vary if other patches were compared. It is 0 for every band if all of the
+   * available patches were compared.
+   */
+  std::vector<double> fvnsim_stderr;
+
   /**
    * Stores the center frequency bands that the above FVNSIM scores correspond
    * to. Values are stored running from the lowest frequency band to the
@@ -71,6 +122,25 @@ struct SimilarityResult {
    */
   SimilarityDebugInfo debug_info;
 
+  /**
+   * The quality of each window of time that has patches in it, in order, if
+   * a timeline was asked for. Else, empty.
+   */
+  std::vector<SimilarityWindow> timeline;
+
+  /**
+   * The time spent in each stage of the comparison, if the stages were timed.
+   * Else, all 0.
+   */
+  StageTimings timings;
+
+  /**
+   * True if the degraded signal matched the reference once aligned and
+   * scaled, so the result is the perfect similarity and no patches were
+   * compared.
+   */
+  bool identical_signals = false;
+
   /**
    * If the reference audio signal was read in from file, this will store the
    * path to this file.
@@ -45,6 +45,26 @@ class SimilarityToQualityMapper {
   virtual double PredictQuality(
       const std::vector<double> &similarity_vector) const = 0;
 
+  /**
+   * Map a number of vectors of quality measures across frequency bands to a
+   * MOSLQO each, such as the windows of a timeline. Mappers that can share
+   * work between the vectors override this, and the others map each vector
+   * with PredictQuality.
+   *
+   * @param similarity_vectors The vectors of NSIM scores.
+   *
+   * @return A MOSLQO score (1 to 5) for each vector, in order.
+   */
+  virtual std::vector<double> PredictQualityBatch(
+      const std::vector<std::vector<double>> &similarity_vectors) const {
+    std::vector<double> qualities;
+    qualities.reserve(similarity_vectors.size());
+    for (const auto &similarity_vector : similarity_vectors) {
+      qualities.push_back(PredictQuality(similarity_vector));
+    }
+    return qualities;
+  }
+
   /**
    * Initializes the similarity to quality mapper.
    *
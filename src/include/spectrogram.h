@@ -17,11 +17,17 @@
 #ifndef VISQOL_INCLUDE_SPECTROGRAM_H
 #define VISQOL_INCLUDE_SPECTROGRAM_H
 
+#include <utility>
 #include <vector>
 
 #include "amatrix.h"
 
 namespace Visqol {
+/**
+ * Sorted, non-overlapping ranges of the columns of a spectrogram. Each range
+ * is the first column and one past the last column.
+ */
+using SpectrogramColumnRanges = std::vector<std::pair<size_t, size_t>>;
 
 /**
  * This class represents a spectrogram representation of a signal.
@@ -56,6 +62,27 @@ class Spectrogram {
    */
   void RaiseFloorPerFrame(double noise_threshold, Spectrogram& other);
 
+  /**
+   * Converts this spectrogram and another spectrogram to decibels, raises the
+   * floor of both to absolute_floor and then raises the floor at each frame
+   * to relative_floor below the maximum value in either spectrogram. This
+   * gives the same result as calling ConvertToDb, RaiseFloor and
+   * RaiseFloorPerFrame in turn, but visits each frame only once.
+   *
+   * @param absolute_floor The new absolute floor, in decibels.
+   * @param relative_floor The new floor relative to the peak of each frame,
+   *    in decibels.
+   * @param other A spectrogram to compare against.
+   * @param columns If not null, only these columns of either spectrogram are
+   *    converted, and the others are left as they are.
+   *
+   * @return The smallest value in the converted columns of either
+   *    spectrogram after the floors have been raised.
+   */
+  double ConvertToDbAndRaiseFloors(
+      double absolute_floor, double relative_floor, Spectrogram& other,
+      const SpectrogramColumnRanges *columns = nullptr);
+
 
   /**
    * For each element in the spectrogram's matrix, subtract the provided floor
@@ -78,6 +105,14 @@ class Spectrogram {
    */
   const AMatrix<double>& Data() const { return data_; }
 
+  /**
+   * Move the spectrogram's matrix out of the spectrogram, leaving it empty.
+   * This lets the matrix be recycled once the spectrogram is no longer used.
+   *
+   * @return The spectrogram's matrix.
+   */
+  AMatrix<double> ReleaseData() { return std::move(data_); }
+
   /**
    * Set the center frequency bands that were used to construct this
    * spectrogram. This setter is therefore called after the spectrogram has
@@ -122,6 +157,16 @@ class Spectrogram {
    */
   static double ConvertSampleToDb(const double sample);
 
+  /**
+   * Convert a contiguous run of samples to decibels in place. This gives the
+   * same result as ConvertSampleToDb for each sample, but computes the logs
+   * in SIMD lanes where they are available.
+   *
+   * @param frame The samples to convert.
+   * @param size The number of samples to convert.
+   */
+  static void ConvertFrameToDb(double *frame, size_t size);
+
   /**
    * The center frequency of each frequency band (represented by the rows) in
    * this Spectrogram. The center frequencies are stored from lowest to highest.
@@ -17,16 +17,23 @@
 #ifndef VISQOL_INCLUDE_SPECTROGRAMBUILDER_H
 #define VISQOL_INCLUDE_SPECTROGRAMBUILDER_H
 
+#include <utility>
+
 #include "google/protobuf/stubs/statusor.h"
 
 #include "analysis_window.h"
-#include "audio_signal.h"
+#include "audio_signal_view.h"
 #include "spectrogram.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 
 /**
  * This class is used to build a spectrogram representation of a given signal.
+ *
+ * Implementations hold only immutable configuration, and keep any working
+ * state (such as filter conditions) local to each call of Build. Build can
+ * therefore be called concurrently from several threads.
  */
 class SpectrogramBuilder {
  public:
@@ -47,12 +54,62 @@ class SpectrogramBuilder {
    * @param signal The signal to produce a spectrogram representation of.
    * @param window The analysis window that specifies the length and overlap of
    *    each Hamming window.
+   * @param workspace If not null, the scratch buffers of the build are taken
+   *    from this workspace rather than from the heap.
    *
    * @return The spectrogram representation of the input signal.
    */
   virtual google::protobuf::util::StatusOr<Spectrogram> Build(
-      const AudioSignal &signal,
-      const AnalysisWindow &window) = 0;
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const = 0;
+
+  /**
+   * Build the spectrogram of a signal as Build does, but only fill the given
+   * columns, for comparisons that only read part of it. The spectrogram has
+   * every column, and the columns that are not filled are left at zero.
+   *
+   * Builders whose columns depend on the columns before them fill every
+   * column, as Build does. This is the default.
+   *
+   * @param signal The signal to produce a spectrogram representation of.
+   * @param window The analysis window that specifies the length and overlap of
+   *    each Hamming window.
+   * @param columns The columns to fill. Columns past the end of the
+   *    spectrogram are ignored.
+   * @param workspace If not null, the scratch buffers of the build are taken
+   *    from this workspace rather than from the heap.
+   *
+   * @return The spectrogram representation of the input signal.
+   */
+  virtual google::protobuf::util::StatusOr<Spectrogram> BuildColumnRanges(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      const SpectrogramColumnRanges &columns,
+      VisqolWorkspace *workspace = nullptr) const {
+    return Build(signal, window, workspace);
+  }
+
+  /**
+   * Build the spectrograms of a reference and a degraded signal. The two
+   * spectrograms are built concurrently if num_workers is greater than 1, or
+   * else in turn on the calling thread.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @param window The analysis window to build both spectrograms with.
+   * @param workspace If not null, the scratch buffers of both builds are taken
+   *    from this workspace rather than from the heap.
+   * @param num_workers The maximum number of threads to build the two
+   *    spectrograms on.
+   *
+   * @return The result of building the reference spectrogram, followed by the
+   *    result of building the degraded spectrogram.
+   */
+  std::pair<google::protobuf::util::StatusOr<Spectrogram>,
+            google::protobuf::util::StatusOr<Spectrogram>> BuildPair(
+      const AudioSignalView &ref_signal,
+      const AudioSignalView &deg_signal,
+      const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr, size_t num_workers = 1) const;
 };
 }  // namespace Visqol
 
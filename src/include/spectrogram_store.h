@@ -0,0 +1,237 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_SPECTROGRAM_STORE_H
+#define VISQOL_INCLUDE_SPECTROGRAM_STORE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "amatrix.h"
+
+namespace Visqol {
+/**
+ * A copy of a spectrogram that is laid out for reading patches a band at a
+ * time.
+ *
+ * An AMatrix spectrogram is column major, so the values of one band are a
+ * whole column apart. The patch search walks along each band, so the store
+ * keeps each band contiguous instead. Each band is padded with silent frames
+ * on both sides, so a window that extends past either end of the spectrogram
+ * by up to that many frames is read without checking each frame. The bands
+ * start a multiple of kRowAlignment values apart.
+ *
+ * @tparam T The type of the stored values, either double or float.
+ */
+template <typename T>
+class BasicSpectrogramStore {
+ public:
+  /**
+   * The type of the values of the store.
+   */
+  using value_type = T;
+
+  /**
+   * The number of values that the distance between the starts of the bands
+   * is rounded up to, which is a 64 byte cache line.
+   */
+  static const size_t kRowAlignment;
+
+  /**
+   * A read only window of a range of frames of the store, which must be
+   * covered by the store. It is indexed like a BasicPatchView.
+   */
+  class Window {
+   public:
+    /**
+     * The type of the values of the window.
+     */
+    using value_type = T;
+
+    /**
+     * Constructs a window of a store.
+     *
+     * @param store The store, which must outlive the window.
+     * @param first_frame The frame of the store that the first column of the
+     *    window corresponds to.
+     * @param num_frames The number of columns in the window.
+     */
+    Window(const BasicSpectrogramStore<T> &store, int first_frame,
+           size_t num_frames)
+        : data_(store.Band(0) + first_frame), stride_(store.Stride()),
+          num_rows_(store.NumBands()), num_cols_(num_frames) {}
+
+    /**
+     * Get a value of the window.
+     *
+     * @param row The band of the value.
+     * @param col The column of the value, relative to the start of the
+     *    window.
+     *
+     * @return The value.
+     */
+    T operator()(size_t row, size_t col) const {
+      return data_[row * stride_ + col];
+    }
+
+    /**
+     * Get the number of rows, i.e. bands, in the window.
+     *
+     * @return The number of rows in the window.
+     */
+    size_t NumRows() const { return num_rows_; }
+
+    /**
+     * Get the number of columns, i.e. frames, in the window.
+     *
+     * @return The number of columns in the window.
+     */
+    size_t NumCols() const { return num_cols_; }
+
+   private:
+    /**
+     * The value of the first band at the first column of the window.
+     */
+    const T *data_;
+
+    /**
+     * The distance between the starts of neighbouring bands in data_.
+     */
+    size_t stride_;
+
+    /**
+     * The number of rows in the window.
+     */
+    size_t num_rows_;
+
+    /**
+     * The number of columns in the window.
+     */
+    size_t num_cols_;
+  };
+
+  /**
+   * Constructs an empty store.
+   */
+  BasicSpectrogramStore() {}
+
+  /**
+   * Constructs a store from a spectrogram matrix, with a row for each band
+   * and a column for each frame.
+   *
+   * @param matrix The spectrogram matrix to copy.
+   * @param num_pad_frames The number of silent frames before and after the
+   *    frames of the spectrogram.
+   */
+  BasicSpectrogramStore(const AMatrix<T> &matrix, size_t num_pad_frames);
+
+  /**
+   * Get the values of a band.
+   *
+   * @param band The band.
+   *
+   * @return The value of the band at the first frame of the spectrogram. The
+   *    pad frames are before and after it.
+   */
+  const T *Band(size_t band) const {
+    return data_.data() + band * stride_ + num_pad_frames_;
+  }
+
+  /**
+   * Get whether a range of frames can be read from the store, i.e. lies
+   * within the spectrogram and its pad frames.
+   *
+   * @param first_frame The first frame of the range. This may be negative.
+   * @param num_frames The number of frames in the range.
+   *
+   * @return True if the range is covered by the store.
+   */
+  bool Covers(int first_frame, size_t num_frames) const;
+
+  /**
+   * Get a window of a range of frames, which must be covered by the store.
+   *
+   * @param first_frame The first frame of the window. This may be negative.
+   * @param num_frames The number of frames in the window.
+   *
+   * @return The window.
+   */
+  Window GetWindow(int first_frame, size_t num_frames) const {
+    return Window(*this, first_frame, num_frames);
+  }
+
+  /**
+   * Get the number of bands in the store.
+   *
+   * @return The number of bands.
+   */
+  size_t NumBands() const { return num_bands_; }
+
+  /**
+   * Get the number of frames of the spectrogram, without the pad frames.
+   *
+   * @return The number of frames.
+   */
+  size_t NumFrames() const { return num_frames_; }
+
+  /**
+   * Get the number of silent frames before and after the spectrogram.
+   *
+   * @return The number of pad frames on each side.
+   */
+  size_t NumPadFrames() const { return num_pad_frames_; }
+
+  /**
+   * Get the distance between the starts of neighbouring bands.
+   *
+   * @return The distance in values.
+   */
+  size_t Stride() const { return stride_; }
+
+ private:
+  /**
+   * The padded bands, one after the other.
+   */
+  std::vector<T> data_;
+
+  /**
+   * The number of bands.
+   */
+  size_t num_bands_ = 0;
+
+  /**
+   * The number of frames of the spectrogram.
+   */
+  size_t num_frames_ = 0;
+
+  /**
+   * The number of silent frames on each side of the spectrogram.
+   */
+  size_t num_pad_frames_ = 0;
+
+  /**
+   * The distance between the starts of neighbouring bands in data_.
+   */
+  size_t stride_ = 0;
+};
+
+/**
+ * A store of a double precision spectrogram.
+ */
+using SpectrogramStore = BasicSpectrogramStore<double>;
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_SPECTROGRAM_STORE_H
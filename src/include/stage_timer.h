@@ -0,0 +1,179 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_STAGE_TIMER_H
+#define VISQOL_INCLUDE_STAGE_TIMER_H
+
+#include <chrono>
+#include <utility>
+
+#include "metrics.h"
+#include "trace_writer.h"
+
+namespace Visqol {
+/**
+ * The wall time (in sec) spent in each stage of a comparison.
+ */
+struct StageTimings {
+  /**
+   * Waiting for the input files to be loaded and decoded.
+   */
+  double load = 0.0;
+
+  /**
+   * Globally aligning the degraded signal to the reference.
+   */
+  double global_alignment = 0.0;
+
+  /**
+   * Scaling the degraded signal to the sound pressure level of the reference.
+   */
+  double spl_scaling = 0.0;
+
+  /**
+   * Building the reference and degraded spectrograms, which may be built
+   * concurrently.
+   */
+  double spectrograms = 0.0;
+
+  /**
+   * Preparing the spectrograms for the comparison.
+   */
+  double spectrogram_prep = 0.0;
+
+  /**
+   * Choosing the reference patches.
+   */
+  double patch_indices = 0.0;
+
+  /**
+   * Searching the degraded spectrogram for the most similar patches.
+   */
+  double coarse_search = 0.0;
+
+  /**
+   * Finely realigning the patches and measuring their similarity.
+   */
+  double fine_alignment = 0.0;
+
+  /**
+   * Mapping the similarity of the patches to the quality scores.
+   */
+  double mapping = 0.0;
+};
+
+/**
+ * Add the time spent in each stage of a part of a comparison, such as a tile
+ * of a long pair, to the time spent in each stage of the whole comparison.
+ *
+ * @param timings The time spent in each stage of the part.
+ * @param total The time spent in each stage of the whole comparison.
+ */
+inline void AddStageTimings(const StageTimings &timings, StageTimings *total) {
+  total->load += timings.load;
+  total->global_alignment += timings.global_alignment;
+  total->spl_scaling += timings.spl_scaling;
+  total->spectrograms += timings.spectrograms;
+  total->spectrogram_prep += timings.spectrogram_prep;
+  total->patch_indices += timings.patch_indices;
+  total->coarse_search += timings.coarse_search;
+  total->fine_alignment += timings.fine_alignment;
+  total->mapping += timings.mapping;
+}
+
+/**
+ * @param stage A stage of a StageTimings.
+ *
+ * @return The name of the stage, as it is traced.
+ */
+inline const char *StageName(double StageTimings::*stage) {
+  const std::pair<double StageTimings::*, const char *> names[] = {
+      {&StageTimings::load, "load"},
+      {&StageTimings::global_alignment, "global_alignment"},
+      {&StageTimings::spl_scaling, "spl_scaling"},
+      {&StageTimings::spectrograms, "spectrograms"},
+      {&StageTimings::spectrogram_prep, "spectrogram_prep"},
+      {&StageTimings::patch_indices, "patch_indices"},
+      {&StageTimings::coarse_search, "coarse_search"},
+      {&StageTimings::fine_alignment, "fine_alignment"},
+      {&StageTimings::mapping, "mapping"},
+  };
+  for (const auto &name : names) {
+    if (name.first == stage) {
+      return name.second;
+    }
+  }
+  return "stage";
+}
+
+/**
+ * Adds the wall time from its construction to its destruction to a stage of
+ * a StageTimings. The stage is also recorded as a trace event if a
+ * TraceWriter is recording, and as a latency if Metrics has a sink. If the
+ * timings are null and the stage is neither traced nor reported, the clock is
+ * never read, so the timers cost nothing when they are not recorded.
+ */
+class ScopedStageTimer {
+ public:
+  /**
+   * Starts timing a stage.
+   *
+   * @param timings The timings to add the time to, or null to not time it.
+   * @param stage The stage to add the time to.
+   */
+  ScopedStageTimer(StageTimings *timings, double StageTimings::*stage)
+      : stage_(timings == nullptr ? nullptr : &(timings->*stage)),
+        name_(TraceWriter::IsEnabled() || Metrics::IsEnabled() ?
+              StageName(stage) : nullptr) {
+    if (stage_ != nullptr || name_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedStageTimer() { Stop(); }
+
+  /**
+   * Stops timing the stage before the timer goes out of scope. The time is
+   * only added once.
+   */
+  void Stop() {
+    if (stage_ == nullptr && name_ == nullptr) {
+      return;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    if (stage_ != nullptr) {
+      *stage_ += std::chrono::duration<double>(end - start_).count();
+      stage_ = nullptr;
+    }
+    if (name_ != nullptr) {
+      TraceWriter::AddEvent("stage", name_, start_, end);
+      Metrics::ReportStage(name_,
+          std::chrono::duration<double>(end - start_).count());
+      name_ = nullptr;
+    }
+  }
+
+  ScopedStageTimer(const ScopedStageTimer &) = delete;
+  ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+ private:
+  double *stage_;
+  const char *name_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_STAGE_TIMER_H
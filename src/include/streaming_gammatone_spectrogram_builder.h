@@ -0,0 +1,75 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_STREAMINGGAMMATONESPECTROGRAMBUILDER_H
+#define VISQOL_INCLUDE_STREAMINGGAMMATONESPECTROGRAMBUILDER_H
+
+#include "gammatone_filterbank.h"
+#include "spectrogram_builder.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+/**
+ * A faster, approximate alternative to the GammatoneSpectrogramBuilder.
+ *
+ * The GammatoneSpectrogramBuilder restarts the gammatone filters from zero at
+ * the start of every frame, so with the default 25% overlap every sample is
+ * filtered about four times. This builder filters the whole signal once with
+ * continuous filter state, accumulating the energy of each band in blocks, and
+ * then computes the RMS of each analysis window from those blocks. The
+ * spectrogram has the same dimensions and center frequencies as the one
+ * produced by the GammatoneSpectrogramBuilder.
+ *
+ * Because the filters are not restarted for each frame, the low frequency
+ * bands no longer include the filter ramp up at the start of each frame, which
+ * the SVR model was trained with. This shifts the resulting MOS-LQO, most
+ * noticeably for bass heavy content. The known scores for this mode, and the
+ * shift relative to the reference mode, are listed in conformance.h. Scores
+ * from this mode should only be compared with other scores from this mode.
+ */
+class StreamingGammatoneSpectrogramBuilder : public SpectrogramBuilder {
+ public:
+  /**
+   * Constructs an instance of this StreamingGammatoneSpectrogramBuilder using
+   * the provided GammatoneFilterBank.
+   *
+   * @param filter_bank The gamatone filter bank to apply to the signal.
+   * @param use_speech_mode If true, build the spectrogram for speech mode.
+   */
+  StreamingGammatoneSpectrogramBuilder(const GammatoneFilterBank &filter_bank,
+      const bool use_speech_mode);
+
+  // Docs inherited from parent.
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace = nullptr) const override;
+
+ private:
+  /**
+   * The configuration of the gammatone filter bank to apply to the signal.
+   * Each call to Build filters with its own copy of it.
+   */
+  GammatoneFilterBank filter_bank_;
+
+  /**
+   * If true, build the spectrogram for speech mode.
+   */
+  bool speech_mode_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_STREAMINGGAMMATONESPECTROGRAMBUILDER_H
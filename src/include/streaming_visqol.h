@@ -0,0 +1,215 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_STREAMING_VISQOL_H
+#define VISQOL_INCLUDE_STREAMING_VISQOL_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+
+namespace Visqol {
+/**
+ * The result of a segment of a stream.
+ */
+struct StreamingVisqolResult {
+  /**
+   * The index of the segment in the stream, counting from 0.
+   */
+  size_t segment_index;
+
+  /**
+   * The time that the segment starts at, in seconds from the start of the
+   * stream.
+   */
+  double start_time;
+
+  /**
+   * The result of the segment. The times of its patches are in seconds from
+   * the start of the stream.
+   */
+  SimilarityResultMsg segment;
+
+  /**
+   * The MOS-LQO of the stream so far: the mean MOS-LQO of the segments that
+   * have been scored, weighted by their number of patches.
+   */
+  double running_moslqo;
+
+  /**
+   * The number of patches that have been compared in the stream so far.
+   */
+  size_t num_patches;
+};
+
+/**
+ * Scores a reference/degraded signal pair as it is pushed in chunks, such as
+ * the legs of a live call, with bounded memory.
+ *
+ * The stream is split into segments of a fixed duration. Once a segment of
+ * the reference has been pushed, along with the same segment of the degraded
+ * signal and a lookahead beyond it, the segment is compared and its result,
+ * along with the running MOS-LQO, is handed to the handler. The lookahead
+ * lets the degraded patches at the end of the segment be found when the
+ * degraded signal lags the reference. Only the audio of the segment that is
+ * being filled, and the lookahead, is kept.
+ *
+ * This class is not thread safe, but separate streams may share one manager.
+ */
+class StreamingVisqol {
+ public:
+  /**
+   * The default duration of a segment, in seconds. It holds several patches
+   * in both audio and speech mode.
+   */
+  static const double kDefaultSegmentDuration;
+
+  /**
+   * The default duration of the lookahead of the degraded signal, in
+   * seconds. It is half of the duration of an audio mode patch.
+   */
+  static const double kDefaultLookahead;
+
+  /**
+   * Handles the result of each segment, in order.
+   */
+  using ResultHandler = std::function<void(const StreamingVisqolResult &)>;
+
+  /**
+   * Constructs a stream.
+   *
+   * @param visqol The initialized manager to compare the segments with,
+   *    which must outlive the stream.
+   * @param sample_rate The sample rate of both of the pushed signals.
+   * @param segment_duration The duration of each segment, in seconds.
+   * @param lookahead The duration of the degraded signal beyond the end of a
+   *    segment that is compared with it, in seconds.
+   * @param handler Handles the result of each segment.
+   */
+  StreamingVisqol(const VisqolManager *visqol, size_t sample_rate,
+                  double segment_duration, double lookahead,
+                  ResultHandler handler);
+
+  StreamingVisqol(const StreamingVisqol &) = delete;
+  StreamingVisqol &operator=(const StreamingVisqol &) = delete;
+
+  /**
+   * Push the next chunk of the reference signal, and compare any segments
+   * that are now complete.
+   *
+   * @param samples The samples of the chunk.
+   *
+   * @return An 'OK' status, or the error of the first segment that could not
+   *    be compared. A segment that cannot be compared is skipped, and the
+   *    stream carries on.
+   */
+  google::protobuf::util::Status PushReference(
+      absl::Span<const double> samples);
+
+  /**
+   * Push the next chunk of the degraded signal, and compare any segments
+   * that are now complete.
+   *
+   * @param samples The samples of the chunk.
+   *
+   * @return An 'OK' status, or the error of the first segment that could not
+   *    be compared.
+   */
+  google::protobuf::util::Status PushDegraded(
+      absl::Span<const double> samples);
+
+  /**
+   * Compare the audio that has been pushed but not compared yet, as a final
+   * segment, such as when a call ends. The final segment is only compared if
+   * it is at least half of the segment duration.
+   *
+   * @return An 'OK' status, or the error of the final segment.
+   */
+  google::protobuf::util::Status Finish();
+
+  /**
+   * @return The MOS-LQO of the stream so far, or 0 if no patches have been
+   *    compared yet.
+   */
+  double RunningMoslqo() const;
+
+  /**
+   * @return The number of segments that have been scored.
+   */
+  size_t NumSegments() const { return num_segments_; }
+
+ private:
+  /**
+   * Compare every complete segment.
+   *
+   * @return An 'OK' status, or the error of the first segment that could not
+   *    be compared.
+   */
+  google::protobuf::util::Status CompareCompleteSegments();
+
+  /**
+   * Compare the start of the buffered signals as a segment, and drop the
+   * segment from the buffers.
+   *
+   * @param num_ref_samples The number of reference samples in the segment.
+   * @param num_deg_samples The number of degraded samples to compare it
+   *    with, including the lookahead.
+   *
+   * @return An 'OK' status, or the error if the segment could not be
+   *    compared.
+   */
+  google::protobuf::util::Status CompareSegment(size_t num_ref_samples,
+                                                size_t num_deg_samples);
+
+  const VisqolManager *visqol_;
+  const size_t sample_rate_;
+  const size_t segment_samples_;
+  const size_t lookahead_samples_;
+  const ResultHandler handler_;
+
+  /**
+   * The reference samples that have not been compared yet.
+   */
+  std::vector<double> reference_;
+
+  /**
+   * The degraded samples that have not been compared yet.
+   */
+  std::vector<double> degraded_;
+
+  /**
+   * The number of segments that have been started, including any skipped.
+   */
+  size_t segment_index_ = 0;
+
+  size_t num_segments_ = 0;
+  size_t num_patches_ = 0;
+
+  /**
+   * The sum of the MOS-LQO of each scored segment, weighted by its number of
+   * patches.
+   */
+  double weighted_moslqo_sum_ = 0.0;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_STREAMING_VISQOL_H
@@ -17,22 +17,60 @@
 #ifndef VISQOL_INCLUDE_SUPPORTVECTORREGRESSIONMODEL_H
 #define VISQOL_INCLUDE_SUPPORTVECTORREGRESSIONMODEL_H
 
+#include <memory>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "google/protobuf/stubs/status.h"
 #include "svm.h"
 
+#include "dense_rbf_model.h"
+#include "embedded_svr_model.h"
 #include "file_path.h"
 #include "machine_learning.h"
 
 namespace Visqol {
+/**
+ * The parameters that an SVR model is trained with. The model is a nu SVR
+ * with an RBF kernel.
+ */
+struct SvrTrainingParams {
+  /**
+   * The cost of the errors of the regression.
+   */
+  double cost = 0.4;
+
+  /**
+   * The nu of the regression, which bounds the fraction of support vectors.
+   */
+  double nu = 0.6;
+
+  /**
+   * The gamma of the RBF kernel. A gamma of 0 is 1 over the number of
+   * features of the observations.
+   */
+  double gamma = 0.0;
+
+  /**
+   * The size of the kernel cache of LIBSVM, in MB. Larger caches train
+   * faster on large data sets, as fewer kernel values are computed again.
+   */
+  double cache_size_mb = 100;
+};
+
 /**
  * This class represents a Support Vector Regression model. It utilises the
  * LIBSVM library.
  */
 class SupportVectorRegressionModel {
  public:
+  /**
+   * The extension of compiled model files. A compiled model file that is
+   * named after a LIBSVM model file with this extension appended is loaded
+   * in its place, if it was compiled from the same version of the file.
+   */
+  static const char kCompiledModelExtension[];
+
   /**
    * The constructor for the SVR model.
    */
@@ -44,7 +82,11 @@ class SupportVectorRegressionModel {
   ~SupportVectorRegressionModel();
 
   /**
-   * Initialize the SVR model using a model file.
+   * Initialize the SVR model using a model file. A LIBSVM model file is
+   * parsed, unless a compiled model file of the same version sits next to
+   * it, in which case the compiled file is read instead, without parsing or
+   * taking the LIBSVM loading lock. A path with the compiled extension is
+   * always read as a compiled model file.
    *
    * @param model_path The path to the SVR model file.
    *
@@ -53,6 +95,28 @@ class SupportVectorRegressionModel {
    */
   google::protobuf::util::Status Init(const FilePath &model_path);
 
+  /**
+   * Initialize the SVR model using a model that is compiled into the
+   * library, without reading or parsing any file.
+   *
+   * @param model The embedded model.
+   */
+  void Init(const EmbeddedSvrModel &model);
+
+  /**
+   * Compile a LIBSVM model file with an RBF kernel to a compiled model file,
+   * which holds the dense support vectors, their coefficients, the gamma and
+   * the rho of the model, and the size and hash of the LIBSVM file.
+   *
+   * @param model_path The path to the LIBSVM model file.
+   * @param compiled_path The path to write the compiled model file to.
+   *
+   * @return An OK status if the model was compiled. Else, an error status is
+   *    returned.
+   */
+  static google::protobuf::util::Status Compile(const FilePath &model_path,
+                                                const FilePath &compiled_path);
+
   /**
    * Initialize the SVR model using vectors of observations and targets. These
    * vectors are used to train the SVR model and save it for prediction usage.
@@ -63,8 +127,22 @@ class SupportVectorRegressionModel {
   void Init(const std::vector<MlObservation> &observations,
             const std::vector<MlTarget> &targets);
 
+  /**
+   * Initialize the SVR model by training it with the given parameters on
+   * vectors of observations and targets.
+   *
+   * @param observations A vector of observations.
+   * @param targets A vector of targets.
+   * @param params The parameters to train the model with.
+   */
+  void Init(const std::vector<MlObservation> &observations,
+            const std::vector<MlTarget> &targets,
+            const SvrTrainingParams &params);
+
   /**
    * Using the SVR model, predict a quality value for the given observation.
+   * RBF models predict with a dense copy of the model, which gives the same
+   * values as LIBSVM.
    *
    * @param observation A single observation.
    *
@@ -72,12 +150,32 @@ class SupportVectorRegressionModel {
    */
   double Predict(const MlObservation &observation) const;
 
+  /**
+   * Using the SVR model, predict a quality value for each of a number of
+   * observations. RBF models stream their support vectors once per block of
+   * observations, rather than once per observation, and give the same values
+   * as Predict.
+   *
+   * @param observations The observations.
+   *
+   * @return The predicted value for each observation, in order.
+   */
+  std::vector<double> PredictBatch(
+      const std::vector<MlObservation> &observations) const;
+
  private:
   /**
-   * The svm model provided by the LIBSVM library.
+   * The svm model provided by the LIBSVM library, or null if the model was
+   * loaded from a compiled model file or is embedded in the library.
    */
   svm_model *model_;
 
+  /**
+   * The dense copy of the model that observations are predicted with, or null
+   * if the model does not use an RBF kernel.
+   */
+  std::unique_ptr<DenseRbfModel> dense_model_;
+
   /**
    * Accessing the LibSVM external libraries for loading the model must be
    * performed by one thread at a time. This mutex is used to guard this
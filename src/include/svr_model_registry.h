@@ -0,0 +1,62 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_SVRMODELREGISTRY_H
+#define VISQOL_INCLUDE_SVRMODELREGISTRY_H
+
+#include <memory>
+
+#include "google/protobuf/stubs/statusor.h"
+
+#include "file_path.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+/**
+ * A process wide registry of the SVR models that have been loaded from model
+ * files, so that every user of a model file shares one read only copy of it.
+ *
+ * The models are keyed by the path and a hash of the contents of their file,
+ * so a model file that is rewritten is loaded again. A model is freed once
+ * the last user of it releases it.
+ */
+class SvrModelRegistry {
+ public:
+  /**
+   * Get the model of a model file, loading it if it is not already loaded.
+   * This is safe to call concurrently. Concurrent calls for a model that is
+   * not loaded yet wait for it to be loaded once.
+   *
+   * @param model_path The path to the SVR model file.
+   *
+   * @return The shared model, or an error status if the file could not be
+   *    read or loaded.
+   */
+  static google::protobuf::util::StatusOr<
+      std::shared_ptr<const SupportVectorRegressionModel>>
+  Get(const FilePath &model_path);
+
+  /**
+   * Get the default audio mode model that is compiled into the library. It
+   * is built on first use, without reading any file, and is never freed.
+   *
+   * @return The shared model.
+   */
+  static std::shared_ptr<const SupportVectorRegressionModel> GetEmbedded();
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_SVRMODELREGISTRY_H
@@ -17,6 +17,7 @@
 #ifndef VISQOL_INCLUDE_SVRSIMILARITYTOQUALITYMAPPER_H
 #define VISQOL_INCLUDE_SVRSIMILARITYTOQUALITYMAPPER_H
 
+#include <memory>
 #include <vector>
 
 #include "google/protobuf/stubs/status.h"
@@ -36,7 +37,8 @@ class SvrSimilarityToQualityMapper : public SimilarityToQualityMapper {
   /**
    * Construct the mapper utilising the given SVR model file.
    *
-   * @param support_vector_model The filepath to the SVR model file.
+   * @param support_vector_model The filepath to the SVR model file, or an
+   *    empty path for the default model that is compiled into the library.
    */
   explicit SvrSimilarityToQualityMapper(const FilePath &support_vector_model);
 
@@ -44,14 +46,20 @@ class SvrSimilarityToQualityMapper : public SimilarityToQualityMapper {
   double PredictQuality(const std::vector<double> &similarity_vector) const
       override;
 
+  // Docs inherited from parent.
+  std::vector<double> PredictQualityBatch(
+      const std::vector<std::vector<double>> &similarity_vectors) const
+      override;
+
   // Docs inherited from parent.
   google::protobuf::util::Status Init() override;
 
  private:
   /**
-   * The SVR model used for predictions.
+   * The SVR model used for predictions, which is shared with every other
+   * mapper of the same model file.
    */
-  SupportVectorRegressionModel model_;
+  std::shared_ptr<const SupportVectorRegressionModel> model_;
 
   /**
    * The filepath to the SVR model file, used for instantiating the SVR model.
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_TASK_GRAPH_H
+#define VISQOL_INCLUDE_TASK_GRAPH_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace Visqol {
+/**
+ * Runs tasks that depend on each other on a number of worker threads. Each
+ * task is started as soon as the tasks that it depends on have completed,
+ * by whichever worker is free, so that independent stages of a comparison
+ * overlap.
+ *
+ * Like the ParallelExecutor, the calling thread is one of the workers, and
+ * the others are taken from the shared WorkerPool, so the stages of a pair
+ * share the threads of the pool with the other pairs of a batch and with the
+ * patches of their comparisons rather than adding threads of their own.
+ */
+class TaskGraph {
+ public:
+  /**
+   * Add a task to the graph.
+   *
+   * @param task The task to run.
+   * @param dependencies The indices of the tasks that must complete before
+   *    this task starts. They must have been added before this task, which
+   *    keeps the graph free of cycles.
+   *
+   * @return The index of the task.
+   */
+  size_t AddTask(std::function<void()> task,
+                 const std::vector<size_t> &dependencies = {});
+
+  /**
+   * Run every task of the graph, and wait for all of them to complete. A
+   * worker count of 0 or 1 runs every task on the calling thread, in the
+   * order that they were added. The tasks that are not ordered by their
+   * dependencies must be safe to run concurrently with each other.
+   *
+   * @param num_workers The maximum number of threads to run the tasks on.
+   */
+  void Run(size_t num_workers);
+
+  /**
+   * @return The number of tasks in the graph.
+   */
+  size_t NumTasks() const;
+
+ private:
+  /**
+   * The tasks, in the order that they were added.
+   */
+  std::vector<std::function<void()>> tasks_;
+
+  /**
+   * The number of tasks that each task depends on.
+   */
+  std::vector<size_t> num_dependencies_;
+
+  /**
+   * The tasks that depend on each task.
+   */
+  std::vector<std::vector<size_t>> dependents_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_TASK_GRAPH_H
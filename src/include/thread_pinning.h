@@ -0,0 +1,139 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_THREAD_PINNING_H
+#define VISQOL_INCLUDE_THREAD_PINNING_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * Pins the worker threads of a batch to the CPUs of the NUMA nodes of the
+ * machine, spreading the workers across the nodes.
+ *
+ * Memory is allocated on the node of the thread that first touches it, so a
+ * pinned worker that creates its own VisqolManager, and the workspaces of
+ * its comparisons, keeps their buffers on its own node. The threads of the
+ * shared WorkerPool that work for a pinned worker, such as those of its patch
+ * workers, are pinned to its CPUs while they do.
+ *
+ * Pinning is only supported on Linux. Elsewhere the threads are left free.
+ */
+class ThreadPinning {
+ public:
+  /**
+   * Read the CPUs of each NUMA node from sysfs.
+   *
+   * @param sysfs_node_dir The directory of the nodes, which is
+   *    /sys/devices/system/node on Linux.
+   *
+   * @return The CPUs of each node that has CPUs, in the order of the nodes.
+   *    If the nodes cannot be read, a single node of every CPU.
+   */
+  static std::vector<std::vector<int>> NodeCpus(
+      const std::string &sysfs_node_dir = "/sys/devices/system/node");
+
+  /**
+   * Parse a CPU list of sysfs, such as "0-3,8,10-11".
+   *
+   * @param cpu_list The CPU list.
+   *
+   * @return The CPUs of the list, in order, or an empty vector if the list
+   *    is not valid.
+   */
+  static std::vector<int> ParseCpuList(const std::string &cpu_list);
+
+  /**
+   * Choose the CPUs that a worker is pinned to. Worker i is placed on node
+   * i modulo the number of nodes, so consecutive workers alternate between
+   * the nodes.
+   *
+   * @param worker The index of the worker.
+   * @param pinning Whether the worker is pinned to all the CPUs of its node,
+   *    or to a single CPU of its node.
+   * @param node_cpus The CPUs of each node, as NodeCpus returns.
+   *
+   * @return The CPUs to pin the worker to, or an empty vector if the worker
+   *    is not pinned.
+   */
+  static std::vector<int> WorkerCpus(
+      size_t worker, VisqolConfig::VisqolOptions::ThreadPinning pinning,
+      const std::vector<std::vector<int>> &node_cpus);
+
+  /**
+   * Pin the calling thread to a set of CPUs.
+   *
+   * @param cpus The CPUs to pin the thread to.
+   *
+   * @return True if the thread was pinned, or false if pinning failed or is
+   *    not supported on this platform.
+   */
+  static bool PinCurrentThread(const std::vector<int> &cpus);
+
+  /**
+   * @return The CPUs that the calling thread may run on, or an empty vector
+   *    if they cannot be read on this platform.
+   */
+  static std::vector<int> CurrentThreadCpus();
+};
+
+/**
+ * Pins the calling thread to a set of CPUs for the lifetime of the object,
+ * and then restores the CPUs that it could run on before.
+ */
+class ScopedThreadPin {
+ public:
+  /**
+   * @param cpus The CPUs to pin the calling thread to. The thread is left
+   *    free if this is empty.
+   */
+  explicit ScopedThreadPin(const std::vector<int> &cpus);
+
+  ~ScopedThreadPin();
+
+  ScopedThreadPin(const ScopedThreadPin &) = delete;
+  ScopedThreadPin &operator=(const ScopedThreadPin &) = delete;
+
+  /**
+   * @return The CPUs that the calling thread is pinned to by the innermost
+   *    ScopedThreadPin that pinned it, or an empty vector if none did.
+   */
+  static std::vector<int> CurrentCpus();
+
+ private:
+  /**
+   * The CPUs that the thread could run on before it was pinned, or an empty
+   * vector if it was not pinned.
+   */
+  std::vector<int> previous_cpus_;
+
+  /**
+   * The CPUs that the thread was pinned to, if it was pinned.
+   */
+  std::vector<int> cpus_;
+
+  /**
+   * The CPUs of the ScopedThreadPin that this one is nested in, if any.
+   */
+  const std::vector<int> *previous_pin_cpus_ = nullptr;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_THREAD_PINNING_H
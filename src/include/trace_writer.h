@@ -0,0 +1,138 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_TRACE_WRITER_H
+#define VISQOL_INCLUDE_TRACE_WRITER_H
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file_path.h"
+
+namespace Visqol {
+/**
+ * Records the pairs and stages of the comparisons of a process as events in
+ * the Chrome trace format, which chrome://tracing and Perfetto can show.
+ * Each event holds the thread that it ran on, so the utilization of the
+ * workers of a batch, their waits for input and the pairs that finish last
+ * can be seen.
+ *
+ * Recording is off until Start is called, and costs a single check of a flag
+ * per stage while it is off. Events may be added from any thread.
+ */
+class TraceWriter {
+ public:
+  /**
+   * The arguments of an event, as key/value pairs.
+   */
+  using Args = std::vector<std::pair<std::string, std::string>>;
+
+  /**
+   * Starts recording events. The timestamps of the events are relative to
+   * the call, and any events recorded before are dropped.
+   */
+  static void Start();
+
+  /**
+   * @return True if events are being recorded.
+   */
+  static bool IsEnabled();
+
+  /**
+   * Record an event that ran from start to end on the calling thread. Does
+   * nothing if events are not being recorded.
+   *
+   * @param category The category of the event, such as "pair" or "stage".
+   * @param name The name of the event.
+   * @param start The time that the event started.
+   * @param end The time that the event ended.
+   * @param args The arguments shown with the event.
+   */
+  static void AddEvent(const char *category, const std::string &name,
+                       std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end,
+                       const Args &args = Args());
+
+  /**
+   * Stops recording events, and formats the recorded events as a Chrome
+   * trace, ordered by their start times.
+   *
+   * @return The JSON of the trace.
+   */
+  static std::string StopAndFormat();
+
+  /**
+   * Stops recording events, and writes them to a file as a Chrome trace.
+   *
+   * @param path The path of the trace file.
+   *
+   * @return True if the file was written.
+   */
+  static bool StopAndWrite(const FilePath &path);
+};
+
+/**
+ * Records an event of the calling thread, from its construction to its
+ * destruction, if events are being recorded.
+ */
+class ScopedTraceEvent {
+ public:
+  /**
+   * Starts the event.
+   *
+   * @param category The category of the event.
+   * @param name The name of the event.
+   * @param args The arguments shown with the event.
+   */
+  ScopedTraceEvent(const char *category, std::string name,
+                   TraceWriter::Args args = TraceWriter::Args())
+      : enabled_(TraceWriter::IsEnabled()), category_(category) {
+    if (enabled_) {
+      name_ = std::move(name);
+      args_ = std::move(args);
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedTraceEvent() { Stop(); }
+
+  /**
+   * Ends the event before it goes out of scope. The event is only recorded
+   * once.
+   */
+  void Stop() {
+    if (enabled_) {
+      TraceWriter::AddEvent(category_, name_, start_,
+                            std::chrono::steady_clock::now(), args_);
+      enabled_ = false;
+    }
+  }
+
+  ScopedTraceEvent(const ScopedTraceEvent &) = delete;
+  ScopedTraceEvent &operator=(const ScopedTraceEvent &) = delete;
+
+ private:
+  bool enabled_;
+  const char *category_;
+  std::string name_;
+  TraceWriter::Args args_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_TRACE_WRITER_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_TRAINING_DATA_WRITER_H
+#define VISQOL_INCLUDE_TRAINING_DATA_WRITER_H
+
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * Writes the FVNSIM of the results of a batch, and the MOS-LQS of their pairs,
+ * to a pair of files in the format that TrainingDataFileReader reads, so that
+ * an SVR model can be trained on them without converting the results.
+ *
+ * The observations file holds the FVNSIM of a result per row, and the targets
+ * file holds the MOS-LQS of the same result on the same row. The rows are
+ * written in the order of the pairs of the batch, whatever order the pairs
+ * are compared in.
+ */
+class TrainingDataWriter {
+ public:
+  /**
+   * The MOS-LQS of each pair of a batch, by the paths of its reference and
+   * degraded files.
+   */
+  using TargetMap = std::map<std::pair<std::string, std::string>, double>;
+
+  /**
+   * The suffix of the path of the observations file.
+   */
+  static const char kObservationsSuffix[];
+
+  /**
+   * The suffix of the path of the targets file.
+   */
+  static const char kTargetsSuffix[];
+
+  /**
+   * Read the MOS-LQS of the pairs of a batch CSV file, which has them in a
+   * third column after the reference and degraded paths. A pair that is
+   * listed more than once has the MOS-LQS of its first row.
+   *
+   * @param batch_input_csv The path to the batch CSV file.
+   *
+   * @return The MOS-LQS of each pair that has one.
+   */
+  static TargetMap ReadTargets(const FilePath &batch_input_csv);
+
+  /**
+   * Format the FVNSIM of a result as a row of the observations file, without
+   * the line ending.
+   *
+   * @param sim_res_msg The result.
+   *
+   * @return The values of the FVNSIM, separated by commas.
+   */
+  static std::string FormatObservation(const SimilarityResultMsg &sim_res_msg);
+
+  /**
+   * Opens the observations and targets files, replacing any that exist.
+   *
+   * @param output_prefix The path that the suffixes are appended to, to name
+   *    the observations and targets files.
+   * @param targets The MOS-LQS of the pairs of the batch.
+   */
+  TrainingDataWriter(const std::string &output_prefix, TargetMap targets);
+
+  /**
+   * Writes any rows that are still held back and closes the files.
+   */
+  ~TrainingDataWriter();
+
+  TrainingDataWriter(const TrainingDataWriter &) = delete;
+  TrainingDataWriter &operator=(const TrainingDataWriter &) = delete;
+
+  /**
+   * Write the row of the result of a pair. A result of a pair without a
+   * MOS-LQS is skipped.
+   *
+   * @param index The index of the pair in the batch.
+   * @param sim_res_msg The comparison result.
+   */
+  void Write(size_t index, const SimilarityResultMsg &sim_res_msg);
+
+  /**
+   * Record that the pair has no result, so that the rows of later pairs are
+   * no longer held back for it.
+   *
+   * @param index The index of the pair in the batch.
+   */
+  void Skip(size_t index);
+
+  /**
+   * Write any rows that are still held back, and flush the files.
+   *
+   * @return True if every row was written.
+   */
+  bool Flush();
+
+  /**
+   * @return The number of rows that have been written so far.
+   */
+  size_t NumRows() const;
+
+ private:
+  /**
+   * The rows of a pair, which are empty for a pair without a row.
+   */
+  struct Row {
+    std::string observation;
+    std::string target;
+  };
+
+  /**
+   * Write the row of a pair, or hold it back until the rows of the earlier
+   * pairs have been added. The mutex must be held.
+   */
+  void Add(size_t index, Row &&row);
+
+  /**
+   * Write a row to the files. The mutex must be held.
+   */
+  void Emit(const Row &row);
+
+  const TargetMap targets_;
+  std::ofstream observations_file_;
+  std::ofstream targets_file_;
+
+  /**
+   * Guards the files, the held back rows and the count of rows.
+   */
+  mutable std::mutex mutex_;
+
+  /**
+   * The index of the next pair to write.
+   */
+  size_t next_index_ = 0;
+
+  /**
+   * The rows that are held back, by the index of their pair.
+   */
+  std::map<size_t, Row> pending_;
+
+  /**
+   * The number of rows written.
+   */
+  size_t num_rows_ = 0;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_TRAINING_DATA_WRITER_H
@@ -45,8 +45,8 @@ class VadPatchCreator : public ImagePatchCreator {
   static const double kFramesWithVAThreshold;
 
   // Docs inherited from parent.
-  explicit VadPatchCreator(size_t patch_size)
-      : ImagePatchCreator(patch_size) {}
+  explicit VadPatchCreator(size_t patch_size, size_t max_patches = 0)
+      : ImagePatchCreator(patch_size, max_patches) {}
 
   // Docs inherited from parent.
   google::protobuf::util::StatusOr<std::vector<size_t>> CreateRefPatchIndices(
@@ -64,6 +64,8 @@ class VadPatchCreator : public ImagePatchCreator {
    *    starting from the given starting sample.
    * @param frame_len The length of each frame that should be pased to the
    *    VAD.
+   * @param peak The value that the samples are divided by to normalize them
+   *    before they are measured.
    *
    * @return A vector containing the VAD results for each frame taken from
    *    the input signal. Results are in order of frame position within the
@@ -73,7 +75,8 @@ class VadPatchCreator : public ImagePatchCreator {
    */
   std::vector<double> GetVoiceActivity(
       const AudioSignal &signal, const size_t start_sample,
-      const size_t total_samples, const size_t frame_len) const;
+      const size_t total_samples, const size_t frame_len,
+      const double peak = 1.0) const;
 };
 
 }  // namespace Visqol
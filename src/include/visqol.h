@@ -26,10 +26,14 @@
 #include "comparison_patches_selector.h"
 #include "file_path.h"
 #include "image_patch_creator.h"
+#include "previous_comparison.h"
+#include "reference_features.h"
 #include "similarity_result.h"
 #include "similarity_to_quality_mapper.h"
 #include "spectrogram.h"
 #include "spectrogram_builder.h"
+#include "stage_timer.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
 
@@ -39,6 +43,32 @@ namespace Visqol {
  */
 class Visqol {
  public:
+  /**
+   * The number of patches that are compared in each round when the
+   * comparison stops early.
+   */
+  static const size_t kPatchesPerRound;
+
+  /**
+   * Constructs a Visqol instance.
+   *
+   * @param target_vnsim_stderr If positive, the patches are compared in
+   *    rounds of kPatchesPerRound, spread over the whole signal, and the
+   *    comparison stops once the standard error of the VNSIM of the compared
+   *    patches is below this target. Else, every patch is compared.
+   * @param lazy_degraded_spectrogram If true, the reference patches are chosen
+   *    before the degraded spectrogram is built, and only the columns of the
+   *    degraded spectrogram that the patch search reads are built.
+   * @param record_stage_timings If true, the time spent in each stage of a
+   *    comparison is recorded in the timings of its result.
+   * @param num_workers The maximum number of threads that the reference and
+   *    degraded spectrograms of a comparison are built on. Values of 0 and 1
+   *    build them in turn on the calling thread.
+   */
+  explicit Visqol(double target_vnsim_stderr = 0.0,
+                  bool lazy_degraded_spectrogram = false,
+                  bool record_stage_timings = false, size_t num_workers = 1);
+
   /**
    * Perform a comparison on two audio signals. Their similarity is calculated
    * and converted to a quality score using the given similarity to quality
@@ -55,17 +85,111 @@ class Visqol {
    *    from the degraded signal with those from the reference signal.
    * @param sim_to_qual_mapper Used to convert a similarity score to a quality
    *    score.
+   * @param workspace If not null, the scratch buffers of the comparison are
+   *    taken from this workspace rather than from the heap. The caller resets
+   *    it once the comparison is done.
+   * @param ref_features If not null, the features of the reference signal,
+   *    built by BuildReferenceFeatures with the same spectrogram builder,
+   *    window and patch creator. Else, they are built for this comparison.
+   * @param previous If not null, an earlier comparison of the same signals,
+   *    with the degraded signal aligned by the same lag. Only the patches
+   *    that read the changed parts of the degraded signal are compared, and
+   *    only the degraded columns that they search are built. Ignored if the
+   *    patches are compared in rounds to a target standard error.
+   * @param deg_scale_factor If not null, the factor that the degraded signal
+   *    is scaled by, such as one that matches the spl of the whole signal
+   *    when only a part of it is compared. Else, the degraded signal is
+   *    scaled to match the spl of the reference signal.
    *
    * @return If the comparison was successful, return the similarity result and
    *    associated debug info. Else, return an error status.
    */
   google::protobuf::util::StatusOr<SimilarityResult> CalculateSimilarity(
       const AudioSignal &ref_signal, AudioSignal &deg_signal,
-      SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
+      const SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
       const ImagePatchCreator *patch_creator,
       const ComparisonPatchesSelector *comparison_patches_selector,
+      const SimilarityToQualityMapper *sim_to_qual_mapper,
+      VisqolWorkspace *workspace = nullptr,
+      const ReferenceFeatures *ref_features = nullptr,
+      const PreviousComparison *previous = nullptr,
+      const double *deg_scale_factor = nullptr) const;
+
+  /**
+   * Build the features of a reference signal that CalculateSimilarity can
+   * reuse for every comparison against it.
+   *
+   * @param ref_signal The reference signal.
+   * @param spect_builder The spectrogram builder to build the spectrogram of
+   *    the reference with.
+   * @param window The analysis window of the comparisons.
+   * @param patch_creator Used for choosing the patches of the reference.
+   *
+   * @return The features of the reference, or an error status.
+   */
+  google::protobuf::util::StatusOr<ReferenceFeatures> BuildReferenceFeatures(
+      const AudioSignal &ref_signal, const SpectrogramBuilder *spect_builder,
+      const AnalysisWindow &window,
+      const ImagePatchCreator *patch_creator) const;
+
+  /**
+   * Combine the results of the compared patches of a comparison into the
+   * similarity and quality of the comparison, as CalculateSimilarity does
+   * once it has compared them. The patches of a comparison may have been
+   * compared in parts, such as in the tiles of a long signal.
+   *
+   * @param patch_sims The results of the compared patches, in order.
+   * @param num_available_patches The number of reference patches that could
+   *    have been compared.
+   * @param num_realign_skipped_patches The number of patches whose fine
+   *    realignment was skipped.
+   * @param sim_to_qual_mapper Used to convert a similarity score to a quality
+   *    score.
+   *
+   * @return The result of the comparison, without its center frequency bands
+   *    and stage timings.
+   */
+  SimilarityResult CombinePatchSimilarities(
+      std::vector<PatchSimilarityResult> patch_sims,
+      size_t num_available_patches, size_t num_realign_skipped_patches,
+      const SimilarityToQualityMapper *sim_to_qual_mapper) const;
+
+  /**
+   * Calculate the quality of each window of time of a comparison, from the
+   * patches of the whole comparison, so that the signals are aligned and
+   * their patches searched once rather than once per window. Each patch
+   * belongs to the window that its reference start time falls in, and the
+   * patches of each window are mapped to a quality score as the patches of a
+   * whole comparison are.
+   *
+   * @param patch_sims The results of the patches of the comparison.
+   * @param window_duration The duration of each window, in seconds.
+   * @param sim_to_qual_mapper Used to convert a similarity score to a quality
+   *    score.
+   *
+   * @return The quality of each window that has patches in it, in order.
+   */
+  std::vector<SimilarityWindow> CalculateTimeline(
+      const std::vector<PatchSimilarityResult> &patch_sims,
+      double window_duration,
       const SimilarityToQualityMapper *sim_to_qual_mapper) const;
 
+  /**
+   * This function alters the resulting MOS-LQO score in cases where the audio
+   * files are massively dissimilar e.g. two completely different audio files.
+   * It is applied to the MOS-LQO of every comparison, so a MOS-LQO that is
+   * mapped after the comparison, with those of other comparisons, is altered
+   * with this too.
+   *
+   * @param vnsim The mean of the FVNSIM scores.
+   * @param moslqo The MOS-LQO that was produced for the given set of FVNSIM
+   *    scores.
+   *
+   * @return If the given VNSIM is below a certain threshold value, a constant
+   *    MOS-LQO of 1 is returned. Else, the input MOS-LQO is returned.
+   */
+  double AlterForSimilarityExtremes(double vnsim, double moslqo) const;
+
  private:
   /**
    * For a given set of FVNSIM scores, which represent the similarity between
@@ -94,17 +218,113 @@ class Visqol {
       const std::vector<PatchSimilarityResult> &sim_match_info) const;
 
   /**
-   * This function alters the resulting MOS-LQO score in cases where the audio
-   * files are massively dissimilar e.g. two completely different audio files.
+   * Estimate how much each FVNSIM score would vary with the patches that
+   * were compared, when only a subset of the available patches was compared.
    *
-   * @param vnsim The mean of the FVNSIM scores.
-   * @param moslqo The MOS-LQO that was produced for the given set of FVNSIM
-   *    scores.
+   * @param sim_match_info The similarity scores for each patch comparison.
+   * @param fvnsim The FVNSIM scores of the compared patches.
+   * @param num_available_patches The number of patches that were available.
    *
-   * @return If the given VNSIM is below a certain threshold value, a constant
-   *    MOS-LQO of 1 is returned. Else, the input MOS-LQO is returned.
+   * @return The standard error of each FVNSIM score, which is 0 for every
+   *    band if every available patch was compared.
    */
-  double AlterForSimilarityExtremes(double vnsim, double moslqo) const;
+  std::vector<double> CalcFvnsimStandardError(
+      const std::vector<PatchSimilarityResult> &sim_match_info,
+      const AMatrix<double> &fvnsim, size_t num_available_patches) const;
+
+  /**
+   * Estimate how much the VNSIM would vary with the patches that were
+   * compared, when only a subset of the available patches was compared.
+   *
+   * @param sim_match_info The similarity scores for each patch comparison.
+   * @param num_available_patches The number of patches that were available.
+   *
+   * @return The standard error of the VNSIM, which is 0 if fewer than two
+   *    patches or every available patch was compared.
+   */
+  double CalcVnsimStandardError(
+      const std::vector<PatchSimilarityResult> &sim_match_info,
+      size_t num_available_patches) const;
+
+  /**
+   * Build the reference spectrogram and choose the reference patches, and
+   * then build only the columns of the degraded spectrogram that the patch
+   * search reads, and prepare them for comparison.
+   *
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @param spect_builder The spectrogram builder of the comparison.
+   * @param window The analysis window of the comparison.
+   * @param patch_creator Used for choosing the reference patches.
+   * @param workspace If not null, the scratch buffers of the comparison.
+   * @param ref_features If not null, the features of the reference signal.
+   * @param previous If not null, an earlier comparison of the same signals.
+   *    Only the columns that the patches to compare again search are built,
+   *    and none if every patch is reused, in which case the degraded
+   *    spectrogram is left empty.
+   * @param ref_spectrogram Set to the prepared reference spectrogram.
+   * @param deg_spectrogram Set to the prepared degraded spectrogram.
+   * @param ref_patch_indices Set to the indices of all of the reference
+   *    patches.
+   * @param timings If not null, the time spent in each stage is added here.
+   *
+   * @return True if the spectrograms were prepared, or false if the columns
+   *    that were built do not give the floor of the whole spectrograms, and
+   *    the spectrograms must be built in full. Else, an error status.
+   */
+  google::protobuf::util::StatusOr<bool> BuildSearchedSpectrograms(
+      const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+      const SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
+      const ImagePatchCreator *patch_creator, VisqolWorkspace *workspace,
+      const ReferenceFeatures *ref_features,
+      const PreviousComparison *previous, Spectrogram *ref_spectrogram,
+      Spectrogram *deg_spectrogram, std::vector<size_t> *ref_patch_indices,
+      StageTimings *timings) const;
+
+  /**
+   * Find the most similar degraded patch to each of the given reference
+   * patches, and realign them finely.
+   *
+   * @param ref_spectrogram The prepared reference spectrogram.
+   * @param deg_spectrogram The prepared degraded spectrogram.
+   * @param ref_patch_indices The sorted indices of the reference patches.
+   * @param ref_signal The reference signal.
+   * @param deg_signal The degraded signal.
+   * @param spect_builder The spectrogram builder of the comparison.
+   * @param window The analysis window of the comparison.
+   * @param frame_duration The duration of a frame, in seconds.
+   * @param patch_creator Used for creating the reference patches.
+   * @param comparison_patches_selector Used for finding and realigning the
+   *    degraded patches.
+   * @param num_realign_skipped Set to the number of patches that could not
+   *    be realigned.
+   * @param workspace If not null, the scratch buffers of the comparison.
+   * @param timings If not null, the time spent in each stage is added here.
+   *
+   * @return The similarity of each patch that could be compared, or an error
+   *    status.
+   */
+  google::protobuf::util::StatusOr<std::vector<PatchSimilarityResult>>
+  ComparePatches(const Spectrogram &ref_spectrogram,
+                 const Spectrogram &deg_spectrogram,
+                 const std::vector<size_t> &ref_patch_indices,
+                 const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+                 const SpectrogramBuilder *spect_builder,
+                 const AnalysisWindow &window, double frame_duration,
+                 const ImagePatchCreator *patch_creator,
+                 const ComparisonPatchesSelector *comparison_patches_selector,
+                 size_t *num_realign_skipped, VisqolWorkspace *workspace,
+                 StageTimings *timings) const;
+
+  /**
+   * Order the patches so that every prefix of the order is spread evenly
+   * over the signal.
+   *
+   * @param num_patches The number of patches.
+   *
+   * @return The positions of the patches, in the order to compare them.
+   */
+  static std::vector<size_t> StratifiedOrder(size_t num_patches);
 
   /**
    * Calculate the duration of a frame in seconds.
@@ -117,6 +337,11 @@ class Visqol {
    */
   double CalcFrameDuration(const size_t frame_size,
                            const size_t sample_rate) const;
+
+  const double target_vnsim_stderr_;
+  const bool lazy_degraded_spectrogram_;
+  const bool record_stage_timings_;
+  const size_t num_workers_;
 };
 }  // namespace Visqol
 
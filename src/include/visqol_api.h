@@ -17,17 +17,32 @@
 #ifndef VISQOL_INCLUDE_VISQOL_API_H
 #define VISQOL_INCLUDE_VISQOL_API_H
 
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/statusor.h"
 
 #include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "streaming_visqol.h"
 #include "visqol_config.pb.h"      // Generated by cc_proto_library rule
 #include "visqol_manager.h"
 
 namespace Visqol {
+/**
+ * Compares audio signals that are held in memory.
+ *
+ * Once created, a VisqolApi is thread-safe: Measure, MeasureAsync and
+ * MeasureBatch may be called concurrently from any number of threads, and
+ * all of the comparisons share the one initialized instance of ViSQOL.
+ * Create and SetExecutor must not be called while comparisons are running.
+ */
 class VisqolApi {
  public:
   /**
@@ -36,6 +51,49 @@ class VisqolApi {
    */
   static const size_t k48kSampleRate;
 
+  /**
+   * The longest degraded signal, in seconds, of a pair that MeasureBatch
+   * treats as a short clip.
+   */
+  static const double kMaxClipDuration;
+
+  /**
+   * The most short clips that MeasureBatch compares in one task.
+   */
+  static const size_t kMaxClipsPerTask;
+
+  /**
+   * Receives the result of an asynchronous comparison, or the error status
+   * if it failed.
+   */
+  using Callback = std::function<void(
+      google::protobuf::util::StatusOr<SimilarityResultMsg>)>;
+
+  /**
+   * Runs a task of an asynchronous comparison, such as on a thread pool or
+   * the worker threads of an event loop. It must run every task that it is
+   * given, and may run them concurrently.
+   */
+  using Executor = std::function<void(std::function<void()>)>;
+
+  /**
+   * A reference and a degraded input signal to be compared by MeasureBatch.
+   */
+  struct SignalPair {
+    absl::Span<double> reference;
+    absl::Span<double> degraded;
+  };
+
+  VisqolApi() = default;
+
+  /**
+   * Waits for the asynchronous comparisons that are in flight to finish.
+   */
+  ~VisqolApi();
+
+  VisqolApi(const VisqolApi &) = delete;
+  VisqolApi &operator=(const VisqolApi &) = delete;
+
   /**
    * Create an instance of the ViSQOL API, using the given config data.
    * See the proto file of this config for the config details.
@@ -50,12 +108,38 @@ class VisqolApi {
    */
   google::protobuf::util::Status Create(const VisqolConfig config);
 
+  /**
+   * Warm this instance up for signals of an expected duration, so that its
+   * first comparisons are as fast as those after them. A synthetic pair of
+   * that duration is compared on each thread, which builds the FFT plans and
+   * filter coefficients of its size, grows a workspace per thread and
+   * touches the pages of the model. Create does this when the warmup_duration
+   * option is set. The scores are not changed.
+   *
+   * The synthetic pairs do not change the lag hint of the comparisons, so
+   * this may be called while comparisons run, though it is best called
+   * before they start, as it slows them down.
+   *
+   * @param expected_duration The expected duration of the signals, in
+   *    seconds.
+   * @param num_threads The number of comparisons that are expected to run at
+   *    once, such as the num_threads of MeasureMany.
+   *
+   * @return An 'ok' status if the instance was warmed up. Else, an error
+   *    status.
+   */
+  google::protobuf::util::Status Warmup(double expected_duration,
+                                        size_t num_threads = 1) const;
+
   /**
    * Perform a ViSQOL comparison on the given input signals.
    *
    * Both signals must have the same sample rate. This sample rate is set in
    * the constructor.
    *
+   * The samples are read in place rather than copied, and are not modified.
+   * They must not be modified by the caller until the comparison returns.
+   *
    * @param reference The reference input signal.
    * @param degraded The degraded input signal.
    *
@@ -65,9 +149,136 @@ class VisqolApi {
    */
   google::protobuf::util::StatusOr<SimilarityResultMsg> Measure(
       const absl::Span<double>& reference,
-      const absl::Span<double>& degraded);
+      const absl::Span<double>& degraded) const;
+
+  /**
+   * Perform a ViSQOL comparison on the given single precision input signals.
+   * The samples are converted to double precision as they are copied into the
+   * signals that are compared, so they are only copied once.
+   *
+   * @param reference The reference input signal.
+   * @param degraded The degraded input signal.
+   *
+   * @return The similarity results, or an error if the comparison fails.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> Measure(
+      absl::Span<const float> reference, absl::Span<const float> degraded) const;
+
+  /**
+   * Perform a ViSQOL comparison on the given 16 bit PCM input signals. The
+   * samples are normalized to [-1, 1) as wav files are when they are loaded.
+   *
+   * @param reference The reference input signal.
+   * @param degraded The degraded input signal.
+   *
+   * @return The similarity results, or an error if the comparison fails.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> Measure(
+      absl::Span<const int16_t> reference,
+      absl::Span<const int16_t> degraded) const;
+
+  /**
+   * Perform ViSQOL comparisons on a batch of input signal pairs, on a number
+   * of threads.
+   *
+   * Pairs whose reference spans the same samples, by address and length, are
+   * treated as sharing a reference. The alignment spectrum of a shared
+   * reference is prepared once for the pairs that are compared together, as
+   * in batch mode. The samples are read in place, and must not be modified
+   * by the caller until the comparisons return.
+   *
+   * Pairs with a reference of their own whose degraded signal lasts at most
+   * kMaxClipDuration are short clips, whose fixed costs outweigh their
+   * comparison. Up to kMaxClipsPerTask of them are compared in each task,
+   * and the similarities of the clips of a task are mapped to quality in one
+   * batch. Their scores are the same as those of Measure.
+   *
+   * @param pairs The pairs of signals to compare.
+   * @param num_threads The number of threads to compare the pairs on. Values
+   *    of 0 and 1 compare every pair on the calling thread.
+   *
+   * @return The similarity results of each pair, or the error if its
+   *    comparison failed, in the order of the pairs.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>>
+  MeasureBatch(absl::Span<const SignalPair> pairs, size_t num_threads) const;
+
+  /**
+   * Perform ViSQOL comparisons of a number of degraded input signals against
+   * one reference input signal, such as the rungs of a codec ladder or the
+   * candidates of an A/B test, on a number of threads.
+   *
+   * The reference is prepared once, and its alignment envelope and features
+   * are shared by all of the comparisons. The samples are read in place, and
+   * must not be modified by the caller until the comparisons return.
+   *
+   * @param reference The reference input signal.
+   * @param degraded The degraded input signals.
+   * @param num_threads The number of threads to compare the degraded signals
+   *    on. Values of 0 and 1 compare every signal on the calling thread.
+   *
+   * @return The similarity results of each degraded signal, or the error if
+   *    its comparison failed, in the order of the degraded signals.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>>
+  MeasureMany(absl::Span<double> reference,
+              absl::Span<const absl::Span<double>> degraded,
+              size_t num_threads) const;
+
+  /**
+   * Start scoring a reference/degraded signal pair that is pushed in chunks,
+   * such as the legs of a live call. Both signals must have the sample rate
+   * that is set in the config. The stream is split into segments of
+   * StreamingVisqol::kDefaultSegmentDuration, and the result of each segment
+   * is handed to the handler as soon as it is complete.
+   *
+   * @param handler Handles the result of each segment.
+   *
+   * @return The stream, which must not outlive this instance.
+   */
+  std::unique_ptr<StreamingVisqol> CreateStream(
+      StreamingVisqol::ResultHandler handler) const;
+
+  /**
+   * Set the executor that asynchronous comparisons are run on. By default,
+   * each comparison runs on a thread of its own. Must not be called while
+   * comparisons are in flight.
+   *
+   * @param executor The executor to run the comparisons on.
+   */
+  void SetExecutor(Executor executor);
+
+  /**
+   * Perform a ViSQOL comparison on the given input signals asynchronously,
+   * and pass its result to a callback on the thread of the executor.
+   *
+   * Any number of comparisons can be in flight at once, and their results
+   * match those of Measure.
+   *
+   * @param reference The reference input signal.
+   * @param degraded The degraded input signal.
+   * @param callback Receives the result of the comparison.
+   */
+  void MeasureAsync(std::vector<double> reference,
+                    std::vector<double> degraded, Callback callback);
+
+  /**
+   * Perform a ViSQOL comparison on the given input signals asynchronously.
+   *
+   * @param reference The reference input signal.
+   * @param degraded The degraded input signal.
+   *
+   * @return A future of the result of the comparison.
+   */
+  std::future<google::protobuf::util::StatusOr<SimilarityResultMsg>>
+  MeasureAsync(std::vector<double> reference, std::vector<double> degraded);
 
  private:
+  /**
+   * True if no asynchronous comparison is in flight. The mutex must be held.
+   */
+  bool IsIdle() const;
+
   /**
    * The instance of ViSQOL that will be used for comparing the signals.
    */
@@ -77,6 +288,19 @@ class VisqolApi {
    * The sample rate of the input signals to be compared.
    */
   size_t sample_rate_;
+
+  /**
+   * Runs the asynchronous comparisons, or is empty to run each one on a
+   * thread of its own.
+   */
+  Executor executor_;
+
+  absl::Mutex mutex_;
+
+  /**
+   * The number of asynchronous comparisons in flight.
+   */
+  size_t num_in_flight_ = 0;
 };
 }  // namespace Visqol
 
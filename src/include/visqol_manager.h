@@ -17,20 +17,36 @@
 #ifndef VISQOL_INCLUDE_VISQOLCOMMANDLINE_H
 #define VISQOL_INCLUDE_VISQOLCOMMANDLINE_H
 
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/statusor.h"
 
 #include "comparison_patches_selector.h"
+#include "compute_backend.h"
 #include "file_path.h"
 #include "gammatone_spectrogram_builder.h"
 #include "image_patch_creator.h"
+#include "previous_comparison.h"
+#include "reference_aligner.h"
+#include "reference_cache.h"
+#include "reference_feature_store.h"
+#include "reference_features.h"
+#include "result_cache.h"
 #include "similarity_result.h"
 #include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "similarity_to_quality_mapper.h"
 #include "svr_similarity_to_quality_mapper.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_workspace.h"
+#include "wav_tile_reader.h"
 
 namespace Visqol {
 
@@ -78,12 +94,33 @@ class VisqolManager {
    */
   static const double kDurationMismatchTolerance;
 
+  /**
+   * The shortest duration of the tiles that long pairs are compared in, in
+   * seconds.
+   */
+  static const double kMinTileDuration;
+
+  /**
+   * The duration of the degraded signal on each side of a tile that is
+   * compared with it, in seconds. The lag of a tile is searched within this
+   * far of the lag of the tile before.
+   */
+  static const double kTileMargin;
+
+  /**
+   * The estimated peak memory of a comparison per sample of the reference, in
+   * bytes. It is dominated by the copies of the signals and by the buffers of
+   * the global alignment.
+   */
+  static const size_t kBytesPerComparedSample;
+
   /**
    * Initializes an instance for use with the given similarity to quality
    * mapping model. Must be called before running comparisons.
    *
    * @param sim_to_quality_mapper_model The filepath to the similarity to
-   *    quality mapping model.
+   *    quality mapping model, or an empty path for the default audio model
+   *    that is compiled into the library.
    * @param use_speech_mode True if the input signals should be processed as
    *    speech audio. Else, false.
    * @param use_unscaled_speech True if perfect NSIM scores of 1.0 should not
@@ -95,6 +132,25 @@ class VisqolManager {
       const FilePath sim_to_quality_mapper_model,
       const bool use_speech_mode, const bool use_unscaled_speech);
 
+  /**
+   * Initializes an instance for use with the given similarity to quality
+   * mapping model and config options. Must be called before running
+   * comparisons.
+   *
+   * The svr_model_path in the options is ignored. The model to use is passed
+   * separately, so that the caller can resolve the default model location.
+   *
+   * @param sim_to_quality_mapper_model The filepath to the similarity to
+   *    quality mapping model, or an empty path for the default audio model
+   *    that is compiled into the library.
+   * @param options The config options to run the comparisons with.
+   *
+   * @return An 'OK' status if initialised successfully, else an error status.
+   */
+  google::protobuf::util::Status Init(
+      const FilePath sim_to_quality_mapper_model,
+      const VisqolConfig::VisqolOptions &options);
+
   /**
    * Perform comparisons on a number of reference/degraded audio file pairs.
    *
@@ -111,9 +167,40 @@ class VisqolManager {
   std::vector<SimilarityResultMsg> Run(
       const std::vector<ReferenceDegradedPathPair>& signals_to_compare);
 
+  /**
+   * Handles the result of the comparison of a pair of a batch. It is passed
+   * the index of the pair and the result, or the error status if the
+   * comparison failed.
+   */
+  using ResultHandler = std::function<void(size_t,
+      google::protobuf::util::StatusOr<SimilarityResultMsg>&&)>;
+
+  /**
+   * Perform comparisons on a number of reference/degraded audio file pairs,
+   * handing the result of each one to a handler as soon as it is compared, so
+   * that the results of a large batch do not need to be held in memory.
+   *
+   * If any of the comparisons fail, an error will be logged, the error is
+   * handed to the handler and the next comparison will be moved onto.
+   *
+   * @param signals_to_compare A vector of reference/degraded signal pairs to
+   *    be compared to each other.
+   * @param handler Handles the result of each comparison, in order.
+   */
+  void RunBatch(
+      const std::vector<ReferenceDegradedPathPair>& signals_to_compare,
+      const ResultHandler& handler);
+
   /**
    * Perform a comparison on a single reference/degraded audio file pair.
    *
+   * The spectrum used to globally align the signals is kept for the
+   * reference, so later comparisons against the same reference file only
+   * process the degraded signal.
+   *
+   * With the multichannel option, each channel is compared, as RunChannels
+   * does.
+   *
    * @param ref_signal_path The path to the reference audio file.
    * @param deg_signal_path The path to the degraded audio file.
    *
@@ -126,6 +213,13 @@ class VisqolManager {
   /**
    * Perform a comparison on a single reference/degraded audio signal pair.
    *
+   * This is safe to call concurrently on one initialized manager, from any
+   * number of threads. Each call takes its scratch memory from a pool that is
+   * kept across calls. reuse_global_lag does not support concurrent calls:
+   * the lag hint is carried on from whichever comparison completed last, so
+   * the lags and scores of concurrent comparisons depend on the order in
+   * which they complete.
+   *
    * @param ref_signal The reference audio signal.
    * @param deg_signal The degraded audio signal.
    *
@@ -133,7 +227,105 @@ class VisqolManager {
    *    comparison was successful, else it will contain the error Status.
    */
   google::protobuf::util::StatusOr<SimilarityResultMsg> Run(
-      const AudioSignal& ref_signal, AudioSignal& deg_signal);
+      const AudioSignal& ref_signal, AudioSignal& deg_signal) const;
+
+  /**
+   * Perform a comparison of each channel of a reference/degraded audio file
+   * pair, as Run does with the multichannel option. The files are decoded
+   * once, and the degraded file is globally aligned once, by the lag between
+   * the downmixes of the files. The channels are then compared on up to as
+   * many threads as the patch or segment workers of the options.
+   *
+   * @param ref_signal_path The path to the reference audio file.
+   * @param deg_signal_path The path to the degraded audio file, which must
+   *    have as many channels as the reference.
+   *
+   * @return A StatusOr object that will contain a SimilarityResultMsg with
+   *    the result of each channel, and their mean scores, if the comparison
+   *    of every channel was successful, else it will contain the error Status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> RunChannels(
+      const FilePath& ref_signal_path, const FilePath& deg_signal_path) const;
+
+  /**
+   * Perform comparisons of a number of degraded audio files against the same
+   * reference audio file, such as the rungs of a codec ladder. The reference
+   * is loaded, and its alignment envelope and features found, once for all
+   * of the comparisons, using the reference cache and the reference feature
+   * store if they are enabled.
+   *
+   * @param ref_signal_path The path to the reference audio file.
+   * @param deg_paths The paths to the degraded audio files.
+   * @param num_threads The number of threads to compare the degraded files
+   *    on. Values of 0 and 1 compare every file on the calling thread.
+   *
+   * @return A StatusOr object for each degraded file, in the same order,
+   *    that will contain a SimilarityResultMsg if its comparison was
+   *    successful, else it will contain the error Status.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>> RunMany(
+      const FilePath& ref_signal_path, const std::vector<FilePath>& deg_paths,
+      size_t num_threads);
+
+  /**
+   * Perform comparisons of a number of degraded audio signals against the
+   * same reference audio signal. The reference is resampled, and its
+   * alignment envelope and features built, once for all of the comparisons.
+   * This is safe to call concurrently, as the signal pair Run is.
+   *
+   * @param ref_signal The reference audio signal.
+   * @param deg_signals The degraded audio signals.
+   * @param num_threads The number of threads to compare the degraded signals
+   *    on. Values of 0 and 1 compare every signal on the calling thread.
+   *
+   * @return A StatusOr object for each degraded signal, in the same order,
+   *    that will contain a SimilarityResultMsg if its comparison was
+   *    successful, else it will contain the error Status.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>> RunMany(
+      const AudioSignal& ref_signal, std::vector<AudioSignal> deg_signals,
+      size_t num_threads = 1) const;
+
+  /**
+   * Perform comparisons of a number of short reference/degraded audio signal
+   * pairs, such as the clips of a speech corpus, one after another on the
+   * calling thread. The similarities of the clips are mapped to quality
+   * scores in one batch once every clip is compared, rather than one at a
+   * time, so that the support vectors of the model are evaluated once per
+   * batch of clips. The scores are the same as those of Run. This is safe to
+   * call concurrently, as the signal pair Run is.
+   *
+   * @param ref_signals The reference audio signals.
+   * @param deg_signals The degraded audio signals, one for each reference.
+   *
+   * @return A StatusOr object for each pair, in the same order, that will
+   *    contain a SimilarityResultMsg if its comparison was successful, else
+   *    it will contain the error Status.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>> RunClips(
+      const std::vector<AudioSignal>& ref_signals,
+      std::vector<AudioSignal> deg_signals) const;
+
+  /**
+   * Compare a synthetic signal pair of an expected duration on a number of
+   * threads at once, so that the first comparisons of real signals of that
+   * duration run as fast as those after them. The comparisons build the FFT
+   * plans and filter coefficients of that size, grow a workspace for each
+   * thread, and touch every page of the quality model. The synthetic pairs
+   * are aligned with a scratch copy of the lag hint, so they never change the
+   * hint of the real comparisons. This should be called before the real
+   * comparisons start.
+   *
+   * @param duration The expected duration of the signals, in seconds.
+   * @param sample_rate The sample rate of the signals that are to be
+   *    compared, before any resampling to the rate of the mode.
+   * @param num_threads The number of comparisons that are expected to run at
+   *    once.
+   *
+   * @return An OK status, or the error status of a synthetic comparison.
+   */
+  google::protobuf::util::Status Warmup(double duration, size_t sample_rate,
+                                        size_t num_threads = 1) const;
 
  private:
   /**
@@ -147,6 +339,88 @@ class VisqolManager {
    */
   bool use_unscaled_speech_mos_mapping_ = false;
 
+  /**
+   * The method used to build the spectrograms of the input signals.
+   */
+  VisqolConfig::VisqolOptions::SpectrogramMode spectrogram_mode_ =
+      VisqolConfig::VisqolOptions::GAMMATONE;
+
+  /**
+   * The number of threads that the patches of a single comparison are
+   * searched and realigned on.
+   */
+  size_t num_patch_workers_ = 1;
+
+  /**
+   * The number of threads that the spectrogram columns of a comparison are
+   * built on, in as many contiguous segments. The patches are searched and
+   * realigned on at least as many threads.
+   */
+  size_t num_segment_workers_ = 1;
+
+  /**
+   * The strategy used to search for the degraded patch that best matches each
+   * reference patch.
+   */
+  VisqolConfig::VisqolOptions::PatchSearch patch_search_ =
+      VisqolConfig::VisqolOptions::EXHAUSTIVE;
+
+  /**
+   * The patches whose coarse similarity is above this value are not finely
+   * realigned.
+   */
+  double realign_skip_similarity_ = 0.0;
+
+  /**
+   * If true, the patches are searched for in single precision.
+   */
+  bool use_float_patch_search_ = false;
+
+  /**
+   * The method used to globally align the degraded signal to the reference.
+   */
+  VisqolConfig::VisqolOptions::GlobalAlignment global_alignment_ =
+      VisqolConfig::VisqolOptions::FULL_RATE;
+
+  /**
+   * If true, the fine realignment of each patch only searches lags of up to
+   * half the patch.
+   */
+  bool use_bounded_patch_realignment_ = false;
+
+  /**
+   * Guards the lag hint, which comparisons on several threads may carry on.
+   */
+  mutable absl::Mutex global_lag_mutex_;
+
+  /**
+   * The expected lag (in sec) of the next degraded signal.
+   */
+  mutable double global_lag_hint_ = 0.0;
+
+  /**
+   * If above 0, the global alignment only searches the lags within this many
+   * seconds of the lag hint.
+   */
+  double global_lag_search_window_ = 0.0;
+
+  /**
+   * If true, the lag applied by each comparison becomes the lag hint.
+   */
+  bool reuse_global_lag_ = false;
+
+  /**
+   * If true, the input signals are resampled to the native sample rate of the
+   * mode before they are compared.
+   */
+  bool resample_to_mode_rate_ = false;
+
+  /**
+   * The number of upcoming pairs of a batch that are loaded while the current
+   * pair is compared.
+   */
+  size_t num_prefetch_pairs_ = 0;
+
   /**
    * True if the object was successfully initialized, else false.
    */
@@ -176,6 +450,158 @@ class VisqolManager {
    */
   std::unique_ptr<SimilarityToQualityMapper> sim_to_qual_;
 
+  /**
+   * Aligns the degraded signals to the reference file that was compared last.
+   */
+  std::unique_ptr<ReferenceAligner> reference_aligner_;
+
+  /**
+   * The path of the reference file that the reference aligner was prepared
+   * for.
+   */
+  std::string reference_aligner_path_;
+
+  /**
+   * The reference files that were compared recently, along with their
+   * features, or null if they are not cached.
+   */
+  std::unique_ptr<ReferenceCache> reference_cache_;
+
+  /**
+   * The directory that the features of reference files are saved in, or
+   * null if they are not saved.
+   */
+  std::unique_ptr<ReferenceFeatureStore> reference_feature_store_;
+
+  /**
+   * If true, the features of the reference files that are not in the store
+   * are saved to it once they are built.
+   */
+  bool write_reference_features_ = false;
+
+  /**
+   * The cache of the results of earlier runs, or null if results are not
+   * cached. Shared with the other instances that use the same file.
+   */
+  std::shared_ptr<ResultCache> result_cache_;
+
+  /**
+   * The hash of the options, model and version that the results depend on,
+   * which is part of the key of each result in the result cache, and which
+   * the earlier results of --previous_results must match.
+   */
+  uint64_t result_config_hash_ = 0;
+
+  /**
+   * If true, the hashes of the blocks of the degraded signal are recorded in
+   * the result of each pair that is compared whole and in mono.
+   */
+  bool record_block_hashes_ = false;
+
+  /**
+   * The results of an earlier run, by the path of their degraded file, whose
+   * patches are reused where the degraded file did not change.
+   */
+  std::map<std::string, SimilarityResultMsg> previous_results_;
+
+  /**
+   * If greater than 0, the duration (in sec) of the windows of the timeline
+   * of each comparison.
+   */
+  double timeline_window_ = 0.0;
+
+  /**
+   * The maximum number of reference patches that are compared, or 0 to
+   * compare them all.
+   */
+  size_t max_patches_ = 0;
+
+  /**
+   * If greater than 0, the standard error of the VNSIM that the comparison of
+   * the patches stops at.
+   */
+  double target_vnsim_stderr_ = 0.0;
+
+  /**
+   * If true, only the columns of the degraded spectrogram that the patch
+   * search reads are built.
+   */
+  bool lazy_degraded_spectrogram_ = false;
+
+  /**
+   * If negative, the level in dB relative to the peak of the reference below
+   * which reference patches are not compared in audio mode.
+   */
+  double silent_patch_threshold_ = 0.0;
+
+  /**
+   * If true, each channel of the files of a pair is scored on its own.
+   */
+  bool multichannel_ = false;
+
+  /**
+   * If true, the time spent in each stage of each comparison is recorded in
+   * its result.
+   */
+  bool record_stage_timings_ = false;
+
+  /**
+   * If true, the memory used by each comparison is recorded in its result.
+   */
+  bool record_memory_usage_ = false;
+
+  /**
+   * How much of the detail of each comparison is copied into its result.
+   */
+  VisqolConfig::VisqolOptions::ResultDetail result_detail_ =
+      VisqolConfig::VisqolOptions::FULL;
+
+  /**
+   * If true, a degraded signal that matches the reference once it is aligned
+   * and scaled is given the perfect similarity without being compared.
+   */
+  bool detect_identical_signals_ = false;
+
+  /**
+   * The largest difference between an aligned and scaled degraded sample and
+   * its reference sample for the signals to match.
+   */
+  double identical_signal_tolerance_ = 0.0;
+
+  /**
+   * If not null, the backend that builds the gammatone spectrograms and
+   * compares the patches. It is owned by the ComputeBackendRegistry.
+   */
+  const ComputeBackend* compute_backend_ = nullptr;
+
+  /**
+   * If above 0, the duration of the tiles that long pairs of files are
+   * compared in, in seconds.
+   */
+  double tile_duration_ = 0.0;
+
+  /**
+   * If above 0, the memory in bytes that the comparison of a pair of files
+   * should stay within.
+   */
+  size_t max_memory_bytes_ = 0;
+
+  /**
+   * Guards the idle workspaces.
+   */
+  mutable absl::Mutex workspaces_mutex_;
+
+  /**
+   * The workspaces that are kept across the comparisons that are run by this
+   * manager, and are not in use. Each comparison takes one for its scratch
+   * memory and returns it once it is done, so there are as many as there
+   * have been comparisons running at once. A workspace is reset after every
+   * comparison, and keeps the memory of the largest one so far along with the
+   * recycled spectrogram matrices and filter banks, so that comparisons of
+   * clips of the same length do not reallocate them.
+   */
+  mutable std::vector<std::unique_ptr<VisqolWorkspace>> idle_workspaces_;
+
   /**
    * Initialises the patch creator.
    */
@@ -204,7 +630,264 @@ class VisqolManager {
    * @return An error status if the object was not initialized correctly. Else,
    * an 'ok' status is returned.
    */
-  google::protobuf::util::Status ErrorIfNotInitialized();
+  google::protobuf::util::Status ErrorIfNotInitialized() const;
+
+  /**
+   * Resample a signal to the native sample rate of the mode, if resampling is
+   * enabled and the signal is not already at that rate.
+   *
+   * @param signal The signal to resample.
+   *
+   * @return The signal at the rate that it is compared at.
+   */
+  AudioSignal ResampleToModeRate(AudioSignal signal) const;
+
+  /**
+   * Load an audio file as a mono signal at the rate that it is compared at,
+   * or copy it from the reference cache. This is safe to call concurrently.
+   *
+   * @param path The path to the audio file.
+   *
+   * @return The loaded signal.
+   */
+  AudioSignal LoadSignal(const FilePath& path) const;
+
+  /**
+   * Perform a comparison on a reference/degraded audio file pair whose
+   * signals have already been loaded.
+   *
+   * @param paths The paths that the signals were loaded from.
+   * @param ref_signal The reference audio signal.
+   * @param deg_signal The degraded audio signal.
+   *
+   * @return A StatusOr object that will contain a SimilarityResultMsg if the
+   *    comparison was successful, else it will contain the error Status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> RunLoadedPair(
+      const ReferenceDegradedPathPair& paths, const AudioSignal& ref_signal,
+      AudioSignal& deg_signal);
+
+  /**
+   * Perform a comparison of each channel of a reference/degraded audio file
+   * pair whose channels have already been loaded, as RunChannels does.
+   *
+   * @param paths The paths that the signals were loaded from.
+   * @param ref_channels The reference audio signal, with a column per
+   *    channel, at the rate of the file.
+   * @param deg_channels The degraded audio signal, with a column per
+   *    channel, at the rate of the file.
+   *
+   * @return A StatusOr object that will contain a SimilarityResultMsg if the
+   *    comparison was successful, else it will contain the error Status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> RunLoadedChannels(
+      const ReferenceDegradedPathPair& paths, const AudioSignal& ref_channels,
+      const AudioSignal& deg_channels) const;
+
+  /**
+   * Find the result of a pair of signals in the result cache.
+   *
+   * @param key The key of the signals.
+   * @param paths The paths that the signals were loaded from, which are set
+   *    in the result.
+   * @param sim_result_msg Set to the result, if it is found.
+   *
+   * @return True if the result was found.
+   */
+  bool FindCachedResult(const ResultCache::Key& key,
+                        const ReferenceDegradedPathPair& paths,
+                        SimilarityResultMsg* sim_result_msg) const;
+
+  /**
+   * Perform a comparison on a single reference/degraded audio signal pair,
+   * optionally aligning them with an aligner prepared for the reference.
+   * The lag that the degraded signal is globally aligned by is reported in
+   * the result.
+   *
+   * @param ref_signal The reference audio signal.
+   * @param deg_signal The degraded audio signal.
+   * @param ref_aligner If not null, the aligner prepared for the reference
+   *    signal. Else, the signals are aligned from scratch.
+   * @param ref_features If not null, the features of the reference signal.
+   *    Else, they are built for this comparison.
+   * @param previous If not null, an earlier comparison of the same files,
+   *    whose patches are reused where the degraded signal did not change.
+   * @param sim_to_qual_mapper If not null, maps the similarity of the
+   *    compared patches to quality in place of the mapper of this instance.
+   * @param global_lag_hint If not null, the lag hint that the global alignment
+   *    uses and updates, in place of the shared hint of this instance.
+   *
+   * @return A StatusOr object that will contain a SimilarityResultMsg if the
+   *    comparison was successful, else it will contain the error Status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> RunComparison(
+      const AudioSignal& ref_signal, AudioSignal& deg_signal,
+      ReferenceAligner* ref_aligner,
+      const ReferenceFeatures* ref_features = nullptr,
+      const PreviousComparison* previous = nullptr,
+      const SimilarityToQualityMapper* sim_to_qual_mapper = nullptr,
+      double* global_lag_hint = nullptr) const;
+
+  /**
+   * Globally align a degraded signal to the reference with the alignment
+   * method of the options, and carry the lag on as the hint if it is reused.
+   *
+   * @param ref_signal The reference audio signal.
+   * @param deg_signal The degraded audio signal.
+   * @param ref_aligner If not null, the aligner prepared for the reference
+   *    signal.
+   * @param global_lag_hint If not null, the lag hint to search around and to
+   *    carry the lag on in, in place of the shared hint of this instance.
+   *
+   * @return A tuple of the aligned degraded signal and its lag in seconds.
+   */
+  std::tuple<AudioSignal, double> GloballyAlign(
+      const AudioSignal& ref_signal, const AudioSignal& deg_signal,
+      ReferenceAligner* ref_aligner, double* global_lag_hint = nullptr) const;
+
+  /**
+   * Compare a degraded signal that has already been globally aligned to the
+   * reference.
+   *
+   * @param ref_signal The reference audio signal.
+   * @param deg_signal The aligned degraded audio signal.
+   * @param global_lag The lag that the degraded signal was aligned by, in
+   *    seconds, which is reported in the result.
+   * @param ref_features If not null, the features of the reference signal.
+   * @param previous If not null, an earlier comparison of the same files. It
+   *    is only used if the degraded signal was aligned by the same lag.
+   * @param sim_to_qual_mapper If not null, maps the similarity of the
+   *    compared patches to quality in place of the mapper of this instance.
+   *    The signals that are found to be identical, and the windows of the
+   *    timeline, are still mapped with the mapper of this instance.
+   *
+   * @return A StatusOr object that will contain a SimilarityResultMsg if the
+   *    comparison was successful, else it will contain the error Status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> CompareAligned(
+      const AudioSignal& ref_signal, AudioSignal& deg_signal,
+      double global_lag, const ReferenceFeatures* ref_features,
+      const PreviousComparison* previous = nullptr,
+      const SimilarityToQualityMapper* sim_to_qual_mapper = nullptr) const;
+
+  /**
+   * Compare degraded signals against a reference whose features have already
+   * been prepared.
+   *
+   * @param ref_signal The reference audio signal, at the rate it is compared.
+   * @param ref_features If not null, the features of the reference signal.
+   * @param num_degraded The number of degraded signals.
+   * @param num_threads The number of threads to compare the signals on.
+   * @param degraded_signal Gets a degraded signal, at the rate it is
+   *    compared, by its index. It is called once for each index, from the
+   *    thread that compares the signal.
+   *
+   * @return A StatusOr object for each degraded signal, in order.
+   */
+  std::vector<google::protobuf::util::StatusOr<SimilarityResultMsg>>
+  RunManyPrepared(const AudioSignal& ref_signal,
+                  const ReferenceFeatures* ref_features, size_t num_degraded,
+                  size_t num_threads,
+                  const std::function<AudioSignal(size_t)>& degraded_signal)
+      const;
+
+  /**
+   * Build the features of a reference signal that are shared by the
+   * comparisons against it.
+   *
+   * @param ref_signal The reference signal.
+   *
+   * @return The features, or null if they could not be built, in which case
+   *    each comparison builds them and reports the error.
+   */
+  std::unique_ptr<ReferenceFeatures> BuildReferenceFeatures(
+      const AudioSignal& ref_signal) const;
+
+  /**
+   * Get the features of a reference file from the reference cache, or load
+   * them from the reference feature store, or else build them. Features that
+   * are built are saved to the store if it is written to, and added to the
+   * cache.
+   *
+   * @param path The path that the reference signal was loaded from.
+   * @param ref_signal The reference signal.
+   *
+   * @return The features, or null if they could not be built.
+   */
+  std::shared_ptr<const ReferenceFeatures> FindReferenceFeatures(
+      const FilePath& path, const AudioSignal& ref_signal);
+
+  /**
+   * The number of threads that the stages of a single comparison are run
+   * on: its patch workers or its segment workers, whichever is more.
+   */
+  size_t NumPairWorkers() const;
+
+  /**
+   * True if degraded signals are globally aligned to the reference with a
+   * ReferenceAligner, which uses the upper envelope of the reference.
+   */
+  bool UsesReferenceAligner() const;
+
+  /**
+   * Take an idle workspace for a comparison, or create a new one.
+   *
+   * @return The workspace.
+   */
+  std::unique_ptr<VisqolWorkspace> TakeWorkspace() const;
+
+  /**
+   * Reset a workspace that a comparison is done with, and return it to the
+   * idle workspaces.
+   *
+   * @param workspace The workspace.
+   */
+  void RecycleWorkspace(std::unique_ptr<VisqolWorkspace> workspace) const;
+
+  /**
+   * The number of reference samples in each tile that a pair of files is
+   * compared in, from the tile duration and the memory limit.
+   *
+   * @param sample_rate The sample rate of the files.
+   *
+   * @return The number of samples, or 0 if pairs are compared whole.
+   */
+  size_t TileSamples(size_t sample_rate) const;
+
+  /**
+   * Compare a pair of files in tiles of the reference, reading each tile and
+   * the degraded samples around it as it is compared. The first tile is
+   * globally aligned as a whole pair would be, and each tile after it around
+   * the lag of the tile before. Only the results of the patches of each tile
+   * are kept, and they are combined into the result of the pair once every
+   * tile is compared.
+   *
+   * @param ref_reader Reads the reference file.
+   * @param deg_reader Reads the degraded file.
+   * @param tile_samples The number of reference samples in each tile. The
+   *    last tile also takes the samples after it if they are fewer than half
+   *    of a tile.
+   * @param deg_scale_factor The factor that the degraded samples of every
+   *    tile are scaled by, which matches the spl of the whole degraded file
+   *    to that of the whole reference file.
+   *
+   * @return The result of the pair, or the error of the first tile that
+   *    failed.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> RunTiled(
+      WavTileReader* ref_reader, WavTileReader* deg_reader,
+      size_t tile_samples, double deg_scale_factor) const;
+
+  /**
+   * The result of comparing a degraded signal that matches the reference: a
+   * FVNSIM of 1 in every band, mapped to the MOS-LQO by the quality mapper,
+   * without any patches.
+   *
+   * @param sample_rate The sample rate of the signals.
+   *
+   * @return The similarity result, flagged as identical.
+   */
+  SimilarityResult IdenticalSignalsResult(size_t sample_rate) const;
 
   /**
    * For a given ViSQOL similarity result, populate a similarity result
@@ -219,7 +902,8 @@ class VisqolManager {
    *
    * @return The similarity result in protobuf format.
    */
-  SimilarityResultMsg PopulateSimResultMsg(const SimilarityResult &sim_result);
+  SimilarityResultMsg PopulateSimResultMsg(
+      const SimilarityResult &sim_result) const;
 
   /**
    * Validate that the input audio signal meet the necessary requirements.
@@ -230,7 +914,7 @@ class VisqolManager {
    * @return An 'OK' status if input signals are valid, else an error status.
    */
   google::protobuf::util::Status ValidateInputAudio(
-      const AudioSignal& ref_signal, const AudioSignal& deg_signal);
+      const AudioSignal& ref_signal, const AudioSignal& deg_signal) const;
 };
 }  // namespace Visqol
 
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_VISQOL_SERVER_H
+#define VISQOL_INCLUDE_VISQOL_SERVER_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/message_lite.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+#include "visqol_service.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+/**
+ * A long running ViSQOL service, which keeps initialized instances of ViSQOL
+ * warm between requests so that each request does not pay for loading the
+ * SVR model and setting up the comparison.
+ *
+ * Requests are served over a unix domain socket. Each message on a
+ * connection is a VisqolRequest or VisqolResponse, serialized and prefixed by
+ * its size as a 4 byte little endian integer. A client may send any number of
+ * requests on a connection, one at a time, each followed by its response.
+ *
+ * A request may also pass up to kMaxMessageFds file descriptors with its
+ * size prefix, as SCM_RIGHTS ancillary data, to share the samples of its
+ * signals. The samples are mapped privately rather than copied, so
+ * co-located clients can hand over long signals without serializing them.
+ * Each descriptor must be a memfd that is sealed against shrinking and
+ * writing, so that the client cannot truncate the mapped samples.
+ *
+ * Up to a given number of requests are compared at once. Further requests
+ * wait for a free slot, up to a given number, beyond which they are rejected
+ * at once with RESOURCE_EXHAUSTED, so that callers can back off rather than
+ * queue without bound.
+ */
+class VisqolServer {
+ public:
+  /**
+   * The largest message that is read from a connection, in bytes.
+   */
+  static const size_t kMaxMessageBytes;
+
+  /**
+   * The most file descriptors that are read with a message, which is one for
+   * each signal of a request.
+   */
+  static const size_t kMaxMessageFds;
+
+  /**
+   * Constructs a server.
+   *
+   * @param max_concurrent_requests The maximum number of requests that are
+   *    compared at once, and of idle instances of ViSQOL that are kept warm.
+   * @param max_queued_requests The maximum number of requests that wait for
+   *    a free slot.
+   */
+  VisqolServer(size_t max_concurrent_requests, size_t max_queued_requests);
+
+  /**
+   * Waits for Serve to return.
+   */
+  ~VisqolServer();
+
+  VisqolServer(const VisqolServer &) = delete;
+  VisqolServer &operator=(const VisqolServer &) = delete;
+
+  /**
+   * Handle a request, waiting for a free slot if needed. Can be called
+   * concurrently.
+   *
+   * @param request The request to handle.
+   * @param fds The file descriptors that were passed with the request, which
+   *    its shared samples refer to. They remain owned by the caller.
+   *
+   * @return The response to the request.
+   */
+  VisqolResponse Handle(const VisqolRequest &request,
+                        const std::vector<int> &fds = {});
+
+  /**
+   * Serve requests on a unix domain socket until Shutdown is called. Each
+   * connection is served on its own thread.
+   *
+   * @param socket_path The path of the socket to create. An existing file at
+   *    the path is replaced.
+   *
+   * @return An OK status once the server is shut down, or an error status if
+   *    the socket could not be created.
+   */
+  google::protobuf::util::Status Serve(const std::string &socket_path);
+
+  /**
+   * Stop accepting connections, close the open connections and make Serve
+   * return once their requests in progress are complete.
+   */
+  void Shutdown();
+
+  /**
+   * Send a request to a server and wait for its response, on a connection of
+   * its own.
+   *
+   * @param socket_path The path of the socket of the server.
+   * @param request The request to send.
+   * @param fds The file descriptors to pass with the request, which its
+   *    shared samples refer to. They remain owned by the caller.
+   *
+   * @return The response, or an error status if the server could not be
+   *    reached.
+   */
+  static google::protobuf::util::StatusOr<VisqolResponse> Call(
+      const std::string &socket_path, const VisqolRequest &request,
+      const std::vector<int> &fds = {});
+
+  /**
+   * Write a size prefixed message to a socket.
+   *
+   * @param fd The socket to write to.
+   * @param message The message to write.
+   * @param fds The file descriptors to pass with the message.
+   *
+   * @return True if the whole message was written.
+   */
+  static bool WriteMessage(int fd,
+                           const google::protobuf::MessageLite &message,
+                           const std::vector<int> &fds = {});
+
+  /**
+   * Read a size prefixed message from a socket.
+   *
+   * @param fd The socket to read from.
+   * @param message The message to parse into.
+   * @param fds The file descriptors that were passed with the message are
+   *    appended here, even if the message is not read whole, and the caller
+   *    must close them. If this is null, they are closed at once.
+   *
+   * @return True if a whole message was read and parsed, or false at the end
+   *    of the connection or on an error, including more than kMaxMessageFds
+   *    descriptors being passed with the message.
+   */
+  static bool ReadMessage(int fd, google::protobuf::MessageLite *message,
+                          std::vector<int> *fds = nullptr);
+
+ private:
+  /**
+   * Compare the signals of a request on an instance of ViSQOL.
+   *
+   * @param visqol The instance to compare the signals on.
+   * @param request The request with the signals to compare.
+   * @param fds The file descriptors that the shared samples refer to.
+   *
+   * @return The result of the comparison, or an error status.
+   */
+  google::protobuf::util::StatusOr<SimilarityResultMsg> Compare(
+      VisqolManager *visqol, const VisqolRequest &request,
+      const std::vector<int> &fds);
+
+  /**
+   * Take an idle instance of ViSQOL with the given options, or initialize a
+   * new one.
+   *
+   * @param options The options of the instance.
+   * @param key The key of the options in the pool.
+   * @param visqol Set to the instance.
+   *
+   * @return An OK status, or an error status if the instance could not be
+   *    initialized.
+   */
+  google::protobuf::util::Status Acquire(
+      const VisqolConfig::VisqolOptions &options, const std::string &key,
+      std::unique_ptr<VisqolManager> *visqol);
+
+  /**
+   * Return an instance of ViSQOL to the pool, or free it if the pool is full.
+   *
+   * @param key The key of the options of the instance.
+   * @param visqol The instance.
+   */
+  void Release(const std::string &key, std::unique_ptr<VisqolManager> visqol);
+
+  /**
+   * Serve the requests of a connection until it is closed.
+   *
+   * @param fd The socket of the connection, which is closed at the end.
+   */
+  void ServeConnection(int fd);
+
+  /**
+   * True if fewer than max_concurrent_requests_ requests are being compared.
+   * The mutex must be held.
+   */
+  bool HasFreeSlot() const;
+
+  /**
+   * True if fewer than max_reading_connections_ connections are reading the
+   * body of a request, or if the server is shut down. The mutex must be held.
+   */
+  bool CanReadRequest() const;
+
+  const size_t max_concurrent_requests_;
+  const size_t max_queued_requests_;
+
+  /**
+   * The maximum number of connections that read the body of a request at
+   * once, which is the number of requests that may be running or waiting.
+   */
+  const size_t max_reading_connections_;
+
+  absl::Mutex mutex_;
+
+  /**
+   * The number of requests that are being compared.
+   */
+  size_t num_running_ = 0;
+
+  /**
+   * The number of requests that are waiting for a free slot.
+   */
+  size_t num_waiting_ = 0;
+
+  /**
+   * The number of connections that are reading the body of a request.
+   */
+  size_t num_reading_ = 0;
+
+  /**
+   * The idle instances of ViSQOL, by the serialized options that they were
+   * initialized with.
+   */
+  std::map<std::string, std::vector<std::unique_ptr<VisqolManager>>> idle_;
+
+  /**
+   * The number of idle instances of ViSQOL in the pool.
+   */
+  size_t num_idle_ = 0;
+
+  /**
+   * The listening socket while serving, or -1.
+   */
+  int listen_fd_ = -1;
+
+  /**
+   * True once Shutdown has been called.
+   */
+  bool is_shut_down_ = false;
+
+  /**
+   * True while Serve is running.
+   */
+  bool is_serving_ = false;
+
+  /**
+   * The sockets of the open connections. Serve waits for it to empty before
+   * it returns.
+   */
+  std::set<int> connection_fds_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_VISQOL_SERVER_H
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_VISQOL_WORKSPACE_H
+#define VISQOL_INCLUDE_VISQOL_WORKSPACE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "gammatone_filterbank.h"
+
+namespace Visqol {
+
+/**
+ * An arena for the scratch buffers of a comparison, such as the copies of the
+ * signals that are filtered and the per frame band values of the spectrogram
+ * builders. Buffers are carved out of large blocks and are only freed, all at
+ * once, when the workspace is reset at the end of the comparison.
+ *
+ * Each reset replaces the blocks with a single block that is as large as the
+ * most memory used by one comparison so far. Once a comparison of the largest
+ * size has been run, later comparisons of up to that size allocate no blocks.
+ *
+ * The workspace also keeps the spectrogram matrices and the gammatone filter
+ * banks that are recycled into it, across resets. A worker thread that keeps
+ * one workspace for all of its comparisons takes these back out for the next
+ * comparison, so comparisons of clips of the same length reuse them rather
+ * than reallocating them.
+ *
+ * Buffers may be allocated from several threads at once. Reset must not be
+ * called while any buffer is still in use.
+ */
+class VisqolWorkspace {
+ public:
+  /**
+   * The minimum size of a block in bytes.
+   */
+  static const size_t kMinBlockBytes;
+
+  /**
+   * The maximum number of recycled matrices that are kept. The least recently
+   * recycled matrix is freed when there are more.
+   */
+  static const size_t kMaxRecycledMatrices;
+
+  /**
+   * The maximum number of recycled filter banks that are kept.
+   */
+  static const size_t kMaxRecycledFilterBanks;
+
+  VisqolWorkspace() = default;
+
+  VisqolWorkspace(const VisqolWorkspace &) = delete;
+  VisqolWorkspace &operator=(const VisqolWorkspace &) = delete;
+
+  /**
+   * Allocate an uninitialised buffer. It remains valid until the next Reset.
+   *
+   * @param size The number of elements in the buffer.
+   *
+   * @return The buffer.
+   */
+  template <typename T>
+  absl::Span<T> Allocate(size_t size) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "The workspace never runs destructors.");
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "The workspace only aligns for the fundamental types.");
+    return absl::Span<T>(static_cast<T *>(AllocateBytes(size * sizeof(T))),
+                         size);
+  }
+
+  /**
+   * Take a matrix of the given size, reusing a recycled matrix of that size
+   * if there is one. The values of the matrix are not initialised.
+   *
+   * @param num_rows The number of rows of the matrix.
+   * @param num_cols The number of columns of the matrix.
+   *
+   * @return The matrix.
+   */
+  AMatrix<double> TakeMatrix(size_t num_rows, size_t num_cols);
+
+  /**
+   * Keep a matrix that is no longer used, for a later TakeMatrix.
+   *
+   * @param matrix The matrix to recycle.
+   */
+  void RecycleMatrix(AMatrix<double> &&matrix);
+
+  /**
+   * Take a copy of a filter bank, copying it into a recycled filter bank with
+   * the same number of bands if there is one, so that its coefficient and
+   * state arrays are not reallocated.
+   *
+   * @param filter_bank The filter bank to copy.
+   *
+   * @return The copy of the filter bank.
+   */
+  GammatoneFilterBank TakeFilterBank(const GammatoneFilterBank &filter_bank);
+
+  /**
+   * Keep a filter bank that is no longer used, for a later TakeFilterBank.
+   *
+   * @param filter_bank The filter bank to recycle.
+   */
+  void RecycleFilterBank(GammatoneFilterBank &&filter_bank);
+
+  /**
+   * Free all of the buffers, keeping enough memory for the largest
+   * comparison so far in a single block. The recycled matrices and filter
+   * banks are kept.
+   */
+  void Reset();
+
+  /**
+   * Get the number of blocks that have been allocated since the workspace
+   * was created.
+   *
+   * @return The number of block allocations.
+   */
+  size_t NumBlockAllocations() const;
+
+  /**
+   * Get the number of matrices that TakeMatrix has allocated, rather than
+   * reused, since the workspace was created.
+   *
+   * @return The number of matrix allocations.
+   */
+  size_t NumMatrixAllocations() const;
+
+  /**
+   * Get the number of bytes held in blocks.
+   *
+   * @return The capacity of the workspace in bytes.
+   */
+  size_t Capacity() const;
+
+ private:
+  /**
+   * A block of memory that buffers are carved out of, from its start.
+   */
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+    size_t used;
+  };
+
+  /**
+   * Allocate a buffer from the last block, or from a new block if it does not
+   * fit. Sizes are rounded up to the fundamental alignment, so the memory
+   * used by a comparison does not depend on the order of its allocations.
+   *
+   * @param num_bytes The size of the buffer in bytes.
+   *
+   * @return The start of the buffer.
+   */
+  void *AllocateBytes(size_t num_bytes);
+
+  /**
+   * Add a new block of at least the given size. The mutex must be held.
+   *
+   * @param num_bytes The minimum size of the block in bytes.
+   */
+  void AddBlock(size_t num_bytes);
+
+  /**
+   * Get the number of bytes held in blocks. The mutex must be held.
+   *
+   * @return The total size of the blocks in bytes.
+   */
+  size_t TotalBlockBytes() const;
+
+  /**
+   * Guards the blocks and the counters.
+   */
+  mutable absl::Mutex mutex_;
+
+  /**
+   * The blocks, with the one that is being carved up last.
+   */
+  std::vector<Block> blocks_;
+
+  /**
+   * The number of bytes used since the last reset.
+   */
+  size_t used_bytes_ = 0;
+
+  /**
+   * The largest number of bytes used between two resets.
+   */
+  size_t high_water_bytes_ = 0;
+
+  /**
+   * The number of blocks allocated since the workspace was created.
+   */
+  size_t num_block_allocations_ = 0;
+
+  /**
+   * The matrices that are no longer used, ordered from the most recently
+   * recycled.
+   */
+  std::list<AMatrix<double>> recycled_matrices_;
+
+  /**
+   * The number of matrices that TakeMatrix has allocated.
+   */
+  size_t num_matrix_allocations_ = 0;
+
+  /**
+   * The filter banks that are no longer used, ordered from the most recently
+   * recycled.
+   */
+  std::list<GammatoneFilterBank> recycled_filter_banks_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_VISQOL_WORKSPACE_H
@@ -19,13 +19,17 @@
 
 #include <cstdint>
 #include <istream>
+#include <vector>
+
+#include "absl/types/span.h"
 
 #include "misc_math.h"
 
 namespace Visqol {
 
 /**
- *  Basic RIFF WAVE decoder that supports multichannel 16-bit PCM.
+ *  Basic RIFF WAVE decoder that supports multichannel 16, 24 and 32-bit PCM
+ *  and 32-bit IEEE float, including in the extensible format.
  *
  *  This class was adapted from the ResonanceAudio project:
  *  https://github.com/resonance-audio/resonance-audio
@@ -66,14 +70,62 @@ class WavReader {
   double GetDuration() const;
 
   /**
-  * Reads samples from WAV file into target buffer.
+  * Reads samples from WAV file into target buffer. Only 16-bit PCM files
+  * can be read this way; the other formats are read with ReadMonoSamples.
   *
   * @param num_samples Number of samples to read.
   * @param target_buffer Target buffer to write to.
-  * @return Number of decoded samples.
+  * @return Number of decoded samples, which is 0 if the file is not 16-bit
+  *    PCM.
   */
   size_t ReadSamples(size_t num_samples, int16_t* target_buffer);
 
+  /**
+  * Reads frames of interleaved samples from WAV file, normalizes them to
+  * [-1, 1) and mixes the channels of each frame down to a single sample. The
+  * samples are decoded in blocks, so the file is read in a single pass
+  * without its samples being held in memory.
+  *
+  * @param num_frames Number of frames to read.
+  * @param target_buffer Target buffer to write one sample per frame to.
+  * @return Number of decoded frames.
+  */
+  size_t ReadMonoSamples(size_t num_frames, double* target_buffer);
+
+  /**
+  * Reads frames of interleaved samples from WAV file, normalizes them to
+  * [-1, 1) and splits them into their channels, without mixing them down.
+  * The samples are decoded in blocks, as ReadMonoSamples does.
+  *
+  * @param num_frames Number of frames to read.
+  * @param target_buffer Target buffer of num_frames samples per channel. The
+  *    samples of each channel are written after those of the channel before,
+  *    so the buffer is laid out as a column major matrix with a column per
+  *    channel.
+  * @return Number of decoded frames.
+  */
+  size_t ReadChannels(size_t num_frames, double* target_buffer);
+
+  /**
+  * Reads the next block of the WAV file as mono samples, as ReadMonoSamples
+  * does. Calling this repeatedly with a block of a fixed size streams the
+  * file, holding no more than one block of it at a time.
+  *
+  * @param block Target block to fill with one sample per frame.
+  * @return Number of decoded frames. This is the size of the block, except at
+  *    the end of the file, where it is 0 once every frame has been read.
+  */
+  size_t ReadMonoBlock(absl::Span<double> block);
+
+  /**
+  * Reads the next block of the WAV file as single precision mono samples.
+  * Each sample is mixed down in double precision and then rounded.
+  *
+  * @param block Target block to fill with one sample per frame.
+  * @return Number of decoded frames.
+  */
+  size_t ReadMonoBlock(absl::Span<float> block);
+
  private:
   /**
    * Calculate the total number of bytes in the data stream.
@@ -98,6 +150,27 @@ class WavReader {
   */
   size_t ReadBinaryDataFromStream(void* target_ptr, size_t size);
 
+  /**
+  * Reads samples from WAV file without decoding them.
+  *
+  * @param num_samples Number of samples to read.
+  * @param target_buffer Target buffer of bytes_per_sample_ bytes per sample.
+  * @return Number of samples read.
+  */
+  size_t ReadRawSamples(size_t num_samples, void* target_buffer);
+
+  /**
+  * Decodes frames into mono samples of the given type, as ReadMonoSamples
+  * does.
+  *
+  * @param num_frames Number of frames to read.
+  * @param target_buffer Target buffer to write one sample per frame to.
+  * @return Number of decoded frames.
+  */
+  template <typename T>
+  size_t DecodeMono(size_t num_frames, T* target_buffer);
+
+
   /**
   * Binary input stream.
   */
@@ -133,6 +206,11 @@ class WavReader {
   */
   size_t bytes_per_sample_;
 
+  /**
+  * True if the samples are IEEE float rather than PCM.
+  */
+  bool is_float_ = false;
+
   /**
   * Offset into data stream where PCM data begins.
   */
@@ -142,6 +220,13 @@ class WavReader {
    * Total number of bytes in data stream.
    */
   int64_t bytes_in_stream_;
+
+  /**
+  * The encoded interleaved samples of the block that is being decoded to
+  * mono. It is kept so that streaming the file does not allocate for every
+  * block.
+  */
+  std::vector<uint8_t> raw_block_;
 };
 
 }  // namespace Visqol
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_WAV_TILE_READER_H
+#define VISQOL_INCLUDE_WAV_TILE_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "wav_reader.h"
+
+namespace Visqol {
+/**
+ * Reads a wav file as mono, one range of samples at a time, for comparisons
+ * that are made in tiles of time. The ranges move forward through the file
+ * and may overlap, and only the samples of the latest range are held in
+ * memory, so a file of any duration is read in bounded memory.
+ */
+class WavTileReader {
+ public:
+  /**
+   * Opens the file and reads its header.
+   *
+   * @param path The path of the file.
+   */
+  explicit WavTileReader(const FilePath &path);
+
+  WavTileReader(const WavTileReader &) = delete;
+  WavTileReader &operator=(const WavTileReader &) = delete;
+
+  /**
+   * @return True if the file was opened and its header is valid.
+   */
+  bool ok() const { return reader_ != nullptr; }
+
+  /**
+   * @return The sample rate of the file.
+   */
+  size_t SampleRate() const { return sample_rate_; }
+
+  /**
+   * @return The number of mono samples in the file.
+   */
+  size_t NumSamples() const { return num_samples_; }
+
+  /**
+   * Read a range of the mono samples of the file. The range must not start
+   * before the range of the previous call, and the samples before it are
+   * dropped. The part of the range that lies outside of the file is left out
+   * of the signal.
+   *
+   * @param first_sample The first sample of the range. This may be negative.
+   * @param num_samples The number of samples in the range.
+   * @param signal_first_sample Set to the sample of the file that the first
+   *    sample of the signal is.
+   *
+   * @return The samples of the range that lie inside the file.
+   */
+  AudioSignal Read(int64_t first_sample, size_t num_samples,
+                   int64_t *signal_first_sample);
+
+ private:
+  std::ifstream file_;
+  std::unique_ptr<WavReader> reader_;
+  size_t sample_rate_ = 0;
+  size_t num_samples_ = 0;
+
+  /**
+   * The samples that have been read and not dropped yet.
+   */
+  std::vector<double> buffer_;
+
+  /**
+   * The sample of the file that the first sample of the buffer is.
+   */
+  int64_t buffer_first_sample_ = 0;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_WAV_TILE_READER_H
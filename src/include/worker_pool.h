@@ -0,0 +1,94 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_WORKER_POOL_H
+#define VISQOL_INCLUDE_WORKER_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace Visqol {
+/**
+ * A fixed set of threads that run jobs from a shared queue.
+ *
+ * The ParallelExecutor and the TaskGraph take their extra workers from the
+ * shared pool rather than starting threads of their own, so the workers of
+ * a batch, the stages of a pair and the patches of a comparison all run on
+ * the same threads. A worker budget nested inside another is then only
+ * filled by threads of the pool that are idle, and the process runs at most
+ * one thread per core, plus the threads that called into the pool, however
+ * the budgets are nested.
+ */
+class WorkerPool {
+ public:
+  /**
+   * Starts the threads of the pool.
+   *
+   * @param num_threads The number of threads of the pool. A pool without
+   *    threads never runs the jobs that are submitted to it.
+   */
+  explicit WorkerPool(size_t num_threads);
+
+  /**
+   * Runs the jobs that are already queued, and stops the threads.
+   */
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  /**
+   * @return The pool that is shared by the whole process, with one thread
+   *    less than the number of cores, as the thread that submits the jobs
+   *    works on them too.
+   */
+  static WorkerPool &Shared();
+
+  /**
+   * Queue a job to run on the first thread of the pool that is idle. The
+   * jobs are run in the order that they were submitted. A job may be started
+   * long after it was submitted, so it must hold the state that it reads.
+   *
+   * @param job The job to run.
+   */
+  void Submit(std::function<void()> job);
+
+  /**
+   * @return The number of threads of the pool.
+   */
+  size_t NumThreads() const { return threads_.size(); }
+
+ private:
+  /**
+   * Run queued jobs until the pool is stopped.
+   */
+  void RunJobs();
+
+  bool HasJobOrIsStopping() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  std::deque<std::function<void()>> jobs_ ABSL_GUARDED_BY(mutex_);
+  bool is_stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  std::vector<std::thread> threads_;
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_WORKER_POOL_H
@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "amatrix.h"
+#include "audio_channel.h"
 #include "fast_fourier_transform.h"
 
 namespace Visqol {
@@ -31,6 +32,13 @@ namespace Visqol {
  */
 class XCorr {
  public:
+  /**
+   * The estimated cost of an FFT point, relative to a multiply-add of the
+   * direct correlation, per level of the FFT. Used to choose between the
+   * direct and the overlap-save correlation in CalcBestLagWithin.
+   */
+  static const double kFftPointCost;
+
   /**
    * Using cross correlation, calculate the best lag value between the two
    * signals. The lag describes how many samples one signal lags behind the
@@ -46,38 +54,170 @@ class XCorr {
   static int64_t CalcBestLag(const AMatrix<double> &signal_1,
                              const AMatrix<double> &signal_2);
 
- private:
   /**
-   * Helper function used to calculate the inverse fft of the result of the
-   * pointwise product of the two signal's forward fft.
+   * Calculate the best lag of each pair in a batch of signal pairs, exactly as
+   * CalcBestLag does for each pair. The pairs whose correlations have the same
+   * FFT size are transformed with one FFT manager and one set of buffers,
+   * rather than setting up and allocating them for every pair.
    *
-   * These two fft operations are split over these functions to shorten the
-   * lifespan of these variables to reduce peak memory consumption.
+   * @param signals_1 The first signal of each pair.
+   * @param signals_2 The second signal of each pair.
    *
-   * @param signal_1 The first signal to be processed.
-   * @param signal_1 The second signal to be processed.
+   * @return The best lag of each pair.
+   */
+  static std::vector<int64_t> CalcBestLags(
+      const std::vector<AMatrix<double>> &signals_1,
+      const std::vector<AMatrix<double>> &signals_2);
+
+  /**
+   * Calculate the number of FFT points needed to cross correlate two signals
+   * whose longest length is the given number of samples, without the
+   * correlations of positive and negative lags overlapping.
+   *
+   * @param num_samples The length of the longest of the two signals.
+   *
+   * @return The number of FFT points, a power of 2.
+   */
+  static size_t CalcFftPoints(size_t num_samples);
+
+  /**
+   * Circularly reverse a signal in time within an FFT of the given size. The
+   * spectrum of the reversed signal is the conjugate of the spectrum of the
+   * signal.
+   *
+   * @param signal The signal to reverse. It must not be longer than the FFT.
+   * @param fft_size The FFT size.
+   *
+   * @return The reversed signal, zero padded to the FFT size.
+   */
+  static std::vector<double> CircularlyReverse(
+      const std::vector<double> &signal, size_t fft_size);
+
+  /**
+   * Find the best lag in the output of a circular cross correlation. Negative
+   * lags wrap around to the end of the correlations. If several lags have the
+   * same correlation, the most negative of them is returned.
    *
-   * @return The inverse fft of the pointwise product of the two signal's
-   *    forward fft.
+   * @param corrs The correlations, as returned by the inverse FFT of the
+   *    cross spectrum.
+   * @param max_lag The largest lag, positive or negative, to consider.
+   *
+   * @return The lag with the highest correlation.
    */
-  static std::vector<double> CalcInverseFFTPwiseProd(
-      const AMatrix<double>& signal_1, const AMatrix<double>& signal_2);
+  static int64_t FindBestLag(const std::vector<double> &corrs,
+                             int64_t max_lag);
 
   /**
-   * Helper function used to the pointwise product of the two signal's forward
-   * fft.
+   * Calculate the best lag between two signals by correlating them directly
+   * in the time domain, only at the lags in the given range. The lag has the
+   * same meaning as for CalcBestLag. This is cheaper than the FFT when the
+   * range is small.
    *
-   * These two fft operations are split over these functions to shorten the
-   * lifespan of these variables to reduce peak memory consumption.
+   * @param signal_1 The first signal in the pair of signals to be correlated.
+   * @param signal_2 The second signal in the pair of signals to be correlated.
+   * @param min_lag The smallest lag to consider.
+   * @param max_lag The largest lag to consider.
+   *
+   * @return The lag in the range with the highest correlation. If several
+   *    lags have the same correlation, the smallest of them is returned.
+   */
+  static int64_t CalcBestLagInRange(const std::vector<double> &signal_1,
+                                    const std::vector<double> &signal_2,
+                                    int64_t min_lag, int64_t max_lag);
+
+  /**
+   * Using cross correlation, calculate the best lag value between the two
+   * signals, only considering lags of up to the given magnitude. The lag has
+   * the same meaning as for CalcBestLag.
+   *
+   * The correlations are computed directly in the time domain when the lag
+   * range is small, and by overlap-save FFT correlation otherwise. The FFT is
+   * then sized for the lag range rather than for the length of the signals.
+   *
+   * @param signal_1 The first signal in the pair of signals to be correlated.
+   * @param signal_2 The second signal in the pair of signals to be correlated.
+   * @param max_lag The largest magnitude of the lags to consider.
+   *
+   * @return The lag in the range with the highest correlation. If several
+   *    lags have the same correlation, the smallest of them is returned.
+   */
+  static int64_t CalcBestLagWithin(const AMatrix<double> &signal_1,
+                                   const AMatrix<double> &signal_2,
+                                   int64_t max_lag);
+
+ private:
+  /**
+   * Calculate the best lag of up to the given magnitude by overlap-save FFT
+   * correlation. The second signal is split into blocks, and the cross
+   * spectra of each block with the matching segment of the first signal are
+   * accumulated, so that a single inverse FFT gives all the correlations.
    *
    * @param signal_1 The first signal to be processed.
-   * @param signal_1 The second signal to be processed.
+   * @param signal_2 The second signal to be processed.
+   * @param max_lag The largest magnitude of the lags to consider.
+   * @param fft_points The number of FFT points. It must be at least twice the
+   *    max lag plus one.
    *
-   * @return The pointwise product of the two signal's forward fft.
+   * @return The lag in the range with the highest correlation.
+   */
+  static int64_t CalcBestLagOverlapSave(const std::vector<double> &signal_1,
+                                        const std::vector<double> &signal_2,
+                                        int64_t max_lag, size_t fft_points);
+
+  /**
+   * The buffers of a circular cross correlation at one FFT size. They are
+   * allocated once and reused for every pair of signals that is correlated at
+   * that size.
+   */
+  struct CorrelationBuffers {
+    /**
+     * @param fft_size The FFT size of the manager that the buffers are used
+     *    with.
+     */
+    explicit CorrelationBuffers(size_t fft_size);
+
+    /**
+     * The zero padded time domain input of each forward FFT, and the output
+     * of the inverse FFT.
+     */
+    AudioChannel time_buffer;
+
+    /**
+     * The half spectrum of the first signal.
+     */
+    AudioChannel spectrum_1;
+
+    /**
+     * The half spectrum of the circularly reversed second signal.
+     */
+    AudioChannel spectrum_2;
+
+    /**
+     * The pointwise product of the two spectra.
+     */
+    AudioChannel pwise_prod;
+  };
+
+  /**
+   * Calculate the circular cross correlation of two signals, as the inverse
+   * FFT of the pointwise product of the first signal's forward FFT with the
+   * conjugate of the second signal's forward FFT. The signals are written
+   * straight into the reused buffers, the second one circularly reversed, so
+   * that nothing is allocated per pair.
+   *
+   * @param signal_1 The first signal to be processed.
+   * @param signal_2 The second signal to be processed.
+   * @param fft_manager The manager required for performing the FFT. Its FFT
+   *    size must be at least CalcFftPoints of the longest signal.
+   * @param buffers The buffers of the FFT size of the manager.
+   * @param corrs The correlations are written here, one per FFT point. It
+   *    must have the FFT size of the manager.
    */
-  static AMatrix<std::complex<double>> CalcFFTPwiseProd(
-      const std::vector<double> &signal_1, const std::vector<double> &signal_2,
-      const std::unique_ptr<FftManager>& fft_manager, const size_t fft_points);
+  static void CalcCorrelations(const AMatrix<double> &signal_1,
+                               const AMatrix<double> &signal_2,
+                               const std::unique_ptr<FftManager> &fft_manager,
+                               CorrelationBuffers *buffers,
+                               std::vector<double> *corrs);
 };
 }  // namespace Visqol
 
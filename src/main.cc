@@ -12,12 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include "batch_runner.h"
 #include "commandline_parser.h"
+#include "file_path.h"
+#include "metrics.h"
 #include "sim_results_writer.h"
+#include "trace_writer.h"
+#include "training_data_writer.h"
 #include "visqol_manager.h"
 
 int main(int argc, char **argv) {
@@ -29,28 +39,85 @@ int main(int argc, char **argv) {
     return -1;
   }
   Visqol::CommandLineArgs cmd_args = parse_statusor.ValueOrDie();
-  auto files_to_compare = Visqol::VisqolCommandLineParser::BuildFilePairPaths(
+  // A streamed batch is compared as its pairs are discovered, and any other
+  // batch is read whole up front.
+  auto pair_source = Visqol::VisqolCommandLineParser::BuildPairSource(
       cmd_args);
+  std::vector<Visqol::ReferenceDegradedPathPair> files_to_compare;
+  if (pair_source == nullptr) {
+    files_to_compare = Visqol::VisqolCommandLineParser::BuildFilePairPaths(
+        cmd_args);
+  }
 
-  // Init ViSQOL.
-  Visqol::VisqolManager visqol;
-  auto init_status = visqol.Init(cmd_args.sim_to_quality_mapper_model,
-      cmd_args.use_speech_mode,
-      cmd_args.use_unscaled_speech_mos_mapping);
-  if (!init_status.ok()) {
-    ABSL_RAW_LOG(ERROR, "%s",
-        init_status.error_message().ToString().c_str());
+  // Init ViSQOL and run it on each worker thread, writing each result as it
+  // completes.
+  Visqol::SimilarityResultsStream results_stream(
+      cmd_args.verbose, cmd_args.results_output_csv, cmd_args.debug_output_path,
+      cmd_args.use_speech_mode, !cmd_args.unordered_results,
+      Visqol::FilePath(cmd_args.results_proto),
+      Visqol::FilePath(cmd_args.results_arrow));
+  // The training data, if requested, is written next to the results.
+  std::unique_ptr<Visqol::TrainingDataWriter> training_data;
+  if (!cmd_args.training_data_output.empty()) {
+    training_data = absl::make_unique<Visqol::TrainingDataWriter>(
+        cmd_args.training_data_output,
+        Visqol::TrainingDataWriter::ReadTargets(cmd_args.batch_input_csv));
+  }
+  if (!cmd_args.trace_output.empty()) {
+    Visqol::TraceWriter::Start();
+  }
+  Visqol::MetricsRegistry metrics;
+  if (!cmd_args.metrics_output.empty()) {
+    Visqol::Metrics::SetSink(&metrics);
+  }
+  const Visqol::VisqolManager::ResultHandler handler =
+      [&results_stream, &training_data](size_t i,
+          google::protobuf::util::StatusOr<Visqol::SimilarityResultMsg>
+              &&status_or) {
+        if (status_or.ok()) {
+          results_stream.Write(i, status_or.ValueOrDie());
+          if (training_data != nullptr) {
+            training_data->Write(i, status_or.ValueOrDie());
+          }
+        } else {
+          results_stream.Skip(i);
+          if (training_data != nullptr) {
+            training_data->Skip(i);
+          }
+        }
+      };
+  const auto options = Visqol::VisqolCommandLineParser::BuildVisqolOptions(
+      cmd_args);
+  auto run_status = pair_source != nullptr ?
+      Visqol::BatchRunner::StreamFrom(cmd_args.sim_to_quality_mapper_model,
+          options, pair_source.get(), cmd_args.num_threads, handler) :
+      Visqol::BatchRunner::Stream(cmd_args.sim_to_quality_mapper_model,
+          options, files_to_compare, cmd_args.num_threads, handler,
+          cmd_args.verbose);
+  if (!run_status.ok()) {
+    ABSL_RAW_LOG(ERROR, "%s", run_status.error_message().ToString().c_str());
     return -1;
   }
-
-  // Run ViSQOL.
-  auto sim_result_msgs = visqol.Run(files_to_compare);
-
-  // Write the results.
-  for (auto sim_result_msg : sim_result_msgs) {
-    Visqol::SimilarityResultsWriter::Write(
-        cmd_args.verbose, cmd_args.results_output_csv, cmd_args.debug_output_path,
-        sim_result_msg, cmd_args.use_speech_mode);
+  results_stream.Flush();
+  if (!cmd_args.trace_output.empty() &&
+      !Visqol::TraceWriter::StopAndWrite(cmd_args.trace_output)) {
+    ABSL_RAW_LOG(ERROR, "Error writing the trace to %s.",
+                 cmd_args.trace_output.c_str());
+    return -1;
+  }
+  if (!cmd_args.metrics_output.empty()) {
+    Visqol::Metrics::SetSink(nullptr);
+    if (!metrics.WriteToFile(cmd_args.metrics_output,
+                             cmd_args.prometheus_metrics)) {
+      ABSL_RAW_LOG(ERROR, "Error writing the metrics to %s.",
+                   cmd_args.metrics_output.c_str());
+      return -1;
+    }
+  }
+  if (training_data != nullptr && !training_data->Flush()) {
+    ABSL_RAW_LOG(ERROR, "Error writing the training data to %s.",
+                 cmd_args.training_data_output.c_str());
+    return -1;
   }
 
   return 0;
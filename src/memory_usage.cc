@@ -0,0 +1,109 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "memory_usage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Visqol {
+namespace {
+// The counter of the calling thread. Constant initialized, so the counting
+// allocator can read it before any other initialization of the thread.
+thread_local AllocationCounter *current_counter = nullptr;
+
+std::atomic<bool> hooked(false);
+}  // namespace
+
+AllocationCounter::ThreadScope::ThreadScope(AllocationCounter *counter)
+    : previous_(current_counter) {
+  current_counter = counter;
+}
+
+AllocationCounter::ThreadScope::~ThreadScope() {
+  current_counter = previous_;
+}
+
+AllocationCounter::AllocationCounter(MemoryUsage *usage)
+    : usage_(usage), previous_(nullptr) {
+  if (usage_ != nullptr) {
+    previous_ = current_counter;
+    current_counter = this;
+  }
+}
+
+AllocationCounter::~AllocationCounter() { Stop(); }
+
+void AllocationCounter::Stop() {
+  if (usage_ == nullptr) {
+    return;
+  }
+  current_counter = previous_;
+  usage_->bytes_allocated += bytes_allocated_.load(std::memory_order_relaxed);
+  usage_->num_allocations += num_allocations_.load(std::memory_order_relaxed);
+  usage_->peak_rss_kb = PeakRssKb();
+  usage_ = nullptr;
+}
+
+AllocationCounter *AllocationCounter::Current() { return current_counter; }
+
+void AllocationCounter::RecordAllocation(size_t size) {
+  AllocationCounter *counter = current_counter;
+  if (counter != nullptr) {
+    counter->bytes_allocated_.fetch_add(size, std::memory_order_relaxed);
+    counter->num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool AllocationCounter::MarkHooked() {
+  hooked.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+bool AllocationCounter::IsHooked() {
+  return hooked.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::PeakRssKb() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                            sizeof(counters))) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  // macOS reports the peak in bytes.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+}  // namespace Visqol
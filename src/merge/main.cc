@@ -0,0 +1,88 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Merges the outputs of the shards of a batch that was split with
+// --num_shards and --shard_index.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "file_path.h"
+#include "results_merger.h"
+
+ABSL_FLAG(std::string, shard_results_csvs, "",
+"A comma separated list of the --results_csv files of the shards.");
+ABSL_FLAG(std::string, merged_results_csv, "",
+"The path to write the merged results CSV file to.");
+ABSL_FLAG(std::string, shard_debug_outputs, "",
+"A comma separated list of the --output_debug files of the shards.");
+ABSL_FLAG(std::string, merged_debug_output, "",
+"The path to write the merged debug JSON file to.");
+ABSL_FLAG(std::string, batch_order_csv, "",
+"The --batch_input_csv that was split into the shards. If given, the merged\n"
+"results are written in the order of its pairs.");
+
+namespace {
+std::vector<Visqol::FilePath> SplitPaths(const std::string &paths) {
+  std::vector<Visqol::FilePath> split;
+  std::istringstream in(paths);
+  std::string path;
+  while (std::getline(in, path, ',')) {
+    if (!path.empty()) {
+      split.push_back(path);
+    }
+  }
+  return split;
+}
+
+bool LogIfError(const google::protobuf::util::Status &status) {
+  if (!status.ok()) {
+    ABSL_RAW_LOG(ERROR, "%s", status.error_message().ToString().c_str());
+  }
+  return !status.ok();
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  const std::string merged_results_csv = absl::GetFlag(
+      FLAGS_merged_results_csv);
+  const std::string merged_debug_output = absl::GetFlag(
+      FLAGS_merged_debug_output);
+  if (merged_results_csv.empty() && merged_debug_output.empty()) {
+    ABSL_RAW_LOG(ERROR, "Nothing to merge. Set --merged_results_csv or"
+                 " --merged_debug_output.");
+    return -1;
+  }
+
+  if (!merged_results_csv.empty() && LogIfError(
+      Visqol::ResultsMerger::MergeResultsCSVs(
+          SplitPaths(absl::GetFlag(FLAGS_shard_results_csvs)),
+          absl::GetFlag(FLAGS_batch_order_csv), merged_results_csv))) {
+    return -1;
+  }
+  if (!merged_debug_output.empty() && LogIfError(
+      Visqol::ResultsMerger::ConcatenateFiles(
+          SplitPaths(absl::GetFlag(FLAGS_shard_debug_outputs)),
+          merged_debug_output))) {
+    return -1;
+  }
+  return 0;
+}
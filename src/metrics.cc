@@ -0,0 +1,246 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace Visqol {
+namespace {
+std::atomic<MetricsSink *> metrics_sink(nullptr);
+
+const char *const kErrorCodeNames[] = {
+    "OK", "CANCELLED", "UNKNOWN", "INVALID_ARGUMENT", "DEADLINE_EXCEEDED",
+    "NOT_FOUND", "ALREADY_EXISTS", "PERMISSION_DENIED", "RESOURCE_EXHAUSTED",
+    "FAILED_PRECONDITION", "ABORTED", "OUT_OF_RANGE", "UNIMPLEMENTED",
+    "INTERNAL", "UNAVAILABLE", "DATA_LOSS", "UNAUTHENTICATED",
+};
+
+// Format labels as name="value" pairs, escaping the values as the
+// Prometheus text format does.
+std::string JoinLabels(const MetricLabels &labels) {
+  std::string joined;
+  for (const auto &label : labels) {
+    if (!joined.empty()) {
+      joined += ",";
+    }
+    joined += label.first + "=\"";
+    for (const char c : label.second) {
+      if (c == '\\' || c == '"') {
+        joined += '\\';
+        joined += c;
+      } else if (c == '\n') {
+        joined += "\\n";
+      } else {
+        joined += c;
+      }
+    }
+    joined += "\"";
+  }
+  return joined;
+}
+}  // namespace
+
+void Metrics::SetSink(MetricsSink *sink) {
+  metrics_sink.store(sink, std::memory_order_release);
+}
+
+bool Metrics::IsEnabled() {
+  return metrics_sink.load(std::memory_order_acquire) != nullptr;
+}
+
+void Metrics::IncrementCounter(const std::string &name,
+                               const MetricLabels &labels, uint64_t delta) {
+  MetricsSink *const sink = metrics_sink.load(std::memory_order_acquire);
+  if (sink != nullptr) {
+    sink->IncrementCounter(name, labels, delta);
+  }
+}
+
+void Metrics::ObserveLatency(const std::string &name,
+                             const MetricLabels &labels, double seconds) {
+  MetricsSink *const sink = metrics_sink.load(std::memory_order_acquire);
+  if (sink != nullptr) {
+    sink->ObserveLatency(name, labels, seconds);
+  }
+}
+
+void Metrics::ReportPair(int error_code, double seconds) {
+  if (!IsEnabled()) {
+    return;
+  }
+  IncrementCounter("visqol_pairs_total",
+                   {{"code", ErrorCodeName(error_code)}});
+  ObserveLatency("visqol_pair_seconds", {}, seconds);
+}
+
+void Metrics::ReportStage(const char *stage, double seconds) {
+  if (IsEnabled()) {
+    ObserveLatency("visqol_stage_seconds", {{"stage", stage}}, seconds);
+  }
+}
+
+void Metrics::ReportDroppedPatches(size_t num_patches) {
+  if (IsEnabled()) {
+    IncrementCounter("visqol_dropped_patches_total", {}, num_patches);
+  }
+}
+
+void Metrics::ReportReferenceCacheLookup(bool hit) {
+  if (IsEnabled()) {
+    IncrementCounter("visqol_reference_cache_lookups_total",
+                     {{"result", hit ? "hit" : "miss"}});
+  }
+}
+
+void Metrics::ReportResultCacheLookup(bool hit) {
+  if (IsEnabled()) {
+    IncrementCounter("visqol_result_cache_lookups_total",
+                     {{"result", hit ? "hit" : "miss"}});
+  }
+}
+
+void Metrics::ReportServerRequest(int error_code, double seconds) {
+  if (!IsEnabled()) {
+    return;
+  }
+  IncrementCounter("visqol_server_requests_total",
+                   {{"code", ErrorCodeName(error_code)}});
+  ObserveLatency("visqol_server_request_seconds", {}, seconds);
+}
+
+const char *Metrics::ErrorCodeName(int code) {
+  const int num_codes = sizeof(kErrorCodeNames) / sizeof(kErrorCodeNames[0]);
+  return code >= 0 && code < num_codes ? kErrorCodeNames[code] : "UNKNOWN";
+}
+
+const std::vector<double> MetricsRegistry::kLatencyBuckets = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0,
+    10.0, 25.0, 60.0, 150.0, 300.0};
+
+void MetricsRegistry::IncrementCounter(const std::string &name,
+                                       const MetricLabels &labels,
+                                       uint64_t delta) {
+  const std::string joined = JoinLabels(labels);
+  absl::MutexLock lock(&mutex_);
+  counters_[name][joined] += delta;
+}
+
+void MetricsRegistry::ObserveLatency(const std::string &name,
+                                     const MetricLabels &labels,
+                                     double seconds) {
+  const std::string joined = JoinLabels(labels);
+  const size_t bucket = std::lower_bound(kLatencyBuckets.begin(),
+      kLatencyBuckets.end(), seconds) - kLatencyBuckets.begin();
+  absl::MutexLock lock(&mutex_);
+  Histogram &histogram = histograms_[name][joined];
+  histogram.bucket_counts[bucket]++;
+  histogram.count++;
+  histogram.sum += seconds;
+  histogram.max = std::max(histogram.max, seconds);
+}
+
+std::string MetricsRegistry::FormatLabels(const std::string &labels,
+                                          const std::string &extra_label) {
+  if (labels.empty() && extra_label.empty()) {
+    return "";
+  }
+  const std::string separator =
+      !labels.empty() && !extra_label.empty() ? "," : "";
+  return "{" + labels + separator + extra_label + "}";
+}
+
+std::string MetricsRegistry::FormatText() const {
+  absl::MutexLock lock(&mutex_);
+  std::stringstream ss;
+  for (const auto &counter : counters_) {
+    for (const auto &series : counter.second) {
+      ss << counter.first << FormatLabels(series.first, "") << " "
+         << series.second << "\n";
+    }
+  }
+  for (const auto &histogram : histograms_) {
+    for (const auto &series : histogram.second) {
+      const Histogram &values = series.second;
+      ss << histogram.first << FormatLabels(series.first, "")
+         << " count=" << values.count
+         << " mean=" << (values.count > 0 ? values.sum / values.count : 0.0)
+         << " max=" << values.max << "\n";
+    }
+  }
+  return ss.str();
+}
+
+std::string MetricsRegistry::FormatPrometheus() const {
+  absl::MutexLock lock(&mutex_);
+  std::stringstream ss;
+  for (const auto &counter : counters_) {
+    ss << "# TYPE " << counter.first << " counter\n";
+    for (const auto &series : counter.second) {
+      ss << counter.first << FormatLabels(series.first, "") << " "
+         << series.second << "\n";
+    }
+  }
+  for (const auto &histogram : histograms_) {
+    const std::string &name = histogram.first;
+    ss << "# TYPE " << name << " histogram\n";
+    for (const auto &series : histogram.second) {
+      const Histogram &values = series.second;
+      // The buckets of the Prometheus format are cumulative.
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b <= kLatencyBuckets.size(); b++) {
+        cumulative += values.bucket_counts[b];
+        std::stringstream le;
+        if (b < kLatencyBuckets.size()) {
+          le << "le=\"" << kLatencyBuckets[b] << "\"";
+        } else {
+          le << "le=\"+Inf\"";
+        }
+        ss << name << "_bucket" << FormatLabels(series.first, le.str())
+           << " " << cumulative << "\n";
+      }
+      ss << name << "_sum" << FormatLabels(series.first, "") << " "
+         << values.sum << "\n";
+      ss << name << "_count" << FormatLabels(series.first, "") << " "
+         << values.count << "\n";
+    }
+  }
+  return ss.str();
+}
+
+bool MetricsRegistry::WriteToFile(const std::string &path,
+                                  bool prometheus) const {
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios_base::binary);
+    out << (prometheus ? FormatPrometheus() : FormatText());
+    if (!out) {
+      return false;
+    }
+  }
+  return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+}  // namespace Visqol
@@ -20,12 +20,12 @@
 #include <cmath>
 #include <fstream>
 #include <memory>
-#include <sstream>
 #include <utility>
 #include <vector>
 
 #include "absl/base/internal/raw_logging.h"
 
+#include "audio_decoder.h"
 #include "wav_reader.h"
 
 namespace Visqol {
@@ -38,20 +38,60 @@ const double kNoiseFloorAbsoluteDb = -45.;
 
 AudioSignal MiscAudio::ScaleToMatchSoundPressureLevel(
     const AudioSignal &reference, const AudioSignal &degraded) {
+  AudioSignal scaled_sig = degraded;
+  ScaleToMatchSoundPressureLevel(reference, &scaled_sig);
+  return scaled_sig;
+}
+
+void MiscAudio::ScaleToMatchSoundPressureLevel(const AudioSignal &reference,
+                                               AudioSignal *degraded) {
   const double ref_spl = MiscAudio::CalcSoundPressureLevel(reference);
-  const double deg_spl = MiscAudio::CalcSoundPressureLevel(degraded);
+  const double deg_spl = MiscAudio::CalcSoundPressureLevel(*degraded);
   const double scale_factor = std::pow(10, (ref_spl - deg_spl) / 20);
-  const auto scaled_mat = degraded.data_matrix * scale_factor;
-  AudioSignal scaled_sig{std::move(scaled_mat), degraded.sample_rate};
-  return scaled_sig;
+  for (double &sample : degraded->data_matrix) {
+    sample *= scale_factor;
+  }
+}
+
+bool MiscAudio::MatchesAfterScaling(const AudioSignal &reference,
+                                    const AudioSignal &degraded,
+                                    double tolerance) {
+  const auto &ref_matrix = reference.data_matrix;
+  const auto &deg_matrix = degraded.data_matrix;
+  if (reference.sample_rate != degraded.sample_rate ||
+      ref_matrix.NumRows() != deg_matrix.NumRows() ||
+      ref_matrix.NumCols() != deg_matrix.NumCols()) {
+    return false;
+  }
+  const double *ref_samples = ref_matrix.data();
+  const double *deg_samples = deg_matrix.data();
+  const size_t num_samples = ref_matrix.NumElements();
+  // Bit-identical signals are found without computing their levels.
+  if (std::equal(ref_samples, ref_samples + num_samples, deg_samples)) {
+    return true;
+  }
+  const double ref_spl = CalcSoundPressureLevel(reference);
+  const double deg_spl = CalcSoundPressureLevel(degraded);
+  const double scale_factor = std::pow(10, (ref_spl - deg_spl) / 20);
+  for (size_t i = 0; i < num_samples; i++) {
+    // Written so that a NaN sample does not match.
+    if (!(std::abs(deg_samples[i] * scale_factor - ref_samples[i]) <=
+          tolerance)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 double MiscAudio::CalcSoundPressureLevel(const AudioSignal &signal) {
   const auto &data_matrix = signal.data_matrix;
+  const double *samples = data_matrix.data();
+  const size_t num_samples = data_matrix.NumElements();
   double sum = 0;
-  std::for_each(data_matrix.cbegin(), data_matrix.cend(),
-           [&](const double &datum) { sum += std::pow(datum, 2); });
-  const double sound_pressure = std::sqrt(sum / data_matrix.NumElements());
+  for (size_t i = 0; i < num_samples; i++) {
+    sum += samples[i] * samples[i];
+  }
+  const double sound_pressure = std::sqrt(sum / num_samples);
   return 20 * std::log10(sound_pressure / kSplReferencePoint);
 }
 
@@ -66,7 +106,8 @@ AMatrix<double> MiscAudio::ToMono(const AMatrix<double> &signal) {
         mono_mat(sample_i, 0) += signal(sample_i, chan_i);
       }
     }
-    return mono_mat / signal.NumCols();
+    mono_mat /= signal.NumCols();
+    return mono_mat;
   } else {
     return signal;
   }
@@ -76,7 +117,7 @@ AMatrix<double> MiscAudio::ToMono(const AMatrix<double> &signal) {
 AudioSignal MiscAudio::ToMono(const AudioSignal &signal) {
   // If already Mono, nothing to do.
   if (signal.data_matrix.NumCols() > kNumChanMono) {
-    const AMatrix<double> sig_mid_mat(MiscAudio::ToMono(signal.data_matrix));
+    AMatrix<double> sig_mid_mat(MiscAudio::ToMono(signal.data_matrix));
     AudioSignal sig_mid;
     sig_mid.data_matrix = std::move(sig_mid_mat);
     sig_mid.sample_rate = signal.sample_rate;
@@ -87,40 +128,87 @@ AudioSignal MiscAudio::ToMono(const AudioSignal &signal) {
 }
 
 AudioSignal MiscAudio::LoadAsMono(const FilePath &path) {
+  const AudioDecoder *decoder = AudioDecoderRegistry::Find(path);
+  if (decoder != nullptr) {
+    return decoder->Decode(path, true);
+  }
   AudioSignal sig;
+  // The samples are decoded straight from the file into the mono signal, so
+  // they are only held in memory once.
   std::ifstream wav_file(path.Path().c_str(), std::ios::binary);
   if (wav_file) {
-    std::stringstream wav_string_stream;
-    wav_string_stream << wav_file.rdbuf();
-    wav_file.close();
-
-    WavReader wav_reader(&wav_string_stream);
+    WavReader wav_reader(&wav_file);
     const size_t num_total_samples = wav_reader.GetNumTotalSamples();
 
     if (wav_reader.IsHeaderValid() && num_total_samples != 0) {
-      std::vector<int16_t> interleaved_samples(num_total_samples);
-      const auto num_samp_read = wav_reader.ReadSamples(num_total_samples,
-                                                      &interleaved_samples[0]);
+      const size_t num_channels = wav_reader.GetNumChannels();
+      const size_t num_frames = num_total_samples / num_channels;
+      AMatrix<double> samples(num_frames, 1);
+      const auto num_frames_read = wav_reader.ReadMonoSamples(num_frames,
+          samples.mutData());
 
       // Certain wav files are 'mostly valid' and have a slight difference with
-      // the reported file length.  Warn for these.
-      if (num_samp_read != num_total_samples) {
+      // the reported file length.  Warn for these. The missing samples are
+      // silent.
+      if (num_frames_read != num_frames) {
+        ABSL_RAW_LOG(WARNING,
+                     "Number of samples read (%lu) was less than the expected"
+                     " number (%lu).",
+                     num_frames_read * num_channels, num_total_samples);
+        std::fill(samples.mutData() + num_frames_read,
+                  samples.mutData() + num_frames, kZeroSample);
+      }
+      if (num_frames_read > 0) {
+        sig.data_matrix = std::move(samples);
+        sig.sample_rate = wav_reader.GetSampleRateHz();
+      } else {
+        ABSL_RAW_LOG(ERROR,
+                 "Error reading data for file %s.", path.Path().c_str());
+      }
+    } else {
+      ABSL_RAW_LOG(ERROR,
+                 "Error reading header for file %s.", path.Path().c_str());
+    }
+
+  } else {
+    ABSL_RAW_LOG(ERROR,
+                 "Could not find file %s.", path.Path().c_str());
+  }
+
+  return sig;
+}
+
+AudioSignal MiscAudio::LoadChannels(const FilePath &path) {
+  const AudioDecoder *decoder = AudioDecoderRegistry::Find(path);
+  if (decoder != nullptr) {
+    return decoder->Decode(path, false);
+  }
+  AudioSignal sig;
+  std::ifstream wav_file(path.Path().c_str(), std::ios::binary);
+  if (wav_file) {
+    WavReader wav_reader(&wav_file);
+    const size_t num_total_samples = wav_reader.GetNumTotalSamples();
+
+    if (wav_reader.IsHeaderValid() && num_total_samples != 0) {
+      const size_t num_channels = wav_reader.GetNumChannels();
+      const size_t num_frames = num_total_samples / num_channels;
+      // The matrix is column major, so each channel is decoded straight into
+      // its column.
+      auto samples = AMatrix<double>::Filled(num_frames, num_channels,
+                                             kZeroSample);
+      const auto num_frames_read = wav_reader.ReadChannels(num_frames,
+          samples.mutData());
+
+      // The missing samples of 'mostly valid' files are left silent.
+      if (num_frames_read != num_frames) {
         ABSL_RAW_LOG(WARNING,
                      "Number of samples read (%lu) was less than the expected"
                      " number (%lu).",
-                     num_samp_read, num_total_samples);
+                     num_frames_read * num_channels, num_total_samples);
       }
-      if (num_samp_read > 0) {
-        const auto interleaved_norm_vec = MiscMath::NormalizeInt16ToDouble(
-            interleaved_samples);
-        const auto multi_chan_norm_vec = ExtractMultiChannel(
-            wav_reader.GetNumChannels(),
-            interleaved_norm_vec);
-
-        const AMatrix<double> outMat(multi_chan_norm_vec);
-        sig.data_matrix = outMat;
+      if (num_frames_read > 0) {
+        sig.data_matrix = std::move(samples);
         sig.sample_rate = wav_reader.GetSampleRateHz();
-        sig = MiscAudio::ToMono(sig);
       } else {
         ABSL_RAW_LOG(ERROR,
                  "Error reading data for file %s.", path.Path().c_str());
@@ -159,23 +247,31 @@ std::vector<std::vector<double>> MiscAudio::ExtractMultiChannel(
 
 void MiscAudio::PrepareSpectrogramsForComparison(
     Spectrogram &reference, Spectrogram &degraded) {
-  reference.ConvertToDb();
-  degraded.ConvertToDb();
-
-  // An absolute threshold is also applied.
-  reference.RaiseFloor(kNoiseFloorAbsoluteDb);
-  degraded.RaiseFloor(kNoiseFloorAbsoluteDb);
-  // Apply a per-frame relative threshold.
+  // Convert to dB and apply an absolute threshold and a per-frame relative
+  // threshold, in a single sweep over the frames of both spectrograms.
   // Note that this is not an STFT spectrogram, the spectrogram bins
   // here are each the RMS of a band filter output on the time domain signal.
-  reference.RaiseFloorPerFrame(kNoiseFloorRelativeToPeakDb,
-                               degraded);
+  double lowest_floor = reference.ConvertToDbAndRaiseFloors(
+      kNoiseFloorAbsoluteDb, kNoiseFloorRelativeToPeakDb, degraded);
+
   // Normalize to a 0dB global floor (which is probably kNoiseFloorAbsoluteDb).
-  double ref_floor = reference.Minimum();
-  double deg_floor = degraded.Minimum();
-  double lowest_floor = std::min(ref_floor, deg_floor);
 
   reference.SubtractFloor(lowest_floor);
   degraded.SubtractFloor(lowest_floor);
 }
+
+bool MiscAudio::PrepareSpectrogramColumnsForComparison(
+    Spectrogram &reference, Spectrogram &degraded,
+    const SpectrogramColumnRanges &columns) {
+  const double lowest_floor = reference.ConvertToDbAndRaiseFloors(
+      kNoiseFloorAbsoluteDb, kNoiseFloorRelativeToPeakDb, degraded, &columns);
+  // No column can be below the absolute floor, so the global floor is only
+  // known if the prepared columns reach it.
+  if (lowest_floor != kNoiseFloorAbsoluteDb) {
+    return false;
+  }
+  reference.SubtractFloor(lowest_floor);
+  degraded.SubtractFloor(lowest_floor);
+  return true;
+}
 }  // namespace Visqol
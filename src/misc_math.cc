@@ -15,9 +15,29 @@
 #include "misc_math.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 
+#include "absl/types/span.h"
+
+#include "simd_dispatch.h"
+
 namespace Visqol {
+const double MiscMath::kFastLog10MaxError = 1e-12;
+
+double MiscMath::FastLog10(const double x) {
+  double y;
+  SimdDispatch::Kernels().fast_log10(&x, &y, 1);
+  return y;
+}
+
+void MiscMath::FastLog10(absl::Span<const double> input,
+                         absl::Span<double> output) {
+  SimdDispatch::Kernels().fast_log10(input.data(), output.data(),
+                                     input.size());
+}
+
 AMatrix<double> MiscMath::Normalize(const AMatrix<double>& m) {
   double maxValue = *std::max_element(m.cbegin(), m.cend());
   AMatrix<double> n(m.NumRows(), m.NumCols());
@@ -0,0 +1,208 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "multirate_gammatone_filterbank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "equivalent_rectangular_bandwidth.h"
+#include "erb_filter_cache.h"
+#include "gammatone_filterbank.h"
+
+namespace Visqol {
+namespace {
+// The half-band filter has taps at offsets -kHalfBandReach..kHalfBandReach.
+// Apart from the center tap, only the odd offsets are non-zero.
+const int kHalfBandReach = 15;
+
+// The non-zero odd taps of a Blackman windowed half-band lowpass filter, for
+// offsets 1, 3, ..., kHalfBandReach. The center tap is 0.5. The taps are
+// normalized for unity gain at DC.
+const std::vector<double> &HalfBandTaps() {
+  static const std::vector<double> *taps = [] {
+    auto t = new std::vector<double>();
+    double sum = 0.0;
+    for (int j = 1; j <= kHalfBandReach; j += 2) {
+      const double x = M_PI * j / (kHalfBandReach + 1);
+      const double window = 0.42 + 0.5 * cos(x) + 0.08 * cos(2.0 * x);
+      t->push_back(sin(M_PI * j / 2.0) / (M_PI * j) * window);
+      sum += 2.0 * t->back();
+    }
+    for (auto &tap : *t) {
+      tap *= 0.5 / sum;
+    }
+    return t;
+  }();
+  return *taps;
+}
+}  // namespace
+
+const size_t MultirateGammatoneFilterBank::kMaxDecimationLevel = 5;
+const double MultirateGammatoneFilterBank::kMaxCenterFreqRatio = 0.2;
+
+MultirateGammatoneFilterBank::MultirateGammatoneFilterBank(
+    const size_t num_bands, const double min_freq)
+    : num_bands_(num_bands), min_freq_(min_freq) {}
+
+size_t MultirateGammatoneFilterBank::GetNumBands() const { return num_bands_; }
+
+double MultirateGammatoneFilterBank::GetMinFreq() const { return min_freq_; }
+
+size_t MultirateGammatoneFilterBank::GetDecimationLevel(size_t band) const {
+  for (const auto &stage : stages_) {
+    if (band >= stage.first_band) {
+      return stage.decimation_level;
+    }
+  }
+  return 0;
+}
+
+void MultirateGammatoneFilterBank::SetCenterFrequencies(
+    size_t sample_rate, const std::vector<double> &center_freqs) {
+  if (filters_ != nullptr && filters_->sample_rate == sample_rate &&
+      filters_->center_freqs == center_freqs) {
+    return;
+  }
+  SetFilters(std::make_shared<const MultirateErbFilterSet>(
+      DesignStages(sample_rate, center_freqs)));
+}
+
+void MultirateGammatoneFilterBank::SetFilters(
+    std::shared_ptr<const MultirateErbFilterSet> filters) {
+  if (filters == filters_) {
+    return;
+  }
+  filters_ = std::move(filters);
+  stages_.clear();
+  for (const auto &design : filters_->stages) {
+    Stage stage{design.decimation_level, design.first_band,
+                GammatoneFilterBank{design.filter_coeffs.NumRows(),
+                                    min_freq_}};
+    stage.filter_bank.SetFilterCoefficients(design.filter_coeffs);
+    stage.filter_bank.ResetFilterConditions();
+    stages_.push_back(std::move(stage));
+  }
+
+  const size_t max_level = stages_.empty() ? 0 :
+      stages_.back().decimation_level;
+  decimated_.resize(max_level);
+}
+
+MultirateErbFilterSet MultirateGammatoneFilterBank::DesignStages(
+    size_t sample_rate, const std::vector<double> &center_freqs) {
+  MultirateErbFilterSet filters;
+  filters.sample_rate = sample_rate;
+  filters.center_freqs = center_freqs;
+
+  // Find the lowest rate at which each band can be filtered. The rate is only
+  // halved while it stays a whole number.
+  std::vector<size_t> levels(center_freqs.size(), 0);
+  for (size_t band = 0; band < center_freqs.size(); band++) {
+    size_t level = 0;
+    while (level < kMaxDecimationLevel &&
+           sample_rate % (size_t{2} << level) == 0 &&
+           center_freqs[band] <=
+               kMaxCenterFreqRatio * (sample_rate >> (level + 1))) {
+      level++;
+    }
+    levels[band] = level;
+  }
+
+  // Group neighbouring bands with the same level into a stage, starting from
+  // the highest frequency band.
+  size_t end_band = center_freqs.size();
+  while (end_band > 0) {
+    const size_t level = levels[end_band - 1];
+    size_t first_band = end_band - 1;
+    while (first_band > 0 && levels[first_band - 1] == level) {
+      first_band--;
+    }
+    const std::vector<double> stage_freqs(center_freqs.begin() + first_band,
+                                          center_freqs.begin() + end_band);
+    ErbFiltersResult erb_rslt =
+        EquivalentRectangularBandwidth::MakeFiltersForCenterFreqs(
+            sample_rate >> level, stage_freqs);
+    filters.stages.push_back(MultirateErbStage{
+        level, first_band, AMatrix<double>(erb_rslt.filterCoeffs)});
+    end_band = first_band;
+  }
+  return filters;
+}
+
+std::vector<double> MultirateGammatoneFilterBank::ApplyFilterRms(
+    absl::Span<const double> signal) {
+  std::vector<double> rms(num_bands_, 0.0);
+  ApplyFilterRms(signal, absl::MakeSpan(rms));
+  return rms;
+}
+
+void MultirateGammatoneFilterBank::ApplyFilterRms(
+    absl::Span<const double> signal, absl::Span<double> rms) {
+  std::fill(rms.begin(), rms.end(), 0.0);
+  size_t num_decimated = 0;
+  for (auto &stage : stages_) {
+    // decimate down to the rate of this stage.
+    while (num_decimated < stage.decimation_level) {
+      const absl::Span<const double> src = num_decimated == 0 ? signal :
+          absl::Span<const double>(decimated_[num_decimated - 1]);
+      Decimate(src, &decimated_[num_decimated]);
+      num_decimated++;
+    }
+    const absl::Span<const double> stage_signal =
+        stage.decimation_level == 0 ? signal :
+        absl::Span<const double>(decimated_[stage.decimation_level - 1]);
+    stage.filter_bank.ApplyFilterRms(stage_signal,
+        rms.subspan(stage.first_band, stage.filter_bank.GetNumBands()));
+  }
+}
+
+void MultirateGammatoneFilterBank::ResetFilterConditions() {
+  for (auto &stage : stages_) {
+    stage.filter_bank.ResetFilterConditions();
+  }
+}
+
+void MultirateGammatoneFilterBank::Decimate(absl::Span<const double> signal,
+    std::vector<double> *decimated) {
+  const std::vector<double> &taps = HalfBandTaps();
+  const int n = signal.size();
+  decimated->resize((n + 1) / 2);
+  for (int m = 0; m < static_cast<int>(decimated->size()); m++) {
+    const int center = 2 * m;
+    double y = 0.5 * signal[center];
+    if (center >= kHalfBandReach && center + kHalfBandReach < n) {
+      for (size_t t = 0; t < taps.size(); t++) {
+        const int j = 2 * t + 1;
+        y += taps[t] * (signal[center - j] + signal[center + j]);
+      }
+    } else {
+      // the signal is zero padded at the edges.
+      for (size_t t = 0; t < taps.size(); t++) {
+        const int j = 2 * t + 1;
+        const double before = center - j >= 0 ? signal[center - j] : 0.0;
+        const double after = center + j < n ? signal[center + j] : 0.0;
+        y += taps[t] * (before + after);
+      }
+    }
+    (*decimated)[m] = y;
+  }
+}
+}  // namespace Visqol
@@ -0,0 +1,94 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "multirate_gammatone_spectrogram_builder.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal_view.h"
+#include "erb_filter_cache.h"
+#include "gammatone_spectrogram_builder.h"
+#include "spectrogram.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+MultirateGammatoneSpectrogramBuilder::MultirateGammatoneSpectrogramBuilder(
+    const MultirateGammatoneFilterBank &filter_bank,
+    const bool use_speech_mode) :
+    filter_bank_(filter_bank), speech_mode_(use_speech_mode) {}
+
+google::protobuf::util::StatusOr<Spectrogram>
+MultirateGammatoneSpectrogramBuilder::Build(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  size_t sample_rate = signal.SampleRate();
+  double max_freq = speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
+
+  // use the same center frequencies as the full rate filter bank, so that the
+  // spectrogram layout is unchanged. The stages are designed once per
+  // configuration and shared, so only the filter conditions are local to this
+  // call.
+  std::shared_ptr<const MultirateErbFilterSet> erb_filters =
+      ErbFilterCache::GetMultirateFilters(sample_rate,
+                                          filter_bank_.GetNumBands(),
+                                          filter_bank_.GetMinFreq(), max_freq);
+  MultirateGammatoneFilterBank filter_bank{filter_bank_.GetNumBands(),
+                                           filter_bank_.GetMinFreq()};
+  filter_bank.SetFilters(erb_filters);
+
+  // set up the windowing
+  size_t hop_size = window.size * window.overlap;
+
+  // ensure that the signal is large enough.
+  if (num_samples <= window.size) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::INVALID_ARGUMENT,
+        "Too few samples ("+std::to_string(num_samples)+") in signal to build"
+        " spectrogram ("+std::to_string(hop_size)+" required minimum).");
+  }
+  size_t num_cols = 1 + floor((num_samples - window.size) / hop_size);
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  AMatrix<double> out_matrix = scratch->TakeMatrix(filter_bank.GetNumBands(),
+                                                   num_cols);
+
+  // run the windowing, writing the RMS of each band straight into the columns
+  // of the spectrogram. The signal is only copied if the view has silent
+  // samples.
+  const absl::Span<const double> sig_span = signal.ToSpan(scratch);
+  const size_t num_bands = filter_bank.GetNumBands();
+  for (size_t i = 0; i < num_cols; i++) {
+    const auto frame = sig_span.subspan(i * hop_size, window.size);
+    filter_bank.ResetFilterConditions();
+    filter_bank.ApplyFilterRms(frame, absl::Span<double>(
+        out_matrix.mutData() + i * num_bands, num_bands));
+  }
+
+  Spectrogram spectro(std::move(out_matrix));
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
+  return spectro;
+}
+}  // namespace Visqol
@@ -12,64 +12,229 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+
 #include "neurogram_similiarity_index_measure.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+
 #include "convolution_2d.h"
+#include "patch_view.h"
+#include "spectrogram_store.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
-PatchSimilarityResult NeurogramSimiliarityIndexMeasure::MeasurePatchSimilarity(
-    const ImagePatch &ref_patch, const ImagePatch &deg_patch) const {
-  const std::vector<double> w = {
-      0.0113033910173052, 0.0838251475442633, 0.0113033910173052,
-      0.0838251475442633, 0.619485845753726,  0.0838251475442633,
-      0.0113033910173052, 0.0838251475442633, 0.0113033910173052};
-  AMatrix<double> window(3, 3, std::move(w));
+namespace {
+// The 3x3 gaussian window that the local means are calculated with is
+//   [c e c]
+//   [e m e]   with c = 0.0113033910173052, e = 0.0838251475442633 and
+//   [c e c]        m = 0.619485845753726.
+// This is the outer product of the taps [a b a] with themselves, where
+// a = sqrt(c) and b = e / a, less a small excess at the center, so the local
+// means are calculated with a separable convolution and a center correction.
+template <typename T>
+struct NsimFilter {
+  std::array<T, 3> taps;
+  T center_excess;
+};
 
-  std::vector<double> k{0.01, 0.03};
-  double c1 = pow(k[0] * intensity_range_, 2);
-  double c3 = pow(k[1] * intensity_range_, 2) / 2;
+template <typename T>
+const NsimFilter<T> &GetNsimFilter() {
+  static const NsimFilter<T> *filter = [] {
+    const double corner = 0.0113033910173052;
+    const double edge = 0.0838251475442633;
+    const double center = 0.619485845753726;
+    const double a = sqrt(corner);
+    const double b = edge / a;
+    return new NsimFilter<T>{{{static_cast<T>(a), static_cast<T>(b),
+                               static_cast<T>(a)}},
+                             static_cast<T>(b * b - center)};
+  }();
+  return *filter;
+}
+
+int Clamp(int i, int size) { return std::min(std::max(i, 0), size - 1); }
+
+// The shape of the patch pairs that the NSIM loops are instantiated for. The
+// numbers of bands and frames of a fixed shape are compile time constants, so
+// the loops over them have fixed trip counts that the compiler can unroll, and
+// the clamping of the rows at the patch boundary folds to constants. A shape
+// of 0 by 0 reads them from the patches.
+template <int kRows, int kCols>
+struct PatchShape {
+  static constexpr int kNumRows = kRows;
+  static constexpr int kNumCols = kCols;
+
+  template <typename Patch>
+  static int NumRows(const Patch &patch) {
+    return kRows > 0 ? kRows : static_cast<int>(patch.NumRows());
+  }
 
-  auto mu_r = Convolution2D<double>::Valid2DConvWithBoundary(window, ref_patch);
-  auto mu_d = Convolution2D<double>::Valid2DConvWithBoundary(window, deg_patch);
-  auto ref_mu_sq = mu_r.PointWiseProduct(mu_r);
-  auto deg_mu_sq = mu_d.PointWiseProduct(mu_d);
-  auto mu_r_mu_d = mu_r.PointWiseProduct(mu_d);
-  auto ref_neuro_sq = ref_patch.PointWiseProduct(ref_patch);
-  auto deg_neuro_sq = deg_patch.PointWiseProduct(deg_patch);
-  auto conv2_ref_neuro_sq =
-      Convolution2D<double>::Valid2DConvWithBoundary(window, ref_neuro_sq);
-  auto sigma_r_sq = conv2_ref_neuro_sq - ref_mu_sq;
-  auto conv2_deg_neuro_sq =
-      Convolution2D<double>::Valid2DConvWithBoundary(window, deg_neuro_sq);
-  auto sigma_d_sq = conv2_deg_neuro_sq - deg_mu_sq;
-  auto ref_neuro_deg = ref_patch.PointWiseProduct(deg_patch);
-  auto conv2_ref_neuro_deg =
-      Convolution2D<double>::Valid2DConvWithBoundary(window, ref_neuro_deg);
-  auto sigma_r_d = conv2_ref_neuro_deg - mu_r_mu_d;
-
-  auto intensity_numer = mu_r_mu_d * 2.0 + c1;
-  auto intensity_denom = ref_mu_sq + deg_mu_sq + c1;
-  auto intensity = intensity_numer.PointWiseDivide(intensity_denom);
-
-  auto structure_numer = sigma_r_d + c3;
-  auto structure_denom = sigma_r_sq.PointWiseProduct(sigma_d_sq);
-  std::transform(structure_denom.begin(), structure_denom.end(),
-                 structure_denom.begin(),
-                 [&](decltype(*structure_denom.begin()) &d) {
-                   // Avoid a nan is when stddev is negative.
-                   // This occasionally happens with silent patches,
-                   // which generate an epison negative value.
-                   return (d < 0.) ? c3 : (sqrt(d) + c3);
-                 });
-  auto structure = structure_numer.PointWiseDivide(structure_denom);
-  auto sim_map = intensity.PointWiseProduct(structure);
-
-  auto freq_band_means = sim_map.Mean(kDimension::ROW);  // A.K.A. FVNSIM
+  template <typename Patch>
+  static int NumCols(const Patch &patch) {
+    return kCols > 0 ? kCols : static_cast<int>(patch.NumCols());
+  }
+
+  // Whether a patch has the fixed shape.
+  template <typename Patch>
+  static bool Matches(const Patch &patch) {
+    return patch.NumRows() == static_cast<size_t>(kRows) &&
+        patch.NumCols() == static_cast<size_t>(kCols);
+  }
+};
+
+// The patch shapes of the audio and speech modes of VisqolManager, i.e. their
+// numbers of bands by their patch sizes.
+using AudioPatchShape = PatchShape<32, 30>;
+using SpeechPatchShape = PatchShape<21, 20>;
+using DynamicPatchShape = PatchShape<0, 0>;
+
+// The five local sums that NSIM is calculated from, at one point of a patch
+// pair.
+template <typename T>
+struct NsimTerms {
+  T ref;
+  T deg;
+  T ref_sq;
+  T deg_sq;
+  T ref_deg;
+};
+
+// The local terms of the reference patch, for every point of a patch of the
+// shape. The terms of a fixed shape are held on the stack.
+template <typename Shape, typename T>
+class RefTermsBuffer {
+ public:
+  absl::Span<NsimTerms<T>> Get(size_t) { return absl::MakeSpan(terms_); }
+
+ private:
+  std::array<NsimTerms<T>, Shape::kNumRows * Shape::kNumCols> terms_;
+};
+
+template <typename T>
+class RefTermsBuffer<DynamicPatchShape, T> {
+ public:
+  absl::Span<NsimTerms<T>> Get(size_t size) {
+    terms_.resize(size);
+    return absl::MakeSpan(terms_);
+  }
+
+ private:
+  std::vector<NsimTerms<T>> terms_;
+};
+
+// The column pass of the separable filter at one point of a patch pair, with
+// the first and last rows replicated. The patches are BasicPatchViews or
+// store windows.
+template <typename Shape, typename Patch,
+          typename T = typename Patch::value_type>
+NsimTerms<T> ColumnTerms(const Patch &ref, const Patch &deg, int row,
+                         int col) {
+  const std::array<T, 3> &taps = GetNsimFilter<T>().taps;
+  const int num_rows = Shape::NumRows(ref);
+  NsimTerms<T> t{0, 0, 0, 0, 0};
+  for (int k = 0; k < 3; k++) {
+    const int in_row = Clamp(row + k - 1, num_rows);
+    const T x_r = ref(in_row, col);
+    const T x_d = deg(in_row, col);
+    const T tap = taps[2 - k];
+    t.ref += x_r * tap;
+    t.deg += x_d * tap;
+    t.ref_sq += (x_r * x_r) * tap;
+    t.deg_sq += (x_d * x_d) * tap;
+    t.ref_deg += (x_r * x_d) * tap;
+  }
+  return t;
+}
 
+// The column pass of the separable filter for the degraded and cross terms
+// alone. The reference terms are left at zero.
+template <typename Shape, typename T>
+NsimTerms<T> DegColumnTerms(const BasicPatchView<T> &ref,
+                            const BasicPatchView<T> &deg, int row, int col) {
+  const std::array<T, 3> &taps = GetNsimFilter<T>().taps;
+  const int num_rows = Shape::NumRows(ref);
+  NsimTerms<T> t{0, 0, 0, 0, 0};
+  for (int k = 0; k < 3; k++) {
+    const int in_row = Clamp(row + k - 1, num_rows);
+    const T x_r = ref(in_row, col);
+    const T x_d = deg(in_row, col);
+    const T tap = taps[2 - k];
+    t.deg += x_d * tap;
+    t.deg_sq += (x_d * x_d) * tap;
+    t.ref_deg += (x_r * x_d) * tap;
+  }
+  return t;
+}
+
+// The column pass of the separable filter for the cross term alone.
+template <typename Shape, typename RefPatch, typename DegPatch,
+          typename T = typename RefPatch::value_type>
+T CrossColumnTerm(const RefPatch &ref, const DegPatch &deg, int row,
+                  int col) {
+  const std::array<T, 3> &taps = GetNsimFilter<T>().taps;
+  const int num_rows = Shape::NumRows(ref);
+  T sum = 0;
+  for (int k = 0; k < 3; k++) {
+    const int in_row = Clamp(row + k - 1, num_rows);
+    sum += (ref(in_row, col) * deg(in_row, col)) * taps[2 - k];
+  }
+  return sum;
+}
+
+// The row pass of the separable filter, over the column terms of the columns
+// before, at and after a point. The excess weight at the center is then
+// removed, given the values of the patch pair at that point.
+template <typename T>
+NsimTerms<T> LocalTerms(const NsimTerms<T> &before, const NsimTerms<T> &at,
+                        const NsimTerms<T> &after, T x_r, T x_d) {
+  const std::array<T, 3> &taps = GetNsimFilter<T>().taps;
+  const T center_excess = GetNsimFilter<T>().center_excess;
+  auto row_pass = [&](T NsimTerms<T>::*term, T center) {
+    T sum = 0;
+    sum += before.*term * taps[2];
+    sum += at.*term * taps[1];
+    sum += after.*term * taps[0];
+    return sum - center_excess * center;
+  };
+  return NsimTerms<T>{row_pass(&NsimTerms<T>::ref, x_r),
+                      row_pass(&NsimTerms<T>::deg, x_d),
+                      row_pass(&NsimTerms<T>::ref_sq, x_r * x_r),
+                      row_pass(&NsimTerms<T>::deg_sq, x_d * x_d),
+                      row_pass(&NsimTerms<T>::ref_deg, x_r * x_d)};
+}
+
+// Combine the local terms at one point of a patch pair into the similarity at
+// that point.
+template <typename T>
+T PointSimilarity(const NsimTerms<T> &local, T c1, T c3) {
+  const T ref_mu_sq = local.ref * local.ref;
+  const T deg_mu_sq = local.deg * local.deg;
+  const T mu_r_mu_d = local.ref * local.deg;
+  const T sigma_r_sq = local.ref_sq - ref_mu_sq;
+  const T sigma_d_sq = local.deg_sq - deg_mu_sq;
+  const T sigma_r_d = local.ref_deg - mu_r_mu_d;
+
+  const T intensity = (mu_r_mu_d * 2 + c1) / (ref_mu_sq + deg_mu_sq + c1);
+
+  // Avoid a nan is when stddev is negative. This occasionally happens with
+  // silent patches, which generate an epison negative value.
+  const T d = sigma_r_sq * sigma_d_sq;
+  const T structure_denom = (d < 0) ? c3 : (std::sqrt(d) + c3);
+  const T structure = (sigma_r_d + c3) / structure_denom;
+  return intensity * structure;
+}
+
+// Build the similarity result from the mean similarity of each band, i.e.
+// of each row of the patch pair.
+PatchSimilarityResult SimilarityFromBandMeans(AMatrix<double> freq_band_means) {
   double freq_band_sim_sum = 0;
   std::for_each(freq_band_means.begin(), freq_band_means.end(),
       [&](decltype(*freq_band_means.begin()) &d) {freq_band_sim_sum += d;});
@@ -81,4 +246,326 @@ PatchSimilarityResult NeurogramSimiliarityIndexMeasure::MeasurePatchSimilarity(
   r.freq_band_means = std::move(freq_band_means);
   return r;
 }
+
+// Calculate the local terms of the reference patch with itself, which hold
+// the reference means at every point of the patch, in column major order.
+template <typename Shape, typename Patch,
+          typename T = typename Patch::value_type>
+void RefLocalTerms(const Patch &ref_patch,
+                   absl::Span<NsimTerms<T>> ref_terms) {
+  const int num_rows = Shape::NumRows(ref_patch);
+  const int num_cols = Shape::NumCols(ref_patch);
+  for (int r = 0; r < num_rows; r++) {
+    NsimTerms<T> before = ColumnTerms<Shape>(ref_patch, ref_patch, r, 0);
+    NsimTerms<T> at = before;
+    for (int c = 0; c < num_cols; c++) {
+      const NsimTerms<T> after = c + 1 < num_cols ?
+          ColumnTerms<Shape>(ref_patch, ref_patch, r, c + 1) : at;
+      ref_terms[c * num_rows + r] = LocalTerms(before, at, after,
+          ref_patch(r, c), ref_patch(r, c));
+      before = at;
+      at = after;
+    }
+  }
+}
+
+// Measure the similarity of a patch pair, given the precalculated local terms
+// of the reference patch and a function that returns the degraded and cross
+// column terms at a point.
+template <typename Shape, typename RefPatch, typename DegPatch,
+          typename DegColumnTermsFn,
+          typename T = typename RefPatch::value_type>
+PatchSimilarityResult MeasureWithRefTerms(const RefPatch &ref_patch,
+    absl::Span<const NsimTerms<typename RefPatch::value_type>> ref_terms,
+    const DegPatch &deg_patch, const DegColumnTermsFn &column_terms,
+    typename RefPatch::value_type c1, typename RefPatch::value_type c3) {
+  const int num_rows = Shape::NumRows(ref_patch);
+  const int num_cols = Shape::NumCols(ref_patch);
+  AMatrix<double> freq_band_means(num_rows, 1);  // A.K.A. FVNSIM
+  for (int r = 0; r < num_rows; r++) {
+    NsimTerms<T> before = column_terms(r, 0);
+    NsimTerms<T> at = before;
+    T row_sum = 0;
+    for (int c = 0; c < num_cols; c++) {
+      const NsimTerms<T> after = c + 1 < num_cols ?
+          column_terms(r, c + 1) : at;
+      NsimTerms<T> local = LocalTerms(before, at, after, ref_patch(r, c),
+                                      deg_patch(r, c));
+      const NsimTerms<T> &ref_local = ref_terms[c * num_rows + r];
+      local.ref = ref_local.ref;
+      local.ref_sq = ref_local.ref_sq;
+      row_sum += PointSimilarity(local, c1, c3);
+      before = at;
+      at = after;
+    }
+    freq_band_means(r) = row_sum / num_cols;
+  }
+  return SimilarityFromBandMeans(std::move(freq_band_means));
+}
+
+// Measure the similarity of a patch pair from the degraded column term maps,
+// given the precalculated local terms of the reference patch.
+template <typename Shape, typename RefPatch, typename DegPatch,
+          typename T = typename RefPatch::value_type>
+PatchSimilarityResult MeasureAtOffset(const RefPatch &ref_patch,
+    absl::Span<const NsimTerms<typename RefPatch::value_type>> ref_terms,
+    const DegPatch &deg_patch, const DegPatch &deg_col_mean,
+    const DegPatch &deg_sq_col_mean, typename RefPatch::value_type c1,
+    typename RefPatch::value_type c3) {
+  return MeasureWithRefTerms<Shape>(ref_patch, ref_terms, deg_patch,
+      [&](int r, int c) {
+        return NsimTerms<T>{0, deg_col_mean(r, c), 0, deg_sq_col_mean(r, c),
+                            CrossColumnTerm<Shape>(ref_patch, deg_patch, r,
+                                                   c)};
+      }, c1, c3);
+}
+
+// Measure the similarity of a patch pair of the shape in a single pass over
+// each row, which keeps the column terms of the neighbouring columns. The
+// patch boundary is replicated.
+template <typename Shape>
+PatchSimilarityResult MeasurePair(const PatchView &ref_patch,
+                                  const PatchView &deg_patch, double c1,
+                                  double c3) {
+  const int num_rows = Shape::NumRows(ref_patch);
+  const int num_cols = Shape::NumCols(ref_patch);
+  AMatrix<double> freq_band_means(num_rows, 1);  // A.K.A. FVNSIM
+  for (int r = 0; r < num_rows; r++) {
+    NsimTerms<double> before = ColumnTerms<Shape>(ref_patch, deg_patch, r, 0);
+    NsimTerms<double> at = before;
+    double row_sum = 0;
+    for (int c = 0; c < num_cols; c++) {
+      const NsimTerms<double> after = c + 1 < num_cols ?
+          ColumnTerms<Shape>(ref_patch, deg_patch, r, c + 1) : at;
+      row_sum += PointSimilarity(LocalTerms(before, at, after,
+          ref_patch(r, c), deg_patch(r, c)), c1, c3);
+      before = at;
+      at = after;
+    }
+    freq_band_means(r) = row_sum / num_cols;
+  }
+  return SimilarityFromBandMeans(std::move(freq_band_means));
+}
+
+// Measure the similarity of a reference patch of the shape with each of the
+// degraded patches. The reference terms are the same for every degraded
+// patch.
+template <typename Shape>
+std::vector<PatchSimilarityResult> MeasurePairs(const PatchView &ref_patch,
+    absl::Span<const PatchView> deg_patches, double c1, double c3) {
+  std::vector<PatchSimilarityResult> results;
+  results.reserve(deg_patches.size());
+  RefTermsBuffer<Shape, double> ref_terms_buffer;
+  const absl::Span<NsimTerms<double>> ref_terms = ref_terms_buffer.Get(
+      ref_patch.NumRows() * ref_patch.NumCols());
+  RefLocalTerms<Shape>(ref_patch, ref_terms);
+  for (const PatchView &deg_patch : deg_patches) {
+    results.push_back(MeasureWithRefTerms<Shape>(ref_patch,
+        absl::MakeConstSpan(ref_terms), deg_patch,
+        [&](int r, int c) {
+          return DegColumnTerms<Shape>(ref_patch, deg_patch, r, c);
+        }, c1, c3));
+  }
+  return results;
+}
+
+// A window of a store that may extend past its pad frames. The frames that
+// are outside the spectrogram read as silence.
+template <typename T>
+class CheckedWindow {
+ public:
+  using value_type = T;
+
+  CheckedWindow(const BasicSpectrogramStore<T> &store, int first_frame,
+                size_t num_frames)
+      : store_(store), first_frame_(first_frame), num_frames_(num_frames) {}
+
+  T operator()(size_t row, size_t col) const {
+    const int frame = first_frame_ + static_cast<int>(col);
+    if (frame < 0 || frame >= static_cast<int>(store_.NumFrames())) {
+      return T(0);
+    }
+    return store_.Band(row)[frame];
+  }
+
+  size_t NumRows() const { return store_.NumBands(); }
+
+  size_t NumCols() const { return num_frames_; }
+
+ private:
+  const BasicSpectrogramStore<T> &store_;
+  int first_frame_;
+  size_t num_frames_;
+};
+
+// Copy a view into a matrix of the given precision.
+template <typename T>
+AMatrix<T> ToPrecision(const PatchView &view) {
+  AMatrix<T> matrix(view.NumRows(), view.NumCols());
+  for (size_t col = 0; col < view.NumCols(); col++) {
+    for (size_t row = 0; row < view.NumRows(); row++) {
+      matrix(row, col) = static_cast<T>(view(row, col));
+    }
+  }
+  return matrix;
+}
+
+// Measure the similarity of a reference patch of the shape with the degraded
+// patch at each offset of the search, given its precalculated local terms.
+template <typename Shape, typename T>
+void MeasureAtOffsets(const typename BasicSpectrogramStore<T>::Window &ref_view,
+    absl::Span<NsimTerms<T>> ref_terms, const std::vector<int> &offsets,
+    const BasicSpectrogramStore<T> &deg_spectrogram,
+    const BasicSpectrogramStore<T> &deg_col_mean,
+    const BasicSpectrogramStore<T> &deg_sq_col_mean, T c1, T c3,
+    std::vector<PatchSimilarityResult> *results) {
+  const int num_cols = Shape::NumCols(ref_view);
+  RefLocalTerms<Shape>(ref_view, ref_terms);
+  for (const int offset : offsets) {
+    // The column terms of the degraded patch are read from the maps. Only the
+    // cross term needs the column pass.
+    if (deg_spectrogram.Covers(offset, num_cols)) {
+      results->push_back(MeasureAtOffset<Shape>(ref_view,
+          absl::MakeConstSpan(ref_terms),
+          deg_spectrogram.GetWindow(offset, num_cols),
+          deg_col_mean.GetWindow(offset, num_cols),
+          deg_sq_col_mean.GetWindow(offset, num_cols), c1, c3));
+    } else {
+      // The patch extends past the pad frames, so each frame is checked.
+      results->push_back(MeasureAtOffset<Shape>(ref_view,
+          absl::MakeConstSpan(ref_terms),
+          CheckedWindow<T>(deg_spectrogram, offset, num_cols),
+          CheckedWindow<T>(deg_col_mean, offset, num_cols),
+          CheckedWindow<T>(deg_sq_col_mean, offset, num_cols), c1, c3));
+    }
+  }
+}
+}  // namespace
+
+NsimPatchShape NsimPatchShapeOf(size_t num_bands, size_t patch_size) {
+  if (num_bands == AudioPatchShape::kNumRows &&
+      patch_size == AudioPatchShape::kNumCols) {
+    return NsimPatchShape::kAudio;
+  }
+  if (num_bands == SpeechPatchShape::kNumRows &&
+      patch_size == SpeechPatchShape::kNumCols) {
+    return NsimPatchShape::kSpeech;
+  }
+  return NsimPatchShape::kDynamic;
+}
+
+NeurogramSimiliarityIndexMeasure::NeurogramSimiliarityIndexMeasure(
+    bool use_float_search, NsimPatchShape patch_shape)
+    : use_float_search_(use_float_search), patch_shape_(patch_shape) {}
+
+PatchSimilarityResult NeurogramSimiliarityIndexMeasure::MeasurePatchSimilarity(
+    const PatchView &ref_patch, const PatchView &deg_patch) const {
+  std::vector<double> k{0.01, 0.03};
+  double c1 = pow(k[0] * intensity_range_, 2);
+  double c3 = pow(k[1] * intensity_range_, 2) / 2;
+
+  if (patch_shape_ == NsimPatchShape::kAudio &&
+      AudioPatchShape::Matches(ref_patch)) {
+    return MeasurePair<AudioPatchShape>(ref_patch, deg_patch, c1, c3);
+  }
+  if (patch_shape_ == NsimPatchShape::kSpeech &&
+      SpeechPatchShape::Matches(ref_patch)) {
+    return MeasurePair<SpeechPatchShape>(ref_patch, deg_patch, c1, c3);
+  }
+  return MeasurePair<DynamicPatchShape>(ref_patch, deg_patch, c1, c3);
+}
+
+std::vector<PatchSimilarityResult>
+NeurogramSimiliarityIndexMeasure::MeasurePatchSimilarities(
+    const PatchView &ref_patch, absl::Span<const PatchView> deg_patches) const {
+  std::vector<double> k{0.01, 0.03};
+  double c1 = pow(k[0] * intensity_range_, 2);
+  double c3 = pow(k[1] * intensity_range_, 2) / 2;
+
+  if (patch_shape_ == NsimPatchShape::kAudio &&
+      AudioPatchShape::Matches(ref_patch)) {
+    return MeasurePairs<AudioPatchShape>(ref_patch, deg_patches, c1, c3);
+  }
+  if (patch_shape_ == NsimPatchShape::kSpeech &&
+      SpeechPatchShape::Matches(ref_patch)) {
+    return MeasurePairs<SpeechPatchShape>(ref_patch, deg_patches, c1, c3);
+  }
+  return MeasurePairs<DynamicPatchShape>(ref_patch, deg_patches, c1, c3);
+}
+
+std::unique_ptr<SlidingPatchComparator>
+NeurogramSimiliarityIndexMeasure::CreateSlidingComparator(
+    const AMatrix<double> &deg_spectrogram, size_t num_patch_frames) const {
+  if (use_float_search_) {
+    return absl::make_unique<SlidingNeurogramSimiliarityIndexMeasure<float>>(
+        deg_spectrogram, intensity_range_, num_patch_frames, patch_shape_);
+  }
+  return absl::make_unique<SlidingNeurogramSimiliarityIndexMeasure<double>>(
+      deg_spectrogram, intensity_range_, num_patch_frames, patch_shape_);
+}
+
+template <typename T>
+SlidingNeurogramSimiliarityIndexMeasure<T>::
+SlidingNeurogramSimiliarityIndexMeasure(
+    const AMatrix<double> &deg_spectrogram, double intensity_range,
+    size_t num_patch_frames, NsimPatchShape patch_shape)
+    : patch_shape_(patch_shape) {
+  // The maps are silent outside the spectrogram, as the patches are, so they
+  // are padded with a patch of silence on each side.
+  AMatrix<T> deg = ToPrecision<T>(deg_spectrogram);
+  const std::array<T, 3> &taps = GetNsimFilter<T>().taps;
+  deg_spectrogram_ = BasicSpectrogramStore<T>(deg, num_patch_frames);
+  deg_col_mean_ = BasicSpectrogramStore<T>(
+      Convolution2D<T>::ColumnConvWithBoundary(taps, deg), num_patch_frames);
+  // the degraded values are not needed again, so they are squared in place.
+  deg.PointWiseMultiplyInPlace(deg);
+  deg_sq_col_mean_ = BasicSpectrogramStore<T>(
+      Convolution2D<T>::ColumnConvWithBoundary(taps, deg), num_patch_frames);
+  std::vector<double> k{0.01, 0.03};
+  c1_ = pow(k[0] * intensity_range, 2);
+  c3_ = pow(k[1] * intensity_range, 2) / 2;
+}
+
+template <typename T>
+std::vector<PatchSimilarityResult>
+SlidingNeurogramSimiliarityIndexMeasure<T>::MeasurePatchSimilarityAtOffsets(
+    const PatchView &ref_patch, const std::vector<int> &offsets,
+    VisqolWorkspace *workspace) const {
+  std::vector<PatchSimilarityResult> results;
+  if (offsets.empty()) {
+    return results;
+  }
+  results.reserve(offsets.size());
+
+  // The reference terms are the same for every offset. The reference patch is
+  // copied in the precision and layout of the search.
+  const BasicSpectrogramStore<T> ref_store(ToPrecision<T>(ref_patch), 0);
+  const int num_cols = ref_patch.NumCols();
+  const typename BasicSpectrogramStore<T>::Window ref_view =
+      ref_store.GetWindow(0, num_cols);
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  const absl::Span<NsimTerms<T>> ref_terms =
+      scratch->Allocate<NsimTerms<T>>(ref_view.NumRows() * num_cols);
+  if (patch_shape_ == NsimPatchShape::kAudio &&
+      AudioPatchShape::Matches(ref_view)) {
+    MeasureAtOffsets<AudioPatchShape>(ref_view, ref_terms, offsets,
+        deg_spectrogram_, deg_col_mean_, deg_sq_col_mean_, c1_, c3_,
+        &results);
+  } else if (patch_shape_ == NsimPatchShape::kSpeech &&
+             SpeechPatchShape::Matches(ref_view)) {
+    MeasureAtOffsets<SpeechPatchShape>(ref_view, ref_terms, offsets,
+        deg_spectrogram_, deg_col_mean_, deg_sq_col_mean_, c1_, c3_,
+        &results);
+  } else {
+    MeasureAtOffsets<DynamicPatchShape>(ref_view, ref_terms, offsets,
+        deg_spectrogram_, deg_col_mean_, deg_sq_col_mean_, c1_, c3_,
+        &results);
+  }
+  return results;
+}
+
+template class SlidingNeurogramSimiliarityIndexMeasure<double>;
+template class SlidingNeurogramSimiliarityIndexMeasure<float>;
 }  // namespace Visqol
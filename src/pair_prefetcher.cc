@@ -0,0 +1,70 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pair_prefetcher.h"
+
+#include <algorithm>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+PairPrefetcher::PairPrefetcher(
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    size_t num_prefetch_pairs, Loader loader)
+    : pairs_(pairs), num_prefetch_pairs_(num_prefetch_pairs),
+      loader_(std::move(loader)) {
+  StartLoads();
+}
+
+PairPrefetcher::~PairPrefetcher() {
+  for (auto &load : loads_) {
+    load.wait();
+  }
+}
+
+bool PairPrefetcher::HasNext() const {
+  return next_pair_ < pairs_.size();
+}
+
+PairPrefetcher::LoadedPair PairPrefetcher::Next() {
+  LoadedPair loaded;
+  if (loads_.empty()) {
+    loaded = Load(next_pair_);
+  } else {
+    loaded = loads_.front().get();
+    loads_.pop_front();
+  }
+  next_pair_++;
+  StartLoads();
+  return loaded;
+}
+
+PairPrefetcher::LoadedPair PairPrefetcher::Load(size_t pair_index) const {
+  const ReferenceDegradedPathPair &pair = pairs_[pair_index];
+  return LoadedPair{loader_(pair.reference), loader_(pair.degraded)};
+}
+
+void PairPrefetcher::StartLoads() {
+  next_load_ = std::max(next_load_, next_pair_);
+  while (loads_.size() < num_prefetch_pairs_ && next_load_ < pairs_.size()) {
+    loads_.push_back(std::async(std::launch::async, &PairPrefetcher::Load,
+                                this, next_load_));
+    next_load_++;
+  }
+}
+}  // namespace Visqol
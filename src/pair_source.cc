@@ -0,0 +1,127 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pair_source.h"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "absl/base/internal/raw_logging.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+ManifestPairSource::ManifestPairSource(const FilePath &manifest_path)
+    : manifest_(manifest_path.Path()) {
+  if (!manifest_) {
+    ABSL_RAW_LOG(ERROR, "Could not open the batch file %s.",
+                 manifest_path.Path().c_str());
+    return;
+  }
+  std::string header;
+  std::getline(manifest_, header);
+}
+
+bool ManifestPairSource::Next(ReferenceDegradedPathPair *pair) {
+  std::string line;
+  while (std::getline(manifest_, line)) {
+    // getline will read up to \n, so in cases where the line ending is \r\n,
+    // we need to manually strip the \r.
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    std::istringstream in(line);
+    std::string reference;
+    std::string degraded;
+    if (std::getline(in, reference, ',') && std::getline(in, degraded, ',')) {
+      *pair = {reference, degraded};
+      return true;
+    }
+    if (!line.empty()) {
+      ABSL_RAW_LOG(ERROR, "Skipping a batch line without a pair: %s",
+                   line.c_str());
+    }
+  }
+  return false;
+}
+
+DirectoryPairSource::DirectoryPairSource(const FilePath &reference_dir,
+                                         const FilePath &degraded_dir,
+                                         const std::string &file_pattern)
+    : degraded_dir_(degraded_dir.Path()), file_pattern_(file_pattern) {
+  boost::system::error_code error;
+  next_entry_ = boost::filesystem::directory_iterator(reference_dir.Path(),
+                                                      error);
+  if (error) {
+    ABSL_RAW_LOG(ERROR, "Could not list the directory %s: %s",
+                 reference_dir.Path().c_str(), error.message().c_str());
+  }
+}
+
+bool DirectoryPairSource::Next(ReferenceDegradedPathPair *pair) {
+  boost::system::error_code error;
+  for (; next_entry_ != boost::filesystem::directory_iterator();
+       next_entry_.increment(error)) {
+    const boost::filesystem::path reference = next_entry_->path();
+    const std::string name = reference.filename().string();
+    if (!MatchesPattern(name, file_pattern_) ||
+        boost::filesystem::is_directory(reference, error)) {
+      continue;
+    }
+    const boost::filesystem::path degraded = degraded_dir_ / name;
+    if (!boost::filesystem::exists(degraded, error)) {
+      ABSL_RAW_LOG(ERROR, "Skipping %s, which has no degraded file %s.",
+                   reference.string().c_str(), degraded.string().c_str());
+      continue;
+    }
+    *pair = {reference.string(), degraded.string()};
+    next_entry_.increment(error);
+    return true;
+  }
+  return false;
+}
+
+bool DirectoryPairSource::MatchesPattern(const std::string &name,
+                                         const std::string &pattern) {
+  // Match greedily, and on a mismatch let the last `*` match one more
+  // character, which is linear for patterns with a single `*`.
+  size_t n = 0;
+  size_t p = 0;
+  size_t star = std::string::npos;
+  size_t star_n = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      n++;
+      p++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_n = n;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      n = ++star_n;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+}  // namespace Visqol
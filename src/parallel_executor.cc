@@ -0,0 +1,92 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "memory_usage.h"
+#include "thread_pinning.h"
+#include "worker_pool.h"
+
+namespace Visqol {
+namespace {
+// The progress of the tasks of a call to ForEach. It is shared with the jobs
+// that the call submits to the pool, which may only start once every task
+// is done.
+struct ForEachState {
+  std::atomic<size_t> next_task{0};
+  std::mutex mutex;
+  std::condition_variable all_done;
+  size_t num_done = 0;
+};
+}  // namespace
+
+void ParallelExecutor::ForEach(size_t num_tasks, size_t num_workers,
+                               const std::function<void(size_t)> &task) {
+  const size_t num_threads = std::min(std::max(num_workers, size_t{1}),
+                                      num_tasks);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < num_tasks; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  // The workers count their allocations with the calling thread, and run on
+  // the CPUs that it is pinned to. The task and the counter are only used
+  // while a task is left, so a job that the pool starts after the call
+  // returns only finds that none are.
+  const auto state = std::make_shared<ForEachState>();
+  const std::function<void(size_t)> *const shared_task = &task;
+  AllocationCounter *const allocation_counter = AllocationCounter::Current();
+  auto worker = [state, num_tasks, shared_task, allocation_counter](
+                    const std::vector<int> &pin_cpus) {
+    size_t i = state->next_task++;
+    if (i >= num_tasks) {
+      return;
+    }
+    size_t num_run = 0;
+    {
+      const ScopedThreadPin pin(pin_cpus);
+      AllocationCounter::ThreadScope allocation_scope(allocation_counter);
+      for (; i < num_tasks; i = state->next_task++) {
+        (*shared_task)(i);
+        num_run++;
+      }
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->num_done += num_run;
+    if (state->num_done == num_tasks) {
+      state->all_done.notify_all();
+    }
+  };
+  // The calling thread is one of the workers, and the others are the threads
+  // of the shared pool that are free to take a job. The calling thread works
+  // through the tasks itself if none are.
+  const std::vector<int> pin_cpus = ScopedThreadPin::CurrentCpus();
+  for (size_t t = 1; t < num_threads; t++) {
+    WorkerPool::Shared().Submit([worker, pin_cpus]() { worker(pin_cpus); });
+  }
+  worker({});
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->all_done.wait(lock, [&]() { return state->num_done == num_tasks; });
+}
+}  // namespace Visqol
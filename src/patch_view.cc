@@ -0,0 +1,47 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "patch_view.h"
+
+#include "amatrix.h"
+
+namespace Visqol {
+template <typename T>
+BasicPatchView<T>::BasicPatchView(const AMatrix<T> &matrix)
+    : BasicPatchView(matrix, 0, matrix.NumCols()) {}
+
+template <typename T>
+BasicPatchView<T>::BasicPatchView(const AMatrix<T> &matrix, int first_col,
+                                  size_t num_cols)
+    : data_(matrix.data()),
+      stride_(matrix.NumRows()),
+      num_rows_(matrix.NumRows()),
+      num_cols_(num_cols),
+      first_col_(first_col),
+      num_data_cols_(matrix.NumCols()) {}
+
+template <typename T>
+AMatrix<T> BasicPatchView<T>::ToMatrix() const {
+  AMatrix<T> matrix(num_rows_, num_cols_);
+  for (size_t col = 0; col < num_cols_; col++) {
+    for (size_t row = 0; row < num_rows_; row++) {
+      matrix(row, col) = (*this)(row, col);
+    }
+  }
+  return matrix;
+}
+
+template class BasicPatchView<double>;
+template class BasicPatchView<float>;
+}  // namespace Visqol
@@ -0,0 +1,146 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "previous_comparison.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "amatrix.h"
+#include "comparison_patches_selector.h"
+#include "patch_similarity_comparator.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+const size_t PreviousComparison::kBlockSamples = 4096;
+
+std::unique_ptr<PreviousComparison> PreviousComparison::Create(
+    const SimilarityResultMsg &previous_result,
+    const std::vector<uint64_t> &deg_block_hashes, uint64_t ref_hash,
+    uint64_t config_hash, size_t sample_rate) {
+  const auto &previous_hashes = previous_result.degraded_block_hashes();
+  if (previous_hashes.empty() || previous_result.patch_sims().empty() ||
+      sample_rate == 0) {
+    return nullptr;
+  }
+  // The patches of a different reference, or of other options, such as those
+  // of speech mode with fewer bands, do not fit this comparison.
+  if (previous_result.reference_hash() != ref_hash ||
+      previous_result.config_hash() != config_hash) {
+    return nullptr;
+  }
+  std::unique_ptr<PreviousComparison> previous(new PreviousComparison());
+  previous->global_lag_ = previous_result.global_lag();
+  previous->sample_rate_ = sample_rate;
+
+  // A block that only one of the signals has changed too, as did the last
+  // block of the shorter signal.
+  const size_t num_blocks = std::max<size_t>(previous_hashes.size(),
+                                             deg_block_hashes.size());
+  const double block_duration = static_cast<double>(kBlockSamples) /
+      sample_rate;
+  for (size_t block = 0; block < num_blocks; block++) {
+    const bool changed = block >= previous_hashes.size() ||
+        block >= deg_block_hashes.size() ||
+        previous_hashes.Get(block) != deg_block_hashes[block];
+    if (!changed) {
+      continue;
+    }
+    const double start = block * block_duration;
+    const double end = start + block_duration;
+    auto &ranges = previous->changed_ranges_;
+    if (!ranges.empty() && ranges.back().second >= start) {
+      ranges.back().second = end;
+    } else {
+      ranges.emplace_back(start, end);
+    }
+  }
+
+  previous->patches_.assign(previous_result.patch_sims().begin(),
+                            previous_result.patch_sims().end());
+  std::sort(previous->patches_.begin(), previous->patches_.end(),
+            [](const SimilarityResultMsg::PatchSimilarityMsg &a,
+               const SimilarityResultMsg::PatchSimilarityMsg &b) {
+              return a.ref_patch_start_time() < b.ref_patch_start_time();
+            });
+  return previous;
+}
+
+bool PreviousComparison::MatchesGlobalLag(double global_lag) const {
+  return std::abs(global_lag - global_lag_) * sample_rate_ < 0.5;
+}
+
+std::vector<size_t> PreviousComparison::SplitPatches(
+    const std::vector<size_t> &ref_patch_indices,
+    size_t num_frames_per_patch, double frame_duration,
+    double window_duration,
+    std::vector<PatchSimilarityResult> *reused_patches) const {
+  std::vector<size_t> to_compare;
+  for (const size_t index : ref_patch_indices) {
+    // The earlier result of the same reference patch, if it was compared.
+    const double ref_start = index * frame_duration;
+    const auto patch = std::lower_bound(patches_.begin(), patches_.end(),
+        ref_start - frame_duration / 2,
+        [](const SimilarityResultMsg::PatchSimilarityMsg &p, double time) {
+          return p.ref_patch_start_time() < time;
+        });
+    bool reusable = patch != patches_.end() &&
+        patch->ref_patch_start_time() < ref_start + frame_duration / 2;
+
+    // The search reads the degraded columns around the patch, and the
+    // realignment only reads the samples of the columns that it matched. The
+    // changed ranges are moved by the lag that the degraded signal is aligned
+    // by, which is the earlier lag.
+    if (reusable) {
+      const SpectrogramColumnRanges columns =
+          ComparisonPatchesSelector::SearchedColumns({index},
+                                                     num_frames_per_patch);
+      const double read_start = columns.front().first * frame_duration;
+      const double read_end = columns.back().second * frame_duration +
+          window_duration;
+      for (const auto &range : changed_ranges_) {
+        if (range.first + global_lag_ < read_end &&
+            range.second + global_lag_ > read_start) {
+          reusable = false;
+          break;
+        }
+      }
+    }
+
+    if (!reusable) {
+      to_compare.push_back(index);
+    } else if (reused_patches != nullptr) {
+      PatchSimilarityResult result;
+      result.similarity = patch->similarity();
+      result.freq_band_means = AMatrix<double>(std::vector<double>(
+          patch->freq_band_means().begin(), patch->freq_band_means().end()));
+      result.ref_patch_start_time = patch->ref_patch_start_time();
+      result.ref_patch_end_time = patch->ref_patch_end_time();
+      result.deg_patch_start_time = patch->deg_patch_start_time();
+      result.deg_patch_end_time = patch->deg_patch_end_time();
+      reused_patches->push_back(std::move(result));
+    }
+  }
+  return to_compare;
+}
+
+const std::vector<std::pair<double, double>> &
+PreviousComparison::ChangedRanges() const {
+  return changed_ranges_;
+}
+}  // namespace Visqol
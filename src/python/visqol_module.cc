@@ -0,0 +1,219 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Python bindings of the ViSQOL API. The samples of numpy arrays are read in
+// place through the buffer protocol, and the GIL is released while they are
+// compared, so that comparisons on Python threads run in parallel.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+#include "google/protobuf/util/json_util.h"
+#include "pybind11/numpy.h"
+#include "pybind11/pybind11.h"
+
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_api.h"
+#include "visqol_config.pb.h"      // Generated by cc_proto_library rule
+
+namespace py = pybind11;
+
+namespace Visqol {
+namespace {
+// Raise the error of a status that is not ok as a Python exception. Invalid
+// arguments raise a ValueError, and every other error a RuntimeError.
+void ThrowIfError(const google::protobuf::util::Status &status) {
+  if (status.ok()) {
+    return;
+  }
+  if (status.error_code() ==
+      google::protobuf::util::error::INVALID_ARGUMENT) {
+    throw py::value_error(status.ToString());
+  }
+  throw std::runtime_error(status.ToString());
+}
+
+// Create an instance of the API from a config.
+std::unique_ptr<VisqolApi> CreateApi(const VisqolConfig &config) {
+  auto api = absl::make_unique<VisqolApi>();
+  ThrowIfError(api->Create(config));
+  return api;
+}
+
+// Create an instance of the API from a sample rate and a dict of the fields
+// of VisqolConfig.VisqolOptions, keyed by their proto field names.
+std::unique_ptr<VisqolApi> CreateApiFromOptions(int sample_rate,
+                                                py::object options) {
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(sample_rate);
+  if (!options.is_none()) {
+    const std::string options_json =
+        py::module::import("json").attr("dumps")(options).cast<std::string>();
+    ThrowIfError(google::protobuf::util::JsonStringToMessage(
+        options_json, config.mutable_options()));
+  }
+  return CreateApi(config);
+}
+
+// Create an instance of the API from a serialized VisqolConfig.
+std::unique_ptr<VisqolApi> CreateApiFromConfig(py::bytes serialized_config) {
+  VisqolConfig config;
+  if (!config.ParseFromString(std::string(serialized_config))) {
+    throw py::value_error("Unable to parse the serialized VisqolConfig.");
+  }
+  return CreateApi(config);
+}
+
+// The samples of a one dimensional array, which must be contiguous.
+template <typename T>
+absl::Span<const T> SamplesOf(const py::array &array) {
+  return absl::Span<const T>(static_cast<const T *>(array.data()),
+                             array.shape(0));
+}
+
+// True if an array holds contiguous samples of a type.
+template <typename T>
+bool HoldsContiguous(const py::array &array) {
+  return py::isinstance<py::array_t<T>>(array) &&
+         (array.flags() & py::array::c_style);
+}
+
+// Compare two signals, reading the samples of the arrays in place. The
+// arrays of float64, float32 and int16 samples are read without a copy, as
+// long as they are contiguous and both have the same type. Any other arrays
+// are converted to float64 first. The GIL is released while they are
+// compared.
+SimilarityResultMsg Measure(const VisqolApi &api, py::array reference,
+                            py::array degraded) {
+  if (reference.ndim() != 1 || degraded.ndim() != 1) {
+    throw py::value_error("The signals must be one dimensional arrays.");
+  }
+  google::protobuf::util::StatusOr<SimilarityResultMsg> result;
+  if (HoldsContiguous<float>(reference) && HoldsContiguous<float>(degraded)) {
+    const auto ref_samples = SamplesOf<float>(reference);
+    const auto deg_samples = SamplesOf<float>(degraded);
+    py::gil_scoped_release release;
+    result = api.Measure(ref_samples, deg_samples);
+  } else if (HoldsContiguous<int16_t>(reference) &&
+             HoldsContiguous<int16_t>(degraded)) {
+    const auto ref_samples = SamplesOf<int16_t>(reference);
+    const auto deg_samples = SamplesOf<int16_t>(degraded);
+    py::gil_scoped_release release;
+    result = api.Measure(ref_samples, deg_samples);
+  } else {
+    // Converting returns the array itself when it already holds contiguous
+    // float64 samples. The samples are only read, so the span of the
+    // mutable samples that Measure takes does not modify them.
+    using DoubleArray =
+        py::array_t<double, py::array::c_style | py::array::forcecast>;
+    const DoubleArray ref_array = DoubleArray::ensure(reference);
+    const DoubleArray deg_array = DoubleArray::ensure(degraded);
+    if (!ref_array || !deg_array) {
+      throw py::value_error("The signals must hold numeric samples.");
+    }
+    const absl::Span<double> ref_samples(
+        const_cast<double *>(ref_array.data()), ref_array.shape(0));
+    const absl::Span<double> deg_samples(
+        const_cast<double *>(deg_array.data()), deg_array.shape(0));
+    py::gil_scoped_release release;
+    result = api.Measure(ref_samples, deg_samples);
+  }
+  ThrowIfError(result.status());
+  return result.ValueOrDie();
+}
+
+// Convert a result to a dict, keyed by the proto field names.
+py::object ToDict(const SimilarityResultMsg &result) {
+  google::protobuf::util::JsonPrintOptions json_options;
+  json_options.preserve_proto_field_names = true;
+  std::string json;
+  ThrowIfError(
+      google::protobuf::util::MessageToJsonString(result, &json, json_options));
+  return py::module::import("json").attr("loads")(json);
+}
+}  // namespace
+}  // namespace Visqol
+
+PYBIND11_MODULE(visqol_py, m) {
+  using Visqol::VisqolApi;
+
+  m.doc() = "Python bindings of the ViSQOL API.";
+
+  py::class_<VisqolApi>(m, "VisqolApi", R"doc(
+Compares audio signals that are held in numpy arrays.
+
+An instance may be shared by any number of Python threads. The GIL is
+released while signals are compared, so comparisons on different threads
+run in parallel.
+)doc")
+      .def(py::init(&Visqol::CreateApiFromOptions), py::arg("sample_rate"),
+           py::arg("options") = py::none(), R"doc(
+Create an instance of ViSQOL for signals of a sample rate.
+
+Args:
+  sample_rate: The sample rate of the signals to compare.
+  options: A dict of the fields of VisqolConfig.VisqolOptions, keyed by their
+    proto field names, such as {"use_speech_scoring": True}.
+
+Raises:
+  ValueError: If the config is not valid.
+)doc")
+      .def_static("from_config", &Visqol::CreateApiFromConfig,
+                  py::arg("config"), R"doc(
+Create an instance of ViSQOL from a serialized VisqolConfig.
+
+Raises:
+  ValueError: If the config can not be parsed or is not valid.
+)doc")
+      .def(
+          "measure",
+          [](const VisqolApi &api, py::array reference, py::array degraded) {
+            return Visqol::ToDict(Visqol::Measure(api, reference, degraded));
+          },
+          py::arg("reference"), py::arg("degraded"), R"doc(
+Compare a degraded signal to a reference signal.
+
+Contiguous one dimensional arrays of float64, float32 or int16 samples are
+read in place, as long as both arrays have the same type. int16 samples are
+normalized to [-1, 1) as samples of wav files are. Other arrays are converted
+to float64 first. The arrays must not be modified until the comparison
+returns.
+
+Returns:
+  The SimilarityResultMsg of the comparison as a dict, keyed by the proto
+  field names.
+
+Raises:
+  ValueError: If the signals are not valid.
+  RuntimeError: If the comparison fails.
+)doc")
+      .def(
+          "measure_proto",
+          [](const VisqolApi &api, py::array reference, py::array degraded) {
+            const std::string serialized =
+                Visqol::Measure(api, reference, degraded).SerializeAsString();
+            return py::bytes(serialized);
+          },
+          py::arg("reference"), py::arg("degraded"), R"doc(
+Compare a degraded signal to a reference signal, as measure does.
+
+Returns:
+  The serialized SimilarityResultMsg of the comparison.
+)doc");
+}
@@ -0,0 +1,93 @@
+# Copyright 2019 Google LLC, Andrew Hines
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests of the Python bindings of the ViSQOL API."""
+
+from concurrent import futures
+import unittest
+import wave
+
+import numpy as np
+
+from src.python import visqol_py
+
+REF_PATH = "testdata/clean_speech/CA01_01.wav"
+DEG_PATH = "testdata/clean_speech/transcoded_CA01_01.wav"
+SAMPLE_RATE = 48000
+SPEECH_OPTIONS = {"use_speech_scoring": True}
+
+
+def load_samples(path):
+  """Loads the 16 bit samples of a mono wav file."""
+  with wave.open(path, "rb") as wav:
+    return np.frombuffer(wav.readframes(wav.getnframes()), dtype=np.int16)
+
+
+class VisqolPyTest(unittest.TestCase):
+
+  def setUp(self):
+    super().setUp()
+    self.ref = load_samples(REF_PATH)
+    self.deg = load_samples(DEG_PATH)
+
+  def test_identical_signals_score_perfectly(self):
+    api = visqol_py.VisqolApi(SAMPLE_RATE, SPEECH_OPTIONS)
+    ref = self.ref / 32768.0
+    result = api.measure(ref, ref)
+    self.assertAlmostEqual(5.0, result["moslqo"], places=4)
+
+  def test_sample_types_give_the_same_score(self):
+    api = visqol_py.VisqolApi(SAMPLE_RATE, SPEECH_OPTIONS)
+    ref = self.ref / 32768.0
+    deg = self.deg / 32768.0
+    expected = api.measure(ref, deg)["moslqo"]
+    self.assertEqual(expected, api.measure(self.ref, self.deg)["moslqo"])
+    self.assertAlmostEqual(
+        expected,
+        api.measure(ref.astype(np.float32), deg.astype(np.float32))["moslqo"],
+        places=4)
+    # Arrays that are not contiguous are converted.
+    self.assertEqual(
+        expected,
+        api.measure(np.repeat(ref, 2)[::2], np.repeat(deg, 2)[::2])["moslqo"])
+
+  def test_threads_share_an_instance(self):
+    api = visqol_py.VisqolApi(SAMPLE_RATE, SPEECH_OPTIONS)
+    expected = api.measure(self.ref, self.deg)["moslqo"]
+    with futures.ThreadPoolExecutor(max_workers=4) as pool:
+      results = list(
+          pool.map(lambda _: api.measure(self.ref, self.deg), range(8)))
+    for result in results:
+      self.assertEqual(expected, result["moslqo"])
+
+  def test_measure_proto_returns_the_serialized_result(self):
+    api = visqol_py.VisqolApi(SAMPLE_RATE, SPEECH_OPTIONS)
+    serialized = api.measure_proto(self.ref, self.deg)
+    self.assertIsInstance(serialized, bytes)
+    self.assertGreater(len(serialized), 0)
+
+  def test_invalid_arguments_raise_value_errors(self):
+    with self.assertRaises(ValueError):
+      visqol_py.VisqolApi(44100)
+    with self.assertRaises(ValueError):
+      visqol_py.VisqolApi(SAMPLE_RATE, {"no_such_option": True})
+    with self.assertRaises(ValueError):
+      visqol_py.VisqolApi.from_config(b"not a config")
+    api = visqol_py.VisqolApi(SAMPLE_RATE, SPEECH_OPTIONS)
+    with self.assertRaises(ValueError):
+      api.measure(np.zeros((2, 2)), np.zeros((2, 2)))
+
+
+if __name__ == "__main__":
+  unittest.main()
@@ -0,0 +1,93 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference_aligner.h"
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+
+#include "alignment.h"
+#include "envelope.h"
+#include "fast_fourier_transform.h"
+#include "xcorr.h"
+
+namespace Visqol {
+
+ReferenceAligner::ReferenceAligner(const AudioSignal &ref_signal)
+    : ref_upper_env_(Envelope::CalcUpperEnv(ref_signal.data_matrix)
+                         .ToVector()),
+      ref_num_samples_(ref_signal.data_matrix.NumRows()),
+      ref_sample_rate_(ref_signal.sample_rate) {}
+
+ReferenceAligner::ReferenceAligner(std::vector<double> ref_upper_env,
+                                   size_t ref_num_samples,
+                                   size_t ref_sample_rate)
+    : ref_upper_env_(std::move(ref_upper_env)),
+      ref_num_samples_(ref_num_samples),
+      ref_sample_rate_(ref_sample_rate) {}
+
+std::tuple<AudioSignal, double> ReferenceAligner::GloballyAlign(
+    const AudioSignal &deg_signal) {
+  auto deg_upper_env = Envelope::CalcUpperEnv(deg_signal.data_matrix);
+  auto best_lag = CalcBestLag(deg_upper_env);
+  return Alignment::ApplyGlobalLag(deg_signal, best_lag, ref_num_samples_);
+}
+
+int64_t ReferenceAligner::CalcBestLag(const AMatrix<double> &deg_upper_env) {
+  const size_t biggest_vec = std::max(ref_upper_env_.size(),
+                                      deg_upper_env.NumRows());
+  const int64_t max_lag = static_cast<int64_t>(biggest_vec) - 1;
+  PrepareReferenceSpectrum(XCorr::CalcFftPoints(biggest_vec));
+  const size_t fft_size = fft_manager_->GetFftSize();
+
+  AudioChannel deg_spectrum;
+  deg_spectrum.Init(fft_size);
+  FastFourierTransform::ForwardReal1d(
+      fft_manager_,
+      XCorr::CircularlyReverse(deg_upper_env.ToVector(), fft_size),
+      &deg_spectrum);
+
+  AudioChannel pwise_prod;
+  pwise_prod.Init(fft_size);
+  pwise_prod.Clear();
+  fft_manager_->ZConvolveAccumulate(*ref_spectrum_, deg_spectrum, &pwise_prod,
+                                    1.0f);
+  return XCorr::FindBestLag(
+      FastFourierTransform::InverseReal1d(fft_manager_, pwise_prod), max_lag);
+}
+
+bool ReferenceAligner::MatchesReference(const AudioSignal &signal) const {
+  return signal.data_matrix.NumRows() == ref_num_samples_ &&
+         signal.sample_rate == ref_sample_rate_;
+}
+
+void ReferenceAligner::PrepareReferenceSpectrum(size_t fft_points) {
+  if (fft_manager_ != nullptr &&
+      fft_manager_->GetSamplesPerChannel() == fft_points) {
+    return;
+  }
+  // The number of points only changes when a degraded signal is longer than
+  // the reference and crosses a power of 2, which is rare in a batch.
+  fft_manager_ = absl::make_unique<FftManager>(fft_points);
+  ref_spectrum_ = absl::make_unique<AudioChannel>();
+  ref_spectrum_->Init(fft_manager_->GetFftSize());
+  FastFourierTransform::ForwardReal1d(fft_manager_, ref_upper_env_,
+                                      ref_spectrum_.get());
+}
+}  // namespace Visqol
@@ -0,0 +1,84 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference_cache.h"
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "absl/synchronization/mutex.h"
+
+#include "file_path.h"
+#include "metrics.h"
+
+namespace Visqol {
+ReferenceCache::ReferenceCache(size_t capacity) : capacity_(capacity) {}
+
+std::string ReferenceCache::KeyOf(const FilePath &path) {
+  boost::system::error_code error;
+  const uintmax_t size = ::boost::filesystem::file_size(path.Path(), error);
+  if (error) {
+    return "";
+  }
+  const std::time_t modified = ::boost::filesystem::last_write_time(
+      path.Path(), error);
+  if (error) {
+    return "";
+  }
+  return path.Path() + '\n' + std::to_string(size) + '\n' +
+         std::to_string(modified);
+}
+
+std::shared_ptr<const ReferenceCache::Entry> ReferenceCache::Find(
+    const std::string &key) {
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(key);
+  Metrics::ReportReferenceCacheLookup(it != index_.end());
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void ReferenceCache::Insert(const std::string &key,
+                            std::shared_ptr<const Entry> entry) {
+  if (capacity_ == 0 || key.empty()) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+  entries_.emplace_front(key, std::move(entry));
+  index_[key] = entries_.begin();
+  while (entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+size_t ReferenceCache::Size() {
+  absl::MutexLock lock(&mutex_);
+  return entries_.size();
+}
+}  // namespace Visqol
@@ -0,0 +1,178 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference_feature_store.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+#include "reference_features.h"
+#include "reference_features.pb.h"  // Generated by cc_proto_library rule
+#include "spectrogram.h"
+
+namespace Visqol {
+const char ReferenceFeatureStore::kFileExtension[] = ".vqref";
+
+ReferenceFeatureStore::ReferenceFeatureStore(std::string dir,
+                                             uint64_t config_hash)
+    : dir_(std::move(dir)), config_hash_(config_hash) {}
+
+uint64_t ReferenceFeatureStore::Hash(const std::string &str) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : str) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string ReferenceFeatureStore::PathFor(const FilePath &reference) const {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016" PRIx64, Hash(reference.Path()));
+  return dir_ + "/" + name + kFileExtension;
+}
+
+std::unique_ptr<ReferenceFeatures> ReferenceFeatureStore::Load(
+    const FilePath &reference, const std::string &reference_key,
+    const AudioSignal &ref_signal) const {
+  const std::string path = PathFor(reference);
+  std::ifstream in(path, std::ios_base::binary);
+  if (!in) {
+    return nullptr;
+  }
+  const std::string contents((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+  ReferenceFeaturesMsg msg;
+  if (!msg.ParseFromString(contents)) {
+    ABSL_RAW_LOG(WARNING, "Ignoring unreadable reference features %s.",
+                 path.c_str());
+    return nullptr;
+  }
+  if (msg.config_hash() != config_hash_ ||
+      msg.reference_key() != reference_key ||
+      msg.num_samples() != ref_signal.data_matrix.NumRows() ||
+      msg.sample_rate() != ref_signal.sample_rate) {
+    ABSL_RAW_LOG(INFO, "Ignoring stale reference features %s of %s.",
+                 path.c_str(), reference.Path().c_str());
+    return nullptr;
+  }
+  return FromMsg(msg);
+}
+
+bool ReferenceFeatureStore::Save(const FilePath &reference,
+                                 const std::string &reference_key,
+                                 const AudioSignal &ref_signal,
+                                 const ReferenceFeatures &features) const {
+  ReferenceFeaturesMsg msg = ToMsg(reference_key, ref_signal, features);
+  msg.set_config_hash(config_hash_);
+  std::string contents;
+  if (!msg.SerializeToString(&contents)) {
+    return false;
+  }
+
+  const std::string path = PathFor(reference);
+  const std::string temp_path = path + ".tmp" +
+      ::boost::filesystem::unique_path().string();
+  {
+    std::ofstream out(temp_path, std::ios_base::binary | std::ios_base::trunc);
+    out.write(contents.data(), contents.size());
+    if (!out) {
+      ABSL_RAW_LOG(WARNING, "Error writing reference features %s.",
+                   temp_path.c_str());
+      return false;
+    }
+  }
+  boost::system::error_code error;
+  ::boost::filesystem::rename(temp_path, path, error);
+  if (error) {
+    ABSL_RAW_LOG(WARNING, "Error renaming reference features to %s: %s",
+                 path.c_str(), error.message().c_str());
+    ::boost::filesystem::remove(temp_path, error);
+    return false;
+  }
+  return true;
+}
+
+ReferenceFeaturesMsg ReferenceFeatureStore::ToMsg(
+    const std::string &reference_key, const AudioSignal &ref_signal,
+    const ReferenceFeatures &features) {
+  ReferenceFeaturesMsg msg;
+  msg.set_reference_key(reference_key);
+  msg.set_num_samples(ref_signal.data_matrix.NumRows());
+  msg.set_sample_rate(ref_signal.sample_rate);
+  const AMatrix<double> &spectrogram = features.spectrogram.Data();
+  msg.set_num_bands(spectrogram.NumRows());
+  msg.set_num_frames(spectrogram.NumCols());
+  const size_t num_values = spectrogram.NumRows() * spectrogram.NumCols();
+  msg.mutable_spectrogram()->Reserve(num_values);
+  for (size_t i = 0; i < num_values; i++) {
+    msg.add_spectrogram(spectrogram.data()[i]);
+  }
+  for (const double freq : features.spectrogram.GetCenterFreqBands()) {
+    msg.add_center_freq_bands(freq);
+  }
+  for (const size_t index : features.patch_indices) {
+    msg.add_patch_indices(index);
+  }
+  for (const double value : features.upper_envelope) {
+    msg.add_upper_envelope(value);
+  }
+  return msg;
+}
+
+std::unique_ptr<ReferenceFeatures> ReferenceFeatureStore::FromMsg(
+    const ReferenceFeaturesMsg &msg) {
+  const size_t num_values = static_cast<size_t>(msg.num_bands()) *
+                            msg.num_frames();
+  if (static_cast<size_t>(msg.spectrogram_size()) != num_values ||
+      static_cast<size_t>(msg.center_freq_bands_size()) != msg.num_bands()) {
+    return nullptr;
+  }
+  // The patches are searched from their start columns, which must lie in the
+  // spectrogram.
+  for (const uint64_t index : msg.patch_indices()) {
+    if (index >= msg.num_frames()) {
+      return nullptr;
+    }
+  }
+  auto features = absl::make_unique<ReferenceFeatures>();
+  features->spectrogram = Spectrogram(AMatrix<double>(
+      msg.num_bands(), msg.num_frames(),
+      std::vector<double>(msg.spectrogram().begin(),
+                          msg.spectrogram().end())));
+  features->spectrogram.SetCenterFreqBands(std::vector<double>(
+      msg.center_freq_bands().begin(), msg.center_freq_bands().end()));
+  features->patch_indices.assign(msg.patch_indices().begin(),
+                                 msg.patch_indices().end());
+  features->upper_envelope.assign(msg.upper_envelope().begin(),
+                                  msg.upper_envelope().end());
+  return features;
+}
+}  // namespace Visqol
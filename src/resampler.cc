@@ -0,0 +1,179 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+
+namespace Visqol {
+namespace {
+// The number of taps of each phase is a multiple of this, so that the dot
+// products have no remainder for any of the SIMD widths below.
+constexpr size_t kTapAlignment = 4;
+
+// The greatest common divisor of two sample rates.
+size_t GreatestCommonDivisor(size_t a, size_t b) {
+  while (b != 0) {
+    a %= b;
+    std::swap(a, b);
+  }
+  return a;
+}
+
+// The dot product of two arrays of a multiple of kTapAlignment values.
+inline double DotProduct(const double *a, const double *b, size_t n) {
+#if defined(__AVX__)
+  __m256d sum = _mm256_setzero_pd();
+  for (size_t i = 0; i < n; i += 4) {
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                           _mm256_loadu_pd(b + i)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, sum);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+  __m128d sum = _mm_setzero_pd();
+  for (size_t i = 0; i < n; i += 2) {
+    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                     _mm_loadu_pd(b + i)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, sum);
+  return lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  float64x2_t sum = vdupq_n_f64(0.0);
+  for (size_t i = 0; i < n; i += 2) {
+    sum = vaddq_f64(sum, vmulq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+  }
+  return vgetq_lane_f64(sum, 0) + vgetq_lane_f64(sum, 1);
+#else
+  double sum = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+#endif
+}
+}  // namespace
+
+const size_t Resampler::kZeroCrossings = 16;
+const double Resampler::kCutoff = 0.95;
+
+Resampler::Resampler(size_t input_rate, size_t output_rate)
+    : input_rate_(input_rate), output_rate_(output_rate) {
+  const size_t divisor = GreatestCommonDivisor(input_rate, output_rate);
+  up_factor_ = output_rate / divisor;
+  down_factor_ = input_rate / divisor;
+
+  // When downsampling, the filter is stretched over the input samples so
+  // that it cuts off below the output Nyquist frequency.
+  const double scale = std::min(1.0, static_cast<double>(output_rate) /
+                                     input_rate);
+  const double cutoff = kCutoff * scale;
+  const size_t half_width = static_cast<size_t>(
+      std::ceil(kZeroCrossings / scale));
+  num_taps_before_ = half_width - 1;
+  num_taps_ = (2 * half_width + kTapAlignment - 1) / kTapAlignment *
+      kTapAlignment;
+
+  // Phase p holds the taps for an output position p / L of the way from one
+  // input sample to the next, for the input samples from num_taps_before_
+  // before it to half_width after it.
+  taps_.assign(up_factor_ * num_taps_, 0.0);
+  for (size_t phase = 0; phase < up_factor_; phase++) {
+    double *taps = &taps_[phase * num_taps_];
+    const double fraction = static_cast<double>(phase) / up_factor_;
+    double sum = 0.0;
+    for (size_t k = 0; k < 2 * half_width; k++) {
+      const double offset = static_cast<double>(k) - num_taps_before_ -
+          fraction;
+      if (std::abs(offset) >= half_width) {
+        continue;
+      }
+      const double x = M_PI * offset / half_width;
+      const double window = 0.42 + 0.5 * std::cos(x) + 0.08 * std::cos(2 * x);
+      const double sinc = offset == 0.0 ? 1.0 :
+          std::sin(M_PI * cutoff * offset) / (M_PI * cutoff * offset);
+      taps[k] = cutoff * sinc * window;
+      sum += taps[k];
+    }
+    // Normalize each phase for unity gain at DC.
+    for (size_t k = 0; k < 2 * half_width; k++) {
+      taps[k] /= sum;
+    }
+  }
+}
+
+size_t Resampler::GetNumOutputSamples(size_t num_input_samples) const {
+  return (static_cast<uint64_t>(num_input_samples) * up_factor_ +
+          down_factor_ - 1) / down_factor_;
+}
+
+void Resampler::Process(absl::Span<const double> signal,
+                        absl::Span<double> output) const {
+  const int64_t num_input = signal.size();
+  size_t phase = 0;
+  int64_t position = 0;
+  for (size_t n = 0; n < output.size(); n++) {
+    const double *taps = &taps_[phase * num_taps_];
+    const int64_t first = position - static_cast<int64_t>(num_taps_before_);
+    if (first >= 0 && first + static_cast<int64_t>(num_taps_) <= num_input) {
+      output[n] = DotProduct(taps, &signal[first], num_taps_);
+    } else {
+      // The signal is zero padded at the edges.
+      double y = 0.0;
+      const int64_t begin = std::max<int64_t>(first, 0);
+      const int64_t end = std::min<int64_t>(first + num_taps_, num_input);
+      for (int64_t i = begin; i < end; i++) {
+        y += taps[i - first] * signal[i];
+      }
+      output[n] = y;
+    }
+    // Step the output position on by M / L input samples.
+    phase += down_factor_;
+    position += phase / up_factor_;
+    phase %= up_factor_;
+  }
+}
+
+AudioSignal Resampler::Resample(AudioSignal signal, size_t output_rate) {
+  if (signal.sample_rate == output_rate) {
+    return signal;
+  }
+  const Resampler resampler(signal.sample_rate, output_rate);
+  const size_t num_input = signal.data_matrix.NumRows();
+  AMatrix<double> resampled(resampler.GetNumOutputSamples(num_input), 1);
+  resampler.Process(
+      absl::Span<const double>(signal.data_matrix.data(), num_input),
+      absl::Span<double>(resampled.mutData(), resampled.NumRows()));
+  return AudioSignal{std::move(resampled), output_rate};
+}
+}  // namespace Visqol
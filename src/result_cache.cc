@@ -0,0 +1,202 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "result_cache.pb.h"  // Generated by cc_proto_library rule
+#include "results_proto_stream.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t HashWord(uint64_t hash, uint64_t word) {
+  return (hash ^ word) * kFnvPrime;
+}
+
+ResultCache::Key KeyOfEntry(const ResultCacheEntryMsg &entry) {
+  return {entry.reference_hash(), entry.degraded_hash(), entry.config_hash()};
+}
+}  // namespace
+
+std::shared_ptr<ResultCache> ResultCache::Open(const std::string &path) {
+  static absl::Mutex *const mutex = new absl::Mutex;
+  static auto *const caches =
+      new std::map<std::string, std::weak_ptr<ResultCache>>;
+  absl::MutexLock lock(mutex);
+  std::shared_ptr<ResultCache> cache = (*caches)[path].lock();
+  if (cache == nullptr) {
+    cache = std::make_shared<ResultCache>(path);
+    if (!cache->ok()) {
+      ABSL_RAW_LOG(ERROR, "Unable to open the result cache %s.",
+                   path.c_str());
+      return nullptr;
+    }
+    (*caches)[path] = cache;
+  }
+  return cache;
+}
+
+ResultCache::ResultCache(const std::string &path) {
+  bool complete = true;
+  if (FilePath(path).Exists()) {
+    ResultsProtoReader reader{FilePath(path)};
+    ResultCacheEntryMsg entry;
+    while (reader.Next(&entry)) {
+      results_[KeyOfEntry(entry)] = entry.result().SerializeAsString();
+    }
+    complete = reader.ok();
+  }
+
+  if (!complete) {
+    // A run that was killed while it appended a result leaves a partial
+    // record at the end of the file, after which appended records could not
+    // be read. The file is written again with the results that were read,
+    // under a temporary name that is then renamed.
+    ABSL_RAW_LOG(WARNING, "Rewriting the result cache %s after an unreadable"
+                 " record.", path.c_str());
+    const std::string temp_path = path + ".tmp";
+    {
+      ResultsProtoWriter rewriter{FilePath(temp_path)};
+      ResultCacheEntryMsg entry;
+      for (const auto &result : results_) {
+        entry.set_reference_hash(result.first.reference_hash);
+        entry.set_degraded_hash(result.first.degraded_hash);
+        entry.set_config_hash(result.first.config_hash);
+        entry.mutable_result()->ParseFromString(result.second);
+        rewriter.Write(entry);
+      }
+    }
+    boost::system::error_code error;
+    ::boost::filesystem::rename(temp_path, path, error);
+    if (error) {
+      ABSL_RAW_LOG(ERROR, "Unable to rewrite the result cache %s.",
+                   path.c_str());
+      return;
+    }
+  }
+  writer_ = absl::make_unique<ResultsProtoWriter>(FilePath(path));
+}
+
+bool ResultCache::ok() const {
+  absl::MutexLock lock(&mutex_);
+  return writer_ != nullptr && writer_->ok();
+}
+
+uint64_t ResultCache::HashSignal(const AudioSignal &signal) {
+  const size_t num_samples = signal.data_matrix.NumElements();
+  uint64_t hash = HashWord(kFnvOffset, signal.sample_rate);
+  hash = HashWord(hash, signal.data_matrix.NumCols());
+  hash = HashWord(hash, num_samples);
+  const double *samples = signal.data_matrix.data();
+  for (size_t i = 0; i < num_samples; i++) {
+    uint64_t bits;
+    std::memcpy(&bits, &samples[i], sizeof(bits));
+    hash = HashWord(hash, bits);
+  }
+  return hash;
+}
+
+std::vector<uint64_t> ResultCache::HashSignalBlocks(const AudioSignal &signal,
+                                                    size_t block_samples) {
+  const size_t num_samples = signal.data_matrix.NumElements();
+  const double *samples = signal.data_matrix.data();
+  std::vector<uint64_t> hashes;
+  hashes.reserve((num_samples + block_samples - 1) / block_samples);
+  for (size_t start = 0; start < num_samples; start += block_samples) {
+    const size_t end = std::min(start + block_samples, num_samples);
+    uint64_t hash = HashWord(kFnvOffset, signal.sample_rate);
+    hash = HashWord(hash, end - start);
+    for (size_t i = start; i < end; i++) {
+      uint64_t bits;
+      std::memcpy(&bits, &samples[i], sizeof(bits));
+      hash = HashWord(hash, bits);
+    }
+    hashes.push_back(hash);
+  }
+  return hashes;
+}
+
+ResultCache::Key ResultCache::KeyOf(uint64_t config_hash,
+                                    const AudioSignal &ref_signal,
+                                    const AudioSignal &deg_signal) {
+  return {HashSignal(ref_signal), HashSignal(deg_signal), config_hash};
+}
+
+bool ResultCache::Find(const Key &key,
+                       SimilarityResultMsg *sim_res_msg) const {
+  std::string serialized;
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto result = results_.find(key);
+    if (result == results_.end()) {
+      return false;
+    }
+    serialized = result->second;
+  }
+  return sim_res_msg->ParseFromString(serialized);
+}
+
+void ResultCache::Insert(const Key &key,
+                         const SimilarityResultMsg &sim_res_msg) {
+  ResultCacheEntryMsg entry;
+  entry.set_reference_hash(key.reference_hash);
+  entry.set_degraded_hash(key.degraded_hash);
+  entry.set_config_hash(key.config_hash);
+  SimilarityResultMsg *result = entry.mutable_result();
+  *result = sim_res_msg;
+  result->clear_reference_filepath();
+  result->clear_degraded_filepath();
+  result->clear_timings();
+  for (auto &channel : *result->mutable_channels()) {
+    channel.clear_timings();
+  }
+  const std::string serialized_result = result->SerializeAsString();
+  const std::string serialized_entry = entry.SerializeAsString();
+
+  absl::MutexLock lock(&mutex_);
+  if (!results_.emplace(key, serialized_result).second) {
+    return;
+  }
+  // Each result is flushed as it is added, so that the results of a run that
+  // is killed are kept.
+  writer_->WriteSerialized(serialized_entry);
+  writer_->Flush();
+}
+
+size_t ResultCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return results_.size();
+}
+}  // namespace Visqol
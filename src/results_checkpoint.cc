@@ -0,0 +1,92 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "results_checkpoint.h"
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "absl/base/internal/raw_logging.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+std::vector<ReferenceDegradedPathPair> ResultsCheckpoint::RemoveScoredPairs(
+    const std::vector<ReferenceDegradedPathPair> &pairs,
+    const FilePath &results_csv) {
+  if (!results_csv.Exists()) {
+    return pairs;
+  }
+  std::string contents;
+  {
+    std::ifstream in(results_csv.Path(), std::ios_base::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  // Every complete row ends with a newline, so anything after the last one
+  // was cut short.
+  const size_t complete_size = contents.rfind('\n') + 1;
+  if (complete_size != contents.size()) {
+    ABSL_RAW_LOG(WARNING, "Truncating a partial row from %s.",
+                 results_csv.Path().c_str());
+    contents.resize(complete_size);
+    if (complete_size == 0) {
+      // Not even the header is complete, so start the file afresh.
+      ::boost::filesystem::remove(results_csv.Path());
+      return pairs;
+    }
+    ::boost::filesystem::resize_file(results_csv.Path(), complete_size);
+  }
+
+  // The number of results of each reference/degraded pair.
+  std::map<std::pair<std::string, std::string>, size_t> num_results;
+  std::istringstream rows(contents);
+  std::string row;
+  std::getline(rows, row);  // skip the header
+  while (std::getline(rows, row)) {
+    if (!row.empty() && row.back() == '\r') {
+      row.pop_back();
+    }
+    std::istringstream fields(row);
+    std::string reference, degraded, score;
+    if (std::getline(fields, reference, ',') &&
+        std::getline(fields, degraded, ',') &&
+        std::getline(fields, score, ',') && !score.empty()) {
+      num_results[{reference, degraded}]++;
+    }
+  }
+
+  std::vector<ReferenceDegradedPathPair> remaining;
+  for (const auto &pair : pairs) {
+    auto results = num_results.find({pair.reference.Path(),
+                                     pair.degraded.Path()});
+    if (results != num_results.end() && results->second > 0) {
+      results->second--;
+    } else {
+      remaining.push_back(pair);
+    }
+  }
+  ABSL_RAW_LOG(INFO, "Resuming with %zu of %zu pairs left to compare.",
+               remaining.size(), pairs.size());
+  return remaining;
+}
+}  // namespace Visqol
@@ -0,0 +1,157 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "results_merger.h"
+
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/stubs/status.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+using google::protobuf::util::Status;
+using google::protobuf::util::error::Code;
+
+// Read a line, stripping the \r of a \r\n line ending.
+bool ReadLine(std::ifstream &in, std::string &line) {
+  if (!std::getline(in, line)) {
+    return false;
+  }
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  return true;
+}
+
+// The reference and degraded paths at the start of a CSV line, which
+// identify its pair.
+std::string PairKey(const std::string &line) {
+  const size_t first_comma = line.find(',');
+  if (first_comma == std::string::npos) {
+    return line;
+  }
+  return line.substr(0, line.find(',', first_comma + 1));
+}
+
+Status OpenError(const FilePath &path) {
+  return Status(Code::NOT_FOUND, "Failed to open " + path.Path() + ".");
+}
+}  // namespace
+
+Status ResultsMerger::MergeResultsCSVs(
+    const std::vector<FilePath> &shard_csvs,
+    const FilePath &batch_input_csv, const FilePath &merged_csv) {
+  std::string header;
+  std::vector<std::string> rows;
+  for (const FilePath &shard_csv : shard_csvs) {
+    std::ifstream in(shard_csv.Path());
+    if (!in) {
+      return OpenError(shard_csv);
+    }
+    std::string line;
+    if (!ReadLine(in, line)) {
+      continue;  // A shard with no pairs.
+    }
+    if (header.empty()) {
+      header = line;
+    } else if (line != header) {
+      return Status(Code::INVALID_ARGUMENT, "The header of " +
+          shard_csv.Path() + " differs from the other shards: " + line);
+    }
+    while (ReadLine(in, line)) {
+      if (!line.empty()) {
+        rows.push_back(line);
+      }
+    }
+  }
+
+  std::vector<std::string> ordered_rows;
+  if (batch_input_csv.Path().empty()) {
+    ordered_rows = std::move(rows);
+  } else {
+    std::ifstream batch(batch_input_csv.Path());
+    if (!batch) {
+      return OpenError(batch_input_csv);
+    }
+    // The rows of each pair, in shard order, so that a pair that is listed
+    // more than once in the batch is matched up in order.
+    std::map<std::string, std::deque<size_t>> rows_by_pair;
+    for (size_t i = 0; i < rows.size(); i++) {
+      rows_by_pair[PairKey(rows[i])].push_back(i);
+    }
+    std::vector<bool> is_written(rows.size(), false);
+    std::string line;
+    ReadLine(batch, line);  // skip the header
+    while (ReadLine(batch, line)) {
+      auto pair_rows = rows_by_pair.find(PairKey(line));
+      if (pair_rows == rows_by_pair.end() || pair_rows->second.empty()) {
+        continue;  // The pair failed, or its shard has not been merged.
+      }
+      const size_t row = pair_rows->second.front();
+      pair_rows->second.pop_front();
+      ordered_rows.push_back(rows[row]);
+      is_written[row] = true;
+    }
+    for (size_t i = 0; i < rows.size(); i++) {
+      if (!is_written[i]) {
+        ordered_rows.push_back(rows[i]);
+      }
+    }
+  }
+
+  std::ofstream out(merged_csv.Path(), std::ios_base::trunc);
+  if (!out) {
+    return OpenError(merged_csv);
+  }
+  if (!header.empty()) {
+    out << header << "\n";
+  }
+  for (const std::string &row : ordered_rows) {
+    out << row << "\n";
+  }
+  out.close();
+  return out ? Status() : Status(Code::INTERNAL,
+      "Failed to write " + merged_csv.Path() + ".");
+}
+
+Status ResultsMerger::ConcatenateFiles(
+    const std::vector<FilePath> &shard_files, const FilePath &merged_file) {
+  std::ofstream out(merged_file.Path(),
+                    std::ios_base::binary | std::ios_base::trunc);
+  if (!out) {
+    return OpenError(merged_file);
+  }
+  for (const FilePath &shard_file : shard_files) {
+    std::ifstream in(shard_file.Path(), std::ios_base::binary);
+    if (!in) {
+      return OpenError(shard_file);
+    }
+    // An empty file would set the failbit of the output.
+    if (in.peek() != std::ifstream::traits_type::eof()) {
+      out << in.rdbuf();
+    }
+  }
+  out.close();
+  return out ? Status() : Status(Code::INTERNAL,
+      "Failed to write " + merged_file.Path() + ".");
+}
+}  // namespace Visqol
@@ -0,0 +1,105 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "results_proto_stream.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message_lite.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+
+ResultsProtoWriter::ResultsProtoWriter(const FilePath &path)
+    : file_(path.Path(), std::ios_base::binary | std::ios_base::app) {
+  if (file_) {
+    output_ = absl::make_unique<google::protobuf::io::OstreamOutputStream>(
+        &file_);
+    coded_output_ =
+        absl::make_unique<google::protobuf::io::CodedOutputStream>(
+            output_.get());
+  }
+}
+
+ResultsProtoWriter::~ResultsProtoWriter() { Flush(); }
+
+bool ResultsProtoWriter::ok() const {
+  return coded_output_ != nullptr && !coded_output_->HadError() &&
+         static_cast<bool>(file_);
+}
+
+void ResultsProtoWriter::Write(const google::protobuf::MessageLite &msg) {
+  WriteSerialized(msg.SerializeAsString());
+}
+
+void ResultsProtoWriter::WriteSerialized(const std::string &serialized) {
+  if (coded_output_ == nullptr) {
+    return;
+  }
+  coded_output_->WriteVarint32(static_cast<uint32_t>(serialized.size()));
+  coded_output_->WriteString(serialized);
+}
+
+void ResultsProtoWriter::Flush() {
+  if (coded_output_ == nullptr) {
+    return;
+  }
+  // The coded and zero copy streams only hand their buffers on when they are
+  // destroyed, so they are recreated after each flush.
+  coded_output_.reset();
+  output_.reset();
+  file_.flush();
+  output_ = absl::make_unique<google::protobuf::io::OstreamOutputStream>(
+      &file_);
+  coded_output_ = absl::make_unique<google::protobuf::io::CodedOutputStream>(
+      output_.get());
+}
+
+ResultsProtoReader::ResultsProtoReader(const FilePath &path)
+    : file_(path.Path(), std::ios_base::binary), ok_(file_.is_open()) {
+  if (ok_) {
+    input_ = absl::make_unique<google::protobuf::io::IstreamInputStream>(
+        &file_);
+  }
+}
+
+bool ResultsProtoReader::Next(google::protobuf::MessageLite *msg) {
+  if (!ok_) {
+    return false;
+  }
+  // A coded stream per record, so that the total bytes limit of the coded
+  // stream does not cap the size of the file.
+  google::protobuf::io::CodedInputStream coded_input(input_.get());
+  uint32_t size;
+  if (!coded_input.ReadVarint32(&size)) {
+    // The end of the file, unless part of a size was read.
+    ok_ = coded_input.CurrentPosition() == 0;
+    return false;
+  }
+  const auto limit = coded_input.PushLimit(size);
+  if (!msg->ParseFromCodedStream(&coded_input) ||
+      !coded_input.ConsumedEntireMessage()) {
+    ok_ = false;
+    return false;
+  }
+  coded_input.PopLimit(limit);
+  return true;
+}
+}  // namespace Visqol
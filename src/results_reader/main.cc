@@ -0,0 +1,57 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Prints the records of a --results_proto file, one result per line of JSON.
+
+#include <iostream>
+#include <string>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "google/protobuf/util/json_util.h"
+
+#include "file_path.h"
+#include "results_proto_stream.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+ABSL_FLAG(std::string, results_proto, "",
+"The --results_proto file to read.");
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  const std::string path = absl::GetFlag(FLAGS_results_proto);
+  if (path.empty()) {
+    ABSL_RAW_LOG(ERROR, "Set --results_proto to the file to read.");
+    return -1;
+  }
+
+  Visqol::ResultsProtoReader reader{Visqol::FilePath(path)};
+  Visqol::SimilarityResultMsg sim_res_msg;
+  google::protobuf::util::JsonPrintOptions json_options;
+  json_options.preserve_proto_field_names = true;
+  while (reader.Next(&sim_res_msg)) {
+    std::string json;
+    google::protobuf::util::MessageToJsonString(sim_res_msg, &json,
+                                                json_options);
+    std::cout << json << "\n";
+  }
+  std::cout << std::flush;
+  if (!reader.ok()) {
+    ABSL_RAW_LOG(ERROR, "Unable to read the records of %s.", path.c_str());
+    return -1;
+  }
+  return 0;
+}
@@ -14,12 +14,16 @@
 
 #include "rms_vad.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <vector>
 
-namespace Visqol {
+#include "absl/types/span.h"
+
+#include "simd_dispatch.h"
 
+namespace Visqol {
 const std::size_t RmsVad::kSilentChunkCount = 3;
 const double RmsVad::kRmsThreshold = 5000.0;
 const double RmsVad::kVoiceActivityPresent = 1.0;
@@ -33,13 +37,30 @@ RmsVad::RmsVad() {
   }
 }
 
-double RmsVad::ProcessChunk(std::vector<int16_t> chunk) {
-  const double rms = CalcRootMeanSquare(chunk);
-  if (rms < kRmsThreshold) {
-    each_chunk_result_.push_back(kVoiceActivityAbsent);
-  } else {
-    each_chunk_result_.push_back(kVoiceActivityPresent);
+void RmsVad::Reserve(std::size_t num_chunks) {
+  each_chunk_result_.reserve(num_chunks);
+  vad_results_.reserve(std::max(num_chunks, kSilentChunkCount - 1));
+}
+
+double RmsVad::ProcessChunk(absl::Span<const int16_t> chunk) {
+  double square = 0.0;
+  for (const int16_t sample : chunk) {
+    square += static_cast<double>(sample) * sample;
   }
+  return AddChunkResult(
+      std::sqrt(square / static_cast<double>(chunk.size())));
+}
+
+double RmsVad::ProcessChunk(absl::Span<const double> chunk,
+                            const double peak) {
+  const double square = SimdDispatch::Kernels().sum_of_squared_samples(
+      chunk.data(), chunk.size(), peak);
+  return AddChunkResult(
+      std::sqrt(square / static_cast<double>(chunk.size())));
+}
+
+double RmsVad::AddChunkResult(const double rms) {
+  each_chunk_result_.push_back(!(rms < kRmsThreshold));
   return rms;
 }
 
@@ -59,20 +80,10 @@ std::vector<double> RmsVad::GetVadResults() {
   return vad_results_;
 }
 
-double RmsVad::CalcRootMeanSquare(std::vector<int16_t> chunk) {
-    double square = 0.0;
-    double mean = 0.0;
-    for (std::size_t i = 0; i < chunk.size(); i++) {
-        square += std::pow(chunk[i], 2);
-    }
-    mean = square / static_cast<double>(chunk.size());
-    return std::sqrt(mean);
-}
-
 bool RmsVad::CheckPreviousChunksForSilence(const std::size_t idx) {
   bool previous_chunks_silent = true;
   for (std::size_t j = 1; j < kSilentChunkCount; j++) {
-    if (each_chunk_result_[idx - j] == kVoiceActivityPresent) {
+    if (each_chunk_result_[idx - j]) {
       previous_chunks_silent = false;
       break;
     }
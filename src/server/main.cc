@@ -0,0 +1,107 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Serves ViSQOL comparisons on a unix domain socket, keeping initialized
+// instances of ViSQOL warm between requests.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "metrics.h"
+#include "visqol_server.h"
+
+ABSL_FLAG(std::string, socket_path, "",
+"The path of the unix domain socket to serve requests on.");
+ABSL_FLAG(int, max_concurrent_requests, 0,
+"The maximum number of requests that are compared at once. 0 (the default)\n"
+"uses the number of hardware threads.");
+ABSL_FLAG(int, max_queued_requests, 64,
+"The maximum number of requests that wait for a comparison slot. Further\n"
+"requests are rejected with RESOURCE_EXHAUSTED.");
+ABSL_FLAG(std::string, metrics_output, "",
+"A path to write the metrics of the server to, every --metrics_interval\n"
+"seconds and on shutdown. The file is replaced at once, so it can be read\n"
+"by the textfile collector of the Prometheus node exporter.");
+ABSL_FLAG(std::string, metrics_format, "prometheus",
+"The format of the --metrics_output: 'text' or 'prometheus'.");
+ABSL_FLAG(double, metrics_interval, 10.0,
+"The interval, in seconds, at which the --metrics_output is written.");
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  const std::string socket_path = absl::GetFlag(FLAGS_socket_path);
+  const int max_concurrent_requests = absl::GetFlag(
+      FLAGS_max_concurrent_requests);
+  const int max_queued_requests = absl::GetFlag(FLAGS_max_queued_requests);
+  const std::string metrics_output = absl::GetFlag(FLAGS_metrics_output);
+  const std::string metrics_format = absl::GetFlag(FLAGS_metrics_format);
+  const double metrics_interval = absl::GetFlag(FLAGS_metrics_interval);
+  if (socket_path.empty() || max_concurrent_requests < 0 ||
+      max_queued_requests < 0 || metrics_interval <= 0.0 ||
+      (metrics_format != "text" && metrics_format != "prometheus")) {
+    ABSL_RAW_LOG(ERROR, "Invalid command line arg detected. Run with"
+                 " --helpfull for usage.");
+    return -1;
+  }
+
+  Visqol::VisqolServer server(max_concurrent_requests > 0 ?
+      max_concurrent_requests : std::thread::hardware_concurrency(),
+      max_queued_requests);
+
+  // The metrics are written on a thread of their own while the server runs.
+  Visqol::MetricsRegistry metrics;
+  std::mutex metrics_mutex;
+  std::condition_variable metrics_cv;
+  bool serving = true;
+  std::thread metrics_thread;
+  if (!metrics_output.empty()) {
+    Visqol::Metrics::SetSink(&metrics);
+    metrics_thread = std::thread([&]() {
+      const bool prometheus = metrics_format == "prometheus";
+      std::unique_lock<std::mutex> lock(metrics_mutex);
+      while (serving) {
+        metrics_cv.wait_for(lock,
+            std::chrono::duration<double>(metrics_interval));
+        if (!metrics.WriteToFile(metrics_output, prometheus)) {
+          ABSL_RAW_LOG(ERROR, "Error writing the metrics to %s.",
+                       metrics_output.c_str());
+        }
+      }
+    });
+  }
+
+  const auto status = server.Serve(socket_path);
+  if (metrics_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(metrics_mutex);
+      serving = false;
+    }
+    metrics_cv.notify_one();
+    metrics_thread.join();
+    Visqol::Metrics::SetSink(nullptr);
+  }
+  if (!status.ok()) {
+    ABSL_RAW_LOG(ERROR, "%s", status.error_message().ToString().c_str());
+    return -1;
+  }
+  return 0;
+}
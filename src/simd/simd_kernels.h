@@ -0,0 +1,114 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_SIMD_SIMD_KERNELS_H
+#define VISQOL_SIMD_SIMD_KERNELS_H
+
+#include <cstddef>
+
+namespace Visqol {
+/**
+ * The instruction sets that the SIMD kernels can be compiled for.
+ */
+enum class SimdIsa {
+  kScalar,
+  kSse2,
+  kAvx,
+  kAvx2,
+  kAvx512,
+  kNeon,
+};
+
+/**
+ * The number of stages of the gammatone filter cascade.
+ */
+constexpr size_t kGammatoneCascadeStages = 4;
+
+/**
+ * A set of the hot kernels of ViSQOL, all compiled for the same instruction
+ * set. Every set gives bit-identical results, so the set that is used only
+ * changes the speed of a comparison.
+ */
+struct SimdKernels {
+  /**
+   * The instruction set that the kernels were compiled for.
+   */
+  SimdIsa isa;
+
+  /**
+   * Run the gammatone filter cascade over a signal for every band, and write
+   * the filtered signal.
+   *
+   * The cascade coefficients hold a row of num_bands values per coefficient.
+   * The numerator coefficients of stage s are in rows (s * 3) to (s * 3 + 2),
+   * followed by the two rows of the shared denominator coefficients. The
+   * state holds the two delay rows of each stage, and is updated.
+   *
+   * @param coeffs The cascade coefficients.
+   * @param state The cascade state.
+   * @param num_bands The number of bands.
+   * @param signal The samples to filter.
+   * @param num_samples The number of samples.
+   * @param out The filtered samples, column major with a row per band.
+   */
+  void (*gammatone_filter)(const double *coeffs, double *state,
+                           size_t num_bands, const double *signal,
+                           size_t num_samples, double *out);
+
+  /**
+   * Run the gammatone filter cascade over a signal for every band, as
+   * gammatone_filter does, and add the sum of the squares of the filtered
+   * signal of each band to its energy.
+   */
+  void (*gammatone_energy)(const double *coeffs, double *state,
+                           size_t num_bands, const double *signal,
+                           size_t num_samples, double *energy);
+
+  /**
+   * The sum of the squares of the 16 bit samples that the samples of a chunk
+   * convert to, once they are normalized by the peak. Each sample is divided
+   * by the peak, scaled by 2^15, clamped to the range of 16 bit samples and
+   * truncated.
+   */
+  double (*sum_of_squared_samples)(const double *chunk, size_t n,
+                                   double peak);
+
+  /**
+   * MiscMath::FastLog10 of each input value. The output may be the input.
+   */
+  void (*fast_log10)(const double *input, double *output, size_t n);
+};
+
+/**
+ * @return The kernels compiled for the baseline instruction set of the build,
+ *    which every host that runs the build supports.
+ */
+const SimdKernels *GetBaselineSimdKernels();
+
+/**
+ * @return The kernels compiled for AVX2, or null if the build does not
+ *    include them.
+ */
+const SimdKernels *GetAvx2SimdKernels();
+
+/**
+ * @return The kernels compiled for AVX-512, or null if the build does not
+ *    include them.
+ */
+const SimdKernels *GetAvx512SimdKernels();
+}  // namespace Visqol
+
+#endif  // VISQOL_SIMD_SIMD_KERNELS_H
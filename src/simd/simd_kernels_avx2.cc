@@ -0,0 +1,30 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The kernels compiled for AVX2, on the targets whose build passes the AVX2
+// compiler flags to this file.
+
+#include "simd_kernels.h"
+
+#if defined(__AVX2__)
+#include "simd_kernels_impl.h"
+
+namespace Visqol {
+const SimdKernels *GetAvx2SimdKernels() { return &kSimdKernels; }
+}  // namespace Visqol
+#else
+namespace Visqol {
+const SimdKernels *GetAvx2SimdKernels() { return nullptr; }
+}  // namespace Visqol
+#endif
@@ -0,0 +1,512 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The bodies of the SIMD kernels. This header is included once by each of
+// the simd_kernels_*.cc files, which are compiled for different instruction
+// sets, and picks the widest lanes that the compiler flags of the including
+// file enable.
+//
+// Everything is defined in an anonymous namespace, so that no inline function
+// compiled for a wider instruction set can be merged by the linker into code
+// that runs on a host without it. For the same reason, no function templates
+// of other headers (such as std::min) are instantiated here.
+
+#ifndef VISQOL_SIMD_SIMD_KERNELS_IMPL_H
+#define VISQOL_SIMD_SIMD_KERNELS_IMPL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "simd_kernels.h"
+
+namespace Visqol {
+namespace {
+
+// The instruction set that the including file is compiled for.
+#if defined(__AVX512F__)
+constexpr SimdIsa kCompiledIsa = SimdIsa::kAvx512;
+#elif defined(__AVX2__)
+constexpr SimdIsa kCompiledIsa = SimdIsa::kAvx2;
+#elif defined(__AVX__)
+constexpr SimdIsa kCompiledIsa = SimdIsa::kAvx;
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+constexpr SimdIsa kCompiledIsa = SimdIsa::kSse2;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+constexpr SimdIsa kCompiledIsa = SimdIsa::kNeon;
+#else
+constexpr SimdIsa kCompiledIsa = SimdIsa::kScalar;
+#endif
+
+//////////////////////////// Gammatone cascade ////////////////////////////
+
+// Row offsets of the shared denominator coefficients in the packed cascade
+// coefficients.
+constexpr size_t kDenom1Row = kGammatoneCascadeStages * 3;
+constexpr size_t kDenom2Row = kDenom1Row + 1;
+
+// Lane operations for filtering one band at a time.
+struct ScalarBandOps {
+  typedef double Vec;
+  static constexpr size_t kLanes = 1;
+  static Vec Load(const double *p) { return *p; }
+  static void Store(double *p, Vec v) { *p = v; }
+  static Vec Broadcast(double v) { return v; }
+  static Vec Add(Vec a, Vec b) { return a + b; }
+  static Vec Sub(Vec a, Vec b) { return a - b; }
+  static Vec Mul(Vec a, Vec b) { return a * b; }
+};
+
+#if defined(__AVX__)
+// Lane operations for filtering four neighbouring bands at once.
+struct AvxBandOps {
+  typedef __m256d Vec;
+  static constexpr size_t kLanes = 4;
+  static Vec Load(const double *p) { return _mm256_loadu_pd(p); }
+  static void Store(double *p, Vec v) { _mm256_storeu_pd(p, v); }
+  static Vec Broadcast(double v) { return _mm256_set1_pd(v); }
+  static Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+};
+#endif
+
+// Lane operations for filtering several neighbouring bands at once, and for
+// the bands that are left over.
+#if defined(__AVX512F__)
+struct SimdBandOps {
+  typedef __m512d Vec;
+  static constexpr size_t kLanes = 8;
+  static Vec Load(const double *p) { return _mm512_loadu_pd(p); }
+  static void Store(double *p, Vec v) { _mm512_storeu_pd(p, v); }
+  static Vec Broadcast(double v) { return _mm512_set1_pd(v); }
+  static Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+};
+typedef AvxBandOps NarrowBandOps;
+#elif defined(__AVX__)
+typedef AvxBandOps SimdBandOps;
+typedef ScalarBandOps NarrowBandOps;
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+struct SimdBandOps {
+  typedef __m128d Vec;
+  static constexpr size_t kLanes = 2;
+  static Vec Load(const double *p) { return _mm_loadu_pd(p); }
+  static void Store(double *p, Vec v) { _mm_storeu_pd(p, v); }
+  static Vec Broadcast(double v) { return _mm_set1_pd(v); }
+  static Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static Vec Sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+  static Vec Mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+};
+typedef ScalarBandOps NarrowBandOps;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct SimdBandOps {
+  typedef float64x2_t Vec;
+  static constexpr size_t kLanes = 2;
+  static Vec Load(const double *p) { return vld1q_f64(p); }
+  static void Store(double *p, Vec v) { vst1q_f64(p, v); }
+  static Vec Broadcast(double v) { return vdupq_n_f64(v); }
+  static Vec Add(Vec a, Vec b) { return vaddq_f64(a, b); }
+  static Vec Sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+  static Vec Mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+};
+typedef ScalarBandOps NarrowBandOps;
+#else
+typedef ScalarBandOps SimdBandOps;
+typedef ScalarBandOps NarrowBandOps;
+#endif
+
+// Run the four stage cascade over the signal for Ops::kLanes neighbouring
+// bands, starting at first_band. The filter state is kept in registers for the
+// duration of the signal and written back at the end. The filtered output of
+// each sample is handed to the sink.
+//
+// Each stage is a direct-form II transposed biquad, evaluated in exactly the
+// same order as SignalFilter::Filter so that the output is unchanged. Each
+// band is filtered on its own lane, so the output does not depend on the
+// number of lanes.
+template <typename Ops, typename Sink>
+inline void FilterBandGroup(const double *coeffs, double *state,
+                            const size_t num_bands, const size_t first_band,
+                            const double *signal, const size_t num_samples,
+                            Sink &sink) {
+  typedef typename Ops::Vec Vec;
+  constexpr size_t kNumStages = kGammatoneCascadeStages;
+  Vec n0[kNumStages], n1[kNumStages], n2[kNumStages];
+  Vec z0[kNumStages], z1[kNumStages];
+  for (size_t s = 0; s < kNumStages; s++) {
+    n0[s] = Ops::Load(coeffs + (s * 3) * num_bands + first_band);
+    n1[s] = Ops::Load(coeffs + (s * 3 + 1) * num_bands + first_band);
+    n2[s] = Ops::Load(coeffs + (s * 3 + 2) * num_bands + first_band);
+    z0[s] = Ops::Load(state + (s * 2) * num_bands + first_band);
+    z1[s] = Ops::Load(state + (s * 2 + 1) * num_bands + first_band);
+  }
+  const Vec d1 = Ops::Load(coeffs + kDenom1Row * num_bands + first_band);
+  const Vec d2 = Ops::Load(coeffs + kDenom2Row * num_bands + first_band);
+
+  for (size_t i = 0; i < num_samples; i++) {
+    Vec x = Ops::Broadcast(signal[i]);
+    for (size_t s = 0; s < kNumStages; s++) {
+      const Vec y = Ops::Add(Ops::Mul(n0[s], x), z0[s]);
+      z0[s] = Ops::Sub(Ops::Add(Ops::Mul(n1[s], x), z1[s]), Ops::Mul(d1, y));
+      z1[s] = Ops::Sub(Ops::Mul(n2[s], x), Ops::Mul(d2, y));
+      x = y;
+    }
+    sink.template Consume<Ops>(i, first_band, x);
+  }
+
+  for (size_t s = 0; s < kNumStages; s++) {
+    Ops::Store(state + (s * 2) * num_bands + first_band, z0[s]);
+    Ops::Store(state + (s * 2 + 1) * num_bands + first_band, z1[s]);
+  }
+}
+
+// Run the cascade over all bands, using the widest lanes for as many bands as
+// possible, then narrower lanes, and a scalar pass for any remaining bands.
+template <typename Sink>
+inline void FilterAllBands(const double *coeffs, double *state,
+                           const size_t num_bands, const double *signal,
+                           const size_t num_samples, Sink &sink) {
+  size_t band = 0;
+  for (; band + SimdBandOps::kLanes <= num_bands;
+       band += SimdBandOps::kLanes) {
+    FilterBandGroup<SimdBandOps>(coeffs, state, num_bands, band, signal,
+                                 num_samples, sink);
+  }
+  for (; band + NarrowBandOps::kLanes <= num_bands;
+       band += NarrowBandOps::kLanes) {
+    FilterBandGroup<NarrowBandOps>(coeffs, state, num_bands, band, signal,
+                                   num_samples, sink);
+  }
+  for (; band < num_bands; band++) {
+    FilterBandGroup<ScalarBandOps>(coeffs, state, num_bands, band, signal,
+                                   num_samples, sink);
+  }
+}
+
+// A sink that writes the filtered output into a column major matrix with one
+// row per band.
+struct MatrixSink {
+  double *out;
+  size_t num_bands;
+
+  template <typename Ops>
+  void Consume(size_t sample, size_t first_band, typename Ops::Vec y) {
+    Ops::Store(out + sample * num_bands + first_band, y);
+  }
+};
+
+// A sink that accumulates the sum of squares of the filtered output for each
+// band.
+struct EnergySink {
+  double *energy;
+
+  template <typename Ops>
+  void Consume(size_t sample, size_t first_band, typename Ops::Vec y) {
+    double *e = energy + first_band;
+    Ops::Store(e, Ops::Add(Ops::Load(e), Ops::Mul(y, y)));
+  }
+};
+
+void GammatoneFilter(const double *coeffs, double *state,
+                     const size_t num_bands, const double *signal,
+                     const size_t num_samples, double *out) {
+  MatrixSink sink{out, num_bands};
+  FilterAllBands(coeffs, state, num_bands, signal, num_samples, sink);
+}
+
+void GammatoneEnergy(const double *coeffs, double *state,
+                     const size_t num_bands, const double *signal,
+                     const size_t num_samples, double *energy) {
+  EnergySink sink{energy};
+  FilterAllBands(coeffs, state, num_bands, signal, num_samples, sink);
+}
+
+/////////////////////////////// RMS of a chunk ///////////////////////////////
+
+// The scale and the range of the 16 bit samples that normalized samples are
+// converted to.
+const double kSampleScale = 1 << 15;
+const double kMinSample = -1.0 * (1 << 15);
+const double kMaxSample = 1.0 * ((1 << 15) - 1);
+
+// Convert a sample to the value of the 16 bit sample that it converts to once
+// it is normalized by the peak, as the conversion to int16_t does. The clamps
+// are those of std::max(kMinSample, std::min(kMaxSample, sample)).
+inline double ToSample(const double value, const double peak) {
+  const double sample = value / peak * kSampleScale;
+  const double upper = sample < kMaxSample ? sample : kMaxSample;
+  return std::trunc(kMinSample < upper ? upper : kMinSample);
+}
+
+// The sum of the squares of the 16 bit samples that the samples of a chunk
+// convert to, once they are normalized by the peak. The squares are integers,
+// and their sum is exact for any chunk of fewer than 2^23 samples, so the sum
+// does not depend on the order that the lanes add them in.
+double SumOfSquaredSamples(const double *chunk, const size_t n,
+                           const double peak) {
+  size_t i = 0;
+  double sum = 0.0;
+#if defined(__AVX512F__)
+  const __m512d divisor = _mm512_set1_pd(peak);
+  const __m512d scale = _mm512_set1_pd(kSampleScale);
+  const __m512d min_sample = _mm512_set1_pd(kMinSample);
+  const __m512d max_sample = _mm512_set1_pd(kMaxSample);
+  __m512d lanes_sum = _mm512_setzero_pd();
+  for (; i + 8 <= n; i += 8) {
+    __m512d sample = _mm512_mul_pd(
+        _mm512_div_pd(_mm512_loadu_pd(chunk + i), divisor), scale);
+    sample = _mm512_max_pd(_mm512_min_pd(sample, max_sample), min_sample);
+    sample = _mm512_roundscale_pd(sample,
+                                  _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    lanes_sum = _mm512_add_pd(lanes_sum, _mm512_mul_pd(sample, sample));
+  }
+  sum = _mm512_reduce_add_pd(lanes_sum);
+#elif defined(__AVX__)
+  const __m256d divisor = _mm256_set1_pd(peak);
+  const __m256d scale = _mm256_set1_pd(kSampleScale);
+  const __m256d min_sample = _mm256_set1_pd(kMinSample);
+  const __m256d max_sample = _mm256_set1_pd(kMaxSample);
+  __m256d lanes_sum = _mm256_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    __m256d sample = _mm256_mul_pd(
+        _mm256_div_pd(_mm256_loadu_pd(chunk + i), divisor), scale);
+    sample = _mm256_max_pd(_mm256_min_pd(sample, max_sample), min_sample);
+    sample = _mm256_round_pd(sample, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    lanes_sum = _mm256_add_pd(lanes_sum, _mm256_mul_pd(sample, sample));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, lanes_sum);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+  const __m128d divisor = _mm_set1_pd(peak);
+  const __m128d scale = _mm_set1_pd(kSampleScale);
+  const __m128d min_sample = _mm_set1_pd(kMinSample);
+  const __m128d max_sample = _mm_set1_pd(kMaxSample);
+  __m128d lanes_sum = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2) {
+    __m128d sample = _mm_mul_pd(
+        _mm_div_pd(_mm_loadu_pd(chunk + i), divisor), scale);
+    sample = _mm_max_pd(_mm_min_pd(sample, max_sample), min_sample);
+    // The clamped samples fit in 32 bits, so they are truncated through them.
+    sample = _mm_cvtepi32_pd(_mm_cvttpd_epi32(sample));
+    lanes_sum = _mm_add_pd(lanes_sum, _mm_mul_pd(sample, sample));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, lanes_sum);
+  sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float64x2_t divisor = vdupq_n_f64(peak);
+  const float64x2_t scale = vdupq_n_f64(kSampleScale);
+  const float64x2_t min_sample = vdupq_n_f64(kMinSample);
+  const float64x2_t max_sample = vdupq_n_f64(kMaxSample);
+  float64x2_t lanes_sum = vdupq_n_f64(0.0);
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t sample = vmulq_f64(
+        vdivq_f64(vld1q_f64(chunk + i), divisor), scale);
+    sample = vrndq_f64(vmaxq_f64(vminq_f64(sample, max_sample), min_sample));
+    lanes_sum = vaddq_f64(lanes_sum, vmulq_f64(sample, sample));
+  }
+  sum = vgetq_lane_f64(lanes_sum, 0) + vgetq_lane_f64(lanes_sum, 1);
+#endif
+  for (; i < n; i++) {
+    const double sample = ToSample(chunk[i], peak);
+    sum += sample * sample;
+  }
+  return sum;
+}
+
+///////////////////////////////// Fast log10 /////////////////////////////////
+
+// Bit patterns of an IEEE 754 double.
+constexpr uint64_t kMantissaMask = 0x000fffffffffffffULL;
+constexpr uint64_t kExponentOfOne = 0x3ff0000000000000ULL;
+constexpr uint64_t kExponentMask = 0x7ff;
+constexpr int kExponentBias = 1023;
+
+// The mantissa is reduced to [sqrt(0.5), sqrt(2)), so that the series below
+// converges quickly.
+constexpr double kSqrt2 = 1.4142135623730951;
+constexpr double kLog10Of2 = 0.30102999566398120;
+constexpr double kLog10OfE = 0.43429448190325182;
+
+// The coefficients of the series, from the highest order term, after 1 / 13.
+constexpr double kInverseOdd[] = {1.0 / 11, 1.0 / 9, 1.0 / 7, 1.0 / 5, 1.0 / 3,
+                                  1.0};
+
+// ln(m) = 2 * atanh(t), with t = (m - 1) / (m + 1), evaluated as a truncated
+// odd series in t. |t| < 0.1716, so the first omitted term is below 1e-13.
+inline double LogOfReducedMantissa(double m) {
+  const double t = (m - 1.0) / (m + 1.0);
+  const double t2 = t * t;
+  const double series = 1.0 + t2 * (1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 +
+      t2 * (1.0 / 9 + t2 * (1.0 / 11 + t2 * (1.0 / 13))))));
+  return 2.0 * t * series;
+}
+
+inline double ScalarFastLog10(const double x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  const uint64_t exponent_bits = (bits >> 52) & kExponentMask;
+  if (x < 0 || exponent_bits == 0 || exponent_bits == kExponentMask) {
+    return std::log10(x);
+  }
+  int exponent = static_cast<int>(exponent_bits) - kExponentBias;
+  bits = (bits & kMantissaMask) | kExponentOfOne;
+  double m;
+  std::memcpy(&m, &bits, sizeof(m));
+  if (m >= kSqrt2) {
+    m *= 0.5;
+    exponent++;
+  }
+  return exponent * kLog10Of2 + LogOfReducedMantissa(m) * kLog10OfE;
+}
+
+#if defined(__AVX2__)
+// FastLog10 of four values at once. Lanes holding values that need the
+// std::log10 fallback are flagged in the returned bit mask.
+inline __m256d FastLog10Lanes(__m256d x, int *special_mask) {
+  const __m256i bits = _mm256_castpd_si256(x);
+  // The biased exponent, converted to a double through the 2^52 trick.
+  const __m256i exponent_bits = _mm256_and_si256(_mm256_srli_epi64(bits, 52),
+      _mm256_set1_epi64x(kExponentMask));
+  const __m256d two_52 = _mm256_set1_pd(4503599627370496.0);
+  __m256d exponent = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(
+      exponent_bits, _mm256_castpd_si256(two_52))), two_52);
+  // Zero, subnormal, infinite and NaN values have a biased exponent of 0 or
+  // 0x7ff, and negative values have the sign bit set.
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d special = _mm256_or_pd(
+      _mm256_or_pd(_mm256_cmp_pd(exponent, zero, _CMP_EQ_OQ),
+                   _mm256_cmp_pd(exponent, _mm256_set1_pd(kExponentMask),
+                                 _CMP_EQ_OQ)),
+      _mm256_cmp_pd(x, zero, _CMP_LT_OS));
+  *special_mask = _mm256_movemask_pd(special);
+
+  // The mantissa in [1, 2), reduced to [sqrt(0.5), sqrt(2)).
+  __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi64x(kMantissaMask)),
+      _mm256_set1_epi64x(kExponentOfOne)));
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d reduce = _mm256_cmp_pd(m, _mm256_set1_pd(kSqrt2), _CMP_GE_OS);
+  m = _mm256_mul_pd(m, _mm256_or_pd(_mm256_and_pd(reduce, _mm256_set1_pd(0.5)),
+                                    _mm256_andnot_pd(reduce, one)));
+  exponent = _mm256_add_pd(
+      _mm256_sub_pd(exponent, _mm256_set1_pd(kExponentBias)),
+      _mm256_and_pd(reduce, one));
+
+  const __m256d t = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+  const __m256d t2 = _mm256_mul_pd(t, t);
+  __m256d series = _mm256_set1_pd(1.0 / 13);
+  for (const double c : kInverseOdd) {
+    series = _mm256_add_pd(_mm256_set1_pd(c), _mm256_mul_pd(t2, series));
+  }
+  const __m256d ln_m = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), t),
+                                     series);
+  return _mm256_add_pd(_mm256_mul_pd(exponent, _mm256_set1_pd(kLog10Of2)),
+                       _mm256_mul_pd(ln_m, _mm256_set1_pd(kLog10OfE)));
+}
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+// FastLog10 of two values at once. Lanes holding values that need the
+// std::log10 fallback are flagged in the returned bit mask.
+inline __m128d FastLog10Lanes(__m128d x, int *special_mask) {
+  const __m128i bits = _mm_castpd_si128(x);
+  // The biased exponent, converted to a double through the 2^52 trick.
+  const __m128i exponent_bits = _mm_and_si128(_mm_srli_epi64(bits, 52),
+      _mm_set1_epi64x(kExponentMask));
+  const __m128d two_52 = _mm_set1_pd(4503599627370496.0);
+  __m128d exponent = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(exponent_bits,
+      _mm_castpd_si128(two_52))), two_52);
+  // Zero, subnormal, infinite and NaN values have a biased exponent of 0 or
+  // 0x7ff, and negative values have the sign bit set.
+  const __m128d special = _mm_or_pd(
+      _mm_or_pd(_mm_cmpeq_pd(exponent, _mm_setzero_pd()),
+                _mm_cmpeq_pd(exponent, _mm_set1_pd(kExponentMask))),
+      _mm_cmplt_pd(x, _mm_setzero_pd()));
+  *special_mask = _mm_movemask_pd(special);
+
+  // The mantissa in [1, 2), reduced to [sqrt(0.5), sqrt(2)).
+  __m128d m = _mm_castsi128_pd(_mm_or_si128(
+      _mm_and_si128(bits, _mm_set1_epi64x(kMantissaMask)),
+      _mm_set1_epi64x(kExponentOfOne)));
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d reduce = _mm_cmpge_pd(m, _mm_set1_pd(kSqrt2));
+  m = _mm_mul_pd(m, _mm_or_pd(_mm_and_pd(reduce, _mm_set1_pd(0.5)),
+                              _mm_andnot_pd(reduce, one)));
+  exponent = _mm_add_pd(_mm_sub_pd(exponent, _mm_set1_pd(kExponentBias)),
+                        _mm_and_pd(reduce, one));
+
+  const __m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+  const __m128d t2 = _mm_mul_pd(t, t);
+  __m128d series = _mm_set1_pd(1.0 / 13);
+  for (const double c : kInverseOdd) {
+    series = _mm_add_pd(_mm_set1_pd(c), _mm_mul_pd(t2, series));
+  }
+  const __m128d ln_m = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), t), series);
+  return _mm_add_pd(_mm_mul_pd(exponent, _mm_set1_pd(kLog10Of2)),
+                    _mm_mul_pd(ln_m, _mm_set1_pd(kLog10OfE)));
+}
+#endif
+
+void FastLog10(const double *input, double *output, const size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 4 <= n; i += 4) {
+    int special_mask;
+    const __m256d y = FastLog10Lanes(_mm256_loadu_pd(input + i),
+                                     &special_mask);
+    if (special_mask != 0) {
+      for (size_t lane = 0; lane < 4; lane++) {
+        output[i + lane] = ScalarFastLog10(input[i + lane]);
+      }
+    } else {
+      _mm256_storeu_pd(output + i, y);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+  for (; i + 2 <= n; i += 2) {
+    int special_mask;
+    const __m128d y = FastLog10Lanes(_mm_loadu_pd(input + i), &special_mask);
+    if (special_mask != 0) {
+      output[i] = ScalarFastLog10(input[i]);
+      output[i + 1] = ScalarFastLog10(input[i + 1]);
+    } else {
+      _mm_storeu_pd(output + i, y);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    output[i] = ScalarFastLog10(input[i]);
+  }
+}
+
+const SimdKernels kSimdKernels = {kCompiledIsa, &GammatoneFilter,
+                                  &GammatoneEnergy, &SumOfSquaredSamples,
+                                  &FastLog10};
+}  // namespace
+}  // namespace Visqol
+
+#endif  // VISQOL_SIMD_SIMD_KERNELS_IMPL_H
@@ -0,0 +1,113 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "simd_dispatch.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#include "simd_kernels.h"
+
+namespace Visqol {
+namespace {
+// Pick the widest kernels in the build that the host supports.
+const SimdKernels *SelectKernels() {
+  const SimdIsa host_isa = SimdDispatch::HostIsa();
+  const SimdKernels *kernels = nullptr;
+  if (host_isa == SimdIsa::kAvx512) {
+    kernels = GetAvx512SimdKernels();
+  }
+  if (kernels == nullptr &&
+      (host_isa == SimdIsa::kAvx512 || host_isa == SimdIsa::kAvx2)) {
+    kernels = GetAvx2SimdKernels();
+  }
+  if (kernels == nullptr) {
+    kernels = GetBaselineSimdKernels();
+  }
+  return kernels;
+}
+}  // namespace
+
+SimdIsa SimdDispatch::HostIsa() {
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdIsa::kAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdIsa::kAvx2;
+  }
+  if (__builtin_cpu_supports("avx")) {
+    return SimdIsa::kAvx;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return SimdIsa::kSse2;
+  }
+  return SimdIsa::kScalar;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+  int info[4];
+  __cpuid(info, 1);
+  // The OS must save the AVX registers (OSXSAVE, then XCR0) for AVX to be
+  // usable, and additionally the AVX-512 registers for AVX-512.
+  const bool has_avx = (info[2] & (1 << 28)) != 0;
+  const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+  if (!has_avx || !has_osxsave) {
+    return SimdIsa::kSse2;
+  }
+  const unsigned long long xcr0 = _xgetbv(0);
+  if ((xcr0 & 0x6) != 0x6) {
+    return SimdIsa::kSse2;
+  }
+  __cpuidex(info, 7, 0);
+  if ((info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6) {
+    return SimdIsa::kAvx512;
+  }
+  if ((info[1] & (1 << 5)) != 0) {
+    return SimdIsa::kAvx2;
+  }
+  return SimdIsa::kAvx;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  // NEON is part of the aarch64 baseline.
+  return SimdIsa::kNeon;
+#else
+  return SimdIsa::kScalar;
+#endif
+}
+
+const SimdKernels &SimdDispatch::Kernels() {
+  static const SimdKernels *const kernels = SelectKernels();
+  return *kernels;
+}
+
+const char *SimdDispatch::IsaName(const SimdIsa isa) {
+  switch (isa) {
+    case SimdIsa::kScalar:
+      return "scalar";
+    case SimdIsa::kSse2:
+      return "SSE2";
+    case SimdIsa::kAvx:
+      return "AVX";
+    case SimdIsa::kAvx2:
+      return "AVX2";
+    case SimdIsa::kAvx512:
+      return "AVX-512";
+    case SimdIsa::kNeon:
+      return "NEON";
+  }
+  return "unknown";
+}
+}  // namespace Visqol
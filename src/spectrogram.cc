@@ -15,19 +15,36 @@
 #include "spectrogram.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <utility>
 #include <vector>
 
+#include "absl/types/span.h"
+
 #include "amatrix.h"
 #include "misc_audio.h"
+#include "misc_math.h"
 
 namespace Visqol {
 Spectrogram::Spectrogram(AMatrix<double> &&data) : data_{std::move(data)} {}
 
 void Spectrogram::ConvertToDb() {
-  std::transform(data_.begin(), data_.end(), data_.begin(),
-      Spectrogram::ConvertSampleToDb);
+  ConvertFrameToDb(data_.mutData(), data_.NumElements());
+}
+
+void Spectrogram::ConvertFrameToDb(double *frame, size_t size) {
+  // Get the absolute value of each sample. If the sample is zero, use epsilon.
+  for (size_t j = 0; j < size; j++) {
+    frame[j] = std::abs(frame[j]) == 0 ?
+        std::numeric_limits<double>::epsilon() : std::abs(frame[j]);
+  }
+  // Convert the samples to decibels.
+  MiscMath::FastLog10(absl::Span<const double>(frame, size),
+                      absl::Span<double>(frame, size));
+  for (size_t j = 0; j < size; j++) {
+    frame[j] *= 10;
+  }
 }
 
 double Spectrogram::Minimum() const {
@@ -53,32 +70,99 @@ void Spectrogram::RaiseFloorPerFrame(double noise_threshold,
   // This means most of the action is at the -25 to -10dB range.
   size_t min_cols = std::min(data_.NumCols(),
                              other.data_.NumCols());
+  // The matrices are stored column major, so each frame is contiguous and can
+  // be updated in place.
+  const size_t our_rows = data_.NumRows();
+  const size_t other_rows = other.data_.NumRows();
   for (size_t i = 0; i < min_cols; i++) {
-    auto our_frame = data_.GetColumn(i);
-    auto other_frame = other.data_.GetColumn(i);
+    double *our_frame = data_.mutData() + i * our_rows;
+    double *other_frame = other.data_.mutData() + i * other_rows;
     // Find the max value per frame.
-    double our_max = *std::max_element(our_frame.cbegin(), our_frame.cend());
-    double other_max = *std::max_element(other_frame.cbegin(),
-                                         other_frame.cend());
+    double our_max = *std::max_element(our_frame, our_frame + our_rows);
+    double other_max = *std::max_element(other_frame,
+                                         other_frame + other_rows);
     double any_max = std::max(our_max, other_max);
     double floor_db = any_max - noise_threshold;
 
     // Raise the floor by some amount under the max.
-    std::transform(our_frame.begin(), our_frame.end(), our_frame.begin(),
+    std::transform(our_frame, our_frame + our_rows, our_frame,
                    [&](double d) { return std::max(floor_db, d); });
-    std::transform(other_frame.begin(), other_frame.end(), other_frame.begin(),
+    std::transform(other_frame, other_frame + other_rows, other_frame,
                    [&](double d) { return std::max(floor_db, d); });
-    data_.SetColumn(i, std::move(our_frame));
-    other.data_.SetColumn(i, std::move(other_frame));
   }
 }
 
+double Spectrogram::ConvertToDbAndRaiseFloors(
+    double absolute_floor, double relative_floor, Spectrogram& other,
+    const SpectrogramColumnRanges *columns) {
+  const size_t min_cols = std::min(data_.NumCols(), other.data_.NumCols());
+  const size_t max_cols = std::max(data_.NumCols(), other.data_.NumCols());
+  const size_t our_rows = data_.NumRows();
+  const size_t other_rows = other.data_.NumRows();
+  double lowest = std::numeric_limits<double>::max();
+
+  // Convert a frame to decibels with the absolute floor applied, returning
+  // the max value of the frame.
+  auto convert_frame = [absolute_floor](double *frame, size_t rows) {
+    ConvertFrameToDb(frame, rows);
+    double frame_max = std::numeric_limits<double>::lowest();
+    for (size_t j = 0; j < rows; j++) {
+      frame[j] = std::max(absolute_floor, frame[j]);
+      frame_max = std::max(frame_max, frame[j]);
+    }
+    return frame_max;
+  };
+  // Raise the floor of a frame, returning the min value of the frame.
+  auto raise_frame = [](double *frame, size_t rows, double floor_db) {
+    double frame_min = std::numeric_limits<double>::max();
+    for (size_t j = 0; j < rows; j++) {
+      frame[j] = std::max(floor_db, frame[j]);
+      frame_min = std::min(frame_min, frame[j]);
+    }
+    return frame_min;
+  };
+  auto convert_columns = [&](size_t first_col, size_t end_col) {
+    // The frames present in both spectrograms share a relative floor.
+    for (size_t i = first_col; i < std::min(end_col, min_cols); i++) {
+      double *our_frame = data_.mutData() + i * our_rows;
+      double *other_frame = other.data_.mutData() + i * other_rows;
+      const double any_max = std::max(convert_frame(our_frame, our_rows),
+                                      convert_frame(other_frame, other_rows));
+      const double floor_db = any_max - relative_floor;
+      lowest = std::min(lowest, raise_frame(our_frame, our_rows, floor_db));
+      lowest = std::min(lowest,
+                        raise_frame(other_frame, other_rows, floor_db));
+    }
+
+    // Any trailing frames of the longer spectrogram only get the absolute
+    // floor.
+    for (Spectrogram *spectro : {this, &other}) {
+      const size_t rows = spectro->data_.NumRows();
+      const size_t num_cols = std::min(end_col, spectro->data_.NumCols());
+      for (size_t i = std::max(first_col, min_cols); i < num_cols; i++) {
+        double *frame = spectro->data_.mutData() + i * rows;
+        convert_frame(frame, rows);
+        lowest = std::min(lowest, raise_frame(frame, rows, absolute_floor));
+      }
+    }
+  };
+
+  if (columns == nullptr) {
+    convert_columns(0, max_cols);
+  } else {
+    for (const auto &range : *columns) {
+      convert_columns(range.first, std::min(range.second, max_cols));
+    }
+  }
+  return lowest;
+}
+
 double Spectrogram::ConvertSampleToDb(const double sample) {
   // Get the absolute value of the sample. If the sample is zero, use epsilon.
   const auto abs_sample = std::abs(sample) == 0 ?
       std::numeric_limits<double>::epsilon() : std::abs(sample);
   // Convert the sample to decibels and return.
-  return 10 * std::log10(abs_sample);
+  return 10 * MiscMath::FastLog10(abs_sample);
 }
 
 void Spectrogram::SetCenterFreqBands(
@@ -0,0 +1,47 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spectrogram_builder.h"
+
+#include <utility>
+
+#include "google/protobuf/stubs/statusor.h"
+
+#include "analysis_window.h"
+#include "audio_signal_view.h"
+#include "parallel_executor.h"
+#include "spectrogram.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+
+std::pair<google::protobuf::util::StatusOr<Spectrogram>,
+          google::protobuf::util::StatusOr<Spectrogram>>
+SpectrogramBuilder::BuildPair(const AudioSignalView &ref_signal,
+                              const AudioSignalView &deg_signal,
+                              const AnalysisWindow &window,
+                              VisqolWorkspace *workspace,
+                              size_t num_workers) const {
+  google::protobuf::util::StatusOr<Spectrogram> ref_result;
+  google::protobuf::util::StatusOr<Spectrogram> deg_result;
+  ParallelExecutor::ForEach(2, num_workers, [&](size_t i) {
+    if (i == 0) {
+      ref_result = Build(ref_signal, window, workspace);
+    } else {
+      deg_result = Build(deg_signal, window, workspace);
+    }
+  });
+  return std::make_pair(std::move(ref_result), std::move(deg_result));
+}
+}  // namespace Visqol
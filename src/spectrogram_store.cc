@@ -0,0 +1,58 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spectrogram_store.h"
+
+#include <cstdint>
+
+#include "amatrix.h"
+
+namespace Visqol {
+template <typename T>
+const size_t BasicSpectrogramStore<T>::kRowAlignment = 64 / sizeof(T);
+
+template <typename T>
+BasicSpectrogramStore<T>::BasicSpectrogramStore(const AMatrix<T> &matrix,
+                                                size_t num_pad_frames)
+    : num_bands_(matrix.NumRows()),
+      num_frames_(matrix.NumCols()),
+      num_pad_frames_(num_pad_frames) {
+  const size_t padded_frames = num_frames_ + 2 * num_pad_frames_;
+  stride_ = (padded_frames + kRowAlignment - 1) / kRowAlignment *
+      kRowAlignment;
+  data_.assign(num_bands_ * stride_, T(0));
+  // Each column of the matrix is scattered across the bands once here, so
+  // that the patch search reads each band contiguously.
+  const T *column = matrix.data();
+  for (size_t frame = 0; frame < num_frames_; frame++) {
+    T *band_start = data_.data() + num_pad_frames_ + frame;
+    for (size_t band = 0; band < num_bands_; band++) {
+      band_start[band * stride_] = column[band];
+    }
+    column += num_bands_;
+  }
+}
+
+template <typename T>
+bool BasicSpectrogramStore<T>::Covers(int first_frame,
+                                      size_t num_frames) const {
+  const int64_t pad = num_pad_frames_;
+  return first_frame >= -pad &&
+      first_frame + static_cast<int64_t>(num_frames) <=
+          static_cast<int64_t>(num_frames_) + pad;
+}
+
+template class BasicSpectrogramStore<double>;
+template class BasicSpectrogramStore<float>;
+}  // namespace Visqol
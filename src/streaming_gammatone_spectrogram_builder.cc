@@ -0,0 +1,128 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_gammatone_spectrogram_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal_view.h"
+#include "erb_filter_cache.h"
+#include "gammatone_spectrogram_builder.h"
+#include "spectrogram.h"
+#include "visqol_workspace.h"
+
+namespace Visqol {
+namespace {
+// Greatest common divisor of two sizes.
+size_t GreatestCommonDivisor(size_t a, size_t b) {
+  while (b != 0) {
+    const size_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+}  // namespace
+
+StreamingGammatoneSpectrogramBuilder::StreamingGammatoneSpectrogramBuilder(
+    const GammatoneFilterBank &filter_bank, const bool use_speech_mode) :
+    filter_bank_(filter_bank), speech_mode_(use_speech_mode) {}
+
+google::protobuf::util::StatusOr<Spectrogram>
+StreamingGammatoneSpectrogramBuilder::Build(
+    const AudioSignalView &signal, const AnalysisWindow &window,
+    VisqolWorkspace *workspace) const {
+  const size_t num_samples = signal.NumSamples();
+  size_t sample_rate = signal.SampleRate();
+  double max_freq = speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
+
+  // get gammatone coeffients.
+  std::shared_ptr<const ErbFilterSet> erb_filters = ErbFilterCache::GetFilters(
+      sample_rate, filter_bank_.GetNumBands(), filter_bank_.GetMinFreq(),
+      max_freq);
+
+  // set up the windowing
+  size_t hop_size = window.size * window.overlap;
+
+  // ensure that the signal is large enough.
+  if (num_samples <= window.size || hop_size == 0) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::INVALID_ARGUMENT,
+        "Too few samples ("+std::to_string(num_samples)+") in signal to build"
+        " spectrogram ("+std::to_string(hop_size)+" required minimum).");
+  }
+
+  // the filter conditions are local to this call. Set the filter coefficients
+  // and init the filter conditions to 0. The conditions are not reset again
+  // until the next signal. The filter bank is reused from the workspace where
+  // possible.
+  VisqolWorkspace local_workspace;
+  VisqolWorkspace *scratch = workspace != nullptr ? workspace :
+      &local_workspace;
+  GammatoneFilterBank filter_bank = scratch->TakeFilterBank(filter_bank_);
+  filter_bank.SetFilterCoefficients(erb_filters->filter_coeffs);
+  filter_bank.ResetFilterConditions();
+  const size_t num_bands = filter_bank.GetNumBands();
+  const size_t num_cols = 1 + floor((num_samples - window.size) / hop_size);
+
+  // The energy is accumulated in blocks that evenly divide both the hop and
+  // the window, so that each window is covered by a whole number of blocks.
+  const size_t block_size = GreatestCommonDivisor(hop_size, window.size);
+  const size_t blocks_per_hop = hop_size / block_size;
+  const size_t blocks_per_window = window.size / block_size;
+  const size_t num_blocks = (num_cols - 1) * blocks_per_hop + blocks_per_window;
+
+  // filter the signal once, with continuous state. The signal is only copied
+  // if the view has silent samples.
+  const absl::Span<const double> sig_span = signal.ToSpan(scratch);
+  const absl::Span<double> block_energy = scratch->Allocate<double>(
+      num_blocks * num_bands);
+  for (size_t b = 0; b < num_blocks; b++) {
+    filter_bank.ApplyFilterEnergy(sig_span.subspan(b * block_size, block_size),
+                                  block_energy.subspan(b * num_bands,
+                                                       num_bands));
+  }
+  scratch->RecycleFilterBank(std::move(filter_bank));
+
+  // calculate the RMS of each window from the block energies, straight into
+  // the columns of the spectrogram.
+  AMatrix<double> out_matrix = scratch->TakeMatrix(num_bands, num_cols);
+  for (size_t i = 0; i < num_cols; i++) {
+    const size_t first_block = i * blocks_per_hop;
+    double *band_rms = out_matrix.mutData() + i * num_bands;
+    std::fill(band_rms, band_rms + num_bands, 0.0);
+    for (size_t b = first_block; b < first_block + blocks_per_window; b++) {
+      for (size_t band = 0; band < num_bands; band++) {
+        band_rms[band] += block_energy[b * num_bands + band];
+      }
+    }
+    for (size_t band = 0; band < num_bands; band++) {
+      band_rms[band] = std::sqrt(band_rms[band] / window.size);
+    }
+  }
+
+  Spectrogram spectro(std::move(out_matrix));
+  spectro.SetCenterFreqBands(erb_filters->center_freqs);
+  return spectro;
+}
+}  // namespace Visqol
@@ -0,0 +1,130 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_visqol.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+
+namespace Visqol {
+const double StreamingVisqol::kDefaultSegmentDuration = 3.0;
+const double StreamingVisqol::kDefaultLookahead = 0.3;
+
+StreamingVisqol::StreamingVisqol(const VisqolManager *visqol,
+                                 size_t sample_rate, double segment_duration,
+                                 double lookahead, ResultHandler handler)
+    : visqol_(visqol),
+      sample_rate_(sample_rate),
+      segment_samples_(std::max<size_t>(1,
+          std::lround(segment_duration * sample_rate))),
+      lookahead_samples_(std::lround(std::max(0.0, lookahead) * sample_rate)),
+      handler_(std::move(handler)) {}
+
+google::protobuf::util::Status StreamingVisqol::PushReference(
+    absl::Span<const double> samples) {
+  reference_.insert(reference_.end(), samples.begin(), samples.end());
+  return CompareCompleteSegments();
+}
+
+google::protobuf::util::Status StreamingVisqol::PushDegraded(
+    absl::Span<const double> samples) {
+  degraded_.insert(degraded_.end(), samples.begin(), samples.end());
+  return CompareCompleteSegments();
+}
+
+google::protobuf::util::Status StreamingVisqol::Finish() {
+  const size_t num_samples = std::min(reference_.size(), degraded_.size());
+  if (num_samples < segment_samples_ / 2) {
+    reference_.clear();
+    degraded_.clear();
+    return google::protobuf::util::Status();
+  }
+  const auto status = CompareSegment(num_samples, degraded_.size());
+  reference_.clear();
+  degraded_.clear();
+  return status;
+}
+
+double StreamingVisqol::RunningMoslqo() const {
+  if (num_patches_ == 0) {
+    return 0.0;
+  }
+  return weighted_moslqo_sum_ / num_patches_;
+}
+
+google::protobuf::util::Status StreamingVisqol::CompareCompleteSegments() {
+  google::protobuf::util::Status first_error;
+  while (reference_.size() >= segment_samples_ &&
+         degraded_.size() >= segment_samples_ + lookahead_samples_) {
+    const auto status = CompareSegment(segment_samples_,
+                                       segment_samples_ + lookahead_samples_);
+    if (!status.ok() && first_error.ok()) {
+      first_error = status;
+    }
+  }
+  return first_error;
+}
+
+google::protobuf::util::Status StreamingVisqol::CompareSegment(
+    size_t num_ref_samples, size_t num_deg_samples) {
+  const size_t index = segment_index_++;
+  const double start_time = static_cast<double>(index * segment_samples_) /
+                            sample_rate_;
+  const AudioSignal ref_signal{AMatrix<double>(std::vector<double>(
+      reference_.begin(), reference_.begin() + num_ref_samples)),
+      sample_rate_};
+  AudioSignal deg_signal{AMatrix<double>(std::vector<double>(
+      degraded_.begin(), degraded_.begin() + num_deg_samples)),
+      sample_rate_};
+  // The lookahead is kept, as it starts the next segment.
+  reference_.erase(reference_.begin(), reference_.begin() + num_ref_samples);
+  degraded_.erase(degraded_.begin(),
+                  degraded_.begin() + std::min(num_ref_samples,
+                                               degraded_.size()));
+
+  auto status_or = visqol_->Run(ref_signal, deg_signal);
+  if (!status_or.ok()) {
+    return status_or.status();
+  }
+
+  StreamingVisqolResult result;
+  result.segment_index = index;
+  result.start_time = start_time;
+  result.segment = std::move(status_or.ValueOrDie());
+  for (auto &patch : *result.segment.mutable_patch_sims()) {
+    patch.set_ref_patch_start_time(patch.ref_patch_start_time() + start_time);
+    patch.set_ref_patch_end_time(patch.ref_patch_end_time() + start_time);
+    patch.set_deg_patch_start_time(patch.deg_patch_start_time() + start_time);
+    patch.set_deg_patch_end_time(patch.deg_patch_end_time() + start_time);
+  }
+  const size_t num_patches = result.segment.num_patches();
+  num_segments_++;
+  num_patches_ += num_patches;
+  weighted_moslqo_sum_ += result.segment.moslqo() * num_patches;
+  result.running_moslqo = RunningMoslqo();
+  result.num_patches = num_patches_;
+  handler_(result);
+  return google::protobuf::util::Status();
+}
+}  // namespace Visqol
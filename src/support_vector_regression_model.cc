@@ -14,20 +14,54 @@
 
 #include "support_vector_regression_model.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/status_macros.h"
 #include "svm.h"
 
+#include "dense_rbf_model.h"
+#include "embedded_svr_model.h"
 #include "file_path.h"
 #include "libsvm_target_observation_convertor.h"
+#include "reference_feature_store.h"
 
 namespace Visqol {
+namespace {
+// Read the size and the hash of a LIBSVM model file, which identify the
+// version of the file that a compiled model was built from.
+bool ReadSourceFingerprint(const FilePath &model_path, uint64_t *size,
+                           uint64_t *hash) {
+  std::ifstream model_file(model_path.Path().c_str(), std::ios::binary);
+  if (!model_file) {
+    return false;
+  }
+  const std::string contents{std::istreambuf_iterator<char>(model_file),
+                             std::istreambuf_iterator<char>()};
+  *size = contents.size();
+  *hash = ReferenceFeatureStore::Hash(contents);
+  return true;
+}
+
+bool EndsWith(const std::string &str, const std::string &suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}  // namespace
+
+const char SupportVectorRegressionModel::kCompiledModelExtension[] = ".vqsvr";
 
 absl::Mutex SupportVectorRegressionModel::load_model_mutex_{};
 
 SupportVectorRegressionModel::SupportVectorRegressionModel():
+    model_{nullptr},
     observations_ptr_{nullptr},
     num_observations_{0}
 {
@@ -49,6 +83,13 @@ SupportVectorRegressionModel::~SupportVectorRegressionModel() {
 void SupportVectorRegressionModel::Init(
     const std::vector<MlObservation> &observations,
     const std::vector<MlTarget> &targets) {
+  Init(observations, targets, SvrTrainingParams());
+}
+
+void SupportVectorRegressionModel::Init(
+    const std::vector<MlObservation> &observations,
+    const std::vector<MlTarget> &targets,
+    const SvrTrainingParams &params) {
   // Assumes all observations have same number of features
   size_t num_features = observations[0].size();
 
@@ -67,16 +108,17 @@ void SupportVectorRegressionModel::Init(
 
   // Setup the SVM parameters.
   svm_parameter param;
-  param.C = 0.4;          // cost
+  param.C = params.cost;          // cost
   param.svm_type = NU_SVR;     // SVR
   param.kernel_type = RBF;  // radial
-  param.nu = 0.6;         // SVR nu
+  param.nu = params.nu;         // SVR nu
 
   // These values are the defaults used in the Matlab version
   // as found in svm_model_matlab.c
-  param.gamma = 1.0 / static_cast<double>(num_features);
+  param.gamma = params.gamma > 0.0 ? params.gamma :
+      1.0 / static_cast<double>(num_features);
   param.coef0 = 0;
-  param.cache_size = 100;  // in MB
+  param.cache_size = params.cache_size_mb;  // in MB
   param.shrinking = 1;
   param.probability = 0;
   param.degree = 3;
@@ -89,10 +131,14 @@ void SupportVectorRegressionModel::Init(
   param.weight = NULL;
 
   model_ = svm_train(&problem, &param);
+  dense_model_ = DenseRbfModel::FromSvmModel(model_);
 }
 
 double SupportVectorRegressionModel::Predict(
     const std::vector<double> &observation) const {
+  if (dense_model_ != nullptr) {
+    return dense_model_->Predict(observation);
+  }
   const LibSvmTargetObservationConvertor conv;
   svm_node *obs_node = conv.ConvertObservation(observation);
   const double prediction = svm_predict(model_, obs_node);
@@ -101,8 +147,56 @@ double SupportVectorRegressionModel::Predict(
   return prediction;
 }
 
+std::vector<double> SupportVectorRegressionModel::PredictBatch(
+    const std::vector<MlObservation> &observations) const {
+  const bool all_dense = dense_model_ != nullptr &&
+      std::all_of(observations.begin(), observations.end(),
+                  [this](const MlObservation &observation) {
+                    return observation.size() == dense_model_->NumFeatures();
+                  });
+  if (all_dense) {
+    return dense_model_->PredictBatch(observations);
+  }
+  std::vector<double> predictions;
+  predictions.reserve(observations.size());
+  for (const auto &observation : observations) {
+    predictions.push_back(Predict(observation));
+  }
+  return predictions;
+}
+
 google::protobuf::util::Status SupportVectorRegressionModel::Init(
     const FilePath &model_path) {
+  uint64_t source_size;
+  uint64_t source_hash;
+  if (EndsWith(model_path.Path(), kCompiledModelExtension)) {
+    dense_model_ = DenseRbfModel::Load(model_path.Path(), &source_size,
+                                       &source_hash);
+    if (dense_model_ == nullptr) {
+      return google::protobuf::util::Status(
+          google::protobuf::util::error::Code::INVALID_ARGUMENT,
+          "Failed to load the compiled SVR model file: " + model_path.Path());
+    }
+    return google::protobuf::util::Status();
+  }
+
+  // Use the compiled model next to the model file if it was compiled from
+  // this version of the file.
+  const std::string compiled_path = model_path.Path() +
+      kCompiledModelExtension;
+  uint64_t model_size;
+  uint64_t model_hash;
+  if (FilePath(compiled_path).Exists() &&
+      ReadSourceFingerprint(model_path, &model_size, &model_hash)) {
+    dense_model_ = DenseRbfModel::Load(compiled_path, &source_size,
+                                       &source_hash);
+    if (dense_model_ != nullptr && source_size == model_size &&
+        source_hash == model_hash) {
+      return google::protobuf::util::Status();
+    }
+    dense_model_.reset();
+  }
+
   absl::MutexLock lock(&load_model_mutex_);
   model_ = svm_load_model(model_path.Path().c_str());
 
@@ -111,7 +205,51 @@ google::protobuf::util::Status SupportVectorRegressionModel::Init(
         google::protobuf::util::error::Code::INVALID_ARGUMENT,
         "Failed to load the SVR model file: " + model_path.Path());
   }
+  dense_model_ = DenseRbfModel::FromSvmModel(model_);
+
+  return google::protobuf::util::Status();
+}
+
+void SupportVectorRegressionModel::Init(const EmbeddedSvrModel &model) {
+  dense_model_ = DenseRbfModel::FromEmbedded(model);
+}
 
+google::protobuf::util::Status SupportVectorRegressionModel::Compile(
+    const FilePath &model_path, const FilePath &compiled_path) {
+  uint64_t source_size;
+  uint64_t source_hash;
+  if (!ReadSourceFingerprint(model_path, &source_size, &source_hash)) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::Code::INVALID_ARGUMENT,
+        "Failed to read the SVR model file: " + model_path.Path());
+  }
+  // The text model is loaded directly, as Init would load the compiled model
+  // that an earlier run wrote next to it.
+  svm_model *text_model;
+  {
+    absl::MutexLock lock(&load_model_mutex_);
+    text_model = svm_load_model(model_path.Path().c_str());
+  }
+  if (text_model == nullptr) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::Code::INVALID_ARGUMENT,
+        "Failed to load the SVR model file: " + model_path.Path());
+  }
+  const std::unique_ptr<DenseRbfModel> dense_model =
+      DenseRbfModel::FromSvmModel(text_model);
+  svm_free_and_destroy_model(&text_model);
+  if (dense_model == nullptr) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::Code::INVALID_ARGUMENT,
+        "Only SVR models with an RBF kernel can be compiled: " +
+        model_path.Path());
+  }
+  if (!dense_model->Save(compiled_path.Path(), source_size, source_hash)) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::Code::INTERNAL,
+        "Failed to write the compiled SVR model file: " +
+        compiled_path.Path());
+  }
   return google::protobuf::util::Status();
 }
 
@@ -0,0 +1,94 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "svr_model_registry.h"
+
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "embedded_svr_model.h"
+#include "file_path.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+namespace {
+// A model file, identified by its path and the hash of its contents.
+using ModelKey = std::pair<std::string, size_t>;
+
+// The loaded models. They are held weakly, so that a model is freed with its
+// last user.
+struct Registry {
+  absl::Mutex mutex;
+  std::map<ModelKey, std::weak_ptr<const SupportVectorRegressionModel>>
+      models;
+};
+
+Registry &GetRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+}  // namespace
+
+google::protobuf::util::StatusOr<
+    std::shared_ptr<const SupportVectorRegressionModel>>
+SvrModelRegistry::Get(const FilePath &model_path) {
+  std::ifstream model_file(model_path.Path().c_str(), std::ios::binary);
+  if (!model_file) {
+    return google::protobuf::util::Status(
+        google::protobuf::util::error::Code::INVALID_ARGUMENT,
+        "Failed to load the SVR model file: " + model_path.Path());
+  }
+  const std::string contents{std::istreambuf_iterator<char>(model_file),
+                             std::istreambuf_iterator<char>()};
+  const ModelKey key{model_path.Path(), std::hash<std::string>()(contents)};
+
+  Registry &registry = GetRegistry();
+  // The lock is held while the model is loaded, so that it is only loaded
+  // once however many users ask for it at the same time.
+  absl::MutexLock lock(&registry.mutex);
+  auto &entry = registry.models[key];
+  std::shared_ptr<const SupportVectorRegressionModel> model = entry.lock();
+  if (model == nullptr) {
+    auto loaded = std::make_shared<SupportVectorRegressionModel>();
+    const google::protobuf::util::Status status = loaded->Init(model_path);
+    if (!status.ok()) {
+      registry.models.erase(key);
+      return status;
+    }
+    model = std::move(loaded);
+    entry = model;
+  }
+  return model;
+}
+
+std::shared_ptr<const SupportVectorRegressionModel>
+SvrModelRegistry::GetEmbedded() {
+  static const auto *model =
+      new std::shared_ptr<const SupportVectorRegressionModel>([] {
+        auto embedded = std::make_shared<SupportVectorRegressionModel>();
+        embedded->Init(kEmbeddedSvrModel);
+        return embedded;
+      }());
+  return *model;
+}
+}  // namespace Visqol
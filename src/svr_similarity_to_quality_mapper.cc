@@ -14,11 +14,14 @@
 
 #include "svr_similarity_to_quality_mapper.h"
 
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "google/protobuf/stubs/status.h"
 
 #include "file_path.h"
+#include "svr_model_registry.h"
 
 namespace Visqol {
 SvrSimilarityToQualityMapper::SvrSimilarityToQualityMapper(
@@ -26,11 +29,29 @@ SvrSimilarityToQualityMapper::SvrSimilarityToQualityMapper(
     : model_path_{support_vector_model} {}
 
 google::protobuf::util::Status SvrSimilarityToQualityMapper::Init() {
-  return model_.Init(model_path_);
+  if (model_path_.Path().empty()) {
+    model_ = SvrModelRegistry::GetEmbedded();
+    return google::protobuf::util::Status();
+  }
+  auto model_or = SvrModelRegistry::Get(model_path_);
+  if (!model_or.ok()) {
+    return model_or.status();
+  }
+  model_ = std::move(model_or.ValueOrDie());
+  return google::protobuf::util::Status();
 }
 
 double SvrSimilarityToQualityMapper::PredictQuality(
     const std::vector<double> &similarity_vector) const {
-  return std::max(1.0, std::min(5.0, model_.Predict(similarity_vector)));
+  return std::max(1.0, std::min(5.0, model_->Predict(similarity_vector)));
+}
+
+std::vector<double> SvrSimilarityToQualityMapper::PredictQualityBatch(
+    const std::vector<std::vector<double>> &similarity_vectors) const {
+  std::vector<double> qualities = model_->PredictBatch(similarity_vectors);
+  for (double &quality : qualities) {
+    quality = std::max(1.0, std::min(5.0, quality));
+  }
+  return qualities;
 }
 }  // namespace Visqol
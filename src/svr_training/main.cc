@@ -0,0 +1,56 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compiles a LIBSVM model file to a compiled model file, which ViSQOL reads
+// in its place without parsing it.
+
+#include <string>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "file_path.h"
+#include "support_vector_regression_model.h"
+
+ABSL_FLAG(std::string, model, "",
+"The path to the LIBSVM model file to compile.");
+ABSL_FLAG(std::string, compiled_model, "",
+"The path to write the compiled model file to. Defaults to the path of the\n"
+"model with .vqsvr appended, which ViSQOL loads automatically in place of\n"
+"the model, for as long as the model file is not changed.");
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  const std::string model = absl::GetFlag(FLAGS_model);
+  if (model.empty()) {
+    ABSL_RAW_LOG(ERROR, "Set --model to the LIBSVM model file to compile.");
+    return -1;
+  }
+  std::string compiled_model = absl::GetFlag(FLAGS_compiled_model);
+  if (compiled_model.empty()) {
+    compiled_model = model +
+        Visqol::SupportVectorRegressionModel::kCompiledModelExtension;
+  }
+
+  const google::protobuf::util::Status status =
+      Visqol::SupportVectorRegressionModel::Compile(
+          Visqol::FilePath(model), Visqol::FilePath(compiled_model));
+  if (!status.ok()) {
+    ABSL_RAW_LOG(ERROR, "%s", status.error_message().ToString().c_str());
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "svr_grid_search.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "machine_learning.h"
+#include "parallel_executor.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+std::vector<SvrGridPoint> SvrGridSearch::Search(
+    const std::vector<MlObservation> &observations,
+    const std::vector<MlTarget> &targets, const std::vector<double> &costs,
+    const std::vector<double> &nus, const std::vector<double> &gammas,
+    size_t num_folds, size_t num_workers, double cache_size_mb) {
+  std::vector<SvrGridPoint> points;
+  points.reserve(costs.size() * nus.size() * gammas.size());
+  for (const double cost : costs) {
+    for (const double nu : nus) {
+      for (const double gamma : gammas) {
+        SvrGridPoint point;
+        point.params.cost = cost;
+        point.params.nu = nu;
+        point.params.gamma = gamma;
+        point.params.cache_size_mb = cache_size_mb;
+        point.mean_squared_error = 0.0;
+        points.push_back(point);
+      }
+    }
+  }
+
+  ParallelExecutor::ForEach(points.size(), num_workers, [&](size_t i) {
+    points[i].mean_squared_error = CrossValidate(observations, targets,
+                                                 points[i].params, num_folds);
+  });
+  return points;
+}
+
+SvrGridPoint SvrGridSearch::Best(const std::vector<SvrGridPoint> &points) {
+  return *std::min_element(points.begin(), points.end(),
+      [](const SvrGridPoint &a, const SvrGridPoint &b) {
+        return a.mean_squared_error < b.mean_squared_error;
+      });
+}
+
+double SvrGridSearch::CrossValidate(
+    const std::vector<MlObservation> &observations,
+    const std::vector<MlTarget> &targets, const SvrTrainingParams &params,
+    size_t num_folds) {
+  double squared_error = 0.0;
+  for (size_t fold = 0; fold < num_folds; fold++) {
+    std::vector<MlObservation> train_observations;
+    std::vector<MlTarget> train_targets;
+    std::vector<MlObservation> test_observations;
+    std::vector<MlTarget> test_targets;
+    for (size_t i = 0; i < observations.size(); i++) {
+      if (i % num_folds == fold) {
+        test_observations.push_back(observations[i]);
+        test_targets.push_back(targets[i]);
+      } else {
+        train_observations.push_back(observations[i]);
+        train_targets.push_back(targets[i]);
+      }
+    }
+
+    SupportVectorRegressionModel model;
+    model.Init(train_observations, train_targets, params);
+    const std::vector<double> predictions =
+        model.PredictBatch(test_observations);
+    for (size_t i = 0; i < predictions.size(); i++) {
+      const double error = predictions[i] - test_targets[i];
+      squared_error += error * error;
+    }
+  }
+  return squared_error / observations.size();
+}
+}  // namespace Visqol
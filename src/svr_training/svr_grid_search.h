@@ -0,0 +1,105 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VISQOL_INCLUDE_SVRGRIDSEARCH_H
+#define VISQOL_INCLUDE_SVRGRIDSEARCH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "machine_learning.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+/**
+ * The k-fold cross validation score of a set of SVR training parameters.
+ */
+struct SvrGridPoint {
+  /**
+   * The parameters that the folds were trained with.
+   */
+  SvrTrainingParams params;
+
+  /**
+   * The mean squared error of the predictions of the held out observations.
+   */
+  double mean_squared_error;
+};
+
+/**
+ * Searches a grid of costs, nus and gammas for the parameters that an SVR
+ * model predicts the targets of its training data best with, as LIBSVM's
+ * grid.py does for svm-train.
+ *
+ * Each point of the grid is scored with k-fold cross validation. The points
+ * are independent, so they are fitted in parallel, one point per worker
+ * thread at a time. The folds are not shuffled, so the scores are the same
+ * however many workers there are.
+ */
+class SvrGridSearch {
+ public:
+  /**
+   * Score every combination of the given costs, nus and gammas.
+   *
+   * @param observations The training observations.
+   * @param targets The target of each observation.
+   * @param costs The costs to try.
+   * @param nus The nus to try.
+   * @param gammas The gammas to try. A gamma of 0 is 1 over the number of
+   *    features of the observations.
+   * @param num_folds The number of folds to score each point with. The
+   *    observation at index i is held out in fold i % num_folds. It must be
+   *    at least 2, and no more than the number of observations.
+   * @param num_workers The number of points to fit at the same time.
+   * @param cache_size_mb The size of the kernel cache of each fit, in MB.
+   *
+   * @return The score of each point, with the gammas varying fastest and the
+   *    costs slowest.
+   */
+  static std::vector<SvrGridPoint> Search(
+      const std::vector<MlObservation> &observations,
+      const std::vector<MlTarget> &targets, const std::vector<double> &costs,
+      const std::vector<double> &nus, const std::vector<double> &gammas,
+      size_t num_folds, size_t num_workers, double cache_size_mb);
+
+  /**
+   * Find the point of a search with the lowest error.
+   *
+   * @param points The scored points, which must not be empty.
+   *
+   * @return The first of the points with the lowest mean squared error.
+   */
+  static SvrGridPoint Best(const std::vector<SvrGridPoint> &points);
+
+  /**
+   * Score a single set of parameters with k-fold cross validation.
+   *
+   * @param observations The training observations.
+   * @param targets The target of each observation.
+   * @param params The parameters to train each fold with.
+   * @param num_folds The number of folds.
+   *
+   * @return The mean squared error of the predictions of the held out
+   *    observations.
+   */
+  static double CrossValidate(const std::vector<MlObservation> &observations,
+                              const std::vector<MlTarget> &targets,
+                              const SvrTrainingParams &params,
+                              size_t num_folds);
+};
+}  // namespace Visqol
+
+#endif  // VISQOL_INCLUDE_SVRGRIDSEARCH_H
@@ -14,29 +14,128 @@
 
 #include "training_data_file_reader.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "absl/strings/charconv.h"
 
 #include "file_path.h"
 
 namespace Visqol {
+namespace {
+// The contents of a file. Where the platform allows it, the file is mapped
+// into memory rather than copied, so large training files are parsed
+// straight from the page cache.
+class FileContents {
+ public:
+  explicit FileContents(const std::string &path) {
+#if !defined(_WIN32)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+      void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE,
+                           fd, 0);
+      if (mapping != MAP_FAILED) {
+        madvise(mapping, file_stat.st_size, MADV_SEQUENTIAL);
+        mapping_ = mapping;
+        data_ = static_cast<const char *>(mapping);
+        size_ = file_stat.st_size;
+      }
+    }
+    close(fd);
+    if (mapping_ != nullptr) {
+      return;
+    }
+#endif
+    std::ifstream in(path, std::ios::binary);
+    buffer_.assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+
+  ~FileContents() {
+#if !defined(_WIN32)
+    if (mapping_ != nullptr) {
+      munmap(mapping_, size_);
+    }
+#endif
+  }
+
+  FileContents(const FileContents &) = delete;
+  FileContents &operator=(const FileContents &) = delete;
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  void *mapping_ = nullptr;
+  std::string buffer_;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Parse a value as atof does: leading blanks are skipped, the longest number
+// at the start is parsed, and a value that is not a number is 0.
+double ParseValue(const char *begin, const char *end) {
+  while (begin != end && (*begin == ' ' || *begin == '\t')) {
+    begin++;
+  }
+  if (begin != end && *begin == '+') {
+    begin++;
+  }
+  double value = 0.0;
+  absl::from_chars(begin, end, value);
+  return value;
+}
+}  // namespace
+
 std::vector<std::vector<double>> TrainingDataFileReader::Read(
     const FilePath &data_filepath, const char delimiter) {
+  const FileContents contents(data_filepath.Path());
+  const char *pos = contents.data();
+  const char *const end = pos + contents.size();
   std::vector<std::vector<double>> values;
-  std::vector<double> value_line;
-  std::ifstream fin(data_filepath.Path());
-  std::string item, line;
-  while (getline(fin, line)) {
-    std::istringstream in(line);
-
-    while (getline(in, item, delimiter)) {
-      value_line.push_back(atof(item.c_str()));
+  values.reserve(std::count(pos, end, '\n') + 1);
+  size_t row_size = 0;
+  while (pos != end) {
+    const char *line_end = static_cast<const char *>(
+        std::memchr(pos, '\n', end - pos));
+    if (line_end == nullptr) {
+      line_end = end;
     }
-
-    values.push_back(value_line);
-    value_line.clear();
+    // As with getline, a delimiter at the end of the line does not start
+    // another value.
+    std::vector<double> value_line;
+    value_line.reserve(row_size);
+    while (pos != line_end) {
+      const char *item_end = static_cast<const char *>(
+          std::memchr(pos, delimiter, line_end - pos));
+      if (item_end == nullptr) {
+        item_end = line_end;
+      }
+      value_line.push_back(ParseValue(pos, item_end));
+      pos = item_end == line_end ? line_end : item_end + 1;
+    }
+    row_size = value_line.size();
+    values.push_back(std::move(value_line));
+    pos = line_end == end ? end : line_end + 1;
   }
-  fin.close();
   return values;
 }
-}  // namespace Visqol
\ No newline at end of file
+}  // namespace Visqol
@@ -62,7 +62,8 @@ class TrainingDataFileReader {
  public:
   /**
    * Read in a file containing either targets or observations for training the
-   * SVR model with.
+   * SVR model with. The file is mapped into memory where the platform allows
+   * it, and the values are parsed in place, without copying each row.
    *
    * @param data_filepath The filepath to the file containing the training data
    *    to read.
@@ -0,0 +1,119 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+#include "thread_pinning.h"
+#include "worker_pool.h"
+
+namespace Visqol {
+size_t TaskGraph::AddTask(std::function<void()> task,
+                          const std::vector<size_t> &dependencies) {
+  const size_t index = tasks_.size();
+  tasks_.push_back(std::move(task));
+  num_dependencies_.push_back(dependencies.size());
+  dependents_.emplace_back();
+  for (const size_t dependency : dependencies) {
+    assert(dependency < index);
+    dependents_[dependency].push_back(index);
+  }
+  return index;
+}
+
+size_t TaskGraph::NumTasks() const { return tasks_.size(); }
+
+void TaskGraph::Run(size_t num_workers) {
+  const size_t num_tasks = tasks_.size();
+  const size_t num_threads = std::min(std::max(num_workers, size_t{1}),
+                                      num_tasks);
+  if (num_threads <= 1) {
+    // Every dependency was added before its dependents, so the order that
+    // the tasks were added in satisfies the dependencies.
+    for (const auto &task : tasks_) {
+      task();
+    }
+    return;
+  }
+
+  // The ready tasks are taken in the order that they were added, so the
+  // stages that the tasks were added for first are started first. The state
+  // of the run is shared with the jobs that it submits to the pool, which
+  // may only start once every task has completed.
+  struct RunState {
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::deque<size_t> ready;
+    std::vector<size_t> remaining;
+    size_t num_completed = 0;
+  };
+  const auto state = std::make_shared<RunState>();
+  state->remaining = num_dependencies_;
+  for (size_t i = 0; i < num_tasks; i++) {
+    if (state->remaining[i] == 0) {
+      state->ready.push_back(i);
+    }
+  }
+
+  // The workers count their allocations with the calling thread, and run its
+  // tasks on the CPUs that it is pinned to. The graph and the counter are
+  // only used while a task is left to run.
+  AllocationCounter *const allocation_counter = AllocationCounter::Current();
+  auto worker = [this, state, num_tasks, allocation_counter](
+                    const std::vector<int> &pin_cpus) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+      state->task_ready.wait(lock, [&]() {
+        return !state->ready.empty() || state->num_completed == num_tasks;
+      });
+      if (state->ready.empty()) {
+        return;
+      }
+      const size_t task = state->ready.front();
+      state->ready.pop_front();
+      lock.unlock();
+      {
+        const ScopedThreadPin pin(pin_cpus);
+        AllocationCounter::ThreadScope allocation_scope(allocation_counter);
+        tasks_[task]();
+      }
+      lock.lock();
+      state->num_completed++;
+      for (const size_t dependent : dependents_[task]) {
+        if (--state->remaining[dependent] == 0) {
+          state->ready.push_back(dependent);
+        }
+      }
+      state->task_ready.notify_all();
+    }
+  };
+  // The calling thread is one of the workers, and the others are the threads
+  // of the shared pool that are free to take a job.
+  const std::vector<int> pin_cpus = ScopedThreadPin::CurrentCpus();
+  for (size_t t = 1; t < num_threads; t++) {
+    WorkerPool::Shared().Submit([worker, pin_cpus]() { worker(pin_cpus); });
+  }
+  worker({});
+}
+}  // namespace Visqol
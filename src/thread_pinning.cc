@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 Google LLC, Andrew Hines
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pinning.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+std::vector<std::vector<int>> ThreadPinning::NodeCpus(
+    const std::string &sysfs_node_dir) {
+  // The nodes are read in the order of their numbers, which the directory
+  // listing does not guarantee.
+  std::vector<std::vector<int>> node_cpus;
+  for (int node = 0;; node++) {
+    const boost::filesystem::path cpu_list_path =
+        boost::filesystem::path(sysfs_node_dir) /
+        ("node" + std::to_string(node)) / "cpulist";
+    std::ifstream cpu_list_file(cpu_list_path.string());
+    if (!cpu_list_file) {
+      break;
+    }
+    std::string cpu_list;
+    std::getline(cpu_list_file, cpu_list);
+    std::vector<int> cpus = ParseCpuList(cpu_list);
+    // Nodes of memory only have no CPUs.
+    if (!cpus.empty()) {
+      node_cpus.push_back(std::move(cpus));
+    }
+  }
+  if (node_cpus.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0;
+         cpu < static_cast<int>(std::thread::hardware_concurrency()); cpu++) {
+      cpus.push_back(cpu);
+    }
+    node_cpus.push_back(cpus);
+  }
+  return node_cpus;
+}
+
+std::vector<int> ThreadPinning::ParseCpuList(const std::string &cpu_list) {
+  std::vector<int> cpus;
+  std::istringstream in(cpu_list);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    int first;
+    int last;
+    char dash;
+    std::istringstream range_in(range);
+    if (!(range_in >> first)) {
+      return {};
+    }
+    last = first;
+    if (range_in >> dash) {
+      if (dash != '-' || !(range_in >> last) || last < first) {
+        return {};
+      }
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> ThreadPinning::WorkerCpus(
+    size_t worker, VisqolConfig::VisqolOptions::ThreadPinning pinning,
+    const std::vector<std::vector<int>> &node_cpus) {
+  if (pinning == VisqolConfig::VisqolOptions::NO_PINNING ||
+      node_cpus.empty()) {
+    return {};
+  }
+  const std::vector<int> &cpus = node_cpus[worker % node_cpus.size()];
+  if (pinning == VisqolConfig::VisqolOptions::PIN_TO_NODE || cpus.empty()) {
+    return cpus;
+  }
+  // The workers of a node take its CPUs in turn.
+  return {cpus[(worker / node_cpus.size()) % cpus.size()]};
+}
+
+bool ThreadPinning::PinCurrentThread(const std::vector<int> &cpus) {
+#if defined(__linux__)
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
+std::vector<int> ThreadPinning::CurrentThreadCpus() {
+  std::vector<int> cpus;
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set),
+                             &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+namespace {
+// The CPUs of the innermost ScopedThreadPin that pinned the current thread.
+thread_local const std::vector<int> *current_pin_cpus = nullptr;
+}  // namespace
+
+ScopedThreadPin::ScopedThreadPin(const std::vector<int> &cpus) {
+  if (cpus.empty()) {
+    return;
+  }
+  std::vector<int> previous_cpus = ThreadPinning::CurrentThreadCpus();
+  if (!previous_cpus.empty() && ThreadPinning::PinCurrentThread(cpus)) {
+    previous_cpus_ = std::move(previous_cpus);
+    cpus_ = cpus;
+    previous_pin_cpus_ = current_pin_cpus;
+    current_pin_cpus = &cpus_;
+  }
+}
+
+ScopedThreadPin::~ScopedThreadPin() {
+  if (!previous_cpus_.empty()) {
+    ThreadPinning::PinCurrentThread(previous_cpus_);
+    current_pin_cpus = previous_pin_cpus_;
+  }
+}
+
+std::vector<int> ScopedThreadPin::CurrentCpus() {
+  return current_pin_cpus != nullptr ? *current_pin_cpus : std::vector<int>();
+}
+}  // namespace Visqol
@@ -0,0 +1,161 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "trace_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+struct TraceEvent {
+  const char *category;
+  std::string name;
+  int64_t start_us;
+  int64_t duration_us;
+  uint32_t thread_id;
+  TraceWriter::Args args;
+};
+
+std::atomic<bool> enabled(false);
+std::mutex events_mutex;
+std::chrono::steady_clock::time_point trace_start;
+std::vector<TraceEvent> events;
+
+// The id of the calling thread in the trace. The threads are numbered in the
+// order that they first record an event, so the ids are small and stable.
+uint32_t TraceThreadId() {
+  static std::atomic<uint32_t> next_thread_id(1);
+  thread_local const uint32_t thread_id = next_thread_id++;
+  return thread_id;
+}
+
+std::string EscapeJson(const std::string &str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      case '\t':
+        escaped += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char code[7];
+          std::snprintf(code, sizeof(code), "\\u%04x", c);
+          escaped += code;
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
+void TraceWriter::Start() {
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.clear();
+  trace_start = std::chrono::steady_clock::now();
+  enabled.store(true, std::memory_order_release);
+}
+
+bool TraceWriter::IsEnabled() {
+  return enabled.load(std::memory_order_acquire);
+}
+
+void TraceWriter::AddEvent(const char *category, const std::string &name,
+                           std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end,
+                           const Args &args) {
+  if (!IsEnabled()) {
+    return;
+  }
+  const uint32_t thread_id = TraceThreadId();
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.push_back(TraceEvent{
+      category, name,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          start - trace_start).count(),
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          end - start).count(),
+      thread_id, args});
+}
+
+std::string TraceWriter::StopAndFormat() {
+  enabled.store(false, std::memory_order_release);
+  std::vector<TraceEvent> recorded;
+  {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    recorded.swap(events);
+  }
+  // Events are added as they end, so an enclosing event follows the events
+  // within it. They are listed in the order that they started, with an
+  // enclosing event before the events that start with it.
+  std::stable_sort(recorded.begin(), recorded.end(),
+                   [](const TraceEvent &a, const TraceEvent &b) {
+                     return a.start_us != b.start_us ?
+                         a.start_us < b.start_us :
+                         a.duration_us > b.duration_us;
+                   });
+
+  std::stringstream ss;
+  ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < recorded.size(); i++) {
+    const TraceEvent &event = recorded[i];
+    ss << (i == 0 ? "\n" : ",\n");
+    ss << "{\"name\":\"" << EscapeJson(event.name) << "\",\"cat\":\""
+       << event.category << "\",\"ph\":\"X\",\"ts\":" << event.start_us
+       << ",\"dur\":" << event.duration_us << ",\"pid\":1,\"tid\":"
+       << event.thread_id;
+    if (!event.args.empty()) {
+      ss << ",\"args\":{";
+      for (size_t a = 0; a < event.args.size(); a++) {
+        ss << (a == 0 ? "" : ",") << "\"" << EscapeJson(event.args[a].first)
+           << "\":\"" << EscapeJson(event.args[a].second) << "\"";
+      }
+      ss << "}";
+    }
+    ss << "}";
+  }
+  ss << "\n]}\n";
+  return ss.str();
+}
+
+bool TraceWriter::StopAndWrite(const FilePath &path) {
+  const std::string trace = StopAndFormat();
+  std::ofstream out(path.Path(), std::ios_base::binary);
+  out << trace;
+  return static_cast<bool>(out);
+}
+}  // namespace Visqol
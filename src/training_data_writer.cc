@@ -0,0 +1,149 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "training_data_writer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/strings/numbers.h"
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+// Format a value with enough digits that it is read back exactly.
+std::string FormatValue(const double value) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  return buffer;
+}
+}  // namespace
+
+const char TrainingDataWriter::kObservationsSuffix[] = "_fvnsims.txt";
+const char TrainingDataWriter::kTargetsSuffix[] = "_moslqs.txt";
+
+TrainingDataWriter::TargetMap TrainingDataWriter::ReadTargets(
+    const FilePath &batch_input_csv) {
+  TargetMap targets;
+  std::ifstream fin(batch_input_csv.Path());
+  std::string line;
+  std::getline(fin, line);  // skip the header
+  while (std::getline(fin, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    std::istringstream in(line);
+    std::vector<std::string> items;
+    std::string item;
+    while (std::getline(in, item, ',')) {
+      items.push_back(item);
+    }
+    double target;
+    if (items.size() < 3 || !absl::SimpleAtod(items[2], &target)) {
+      continue;
+    }
+    targets.emplace(std::make_pair(FilePath(items[0]).Path(),
+                                   FilePath(items[1]).Path()), target);
+  }
+  return targets;
+}
+
+std::string TrainingDataWriter::FormatObservation(
+    const SimilarityResultMsg &sim_res_msg) {
+  std::string row;
+  for (int i = 0; i < sim_res_msg.fvnsim_size(); i++) {
+    if (i > 0) {
+      row += ',';
+    }
+    row += FormatValue(sim_res_msg.fvnsim(i));
+  }
+  return row;
+}
+
+TrainingDataWriter::TrainingDataWriter(const std::string &output_prefix,
+                                       TargetMap targets)
+    : targets_(std::move(targets)),
+      observations_file_(output_prefix + kObservationsSuffix,
+                         std::ios_base::trunc),
+      targets_file_(output_prefix + kTargetsSuffix, std::ios_base::trunc) {}
+
+TrainingDataWriter::~TrainingDataWriter() {
+  Flush();
+}
+
+void TrainingDataWriter::Write(const size_t index,
+                               const SimilarityResultMsg &sim_res_msg) {
+  Row row;
+  const auto target = targets_.find(std::make_pair(
+      sim_res_msg.reference_filepath(), sim_res_msg.degraded_filepath()));
+  if (target == targets_.end()) {
+    ABSL_RAW_LOG(WARNING, "No MOS-LQS for the pair %s, %s.",
+                 sim_res_msg.reference_filepath().c_str(),
+                 sim_res_msg.degraded_filepath().c_str());
+  } else {
+    row.observation = FormatObservation(sim_res_msg);
+    row.target = FormatValue(target->second);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Add(index, std::move(row));
+}
+
+void TrainingDataWriter::Skip(const size_t index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Add(index, Row());
+}
+
+bool TrainingDataWriter::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &pending : pending_) {
+    Emit(pending.second);
+  }
+  pending_.clear();
+  observations_file_.flush();
+  targets_file_.flush();
+  return observations_file_.good() && targets_file_.good();
+}
+
+size_t TrainingDataWriter::NumRows() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_rows_;
+}
+
+void TrainingDataWriter::Add(const size_t index, Row &&row) {
+  pending_.emplace(index, std::move(row));
+  for (auto next = pending_.find(next_index_); next != pending_.end();
+       next = pending_.find(next_index_)) {
+    Emit(next->second);
+    pending_.erase(next);
+    next_index_++;
+  }
+}
+
+void TrainingDataWriter::Emit(const Row &row) {
+  if (row.observation.empty()) {
+    return;
+  }
+  observations_file_ << row.observation << '\n';
+  targets_file_ << row.target << '\n';
+  num_rows_++;
+}
+}  // namespace Visqol
@@ -18,12 +18,12 @@
 #include <numeric>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "google/protobuf/stubs/statusor.h"
 
 #include "amatrix.h"
 #include "analysis_window.h"
 #include "audio_signal.h"
-#include "misc_math.h"
 #include "rms_vad.h"
 
 namespace Visqol {
@@ -32,24 +32,20 @@ const double VadPatchCreator::kFramesWithVAThreshold = 1.0;
 
 std::vector<double> VadPatchCreator::GetVoiceActivity(
     const AudioSignal &signal, const size_t start_sample,
-    const size_t total_samples, const size_t frame_len) const {
+    const size_t total_samples, const size_t frame_len,
+    const double peak) const {
+  // The frames are measured in place in the first column of the signal, as
+  // the 16 bit samples that they convert to once normalized by the peak. A
+  // partial frame at the end is left out.
+  const size_t num_rows = signal.data_matrix.NumRows();
+  const size_t patch_begin = std::min(start_sample, num_rows);
+  const absl::Span<const double> patch(signal.data_matrix.data() + patch_begin,
+      std::min(total_samples, num_rows - patch_begin));
+  const size_t num_frames = frame_len == 0 ? 0 : patch.size() / frame_len;
   RmsVad rms_vad;
-  auto sig = signal.data_matrix.GetColumn(0);
-  auto patch = sig.GetRows(start_sample, start_sample + total_samples - 1);
-
-  std::vector<int16_t> frame;
-  frame.reserve(frame_len);
-
-  for (auto floatVal : patch) {
-    // Check the bounds.
-    floatVal = floatVal * (1 << 15);
-    floatVal = std::max(-1.0 * (1 << 15),
-                        std::min(1.0 * ((1 << 15) - 1), floatVal));
-    frame.emplace_back(floatVal);
-    if (frame.size() == frame_len) {
-      rms_vad.ProcessChunk(frame);
-      frame.clear();
-    }
+  rms_vad.Reserve(num_frames);
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    rms_vad.ProcessChunk(patch.subspan(frame * frame_len, frame_len), peak);
   }
 
   return rms_vad.GetVadResults();
@@ -59,8 +55,11 @@ google::protobuf::util::StatusOr<std::vector<size_t>>
     VadPatchCreator::CreateRefPatchIndices(const AMatrix<double> &spectrogram,
                                            const AudioSignal &ref_signal,
                                            const AnalysisWindow &window) const {
-  const auto norm_mat = MiscMath::Normalize(ref_signal.data_matrix);
-  const AudioSignal norm_sig{norm_mat, ref_signal.sample_rate};
+  // The VAD measures the reference signal normalized by its maximum, which
+  // it divides each sample by as it measures it, rather than normalizing a
+  // copy of the signal.
+  const auto &ref_mat = ref_signal.data_matrix;
+  const double peak = *std::max_element(ref_mat.cbegin(), ref_mat.cend());
   const double frame_size = window.size * window.overlap;
   const size_t patch_sample_len = patch_size_ * frame_size;
   const size_t spectrum_length = spectrogram.NumCols();
@@ -72,8 +71,8 @@ google::protobuf::util::StatusOr<std::vector<size_t>>
 
   // Pass the reference signal to the VAD to determine which frames have voice
   // activity.
-  const auto vad_res = GetVoiceActivity(norm_sig, first_patch_idx,
-      total_sample_count, frame_size);
+  const auto vad_res = GetVoiceActivity(ref_signal, first_patch_idx,
+      total_sample_count, frame_size, peak);
 
   // Based on the frame VAD data, determine which reference patches to include
   // in the comparison.
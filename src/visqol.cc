@@ -14,6 +14,9 @@
 
 #include "visqol.h"
 
+#include <algorithm>
+#include <cmath>
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -23,82 +26,254 @@
 #include "file_path.h"
 #include "misc_audio.h"
 #include "patch_similarity_comparator.h"
+#include "previous_comparison.h"
 #include "spectrogram.h"
 #include "comparison_patches_selector.h"
 #include "image_patch_creator.h"
 #include "similarity_result.h"
 #include "similarity_to_quality_mapper.h"
 #include "spectrogram_builder.h"
+#include "stage_timer.h"
+#include "visqol_workspace.h"
 
 namespace Visqol {
+const size_t Visqol::kPatchesPerRound = 8;
+
+Visqol::Visqol(double target_vnsim_stderr, bool lazy_degraded_spectrogram,
+               bool record_stage_timings, size_t num_workers)
+    : target_vnsim_stderr_(target_vnsim_stderr),
+      lazy_degraded_spectrogram_(lazy_degraded_spectrogram),
+      record_stage_timings_(record_stage_timings),
+      num_workers_(num_workers) {}
+
 google::protobuf::util::StatusOr<SimilarityResult>
 Visqol::CalculateSimilarity(
     const AudioSignal &ref_signal, AudioSignal &deg_signal,
-    SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
+    const SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
     const ImagePatchCreator *patch_creator,
     const ComparisonPatchesSelector *comparison_patches_selector,
-    const SimilarityToQualityMapper *sim_to_qual_mapper) const {
-  /////////////////// Stage 1: Preprocessing ///////////////////
-  deg_signal = MiscAudio::ScaleToMatchSoundPressureLevel(ref_signal,
-      deg_signal);
+    const SimilarityToQualityMapper *sim_to_qual_mapper,
+    VisqolWorkspace *workspace, const ReferenceFeatures *ref_features,
+    const PreviousComparison *previous,
+    const double *deg_scale_factor) const {
+  // The stages are only timed if asked to, so that the clock is not read
+  // otherwise.
+  StageTimings stage_timings;
+  StageTimings *timings = record_stage_timings_ ? &stage_timings : nullptr;
+  // The rounds choose their patches by the error of those compared so far,
+  // so an earlier comparison is only reused when every patch is compared.
+  if (target_vnsim_stderr_ > 0.0) {
+    previous = nullptr;
+  }
 
-  // build the reference spectrogram.
-  const auto ref_spectro_result = spect_builder->Build(ref_signal, window);
-  if (!ref_spectro_result.ok()) {
-    ABSL_RAW_LOG(ERROR, "Error building reference spectrogram: %s",
-                 ref_spectro_result.status().ToString().c_str());
-    return ref_spectro_result.status();
+  /////////////////// Stage 1: Preprocessing ///////////////////
+  // The degraded signal is the aligned copy that the caller owns, so it is
+  // scaled in place rather than replaced by a scaled copy.
+  {
+    ScopedStageTimer timer(timings, &StageTimings::spl_scaling);
+    if (deg_scale_factor != nullptr) {
+      for (double &sample : deg_signal.data_matrix) {
+        sample *= *deg_scale_factor;
+      }
+    } else {
+      MiscAudio::ScaleToMatchSoundPressureLevel(ref_signal, &deg_signal);
+    }
   }
 
-  // build the degraded spectrogram.
-  const auto deg_spectro_result = spect_builder->Build(deg_signal, window);
-  if (!deg_spectro_result.ok()) {
-    ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
-                 deg_spectro_result.status().ToString().c_str());
-    return deg_spectro_result.status();
+  Spectrogram ref_spectrogram;
+  Spectrogram deg_spectrogram;
+  std::vector<size_t> ref_patch_indices;
+  bool is_prepared = false;
+  if (lazy_degraded_spectrogram_ || previous != nullptr) {
+    auto lazy_result = BuildSearchedSpectrograms(ref_signal, deg_signal,
+        spect_builder, window, patch_creator, workspace, ref_features,
+        previous, &ref_spectrogram, &deg_spectrogram, &ref_patch_indices,
+        timings);
+    if (!lazy_result.ok()) {
+      return lazy_result.status();
+    }
+    is_prepared = lazy_result.ValueOrDie();
   }
+  // If the columns that were built do not give the floor of the whole
+  // spectrograms, which is rare, the spectrograms are built in full.
+  if (!is_prepared) {
+    ScopedStageTimer spectrograms_timer(timings, &StageTimings::spectrograms);
+    if (ref_features != nullptr) {
+      // Only the degraded spectrogram is built. The reference spectrogram is
+      // copied, as it is prepared for the comparison in place.
+      auto deg_spectro_result = spect_builder->Build(deg_signal, window,
+                                                     workspace);
+      if (!deg_spectro_result.ok()) {
+        ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
+                     deg_spectro_result.status().ToString().c_str());
+        return deg_spectro_result.status();
+      }
+      ref_spectrogram = ref_features->spectrogram;
+      deg_spectrogram = std::move(deg_spectro_result.ValueOrDie());
+    } else {
+      // build the reference and degraded spectrograms concurrently, within
+      // the worker budget of the comparison.
+      auto spectro_results = spect_builder->BuildPair(ref_signal, deg_signal,
+                                                      window, workspace,
+                                                      num_workers_);
+      auto &ref_spectro_result = spectro_results.first;
+      if (!ref_spectro_result.ok()) {
+        ABSL_RAW_LOG(ERROR, "Error building reference spectrogram: %s",
+                     ref_spectro_result.status().ToString().c_str());
+        return ref_spectro_result.status();
+      }
 
-  Spectrogram ref_spectrogram = ref_spectro_result.ValueOrDie();
-  Spectrogram deg_spectrogram = deg_spectro_result.ValueOrDie();
-  MiscAudio::PrepareSpectrogramsForComparison(ref_spectrogram, deg_spectrogram);
+      auto &deg_spectro_result = spectro_results.second;
+      if (!deg_spectro_result.ok()) {
+        ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
+                     deg_spectro_result.status().ToString().c_str());
+        return deg_spectro_result.status();
+      }
+
+      // The results are not used again, so their spectrograms are moved out.
+      ref_spectrogram = std::move(ref_spectro_result.ValueOrDie());
+      deg_spectrogram = std::move(deg_spectro_result.ValueOrDie());
+    }
+    spectrograms_timer.Stop();
+    {
+      ScopedStageTimer timer(timings, &StageTimings::spectrogram_prep);
+      MiscAudio::PrepareSpectrogramsForComparison(ref_spectrogram,
+                                                  deg_spectrogram);
+    }
+
+    // The patch indices only depend on the length of the spectrogram and on
+    // the reference signal, so they are the same before and after it is
+    // prepared.
+    ScopedStageTimer patch_indices_timer(timings,
+                                         &StageTimings::patch_indices);
+    if (ref_features != nullptr) {
+      ref_patch_indices = ref_features->patch_indices;
+    } else {
+      auto ref_patch_result = patch_creator->CreateRefPatchIndices(
+          ref_spectrogram.Data(), ref_signal, window);
+      if (!ref_patch_result.ok()) {
+        ABSL_RAW_LOG(ERROR, "Error creating reference patch indices: %s",
+                     ref_patch_result.status().ToString().c_str());
+        return ref_patch_result.status();
+      }
+      ref_patch_indices = std::move(ref_patch_result.ValueOrDie());
+    }
+  }
 
   /////////////// Stage 2: Feature selection and similarity measure ////////////
-  auto ref_patch_result = patch_creator->CreateRefPatchIndices(
-      ref_spectrogram.Data(), ref_signal, window);
-  if (!ref_patch_result.ok()) {
-    ABSL_RAW_LOG(ERROR, "Error creating reference patch indices: %s",
-                 ref_patch_result.status().ToString().c_str());
-    return ref_patch_result.status();
+  // Only a subset of the patches is compared if there are too many.
+  const size_t num_available_patches = ref_patch_indices.size();
+  {
+    ScopedStageTimer timer(timings, &StageTimings::patch_indices);
+    ref_patch_indices = patch_creator->SelectPatchIndices(ref_patch_indices);
   }
-  auto ref_patch_indices = ref_patch_result.ValueOrDie();
   const double frame_duration = CalcFrameDuration(window.size * window.overlap,
                                                   ref_signal.sample_rate);
 
-  auto ref_patches = patch_creator->CreatePatchesFromIndices(
-      ref_spectrogram.Data(), ref_patch_indices);
-  auto most_sim_patch_result =
-      comparison_patches_selector->FindMostSimilarDegPatches(
-          ref_patches, ref_patch_indices, deg_spectrogram.Data(),
-          frame_duration);
-  if (!most_sim_patch_result.ok()) {
-    return most_sim_patch_result.status();
+  std::vector<PatchSimilarityResult> sim_match_info;
+  size_t num_realign_skipped_patches = 0;
+  if (target_vnsim_stderr_ <= 0.0) {
+    // The patches that only read unchanged parts of the degraded signal keep
+    // their earlier results.
+    std::vector<PatchSimilarityResult> reused_patches;
+    if (previous != nullptr) {
+      ref_patch_indices = previous->SplitPatches(ref_patch_indices,
+          patch_creator->PatchSize(), frame_duration,
+          static_cast<double>(window.size) / ref_signal.sample_rate,
+          &reused_patches);
+    }
+    if (previous == nullptr || !ref_patch_indices.empty()) {
+      auto compare_result = ComparePatches(ref_spectrogram, deg_spectrogram,
+          ref_patch_indices, ref_signal, deg_signal, spect_builder, window,
+          frame_duration, patch_creator, comparison_patches_selector,
+          &num_realign_skipped_patches, workspace, timings);
+      if (!compare_result.ok()) {
+        return compare_result.status();
+      }
+      sim_match_info = std::move(compare_result.ValueOrDie());
+    }
+    if (!reused_patches.empty()) {
+      for (auto &patch : reused_patches) {
+        sim_match_info.push_back(std::move(patch));
+      }
+      std::sort(sim_match_info.begin(), sim_match_info.end(),
+                [](const PatchSimilarityResult &a,
+                   const PatchSimilarityResult &b) {
+                  return a.ref_patch_start_time < b.ref_patch_start_time;
+                });
+    }
+  } else {
+    // Compare the patches in rounds, in an order that spreads each round over
+    // the whole signal, until the mean similarity is known precisely enough.
+    const std::vector<size_t> order = StratifiedOrder(ref_patch_indices.size());
+    google::protobuf::util::Status last_error;
+    for (size_t begin = 0; begin < order.size(); begin += kPatchesPerRound) {
+      const size_t end = std::min(order.size(), begin + kPatchesPerRound);
+      std::vector<size_t> round_indices;
+      round_indices.reserve(end - begin);
+      for (size_t i = begin; i < end; i++) {
+        round_indices.push_back(ref_patch_indices[order[i]]);
+      }
+      std::sort(round_indices.begin(), round_indices.end());
+      size_t num_round_skipped = 0;
+      auto round_result = ComparePatches(ref_spectrogram, deg_spectrogram,
+          round_indices, ref_signal, deg_signal, spect_builder, window,
+          frame_duration, patch_creator, comparison_patches_selector,
+          &num_round_skipped, workspace, timings);
+      if (!round_result.ok()) {
+        // A round whose patches are all past the end of the degraded signal
+        // has nothing to compare, but the other rounds may.
+        if (round_result.status().error_code() !=
+            google::protobuf::util::error::CANCELLED) {
+          return round_result.status();
+        }
+        last_error = round_result.status();
+        continue;
+      }
+      num_realign_skipped_patches += num_round_skipped;
+      for (auto &patch : round_result.ValueOrDie()) {
+        sim_match_info.push_back(std::move(patch));
+      }
+      if (sim_match_info.size() >= kPatchesPerRound &&
+          CalcVnsimStandardError(sim_match_info, num_available_patches) <
+          target_vnsim_stderr_) {
+        break;
+      }
+    }
+    if (sim_match_info.empty()) {
+      return last_error;
+    }
+    std::sort(sim_match_info.begin(), sim_match_info.end(),
+              [](const PatchSimilarityResult &a,
+                 const PatchSimilarityResult &b) {
+                return a.ref_patch_start_time < b.ref_patch_start_time;
+              });
   }
-  auto sim_match_info = most_sim_patch_result.ValueOrDie();
 
-  // Realign the patches in time domain subsignals that start at the coarse
-  // patch times.
-  auto realign_result =
-      comparison_patches_selector->FinelyAlignAndRecreatePatches(
-          sim_match_info, ref_signal, deg_signal, spect_builder,
-          window);
-  if (!realign_result.ok()) {
-    return realign_result.status();
-  }
+  ScopedStageTimer mapping_timer(timings, &StageTimings::mapping);
+  SimilarityResult r = CombinePatchSimilarities(std::move(sim_match_info),
+      num_available_patches, num_realign_skipped_patches, sim_to_qual_mapper);
+  mapping_timer.Stop();
+  r.center_freq_bands = ref_spectrogram.GetCenterFreqBands();
+  r.timings = stage_timings;
 
-  sim_match_info = realign_result.ValueOrDie();
+  // The spectrograms are no longer used, so their matrices are kept for the
+  // next comparison.
+  if (workspace != nullptr) {
+    workspace->RecycleMatrix(ref_spectrogram.ReleaseData());
+    workspace->RecycleMatrix(deg_spectrogram.ReleaseData());
+  }
+  return r;
+}
 
-  auto fvnsim = CalcPerPatchMeanFreqBandMeans(sim_match_info);
+SimilarityResult Visqol::CombinePatchSimilarities(
+    std::vector<PatchSimilarityResult> patch_sims,
+    size_t num_available_patches, size_t num_realign_skipped_patches,
+    const SimilarityToQualityMapper *sim_to_qual_mapper) const {
+  auto fvnsim = CalcPerPatchMeanFreqBandMeans(patch_sims);
   double moslqo = PredictMos(fvnsim, sim_to_qual_mapper);
+  auto fvnsim_stderr = CalcFvnsimStandardError(patch_sims, fvnsim,
+                                               num_available_patches);
 
   // calc vnsim
   double sum = 0;
@@ -111,16 +286,239 @@ Visqol::CalculateSimilarity(
 
   // gather results
   SimilarityDebugInfo d;
-  d.patch_sims = std::move(sim_match_info);
+  d.patch_sims = std::move(patch_sims);
+  d.num_realign_skipped_patches = num_realign_skipped_patches;
+  d.num_available_patches = num_available_patches;
   SimilarityResult r;
   r.vnsim = vnsim;
   r.fvnsim = fvnsim.ToVector();
+  r.fvnsim_stderr = std::move(fvnsim_stderr);
   r.moslqo = moslqo;
   r.debug_info = std::move(d);
-  r.center_freq_bands = ref_spectrogram.GetCenterFreqBands();
   return r;
 }
 
+google::protobuf::util::StatusOr<bool> Visqol::BuildSearchedSpectrograms(
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+    const SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
+    const ImagePatchCreator *patch_creator, VisqolWorkspace *workspace,
+    const ReferenceFeatures *ref_features,
+    const PreviousComparison *previous, Spectrogram *ref_spectrogram,
+    Spectrogram *deg_spectrogram, std::vector<size_t> *ref_patch_indices,
+    StageTimings *timings) const {
+  if (ref_features != nullptr) {
+    *ref_spectrogram = ref_features->spectrogram;
+    *ref_patch_indices = ref_features->patch_indices;
+  } else {
+    ScopedStageTimer spectrogram_timer(timings, &StageTimings::spectrograms);
+    auto ref_spectro_result = spect_builder->Build(ref_signal, window,
+                                                   workspace);
+    if (!ref_spectro_result.ok()) {
+      ABSL_RAW_LOG(ERROR, "Error building reference spectrogram: %s",
+                   ref_spectro_result.status().ToString().c_str());
+      return ref_spectro_result.status();
+    }
+    *ref_spectrogram = std::move(ref_spectro_result.ValueOrDie());
+    spectrogram_timer.Stop();
+    ScopedStageTimer patch_indices_timer(timings,
+                                         &StageTimings::patch_indices);
+    auto ref_patch_result = patch_creator->CreateRefPatchIndices(
+        ref_spectrogram->Data(), ref_signal, window);
+    if (!ref_patch_result.ok()) {
+      ABSL_RAW_LOG(ERROR, "Error creating reference patch indices: %s",
+                   ref_patch_result.status().ToString().c_str());
+      return ref_patch_result.status();
+    }
+    *ref_patch_indices = std::move(ref_patch_result.ValueOrDie());
+  }
+
+  // Only the degraded frames around the compared patches are built, so the
+  // frames of silences without patches are never filtered. Patches that
+  // reuse an earlier result are not compared, so their frames are not built
+  // either.
+  std::vector<size_t> compared_indices =
+      patch_creator->SelectPatchIndices(*ref_patch_indices);
+  if (previous != nullptr) {
+    compared_indices = previous->SplitPatches(compared_indices,
+        patch_creator->PatchSize(),
+        CalcFrameDuration(window.size * window.overlap,
+                          ref_signal.sample_rate),
+        static_cast<double>(window.size) / ref_signal.sample_rate, nullptr);
+    if (compared_indices.empty()) {
+      return true;
+    }
+  }
+  const SpectrogramColumnRanges columns =
+      ComparisonPatchesSelector::SearchedColumns(compared_indices,
+                                                 patch_creator->PatchSize());
+  ScopedStageTimer spectrogram_timer(timings, &StageTimings::spectrograms);
+  auto deg_spectro_result = spect_builder->BuildColumnRanges(
+      deg_signal, window, columns, workspace);
+  if (!deg_spectro_result.ok()) {
+    ABSL_RAW_LOG(ERROR, "Error building degraded spectrogram: %s",
+                 deg_spectro_result.status().ToString().c_str());
+    return deg_spectro_result.status();
+  }
+  *deg_spectrogram = std::move(deg_spectro_result.ValueOrDie());
+  spectrogram_timer.Stop();
+  ScopedStageTimer prep_timer(timings, &StageTimings::spectrogram_prep);
+  return MiscAudio::PrepareSpectrogramColumnsForComparison(
+      *ref_spectrogram, *deg_spectrogram, columns);
+}
+
+google::protobuf::util::StatusOr<std::vector<PatchSimilarityResult>>
+Visqol::ComparePatches(
+    const Spectrogram &ref_spectrogram, const Spectrogram &deg_spectrogram,
+    const std::vector<size_t> &ref_patch_indices,
+    const AudioSignal &ref_signal, const AudioSignal &deg_signal,
+    const SpectrogramBuilder *spect_builder, const AnalysisWindow &window,
+    double frame_duration, const ImagePatchCreator *patch_creator,
+    const ComparisonPatchesSelector *comparison_patches_selector,
+    size_t *num_realign_skipped, VisqolWorkspace *workspace,
+    StageTimings *timings) const {
+  ScopedStageTimer search_timer(timings, &StageTimings::coarse_search);
+  auto ref_patches = patch_creator->CreatePatchesFromIndices(
+      ref_spectrogram.Data(), ref_patch_indices);
+  auto most_sim_patch_result =
+      comparison_patches_selector->FindMostSimilarDegPatches(
+          ref_patches, ref_patch_indices, deg_spectrogram.Data(),
+          frame_duration, workspace);
+  if (!most_sim_patch_result.ok()) {
+    return most_sim_patch_result.status();
+  }
+  search_timer.Stop();
+
+  // Realign the patches in time domain subsignals that start at the coarse
+  // patch times.
+  ScopedStageTimer realign_timer(timings, &StageTimings::fine_alignment);
+  return comparison_patches_selector->FinelyAlignAndRecreatePatches(
+      most_sim_patch_result.ValueOrDie(), ref_signal, deg_signal,
+      spect_builder, window, num_realign_skipped, workspace);
+}
+
+std::vector<size_t> Visqol::StratifiedOrder(size_t num_patches) {
+  // Visit the patches in bit reversed order of their position, so that every
+  // prefix of the order is spread evenly over the signal. The order is fixed,
+  // so the same patches are compared on every run.
+  size_t num_bits = 0;
+  while ((static_cast<size_t>(1) << num_bits) < num_patches) {
+    num_bits++;
+  }
+  std::vector<size_t> order;
+  order.reserve(num_patches);
+  for (size_t i = 0; i < (static_cast<size_t>(1) << num_bits); i++) {
+    size_t reversed = 0;
+    for (size_t bit = 0; bit < num_bits; bit++) {
+      if (i & (static_cast<size_t>(1) << bit)) {
+        reversed |= static_cast<size_t>(1) << (num_bits - 1 - bit);
+      }
+    }
+    if (reversed < num_patches) {
+      order.push_back(reversed);
+    }
+  }
+  return order;
+}
+
+double Visqol::CalcVnsimStandardError(
+    const std::vector<PatchSimilarityResult> &sim_match_info,
+    size_t num_available_patches) const {
+  const size_t n = sim_match_info.size();
+  if (n < 2 || n >= num_available_patches) {
+    return 0.0;
+  }
+  // The VNSIM is the mean over the patches of the mean similarity of the
+  // bands of each patch.
+  std::vector<double> patch_means;
+  patch_means.reserve(n);
+  double sum = 0.0;
+  for (const auto &p : sim_match_info) {
+    const size_t num_bands = p.freq_band_means.NumRows();
+    double band_sum = 0.0;
+    for (size_t band = 0; band < num_bands; band++) {
+      band_sum += p.freq_band_means.data()[band];
+    }
+    patch_means.push_back(band_sum / num_bands);
+    sum += patch_means.back();
+  }
+  const double mean = sum / n;
+  double sum_sq = 0.0;
+  for (const double patch_mean : patch_means) {
+    sum_sq += (patch_mean - mean) * (patch_mean - mean);
+  }
+  const double correction = static_cast<double>(num_available_patches - n) /
+                            (num_available_patches - 1);
+  return std::sqrt(sum_sq / (n - 1) / n * correction);
+}
+
+google::protobuf::util::StatusOr<ReferenceFeatures>
+Visqol::BuildReferenceFeatures(
+    const AudioSignal &ref_signal, const SpectrogramBuilder *spect_builder,
+    const AnalysisWindow &window,
+    const ImagePatchCreator *patch_creator) const {
+  ReferenceFeatures features;
+  auto spectro_result = spect_builder->Build(ref_signal, window);
+  if (!spectro_result.ok()) {
+    ABSL_RAW_LOG(ERROR, "Error building reference spectrogram: %s",
+                 spectro_result.status().ToString().c_str());
+    return spectro_result.status();
+  }
+  features.spectrogram = std::move(spectro_result.ValueOrDie());
+
+  auto patch_result = patch_creator->CreateRefPatchIndices(
+      features.spectrogram.Data(), ref_signal, window);
+  if (!patch_result.ok()) {
+    ABSL_RAW_LOG(ERROR, "Error creating reference patch indices: %s",
+                 patch_result.status().ToString().c_str());
+    return patch_result.status();
+  }
+  features.patch_indices = std::move(patch_result.ValueOrDie());
+  return features;
+}
+
+std::vector<SimilarityWindow> Visqol::CalculateTimeline(
+    const std::vector<PatchSimilarityResult> &patch_sims,
+    double window_duration,
+    const SimilarityToQualityMapper *sim_to_qual_mapper) const {
+  std::vector<SimilarityWindow> timeline;
+  if (window_duration <= 0.0) {
+    return timeline;
+  }
+  // The patches are grouped by the window that they start in. The patches
+  // are in order of their reference start time.
+  std::map<size_t, std::vector<PatchSimilarityResult>> windows;
+  for (const auto &patch : patch_sims) {
+    const size_t index = static_cast<size_t>(
+        std::max(0.0, patch.ref_patch_start_time) / window_duration);
+    windows[index].push_back(patch);
+  }
+  // The FVNSIM of every window is mapped to a MOS-LQO in one batch.
+  std::vector<std::vector<double>> window_fvnsims;
+  window_fvnsims.reserve(windows.size());
+  for (const auto &window : windows) {
+    const AMatrix<double> fvnsim = CalcPerPatchMeanFreqBandMeans(
+        window.second);
+    double sum = 0;
+    for (auto &d : fvnsim) {
+      sum += d;
+    }
+    SimilarityWindow w;
+    w.start_time = window.first * window_duration;
+    w.end_time = (window.first + 1) * window_duration;
+    w.vnsim = sum / fvnsim.NumRows();
+    w.num_patches = window.second.size();
+    timeline.push_back(w);
+    window_fvnsims.push_back(fvnsim.ToVector());
+  }
+  const std::vector<double> window_moslqos =
+      sim_to_qual_mapper->PredictQualityBatch(window_fvnsims);
+  for (size_t i = 0; i < timeline.size(); i++) {
+    timeline[i].moslqo = AlterForSimilarityExtremes(timeline[i].vnsim,
+                                                    window_moslqos[i]);
+  }
+  return timeline;
+}
+
 double Visqol::PredictMos(const AMatrix<double> &fvnsim,
                                const SimilarityToQualityMapper *mapper) const {
   double predicted_quality = mapper->PredictQuality(fvnsim.ToVector());
@@ -138,7 +536,34 @@ AMatrix<double> Visqol::CalcPerPatchMeanFreqBandMeans(
       fvnsim(band) += patch_freq_band_means(band);
     }
   }
-  return fvnsim / sim_match_info.size();
+  fvnsim /= sim_match_info.size();
+  return fvnsim;
+}
+
+std::vector<double> Visqol::CalcFvnsimStandardError(
+    const std::vector<PatchSimilarityResult> &sim_match_info,
+    const AMatrix<double> &fvnsim, size_t num_available_patches) const {
+  const size_t n = sim_match_info.size();
+  std::vector<double> stderrs(fvnsim.NumRows(), 0.0);
+  // With every patch compared, the FVNSIM is exact.
+  if (n < 2 || n >= num_available_patches) {
+    return stderrs;
+  }
+  // The patches are a sample without replacement of the available ones, so
+  // the standard error of their mean is reduced by the finite population
+  // correction.
+  const double correction = static_cast<double>(num_available_patches - n) /
+                            (num_available_patches - 1);
+  for (size_t band = 0; band < stderrs.size(); band++) {
+    double sum_sq = 0.0;
+    for (const auto &p : sim_match_info) {
+      const double diff = p.freq_band_means(band) - fvnsim(band);
+      sum_sq += diff * diff;
+    }
+    const double variance = sum_sq / (n - 1);
+    stderrs[band] = std::sqrt(variance / n * correction);
+  }
+  return stderrs;
 }
 
 double Visqol::AlterForSimilarityExtremes(double vnsim,
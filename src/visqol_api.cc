@@ -14,17 +14,30 @@
 
 #include "visqol_api.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 
 #include "google/protobuf/stubs/statusor.h"
 #include "google/protobuf/stubs/status_macros.h"
 
-#include "commandline_parser.h"
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "batch_runner.h"
+#include "parallel_executor.h"
 #include "similarity_result.h"
 #include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "streaming_visqol.h"
 #include "visqol_config.pb.h"      // Generated by cc_proto_library rule
 #include "visqol_manager.h"
 
@@ -34,8 +47,51 @@
 using namespace google::protobuf::util;
 
 namespace Visqol {
+namespace {
+// The value that 16 bit samples are divided by, as when wav files are loaded.
+const double kInt16FullScale = 32768.0;
+
+// Copy samples into a single channel matrix in double precision, dividing
+// each by the full scale value.
+template <typename T>
+AMatrix<double> ToSamples(absl::Span<const T> samples, double full_scale) {
+  AMatrix<double> matrix(samples.size(), 1);
+  double *data = matrix.mutData();
+  for (size_t i = 0; i < samples.size(); i++) {
+    data[i] = samples[i] / full_scale;
+  }
+  return matrix;
+}
+
+// The pairs of a batch that share a reference and are compared together, or
+// the short clips that are compared together, and the total number of
+// degraded samples in them.
+struct BatchTask {
+  std::vector<size_t> pairs;
+  size_t num_samples = 0;
+  bool is_clips = false;
+};
+
+// The inputs and the callback of an asynchronous comparison.
+struct AsyncMeasurement {
+  std::vector<double> reference;
+  std::vector<double> degraded;
+  VisqolApi::Callback callback;
+};
+}  // namespace
 
 const size_t VisqolApi::k48kSampleRate = 48000;
+const double VisqolApi::kMaxClipDuration = 10.0;
+const size_t VisqolApi::kMaxClipsPerTask = 64;
+
+VisqolApi::~VisqolApi() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &VisqolApi::IsIdle));
+}
+
+bool VisqolApi::IsIdle() const {
+  return num_in_flight_ == 0;
+}
 
 Status VisqolApi::Create(const VisqolConfig config) {
   // If audio info was not supplied, return error.
@@ -57,17 +113,17 @@ Status VisqolApi::Create(const VisqolConfig config) {
 
   // Read the config options if they were set. Else, use default values.
   bool speech_mode = false;
-  bool unscaled_speech_map = false;
   bool allow_sr_override = false;
-  std::string model_file = FilePath::currentWorkingDir() + kDefaultAudioModelFile;
+  bool resample_to_mode_rate = false;
+  // An empty model path selects the default model that is compiled into the
+  // library, so no model file is read.
+  std::string model_file;
   if (config.has_options()) {
     auto config_options = config.options();
     speech_mode = config_options.use_speech_scoring();
-    unscaled_speech_map = config_options.use_unscaled_speech_mos_mapping();
     allow_sr_override = config_options.allow_unsupported_sample_rates();
-    if (!config_options.svr_model_path().empty()) {
-      model_file = config_options.svr_model_path();
-    }
+    resample_to_mode_rate = config_options.resample_to_mode_rate();
+    model_file = config_options.svr_model_path();
   }
 
   // ViSQOL Audio currently supports 48k sample rates only.
@@ -78,31 +134,228 @@ Status VisqolApi::Create(const VisqolConfig config) {
   // specific frequencies (the bands are independent of sample rate, unlike how
   // visqolaudio works). It seems like if we did this for Visqol we could
   // support arbitrary sample rates.
+  // Other rates are allowed if the signals are resampled to 48k.
   if (sample_rate_ != k48kSampleRate &&
       speech_mode == false  &&
-      allow_sr_override == false) {
+      allow_sr_override == false &&
+      resample_to_mode_rate == false) {
     return Status(error::Code::INVALID_ARGUMENT,
         "Currently, 48k is the only sample rate supported by ViSQOL Audio. "
         "See README for details of overriding.");
   }
 
-  // Initialize ViSQOL with the model file.
-  RETURN_IF_ERROR(visqol_.Init(model_file, speech_mode, unscaled_speech_map));
+  // Initialize ViSQOL with the model file and config options.
+  RETURN_IF_ERROR(visqol_.Init(model_file, config.options()));
+
+  if (config.options().warmup_duration() > 0.0) {
+    RETURN_IF_ERROR(Warmup(config.options().warmup_duration()));
+  }
 
   return Status();
 }
 
+Status VisqolApi::Warmup(double expected_duration, size_t num_threads) const {
+  return visqol_.Warmup(expected_duration, sample_rate_, num_threads);
+}
+
 StatusOr<SimilarityResultMsg> VisqolApi::Measure(
     const absl::Span<double>& reference,
-    const absl::Span<double>& degraded) {
+    const absl::Span<double>& degraded) const {
+
+  // Initialize the audio signals and perform comparison. The signals borrow
+  // the samples. The reference is only read, and the degraded signal is
+  // replaced by its globally aligned copy before anything is changed.
+  const AudioSignal ref_sig{AMatrix<double>::Borrow(reference), sample_rate_};
+  AudioSignal deg_sig{AMatrix<double>::Borrow(degraded), sample_rate_};
+  SimilarityResultMsg sim_result_msg;
+  ASSIGN_OR_RETURN(sim_result_msg, visqol_.Run(ref_sig, deg_sig));
+
+  return sim_result_msg;
+}
+
+StatusOr<SimilarityResultMsg> VisqolApi::Measure(
+    absl::Span<const float> reference,
+    absl::Span<const float> degraded) const {
+  const AudioSignal ref_sig{ToSamples(reference, 1.0), sample_rate_};
+  AudioSignal deg_sig{ToSamples(degraded, 1.0), sample_rate_};
+  SimilarityResultMsg sim_result_msg;
+  ASSIGN_OR_RETURN(sim_result_msg, visqol_.Run(ref_sig, deg_sig));
+
+  return sim_result_msg;
+}
 
-  // Initialize the audio signals and perform comparison.
-  AudioSignal ref_sig{reference, sample_rate_};
-  AudioSignal deg_sig{degraded, sample_rate_};
+StatusOr<SimilarityResultMsg> VisqolApi::Measure(
+    absl::Span<const int16_t> reference,
+    absl::Span<const int16_t> degraded) const {
+  const AudioSignal ref_sig{ToSamples(reference, kInt16FullScale),
+                            sample_rate_};
+  AudioSignal deg_sig{ToSamples(degraded, kInt16FullScale), sample_rate_};
   SimilarityResultMsg sim_result_msg;
   ASSIGN_OR_RETURN(sim_result_msg, visqol_.Run(ref_sig, deg_sig));
 
   return sim_result_msg;
 }
 
+std::vector<StatusOr<SimilarityResultMsg>> VisqolApi::MeasureBatch(
+    absl::Span<const SignalPair> pairs, size_t num_threads) const {
+  std::map<std::pair<const double *, size_t>, size_t> num_reference_pairs;
+  for (const SignalPair &pair : pairs) {
+    num_reference_pairs[std::make_pair(pair.reference.data(),
+                                       pair.reference.size())]++;
+  }
+  const size_t max_clip_samples =
+      static_cast<size_t>(kMaxClipDuration * sample_rate_);
+  const auto is_clip = [&](const SignalPair &pair) {
+    return pair.degraded.size() <= max_clip_samples &&
+        num_reference_pairs[std::make_pair(pair.reference.data(),
+                                           pair.reference.size())] == 1;
+  };
+  size_t num_clips = 0;
+  for (const SignalPair &pair : pairs) {
+    num_clips += is_clip(pair) ? 1 : 0;
+  }
+  // The clips are spread over the threads, in tasks of up to
+  // kMaxClipsPerTask.
+  const size_t num_workers = std::max<size_t>(1, num_threads);
+  const size_t clips_per_task = std::max<size_t>(1, std::min(
+      kMaxClipsPerTask, (num_clips + num_workers - 1) / num_workers));
+
+  // Split the batch into tasks of pairs with the same reference, in the order
+  // that each reference first appears, with at most as many pairs in a task as
+  // batch mode hands to a worker at once, and tasks of short clips.
+  std::vector<BatchTask> tasks;
+  std::map<std::pair<const double *, size_t>, size_t> open_task;
+  size_t open_clip_task = 0;
+  bool has_open_clip_task = false;
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (is_clip(pairs[i])) {
+      if (!has_open_clip_task ||
+          tasks[open_clip_task].pairs.size() >= clips_per_task) {
+        open_clip_task = tasks.size();
+        has_open_clip_task = true;
+        tasks.push_back(BatchTask{});
+        tasks.back().is_clips = true;
+      }
+      tasks[open_clip_task].pairs.push_back(i);
+      tasks[open_clip_task].num_samples += pairs[i].degraded.size();
+      continue;
+    }
+    const auto key = std::make_pair(pairs[i].reference.data(),
+                                    pairs[i].reference.size());
+    auto it = open_task.find(key);
+    if (it == open_task.end() ||
+        tasks[it->second].pairs.size() >= BatchRunner::kMaxPairsPerTask) {
+      open_task[key] = tasks.size();
+      tasks.push_back(BatchTask{});
+    }
+    BatchTask &task = tasks[open_task[key]];
+    task.pairs.push_back(i);
+    task.num_samples += pairs[i].degraded.size();
+  }
+  // The longest tasks are started first, so that the batch does not end with
+  // a long task running on its own.
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](const BatchTask &a, const BatchTask &b) {
+                     return a.num_samples > b.num_samples;
+                   });
+
+  std::vector<StatusOr<SimilarityResultMsg>> results(pairs.size());
+  ParallelExecutor::ForEach(tasks.size(), num_threads, [&](size_t t) {
+    const BatchTask &task = tasks[t];
+    if (task.is_clips) {
+      std::vector<AudioSignal> ref_sigs;
+      std::vector<AudioSignal> deg_sigs;
+      ref_sigs.reserve(task.pairs.size());
+      deg_sigs.reserve(task.pairs.size());
+      for (size_t i : task.pairs) {
+        ref_sigs.push_back(AudioSignal{AMatrix<double>::Borrow(
+            pairs[i].reference), sample_rate_});
+        deg_sigs.push_back(AudioSignal{AMatrix<double>::Borrow(
+            pairs[i].degraded), sample_rate_});
+      }
+      auto task_results = visqol_.RunClips(ref_sigs, std::move(deg_sigs));
+      for (size_t j = 0; j < task.pairs.size(); j++) {
+        results[task.pairs[j]] = std::move(task_results[j]);
+      }
+      return;
+    }
+    const AudioSignal ref_sig{
+        AMatrix<double>::Borrow(pairs[task.pairs[0]].reference), sample_rate_};
+    std::vector<AudioSignal> deg_sigs;
+    deg_sigs.reserve(task.pairs.size());
+    for (size_t i : task.pairs) {
+      deg_sigs.push_back(AudioSignal{AMatrix<double>::Borrow(
+          pairs[i].degraded), sample_rate_});
+    }
+    auto task_results = visqol_.RunMany(ref_sig, std::move(deg_sigs));
+    for (size_t j = 0; j < task.pairs.size(); j++) {
+      results[task.pairs[j]] = std::move(task_results[j]);
+    }
+  });
+  return results;
+}
+
+std::vector<StatusOr<SimilarityResultMsg>> VisqolApi::MeasureMany(
+    absl::Span<double> reference, absl::Span<const absl::Span<double>> degraded,
+    size_t num_threads) const {
+  const AudioSignal ref_sig{AMatrix<double>::Borrow(reference), sample_rate_};
+  std::vector<AudioSignal> deg_sigs;
+  deg_sigs.reserve(degraded.size());
+  for (const absl::Span<double> &deg : degraded) {
+    deg_sigs.push_back(AudioSignal{AMatrix<double>::Borrow(deg),
+                                   sample_rate_});
+  }
+  return visqol_.RunMany(ref_sig, std::move(deg_sigs), num_threads);
+}
+
+std::unique_ptr<StreamingVisqol> VisqolApi::CreateStream(
+    StreamingVisqol::ResultHandler handler) const {
+  return absl::make_unique<StreamingVisqol>(&visqol_, sample_rate_,
+      StreamingVisqol::kDefaultSegmentDuration,
+      StreamingVisqol::kDefaultLookahead, std::move(handler));
+}
+
+void VisqolApi::SetExecutor(Executor executor) {
+  executor_ = std::move(executor);
+}
+
+void VisqolApi::MeasureAsync(std::vector<double> reference,
+                             std::vector<double> degraded, Callback callback) {
+  {
+    absl::MutexLock lock(&mutex_);
+    num_in_flight_++;
+  }
+  // The measurement is shared rather than captured by value, so that the
+  // executor can copy the task without copying the signals.
+  auto measurement = std::make_shared<AsyncMeasurement>(AsyncMeasurement{
+      std::move(reference), std::move(degraded), std::move(callback)});
+  std::function<void()> task = [this, measurement]() {
+    const AudioSignal ref_sig{AMatrix<double>::Borrow(
+        absl::Span<double>(measurement->reference)), sample_rate_};
+    AudioSignal deg_sig{AMatrix<double>::Borrow(
+        absl::Span<double>(measurement->degraded)), sample_rate_};
+    measurement->callback(visqol_.Run(ref_sig, deg_sig));
+    absl::MutexLock lock(&mutex_);
+    num_in_flight_--;
+  };
+
+  if (executor_) {
+    executor_(std::move(task));
+  } else {
+    std::thread(std::move(task)).detach();
+  }
+}
+
+std::future<StatusOr<SimilarityResultMsg>> VisqolApi::MeasureAsync(
+    std::vector<double> reference, std::vector<double> degraded) {
+  auto promise =
+      std::make_shared<std::promise<StatusOr<SimilarityResultMsg>>>();
+  auto future = promise->get_future();
+  MeasureAsync(std::move(reference), std::move(degraded),
+               [promise](StatusOr<SimilarityResultMsg> result) {
+                 promise->set_value(std::move(result));
+               });
+  return future;
+}
+
 }  // namespace Visqol
@@ -14,27 +14,66 @@
 
 #include "visqol_manager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <random>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/base/internal/raw_logging.h"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/status_macros.h"
 
 #include "alignment.h"
 #include "analysis_window.h"
+#include "audio_decoder.h"
 #include "audio_signal.h"
+#include "compute_backend.h"
+#include "conformance.h"
+#include "energy_patch_creator.h"
+#include "envelope.h"
+#include "erb_filter_cache.h"
+#include "erb_stft_spectrogram_builder.h"
+#include "fingerprint_aligner.h"
 #include "gammatone_filterbank.h"
+#include "gammatone_spectrogram_builder.h"
+#include "memory_usage.h"
+#include "metrics.h"
 #include "misc_audio.h"
+#include "multirate_gammatone_filterbank.h"
+#include "multirate_gammatone_spectrogram_builder.h"
 #include "neurogram_similiarity_index_measure.h"
+#include "parallel_executor.h"
+#include "pair_prefetcher.h"
+#include "previous_comparison.h"
+#include "reference_aligner.h"
+#include "reference_cache.h"
+#include "reference_feature_store.h"
+#include "resampler.h"
+#include "result_cache.h"
+#include "results_proto_stream.h"
 #include "similarity_result.h"
 #include "similarity_result.pb.h"  // Generated by cc_proto_library rule
 #include "speech_similarity_to_quality_mapper.h"
+#include "stage_timer.h"
+#include "task_graph.h"
+#include "trace_writer.h"
+#include "streaming_gammatone_spectrogram_builder.h"
 #include "vad_patch_creator.h"
 #include "visqol.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_workspace.h"
+#include "wav_tile_reader.h"
 
 #include "google/protobuf/port_def.inc"
 // This 'using' declaration is necessary for the ASSIGN_OR_RETURN macro.
@@ -51,11 +90,214 @@ const size_t VisqolManager::kNumBandsSpeech = 21;
 const double VisqolManager::kMinimumFreq = 50;  // wideband
 const double VisqolManager::kOverlap = 0.25;  // 25% overlap
 const double VisqolManager::kDurationMismatchTolerance = 1.0;
+const double VisqolManager::kMinTileDuration = 10.0;
+const double VisqolManager::kTileMargin = 0.5;
+const size_t VisqolManager::kBytesPerComparedSample = 160;
+
+namespace {
+// Record the memory used by a comparison in the timings of its result.
+void SetMemoryUsage(const MemoryUsage &usage,
+                    SimilarityResultMsg *sim_result_msg) {
+  auto timings_msg = sim_result_msg->mutable_timings();
+  timings_msg->set_bytes_allocated(usage.bytes_allocated);
+  timings_msg->set_num_allocations(usage.num_allocations);
+  timings_msg->set_peak_rss_kb(usage.peak_rss_kb);
+}
+
+// Record the hashes of the blocks of the degraded signal in a result, with
+// the hashes of the reference and of the options that a later run checks
+// before it reuses the result.
+void SetBlockHashes(const std::vector<uint64_t> &deg_block_hashes,
+                    uint64_t ref_hash, uint64_t config_hash,
+                    SimilarityResultMsg *sim_result_msg) {
+  sim_result_msg->set_reference_hash(ref_hash);
+  sim_result_msg->set_config_hash(config_hash);
+  sim_result_msg->clear_degraded_block_hashes();
+  sim_result_msg->mutable_degraded_block_hashes()->Reserve(
+      deg_block_hashes.size());
+  for (const uint64_t hash : deg_block_hashes) {
+    sim_result_msg->add_degraded_block_hashes(hash);
+  }
+}
+
+// The mean of the squares of the mono samples of a wav file, which gives its
+// sound pressure level. The file is read a chunk at a time, so that a file of
+// any duration is read in bounded memory.
+double MeanSquare(const FilePath &path, size_t chunk_samples) {
+  WavTileReader reader(path);
+  const size_t num_samples = reader.NumSamples();
+  double sum = 0.0;
+  for (size_t start = 0; start < num_samples; start += chunk_samples) {
+    int64_t first_sample;
+    const AudioSignal chunk = reader.Read(start, chunk_samples, &first_sample);
+    const double *samples = chunk.data_matrix.data();
+    const size_t num_chunk_samples = chunk.data_matrix.NumElements();
+    for (size_t i = 0; i < num_chunk_samples; i++) {
+      sum += samples[i] * samples[i];
+    }
+  }
+  return sum / num_samples;
+}
+
+// Records the similarity vectors that a comparison maps to quality rather
+// than mapping them, so that the vectors of a number of comparisons can be
+// mapped in one batch once they are all compared. The quality that is
+// returned for each vector is only a placeholder.
+class QualityMappingRecorder : public SimilarityToQualityMapper {
+ public:
+  double PredictQuality(
+      const std::vector<double> &similarity_vector) const override {
+    similarity_vectors_.push_back(similarity_vector);
+    return 1.0;
+  }
+
+  Status Init() override { return Status(); }
+
+  // Take the vectors that were recorded since the last call.
+  std::vector<std::vector<double>> TakeSimilarityVectors() {
+    return std::move(similarity_vectors_);
+  }
+
+ private:
+  mutable std::vector<std::vector<double>> similarity_vectors_;
+};
+}  // namespace
 
 Status VisqolManager::Init(const FilePath sim_to_quality_mapper_model,
     const bool use_speech_mode, const bool use_unscaled_speech) {
-  use_speech_mode_ = use_speech_mode;
-  use_unscaled_speech_mos_mapping_ = use_unscaled_speech;
+  VisqolConfig::VisqolOptions options;
+  options.set_use_speech_scoring(use_speech_mode);
+  options.set_use_unscaled_speech_mos_mapping(use_unscaled_speech);
+  return Init(sim_to_quality_mapper_model, options);
+}
+
+Status VisqolManager::Init(const FilePath sim_to_quality_mapper_model,
+    const VisqolConfig::VisqolOptions &options) {
+  use_speech_mode_ = options.use_speech_scoring();
+  use_unscaled_speech_mos_mapping_ = options.use_unscaled_speech_mos_mapping();
+  spectrogram_mode_ = options.spectrogram_mode();
+  num_patch_workers_ = std::max(options.num_patch_workers(), 1);
+  num_segment_workers_ = std::max(options.num_segment_workers(), 1);
+  patch_search_ = options.patch_search();
+  realign_skip_similarity_ = options.realign_skip_similarity();
+  use_float_patch_search_ = options.use_float_patch_search();
+  global_alignment_ = options.global_alignment();
+  use_bounded_patch_realignment_ = options.use_bounded_patch_realignment();
+  global_lag_hint_ = options.global_lag_hint();
+  global_lag_search_window_ = options.global_lag_search_window();
+  reuse_global_lag_ = options.reuse_global_lag();
+  resample_to_mode_rate_ = options.resample_to_mode_rate();
+  num_prefetch_pairs_ = std::max(options.num_prefetch_pairs(), 0);
+  reference_cache_.reset();
+  if (options.reference_cache_size() > 0) {
+    reference_cache_ = absl::make_unique<ReferenceCache>(
+        options.reference_cache_size());
+  }
+  reference_feature_store_.reset();
+  if (!options.ref_features_dir().empty()) {
+    // The features depend on the spectrogram and the patches of the mode,
+    // and on the rate that the reference is compared at. The version is
+    // bumped whenever the features that are built change.
+    std::string features_config = "version=1 speech=" +
+        std::to_string(use_speech_mode_) + " spectrogram_mode=" +
+        std::to_string(spectrogram_mode_) + " resample=" +
+        std::to_string(resample_to_mode_rate_);
+    if (!options.compute_backend().empty()) {
+      features_config += " compute_backend=" + options.compute_backend();
+    }
+    // The patches of audio mode also depend on the silent patch threshold.
+    // It is only added when it is set, so that the features saved without it
+    // stay valid.
+    if (!use_speech_mode_ && options.silent_patch_threshold() < 0.0) {
+      features_config += " silent_patch_threshold=" +
+          std::to_string(options.silent_patch_threshold());
+    }
+    reference_feature_store_ = absl::make_unique<ReferenceFeatureStore>(
+        options.ref_features_dir(),
+        ReferenceFeatureStore::Hash(features_config));
+  }
+  write_reference_features_ = options.write_ref_features();
+  timeline_window_ = options.timeline_window();
+  max_patches_ = std::max(options.max_patches(), 0);
+  target_vnsim_stderr_ = std::max(options.target_vnsim_stderr(), 0.0);
+  lazy_degraded_spectrogram_ = options.lazy_degraded_spectrogram();
+  silent_patch_threshold_ = std::min(options.silent_patch_threshold(), 0.0);
+  multichannel_ = options.multichannel();
+  record_stage_timings_ = options.record_stage_timings();
+  record_memory_usage_ = options.record_memory_usage();
+  result_detail_ = options.result_detail();
+  detect_identical_signals_ = options.detect_identical_signals();
+  identical_signal_tolerance_ =
+      std::max(options.identical_signal_tolerance(), 0.0);
+  result_cache_.reset();
+  if (!options.result_cache_path().empty()) {
+    result_cache_ = ResultCache::Open(options.result_cache_path());
+  }
+  // The cached results, and the earlier results that the block hashes are
+  // recorded for, are only reused by comparisons with the same options.
+  if (!options.result_cache_path().empty() || options.record_block_hashes() ||
+      !options.previous_results_path().empty()) {
+    // The results depend on the model, the version, and every option but
+    // those that only change how fast they are computed or what else is
+    // recorded.
+    VisqolConfig::VisqolOptions result_options = options;
+    result_options.clear_svr_model_path();
+    result_options.clear_num_patch_workers();
+    result_options.clear_num_segment_workers();
+    result_options.clear_thread_pinning();
+    result_options.clear_num_prefetch_pairs();
+    result_options.clear_reference_cache_size();
+    result_options.clear_ref_features_dir();
+    result_options.clear_write_ref_features();
+    result_options.clear_record_stage_timings();
+    result_options.clear_record_memory_usage();
+    result_options.clear_record_block_hashes();
+    result_options.clear_previous_results_path();
+    result_options.clear_warmup_duration();
+    result_options.clear_result_cache_path();
+    std::string model;
+    if (!sim_to_quality_mapper_model.Path().empty()) {
+      std::ifstream model_file(sim_to_quality_mapper_model.Path(),
+                               std::ios_base::binary);
+      model.assign(std::istreambuf_iterator<char>(model_file),
+                   std::istreambuf_iterator<char>());
+    }
+    result_config_hash_ = ReferenceFeatureStore::Hash(
+        "version=" + std::to_string(kVisqolConformanceNumber) + " model=" +
+        std::to_string(ReferenceFeatureStore::Hash(model)) + " options=" +
+        result_options.SerializeAsString());
+  }
+  record_block_hashes_ = options.record_block_hashes();
+  previous_results_.clear();
+  if (!options.previous_results_path().empty()) {
+    ResultsProtoReader reader{FilePath(options.previous_results_path())};
+    SimilarityResultMsg previous_result;
+    while (reader.Next(&previous_result)) {
+      previous_results_[previous_result.degraded_filepath()] =
+          previous_result;
+    }
+    if (!reader.ok()) {
+      const Status status(error::Code::INVALID_ARGUMENT,
+          "Unable to read the previous results " +
+          options.previous_results_path() + ".");
+      ABSL_RAW_LOG(ERROR, "%s", status.error_message().ToString().c_str());
+      return status;
+    }
+  }
+  tile_duration_ = std::max(options.tile_duration(), 0.0);
+  max_memory_bytes_ = static_cast<size_t>(
+      std::max(options.max_memory_mb(), 0)) << 20;
+  compute_backend_ = nullptr;
+  if (!options.compute_backend().empty()) {
+    compute_backend_ = ComputeBackendRegistry::Find(options.compute_backend());
+    if (compute_backend_ == nullptr) {
+      const Status status(error::Code::INVALID_ARGUMENT,
+          "The compute backend '" + options.compute_backend() +
+          "' is not linked into this binary.");
+      ABSL_RAW_LOG(ERROR, "%s", status.error_message().ToString().c_str());
+      return status;
+    }
+  }
   InitPatchCreator();
   InitPatchSelector();
   InitSpectrogramBuilder();
@@ -72,25 +314,66 @@ Status VisqolManager::Init(const FilePath sim_to_quality_mapper_model,
 
 void VisqolManager::InitPatchCreator() {
   if (use_speech_mode_) {
-    patch_creator_ = absl::make_unique<VadPatchCreator>(kPatchSizeSpeech);
+    patch_creator_ = absl::make_unique<VadPatchCreator>(kPatchSizeSpeech,
+                                                        max_patches_);
+  } else if (silent_patch_threshold_ < 0.0) {
+    patch_creator_ = absl::make_unique<EnergyPatchCreator>(
+        kPatchSize, silent_patch_threshold_, max_patches_);
   } else {
-    patch_creator_ = absl::make_unique<ImagePatchCreator>(kPatchSize);
+    patch_creator_ = absl::make_unique<ImagePatchCreator>(kPatchSize,
+                                                          max_patches_);
   }
 }
 
 void VisqolManager::InitPatchSelector() {
   // Setup the patch similarity comparator to use the Neurogram.
+  const auto search_strategy =
+      patch_search_ == VisqolConfig::VisqolOptions::COARSE_TO_FINE ?
+      ComparisonPatchesSelector::SearchStrategy::kCoarseToFine :
+      ComparisonPatchesSelector::SearchStrategy::kExhaustive;
+  // The NSIM loops are specialized for the shape of the patches of the mode.
+  const NsimPatchShape patch_shape = use_speech_mode_ ?
+      NsimPatchShapeOf(kNumBandsSpeech, kPatchSizeSpeech) :
+      NsimPatchShapeOf(kNumBandsAudio, kPatchSize);
+  std::unique_ptr<PatchSimilarityComparator> comparator;
+  if (compute_backend_ != nullptr && compute_backend_->patch_comparator) {
+    comparator = compute_backend_->patch_comparator(patch_shape);
+  } else {
+    comparator = absl::make_unique<NeurogramSimiliarityIndexMeasure>(
+        use_float_patch_search_, patch_shape);
+  }
   patch_selector_ = absl::make_unique<ComparisonPatchesSelector>(
-      absl::make_unique<NeurogramSimiliarityIndexMeasure>());
+      std::move(comparator), NumPairWorkers(), search_strategy,
+      realign_skip_similarity_, use_bounded_patch_realignment_);
 }
 
 void VisqolManager::InitSpectrogramBuilder() {
-  if (use_speech_mode_) {
-    spectrogram_builder_ = absl::make_unique<GammatoneSpectrogramBuilder>(
-        GammatoneFilterBank{kNumBandsSpeech, kMinimumFreq}, true);
+  const size_t num_bands = use_speech_mode_ ? kNumBandsSpeech : kNumBandsAudio;
+  // A backend only replaces the builder of the default gammatone mode.
+  if (spectrogram_mode_ == VisqolConfig::VisqolOptions::GAMMATONE &&
+      compute_backend_ != nullptr && compute_backend_->spectrogram_builder) {
+    spectrogram_builder_ = compute_backend_->spectrogram_builder(num_bands,
+        kMinimumFreq, use_speech_mode_);
+  } else if (spectrogram_mode_ ==
+             VisqolConfig::VisqolOptions::STREAMING_GAMMATONE) {
+    spectrogram_builder_ =
+        absl::make_unique<StreamingGammatoneSpectrogramBuilder>(
+            GammatoneFilterBank{num_bands, kMinimumFreq}, use_speech_mode_);
+  } else if (spectrogram_mode_ ==
+             VisqolConfig::VisqolOptions::MULTIRATE_GAMMATONE) {
+    spectrogram_builder_ =
+        absl::make_unique<MultirateGammatoneSpectrogramBuilder>(
+            MultirateGammatoneFilterBank{num_bands, kMinimumFreq},
+            use_speech_mode_);
+  } else if (spectrogram_mode_ == VisqolConfig::VisqolOptions::ERB_STFT) {
+    spectrogram_builder_ = absl::make_unique<ErbStftSpectrogramBuilder>(
+        num_bands, kMinimumFreq, use_speech_mode_);
   } else {
+    // The columns are filtered independently, so building them in segments
+    // gives the same spectrogram.
     spectrogram_builder_ = absl::make_unique<GammatoneSpectrogramBuilder>(
-        GammatoneFilterBank{kNumBandsAudio, kMinimumFreq}, false);
+        GammatoneFilterBank{num_bands, kMinimumFreq}, use_speech_mode_,
+        num_segment_workers_);
   }
 }
 
@@ -109,24 +392,85 @@ Status VisqolManager::InitSimilarityToQualityMapper(
 std::vector<SimilarityResultMsg> VisqolManager::Run(
     const std::vector<ReferenceDegradedPathPair>& signals_to_compare) {
   std::vector<SimilarityResultMsg> sim_results;
+  RunBatch(signals_to_compare,
+      [&sim_results](size_t, StatusOr<SimilarityResultMsg>&& status_or) {
+        // Only the successful results are kept.
+        if (status_or.ok()) {
+          sim_results.push_back(std::move(status_or.ValueOrDie()));
+        }
+      });
+  return sim_results;
+}
+
+void VisqolManager::RunBatch(
+    const std::vector<ReferenceDegradedPathPair>& signals_to_compare,
+    const ResultHandler& handler) {
+  // A status of aborted gets returned when visqol hasn't been init'd, in
+  // which case no pair is loaded.
+  const Status init_status = ErrorIfNotInitialized();
+  if (!init_status.ok()) {
+    ABSL_RAW_LOG(ERROR,
+        "Error executing ViSQOL: %s.", init_status.ToString().c_str());
+    return;
+  }
+  // The upcoming pairs are loaded while the current pair is compared.
+  PairPrefetcher prefetcher(signals_to_compare, num_prefetch_pairs_,
+      [this](const FilePath &path) {
+        ScopedTraceEvent event("io", "decode", {{"path", path.Path()}});
+        return multichannel_ ? MiscAudio::LoadChannels(path)
+                             : LoadSignal(path);
+      });
   // Iterate over all signal pairs to compare.
-  for (const auto &signal_pair : signals_to_compare) {
+  for (size_t i = 0; i < signals_to_compare.size(); i++) {
+    ScopedTraceEvent pair_event("pair", signals_to_compare[i].degraded.Path(),
+        {{"index", std::to_string(i)},
+         {"reference", signals_to_compare[i].reference.Path()}});
+    const auto pair_start = std::chrono::steady_clock::now();
+    StageTimings timings;
+    MemoryUsage memory_usage;
+    AllocationCounter allocation_counter(
+        record_memory_usage_ ? &memory_usage : nullptr);
+    PairPrefetcher::LoadedPair loaded;
+    {
+      ScopedStageTimer timer(record_stage_timings_ ? &timings : nullptr,
+                             &StageTimings::load);
+      loaded = prefetcher.Next();
+    }
     // Run comparison on a single signal pair.
-    auto status_or = Run(signal_pair.reference, signal_pair.degraded);
-    // If successful save value, else log an error.
-    if (status_or.ok()) {
-      sim_results.push_back(status_or.ValueOrDie());
-    } else {
+    auto status_or = multichannel_ ?
+        RunLoadedChannels(signals_to_compare[i], loaded.reference,
+                          loaded.degraded) :
+        RunLoadedPair(signals_to_compare[i], loaded.reference,
+                      loaded.degraded);
+    allocation_counter.Stop();
+    pair_event.Stop();
+    Metrics::ReportPair(status_or.status().error_code(),
+        std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - pair_start).count());
+    if ((record_stage_timings_ || record_memory_usage_) && status_or.ok()) {
+      SimilarityResultMsg sim_result_msg = std::move(status_or.ValueOrDie());
+      if (record_stage_timings_) {
+        sim_result_msg.mutable_timings()->set_load(timings.load);
+      }
+      if (record_memory_usage_) {
+        SetMemoryUsage(memory_usage, &sim_result_msg);
+      }
+      status_or = std::move(sim_result_msg);
+    }
+    // Log an error if it failed.
+    const bool aborted = !status_or.ok() &&
+        status_or.status().error_code() == error::Code::ABORTED;
+    if (!status_or.ok()) {
       ABSL_RAW_LOG(ERROR,
           "Error executing ViSQOL: %s.", status_or.status().ToString().c_str());
-      // A status of aborted gets thrown when visqol hasn't been init'd.
-      // So if that happens we want to quit processing.
-      if (status_or.status().error_code() == error::Code::ABORTED) {
-        break;
-      }
+    }
+    handler(i, std::move(status_or));
+    // A status of aborted gets thrown when visqol hasn't been init'd.
+    // So if that happens we want to quit processing.
+    if (aborted) {
+      break;
     }
   }
-  return sim_results;
 }
 
 StatusOr<SimilarityResultMsg> VisqolManager::Run(
@@ -134,22 +478,554 @@ StatusOr<SimilarityResultMsg> VisqolManager::Run(
 
   // Ensure the initialization succeeded.
   RETURN_IF_ERROR(ErrorIfNotInitialized());
+  ScopedTraceEvent pair_event("pair", deg_signal_path.Path(),
+                              {{"reference", ref_signal_path.Path()}});
+  if (multichannel_) {
+    return RunChannels(ref_signal_path, deg_signal_path);
+  }
+
+  StageTimings timings;
+  MemoryUsage memory_usage;
+  AllocationCounter allocation_counter(
+      record_memory_usage_ ? &memory_usage : nullptr);
+  SimilarityResultMsg sim_result_msg;
+
+  // A pair that is too long to compare whole is compared in tiles, which are
+  // read from the files as they are compared. Pairs that are resampled as
+  // they are loaded, and files that are decoded by an AudioDecoder, are
+  // compared whole.
+  std::unique_ptr<WavTileReader> ref_reader;
+  std::unique_ptr<WavTileReader> deg_reader;
+  size_t tile_samples = 0;
+  if ((tile_duration_ > 0.0 || max_memory_bytes_ > 0) &&
+      AudioDecoderRegistry::Find(ref_signal_path) == nullptr &&
+      AudioDecoderRegistry::Find(deg_signal_path) == nullptr) {
+    ref_reader = absl::make_unique<WavTileReader>(ref_signal_path);
+    deg_reader = absl::make_unique<WavTileReader>(deg_signal_path);
+    const size_t sample_rate = ref_reader->SampleRate();
+    const bool is_resampled = resample_to_mode_rate_ && (use_speech_mode_ ?
+        sample_rate > k16kSampleRate : sample_rate != k48kSampleRate);
+    if (ref_reader->ok() && deg_reader->ok() && !is_resampled &&
+        deg_reader->SampleRate() == sample_rate) {
+      tile_samples = TileSamples(sample_rate);
+    }
+    if (tile_samples == 0 || ref_reader->NumSamples() <= tile_samples) {
+      tile_samples = 0;
+      ref_reader.reset();
+      deg_reader.reset();
+    }
+  }
+
+  if (tile_samples > 0) {
+    // Every tile is scaled by the same factor, which matches the sound
+    // pressure level of the whole degraded file to that of the whole
+    // reference, as a pair compared whole would be scaled. The levels are
+    // found in a pass over the files before the tiles are compared.
+    const double deg_scale_factor = std::sqrt(
+        MeanSquare(ref_signal_path, tile_samples) /
+        MeanSquare(deg_signal_path, tile_samples));
+    ASSIGN_OR_RETURN(sim_result_msg, RunTiled(ref_reader.get(),
+        deg_reader.get(), tile_samples, deg_scale_factor));
+    sim_result_msg.set_reference_filepath(ref_signal_path.Path());
+    sim_result_msg.set_degraded_filepath(deg_signal_path.Path());
+  } else {
+    // Load the wav audio files as mono. The files are independent, so they
+    // are decoded and resampled concurrently on the workers of the pair.
+    ScopedStageTimer load_timer(record_stage_timings_ ? &timings : nullptr,
+                                &StageTimings::load);
+    AudioSignal ref_signal;
+    AudioSignal deg_signal;
+    TaskGraph load_graph;
+    load_graph.AddTask([&]() { ref_signal = LoadSignal(ref_signal_path); });
+    load_graph.AddTask([&]() { deg_signal = LoadSignal(deg_signal_path); });
+    load_graph.Run(NumPairWorkers());
+    load_timer.Stop();
+    ASSIGN_OR_RETURN(sim_result_msg, RunLoadedPair(
+        {ref_signal_path, deg_signal_path}, ref_signal, deg_signal));
+    if (record_stage_timings_) {
+      sim_result_msg.mutable_timings()->set_load(timings.load);
+    }
+  }
+  allocation_counter.Stop();
+  if (record_memory_usage_) {
+    SetMemoryUsage(memory_usage, &sim_result_msg);
+  }
+  return sim_result_msg;
+}
+
+AudioSignal VisqolManager::LoadSignal(const FilePath& path) const {
+  if (reference_cache_ != nullptr) {
+    auto cached = reference_cache_->Find(ReferenceCache::KeyOf(path));
+    if (cached != nullptr) {
+      return cached->signal;
+    }
+  }
+  return ResampleToModeRate(MiscAudio::LoadAsMono(path));
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::RunLoadedPair(
+    const ReferenceDegradedPathPair& paths, const AudioSignal& ref_signal,
+    AudioSignal& deg_signal) {
+  const FilePath& ref_signal_path = paths.reference;
+  const FilePath& deg_signal_path = paths.degraded;
+  // The blocks of the degraded signal are hashed as it was loaded, before it
+  // is aligned in place.
+  const auto previous_result = previous_results_.find(deg_signal_path.Path());
+  const bool has_previous_result = previous_result != previous_results_.end() &&
+      previous_result->second.reference_filepath() == ref_signal_path.Path();
+  std::vector<uint64_t> deg_block_hashes;
+  uint64_t ref_hash = 0;
+  if (record_block_hashes_ || has_previous_result) {
+    deg_block_hashes = ResultCache::HashSignalBlocks(deg_signal,
+        PreviousComparison::kBlockSamples);
+    ref_hash = ResultCache::HashSignal(ref_signal);
+  }
+
+  // A pair whose signals were compared with the same options by an earlier
+  // run is not compared again.
+  ResultCache::Key result_key{};
+  if (result_cache_ != nullptr) {
+    result_key = ResultCache::KeyOf(result_config_hash_, ref_signal,
+                                    deg_signal);
+    SimilarityResultMsg cached_result;
+    if (FindCachedResult(result_key, paths, &cached_result)) {
+      if (record_block_hashes_) {
+        SetBlockHashes(deg_block_hashes, ref_hash, result_config_hash_,
+                       &cached_result);
+      }
+      return cached_result;
+    }
+  }
+
+  // Only the patches that read the parts of the degraded signal that changed
+  // since an earlier result are compared again.
+  std::unique_ptr<PreviousComparison> previous;
+  if (has_previous_result) {
+    previous = PreviousComparison::Create(previous_result->second,
+        deg_block_hashes, ref_hash, result_config_hash_,
+        deg_signal.sample_rate);
+  }
+
+  // Reuse the features of the reference if it was compared recently, or if
+  // they were saved by an earlier run.
+  std::shared_ptr<const ReferenceFeatures> ref_features;
+  if (reference_cache_ != nullptr || reference_feature_store_ != nullptr) {
+    ref_features = FindReferenceFeatures(ref_signal_path, ref_signal);
+  }
 
-  // Load the wav audio files as mono.
-  const AudioSignal ref_signal = MiscAudio::LoadAsMono(ref_signal_path);
-  AudioSignal deg_signal = MiscAudio::LoadAsMono(deg_signal_path);
+  // Reuse the alignment spectrum if the reference was compared last. Only
+  // the full rate alignment uses it.
+  if (!UsesReferenceAligner()) {
+    reference_aligner_.reset();
+  } else if (reference_aligner_ == nullptr ||
+      reference_aligner_path_ != ref_signal_path.Path() ||
+      !reference_aligner_->MatchesReference(ref_signal)) {
+    if (ref_features != nullptr && !ref_features->upper_envelope.empty()) {
+      reference_aligner_ = absl::make_unique<ReferenceAligner>(
+          ref_features->upper_envelope, ref_signal.data_matrix.NumRows(),
+          ref_signal.sample_rate);
+    } else {
+      reference_aligner_ = absl::make_unique<ReferenceAligner>(ref_signal);
+    }
+    reference_aligner_path_ = ref_signal_path.Path();
+  }
 
   // If the sim result was successfully calculated, set the signal file paths.
   // Else, return the StatusOr failure.
   SimilarityResultMsg sim_result_msg;
-  ASSIGN_OR_RETURN(sim_result_msg, Run(ref_signal, deg_signal));
+  ASSIGN_OR_RETURN(sim_result_msg, RunComparison(ref_signal, deg_signal,
+      reference_aligner_.get(), ref_features.get(), previous.get()));
   sim_result_msg.set_reference_filepath(ref_signal_path.Path());
   sim_result_msg.set_degraded_filepath(deg_signal_path.Path());
+  if (record_block_hashes_) {
+    SetBlockHashes(deg_block_hashes, ref_hash, result_config_hash_,
+                   &sim_result_msg);
+  }
+  if (result_cache_ != nullptr) {
+    result_cache_->Insert(result_key, sim_result_msg);
+  }
   return sim_result_msg;
 }
 
 StatusOr<SimilarityResultMsg> VisqolManager::Run(
-    const AudioSignal& ref_signal, AudioSignal& deg_signal) {
+    const AudioSignal& ref_signal, AudioSignal& deg_signal) const {
+  if (resample_to_mode_rate_) {
+    const AudioSignal resampled_ref = ResampleToModeRate(ref_signal);
+    deg_signal = ResampleToModeRate(std::move(deg_signal));
+    return RunComparison(resampled_ref, deg_signal, nullptr);
+  }
+  return RunComparison(ref_signal, deg_signal, nullptr);
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::RunChannels(
+    const FilePath& ref_signal_path, const FilePath& deg_signal_path) const {
+  RETURN_IF_ERROR(ErrorIfNotInitialized());
+  StageTimings timings;
+  MemoryUsage memory_usage;
+  AllocationCounter allocation_counter(
+      record_memory_usage_ ? &memory_usage : nullptr);
+  ScopedStageTimer load_timer(record_stage_timings_ ? &timings : nullptr,
+                              &StageTimings::load);
+  AudioSignal ref_channels;
+  AudioSignal deg_channels;
+  TaskGraph load_graph;
+  load_graph.AddTask([&]() {
+    ref_channels = MiscAudio::LoadChannels(ref_signal_path);
+  });
+  load_graph.AddTask([&]() {
+    deg_channels = MiscAudio::LoadChannels(deg_signal_path);
+  });
+  load_graph.Run(NumPairWorkers());
+  load_timer.Stop();
+  SimilarityResultMsg sim_result_msg;
+  ASSIGN_OR_RETURN(sim_result_msg, RunLoadedChannels(
+      {ref_signal_path, deg_signal_path}, ref_channels, deg_channels));
+  allocation_counter.Stop();
+  if (record_stage_timings_) {
+    sim_result_msg.mutable_timings()->set_load(timings.load);
+  }
+  if (record_memory_usage_) {
+    SetMemoryUsage(memory_usage, &sim_result_msg);
+  }
+  return sim_result_msg;
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::RunLoadedChannels(
+    const ReferenceDegradedPathPair& paths, const AudioSignal& ref_channels,
+    const AudioSignal& deg_channels) const {
+  RETURN_IF_ERROR(ErrorIfNotInitialized());
+  const size_t num_channels = ref_channels.data_matrix.NumCols();
+  if (num_channels == 0 || deg_channels.data_matrix.NumCols() == 0) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "Input audio files could not be loaded: " + paths.reference.Path() +
+        ", " + paths.degraded.Path());
+  }
+  if (deg_channels.data_matrix.NumCols() != num_channels) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "Input audio files have different numbers of channels! Reference "
+        "channels: " + std::to_string(num_channels) + ". Degraded channels: " +
+        std::to_string(deg_channels.data_matrix.NumCols()));
+  }
+  ResultCache::Key result_key{};
+  if (result_cache_ != nullptr) {
+    result_key = ResultCache::KeyOf(result_config_hash_, ref_channels,
+                                    deg_channels);
+    SimilarityResultMsg cached_result;
+    if (FindCachedResult(result_key, paths, &cached_result)) {
+      return cached_result;
+    }
+  }
+
+  // The degraded file is aligned once, by the lag between the downmixes, so
+  // that every channel is shifted by the same lag.
+  const AudioSignal ref_mono = ResampleToModeRate(
+      MiscAudio::ToMono(ref_channels));
+  const AudioSignal deg_mono = ResampleToModeRate(
+      MiscAudio::ToMono(deg_channels));
+  RETURN_IF_ERROR(ValidateInputAudio(ref_mono, deg_mono));
+  StageTimings timings;
+  ScopedStageTimer alignment_timer(record_stage_timings_ ? &timings : nullptr,
+                                   &StageTimings::global_alignment);
+  const double global_lag = std::get<1>(GloballyAlign(ref_mono, deg_mono,
+                                                      nullptr));
+  alignment_timer.Stop();
+  const int64_t best_lag = std::lround(global_lag * deg_mono.sample_rate);
+  const size_t ref_num_samples = ref_mono.data_matrix.NumRows();
+
+  // The channels share the worker budget of the pair, so that a file with
+  // many channels does not start a thread for each of them.
+  std::vector<StatusOr<SimilarityResultMsg>> channel_results(num_channels);
+  ParallelExecutor::ForEach(num_channels,
+                            std::min<size_t>(num_channels, NumPairWorkers()),
+                            [&](size_t channel) {
+    const AudioSignal ref_signal = ResampleToModeRate(AudioSignal{
+        ref_channels.data_matrix.GetColumn(channel),
+        ref_channels.sample_rate});
+    const AudioSignal deg_signal = ResampleToModeRate(AudioSignal{
+        deg_channels.data_matrix.GetColumn(channel),
+        deg_channels.sample_rate});
+    AudioSignal aligned_deg_signal = std::get<0>(Alignment::ApplyGlobalLag(
+        deg_signal, best_lag, ref_num_samples));
+    channel_results[channel] = CompareAligned(ref_signal, aligned_deg_signal,
+                                              global_lag, nullptr);
+  });
+
+  // The scores of the pair are the mean of those of the channels.
+  SimilarityResultMsg sim_result_msg;
+  for (auto& status_or : channel_results) {
+    RETURN_IF_ERROR(status_or.status());
+    *sim_result_msg.add_channels() = std::move(status_or.ValueOrDie());
+  }
+  const SimilarityResultMsg& first = sim_result_msg.channels(0);
+  bool identical_signals = true;
+  std::vector<double> fvnsim(first.fvnsim_size(), 0.0);
+  double moslqo = 0.0;
+  double vnsim = 0.0;
+  for (const SimilarityResultMsg& channel : sim_result_msg.channels()) {
+    moslqo += channel.moslqo();
+    vnsim += channel.vnsim();
+    for (size_t band = 0; band < fvnsim.size(); band++) {
+      fvnsim[band] += channel.fvnsim(band);
+    }
+    sim_result_msg.set_num_patches(sim_result_msg.num_patches() +
+                                   channel.num_patches());
+    sim_result_msg.set_num_available_patches(
+        sim_result_msg.num_available_patches() +
+        channel.num_available_patches());
+    sim_result_msg.set_num_realign_skipped_patches(
+        sim_result_msg.num_realign_skipped_patches() +
+        channel.num_realign_skipped_patches());
+    identical_signals = identical_signals && channel.identical_signals();
+  }
+  sim_result_msg.set_identical_signals(identical_signals);
+  sim_result_msg.set_moslqo(moslqo / num_channels);
+  sim_result_msg.set_vnsim(vnsim / num_channels);
+  for (const double band_sum : fvnsim) {
+    sim_result_msg.add_fvnsim(band_sum / num_channels);
+  }
+  *sim_result_msg.mutable_center_freq_bands() = first.center_freq_bands();
+  sim_result_msg.set_global_lag(global_lag);
+  sim_result_msg.set_reference_filepath(paths.reference.Path());
+  sim_result_msg.set_degraded_filepath(paths.degraded.Path());
+  if (record_stage_timings_) {
+    sim_result_msg.mutable_timings()->set_global_alignment(
+        timings.global_alignment);
+  }
+  if (result_cache_ != nullptr) {
+    result_cache_->Insert(result_key, sim_result_msg);
+  }
+  return sim_result_msg;
+}
+
+bool VisqolManager::FindCachedResult(const ResultCache::Key& key,
+    const ReferenceDegradedPathPair& paths,
+    SimilarityResultMsg* sim_result_msg) const {
+  const bool hit = result_cache_->Find(key, sim_result_msg);
+  Metrics::ReportResultCacheLookup(hit);
+  if (hit) {
+    sim_result_msg->set_reference_filepath(paths.reference.Path());
+    sim_result_msg->set_degraded_filepath(paths.degraded.Path());
+  }
+  return hit;
+}
+
+std::vector<StatusOr<SimilarityResultMsg>> VisqolManager::RunMany(
+    const FilePath& ref_signal_path, const std::vector<FilePath>& deg_paths,
+    size_t num_threads) {
+  const Status init_status = ErrorIfNotInitialized();
+  if (!init_status.ok()) {
+    return std::vector<StatusOr<SimilarityResultMsg>>(deg_paths.size(),
+        StatusOr<SimilarityResultMsg>(init_status));
+  }
+
+  // The reference is loaded, and its features found, once for all of the
+  // degraded files.
+  const AudioSignal ref_signal = LoadSignal(ref_signal_path);
+  std::shared_ptr<const ReferenceFeatures> ref_features;
+  if (reference_cache_ != nullptr || reference_feature_store_ != nullptr) {
+    ref_features = FindReferenceFeatures(ref_signal_path, ref_signal);
+  } else if (deg_paths.size() > 1) {
+    ref_features = BuildReferenceFeatures(ref_signal);
+  }
+
+  auto results = RunManyPrepared(ref_signal, ref_features.get(),
+      deg_paths.size(), num_threads,
+      [this, &deg_paths](size_t i) { return LoadSignal(deg_paths[i]); });
+  for (size_t i = 0; i < results.size(); i++) {
+    if (results[i].ok()) {
+      SimilarityResultMsg sim_result_msg = results[i].ValueOrDie();
+      sim_result_msg.set_reference_filepath(ref_signal_path.Path());
+      sim_result_msg.set_degraded_filepath(deg_paths[i].Path());
+      results[i] = std::move(sim_result_msg);
+    }
+  }
+  return results;
+}
+
+std::vector<StatusOr<SimilarityResultMsg>> VisqolManager::RunMany(
+    const AudioSignal& ref_signal, std::vector<AudioSignal> deg_signals,
+    size_t num_threads) const {
+  const Status init_status = ErrorIfNotInitialized();
+  if (!init_status.ok()) {
+    return std::vector<StatusOr<SimilarityResultMsg>>(deg_signals.size(),
+        StatusOr<SimilarityResultMsg>(init_status));
+  }
+
+  // The reference is only copied if it has to be resampled.
+  std::unique_ptr<AudioSignal> resampled_ref;
+  if (resample_to_mode_rate_) {
+    resampled_ref = absl::make_unique<AudioSignal>(
+        ResampleToModeRate(ref_signal));
+  }
+  const AudioSignal& ref = resampled_ref ? *resampled_ref : ref_signal;
+  std::unique_ptr<ReferenceFeatures> ref_features;
+  if (deg_signals.size() > 1) {
+    ref_features = BuildReferenceFeatures(ref);
+  }
+  return RunManyPrepared(ref, ref_features.get(), deg_signals.size(),
+      num_threads, [this, &deg_signals](size_t i) {
+        return ResampleToModeRate(std::move(deg_signals[i]));
+      });
+}
+
+std::vector<StatusOr<SimilarityResultMsg>> VisqolManager::RunManyPrepared(
+    const AudioSignal& ref_signal, const ReferenceFeatures* ref_features,
+    size_t num_degraded, size_t num_threads,
+    const std::function<AudioSignal(size_t)>& degraded_signal) const {
+  std::vector<StatusOr<SimilarityResultMsg>> results(num_degraded);
+  // The degraded signals are split into one run of consecutive signals per
+  // thread. Aligners are not thread safe, so each run aligns with one of its
+  // own, built from the shared upper envelope of the reference.
+  const size_t num_runs = std::max<size_t>(1, std::min(num_threads,
+                                                       num_degraded));
+  ParallelExecutor::ForEach(num_runs, num_runs, [&](size_t run) {
+    const size_t begin = num_degraded * run / num_runs;
+    const size_t end = num_degraded * (run + 1) / num_runs;
+    // Only the full rate alignment uses the alignment spectrum.
+    std::unique_ptr<ReferenceAligner> ref_aligner;
+    if (ref_features != nullptr && !ref_features->upper_envelope.empty()) {
+      ref_aligner = absl::make_unique<ReferenceAligner>(
+          ref_features->upper_envelope, ref_signal.data_matrix.NumRows(),
+          ref_signal.sample_rate);
+    } else if (UsesReferenceAligner() && end - begin > 1) {
+      ref_aligner = absl::make_unique<ReferenceAligner>(ref_signal);
+    }
+    for (size_t i = begin; i < end; i++) {
+      AudioSignal deg_signal = degraded_signal(i);
+      results[i] = RunComparison(ref_signal, deg_signal, ref_aligner.get(),
+                                 ref_features);
+    }
+  });
+  return results;
+}
+
+AudioSignal VisqolManager::ResampleToModeRate(AudioSignal signal) const {
+  if (!resample_to_mode_rate_) {
+    return signal;
+  }
+  if (use_speech_mode_) {
+    // Speech mode accepts any rate, but gains nothing above 16k.
+    if (signal.sample_rate <= k16kSampleRate) {
+      return signal;
+    }
+    return Resampler::Resample(std::move(signal), k16kSampleRate);
+  }
+  return Resampler::Resample(std::move(signal), k48kSampleRate);
+}
+
+std::vector<StatusOr<SimilarityResultMsg>> VisqolManager::RunClips(
+    const std::vector<AudioSignal>& ref_signals,
+    std::vector<AudioSignal> deg_signals) const {
+  const Status init_status = ErrorIfNotInitialized();
+  if (!init_status.ok() || ref_signals.size() != deg_signals.size()) {
+    return std::vector<StatusOr<SimilarityResultMsg>>(deg_signals.size(),
+        StatusOr<SimilarityResultMsg>(init_status.ok() ?
+            Status(error::Code::INVALID_ARGUMENT,
+                   "Each degraded clip needs a reference clip.") :
+            init_status));
+  }
+
+  std::vector<StatusOr<SimilarityResultMsg>> results(deg_signals.size());
+  QualityMappingRecorder recorder;
+  std::vector<size_t> mapped_clips;
+  std::vector<std::vector<double>> similarity_vectors;
+  for (size_t i = 0; i < deg_signals.size(); i++) {
+    // The reference is only copied if it has to be resampled.
+    std::unique_ptr<AudioSignal> resampled_ref;
+    if (resample_to_mode_rate_) {
+      resampled_ref = absl::make_unique<AudioSignal>(
+          ResampleToModeRate(ref_signals[i]));
+    }
+    const AudioSignal& ref = resampled_ref ? *resampled_ref : ref_signals[i];
+    AudioSignal deg_signal = ResampleToModeRate(std::move(deg_signals[i]));
+    results[i] = RunComparison(ref, deg_signal, nullptr, nullptr, nullptr,
+                               &recorder);
+    // Identical clips are not recorded, as their quality is already known.
+    auto clip_vectors = recorder.TakeSimilarityVectors();
+    if (results[i].ok() && clip_vectors.size() == 1) {
+      mapped_clips.push_back(i);
+      similarity_vectors.push_back(std::move(clip_vectors[0]));
+    }
+  }
+  if (mapped_clips.empty()) {
+    return results;
+  }
+
+  const std::vector<double> qualities =
+      sim_to_qual_->PredictQualityBatch(similarity_vectors);
+  const Visqol visqol(target_vnsim_stderr_, lazy_degraded_spectrogram_,
+                      record_stage_timings_, NumPairWorkers());
+  for (size_t j = 0; j < mapped_clips.size(); j++) {
+    SimilarityResultMsg sim_result_msg =
+        results[mapped_clips[j]].ValueOrDie();
+    sim_result_msg.set_moslqo(visqol.AlterForSimilarityExtremes(
+        sim_result_msg.vnsim(), qualities[j]));
+    results[mapped_clips[j]] = std::move(sim_result_msg);
+  }
+  return results;
+}
+
+Status VisqolManager::Warmup(double duration, size_t sample_rate,
+                             size_t num_threads) const {
+  RETURN_IF_ERROR(ErrorIfNotInitialized());
+  const size_t num_samples = duration > 0.0 ?
+      static_cast<size_t>(duration * sample_rate) : 0;
+  if (num_samples == 0) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The warm-up duration and sample rate must be above 0.");
+  }
+
+  // Bursts of noise, which the voice activity detection of speech mode finds
+  // active. The degraded signal has more noise, so that it is compared in
+  // full rather than found to be identical.
+  std::mt19937 generator(1);
+  std::normal_distribution<double> noise(0.0, 0.1);
+  AMatrix<double> reference(num_samples, 1);
+  AMatrix<double> degraded(num_samples, 1);
+  for (size_t i = 0; i < num_samples; i++) {
+    const double burst = 0.5 + 0.5 * std::sin(
+        2.0 * M_PI * 2.0 * i / sample_rate);
+    reference(i) = burst * noise(generator);
+    degraded(i) = reference(i) + 0.1 * noise(generator);
+  }
+  AudioSignal ref_signal{std::move(reference), sample_rate};
+  AudioSignal deg_signal{std::move(degraded), sample_rate};
+  if (resample_to_mode_rate_) {
+    ref_signal = ResampleToModeRate(ref_signal);
+    deg_signal = ResampleToModeRate(std::move(deg_signal));
+  }
+
+  double global_lag_hint;
+  {
+    absl::MutexLock lock(&global_lag_mutex_);
+    global_lag_hint = global_lag_hint_;
+  }
+  // The comparisons run at once, as far as the threads of the shared pool
+  // are free, so that each takes a workspace of its own.
+  // Each aligns with a scratch copy of the lag hint, so that the real
+  // comparisons that may already run never see the lag of the synthetic
+  // pair.
+  std::vector<Status> statuses(std::max<size_t>(1, num_threads));
+  ParallelExecutor::ForEach(statuses.size(), statuses.size(),
+                            [&](size_t i) {
+    AudioSignal warmup_deg_signal = deg_signal;
+    double warmup_lag_hint = global_lag_hint;
+    statuses[i] = RunComparison(ref_signal, warmup_deg_signal, nullptr,
+                                nullptr, nullptr, nullptr,
+                                &warmup_lag_hint).status();
+  });
+  for (const Status& status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return Status();
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::RunComparison(
+    const AudioSignal& ref_signal, AudioSignal& deg_signal,
+    ReferenceAligner* ref_aligner, const ReferenceFeatures* ref_features,
+    const PreviousComparison* previous,
+    const SimilarityToQualityMapper* sim_to_qual_mapper,
+    double* global_lag_hint) const {
 
   // Ensure the initialization succeeded.
   RETURN_IF_ERROR(ErrorIfNotInitialized());
@@ -157,53 +1033,445 @@ StatusOr<SimilarityResultMsg> VisqolManager::Run(
   RETURN_IF_ERROR(ValidateInputAudio(ref_signal, deg_signal));
 
   // Adjust for codec initial padding.
-  auto alignment_result = Alignment::GloballyAlign(ref_signal, deg_signal);
-  deg_signal = std::get<0>(alignment_result);
+  StageTimings timings;
+  ScopedStageTimer alignment_timer(record_stage_timings_ ? &timings : nullptr,
+                                   &StageTimings::global_alignment);
+  std::tuple<AudioSignal, double> alignment_result = GloballyAlign(ref_signal,
+      deg_signal, ref_aligner, global_lag_hint);
+  deg_signal = std::move(std::get<0>(alignment_result));
+  alignment_timer.Stop();
+  SimilarityResultMsg sim_result_msg;
+  ASSIGN_OR_RETURN(sim_result_msg, CompareAligned(ref_signal, deg_signal,
+      std::get<1>(alignment_result), ref_features, previous,
+      sim_to_qual_mapper));
+  if (record_stage_timings_) {
+    sim_result_msg.mutable_timings()->set_global_alignment(
+        timings.global_alignment);
+  }
+  return sim_result_msg;
+}
+
+std::tuple<AudioSignal, double> VisqolManager::GloballyAlign(
+    const AudioSignal& ref_signal, const AudioSignal& deg_signal,
+    ReferenceAligner* ref_aligner, double* global_lag_hint) const {
+  std::tuple<AudioSignal, double> alignment_result;
+  if (global_lag_search_window_ > 0.0) {
+    // Only verify and refine the lag around the hint.
+    double lag_hint;
+    if (global_lag_hint != nullptr) {
+      lag_hint = *global_lag_hint;
+    } else {
+      absl::MutexLock lock(&global_lag_mutex_);
+      lag_hint = global_lag_hint_;
+    }
+    const double sample_rate = ref_signal.sample_rate;
+    alignment_result = Alignment::GloballyAlignAroundLag(ref_signal,
+        deg_signal, std::lround(lag_hint * sample_rate),
+        std::max<int64_t>(1, std::lround(global_lag_search_window_ *
+                                         sample_rate)));
+  } else if (global_alignment_ ==
+             VisqolConfig::VisqolOptions::MULTI_RESOLUTION) {
+    alignment_result = Alignment::GloballyAlignMultiResolution(ref_signal,
+                                                               deg_signal);
+  } else if (global_alignment_ == VisqolConfig::VisqolOptions::FINGERPRINT) {
+    alignment_result = FingerprintAligner::GloballyAlign(ref_signal,
+                                                         deg_signal);
+  } else if (ref_aligner != nullptr) {
+    alignment_result = ref_aligner->GloballyAlign(deg_signal);
+  } else {
+    alignment_result = Alignment::GloballyAlign(ref_signal, deg_signal);
+  }
+  if (reuse_global_lag_) {
+    if (global_lag_hint != nullptr) {
+      *global_lag_hint = std::get<1>(alignment_result);
+    } else {
+      absl::MutexLock lock(&global_lag_mutex_);
+      global_lag_hint_ = std::get<1>(alignment_result);
+    }
+  }
+  return alignment_result;
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::CompareAligned(
+    const AudioSignal& ref_signal, AudioSignal& deg_signal,
+    double global_lag, const ReferenceFeatures* ref_features,
+    const PreviousComparison* previous,
+    const SimilarityToQualityMapper* sim_to_qual_mapper) const {
+  // A degraded signal that matches the reference, such as a pass-through
+  // transcode, has a known result, so its spectrograms are not built.
+  if (detect_identical_signals_) {
+    StageTimings timings;
+    ScopedStageTimer timer(record_stage_timings_ ? &timings : nullptr,
+                           &StageTimings::spl_scaling);
+    const bool identical = MiscAudio::MatchesAfterScaling(ref_signal,
+        deg_signal, identical_signal_tolerance_);
+    timer.Stop();
+    if (identical) {
+      SimilarityResult sim_result = IdenticalSignalsResult(
+          ref_signal.sample_rate);
+      sim_result.timings = timings;
+      SimilarityResultMsg sim_result_msg = PopulateSimResultMsg(sim_result);
+      sim_result_msg.set_global_lag(global_lag);
+      return sim_result_msg;
+    }
+  }
 
   const AnalysisWindow window{ref_signal.sample_rate, kOverlap};
 
+  // The degraded times of the earlier patches only hold if the degraded
+  // signal is aligned as it was then.
+  if (previous != nullptr && !previous->MatchesGlobalLag(global_lag)) {
+    previous = nullptr;
+  }
+
   // If the sim result is successfully calculated, populate the protobuf msg.
   // Else, return the StatusOr failure.
-  const Visqol visqol;
+  std::unique_ptr<VisqolWorkspace> workspace = TakeWorkspace();
+  const Visqol visqol(target_vnsim_stderr_, lazy_degraded_spectrogram_,
+                      record_stage_timings_, NumPairWorkers());
+  auto sim_result_or = visqol.CalculateSimilarity(ref_signal, deg_signal,
+      spectrogram_builder_.get(), window, patch_creator_.get(),
+      patch_selector_.get(),
+      sim_to_qual_mapper != nullptr ? sim_to_qual_mapper : sim_to_qual_.get(),
+      workspace.get(), ref_features, previous);
+  // The scratch buffers of the comparison are all freed at once, whether or
+  // not it succeeded, so that the next comparison reuses their memory.
+  RecycleWorkspace(std::move(workspace));
+  SimilarityResult sim_result;
+  ASSIGN_OR_RETURN(sim_result, std::move(sim_result_or));
+  if (timeline_window_ > 0.0) {
+    ScopedStageTimer timer(record_stage_timings_ ? &sim_result.timings
+                                                 : nullptr,
+                           &StageTimings::mapping);
+    sim_result.timeline = visqol.CalculateTimeline(
+        sim_result.debug_info.patch_sims, timeline_window_,
+        sim_to_qual_.get());
+  }
+  SimilarityResultMsg sim_result_msg = PopulateSimResultMsg(sim_result);
+  sim_result_msg.set_global_lag(global_lag);
+  return sim_result_msg;
+}
+
+size_t VisqolManager::TileSamples(size_t sample_rate) const {
+  double tile_duration = tile_duration_;
+  if (max_memory_bytes_ > 0) {
+    const double max_duration = static_cast<double>(max_memory_bytes_) /
+        (kBytesPerComparedSample * sample_rate);
+    if (tile_duration <= 0.0 || max_duration < tile_duration) {
+      tile_duration = max_duration;
+    }
+  }
+  if (tile_duration <= 0.0 || sample_rate == 0) {
+    return 0;
+  }
+  // The tiles hold whole patches, so that the patches of the tiles start
+  // where those of the whole signal would.
+  const AnalysisWindow window{sample_rate, kOverlap};
+  const size_t patch_samples = std::max<size_t>(1,
+      (use_speech_mode_ ? kPatchSizeSpeech : kPatchSize) *
+      static_cast<size_t>(window.size * kOverlap));
+  const size_t min_tile_samples = std::lround(kMinTileDuration * sample_rate);
+  const size_t tile_samples = std::max<size_t>(min_tile_samples,
+      std::lround(tile_duration * sample_rate));
+  return std::max<size_t>(1, tile_samples / patch_samples) * patch_samples;
+}
+
+StatusOr<SimilarityResultMsg> VisqolManager::RunTiled(
+    WavTileReader* ref_reader, WavTileReader* deg_reader,
+    size_t tile_samples, double deg_scale_factor) const {
+  const size_t sample_rate = ref_reader->SampleRate();
+  const size_t num_ref_samples = ref_reader->NumSamples();
+  const int64_t margin = std::lround(kTileMargin * sample_rate);
+  const AnalysisWindow window{sample_rate, kOverlap};
+  const Visqol visqol(target_vnsim_stderr_, lazy_degraded_spectrogram_,
+                      record_stage_timings_, NumPairWorkers());
+  StageTimings timings;
+  StageTimings *stage_timings = record_stage_timings_ ? &timings : nullptr;
+  std::vector<PatchSimilarityResult> patch_sims;
+  std::vector<double> center_freq_bands;
+  size_t num_available_patches = 0;
+  size_t num_realign_skipped_patches = 0;
+  Status last_error;
+  // The lag of the degraded file, in samples: the sample of the reference
+  // that a sample of the degraded file lines up with is that many samples
+  // after it.
+  int64_t lag = 0;
+  double first_tile_lag = 0.0;
+  for (size_t tile_start = 0; tile_start < num_ref_samples;) {
+    // The last tile takes the samples after it if they are too few for a
+    // tile of their own.
+    size_t num_tile_samples = std::min(tile_samples,
+                                       num_ref_samples - tile_start);
+    if (num_ref_samples - tile_start - num_tile_samples < tile_samples / 2) {
+      num_tile_samples = num_ref_samples - tile_start;
+    }
+    ScopedTraceEvent tile_event("tile", std::to_string(tile_start));
+
+    // Read the tile, and the degraded samples that it lines up with, along
+    // with a margin on each side.
+    ScopedStageTimer load_timer(stage_timings, &StageTimings::load);
+    int64_t ref_first_sample;
+    const AudioSignal ref_tile = ref_reader->Read(tile_start,
+        num_tile_samples, &ref_first_sample);
+    int64_t deg_first_sample;
+    const AudioSignal deg_tile = deg_reader->Read(
+        static_cast<int64_t>(tile_start) - lag - margin,
+        num_tile_samples + 2 * margin, &deg_first_sample);
+    load_timer.Stop();
+
+    // The first tile is aligned as a whole pair would be. Each tile after it
+    // is aligned around the lag of the tile before, which, within the
+    // degraded samples that were read, is that of their first sample.
+    ScopedStageTimer alignment_timer(stage_timings,
+                                     &StageTimings::global_alignment);
+    const int64_t tile_offset = deg_first_sample -
+                                static_cast<int64_t>(tile_start);
+    std::tuple<AudioSignal, double> alignment_result = tile_start == 0 ?
+        GloballyAlign(ref_tile, deg_tile, nullptr) :
+        Alignment::GloballyAlignAroundLag(ref_tile, deg_tile,
+                                          tile_offset + lag, margin);
+    AudioSignal aligned_deg_tile = std::move(std::get<0>(alignment_result));
+    lag = std::lround(std::get<1>(alignment_result) * sample_rate) -
+          tile_offset;
+    if (tile_start == 0) {
+      first_tile_lag = static_cast<double>(lag) / sample_rate;
+    }
+    alignment_timer.Stop();
+
+    std::unique_ptr<VisqolWorkspace> workspace = TakeWorkspace();
+    auto tile_result_or = visqol.CalculateSimilarity(ref_tile,
+        aligned_deg_tile, spectrogram_builder_.get(), window,
+        patch_creator_.get(), patch_selector_.get(), sim_to_qual_.get(),
+        workspace.get(), nullptr, nullptr, &deg_scale_factor);
+    RecycleWorkspace(std::move(workspace));
+    tile_start += num_tile_samples;
+    if (!tile_result_or.ok()) {
+      // A tile without any patches to compare, such as a silent one, is
+      // left out, but the other tiles may have some.
+      if (tile_result_or.status().error_code() != error::CANCELLED) {
+        return tile_result_or.status();
+      }
+      last_error = tile_result_or.status();
+      continue;
+    }
+
+    // Only the results of the patches of the tile are kept, with their times
+    // from the start of the files.
+    SimilarityResult tile_result = std::move(tile_result_or.ValueOrDie());
+    const double tile_start_time = static_cast<double>(ref_first_sample) /
+                                   sample_rate;
+    for (auto &patch : tile_result.debug_info.patch_sims) {
+      patch.ref_patch_start_time += tile_start_time;
+      patch.ref_patch_end_time += tile_start_time;
+      patch.deg_patch_start_time += tile_start_time;
+      patch.deg_patch_end_time += tile_start_time;
+      patch_sims.push_back(std::move(patch));
+    }
+    num_available_patches += tile_result.debug_info.num_available_patches;
+    num_realign_skipped_patches +=
+        tile_result.debug_info.num_realign_skipped_patches;
+    if (center_freq_bands.empty()) {
+      center_freq_bands = std::move(tile_result.center_freq_bands);
+    }
+    AddStageTimings(tile_result.timings, &timings);
+  }
+  if (patch_sims.empty()) {
+    return last_error;
+  }
+
+  ScopedStageTimer mapping_timer(stage_timings, &StageTimings::mapping);
+  SimilarityResult sim_result = visqol.CombinePatchSimilarities(
+      std::move(patch_sims), num_available_patches,
+      num_realign_skipped_patches, sim_to_qual_.get());
+  sim_result.center_freq_bands = std::move(center_freq_bands);
+  if (timeline_window_ > 0.0) {
+    sim_result.timeline = visqol.CalculateTimeline(
+        sim_result.debug_info.patch_sims, timeline_window_,
+        sim_to_qual_.get());
+  }
+  mapping_timer.Stop();
+  sim_result.timings = timings;
+  SimilarityResultMsg sim_result_msg = PopulateSimResultMsg(sim_result);
+  sim_result_msg.set_global_lag(first_tile_lag);
+  if (record_stage_timings_) {
+    sim_result_msg.mutable_timings()->set_load(timings.load);
+    sim_result_msg.mutable_timings()->set_global_alignment(
+        timings.global_alignment);
+  }
+  return sim_result_msg;
+}
+
+SimilarityResult VisqolManager::IdenticalSignalsResult(
+    size_t sample_rate) const {
+  const size_t num_bands = use_speech_mode_ ? kNumBandsSpeech : kNumBandsAudio;
+  const double max_freq = use_speech_mode_ ?
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq : sample_rate / 2.0;
   SimilarityResult sim_result;
-  ASSIGN_OR_RETURN(sim_result, visqol.CalculateSimilarity(ref_signal,
-      deg_signal, spectrogram_builder_.get(), window, patch_creator_.get(),
-      patch_selector_.get(), sim_to_qual_.get()));
-  return PopulateSimResultMsg(sim_result);
+  sim_result.fvnsim.assign(num_bands, 1.0);
+  sim_result.fvnsim_stderr.assign(num_bands, 0.0);
+  sim_result.vnsim = 1.0;
+  sim_result.moslqo = sim_to_qual_->PredictQuality(sim_result.fvnsim);
+  // The bands are those that every spectrogram builder uses.
+  sim_result.center_freq_bands = ErbFilterCache::GetFilters(sample_rate,
+      num_bands, kMinimumFreq, max_freq)->center_freqs;
+  sim_result.identical_signals = true;
+  return sim_result;
+}
+
+std::unique_ptr<ReferenceFeatures> VisqolManager::BuildReferenceFeatures(
+    const AudioSignal& ref_signal) const {
+  const AnalysisWindow window{ref_signal.sample_rate, kOverlap};
+  const Visqol visqol;
+  auto features_or = visqol.BuildReferenceFeatures(ref_signal,
+      spectrogram_builder_.get(), window, patch_creator_.get());
+  if (!features_or.ok()) {
+    return nullptr;
+  }
+  auto features = absl::make_unique<ReferenceFeatures>(
+      std::move(features_or.ValueOrDie()));
+  if (UsesReferenceAligner()) {
+    features->upper_envelope = Envelope::CalcUpperEnv(
+        ref_signal.data_matrix).ToVector();
+  }
+  return features;
+}
+
+std::shared_ptr<const ReferenceFeatures> VisqolManager::FindReferenceFeatures(
+    const FilePath& path, const AudioSignal& ref_signal) {
+  const std::string key = ReferenceCache::KeyOf(path);
+  if (key.empty()) {
+    return nullptr;
+  }
+  if (reference_cache_ != nullptr) {
+    auto cached = reference_cache_->Find(key);
+    if (cached != nullptr) {
+      return cached->features;
+    }
+  }
+
+  std::shared_ptr<const ReferenceFeatures> features;
+  if (reference_feature_store_ != nullptr) {
+    features = reference_feature_store_->Load(path, key, ref_signal);
+  }
+  if (features == nullptr) {
+    std::unique_ptr<ReferenceFeatures> built =
+        BuildReferenceFeatures(ref_signal);
+    if (built == nullptr) {
+      return nullptr;
+    }
+    if (reference_feature_store_ != nullptr && write_reference_features_) {
+      reference_feature_store_->Save(path, key, ref_signal, *built);
+    }
+    features = std::move(built);
+  }
+
+  if (reference_cache_ != nullptr) {
+    reference_cache_->Insert(key, std::make_shared<ReferenceCache::Entry>(
+        ReferenceCache::Entry{ref_signal, features}));
+  }
+  return features;
+}
+
+size_t VisqolManager::NumPairWorkers() const {
+  return std::max(num_patch_workers_, num_segment_workers_);
+}
+
+bool VisqolManager::UsesReferenceAligner() const {
+  return global_alignment_ == VisqolConfig::VisqolOptions::FULL_RATE &&
+         global_lag_search_window_ <= 0.0;
+}
+
+std::unique_ptr<VisqolWorkspace> VisqolManager::TakeWorkspace() const {
+  absl::MutexLock lock(&workspaces_mutex_);
+  if (idle_workspaces_.empty()) {
+    return absl::make_unique<VisqolWorkspace>();
+  }
+  std::unique_ptr<VisqolWorkspace> workspace =
+      std::move(idle_workspaces_.back());
+  idle_workspaces_.pop_back();
+  return workspace;
+}
+
+void VisqolManager::RecycleWorkspace(
+    std::unique_ptr<VisqolWorkspace> workspace) const {
+  workspace->Reset();
+  absl::MutexLock lock(&workspaces_mutex_);
+  idle_workspaces_.push_back(std::move(workspace));
 }
 
 SimilarityResultMsg VisqolManager::PopulateSimResultMsg(
-      const SimilarityResult &sim_result) {
+      const SimilarityResult &sim_result) const {
   SimilarityResultMsg sim_result_msg;
   sim_result_msg.set_moslqo(sim_result.moslqo);
   sim_result_msg.set_vnsim(sim_result.vnsim);
+  sim_result_msg.set_num_realign_skipped_patches(
+      sim_result.debug_info.num_realign_skipped_patches);
+  sim_result_msg.set_num_patches(sim_result.debug_info.patch_sims.size());
+  sim_result_msg.set_num_available_patches(
+      sim_result.debug_info.num_available_patches);
+  sim_result_msg.set_identical_signals(sim_result.identical_signals);
+
+  if (result_detail_ != VisqolConfig::VisqolOptions::SUMMARY) {
+    sim_result_msg.mutable_fvnsim_stderr()->Reserve(
+        sim_result.fvnsim_stderr.size());
+    for (const double stderr_value : sim_result.fvnsim_stderr) {
+      sim_result_msg.add_fvnsim_stderr(stderr_value);
+    }
+    sim_result_msg.mutable_fvnsim()->Reserve(sim_result.fvnsim.size());
+    for (const double band : sim_result.fvnsim) {
+      sim_result_msg.add_fvnsim(band);
+    }
+    sim_result_msg.mutable_center_freq_bands()->Reserve(
+        sim_result.center_freq_bands.size());
+    for (const double freq : sim_result.center_freq_bands) {
+      sim_result_msg.add_center_freq_bands(freq);
+    }
+  }
 
-  auto fvnsim = sim_result.fvnsim;
-  for (auto itr = fvnsim.begin(); itr != fvnsim.end(); ++itr) {
-    sim_result_msg.add_fvnsim(*itr);
+  if (result_detail_ == VisqolConfig::VisqolOptions::FULL) {
+    sim_result_msg.mutable_patch_sims()->Reserve(
+        sim_result.debug_info.patch_sims.size());
+    for (const auto &patch : sim_result.debug_info.patch_sims) {
+      auto patch_msg = sim_result_msg.add_patch_sims();
+      patch_msg->set_similarity(patch.similarity);
+      patch_msg->set_ref_patch_start_time(patch.ref_patch_start_time);
+      patch_msg->set_ref_patch_end_time(patch.ref_patch_end_time);
+      patch_msg->set_deg_patch_start_time(patch.deg_patch_start_time);
+      patch_msg->set_deg_patch_end_time(patch.deg_patch_end_time);
+      const size_t num_bands = patch.freq_band_means.NumElements();
+      const double *band_means = patch.freq_band_means.data();
+      patch_msg->mutable_freq_band_means()->Reserve(num_bands);
+      for (size_t band = 0; band < num_bands; band++) {
+        patch_msg->add_freq_band_means(band_means[band]);
+      }
+    }
   }
 
-  auto cfb = sim_result.center_freq_bands;
-  for (auto itr = cfb.begin(); itr != cfb.end(); ++itr) {
-    sim_result_msg.add_center_freq_bands(*itr);
+  for (const auto &window : sim_result.timeline) {
+    auto window_msg = sim_result_msg.add_timeline();
+    window_msg->set_start_time(window.start_time);
+    window_msg->set_end_time(window.end_time);
+    window_msg->set_moslqo(window.moslqo);
+    window_msg->set_vnsim(window.vnsim);
+    window_msg->set_num_patches(window.num_patches);
   }
 
-  for (auto patch : sim_result.debug_info.patch_sims) {
-    auto patch_msg = sim_result_msg.add_patch_sims();
-    patch_msg->set_similarity(patch.similarity);
-    patch_msg->set_ref_patch_start_time(patch.ref_patch_start_time);
-    patch_msg->set_ref_patch_end_time(patch.ref_patch_end_time);
-    patch_msg->set_deg_patch_start_time(patch.deg_patch_start_time);
-    patch_msg->set_deg_patch_end_time(patch.deg_patch_end_time);
-    for (double each_fbm : patch.freq_band_means.ToVector()) {
-      patch_msg->add_freq_band_means(each_fbm);
-    }
+  if (record_stage_timings_) {
+    const StageTimings &timings = sim_result.timings;
+    auto timings_msg = sim_result_msg.mutable_timings();
+    timings_msg->set_spl_scaling(timings.spl_scaling);
+    timings_msg->set_spectrograms(timings.spectrograms);
+    timings_msg->set_spectrogram_prep(timings.spectrogram_prep);
+    timings_msg->set_patch_indices(timings.patch_indices);
+    timings_msg->set_coarse_search(timings.coarse_search);
+    timings_msg->set_fine_alignment(timings.fine_alignment);
+    timings_msg->set_mapping(timings.mapping);
   }
 
   return sim_result_msg;
 }
 
-Status VisqolManager::ErrorIfNotInitialized() {
+Status VisqolManager::ErrorIfNotInitialized() const {
   if (is_initialized_ == false) {
     return Status(error::Code::ABORTED,
         "VisqolManager must be initialized before use.");
@@ -213,7 +1481,7 @@ Status VisqolManager::ErrorIfNotInitialized() {
 }
 
 google::protobuf::util::Status VisqolManager::ValidateInputAudio(
-      const AudioSignal& ref_signal, const AudioSignal& deg_signal) {
+      const AudioSignal& ref_signal, const AudioSignal& deg_signal) const {
   // Warn if there is an excessive difference in durations.
   double ref_duration = ref_signal.GetDuration();
   double deg_duration = deg_signal.GetDuration();
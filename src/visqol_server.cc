@@ -0,0 +1,718 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "visqol_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "google/protobuf/message_lite.h"
+#include "google/protobuf/repeated_field.h"
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/status_macros.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+#include "metrics.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+#include "visqol_service.pb.h"  // Generated by cc_proto_library rule
+
+#include "google/protobuf/port_def.inc"
+// This 'using' declaration is necessary for the RETURN_IF_ERROR macro.
+using namespace google::protobuf::util;
+
+namespace Visqol {
+namespace {
+// The samples of 16 bit signals are normalized as those of wav files are.
+const double kInt16FullScale = 32768.0;
+
+// A column of samples, normalized by full_scale as they are copied.
+template <typename T>
+AMatrix<double> ToColumn(const T *samples, size_t num_samples,
+                         double full_scale) {
+  AMatrix<double> column(num_samples, 1);
+  double *data = column.mutData();
+  for (size_t i = 0; i < num_samples; i++) {
+    data[i] = samples[i] / full_scale;
+  }
+  return column;
+}
+
+// The inline samples of a signal.
+AMatrix<double> InlineSamples(
+    const google::protobuf::RepeatedField<float> &samples) {
+  return ToColumn(samples.data(), samples.size(), 1.0);
+}
+
+#if !defined(_WIN32)
+// The size of a shared sample, in bytes.
+size_t SampleSize(SharedSamples::SampleFormat format) {
+  switch (format) {
+    case SharedSamples::FLOAT32:
+      return sizeof(float);
+    case SharedSamples::INT16:
+      return sizeof(int16_t);
+    default:
+      return sizeof(double);
+  }
+}
+
+// The pages of shared samples that are mapped for a comparison, which are
+// unmapped when it goes out of scope.
+struct SharedMapping {
+  SharedMapping() = default;
+  SharedMapping(const SharedMapping &) = delete;
+  SharedMapping &operator=(const SharedMapping &) = delete;
+  ~SharedMapping() {
+    if (base != MAP_FAILED) {
+      munmap(base, size);
+    }
+  }
+
+  void *base = MAP_FAILED;
+  size_t size = 0;
+};
+
+// Map the shared samples of a signal. The mapping is private, so the pages
+// are read in place and are only copied if they are written to, and the
+// memory of the client is never changed. 64 bit samples are borrowed by the
+// column, which must not outlive the mapping, and others are converted as
+// they are copied into it. The descriptor must be a memfd that is sealed
+// against shrinking and writing, as a client that truncated the descriptor
+// during the comparison would otherwise kill the server with SIGBUS.
+Status MapSharedSamples(const SharedSamples &shared,
+                        const std::vector<int> &fds, SharedMapping *mapping,
+                        AMatrix<double> *samples) {
+  if (shared.fd_index() >= fds.size()) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The shared samples refer to descriptor " +
+        std::to_string(shared.fd_index()) + ", but " +
+        std::to_string(fds.size()) + " were passed with the request.");
+  }
+  const size_t sample_size = SampleSize(shared.format());
+  if (shared.offset() % sample_size != 0) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The offset of the shared samples is not a multiple of their size.");
+  }
+  const int fd = fds[shared.fd_index()];
+#if defined(F_GET_SEALS)
+  const int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+  const int seals = fcntl(fd, F_GET_SEALS);
+  if (seals < 0 || (seals & kRequiredSeals) != kRequiredSeals) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The shared samples must be in a memfd that is sealed with "
+        "F_SEAL_SHRINK and F_SEAL_WRITE.");
+  }
+#else
+  return Status(error::Code::UNIMPLEMENTED,
+      "Shared samples need sealed memfds, which this platform lacks.");
+#endif
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        std::string("Failed to read the size of the shared samples: ") +
+        std::strerror(errno));
+  }
+  const uint64_t file_size = file_stat.st_size;
+  if (shared.num_samples() == 0 || shared.offset() > file_size ||
+      shared.num_samples() > (file_size - shared.offset()) / sample_size) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The shared samples are empty or end beyond their descriptor.");
+  }
+
+  // The mapping starts at the page of the first sample.
+  const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  const uint64_t map_offset = shared.offset() / page_size * page_size;
+  mapping->size = shared.offset() - map_offset +
+      shared.num_samples() * sample_size;
+  mapping->base = mmap(nullptr, mapping->size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, map_offset);
+  if (mapping->base == MAP_FAILED) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        std::string("Failed to map the shared samples: ") +
+        std::strerror(errno));
+  }
+  char *data = static_cast<char *>(mapping->base) +
+      (shared.offset() - map_offset);
+  switch (shared.format()) {
+    case SharedSamples::FLOAT32:
+      *samples = ToColumn(reinterpret_cast<const float *>(data),
+                          shared.num_samples(), 1.0);
+      break;
+    case SharedSamples::INT16:
+      *samples = ToColumn(reinterpret_cast<const int16_t *>(data),
+                          shared.num_samples(), kInt16FullScale);
+      break;
+    default:
+      *samples = AMatrix<double>::Borrow(absl::Span<double>(
+          reinterpret_cast<double *>(data), shared.num_samples()));
+      break;
+  }
+  return Status();
+}
+
+// Close the file descriptors of a message.
+void CloseAll(std::vector<int> *fds) {
+  for (const int fd : *fds) {
+    close(fd);
+  }
+  fds->clear();
+}
+
+#if defined(MSG_NOSIGNAL)
+// A client that hangs up must not kill the server with SIGPIPE.
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Write a whole buffer to a socket.
+bool WriteAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = send(fd, data, size, kSendFlags);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Send the start of a buffer to a socket with file descriptors attached, and
+// return the number of bytes that were sent, or -1 on an error.
+ssize_t SendWithFds(int fd, const char *data, size_t size,
+                    const std::vector<int> &fds) {
+  iovec io;
+  io.iov_base = const_cast<char *>(data);
+  io.iov_len = size;
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+  cmsghdr *header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+  ssize_t sent;
+  do {
+    sent = sendmsg(fd, &message, kSendFlags);
+  } while (sent < 0 && errno == EINTR);
+  return sent;
+}
+
+// Receive the start of a buffer from a socket, and append the file
+// descriptors that are attached to it. Returns the number of bytes that were
+// received, or -1 on an error, including more descriptors being attached
+// than are accepted.
+ssize_t ReceiveWithFds(int fd, char *data, size_t size,
+                       std::vector<int> *fds) {
+  iovec io;
+  io.iov_base = data;
+  io.iov_len = size;
+  std::vector<char> control(
+      CMSG_SPACE(sizeof(int) * VisqolServer::kMaxMessageFds));
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &io;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+#if defined(MSG_CMSG_CLOEXEC)
+  constexpr int kReceiveFlags = MSG_CMSG_CLOEXEC;
+#else
+  constexpr int kReceiveFlags = 0;
+#endif
+  ssize_t received;
+  do {
+    received = recvmsg(fd, &message, kReceiveFlags);
+  } while (received < 0 && errno == EINTR);
+  for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    const size_t num_fds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < num_fds; i++) {
+      int received_fd;
+      std::memcpy(&received_fd, CMSG_DATA(header) + i * sizeof(int),
+                  sizeof(int));
+      fds->push_back(received_fd);
+    }
+  }
+  // The descriptors beyond the space for them are closed by the kernel.
+  if ((message.msg_flags & MSG_CTRUNC) != 0) {
+    ABSL_RAW_LOG(ERROR, "Rejecting a message with too many descriptors.");
+    return -1;
+  }
+  return received;
+}
+
+// Read a whole buffer from a socket.
+bool ReadAll(int fd, char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t num_read = recv(fd, data, size, 0);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read <= 0) {
+      return false;
+    }
+    data += num_read;
+    size -= num_read;
+  }
+  return true;
+}
+
+// The bytes of a message that are read at a time. The buffer of a message
+// only grows as its bytes arrive, so a size prefix alone allocates nothing.
+constexpr size_t kReadChunkBytes = size_t{1} << 20;
+
+// Read the size prefix of a message from a socket. The descriptors that are
+// passed with it are appended to fds, or closed if fds is null. Returns false
+// at the end of the connection, or if the size exceeds kMaxMessageBytes.
+bool ReadSizePrefix(int fd, size_t *size, std::vector<int> *fds) {
+  // The prefix is received with its descriptors, which are only attached to
+  // its first bytes.
+  unsigned char prefix[4];
+  std::vector<int> received_fds;
+  const ssize_t received = ReceiveWithFds(
+      fd, reinterpret_cast<char *>(prefix), sizeof(prefix), &received_fds);
+  if (fds != nullptr) {
+    fds->insert(fds->end(), received_fds.begin(), received_fds.end());
+  } else {
+    CloseAll(&received_fds);
+  }
+  if (received <= 0 ||
+      !ReadAll(fd, reinterpret_cast<char *>(prefix) + received,
+               sizeof(prefix) - received)) {
+    return false;
+  }
+  *size = prefix[0] | (prefix[1] << 8) | (prefix[2] << 16) |
+      (static_cast<size_t>(prefix[3]) << 24);
+  if (*size > VisqolServer::kMaxMessageBytes) {
+    ABSL_RAW_LOG(ERROR, "Rejecting a message of %zu bytes.", *size);
+    return false;
+  }
+  return true;
+}
+
+// Read the serialized message that follows a size prefix, in chunks of
+// kReadChunkBytes, and parse it.
+bool ReadPayload(int fd, size_t size, google::protobuf::MessageLite *message) {
+  std::string bytes;
+  while (bytes.size() < size) {
+    const size_t offset = bytes.size();
+    bytes.resize(offset + std::min(kReadChunkBytes, size - offset));
+    if (!ReadAll(fd, &bytes[offset], bytes.size() - offset)) {
+      return false;
+    }
+  }
+  return message->ParseFromString(bytes);
+}
+
+// The address of a unix domain socket, or false if the path is too long.
+bool MakeAddress(const std::string &socket_path, sockaddr_un *address) {
+  std::memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address->sun_path)) {
+    return false;
+  }
+  std::memcpy(address->sun_path, socket_path.c_str(), socket_path.size());
+  return true;
+}
+
+Status SocketError(const std::string &what, const std::string &socket_path) {
+  return Status(error::Code::UNAVAILABLE, "Failed to " + what + " socket " +
+                socket_path + ": " + std::strerror(errno));
+}
+#endif
+}  // namespace
+
+const size_t VisqolServer::kMaxMessageBytes = size_t{1} << 30;
+const size_t VisqolServer::kMaxMessageFds = 2;
+
+VisqolServer::VisqolServer(size_t max_concurrent_requests,
+                           size_t max_queued_requests)
+    : max_concurrent_requests_(std::max<size_t>(max_concurrent_requests, 1)),
+      max_queued_requests_(max_queued_requests),
+      max_reading_connections_(max_concurrent_requests_ +
+                               max_queued_requests_) {}
+
+VisqolServer::~VisqolServer() {
+  Shutdown();
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](bool *is_serving) { return !*is_serving; }, &is_serving_));
+}
+
+bool VisqolServer::HasFreeSlot() const {
+  return num_running_ < max_concurrent_requests_;
+}
+
+bool VisqolServer::CanReadRequest() const {
+  return is_shut_down_ || num_reading_ < max_reading_connections_;
+}
+
+VisqolResponse VisqolServer::Handle(const VisqolRequest &request,
+                                    const std::vector<int> &fds) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto seconds_since_start = [&start]() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  };
+  VisqolResponse response;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!HasFreeSlot() && num_waiting_ >= max_queued_requests_) {
+      response.set_error_code(error::Code::RESOURCE_EXHAUSTED);
+      response.set_error_message("The server is busy. Retry later.");
+      Metrics::ReportServerRequest(response.error_code(),
+                                   seconds_since_start());
+      return response;
+    }
+    num_waiting_++;
+    mutex_.Await(absl::Condition(this, &VisqolServer::HasFreeSlot));
+    num_waiting_--;
+    num_running_++;
+  }
+
+  // Requests with the same options share the pool of warm instances.
+  const std::string key = request.config().options().SerializeAsString();
+  std::unique_ptr<VisqolManager> visqol;
+  Status status = Acquire(request.config().options(), key, &visqol);
+  if (status.ok()) {
+    const auto compare_start = std::chrono::steady_clock::now();
+    auto result_or = Compare(visqol.get(), request, fds);
+    Release(key, std::move(visqol));
+    status = result_or.status();
+    Metrics::ReportPair(status.error_code(), std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - compare_start).count());
+    if (result_or.ok()) {
+      *response.mutable_result() = result_or.ValueOrDie();
+    }
+  }
+
+  {
+    absl::MutexLock lock(&mutex_);
+    num_running_--;
+  }
+  response.set_error_code(status.error_code());
+  response.set_error_message(status.error_message().ToString());
+  Metrics::ReportServerRequest(response.error_code(), seconds_since_start());
+  return response;
+}
+
+StatusOr<SimilarityResultMsg> VisqolServer::Compare(
+    VisqolManager *visqol, const VisqolRequest &request,
+    const std::vector<int> &fds) {
+  if (!request.reference_path().empty() || !request.degraded_path().empty()) {
+    return visqol->Run(FilePath(request.reference_path()),
+                       FilePath(request.degraded_path()));
+  }
+
+  // Inline and shared samples are compared as if they had been loaded from
+  // files.
+  const size_t sample_rate = request.config().audio().sample_rate();
+  if (sample_rate == 0) {
+    return Status(error::Code::INVALID_ARGUMENT,
+        "The sample rate must be set for inline and shared samples.");
+  }
+  AMatrix<double> reference;
+  AMatrix<double> degraded;
+#if defined(_WIN32)
+  if (request.has_reference_shared() || request.has_degraded_shared()) {
+    return Status(error::Code::UNIMPLEMENTED,
+        "Shared samples are not supported on Windows.");
+  }
+#else
+  // The mappings outlive the signals that borrow their samples.
+  SharedMapping ref_mapping;
+  SharedMapping deg_mapping;
+  if (request.has_reference_shared()) {
+    RETURN_IF_ERROR(MapSharedSamples(request.reference_shared(), fds,
+                                     &ref_mapping, &reference));
+  }
+  if (request.has_degraded_shared()) {
+    RETURN_IF_ERROR(MapSharedSamples(request.degraded_shared(), fds,
+                                     &deg_mapping, &degraded));
+  }
+#endif
+  if (!request.has_reference_shared()) {
+    reference = InlineSamples(request.reference_samples());
+  }
+  if (!request.has_degraded_shared()) {
+    degraded = InlineSamples(request.degraded_samples());
+  }
+  const AudioSignal ref_signal{std::move(reference), sample_rate};
+  AudioSignal deg_signal{std::move(degraded), sample_rate};
+  return visqol->Run(ref_signal, deg_signal);
+}
+
+Status VisqolServer::Acquire(const VisqolConfig::VisqolOptions &options,
+                             const std::string &key,
+                             std::unique_ptr<VisqolManager> *visqol) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto idle = idle_.find(key);
+    if (idle != idle_.end() && !idle->second.empty()) {
+      *visqol = std::move(idle->second.back());
+      idle->second.pop_back();
+      num_idle_--;
+      return Status();
+    }
+  }
+
+  // As for VisqolApi, an empty model path selects the embedded default model.
+  *visqol = absl::make_unique<VisqolManager>();
+  return (*visqol)->Init(FilePath(options.svr_model_path()), options);
+}
+
+void VisqolServer::Release(const std::string &key,
+                           std::unique_ptr<VisqolManager> visqol) {
+  absl::MutexLock lock(&mutex_);
+  if (num_idle_ < max_concurrent_requests_) {
+    idle_[key].push_back(std::move(visqol));
+    num_idle_++;
+  }
+}
+
+#if defined(_WIN32)
+Status VisqolServer::Serve(const std::string &socket_path) {
+  return Status(error::Code::UNIMPLEMENTED,
+      "The ViSQOL server is not supported on Windows.");
+}
+
+void VisqolServer::Shutdown() {}
+
+StatusOr<VisqolResponse> VisqolServer::Call(const std::string &socket_path,
+                                            const VisqolRequest &request,
+                                            const std::vector<int> &fds) {
+  return Status(error::Code::UNIMPLEMENTED,
+      "The ViSQOL server is not supported on Windows.");
+}
+
+bool VisqolServer::WriteMessage(int fd,
+                                const google::protobuf::MessageLite &message,
+                                const std::vector<int> &fds) {
+  return false;
+}
+
+bool VisqolServer::ReadMessage(int fd, google::protobuf::MessageLite *message,
+                               std::vector<int> *fds) {
+  return false;
+}
+
+void VisqolServer::ServeConnection(int fd) {}
+#else
+Status VisqolServer::Serve(const std::string &socket_path) {
+  sockaddr_un address;
+  if (!MakeAddress(socket_path, &address)) {
+    return Status(error::Code::INVALID_ARGUMENT,
+                  "Invalid socket path: " + socket_path);
+  }
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    return SocketError("create", socket_path);
+  }
+  unlink(socket_path.c_str());
+  if (bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd, SOMAXCONN) != 0) {
+    const Status status = SocketError("listen on", socket_path);
+    close(listen_fd);
+    return status;
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    if (is_shut_down_) {
+      close(listen_fd);
+      return Status();
+    }
+    listen_fd_ = listen_fd;
+    is_serving_ = true;
+  }
+
+  while (true) {
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;  // Shut down.
+    }
+    absl::MutexLock lock(&mutex_);
+    if (is_shut_down_) {
+      close(fd);
+      break;
+    }
+    connection_fds_.insert(fd);
+    std::thread(&VisqolServer::ServeConnection, this, fd).detach();
+  }
+
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](std::set<int> *fds) { return fds->empty(); }, &connection_fds_));
+  close(listen_fd);
+  unlink(socket_path.c_str());
+  listen_fd_ = -1;
+  is_serving_ = false;
+  return Status();
+}
+
+void VisqolServer::Shutdown() {
+  absl::MutexLock lock(&mutex_);
+  is_shut_down_ = true;
+  // Shutting the sockets down wakes the threads that are blocked on them.
+  if (listen_fd_ >= 0) {
+    shutdown(listen_fd_, SHUT_RDWR);
+  }
+  for (const int fd : connection_fds_) {
+    shutdown(fd, SHUT_RD);
+  }
+}
+
+void VisqolServer::ServeConnection(int fd) {
+  VisqolRequest request;
+  std::vector<int> fds;
+  size_t size;
+  while (ReadSizePrefix(fd, &size, &fds)) {
+    // Only a bounded number of connections read the body of a request at
+    // once, so idle clients that only sent a size prefix hold no memory.
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &VisqolServer::CanReadRequest));
+      if (is_shut_down_) {
+        break;
+      }
+      num_reading_++;
+    }
+    const bool is_read = ReadPayload(fd, size, &request);
+    {
+      absl::MutexLock lock(&mutex_);
+      num_reading_--;
+    }
+    if (!is_read) {
+      break;
+    }
+    const VisqolResponse response = Handle(request, fds);
+    CloseAll(&fds);
+    if (!WriteMessage(fd, response)) {
+      break;
+    }
+  }
+  CloseAll(&fds);
+  {
+    // The socket is untracked before it is closed, as its number may be
+    // reused by the next connection as soon as it is closed.
+    absl::MutexLock lock(&mutex_);
+    connection_fds_.erase(fd);
+  }
+  close(fd);
+}
+
+StatusOr<VisqolResponse> VisqolServer::Call(const std::string &socket_path,
+                                            const VisqolRequest &request,
+                                            const std::vector<int> &fds) {
+  sockaddr_un address;
+  if (!MakeAddress(socket_path, &address)) {
+    return Status(error::Code::INVALID_ARGUMENT,
+                  "Invalid socket path: " + socket_path);
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return SocketError("create", socket_path);
+  }
+  if (connect(fd, reinterpret_cast<sockaddr *>(&address),
+              sizeof(address)) != 0) {
+    const Status status = SocketError("connect to", socket_path);
+    close(fd);
+    return status;
+  }
+  VisqolResponse response;
+  const bool ok = WriteMessage(fd, request, fds) &&
+      ReadMessage(fd, &response);
+  close(fd);
+  if (!ok) {
+    return Status(error::Code::UNAVAILABLE,
+                  "The connection to " + socket_path + " was lost.");
+  }
+  return response;
+}
+
+bool VisqolServer::WriteMessage(int fd,
+                                const google::protobuf::MessageLite &message,
+                                const std::vector<int> &fds) {
+  std::string bytes;
+  if (!message.SerializeToString(&bytes) || bytes.size() > kMaxMessageBytes ||
+      fds.size() > kMaxMessageFds) {
+    return false;
+  }
+  const uint32_t size = bytes.size();
+  const char prefix[4] = {
+      static_cast<char>(size), static_cast<char>(size >> 8),
+      static_cast<char>(size >> 16), static_cast<char>(size >> 24)};
+  // The descriptors are attached to the first bytes of the prefix.
+  size_t num_sent = 0;
+  if (!fds.empty()) {
+    const ssize_t sent = SendWithFds(fd, prefix, sizeof(prefix), fds);
+    if (sent <= 0) {
+      return false;
+    }
+    num_sent = sent;
+  }
+  return WriteAll(fd, prefix + num_sent, sizeof(prefix) - num_sent) &&
+      WriteAll(fd, bytes.data(), bytes.size());
+}
+
+bool VisqolServer::ReadMessage(int fd, google::protobuf::MessageLite *message,
+                               std::vector<int> *fds) {
+  size_t size;
+  return ReadSizePrefix(fd, &size, fds) && ReadPayload(fd, size, message);
+}
+#endif
+}  // namespace Visqol
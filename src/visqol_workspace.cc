@@ -0,0 +1,155 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "visqol_workspace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+#include "amatrix.h"
+#include "gammatone_filterbank.h"
+
+namespace Visqol {
+
+const size_t VisqolWorkspace::kMinBlockBytes = 1 << 16;
+const size_t VisqolWorkspace::kMaxRecycledMatrices = 64;
+const size_t VisqolWorkspace::kMaxRecycledFilterBanks = 16;
+
+void *VisqolWorkspace::AllocateBytes(size_t num_bytes) {
+  const size_t alignment = alignof(std::max_align_t);
+  num_bytes = (num_bytes + alignment - 1) / alignment * alignment;
+  absl::MutexLock lock(&mutex_);
+  if (blocks_.empty() ||
+      blocks_.back().used + num_bytes > blocks_.back().size) {
+    AddBlock(num_bytes);
+  }
+  Block &block = blocks_.back();
+  char *buffer = block.data.get() + block.used;
+  block.used += num_bytes;
+  used_bytes_ += num_bytes;
+  return buffer;
+}
+
+void VisqolWorkspace::AddBlock(size_t num_bytes) {
+  // Each block is at least as large as all of the earlier ones together, so
+  // a comparison that outgrows the workspace only adds a few of them.
+  const size_t size = std::max({num_bytes, kMinBlockBytes, TotalBlockBytes()});
+  blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size, 0});
+  num_block_allocations_++;
+}
+
+AMatrix<double> VisqolWorkspace::TakeMatrix(size_t num_rows,
+                                            size_t num_cols) {
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto itr = recycled_matrices_.begin();
+         itr != recycled_matrices_.end(); itr++) {
+      if (itr->NumRows() == num_rows && itr->NumCols() == num_cols) {
+        AMatrix<double> matrix = std::move(*itr);
+        recycled_matrices_.erase(itr);
+        return matrix;
+      }
+    }
+    num_matrix_allocations_++;
+  }
+  // The matrix is allocated outside of the lock.
+  return AMatrix<double>(num_rows, num_cols);
+}
+
+void VisqolWorkspace::RecycleMatrix(AMatrix<double> &&matrix) {
+  AMatrix<double> evicted;
+  {
+    absl::MutexLock lock(&mutex_);
+    recycled_matrices_.push_front(std::move(matrix));
+    if (recycled_matrices_.size() > kMaxRecycledMatrices) {
+      evicted = std::move(recycled_matrices_.back());
+      recycled_matrices_.pop_back();
+    }
+  }
+  // The evicted matrix, if any, is freed outside of the lock.
+}
+
+GammatoneFilterBank VisqolWorkspace::TakeFilterBank(
+    const GammatoneFilterBank &filter_bank) {
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto itr = recycled_filter_banks_.begin();
+         itr != recycled_filter_banks_.end(); itr++) {
+      if (itr->GetNumBands() == filter_bank.GetNumBands()) {
+        // Copy assigning arrays of the same size reuses their memory.
+        GammatoneFilterBank recycled = std::move(*itr);
+        recycled_filter_banks_.erase(itr);
+        recycled = filter_bank;
+        return recycled;
+      }
+    }
+  }
+  return filter_bank;
+}
+
+void VisqolWorkspace::RecycleFilterBank(GammatoneFilterBank &&filter_bank) {
+  std::list<GammatoneFilterBank> evicted;
+  {
+    absl::MutexLock lock(&mutex_);
+    recycled_filter_banks_.push_front(std::move(filter_bank));
+    if (recycled_filter_banks_.size() > kMaxRecycledFilterBanks) {
+      evicted.splice(evicted.begin(), recycled_filter_banks_,
+                     std::prev(recycled_filter_banks_.end()));
+    }
+  }
+  // The evicted filter bank, if any, is freed outside of the lock.
+}
+
+void VisqolWorkspace::Reset() {
+  absl::MutexLock lock(&mutex_);
+  high_water_bytes_ = std::max(high_water_bytes_, used_bytes_);
+  used_bytes_ = 0;
+  if (blocks_.size() > 1) {
+    // Replace the blocks with one that holds a whole comparison.
+    blocks_.clear();
+    AddBlock(high_water_bytes_);
+  } else if (!blocks_.empty()) {
+    blocks_.back().used = 0;
+  }
+}
+
+size_t VisqolWorkspace::NumBlockAllocations() const {
+  absl::MutexLock lock(&mutex_);
+  return num_block_allocations_;
+}
+
+size_t VisqolWorkspace::NumMatrixAllocations() const {
+  absl::MutexLock lock(&mutex_);
+  return num_matrix_allocations_;
+}
+
+size_t VisqolWorkspace::Capacity() const {
+  absl::MutexLock lock(&mutex_);
+  return TotalBlockBytes();
+}
+
+size_t VisqolWorkspace::TotalBlockBytes() const {
+  size_t total = 0;
+  for (const Block &block : blocks_) {
+    total += block.size;
+  }
+  return total;
+}
+}  // namespace Visqol
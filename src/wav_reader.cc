@@ -17,10 +17,13 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <cstring>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/internal/raw_logging.h"
+#include "absl/types/span.h"
 
 #include "misc_math.h"
 
@@ -72,6 +75,81 @@ static_assert(sizeof(WavHeader) == kWavHeaderSize,
 // Supported WAV encoding formats.
 static const uint16_t kExtensibleWavFormat = 0xfffe;
 static const uint16_t kPcmFormat = 0x1;
+static const uint16_t kFloatFormat = 0x3;
+
+// Offset of the sub format GUID in the extension of the extensible format.
+const size_t kSubFormatOffset = 6;
+
+// Decode a little endian sample and normalize it to [-1, 1). The 16 bit
+// samples are normalized as in MiscMath::NormalizeInt16ToDouble.
+double DecodeInt16(const uint8_t* bytes) {
+  return static_cast<int16_t>(bytes[0] | bytes[1] << 8) / 32768.0;
+}
+
+double DecodeInt24(const uint8_t* bytes) {
+  // The sample is shifted to the top of 32 bits, so that its sign is
+  // extended when it is shifted back.
+  const uint32_t bits = static_cast<uint32_t>(bytes[0]) << 8 |
+      static_cast<uint32_t>(bytes[1]) << 16 |
+      static_cast<uint32_t>(bytes[2]) << 24;
+  return (static_cast<int32_t>(bits) >> 8) / 8388608.0;
+}
+
+double DecodeInt32(const uint8_t* bytes) {
+  const uint32_t bits = static_cast<uint32_t>(bytes[0]) |
+      static_cast<uint32_t>(bytes[1]) << 8 |
+      static_cast<uint32_t>(bytes[2]) << 16 |
+      static_cast<uint32_t>(bytes[3]) << 24;
+  return static_cast<int32_t>(bits) / 2147483648.0;
+}
+
+double DecodeFloat32(const uint8_t* bytes) {
+  const uint32_t bits = static_cast<uint32_t>(bytes[0]) |
+      static_cast<uint32_t>(bytes[1]) << 8 |
+      static_cast<uint32_t>(bytes[2]) << 16 |
+      static_cast<uint32_t>(bytes[3]) << 24;
+  float sample;
+  std::memcpy(&sample, &bits, sizeof(sample));
+  return sample;
+}
+
+// Decode frames of interleaved samples and mix the channels of each frame
+// down to a single sample. The channels are summed in order and then
+// averaged, which gives the same result as MiscAudio::ToMono.
+template <double (*Decode)(const uint8_t*), typename T>
+void MixDownFrames(const uint8_t* block, size_t num_frames,
+                   size_t num_channels, size_t bytes_per_sample,
+                   T* target_buffer) {
+  const size_t bytes_per_frame = num_channels * bytes_per_sample;
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    const uint8_t* samples = block + frame * bytes_per_frame;
+    double sum = Decode(samples);
+    for (size_t channel = 1; channel < num_channels; channel++) {
+      sum += Decode(samples + channel * bytes_per_sample);
+    }
+    target_buffer[frame] = static_cast<T>(
+        num_channels == 1 ? sum : sum / num_channels);
+  }
+}
+
+// Decode frames of interleaved samples into the column of each channel of a
+// column major matrix of num_rows rows.
+template <double (*Decode)(const uint8_t*)>
+void SplitFrames(const uint8_t* block, size_t num_frames, size_t num_channels,
+                 size_t bytes_per_sample, size_t num_rows,
+                 double* target_buffer) {
+  const size_t bytes_per_frame = num_channels * bytes_per_sample;
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    const uint8_t* samples = block + frame * bytes_per_frame;
+    for (size_t channel = 0; channel < num_channels; channel++) {
+      target_buffer[channel * num_rows + frame] =
+          Decode(samples + channel * bytes_per_sample);
+    }
+  }
+}
+
+// Number of samples decoded at a time by ReadMonoSamples.
+const size_t kMonoBlockSamples = 1 << 14;
 }  // namespace
 
 WavReader::WavReader(std::istream* binary_stream)
@@ -113,6 +191,7 @@ bool WavReader::ParseHeader() {
     return false;
   }
   const uint32_t format_size = header.format.header.size;
+  uint16_t sample_format_tag = header.format.format_tag;
   // Size of |WavFormat| without |ChunkHeader|.
   static const uint32_t kFormatSubChunkHeader =
       sizeof(WavFormat) - sizeof(ChunkHeader);
@@ -129,49 +208,43 @@ bool WavReader::ParseHeader() {
                    " size");
       return false;
     }
-    int8_t extension_data;
-
-    for (size_t i = 0; i < static_cast<size_t>(extension_size); ++i) {
-      if (ReadBinaryDataFromStream(&extension_data, sizeof(extension_data)) !=
-          sizeof(extension_data)) {
-        ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Error reading extension"
-                     " data");
-        return false;
-      }
-    }
-  }
-  if (header.format.format_tag == kExtensibleWavFormat) {
-    // Skip extensible wav format "fact" header.
-    ChunkHeader fact_header;
-    if (ReadBinaryDataFromStream(&fact_header, sizeof(fact_header)) !=
-        sizeof(fact_header)) {
-      ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Error reading 'fact'"
-                   " header");
-      return false;
-    }
-    if (std::string(fact_header.id, 4) != "fact") {
-      ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Incorrect 'fact' header"
-                   " id");
+    std::vector<uint8_t> extension_data(std::max<int16_t>(extension_size, 0));
+    if (ReadBinaryDataFromStream(extension_data.data(),
+                                 extension_data.size()) !=
+        extension_data.size()) {
+      ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Error reading extension"
+                   " data");
       return false;
     }
-    int8_t fact_data;
-    for (size_t i = 0; i < static_cast<size_t>(fact_header.size); ++i) {
-      if (ReadBinaryDataFromStream(&fact_data, sizeof(fact_data)) !=
-          sizeof(fact_data)) {
-        ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Error reading 'fact'"
-                     " data");
+    // The extensible format holds the actual format in the first two bytes
+    // of its sub format GUID, after the valid bits and the channel mask.
+    if (header.format.format_tag == kExtensibleWavFormat) {
+      if (extension_data.size() < kSubFormatOffset + sizeof(uint16_t)) {
+        ABSL_RAW_LOG(ERROR, "Error parsing WAV Header - Missing extensible"
+                     " sub format");
         return false;
       }
+      sample_format_tag = extension_data[kSubFormatOffset] |
+          extension_data[kSubFormatOffset + 1] << 8;
     }
   }
+  // Any 'fact' chunk, as written for the extensible and float formats, is
+  // skipped along with the other chunks before the 'data' chunk.
 
   num_channels_ = header.format.num_channels;
   sample_rate_hz_ = header.format.samples_rate;
 
   bytes_per_sample_ = header.format.bits_per_sample / 8;
-  if (bytes_per_sample_ == 0 || bytes_per_sample_ != sizeof(int16_t)) {
+  is_float_ = sample_format_tag == kFloatFormat;
+  const bool is_supported_int = sample_format_tag == kPcmFormat &&
+      (bytes_per_sample_ == 2 || bytes_per_sample_ == 3 ||
+       bytes_per_sample_ == 4);
+  const bool is_supported_float = is_float_ && bytes_per_sample_ == 4;
+  if (header.format.bits_per_sample % 8 != 0 ||
+      !(is_supported_int || is_supported_float)) {
     ABSL_RAW_LOG(ERROR,
-                 "Error parsing WAV Header - Expected 16bit samples.");
+                 "Error parsing WAV Header - Expected 16, 24 or 32 bit PCM"
+                 " samples or 32 bit float samples.");
     return false;
   }
 
@@ -208,6 +281,7 @@ bool WavReader::ParseHeader() {
   if (header.format.num_channels == 0 || num_total_samples_ == 0 ||
       bytes_in_payload % bytes_per_sample_ != 0 ||
       (header.format.format_tag != kPcmFormat &&
+       header.format.format_tag != kFloatFormat &&
        header.format.format_tag != kExtensibleWavFormat) ||
       (std::string(header.riff.header.id, 4) != "RIFF") ||
       (std::string(header.riff.format, 4) != "WAVE") ||
@@ -227,19 +301,109 @@ bool WavReader::ParseHeader() {
 }
 
 size_t WavReader::ReadSamples(size_t num_samples, int16_t* target_buffer) {
+  if (is_float_ || bytes_per_sample_ != sizeof(int16_t)) {
+    return 0;
+  }
+  return ReadRawSamples(num_samples, target_buffer);
+}
+
+size_t WavReader::ReadRawSamples(size_t num_samples, void* target_buffer) {
   const size_t num_samples_to_read =
       std::min(num_remaining_samples_, num_samples);
   if (num_samples_to_read == 0) {
     return 0;
   }
-  const size_t num_bytes_read =
-      ReadBinaryDataFromStream(target_buffer, num_samples * sizeof(int16_t));
+  const size_t num_bytes_read = ReadBinaryDataFromStream(target_buffer,
+      num_samples_to_read * bytes_per_sample_);
   const size_t num_samples_read = num_bytes_read / bytes_per_sample_;
 
   num_remaining_samples_ -= num_samples_read;
   return num_samples_read;
 }
 
+size_t WavReader::ReadMonoSamples(size_t num_frames, double* target_buffer) {
+  return DecodeMono(num_frames, target_buffer);
+}
+
+size_t WavReader::ReadMonoBlock(absl::Span<double> block) {
+  return DecodeMono(block.size(), block.data());
+}
+
+size_t WavReader::ReadMonoBlock(absl::Span<float> block) {
+  return DecodeMono(block.size(), block.data());
+}
+
+size_t WavReader::ReadChannels(size_t num_frames, double* target_buffer) {
+  if (num_channels_ == 0) {
+    return 0;
+  }
+  const size_t frames_per_block = std::max<size_t>(1,
+      kMonoBlockSamples / num_channels_);
+  raw_block_.resize(frames_per_block * num_channels_ * bytes_per_sample_);
+  size_t num_frames_read = 0;
+  while (num_frames_read < num_frames) {
+    const size_t block_frames = std::min(frames_per_block,
+                                         num_frames - num_frames_read);
+    const size_t block_frames_read = ReadRawSamples(
+        block_frames * num_channels_, raw_block_.data()) / num_channels_;
+    double* target = target_buffer + num_frames_read;
+    if (is_float_) {
+      SplitFrames<DecodeFloat32>(raw_block_.data(), block_frames_read,
+          num_channels_, bytes_per_sample_, num_frames, target);
+    } else if (bytes_per_sample_ == 2) {
+      SplitFrames<DecodeInt16>(raw_block_.data(), block_frames_read,
+          num_channels_, bytes_per_sample_, num_frames, target);
+    } else if (bytes_per_sample_ == 3) {
+      SplitFrames<DecodeInt24>(raw_block_.data(), block_frames_read,
+          num_channels_, bytes_per_sample_, num_frames, target);
+    } else {
+      SplitFrames<DecodeInt32>(raw_block_.data(), block_frames_read,
+          num_channels_, bytes_per_sample_, num_frames, target);
+    }
+    num_frames_read += block_frames_read;
+    if (block_frames_read < block_frames) {
+      break;
+    }
+  }
+  return num_frames_read;
+}
+
+template <typename T>
+size_t WavReader::DecodeMono(size_t num_frames, T* target_buffer) {
+  if (num_channels_ == 0) {
+    return 0;
+  }
+  const size_t frames_per_block = std::max<size_t>(1,
+      kMonoBlockSamples / num_channels_);
+  raw_block_.resize(frames_per_block * num_channels_ * bytes_per_sample_);
+  size_t num_frames_read = 0;
+  while (num_frames_read < num_frames) {
+    const size_t block_frames = std::min(frames_per_block,
+                                         num_frames - num_frames_read);
+    const size_t block_frames_read = ReadRawSamples(
+        block_frames * num_channels_, raw_block_.data()) / num_channels_;
+    T* target = target_buffer + num_frames_read;
+    if (is_float_) {
+      MixDownFrames<DecodeFloat32>(raw_block_.data(), block_frames_read,
+                                   num_channels_, bytes_per_sample_, target);
+    } else if (bytes_per_sample_ == 2) {
+      MixDownFrames<DecodeInt16>(raw_block_.data(), block_frames_read,
+                                 num_channels_, bytes_per_sample_, target);
+    } else if (bytes_per_sample_ == 3) {
+      MixDownFrames<DecodeInt24>(raw_block_.data(), block_frames_read,
+                                 num_channels_, bytes_per_sample_, target);
+    } else {
+      MixDownFrames<DecodeInt32>(raw_block_.data(), block_frames_read,
+                                 num_channels_, bytes_per_sample_, target);
+    }
+    num_frames_read += block_frames_read;
+    if (block_frames_read < block_frames) {
+      break;
+    }
+  }
+  return num_frames_read;
+}
+
 size_t WavReader::GetNumTotalSamples() const { return num_total_samples_; }
 
 size_t WavReader::GetNumChannels() const { return num_channels_; }
@@ -0,0 +1,88 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "wav_tile_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "absl/base/internal/raw_logging.h"
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+#include "wav_reader.h"
+
+namespace Visqol {
+WavTileReader::WavTileReader(const FilePath &path)
+    : file_(path.Path().c_str(), std::ios::binary) {
+  if (!file_) {
+    ABSL_RAW_LOG(ERROR, "Could not find file %s.", path.Path().c_str());
+    return;
+  }
+  auto reader = absl::make_unique<WavReader>(&file_);
+  if (!reader->IsHeaderValid() || reader->GetNumTotalSamples() == 0) {
+    ABSL_RAW_LOG(ERROR, "Error reading header for file %s.",
+                 path.Path().c_str());
+    return;
+  }
+  sample_rate_ = reader->GetSampleRateHz();
+  num_samples_ = reader->GetNumTotalSamples() / reader->GetNumChannels();
+  reader_ = std::move(reader);
+}
+
+AudioSignal WavTileReader::Read(int64_t first_sample, size_t num_samples,
+                                int64_t *signal_first_sample) {
+  // A range that starts before the samples that were dropped starts at the
+  // first sample that is still held.
+  const int64_t begin = std::min(
+      std::max({first_sample, buffer_first_sample_, int64_t{0}}),
+      static_cast<int64_t>(num_samples_));
+  const int64_t end = std::min(first_sample +
+                                   static_cast<int64_t>(num_samples),
+                               static_cast<int64_t>(num_samples_));
+  // Drop the samples before the range, and read up to its end.
+  const int64_t num_dropped = std::min(
+      std::max<int64_t>(begin - buffer_first_sample_, 0),
+      static_cast<int64_t>(buffer_.size()));
+  buffer_.erase(buffer_.begin(), buffer_.begin() + num_dropped);
+  buffer_first_sample_ += num_dropped;
+  const int64_t buffer_end = buffer_first_sample_ + buffer_.size();
+  if (end > buffer_end && reader_ != nullptr) {
+    // Samples that are skipped over are read and dropped, so that the reader
+    // stays at the end of the buffer.
+    const size_t num_read = end - buffer_end;
+    buffer_.resize(buffer_.size() + num_read);
+    const size_t num_decoded = reader_->ReadMonoBlock(
+        absl::Span<double>(buffer_.data() + buffer_.size() - num_read,
+                           num_read));
+    // A file that is shorter than its header says is padded with silence.
+    std::fill(buffer_.end() - (num_read - num_decoded), buffer_.end(), 0.0);
+    const int64_t num_skipped = std::min<int64_t>(
+        std::max<int64_t>(begin - buffer_first_sample_, 0), buffer_.size());
+    buffer_.erase(buffer_.begin(), buffer_.begin() + num_skipped);
+    buffer_first_sample_ += num_skipped;
+  }
+  *signal_first_sample = begin;
+  const auto signal_begin = buffer_.begin() + (begin - buffer_first_sample_);
+  const auto signal_end = buffer_.begin() +
+      (std::max(end, begin) - buffer_first_sample_);
+  return AudioSignal{AMatrix<double>(std::vector<double>(signal_begin,
+                                                         signal_end)),
+                     sample_rate_};
+}
+}  // namespace Visqol
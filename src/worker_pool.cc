@@ -0,0 +1,74 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+namespace Visqol {
+WorkerPool::WorkerPool(size_t num_threads) {
+  threads_.reserve(num_threads);
+  for (size_t t = 0; t < num_threads; t++) {
+    threads_.emplace_back(&WorkerPool::RunJobs, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    is_stopping_ = true;
+  }
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+WorkerPool &WorkerPool::Shared() {
+  // The pool is never destroyed, so that its threads may still take jobs
+  // while the process exits.
+  static WorkerPool *const pool = new WorkerPool(
+      std::max(std::thread::hardware_concurrency(), 2u) - 1);
+  return *pool;
+}
+
+void WorkerPool::Submit(std::function<void()> job) {
+  absl::MutexLock lock(&mutex_);
+  jobs_.push_back(std::move(job));
+}
+
+bool WorkerPool::HasJobOrIsStopping() const {
+  return !jobs_.empty() || is_stopping_;
+}
+
+void WorkerPool::RunJobs() {
+  while (true) {
+    std::function<void()> job;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &WorkerPool::HasJobOrIsStopping));
+      if (jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
+}  // namespace Visqol
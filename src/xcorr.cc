@@ -17,82 +17,254 @@
 #include <math.h>
 
 #include <algorithm>
+#include <cmath>
 #include <complex>
+#include <map>
 #include <memory>
 #include <utility>
 #include <vector>
 #include <iostream>
-#include "absl/memory/memory.h"
 
 #include "amatrix.h"
 #include "fast_fourier_transform.h"
+#include "fft_manager_pool.h"
+#include "misc_math.h"
 
 namespace Visqol {
 
+const double XCorr::kFftPointCost = 2.0;
+
 // Assumes inputs are column vectors
 int64_t XCorr::CalcBestLag(const AMatrix<double>& signal_1,
                            const AMatrix<double>& signal_2) {
   const int64_t max_lag = std::max(static_cast<int64_t>(signal_1.NumRows()),
       static_cast<int64_t>(signal_2.NumRows())) - 1;
 
-  auto pwise_fft_vec = CalcInverseFFTPwiseProd(signal_1, signal_2);
-  // Build negatives corrs.
-  std::vector<double> corrs{pwise_fft_vec.end() - max_lag, pwise_fft_vec.end()};
-  // Build positive corrs.
-  std::vector<double> positives{pwise_fft_vec.begin(),
-                                pwise_fft_vec.begin() + max_lag + 1};
-  // Build total corrs.
-  corrs.insert(corrs.end(), positives.begin(), positives.end());
-  // Find best corr and from that the best lag.
-  auto best_corr = std::max_element(corrs.cbegin(), corrs.cend());
-  return std::distance(corrs.cbegin(), best_corr) - max_lag;
+  const size_t fft_points = CalcFftPoints(max_lag + 1);
+  // The manager is leased from the pool, as the same sizes recur for every
+  // patch.
+  const FftManagerPool::Lease fft_lease(fft_points);
+  const auto &fft_manager = fft_lease.Get();
+  CorrelationBuffers buffers(fft_manager->GetFftSize());
+  std::vector<double> corrs(fft_manager->GetFftSize());
+  CalcCorrelations(signal_1, signal_2, fft_manager, &buffers, &corrs);
+  return FindBestLag(corrs, max_lag);
 }
 
-std::vector<double> XCorr::CalcInverseFFTPwiseProd(
-    const AMatrix<double>& signal_1, const AMatrix<double>& signal_2) {
-  std::vector<double> signal_1_vec = signal_1.ToVector();
-  std::vector<double> signal_2_vec = signal_2.ToVector();
-
-  // Add zeros until they're both the same length.
-  // Reserve then resize to prevent extraneous memory being allocated.
-  // Resize by itself can double the vector capacity.
-  const size_t biggest_vec = signal_1.NumRows() > signal_2.NumRows() ?
-      signal_1.NumRows() : signal_2.NumRows();
-  if (signal_1.NumRows() > signal_2.NumRows()) {
-    signal_2_vec.reserve(biggest_vec);
-    signal_2_vec.resize(biggest_vec, 0.0);
-  } else if (signal_1.NumRows() < signal_2.NumRows()) {
-    signal_1_vec.reserve(biggest_vec);
-    signal_1_vec.resize(biggest_vec, 0.0);
+std::vector<int64_t> XCorr::CalcBestLags(
+    const std::vector<AMatrix<double>> &signals_1,
+    const std::vector<AMatrix<double>> &signals_2) {
+  std::vector<int64_t> best_lags(signals_1.size(), 0);
+  // Group the pairs by the FFT size of their correlation. Patches mostly have
+  // the same length, so there are only a few groups.
+  std::map<size_t, std::vector<size_t>> pairs_by_fft_points;
+  for (size_t i = 0; i < signals_1.size(); i++) {
+    const size_t biggest_vec = std::max(signals_1[i].NumRows(),
+                                        signals_2[i].NumRows());
+    pairs_by_fft_points[CalcFftPoints(biggest_vec)].push_back(i);
+  }
+
+  for (const auto &group : pairs_by_fft_points) {
+    const FftManagerPool::Lease fft_lease(group.first);
+    const auto &fft_manager = fft_lease.Get();
+    const size_t fft_size = fft_manager->GetFftSize();
+    CorrelationBuffers buffers(fft_size);
+    std::vector<double> corrs(fft_size);
+    for (size_t i : group.second) {
+      const AMatrix<double> &signal_1 = signals_1[i];
+      const AMatrix<double> &signal_2 = signals_2[i];
+      CalcCorrelations(signal_1, signal_2, fft_manager, &buffers, &corrs);
+      const int64_t max_lag = static_cast<int64_t>(
+          std::max(signal_1.NumRows(), signal_2.NumRows())) - 1;
+      best_lags[i] = FindBestLag(corrs, max_lag);
+    }
   }
+  return best_lags;
+}
 
+size_t XCorr::CalcFftPoints(size_t num_samples) {
   // Calculate how many points in FFT (next ^2 elements)
   int expon;
-  frexp(std::abs((int64_t)signal_1_vec.size() * 2 - 1), &expon);
-  const size_t fft_points = pow(2, expon);
+  frexp(std::abs((int64_t)num_samples * 2 - 1), &expon);
+  return pow(2, expon);
+}
+
+std::vector<double> XCorr::CircularlyReverse(
+    const std::vector<double> &signal, size_t fft_size) {
+  std::vector<double> reversed(fft_size, 0.0);
+  if (!signal.empty()) {
+    reversed[0] = signal[0];
+  }
+  for (size_t i = 1; i < signal.size(); i++) {
+    reversed[fft_size - i] = signal[i];
+  }
+  return reversed;
+}
+
+int64_t XCorr::FindBestLag(const std::vector<double> &corrs,
+                           int64_t max_lag) {
+  // The negative lags are at the end of the correlations. They are scanned
+  // first, so that ties resolve to the most negative lag.
+  const int64_t num_corrs = corrs.size();
+  auto corr_at = [&](int64_t lag) {
+    return lag < 0 ? corrs[num_corrs + lag] : corrs[lag];
+  };
+  int64_t best_lag = -max_lag;
+  double best_corr = corr_at(best_lag);
+  for (int64_t lag = -max_lag + 1; lag <= max_lag; lag++) {
+    const double corr = corr_at(lag);
+    if (corr > best_corr) {
+      best_corr = corr;
+      best_lag = lag;
+    }
+  }
+  return best_lag;
+}
+
+int64_t XCorr::CalcBestLagInRange(const std::vector<double> &signal_1,
+                                  const std::vector<double> &signal_2,
+                                  int64_t min_lag, int64_t max_lag) {
+  const int64_t len_1 = signal_1.size();
+  const int64_t len_2 = signal_2.size();
+  int64_t best_lag = min_lag;
+  double best_corr = 0.0;
+  for (int64_t lag = min_lag; lag <= max_lag; lag++) {
+    // Only the samples where both signals overlap contribute, as the signals
+    // are zero padded for the FFT.
+    const int64_t start = std::max<int64_t>(0, -lag);
+    const int64_t end = std::min(len_2, len_1 - lag);
+    double corr = 0.0;
+    for (int64_t n = start; n < end; n++) {
+      corr += signal_1[n + lag] * signal_2[n];
+    }
+    if (lag == min_lag || corr > best_corr) {
+      best_corr = corr;
+      best_lag = lag;
+    }
+  }
+  return best_lag;
+}
 
-  // Calculate the pointwise product of the forward fft of both signals.
-  auto fft_manager = absl::make_unique<FftManager>(fft_points);
-  auto pwise_prod = CalcFFTPwiseProd(signal_1_vec, signal_2_vec, fft_manager,
-      fft_points);
+int64_t XCorr::CalcBestLagWithin(const AMatrix<double>& signal_1,
+                                 const AMatrix<double>& signal_2,
+                                 int64_t max_lag) {
+  const int64_t len_1 = signal_1.NumRows();
+  const int64_t len_2 = signal_2.NumRows();
+  max_lag = std::max<int64_t>(
+      0, std::min(max_lag, std::max(len_1, len_2) - 1));
+  const int64_t num_lags = 2 * max_lag + 1;
+  const std::vector<double> signal_1_vec = signal_1.ToVector();
+  const std::vector<double> signal_2_vec = signal_2.ToVector();
 
-  return FastFourierTransform::Inverse1dConjSym(fft_manager, pwise_prod)
-      .ToVector();
+  // The FFT only needs to hold a block of the second signal and the lags on
+  // either side of it. Blocks of at least the number of lags keep the
+  // overlap below half of each FFT.
+  const size_t fft_points = std::max(
+      MiscMath::NextPowTwo(static_cast<uint32_t>(
+          std::min(2 * num_lags, len_2 + 2 * max_lag))),
+      FftManager::kMinFftSize);
+  const int64_t block_size = static_cast<int64_t>(fft_points) - 2 * max_lag;
+  const int64_t num_blocks = (len_2 + block_size - 1) / block_size;
+  // Each block takes two forward FFTs, and all of them share one inverse.
+  const double fft_cost = kFftPointCost * (2 * num_blocks + 1) * fft_points *
+      std::log2(static_cast<double>(fft_points));
+  const double direct_cost = static_cast<double>(num_lags) *
+      std::min(len_1, len_2);
+  if (direct_cost <= fft_cost) {
+    return CalcBestLagInRange(signal_1_vec, signal_2_vec, -max_lag, max_lag);
+  }
+  return CalcBestLagOverlapSave(signal_1_vec, signal_2_vec, max_lag,
+                                fft_points);
 }
 
-AMatrix<std::complex<double>> XCorr::CalcFFTPwiseProd(
-    const std::vector<double> &signal_1, const std::vector<double> &signal_2,
-    const std::unique_ptr<FftManager>& fft_manager, const size_t fft_points) {
+int64_t XCorr::CalcBestLagOverlapSave(const std::vector<double> &signal_1,
+                                      const std::vector<double> &signal_2,
+                                      int64_t max_lag, size_t fft_points) {
+  const int64_t len_1 = signal_1.size();
+  const int64_t len_2 = signal_2.size();
+  const FftManagerPool::Lease fft_lease(fft_points);
+  const auto &fft_manager = fft_lease.Get();
+  const size_t fft_size = fft_manager->GetFftSize();
+  const int64_t block_size = static_cast<int64_t>(fft_size) - 2 * max_lag;
 
-  auto fftsignal_2 = FastFourierTransform::Forward1d(fft_manager,
-                                                     signal_2,
-                                                     fft_points);
-  std::transform(fftsignal_2.begin(), fftsignal_2.end(),
-                 fftsignal_2.begin(), [](decltype(*fftsignal_2.begin())& s)
-                 { return conj(s); });
+  AudioChannel pwise_prod;
+  pwise_prod.Init(fft_size);
+  pwise_prod.Clear();
+  AudioChannel segment_spectrum;
+  segment_spectrum.Init(fft_size);
+  AudioChannel block_spectrum;
+  block_spectrum.Init(fft_size);
+  std::vector<double> segment(fft_size);
+  for (int64_t start = 0; start < len_2; start += block_size) {
+    const int64_t end = std::min(start + block_size, len_2);
+    // The segment of the first signal that the block overlaps at any lag in
+    // the range, zero where it is outside of the first signal. The circular
+    // correlation at the first 2 * max_lag + 1 points then does not wrap.
+    std::fill(segment.begin(), segment.end(), 0.0);
+    for (int64_t m = 0; m < end - start + 2 * max_lag; m++) {
+      const int64_t n = start - max_lag + m;
+      if (n >= 0 && n < len_1) {
+        segment[m] = signal_1[n];
+      }
+    }
+    const std::vector<double> block{signal_2.begin() + start,
+                                    signal_2.begin() + end};
+    FastFourierTransform::ForwardReal1d(fft_manager, segment,
+                                        &segment_spectrum);
+    FastFourierTransform::ForwardReal1d(
+        fft_manager, CircularlyReverse(block, fft_size), &block_spectrum);
+    fft_manager->ZConvolveAccumulate(segment_spectrum, block_spectrum,
+                                     &pwise_prod, 1.0f);
+  }
+  const std::vector<double> corrs = FastFourierTransform::InverseReal1d(
+      fft_manager, pwise_prod);
+
+  // The correlation at point k is that of the lag k - max_lag.
+  int64_t best_point = 0;
+  for (int64_t k = 1; k <= 2 * max_lag; k++) {
+    if (corrs[k] > corrs[best_point]) {
+      best_point = k;
+    }
+  }
+  return best_point - max_lag;
+}
+
+XCorr::CorrelationBuffers::CorrelationBuffers(size_t fft_size) {
+  time_buffer.Init(fft_size);
+  spectrum_1.Init(fft_size);
+  spectrum_2.Init(fft_size);
+  pwise_prod.Init(fft_size);
+}
+
+void XCorr::CalcCorrelations(const AMatrix<double> &signal_1,
+                             const AMatrix<double> &signal_2,
+                             const std::unique_ptr<FftManager> &fft_manager,
+                             CorrelationBuffers *buffers,
+                             std::vector<double> *corrs) {
+  const size_t fft_size = fft_manager->GetFftSize();
+  AudioChannel &time_buffer = buffers->time_buffer;
+
+  // The first signal is zero padded to the FFT size in place.
+  time_buffer.Clear();
+  std::copy(signal_1.cbegin(), signal_1.cend(), time_buffer.begin());
+  fft_manager->ZDomainFromTimeDomain(time_buffer, &buffers->spectrum_1);
+
+  // The spectrum of a real signal that is circularly reversed in time is the
+  // conjugate of the spectrum of the signal. Reversing the second signal
+  // turns the pointwise product into the one with the conjugate, without
+  // leaving the half spectrum.
+  time_buffer.Clear();
+  for (size_t n = 0; n < signal_2.NumRows(); n++) {
+    time_buffer[n == 0 ? 0 : fft_size - n] = signal_2(n);
+  }
+  fft_manager->ZDomainFromTimeDomain(time_buffer, &buffers->spectrum_2);
 
-  return FastFourierTransform::Forward1d(fft_manager, signal_1, fft_points)
-      .PointWiseProduct(fftsignal_2);
+  buffers->pwise_prod.Clear();
+  fft_manager->ZConvolveAccumulate(buffers->spectrum_1, buffers->spectrum_2,
+                                   &buffers->pwise_prod, 1.0f);
+  fft_manager->TimeFromFreqDomain(buffers->pwise_prod, &time_buffer);
+  fft_manager->ApplyReverseFftScaling(&time_buffer);
+  std::copy(time_buffer.begin(), time_buffer.end(), corrs->begin());
 }
 
 }  // namespace Visqol
@@ -14,9 +14,17 @@
 
 #include "alignment.h"
 
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "audio_signal.h"
+#include "audio_signal_view.h"
+#include "fingerprint_aligner.h"
+#include "reference_aligner.h"
 #include "xcorr.h"
 
 namespace Visqol {
@@ -159,5 +167,155 @@ TEST(Alignment, AlignAndTruncateSignalWithPositiveLag) {
             ref_signal.GetDuration());
 }
 
+// Test that an aligner prepared once for the reference aligns several
+// degraded signals exactly as GloballyAlign does.
+TEST(Alignment, ReferenceAlignerMatchesGloballyAlign) {
+  const AudioSignal ref_signal{kRefSignal, 1};
+  ReferenceAligner ref_aligner(ref_signal);
+  ASSERT_TRUE(ref_aligner.MatchesReference(ref_signal));
+
+  for (const auto &deg_matrix : {kDegSignalLag2, kDegSignalNegativeLag2,
+                                 kRefSignal}) {
+    const AudioSignal deg_signal{deg_matrix, 1};
+    auto expected = Alignment::GloballyAlign(ref_signal, deg_signal);
+    auto result = ref_aligner.GloballyAlign(deg_signal);
+    ASSERT_EQ(std::get<1>(expected), std::get<1>(result));
+    ASSERT_EQ(std::get<0>(expected).data_matrix,
+              std::get<0>(result).data_matrix);
+  }
+}
+
+// Test that the multi-resolution alignment finds the same lag as the full
+// rate alignment for a signal long enough to be decimated.
+TEST(Alignment, MultiResolutionMatchesFullRate) {
+  const size_t kNumSamples = 100000;
+  const int64_t kLag = 301;
+  std::mt19937 gen(7);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  // Noise modulated by a slow envelope, so that the envelope has features.
+  std::vector<double> source(kNumSamples + kLag);
+  for (size_t i = 0; i < source.size(); i++) {
+    source[i] = noise(gen) * (1.1 + std::sin(i / 700.0) * std::sin(i / 53.0));
+  }
+  const AudioSignal ref_signal{AMatrix<double>(std::vector<double>(
+      source.begin(), source.begin() + kNumSamples)), 48000};
+  const AudioSignal deg_signal{AMatrix<double>(std::vector<double>(
+      source.begin() + kLag, source.end())), 48000};
+
+  auto expected = Alignment::GloballyAlign(ref_signal, deg_signal);
+  auto result = Alignment::GloballyAlignMultiResolution(ref_signal,
+                                                        deg_signal);
+  ASSERT_EQ(kLag / 48000.0, std::get<1>(expected));
+  ASSERT_EQ(std::get<1>(expected), std::get<1>(result));
+  ASSERT_EQ(std::get<0>(expected).data_matrix,
+            std::get<0>(result).data_matrix);
+}
+
+// Test that aligning around a lag hint finds the same lag as the full search,
+// both when the hint is close to the lag and when it is beyond the signals.
+TEST(Alignment, AroundLagMatchesFullSearch) {
+  const size_t kNumSamples = 20000;
+  const int64_t kLag = 301;
+  std::mt19937 gen(5);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  std::vector<double> source(kNumSamples + kLag);
+  for (size_t i = 0; i < source.size(); i++) {
+    source[i] = noise(gen) * (1.1 + std::sin(i / 700.0) * std::sin(i / 53.0));
+  }
+  const AudioSignal ref_signal{AMatrix<double>(std::vector<double>(
+      source.begin(), source.begin() + kNumSamples)), 48000};
+  const AudioSignal deg_signal{AMatrix<double>(std::vector<double>(
+      source.begin() + kLag, source.end())), 48000};
+
+  auto expected = Alignment::GloballyAlign(ref_signal, deg_signal);
+  ASSERT_EQ(kLag / 48000.0, std::get<1>(expected));
+  for (int64_t lag_hint : {kLag - 10, -static_cast<int64_t>(kNumSamples)}) {
+    auto result = Alignment::GloballyAlignAroundLag(ref_signal, deg_signal,
+                                                    lag_hint, 32);
+    ASSERT_EQ(std::get<1>(expected), std::get<1>(result));
+    ASSERT_EQ(std::get<0>(expected).data_matrix,
+              std::get<0>(result).data_matrix);
+  }
+}
+
+// Test that the fingerprint alignment finds the same lag as the full rate
+// alignment for a signal of tone bursts, whose landmarks the vote can match.
+TEST(Alignment, FingerprintMatchesFullRate) {
+  const size_t kNumSamples = 200000;
+  const int64_t kLag = 1234;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> freq(0.01, 0.4);
+  std::uniform_int_distribution<size_t> duration(800, 3000);
+  std::uniform_int_distribution<size_t> spacing(1000, 4000);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  std::vector<double> source(kNumSamples + kLag);
+  for (size_t start = 0; start < source.size(); start += spacing(gen)) {
+    const double burst_freq = freq(gen);
+    const size_t burst_duration = duration(gen);
+    for (size_t i = 0; i < burst_duration && start + i < source.size(); i++) {
+      source[start + i] += std::sin(2.0 * M_PI * burst_freq * i) *
+          (0.5 - 0.5 * std::cos(2.0 * M_PI * i / (burst_duration - 1)));
+    }
+  }
+  for (auto &sample : source) {
+    sample += noise(gen);
+  }
+  const AudioSignal ref_signal{AMatrix<double>(std::vector<double>(
+      source.begin(), source.begin() + kNumSamples)), 48000};
+  const AudioSignal deg_signal{AMatrix<double>(std::vector<double>(
+      source.begin() + kLag, source.end())), 48000};
+
+  auto expected = Alignment::GloballyAlign(ref_signal, deg_signal);
+  auto result = FingerprintAligner::GloballyAlign(ref_signal, deg_signal);
+  ASSERT_EQ(kLag / 48000.0, std::get<1>(expected));
+  ASSERT_EQ(std::get<1>(expected), std::get<1>(result));
+  ASSERT_EQ(std::get<0>(expected).data_matrix,
+            std::get<0>(result).data_matrix);
+}
+
+// Test that aligning a batch of pairs, on one or several workers, gives the
+// same views and lags as aligning each pair on its own.
+TEST(Alignment, BatchMatchesAlignAndTruncate) {
+  std::mt19937 gen(11);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  std::vector<AudioSignal> signals;
+  // Pairs of different lengths, so that their correlations take different
+  // FFT sizes.
+  for (size_t num_samples : {14, 600, 700, 2000, 650}) {
+    std::vector<double> source(num_samples + 9);
+    for (size_t i = 0; i < source.size(); i++) {
+      source[i] = noise(gen) * (1.1 + std::sin(i / 30.0));
+    }
+    signals.push_back(AudioSignal{AMatrix<double>(std::vector<double>(
+        source.begin(), source.begin() + num_samples)), 16000});
+    signals.push_back(AudioSignal{AMatrix<double>(std::vector<double>(
+        source.begin() + 9, source.end())), 16000});
+  }
+  std::vector<std::pair<AudioSignalView, AudioSignalView>> signal_pairs;
+  for (size_t i = 0; i < signals.size(); i += 2) {
+    signal_pairs.emplace_back(signals[i], signals[i + 1]);
+  }
+
+  for (bool bounded : {false, true}) {
+    for (size_t num_workers : {1, 3}) {
+      auto results = Alignment::AlignAndTruncateBatch(signal_pairs, bounded,
+                                                      num_workers);
+      ASSERT_EQ(signal_pairs.size(), results.size());
+      for (size_t i = 0; i < signal_pairs.size(); i++) {
+        auto expected = bounded ?
+            Alignment::AlignAndTruncateBounded(signal_pairs[i].first,
+                                               signal_pairs[i].second) :
+            Alignment::AlignAndTruncate(signal_pairs[i].first,
+                                        signal_pairs[i].second);
+        ASSERT_EQ(std::get<2>(expected), std::get<2>(results[i]));
+        ASSERT_EQ(std::get<0>(expected).ToVector(),
+                  std::get<0>(results[i]).ToVector());
+        ASSERT_EQ(std::get<1>(expected).ToVector(),
+                  std::get<1>(results[i]).ToVector());
+      }
+    }
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
@@ -0,0 +1,168 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "amatrix.h"
+
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+
+#include "audio_signal.h"
+#include "spectrogram.h"
+
+namespace Visqol {
+namespace {
+
+// Large enough that armadillo does not hold the elements in its local buffer.
+const size_t kNumRows = 48000;
+const size_t kNumCols = 2;
+
+// Test that moving a matrix takes its buffer rather than copying it.
+TEST(AMatrix, MoveConstructTakesBuffer) {
+  AMatrix<double> matrix = AMatrix<double>::Filled(kNumRows, kNumCols, 0.5);
+  const double *buffer = matrix.MemPtr();
+
+  AMatrix<double> moved(std::move(matrix));
+  EXPECT_EQ(buffer, moved.MemPtr());
+  EXPECT_EQ(kNumRows, moved.NumRows());
+  EXPECT_EQ(kNumCols, moved.NumCols());
+  EXPECT_EQ(0.5, moved(kNumRows - 1, kNumCols - 1));
+}
+
+// Test that move assigning a matrix takes its buffer rather than copying it.
+TEST(AMatrix, MoveAssignTakesBuffer) {
+  AMatrix<double> matrix = AMatrix<double>::Filled(kNumRows, kNumCols, 0.5);
+  const double *buffer = matrix.MemPtr();
+
+  AMatrix<double> moved = AMatrix<double>::Filled(2, 2, 0.0);
+  moved = std::move(matrix);
+  EXPECT_EQ(buffer, moved.MemPtr());
+  EXPECT_EQ(kNumRows, moved.NumRows());
+}
+
+// Test that copying a matrix still copies its buffer.
+TEST(AMatrix, CopyCopiesBuffer) {
+  const AMatrix<double> matrix = AMatrix<double>::Filled(kNumRows, kNumCols,
+                                                         0.5);
+  AMatrix<double> copied(matrix);
+  EXPECT_NE(matrix.MemPtr(), copied.MemPtr());
+  EXPECT_EQ(matrix, copied);
+}
+
+// Test that the signals and spectrograms passed along the pipeline by value
+// keep their buffers, as for the aligned signal taken out of the result of
+// the global alignment, and the matrix that a spectrogram is built from.
+TEST(AMatrix, PipelineValuesKeepBuffers) {
+  AudioSignal signal{AMatrix<double>::Filled(kNumRows, 1, 0.5), 48000};
+  const double *signal_buffer = signal.data_matrix.MemPtr();
+  std::tuple<AudioSignal, double> alignment_result =
+      std::make_tuple(std::move(signal), 0.0);
+  AudioSignal aligned_signal{AMatrix<double>(), 48000};
+  aligned_signal = std::move(std::get<0>(alignment_result));
+  EXPECT_EQ(signal_buffer, aligned_signal.data_matrix.MemPtr());
+
+  AMatrix<double> matrix = AMatrix<double>::Filled(32, kNumRows / 32, 0.5);
+  const double *matrix_buffer = matrix.MemPtr();
+  Spectrogram spectrogram(std::move(matrix));
+  EXPECT_EQ(matrix_buffer, spectrogram.Data().MemPtr());
+}
+
+// Test that a borrowed matrix reads the borrowed values in place, and that
+// neither copying it nor assigning to it writes to them. Armadillo assigns a
+// small matrix by copying its values, so that case is also tested.
+TEST(AMatrix, BorrowReadsInPlace) {
+  std::vector<double> values(kNumRows, 0.5);
+  AMatrix<double> borrowed = AMatrix<double>::Borrow(absl::MakeSpan(values));
+  EXPECT_EQ(values.data(), borrowed.MemPtr());
+  EXPECT_EQ(kNumRows, borrowed.NumRows());
+  EXPECT_EQ(1, borrowed.NumCols());
+
+  const AMatrix<double> copied(borrowed);
+  EXPECT_NE(values.data(), copied.MemPtr());
+  EXPECT_EQ(borrowed, copied);
+
+  borrowed = AMatrix<double>::Filled(kNumRows, 1, 0.25);
+  EXPECT_NE(values.data(), borrowed.MemPtr());
+  EXPECT_EQ(0.25, borrowed(0));
+  EXPECT_EQ(0.5, values[0]);
+
+  std::vector<double> small_values(4, 0.5);
+  AMatrix<double> small = AMatrix<double>::Borrow(
+      absl::MakeSpan(small_values));
+  small = AMatrix<double>::Filled(4, 1, 0.25);
+  EXPECT_EQ(0.25, small(0));
+  EXPECT_EQ(0.5, small_values[0]);
+  const AMatrix<double> small_copy = AMatrix<double>::Filled(4, 1, 0.125);
+  small = AMatrix<double>::Borrow(absl::MakeSpan(small_values));
+  small = small_copy;
+  EXPECT_EQ(0.125, small(0));
+  EXPECT_EQ(0.5, small_values[0]);
+}
+
+// Test that moving a borrowed matrix, small or large, keeps it reading the
+// borrowed values.
+TEST(AMatrix, MovedBorrowReadsInPlace) {
+  std::vector<double> values(kNumRows, 0.5);
+  AMatrix<double> moved(AMatrix<double>::Borrow(absl::MakeSpan(values)));
+  EXPECT_EQ(values.data(), moved.MemPtr());
+  AMatrix<double> assigned;
+  assigned = std::move(moved);
+  EXPECT_EQ(values.data(), assigned.MemPtr());
+  EXPECT_EQ(kNumRows, assigned.NumRows());
+
+  std::vector<double> small_values(4, 0.5);
+  AMatrix<double> small(AMatrix<double>::Borrow(
+      absl::MakeSpan(small_values)));
+  AMatrix<double> small_moved(std::move(small));
+  EXPECT_EQ(small_values.data(), small_moved.MemPtr());
+  small_moved(0) = 0.25;
+  EXPECT_EQ(0.25, small_values[0]);
+}
+
+// Test that the compound operators update the values in the buffer of the
+// matrix, and that a borrowed matrix updates the values that it borrows.
+TEST(AMatrix, CompoundOperatorsUpdateInPlace) {
+  AMatrix<double> matrix = AMatrix<double>::Filled(kNumRows, kNumCols, 0.5);
+  const AMatrix<double> other = AMatrix<double>::Filled(kNumRows, kNumCols,
+                                                        2.0);
+  const double *buffer = matrix.MemPtr();
+
+  matrix += other;
+  EXPECT_EQ(2.5, matrix(kNumRows - 1, kNumCols - 1));
+  matrix -= 0.5;
+  EXPECT_EQ(2.0, matrix(0, 0));
+  matrix *= 3.0;
+  EXPECT_EQ(6.0, matrix(0, 0));
+  matrix.PointWiseMultiplyInPlace(other);
+  EXPECT_EQ(12.0, matrix(0, 0));
+  matrix.PointWiseDivideInPlace(other);
+  EXPECT_EQ(6.0, matrix(0, 0));
+  matrix -= other;
+  EXPECT_EQ(4.0, matrix(0, 0));
+  (matrix /= 2.0) += 1.0;
+  EXPECT_EQ(3.0, matrix(kNumRows - 1, kNumCols - 1));
+  EXPECT_EQ(buffer, matrix.MemPtr());
+
+  std::vector<double> values(kNumRows, 0.5);
+  AMatrix<double> borrowed = AMatrix<double>::Borrow(absl::MakeSpan(values));
+  borrowed *= 2.0;
+  EXPECT_EQ(values.data(), borrowed.MemPtr());
+  EXPECT_EQ(1.0, values[kNumRows - 1]);
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,229 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "arrow_results_writer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+template <typename T>
+T Read(const std::string &buf, size_t pos) {
+  T value;
+  std::memcpy(&value, &buf[pos], sizeof(T));
+  return value;
+}
+
+// A table of a flatbuffer, read as the Arrow readers do.
+struct Table {
+  const std::string *buf;
+  size_t pos;
+
+  // The position of a field, or 0 if it is absent.
+  size_t Field(uint16_t id) const {
+    const size_t vtable = pos - Read<int32_t>(*buf, pos);
+    if (4u + 2u * id >= Read<uint16_t>(*buf, vtable)) {
+      return 0;
+    }
+    const uint16_t offset = Read<uint16_t>(*buf, vtable + 4 + 2 * id);
+    return offset == 0 ? 0 : pos + offset;
+  }
+
+  template <typename T>
+  T Scalar(uint16_t id) const {
+    const size_t field = Field(id);
+    return field == 0 ? T() : Read<T>(*buf, field);
+  }
+
+  // The position that an offset field points to.
+  size_t Target(uint16_t id) const {
+    const size_t field = Field(id);
+    return field + Read<uint32_t>(*buf, field);
+  }
+
+  Table Child(uint16_t id) const { return {buf, Target(id)}; }
+};
+
+// A message of an Arrow stream: the root table of its metadata, and its body.
+struct Message {
+  std::string metadata;
+  std::string body;
+  Table Root() const { return {&metadata, Read<uint32_t>(metadata, 0)}; }
+  Table Header() const { return Root().Child(2); }
+};
+
+// Reads the messages of a stream, and checks that it ends with the end of
+// stream marker.
+std::vector<Message> ReadStream(const std::string &path) {
+  std::ifstream file(path, std::ios_base::binary);
+  const std::string data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  std::vector<Message> messages;
+  size_t pos = 0;
+  while (pos + 8 <= data.size()) {
+    EXPECT_EQ(0xFFFFFFFFu, Read<uint32_t>(data, pos));
+    const uint32_t metadata_size = Read<uint32_t>(data, pos + 4);
+    if (metadata_size == 0) {
+      EXPECT_EQ(data.size(), pos + 8);
+      return messages;
+    }
+    EXPECT_EQ(0u, metadata_size % 8);
+    Message message;
+    message.metadata = data.substr(pos + 8, metadata_size);
+    const int64_t body_size = message.Root().Scalar<int64_t>(3);
+    EXPECT_EQ(0, body_size % 8);
+    message.body = data.substr(pos + 8 + metadata_size, body_size);
+    pos += 8 + metadata_size + body_size;
+    messages.push_back(std::move(message));
+  }
+  ADD_FAILURE() << "No end of stream marker";
+  return messages;
+}
+
+// The names and type ids of the fields of a schema message.
+std::vector<std::pair<std::string, int>> SchemaFields(const Message &schema) {
+  std::vector<std::pair<std::string, int>> fields;
+  const Table header = schema.Header();
+  const size_t vector = header.Target(1);
+  const uint32_t size = Read<uint32_t>(schema.metadata, vector);
+  for (size_t i = 0; i < size; i++) {
+    const size_t element = vector + 4 + 4 * i;
+    const Table field{&schema.metadata,
+                      element + Read<uint32_t>(schema.metadata, element)};
+    const size_t name = field.Target(0);
+    fields.emplace_back(
+        schema.metadata.substr(name + 4,
+                               Read<uint32_t>(schema.metadata, name)),
+        field.Scalar<uint8_t>(2));
+  }
+  return fields;
+}
+
+// The offset and length of a buffer of a record batch message.
+std::pair<int64_t, int64_t> BatchBuffer(const Message &batch, size_t index) {
+  const size_t vector = batch.Header().Target(2);
+  const size_t element = vector + 4 + 16 * index;
+  return {Read<int64_t>(batch.metadata, element),
+          Read<int64_t>(batch.metadata, element + 8)};
+}
+
+SimilarityResultMsg MakeResult(const std::string &degraded, double moslqo) {
+  SimilarityResultMsg sim_res_msg;
+  sim_res_msg.set_reference_filepath("ref.wav");
+  sim_res_msg.set_degraded_filepath(degraded);
+  sim_res_msg.set_moslqo(moslqo);
+  sim_res_msg.set_vnsim(0.25);
+  sim_res_msg.add_fvnsim(0.5);
+  sim_res_msg.add_fvnsim(0.75);
+  return sim_res_msg;
+}
+
+// Ensure that the schema is written with the first result, and the rows are
+// written in record batches of the given size, in order.
+TEST(ArrowResultsWriterTest, WritesSchemaAndBatches) {
+  const std::string path = ::testing::TempDir() + "/results.arrows";
+  {
+    ArrowResultsWriter writer(FilePath(path), 2);
+    ASSERT_TRUE(writer.ok());
+    writer.Append(MakeResult("a.wav", 4.5));
+    writer.Append(MakeResult("bb.wav", 3.5));
+    SimilarityResultMsg one_band = MakeResult("ccc.wav", 2.5);
+    one_band.mutable_fvnsim()->RemoveLast();
+    writer.Append(one_band);
+  }
+
+  const std::vector<Message> messages = ReadStream(path);
+  ASSERT_EQ(3u, messages.size());
+  EXPECT_EQ(1, messages[0].Root().Scalar<uint8_t>(1));
+  const std::vector<std::pair<std::string, int>> expected_fields = {
+      {"reference", 5}, {"degraded", 5}, {"moslqo", 3},
+      {"vnsim", 3}, {"fvnsim0", 3}, {"fvnsim1", 3}};
+  EXPECT_EQ(expected_fields, SchemaFields(messages[0]));
+
+  const Message &first = messages[1];
+  EXPECT_EQ(3, first.Root().Scalar<uint8_t>(1));
+  EXPECT_EQ(2, first.Header().Scalar<int64_t>(0));
+  // The characters of the degraded column, then the moslqo values.
+  const auto degraded_chars = BatchBuffer(first, 5);
+  EXPECT_EQ("a.wavbb.wav",
+            first.body.substr(degraded_chars.first, degraded_chars.second));
+  const auto moslqo = BatchBuffer(first, 7);
+  ASSERT_EQ(16, moslqo.second);
+  EXPECT_EQ(4.5, Read<double>(first.body, moslqo.first));
+  EXPECT_EQ(3.5, Read<double>(first.body, moslqo.first + 8));
+  for (size_t i = 0; i < 14; i++) {
+    EXPECT_EQ(0, BatchBuffer(first, i).first % 8);
+  }
+
+  const Message &second = messages[2];
+  EXPECT_EQ(1, second.Header().Scalar<int64_t>(0));
+  const auto fvnsim1 = BatchBuffer(second, 13);
+  ASSERT_EQ(8, fvnsim1.second);
+  EXPECT_TRUE(std::isnan(Read<double>(second.body, fvnsim1.first)));
+}
+
+// Ensure that the stage timings and memory usage are written as columns if
+// the first result has them.
+TEST(ArrowResultsWriterTest, WritesTimingColumns) {
+  const std::string path = ::testing::TempDir() + "/timings.arrows";
+  {
+    ArrowResultsWriter writer{FilePath(path)};
+    SimilarityResultMsg sim_res_msg = MakeResult("a.wav", 4.5);
+    sim_res_msg.mutable_timings()->set_coarse_search(0.125);
+    sim_res_msg.mutable_timings()->set_peak_rss_kb(2048);
+    writer.Append(sim_res_msg);
+  }
+
+  const std::vector<Message> messages = ReadStream(path);
+  ASSERT_EQ(2u, messages.size());
+  const auto fields = SchemaFields(messages[0]);
+  ASSERT_EQ(6u + 9u + 3u, fields.size());
+  EXPECT_EQ("load_sec", fields[6].first);
+  EXPECT_EQ(3, fields[6].second);
+  EXPECT_EQ("coarse_search_sec", fields[12].first);
+  EXPECT_EQ("peak_rss_kb", fields[17].first);
+  EXPECT_EQ(2, fields[17].second);
+
+  // Two buffers for each of the 16 numeric columns after the strings.
+  const Message &batch = messages[1];
+  const auto coarse_search = BatchBuffer(batch, 6 + 2 * 10 + 1);
+  EXPECT_EQ(0.125, Read<double>(batch.body, coarse_search.first));
+  const auto peak_rss_kb = BatchBuffer(batch, 6 + 2 * 15 + 1);
+  EXPECT_EQ(2048u, Read<uint64_t>(batch.body, peak_rss_kb.first));
+}
+
+// Ensure that nothing is written without a result, as there is no schema.
+TEST(ArrowResultsWriterTest, EmptyWithoutResults) {
+  const std::string path = ::testing::TempDir() + "/empty.arrows";
+  {
+    ArrowResultsWriter writer{FilePath(path)};
+  }
+  std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
+  EXPECT_EQ(0, file.tellg());
+}
+}  // namespace
+}  // namespace Visqol
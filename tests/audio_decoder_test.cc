@@ -0,0 +1,142 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "audio_decoder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "misc_audio.h"
+
+namespace Visqol {
+namespace {
+
+const size_t kSampleRate = 16000;
+const size_t kNumFrames = 5;
+
+// The sample of a channel in a frame of the fake decoder's signal.
+double SampleOf(size_t frame, size_t channel) {
+  return 0.1 * frame + (channel == 0 ? 0.0 : 0.05);
+}
+
+// Decodes any file to a stereo signal of kNumFrames frames. Files that
+// declare their length are decoded in two blocks.
+class FakeDecoder : public AudioDecoder {
+ public:
+  explicit FakeDecoder(bool declares_length)
+      : declares_length_(declares_length) {}
+
+  AudioSignal Decode(const FilePath &path, bool downmix) const override {
+    DecodedSignalBuilder builder(2, declares_length_ ? kNumFrames : 0,
+                                 downmix);
+    builder.Append(2, SampleOf);
+    builder.Append(kNumFrames - 2, [](size_t frame, size_t channel) {
+      return SampleOf(frame + 2, channel);
+    });
+    return builder.Build(kSampleRate, path);
+  }
+
+ private:
+  bool declares_length_;
+};
+
+const bool kRegistered = AudioDecoderRegistry::Register(
+    "fake", absl::make_unique<FakeDecoder>(true));
+const bool kRegisteredUndeclared = AudioDecoderRegistry::Register(
+    "fakeraw", absl::make_unique<FakeDecoder>(false));
+
+// Ensure that decoders are found by the extension of a file, whatever its
+// case, and that WAV files and files without an extension have none.
+TEST(AudioDecoderRegistry, FindsDecodersByExtension) {
+  ASSERT_TRUE(kRegistered);
+  ASSERT_TRUE(kRegisteredUndeclared);
+  EXPECT_NE(nullptr, AudioDecoderRegistry::Find(FilePath("a/b.fake")));
+  EXPECT_NE(nullptr, AudioDecoderRegistry::Find(FilePath("a/b.FAKE")));
+  EXPECT_EQ(nullptr, AudioDecoderRegistry::Find(FilePath("a/b.wav")));
+  EXPECT_EQ(nullptr, AudioDecoderRegistry::Find(FilePath("a/b")));
+  EXPECT_EQ(nullptr, AudioDecoderRegistry::Find(FilePath("a.fake/b")));
+
+  const std::vector<std::string> extensions =
+      AudioDecoderRegistry::Extensions();
+  EXPECT_NE(extensions.end(),
+            std::find(extensions.begin(), extensions.end(), "fake"));
+}
+
+// Ensure that an extension that is taken, and the WAV extension, are not
+// registered again.
+TEST(AudioDecoderRegistry, RejectsTakenExtensions) {
+  EXPECT_FALSE(AudioDecoderRegistry::Register(
+      "FAKE", absl::make_unique<FakeDecoder>(true)));
+  EXPECT_FALSE(AudioDecoderRegistry::Register(
+      "wav", absl::make_unique<FakeDecoder>(true)));
+}
+
+// Ensure that loading a file of a registered extension decodes it, as mono
+// or with its channels, whether or not it declares its length.
+TEST(AudioDecoderRegistry, LoadsDecodedFiles) {
+  for (const std::string path : {"signal.fake", "signal.fakeraw"}) {
+    const AudioSignal mono = MiscAudio::LoadAsMono(FilePath(path));
+    EXPECT_EQ(kSampleRate, mono.sample_rate);
+    ASSERT_EQ(kNumFrames, mono.data_matrix.NumRows());
+    ASSERT_EQ(1, mono.data_matrix.NumCols());
+    for (size_t frame = 0; frame < kNumFrames; frame++) {
+      EXPECT_DOUBLE_EQ((SampleOf(frame, 0) + SampleOf(frame, 1)) / 2,
+                       mono.data_matrix(frame, 0));
+    }
+
+    const AudioSignal channels = MiscAudio::LoadChannels(FilePath(path));
+    ASSERT_EQ(kNumFrames, channels.data_matrix.NumRows());
+    ASSERT_EQ(2, channels.data_matrix.NumCols());
+    for (size_t frame = 0; frame < kNumFrames; frame++) {
+      EXPECT_EQ(SampleOf(frame, 0), channels.data_matrix(frame, 0));
+      EXPECT_EQ(SampleOf(frame, 1), channels.data_matrix(frame, 1));
+    }
+  }
+}
+
+// Ensure that the frames past the declared length are dropped, and that the
+// declared frames that are not decoded are silent.
+TEST(DecodedSignalBuilder, KeepsTheDeclaredLength) {
+  DecodedSignalBuilder long_builder(1, 3, false);
+  long_builder.Append(kNumFrames, SampleOf);
+  const AudioSignal long_signal = long_builder.Build(kSampleRate,
+                                                     FilePath("long.fake"));
+  ASSERT_EQ(3, long_signal.data_matrix.NumRows());
+  EXPECT_EQ(SampleOf(2, 0), long_signal.data_matrix(2, 0));
+
+  DecodedSignalBuilder short_builder(1, 8, false);
+  short_builder.Append(kNumFrames, SampleOf);
+  const AudioSignal short_signal = short_builder.Build(kSampleRate,
+                                                       FilePath("short.fake"));
+  ASSERT_EQ(8, short_signal.data_matrix.NumRows());
+  EXPECT_EQ(SampleOf(kNumFrames - 1, 0),
+            short_signal.data_matrix(kNumFrames - 1, 0));
+  EXPECT_EQ(0.0, short_signal.data_matrix(7, 0));
+
+  DecodedSignalBuilder empty_builder(2, 0, true);
+  const AudioSignal empty_signal = empty_builder.Build(kSampleRate,
+                                                       FilePath("empty.fake"));
+  EXPECT_EQ(0, empty_signal.data_matrix.NumElements());
+}
+
+}  // namespace
+}  // namespace Visqol
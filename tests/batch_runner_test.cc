@@ -0,0 +1,134 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "batch_runner.h"
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "conformance.h"
+#include "file_path.h"
+#include "pair_source.h"
+#include "similarity_result.pb.h"
+#include "visqol_config.pb.h"
+
+namespace Visqol {
+namespace {
+
+const double kTolerance = .00001;
+
+const char kGlockRef[] =
+    "testdata/conformance_testdata_subset/glock48_stereo.wav";
+const char kGlockDeg[] =
+    "testdata/conformance_testdata_subset/glock48_stereo_48kbps_aac.wav";
+const char kGuitarRef[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo.wav";
+const char kGuitarDeg[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav";
+
+// Ensure that a batch run on several threads gives the conformance scores in
+// the order of the pairs, including a pair that fails to load. The longer
+// guitar pairs are compared before the glock pairs.
+TEST(BatchRunnerTest, ThreadedResultsAreOrdered) {
+  const FilePath model(FilePath::currentWorkingDir() +
+                       "/model/libsvm_nu_svr_model.txt");
+  const std::vector<ReferenceDegradedPathPair> pairs = {
+      {FilePath(kGlockRef), FilePath(kGlockDeg)},
+      {FilePath(kGuitarRef), FilePath(kGuitarDeg)},
+      {FilePath(kGuitarRef), FilePath("does_not_exist.wav")},
+      {FilePath(kGuitarRef), FilePath(kGuitarDeg)},
+      {FilePath(kGlockRef), FilePath(kGlockDeg)},
+  };
+  const std::vector<double> expected = {
+      kConformanceGlock48aac, kConformanceGuitar64aac,
+      kConformanceGuitar64aac, kConformanceGlock48aac};
+
+  for (const size_t num_threads : {1, 3}) {
+    const auto results_or = BatchRunner::Run(model,
+        VisqolConfig::VisqolOptions(), pairs, num_threads, true);
+    ASSERT_TRUE(results_or.ok());
+    const auto &results = results_or.ValueOrDie();
+    ASSERT_EQ(expected.size(), results.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], results[i].moslqo(), kTolerance);
+    }
+    EXPECT_EQ(kGuitarRef, results[2].reference_filepath());
+    EXPECT_EQ(kGlockRef, results[3].reference_filepath());
+  }
+}
+
+// A source of the pairs of a vector.
+class VectorPairSource : public PairSource {
+ public:
+  explicit VectorPairSource(const std::vector<ReferenceDegradedPathPair> &pairs)
+      : pairs_(pairs) {}
+
+  bool Next(ReferenceDegradedPathPair *pair) override {
+    if (next_ == pairs_.size()) {
+      return false;
+    }
+    *pair = pairs_[next_++];
+    return true;
+  }
+
+ private:
+  const std::vector<ReferenceDegradedPathPair> &pairs_;
+  size_t next_ = 0;
+};
+
+// Ensure that the pairs of a source are indexed in the order that they are
+// discovered, and give the conformance scores, on one or several threads.
+TEST(BatchRunnerTest, StreamFromIndexesPairsInOrder) {
+  const FilePath model(FilePath::currentWorkingDir() +
+                       "/model/libsvm_nu_svr_model.txt");
+  const std::vector<ReferenceDegradedPathPair> pairs = {
+      {FilePath(kGlockRef), FilePath(kGlockDeg)},
+      {FilePath(kGuitarRef), FilePath("does_not_exist.wav")},
+      {FilePath(kGuitarRef), FilePath(kGuitarDeg)},
+  };
+  const std::vector<double> expected = {
+      kConformanceGlock48aac, 0.0, kConformanceGuitar64aac};
+
+  for (const size_t num_threads : {1, 3}) {
+    VectorPairSource source(pairs);
+    std::mutex mutex;
+    std::vector<double> moslqos(pairs.size(), -1.0);
+    const auto status = BatchRunner::StreamFrom(model,
+        VisqolConfig::VisqolOptions(), &source, num_threads,
+        [&](size_t i, google::protobuf::util::StatusOr<SimilarityResultMsg>
+                &&status_or) {
+          std::lock_guard<std::mutex> lock(mutex);
+          ASSERT_LT(i, moslqos.size());
+          moslqos[i] = status_or.ok() ? status_or.ValueOrDie().moslqo() : 0.0;
+        });
+    ASSERT_TRUE(status.ok());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], moslqos[i], kTolerance);
+    }
+  }
+}
+
+// Ensure that a model that cannot be loaded fails the batch.
+TEST(BatchRunnerTest, InitErrorFailsBatch) {
+  const std::vector<ReferenceDegradedPathPair> pairs = {
+      {FilePath(kGlockRef), FilePath(kGlockDeg)}};
+  const auto results_or = BatchRunner::Run(FilePath("does_not_exist.txt"),
+      VisqolConfig::VisqolOptions(), pairs, 2);
+  EXPECT_FALSE(results_or.ok());
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,93 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "batch_sharder.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+const char kCleanSpeech[] = "/testdata/clean_speech/CA01_01.wav";
+
+std::vector<ReferenceDegradedPathPair> MakePairs(
+    const std::vector<std::string> &references) {
+  std::vector<ReferenceDegradedPathPair> pairs;
+  for (size_t i = 0; i < references.size(); i++) {
+    pairs.push_back({FilePath(references[i]),
+                     FilePath("deg" + std::to_string(i))});
+  }
+  return pairs;
+}
+
+// Ensure that the costliest groups are spread over the shards, with the
+// cheaper groups filling up the least loaded shards.
+TEST(BatchSharderTest, BalancesShardsByCost) {
+  const auto pairs = MakePairs({"a", "b", "c", "d", "e"});
+  const std::vector<double> costs = {10.0, 1.0, 6.0, 4.0, 3.0};
+  const std::vector<size_t> expected = {0, 1, 1, 1, 0};
+  EXPECT_EQ(expected, BatchSharder::AssignShards(pairs, costs, 2));
+}
+
+// Ensure that consecutive pairs with the same reference stay on one shard, up
+// to the group size limit.
+TEST(BatchSharderTest, KeepsReferenceRunsTogether) {
+  std::vector<std::string> references(BatchSharder::kMaxPairsPerGroup + 1,
+                                      "a");
+  references.push_back("b");
+  const auto pairs = MakePairs(references);
+  const std::vector<double> costs(pairs.size(), 1.0);
+  const auto shards = BatchSharder::AssignShards(pairs, costs, 3);
+  for (size_t i = 1; i < BatchSharder::kMaxPairsPerGroup; i++) {
+    EXPECT_EQ(shards[0], shards[i]);
+  }
+  // The pair past the limit starts a group of its own.
+  EXPECT_NE(shards[0], shards[BatchSharder::kMaxPairsPerGroup]);
+}
+
+// Ensure that the shards of a batch cover every pair exactly once, in batch
+// order, with the costs read from the file headers.
+TEST(BatchSharderTest, ShardsPartitionBatch) {
+  const std::string speech = FilePath::currentWorkingDir() + kCleanSpeech;
+  const auto pairs = MakePairs({speech, "missing", speech, "missing2",
+                                "missing3"});
+  const auto costs = BatchSharder::EstimatePairCosts(pairs, 2);
+  EXPECT_GT(costs[0], 0.0);
+  EXPECT_EQ(costs[0], costs[2]);
+  EXPECT_EQ(0.0, costs[1]);
+
+  std::vector<size_t> num_selected(pairs.size(), 0);
+  for (size_t shard = 0; shard < 3; shard++) {
+    const auto selected = BatchSharder::SelectShard(pairs, shard, 3, 1);
+    size_t next = 0;
+    for (const auto &pair : selected) {
+      while (next < pairs.size() &&
+             pairs[next].degraded.Path() != pair.degraded.Path()) {
+        next++;
+      }
+      ASSERT_LT(next, pairs.size());
+      num_selected[next]++;
+    }
+  }
+  EXPECT_EQ(std::vector<size_t>(pairs.size(), 1), num_selected);
+  EXPECT_EQ(pairs.size(), BatchSharder::SelectShard(pairs, 0, 1, 1).size());
+}
+
+}  // namespace
+}  // namespace Visqol
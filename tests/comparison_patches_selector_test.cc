@@ -15,9 +15,16 @@
 #include "comparison_patches_selector.h"
 
 #include <random>
+#include <utility>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "gtest/gtest.h"
 
+#include "image_patch_creator.h"
+#include "neurogram_similiarity_index_measure.h"
+#include "patch_view.h"
+
 namespace Visqol {
 
 class ComparisonPatchesSelectorPeer {
@@ -30,7 +37,7 @@ class ComparisonPatchesSelectorPeer {
     return cps_->CalcMaxNumPatches(ref_patch_indices, max_slide_offset,
         num_frames);
   }
-  static AudioSignal Slice(
+  static AudioSignalView Slice(
       const AudioSignal &in_signal, double start_time, double end_time) {
     return ComparisonPatchesSelector::Slice(in_signal, start_time, end_time);
   }
@@ -67,6 +74,16 @@ TEST_F(ComparisonPatchesSelectorTest, EndPatches) {
   EXPECT_EQ(patchIndices.size() - 1, acceptedNumPatches);
 }
 
+TEST_F(ComparisonPatchesSelectorTest, SearchedColumns) {
+  // The degraded patches of each reference patch start within half a patch of
+  // it, and the overlapping ranges of nearby patches are merged.
+  const SpectrogramColumnRanges columns =
+      ComparisonPatchesSelector::SearchedColumns({10, 40, 200}, 20);
+  const SpectrogramColumnRanges expected{{0, 70}, {190, 230}};
+  EXPECT_EQ(expected, columns);
+  EXPECT_TRUE(ComparisonPatchesSelector::SearchedColumns({}, 20).empty());
+}
+
 TEST_F(ComparisonPatchesSelectorTest, Slice) {
   auto silence_matrix = AMatrix<double>::Filled(16000 * 3, 1, 0.0);
   // Add an impulse at 1.0 secs
@@ -75,15 +92,322 @@ TEST_F(ComparisonPatchesSelectorTest, Slice) {
   silence_matrix.SetRow(16000, impulse_vec);
   AudioSignal three_seconds_silence{silence_matrix, 16000};
 
-  AudioSignal sliced_signal = ComparisonPatchesSelectorPeer::Slice(
+  AudioSignalView sliced_signal = ComparisonPatchesSelectorPeer::Slice(
       three_seconds_silence, 0.5, 2.5);
 
   EXPECT_EQ(sliced_signal.GetDuration(), 2.0);
 
   // Check that the impulse moved to .5 secs.
-  EXPECT_EQ(sliced_signal.data_matrix(7999, 0), 0.0);
-  EXPECT_EQ(sliced_signal.data_matrix(8000, 0), 1.0);
-  EXPECT_EQ(sliced_signal.data_matrix(8001, 0), 0.0);
+  EXPECT_EQ(sliced_signal[7999], 0.0);
+  EXPECT_EQ(sliced_signal[8000], 1.0);
+  EXPECT_EQ(sliced_signal[8001], 0.0);
+}
+
+// A slice that starts before the signal is preceded by silence, and its
+// silence does not reveal the samples outside of the slice when it is shifted
+// further.
+TEST_F(ComparisonPatchesSelectorTest, SliceWithLeadingSilence) {
+  std::vector<double> ramp(16000);
+  for (size_t i = 0; i < ramp.size(); i++) {
+    ramp[i] = i + 1.0;
+  }
+  AudioSignal ramp_signal{AMatrix<double>(ramp), 16000};
+
+  AudioSignalView sliced_signal = ComparisonPatchesSelectorPeer::Slice(
+      ramp_signal, -0.25, 0.5);
+  EXPECT_EQ(sliced_signal.NumSamples(), 4000u + 8000u);
+  EXPECT_EQ(sliced_signal[3999], 0.0);
+  EXPECT_EQ(sliced_signal[4000], 1.0);
+  EXPECT_EQ(sliced_signal[11999], 8000.0);
+
+  // Shifting the slice past its end reads silence, not the rest of the ramp.
+  AudioSignalView shifted = sliced_signal.SubView(4000, 12000);
+  EXPECT_EQ(shifted[7999], 8000.0);
+  EXPECT_EQ(shifted[8000], 0.0);
+  EXPECT_EQ(shifted.ToAudioSignal().data_matrix.NumRows(), 12000u);
+}
+
+// Ensure that the sliding NSIM comparator gives the same results as comparing
+// each degraded patch, including the patches that extend past either end of
+// the degraded spectrogram.
+TEST_F(ComparisonPatchesSelectorTest, SlidingNsimMatchesPatchNsim) {
+  const size_t num_rows = 32;
+  const size_t num_cols = 40;
+  const size_t patch_size = 20;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(num_rows, num_cols);
+  AMatrix<double> deg_spectro(num_rows, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_spectro(r, c) = dist(gen);
+      deg_spectro(r, c) = 0.7 * ref_spectro(r, c) + 0.3 * dist(gen);
+    }
+  }
+  const PatchView ref_patch(ref_spectro, 10, patch_size);
+
+  NeurogramSimiliarityIndexMeasure nsim;
+  const auto sliding = nsim.CreateSlidingComparator(deg_spectro);
+  ASSERT_NE(nullptr, sliding);
+  const int first_offset = -static_cast<int>(patch_size / 2);
+  const int last_offset = num_cols - 1;
+  const auto results = sliding->MeasureSlidingPatchSimilarity(ref_patch,
+      first_offset, last_offset);
+  ASSERT_EQ(last_offset - first_offset + 1, results.size());
+
+  for (int offset = first_offset; offset <= last_offset; offset++) {
+    const PatchView deg_patch(deg_spectro, offset, patch_size);
+    const auto expected = nsim.MeasurePatchSimilarity(ref_patch, deg_patch);
+    const auto &result = results[offset - first_offset];
+    EXPECT_NEAR(expected.similarity, result.similarity, 1e-12);
+    ASSERT_EQ(expected.freq_band_means.NumRows(),
+              result.freq_band_means.NumRows());
+    for (size_t r = 0; r < num_rows; r++) {
+      EXPECT_NEAR(expected.freq_band_means(r), result.freq_band_means(r),
+                  1e-12);
+    }
+  }
+
+  EXPECT_TRUE(sliding->MeasureSlidingPatchSimilarity(ref_patch, 5, 4).empty());
+}
+
+// Ensure that the single precision sliding NSIM comparator stays close to the
+// double precision one.
+TEST_F(ComparisonPatchesSelectorTest, FloatSlidingNsimMatchesDouble) {
+  const size_t num_rows = 32;
+  const size_t num_cols = 40;
+  const size_t patch_size = 20;
+  std::mt19937 gen(19);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(num_rows, num_cols);
+  AMatrix<double> deg_spectro(num_rows, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_spectro(r, c) = dist(gen);
+      deg_spectro(r, c) = 0.7 * ref_spectro(r, c) + 0.3 * dist(gen);
+    }
+  }
+  const PatchView ref_patch(ref_spectro, 10, patch_size);
+
+  const NeurogramSimiliarityIndexMeasure double_nsim;
+  const NeurogramSimiliarityIndexMeasure float_nsim(true);
+  const auto double_sliding = double_nsim.CreateSlidingComparator(deg_spectro);
+  const auto float_sliding = float_nsim.CreateSlidingComparator(deg_spectro);
+  const auto double_results = double_sliding->MeasureSlidingPatchSimilarity(
+      ref_patch, -10, 30);
+  const auto float_results = float_sliding->MeasureSlidingPatchSimilarity(
+      ref_patch, -10, 30);
+  ASSERT_EQ(double_results.size(), float_results.size());
+  for (size_t i = 0; i < double_results.size(); i++) {
+    EXPECT_NEAR(double_results[i].similarity, float_results[i].similarity,
+                1e-5);
+  }
+}
+
+// Ensure that the batch NSIM measure gives the same results as measuring each
+// degraded patch in turn.
+TEST_F(ComparisonPatchesSelectorTest, BatchNsimMatchesPatchNsim) {
+  const size_t num_rows = 32;
+  const size_t num_cols = 40;
+  const size_t patch_size = 20;
+  std::mt19937 gen(17);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(num_rows, num_cols);
+  AMatrix<double> deg_spectro(num_rows, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_spectro(r, c) = dist(gen);
+      deg_spectro(r, c) = 0.5 * ref_spectro(r, c) + 0.5 * dist(gen);
+    }
+  }
+  const PatchView ref_patch(ref_spectro, 10, patch_size);
+  std::vector<PatchView> deg_patches;
+  for (int offset = -5; offset < 30; offset += 3) {
+    deg_patches.emplace_back(deg_spectro, offset, patch_size);
+  }
+
+  NeurogramSimiliarityIndexMeasure nsim;
+  const auto results = nsim.MeasurePatchSimilarities(ref_patch, deg_patches);
+  ASSERT_EQ(deg_patches.size(), results.size());
+  for (size_t i = 0; i < deg_patches.size(); i++) {
+    const auto expected = nsim.MeasurePatchSimilarity(ref_patch,
+                                                      deg_patches[i]);
+    EXPECT_NEAR(expected.similarity, results[i].similarity, 1e-12);
+    for (size_t r = 0; r < num_rows; r++) {
+      EXPECT_NEAR(expected.freq_band_means(r), results[i].freq_band_means(r),
+                  1e-12);
+    }
+  }
+  EXPECT_TRUE(nsim.MeasurePatchSimilarities(ref_patch, {}).empty());
+}
+
+// Ensure that the NSIM loops that are specialized for the patch shapes of the
+// audio and speech modes give exactly the same results as the loops that read
+// the shape from the patches.
+TEST_F(ComparisonPatchesSelectorTest, SpecializedNsimMatchesDynamic) {
+  const size_t num_cols = 60;
+  const std::vector<std::pair<size_t, size_t>> shapes{{32, 30}, {21, 20}};
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  for (const auto &shape : shapes) {
+    const size_t num_rows = shape.first;
+    const size_t patch_size = shape.second;
+    const NsimPatchShape patch_shape = NsimPatchShapeOf(num_rows, patch_size);
+    ASSERT_NE(NsimPatchShape::kDynamic, patch_shape);
+    AMatrix<double> ref_spectro(num_rows, num_cols);
+    AMatrix<double> deg_spectro(num_rows, num_cols);
+    for (size_t c = 0; c < num_cols; c++) {
+      for (size_t r = 0; r < num_rows; r++) {
+        ref_spectro(r, c) = dist(gen);
+        deg_spectro(r, c) = 0.6 * ref_spectro(r, c) + 0.4 * dist(gen);
+      }
+    }
+    const PatchView ref_patch(ref_spectro, 10, patch_size);
+    std::vector<PatchView> deg_patches;
+    for (int offset = -5; offset < 50; offset += 7) {
+      deg_patches.emplace_back(deg_spectro, offset, patch_size);
+    }
+
+    for (const bool use_float_search : {false, true}) {
+      const NeurogramSimiliarityIndexMeasure dynamic_nsim(use_float_search);
+      const NeurogramSimiliarityIndexMeasure specialized_nsim(use_float_search,
+                                                              patch_shape);
+      const auto expected = dynamic_nsim.MeasurePatchSimilarities(ref_patch,
+                                                                  deg_patches);
+      const auto results = specialized_nsim.MeasurePatchSimilarities(
+          ref_patch, deg_patches);
+      ASSERT_EQ(expected.size(), results.size());
+      for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i].similarity, results[i].similarity);
+        EXPECT_EQ(expected[i].freq_band_means, results[i].freq_band_means);
+        EXPECT_EQ(dynamic_nsim.MeasurePatchSimilarity(ref_patch,
+                                                      deg_patches[i])
+                      .similarity,
+                  specialized_nsim.MeasurePatchSimilarity(ref_patch,
+                                                          deg_patches[i])
+                      .similarity);
+      }
+
+      const auto dynamic_sliding = dynamic_nsim.CreateSlidingComparator(
+          deg_spectro, patch_size);
+      const auto specialized_sliding = specialized_nsim.CreateSlidingComparator(
+          deg_spectro, patch_size);
+      const auto expected_sliding =
+          dynamic_sliding->MeasureSlidingPatchSimilarity(ref_patch, -10, 50);
+      const auto sliding_results =
+          specialized_sliding->MeasureSlidingPatchSimilarity(ref_patch, -10,
+                                                             50);
+      ASSERT_EQ(expected_sliding.size(), sliding_results.size());
+      for (size_t i = 0; i < expected_sliding.size(); i++) {
+        EXPECT_EQ(expected_sliding[i].similarity,
+                  sliding_results[i].similarity);
+      }
+    }
+  }
+  EXPECT_EQ(NsimPatchShape::kDynamic, NsimPatchShapeOf(32, 20));
+}
+
+// Ensure that searching the patches on several workers gives the same results
+// as searching them on the calling thread.
+TEST_F(ComparisonPatchesSelectorTest, ParallelSearchMatchesSerial) {
+  const size_t num_rows = 32;
+  const size_t num_cols = 200;
+  const size_t patch_size = 20;
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(num_rows, num_cols);
+  AMatrix<double> deg_spectro(num_rows, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_spectro(r, c) = dist(gen);
+    }
+  }
+  // The degraded spectrogram lags the reference by 3 frames.
+  for (size_t c = 3; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      deg_spectro(r, c) = ref_spectro(r, c - 3) + 0.1 * dist(gen);
+    }
+  }
+  ImagePatchCreator patch_creator(patch_size);
+  const std::vector<size_t> indices{9, 29, 49, 69, 89, 109, 129, 149, 169};
+  const auto ref_patches = patch_creator.CreatePatchesFromIndices(ref_spectro,
+                                                                  indices);
+  const double frame_duration = 0.01;
+
+  ComparisonPatchesSelector serial(
+      absl::make_unique<NeurogramSimiliarityIndexMeasure>());
+  ComparisonPatchesSelector parallel(
+      absl::make_unique<NeurogramSimiliarityIndexMeasure>(), 4);
+  const auto serial_result = serial.FindMostSimilarDegPatches(ref_patches,
+      indices, deg_spectro, frame_duration);
+  const auto parallel_result = parallel.FindMostSimilarDegPatches(ref_patches,
+      indices, deg_spectro, frame_duration);
+  ASSERT_TRUE(serial_result.ok());
+  ASSERT_TRUE(parallel_result.ok());
+  const auto &serial_patches = serial_result.ValueOrDie();
+  const auto &parallel_patches = parallel_result.ValueOrDie();
+  ASSERT_EQ(indices.size(), serial_patches.size());
+  ASSERT_EQ(serial_patches.size(), parallel_patches.size());
+  for (size_t i = 0; i < serial_patches.size(); i++) {
+    EXPECT_EQ(serial_patches[i].similarity, parallel_patches[i].similarity);
+    EXPECT_EQ(serial_patches[i].ref_patch_start_time,
+              parallel_patches[i].ref_patch_start_time);
+    EXPECT_EQ(serial_patches[i].deg_patch_start_time,
+              parallel_patches[i].deg_patch_start_time);
+    // The lag is found by the search.
+    EXPECT_NEAR(serial_patches[i].ref_patch_start_time + 3 * frame_duration,
+                serial_patches[i].deg_patch_start_time, 1e-9);
+  }
+}
+
+// Ensure that the coarse to fine search finds the same patches as the
+// exhaustive search when the lag falls between the coarse offsets.
+TEST_F(ComparisonPatchesSelectorTest, CoarseToFineMatchesExhaustive) {
+  const size_t num_rows = 32;
+  const size_t num_cols = 200;
+  const size_t patch_size = 20;
+  const size_t lag = 6;
+  std::mt19937 gen(13);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(num_rows, num_cols);
+  AMatrix<double> deg_spectro(num_rows, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      ref_spectro(r, c) = dist(gen);
+    }
+  }
+  for (size_t c = lag; c < num_cols; c++) {
+    for (size_t r = 0; r < num_rows; r++) {
+      deg_spectro(r, c) = ref_spectro(r, c - lag) + 0.1 * dist(gen);
+    }
+  }
+  ImagePatchCreator patch_creator(patch_size);
+  const std::vector<size_t> indices{9, 29, 49, 69, 89, 109, 129, 149, 169};
+  const auto ref_patches = patch_creator.CreatePatchesFromIndices(ref_spectro,
+                                                                  indices);
+  const double frame_duration = 0.01;
+
+  ComparisonPatchesSelector exhaustive(
+      absl::make_unique<NeurogramSimiliarityIndexMeasure>());
+  ComparisonPatchesSelector coarse_to_fine(
+      absl::make_unique<NeurogramSimiliarityIndexMeasure>(), 1,
+      ComparisonPatchesSelector::SearchStrategy::kCoarseToFine);
+  const auto exhaustive_result = exhaustive.FindMostSimilarDegPatches(
+      ref_patches, indices, deg_spectro, frame_duration);
+  const auto coarse_result = coarse_to_fine.FindMostSimilarDegPatches(
+      ref_patches, indices, deg_spectro, frame_duration);
+  ASSERT_TRUE(exhaustive_result.ok());
+  ASSERT_TRUE(coarse_result.ok());
+  const auto &exhaustive_patches = exhaustive_result.ValueOrDie();
+  const auto &coarse_patches = coarse_result.ValueOrDie();
+  ASSERT_EQ(exhaustive_patches.size(), coarse_patches.size());
+  for (size_t i = 0; i < coarse_patches.size(); i++) {
+    EXPECT_EQ(exhaustive_patches[i].similarity, coarse_patches[i].similarity);
+    EXPECT_EQ(exhaustive_patches[i].deg_patch_start_time,
+              coarse_patches[i].deg_patch_start_time);
+    EXPECT_NEAR(coarse_patches[i].ref_patch_start_time + lag * frame_duration,
+                coarse_patches[i].deg_patch_start_time, 1e-9);
+  }
 }
 
 }  // namespace
@@ -0,0 +1,129 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "compute_backend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "gammatone_filterbank.h"
+#include "gammatone_spectrogram_builder.h"
+#include "neurogram_similiarity_index_measure.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+#include "visqol_manager.h"
+
+namespace Visqol {
+namespace {
+
+const char kRefPath[] = "testdata/clean_speech/CA01_01.wav";
+const char kDegPath[] = "testdata/clean_speech/transcoded_CA01_01.wav";
+
+// The number of spectrograms and sliding comparators that the counting
+// backend has created.
+std::atomic<int> num_builds{0};
+std::atomic<int> num_sliding_comparators{0};
+
+// A spectrogram builder that counts its builds, and builds them on the CPU.
+class CountingSpectrogramBuilder : public GammatoneSpectrogramBuilder {
+ public:
+  using GammatoneSpectrogramBuilder::GammatoneSpectrogramBuilder;
+
+  google::protobuf::util::StatusOr<Spectrogram> Build(
+      const AudioSignalView &signal, const AnalysisWindow &window,
+      VisqolWorkspace *workspace) const override {
+    num_builds++;
+    return GammatoneSpectrogramBuilder::Build(signal, window, workspace);
+  }
+};
+
+// An NSIM comparator that counts the degraded spectrograms that it searches.
+class CountingComparator : public NeurogramSimiliarityIndexMeasure {
+ public:
+  using NeurogramSimiliarityIndexMeasure::NeurogramSimiliarityIndexMeasure;
+
+  std::unique_ptr<SlidingPatchComparator> CreateSlidingComparator(
+      const AMatrix<double> &deg_spectrogram,
+      size_t num_patch_frames) const override {
+    num_sliding_comparators++;
+    return NeurogramSimiliarityIndexMeasure::CreateSlidingComparator(
+        deg_spectrogram, num_patch_frames);
+  }
+};
+
+const bool kRegistered = ComputeBackendRegistry::Register("counting", {
+    [](size_t num_bands, double min_freq, bool speech_mode)
+        -> std::unique_ptr<SpectrogramBuilder> {
+      return absl::make_unique<CountingSpectrogramBuilder>(
+          GammatoneFilterBank{num_bands, min_freq}, speech_mode);
+    },
+    [](NsimPatchShape patch_shape)
+        -> std::unique_ptr<PatchSimilarityComparator> {
+      return absl::make_unique<CountingComparator>(false, patch_shape);
+    }});
+
+// Ensure that the backends that are linked in are found by name, and that a
+// name can only be registered once.
+TEST(ComputeBackendRegistry, FindsRegisteredBackends) {
+  ASSERT_TRUE(kRegistered);
+  EXPECT_NE(nullptr, ComputeBackendRegistry::Find("counting"));
+  EXPECT_EQ(nullptr, ComputeBackendRegistry::Find("missing"));
+  EXPECT_FALSE(ComputeBackendRegistry::Register("counting", {}));
+  const std::vector<std::string> names = ComputeBackendRegistry::Names();
+  EXPECT_NE(names.end(), std::find(names.begin(), names.end(), "counting"));
+}
+
+// Ensure that a manager builds the spectrograms and searches for the patches
+// with the backend that it is configured with, and that the scores are those
+// of the CPU when the backend computes them in the same way.
+TEST(ComputeBackendRegistry, ManagerUsesBackend) {
+  VisqolConfig::VisqolOptions options;
+  options.set_use_speech_scoring(true);
+  VisqolManager cpu_visqol;
+  ASSERT_TRUE(cpu_visqol.Init(FilePath(""), options).ok());
+  auto cpu_result = cpu_visqol.Run(FilePath(kRefPath), FilePath(kDegPath));
+  ASSERT_TRUE(cpu_result.ok());
+  EXPECT_EQ(0, num_builds);
+
+  options.set_compute_backend("counting");
+  VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(FilePath(""), options).ok());
+  auto result = visqol.Run(FilePath(kRefPath), FilePath(kDegPath));
+  ASSERT_TRUE(result.ok());
+  EXPECT_GT(num_builds, 0);
+  EXPECT_GT(num_sliding_comparators, 0);
+  EXPECT_EQ(cpu_result.ValueOrDie().moslqo(), result.ValueOrDie().moslqo());
+}
+
+// Ensure that a backend that is not linked in fails the initialization.
+TEST(ComputeBackendRegistry, MissingBackendFailsInit) {
+  VisqolConfig::VisqolOptions options;
+  options.set_use_speech_scoring(true);
+  options.set_compute_backend("missing");
+  VisqolManager visqol;
+  const auto status = visqol.Init(FilePath(""), options);
+  EXPECT_EQ(google::protobuf::util::error::INVALID_ARGUMENT,
+            status.error_code());
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -14,13 +14,16 @@
 
 #include "visqol_manager.h"
 
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
 
+#include "commandline_parser.h"
 #include "conformance.h"
 #include "similarity_result.h"
 #include "test_utility.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
 
 namespace Visqol {
 namespace {
@@ -121,5 +124,123 @@ INSTANTIATE_TEST_CASE_P(
       kConformanceCastanetsIdentity)
     ));
 
+// The subset of the conformance pairs that the approximate modes are checked
+// on, in the order of the expected scores of ModeConformanceData.
+struct ModeConformancePair {
+  const char *ref_file;
+  const char *deg_file;
+  const bool speech_mode;
+};
+
+const ModeConformancePair kModeConformancePairs[] = {
+    {"testdata/clean_speech/CA01_01.wav",
+     "testdata/clean_speech/transcoded_CA01_01.wav", true},
+    {"testdata/conformance_testdata_subset/strauss48_stereo.wav",
+     "testdata/conformance_testdata_subset/strauss48_stereo_lp35.wav", false},
+    {"testdata/conformance_testdata_subset/guitar48_stereo.wav",
+     "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav",
+     false},
+    {"testdata/conformance_testdata_subset/contrabassoon48_stereo.wav",
+     "testdata/conformance_testdata_subset/contrabassoon48_stereo_24kbps_aac."
+         "wav", false},
+    {"testdata/conformance_testdata_subset/castanets48_stereo.wav",
+     "testdata/conformance_testdata_subset/castanets48_stereo.wav", false}};
+
+constexpr size_t kNumModeConformancePairs =
+    sizeof(kModeConformancePairs) / sizeof(kModeConformancePairs[0]);
+
+// A mode that is selected by changing the options of the command line, and
+// the expected MOSLQO of each of kModeConformancePairs in that mode.
+struct ModeConformanceData {
+  const char *name;
+  void (*set_options)(VisqolConfig::VisqolOptions *options);
+  double expected_results[kNumModeConformancePairs];
+};
+
+// Class definition necessary for Value-Parameterized Tests of the modes.
+class ModeConformanceTest
+    : public ::testing::TestWithParam<ModeConformanceData> {};
+
+// Assert that the MOSLQO returned in each mode matches the last known
+// version for that mode.
+TEST_P(ModeConformanceTest, ConformanceWithKnownScores) {
+  for (size_t i = 0; i < kNumModeConformancePairs; i++) {
+    const ModeConformancePair &pair = kModeConformancePairs[i];
+    SCOPED_TRACE(pair.deg_file);
+    const CommandLineArgs test_inputs = CommandLineArgsHelper(
+        pair.ref_file, pair.deg_file, "", pair.speech_mode);
+    Visqol::VisqolManager visqol;
+    auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(
+        test_inputs);
+
+    auto options = VisqolCommandLineParser::BuildVisqolOptions(test_inputs);
+    GetParam().set_options(&options);
+    auto status = visqol.Init(test_inputs.sim_to_quality_mapper_model,
+                              options);
+    ASSERT_TRUE(status.ok());
+
+    auto status_or = visqol.Run(files_to_compare[0].reference,
+                                files_to_compare[0].degraded);
+    ASSERT_TRUE(status_or.ok());
+    EXPECT_NEAR(GetParam().expected_results[i],
+                status_or.ValueOrDie().moslqo(), kTolerance);
+  }
+}
+
+// Initialise the modes. The single precision patch search is checked against
+// the scores of the double precision search.
+INSTANTIATE_TEST_CASE_P(
+  TestParams, ModeConformanceTest, testing::Values(
+    ModeConformanceData{
+      "StreamingGammatone",
+      [](VisqolConfig::VisqolOptions *options) {
+        options->set_spectrogram_mode(
+            VisqolConfig::VisqolOptions::STREAMING_GAMMATONE);
+      },
+      {kStreamingConformanceSpeechCA01Transcoded,
+       kStreamingConformanceStraussLp35, kStreamingConformanceGuitar64aac,
+       kStreamingConformanceContrabassoon24aac,
+       kStreamingConformanceCastanetsIdentity}},
+    ModeConformanceData{
+      "MultirateGammatone",
+      [](VisqolConfig::VisqolOptions *options) {
+        options->set_spectrogram_mode(
+            VisqolConfig::VisqolOptions::MULTIRATE_GAMMATONE);
+      },
+      {kMultirateConformanceSpeechCA01Transcoded,
+       kMultirateConformanceStraussLp35, kMultirateConformanceGuitar64aac,
+       kMultirateConformanceContrabassoon24aac,
+       kMultirateConformanceCastanetsIdentity}},
+    ModeConformanceData{
+      "ErbStft",
+      [](VisqolConfig::VisqolOptions *options) {
+        options->set_spectrogram_mode(VisqolConfig::VisqolOptions::ERB_STFT);
+      },
+      {kErbStftConformanceSpeechCA01Transcoded,
+       kErbStftConformanceStraussLp35, kErbStftConformanceGuitar64aac,
+       kErbStftConformanceContrabassoon24aac,
+       kErbStftConformanceCastanetsIdentity}},
+    ModeConformanceData{
+      "CoarseToFine",
+      [](VisqolConfig::VisqolOptions *options) {
+        options->set_patch_search(VisqolConfig::VisqolOptions::COARSE_TO_FINE);
+      },
+      {kCoarseToFineConformanceSpeechCA01Transcoded,
+       kCoarseToFineConformanceStraussLp35,
+       kCoarseToFineConformanceGuitar64aac,
+       kCoarseToFineConformanceContrabassoon24aac,
+       kCoarseToFineConformanceCastanetsIdentity}},
+    ModeConformanceData{
+      "FloatPatchSearch",
+      [](VisqolConfig::VisqolOptions *options) {
+        options->set_use_float_patch_search(true);
+      },
+      {kConformanceSpeechCA01Transcoded, kConformanceStraussLp35,
+       kConformanceGuitar64aac, kConformanceContrabassoon24aac,
+       kConformanceCastanetsIdentity}}),
+  [](const testing::TestParamInfo<ModeConformanceData> &info) {
+    return std::string(info.param.name);
+  });
+
 } // namespace
 } // namespace Visqol
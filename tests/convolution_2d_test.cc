@@ -14,6 +14,10 @@
 
 #include "convolution_2d.h"
 
+#include <array>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "test_utility.h"
@@ -50,5 +54,48 @@ TEST(Convolution2D, 3x3_2d_conv_test) {
       &fail_msg));
 }
 
+/**
+ * Test that the separable convolution matches the 2D convolution with the
+ * outer product filter, including at the replicated boundary.
+ */
+TEST(Convolution2D, separable_matches_2d_conv) {
+  const std::array<double, 3> taps{{0.2, 0.5, 0.3}};
+  std::vector<double> w(9);
+  for (size_t col = 0; col < 3; col++) {
+    for (size_t row = 0; row < 3; row++) {
+      w[col * 3 + row] = taps[row] * taps[col];
+    }
+  }
+  AMatrix<double> window(3, 3, std::move(w));
+
+  std::vector<double> m{40.0392, 43.3409, 39.5270, 41.1731, 41.3591, 42.6852,
+      45.2083, 45.7769, 39.9689, 43.6190, 41.0119, 40.4244, 41.5932, 43.6027,
+      42.6204, 43.0624, 42.2610, 42.4725, 43.4258, 42.9079};
+  AMatrix<double> matrix(5, 4, std::move(m));
+
+  auto expected_result = Convolution2D<double>::Valid2DConvWithBoundary(
+      window, matrix);
+  auto separable_res = Convolution2D<double>::SeparableConvWithBoundary(taps,
+                                                                        matrix);
+  std::string fail_msg;
+  ASSERT_TRUE(CompareDoubleMatrix(expected_result, separable_res, 1e-12,
+      &fail_msg)) << fail_msg;
+}
+
+/**
+ * Test that a wider separable filter replicates the boundary of a constant
+ * input, so the output is the constant scaled by the filter gain.
+ */
+TEST(Convolution2D, separable_5_tap_boundary) {
+  const std::array<double, 5> taps{{0.1, 0.2, 0.4, 0.2, 0.1}};
+  auto matrix = AMatrix<double>::Filled(3, 2, 2.0);
+  auto res = Convolution2D<double>::SeparableConvWithBoundary(taps, matrix);
+  ASSERT_EQ(matrix.NumRows(), res.NumRows());
+  ASSERT_EQ(matrix.NumCols(), res.NumCols());
+  for (size_t i = 0; i < res.NumElements(); i++) {
+    EXPECT_NEAR(2.0, res(i), 1e-12);
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
@@ -0,0 +1,235 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dense_rbf_model.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "svm.h"
+
+#include "embedded_svr_model.h"
+#include "file_path.h"
+#include "libsvm_target_observation_convertor.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+namespace {
+
+const double kTolerance = 1e-9;
+const FilePath kAudioModelFile = FilePath(
+    FilePath::currentWorkingDir() + "/model/libsvm_nu_svr_model.txt");
+const FilePath kSpeechModelFile = FilePath(FilePath::currentWorkingDir() +
+    "/model/tcdvoip_nu.568_c5.31474325639_g3.17773760038_model.txt");
+
+void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+// Predict an observation with LIBSVM, through its sparse nodes.
+double SvmPredict(const svm_model *model,
+                  const std::vector<double> &observation) {
+  const LibSvmTargetObservationConvertor conv;
+  svm_node *obs_node = conv.ConvertObservation(observation);
+  const double prediction = svm_predict(model, obs_node);
+  free(obs_node);
+  return prediction;
+}
+
+// Make observations of similarity scores between 0 and 1.
+std::vector<std::vector<double>> MakeObservations(size_t num_observations,
+                                                  size_t num_features) {
+  std::vector<std::vector<double>> observations(num_observations,
+      std::vector<double>(num_features));
+  for (size_t i = 0; i < num_observations; i++) {
+    for (size_t band = 0; band < num_features; band++) {
+      observations[i][band] = 0.5 + 0.5 * std::sin(0.7 * i + 0.3 * band * i);
+    }
+  }
+  return observations;
+}
+
+// Ensure that the dense model predicts the same values as LIBSVM.
+void ExpectSamePredictions(const FilePath &model_file) {
+  svm_model *model = svm_load_model(model_file.Path().c_str());
+  ASSERT_NE(nullptr, model);
+  const auto dense = DenseRbfModel::FromSvmModel(model);
+  ASSERT_NE(nullptr, dense);
+  ASSERT_GT(dense->NumFeatures(), 0u);
+
+  for (const auto &observation : MakeObservations(16, dense->NumFeatures())) {
+    EXPECT_NEAR(SvmPredict(model, observation), dense->Predict(observation),
+                kTolerance);
+  }
+  svm_free_and_destroy_model(&model);
+}
+
+TEST(DenseRbfModelTest, MatchesAudioModel) {
+  ExpectSamePredictions(kAudioModelFile);
+}
+
+TEST(DenseRbfModelTest, MatchesSpeechModel) {
+  ExpectSamePredictions(kSpeechModelFile);
+}
+
+// Ensure that the embedded model holds exactly the values of the default
+// model file.
+TEST(DenseRbfModelTest, EmbeddedModelMatchesAudioModel) {
+  svm_model *model = svm_load_model(kAudioModelFile.Path().c_str());
+  ASSERT_NE(nullptr, model);
+  const auto dense = DenseRbfModel::FromSvmModel(model);
+  ASSERT_NE(nullptr, dense);
+  const auto embedded = DenseRbfModel::FromEmbedded(kEmbeddedSvrModel);
+  ASSERT_EQ(dense->NumFeatures(), embedded->NumFeatures());
+  EXPECT_EQ(static_cast<size_t>(model->l),
+            kEmbeddedSvrModel.num_support_vectors);
+
+  for (const auto &observation : MakeObservations(16, dense->NumFeatures())) {
+    EXPECT_EQ(dense->Predict(observation), embedded->Predict(observation));
+  }
+  svm_free_and_destroy_model(&model);
+}
+
+// Ensure that a batch spanning several blocks is predicted exactly as each of
+// its observations is on its own.
+TEST(DenseRbfModelTest, BatchMatchesSinglePredictions) {
+  svm_model *model = svm_load_model(kAudioModelFile.Path().c_str());
+  ASSERT_NE(nullptr, model);
+  const auto dense = DenseRbfModel::FromSvmModel(model);
+  ASSERT_NE(nullptr, dense);
+
+  const auto observations = MakeObservations(
+      2 * DenseRbfModel::kObservationsPerBlock + 3, dense->NumFeatures());
+  const std::vector<double> predictions = dense->PredictBatch(observations);
+  ASSERT_EQ(observations.size(), predictions.size());
+  for (size_t i = 0; i < observations.size(); i++) {
+    EXPECT_NEAR(dense->Predict(observations[i]), predictions[i], kTolerance);
+  }
+  EXPECT_TRUE(dense->PredictBatch({}).empty());
+  svm_free_and_destroy_model(&model);
+}
+
+// Ensure that a saved model is loaded back with the same predictions and
+// source fingerprint, and that other files are not loaded as models.
+TEST(DenseRbfModelTest, SaveAndLoad) {
+  svm_model *model = svm_load_model(kAudioModelFile.Path().c_str());
+  ASSERT_NE(nullptr, model);
+  const auto dense = DenseRbfModel::FromSvmModel(model);
+  ASSERT_NE(nullptr, dense);
+  const std::string path = ::testing::TempDir() + "/dense_rbf_model.vqsvr";
+  ASSERT_TRUE(dense->Save(path, 123, 456));
+
+  uint64_t source_size = 0;
+  uint64_t source_hash = 0;
+  const auto loaded = DenseRbfModel::Load(path, &source_size, &source_hash);
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(123u, source_size);
+  EXPECT_EQ(456u, source_hash);
+  EXPECT_EQ(dense->NumFeatures(), loaded->NumFeatures());
+  for (const auto &observation : MakeObservations(8, dense->NumFeatures())) {
+    EXPECT_EQ(dense->Predict(observation), loaded->Predict(observation));
+  }
+  EXPECT_EQ(nullptr, DenseRbfModel::Load(kAudioModelFile.Path(), &source_size,
+                                         &source_hash));
+  svm_free_and_destroy_model(&model);
+}
+
+// Ensure that a truncated model, or one whose header claims more support
+// vectors than the file holds, is not loaded.
+TEST(DenseRbfModelTest, CorruptModelIsNotLoaded) {
+  svm_model *model = svm_load_model(kAudioModelFile.Path().c_str());
+  ASSERT_NE(nullptr, model);
+  const auto dense = DenseRbfModel::FromSvmModel(model);
+  svm_free_and_destroy_model(&model);
+  ASSERT_NE(nullptr, dense);
+  const std::string path = ::testing::TempDir() + "/dense_rbf_model.vqsvr";
+  ASSERT_TRUE(dense->Save(path, 123, 456));
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  const auto write_file = [&path](const std::string &bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  };
+
+  uint64_t source_size = 0;
+  uint64_t source_hash = 0;
+  write_file(contents.substr(0, contents.size() - sizeof(double)));
+  EXPECT_EQ(nullptr, DenseRbfModel::Load(path, &source_size, &source_hash));
+
+  // The count of support vectors follows the magic, version and number of
+  // features in the header.
+  std::string huge_count = contents;
+  const uint64_t num_support_vectors = ~uint64_t{0} / 2;
+  huge_count.replace(16, sizeof(num_support_vectors),
+                     reinterpret_cast<const char *>(&num_support_vectors),
+                     sizeof(num_support_vectors));
+  write_file(huge_count);
+  EXPECT_EQ(nullptr, DenseRbfModel::Load(path, &source_size, &source_hash));
+
+  write_file(contents);
+  EXPECT_NE(nullptr, DenseRbfModel::Load(path, &source_size, &source_hash));
+}
+
+// Ensure that a compiled model next to a model file is loaded in its place,
+// and is ignored once the model file changes.
+TEST(DenseRbfModelTest, CompiledModelFollowsModelFile) {
+  const std::string model_path = ::testing::TempDir() + "/compiled_model.txt";
+  const std::string compiled_path = model_path +
+      SupportVectorRegressionModel::kCompiledModelExtension;
+  std::remove(compiled_path.c_str());
+  CopyFile(kAudioModelFile.Path(), model_path);
+  ASSERT_TRUE(SupportVectorRegressionModel::Compile(
+      FilePath(model_path), FilePath(compiled_path)).ok());
+  // Compiling again finds the compiled model next to the model file, which
+  // must not keep the text model from being compiled.
+  ASSERT_TRUE(SupportVectorRegressionModel::Compile(
+      FilePath(model_path), FilePath(compiled_path)).ok());
+
+  SupportVectorRegressionModel text_model;
+  ASSERT_TRUE(text_model.Init(kAudioModelFile).ok());
+  SupportVectorRegressionModel compiled_model;
+  ASSERT_TRUE(compiled_model.Init(FilePath(model_path)).ok());
+  const auto observations = MakeObservations(8, 32);
+  for (const auto &observation : observations) {
+    EXPECT_NEAR(text_model.Predict(observation),
+                compiled_model.Predict(observation), kTolerance);
+  }
+
+  // The stale compiled model must not be used for the new model file.
+  CopyFile(kSpeechModelFile.Path(), model_path);
+  SupportVectorRegressionModel speech_model;
+  ASSERT_TRUE(speech_model.Init(kSpeechModelFile).ok());
+  SupportVectorRegressionModel changed_model;
+  ASSERT_TRUE(changed_model.Init(FilePath(model_path)).ok());
+  for (const auto &observation : observations) {
+    EXPECT_NEAR(speech_model.Predict(observation),
+                changed_model.Predict(observation), kTolerance);
+  }
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,117 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "energy_patch_creator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal.h"
+#include "image_patch_creator.h"
+
+namespace Visqol {
+namespace {
+
+const size_t kSampleRate = 48000;
+const double kOverlap = 0.25;
+const size_t kPatchSize = 30;
+const double kSilenceThresholdDb = -60.0;
+
+// A signal with a tone between the given times, and silence elsewhere.
+AudioSignal MakeSignal(double duration, double tone_start, double tone_end) {
+  std::vector<double> samples(duration * kSampleRate, 0.0);
+  for (size_t i = tone_start * kSampleRate; i < tone_end * kSampleRate; i++) {
+    samples[i] = 0.5 * std::sin(2 * M_PI * 1000.0 * i / kSampleRate);
+  }
+  return AudioSignal{AMatrix<double>(samples), kSampleRate};
+}
+
+// The spectrogram that a signal of the given duration has the columns of.
+AMatrix<double> MakeSpectrogram(const AudioSignal &signal,
+                                const AnalysisWindow &window) {
+  const size_t hop_size = window.size * window.overlap;
+  const size_t num_cols = 1 + (signal.data_matrix.NumRows() - window.size) /
+                              hop_size;
+  return AMatrix<double>(1, num_cols);
+}
+
+// Ensure that the patches in the silent lead-in and tail are dropped, and
+// that the patches of the tone are kept.
+TEST(EnergyPatchCreatorTest, DropsSilentPatches) {
+  const AudioSignal signal = MakeSignal(10.0, 3.0, 7.0);
+  const AnalysisWindow window{kSampleRate, kOverlap};
+  const AMatrix<double> spectrogram = MakeSpectrogram(signal, window);
+
+  const auto all_result = ImagePatchCreator(kPatchSize).CreateRefPatchIndices(
+      spectrogram, signal, window);
+  ASSERT_TRUE(all_result.ok());
+  const EnergyPatchCreator creator(kPatchSize, kSilenceThresholdDb);
+  const auto result = creator.CreateRefPatchIndices(spectrogram, signal,
+                                                    window);
+  ASSERT_TRUE(result.ok());
+  const std::vector<size_t> &all_indices = all_result.ValueOrDie();
+  const std::vector<size_t> &indices = result.ValueOrDie();
+  EXPECT_LT(indices.size(), all_indices.size());
+  ASSERT_FALSE(indices.empty());
+
+  // Each kept patch overlaps the tone, and each patch that overlaps the tone
+  // is kept.
+  const size_t hop_size = window.size * window.overlap;
+  const size_t patch_samples = (kPatchSize - 1) * hop_size + window.size;
+  for (const size_t index : all_indices) {
+    const double start = static_cast<double>(index * hop_size) / kSampleRate;
+    const double end = start + static_cast<double>(patch_samples) /
+                               kSampleRate;
+    const bool has_tone = end > 3.0 && start < 7.0;
+    const bool is_kept = std::find(indices.begin(), indices.end(), index) !=
+                         indices.end();
+    EXPECT_EQ(has_tone, is_kept) << "patch at " << start << " sec";
+  }
+}
+
+// Ensure that every patch of a silent reference is kept, so that it can still
+// be scored.
+TEST(EnergyPatchCreatorTest, KeepsAllPatchesOfSilence) {
+  const AudioSignal signal = MakeSignal(5.0, 0.0, 0.0);
+  const AnalysisWindow window{kSampleRate, kOverlap};
+  const AMatrix<double> spectrogram = MakeSpectrogram(signal, window);
+  const auto all_result = ImagePatchCreator(kPatchSize).CreateRefPatchIndices(
+      spectrogram, signal, window);
+  const auto result = EnergyPatchCreator(kPatchSize, kSilenceThresholdDb)
+      .CreateRefPatchIndices(spectrogram, signal, window);
+  ASSERT_TRUE(all_result.ok());
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(all_result.ValueOrDie(), result.ValueOrDie());
+}
+
+// Ensure that the level of a patch is relative to the peak of the signal.
+TEST(EnergyPatchCreatorTest, PatchLevels) {
+  const AudioSignal signal = MakeSignal(5.0, 0.0, 5.0);
+  const AnalysisWindow window{kSampleRate, kOverlap};
+  const EnergyPatchCreator creator(kPatchSize, kSilenceThresholdDb);
+  const std::vector<double> levels = creator.CalcPatchLevels(signal, {15, 45},
+                                                             window);
+  ASSERT_EQ(2u, levels.size());
+  // The RMS of a sine wave is 3 dB below its peak.
+  EXPECT_NEAR(-3.0103, levels[0], 0.01);
+  EXPECT_NEAR(-3.0103, levels[1], 0.01);
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -15,13 +15,17 @@
 #include "fast_fourier_transform.h"
 
 #include <complex>
+#include <memory>
 #include <string>
 #include <valarray>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "gtest/gtest.h"
 
 #include "amatrix.h"
+#include "audio_channel.h"
+#include "fft_manager_pool.h"
 #include "test_utility.h"
 
 namespace Visqol {
@@ -288,5 +292,84 @@ TEST(FastFourierTransformTest, FftReconstructConjsymZero) {
                                   kTolerance, &fail_msg)) << fail_msg;
 }
 
+// Test that a manager leased from the pool is reused by a later lease of the
+// same size, and that it still reconstructs the input after being reused.
+TEST(FastFourierTransformTest, PooledManagerIsReused) {
+  const FftManager *first_manager;
+  {
+    const FftManagerPool::Lease lease(k65Samples.NumElements());
+    first_manager = lease.Get().get();
+    FastFourierTransform::Forward1d(lease.Get(), k65SamplesZero);
+  }
+  const FftManagerPool::Lease lease(k65Samples.NumElements());
+  ASSERT_EQ(first_manager, lease.Get().get());
+  auto fft_forward = FastFourierTransform::Forward1d(lease.Get(), k65Samples);
+  auto fft_inverse = FastFourierTransform::Inverse1dConjSym(lease.Get(),
+                                                            fft_forward);
+
+  std::string fail_msg;
+  ASSERT_TRUE(CompareDoubleMatrix(k65Samples,
+                                  fft_inverse,
+                                  kTolerance, &fail_msg)) << fail_msg;
+
+  // A concurrent lease of the same size gets a different manager.
+  const FftManagerPool::Lease other_lease(k65Samples.NumElements());
+  ASSERT_NE(lease.Get().get(), other_lease.Get().get());
+}
+
+// Test that the pool is bounded by the size of the buffers of its idle
+// managers rather than by their number, so that many short FFTs of different
+// sizes are all kept.
+TEST(FastFourierTransformTest, PoolKeepsManySmallManagers) {
+  const size_t kNumSizes = 32;
+  std::vector<const FftManager *> first_managers;
+  {
+    std::vector<std::unique_ptr<FftManagerPool::Lease>> leases;
+    for (size_t i = 0; i < kNumSizes; i++) {
+      leases.push_back(absl::make_unique<FftManagerPool::Lease>(1000 + i));
+      first_managers.push_back(leases.back()->Get().get());
+      ASSERT_LT(FftManagerPool::BufferBytes(*leases.back()->Get()),
+                FftManagerPool::kMaxIdleBytes / kNumSizes);
+    }
+  }
+  for (size_t i = 0; i < kNumSizes; i++) {
+    const FftManagerPool::Lease lease(1000 + i);
+    ASSERT_EQ(first_managers[i], lease.Get().get());
+  }
+}
+
+// Test that the half spectrum round trips the input, and that its pointwise
+// product matches the one of the full complex spectrum.
+TEST(FastFourierTransformTest, HalfSpectrumMatchesComplexSpectrum) {
+  auto fft_manager = absl::make_unique<FftManager>(k65Samples.NumElements());
+  const size_t fft_size = fft_manager->GetFftSize();
+  const std::vector<double> signal = k65Samples.ToVector();
+  AudioChannel spectrum;
+  spectrum.Init(fft_size);
+  FastFourierTransform::ForwardReal1d(fft_manager, signal, &spectrum);
+  const std::vector<double> round_trip = FastFourierTransform::InverseReal1d(
+      fft_manager, spectrum);
+  ASSERT_EQ(signal.size(), round_trip.size());
+  for (size_t i = 0; i < signal.size(); i++) {
+    ASSERT_NEAR(signal[i], round_trip[i], kTolerance);
+  }
+
+  // Square the spectrum in the half spectrum and in the full spectrum.
+  AudioChannel squared;
+  squared.Init(fft_size);
+  squared.Clear();
+  fft_manager->ZConvolveAccumulate(spectrum, spectrum, &squared, 1.0f);
+  const std::vector<double> half_result = FastFourierTransform::InverseReal1d(
+      fft_manager, squared);
+  auto full_spectrum = FastFourierTransform::Forward1d(fft_manager,
+                                                       k65Samples);
+  const auto full_result = FastFourierTransform::Inverse1dConjSym(
+      fft_manager, full_spectrum.PointWiseProduct(full_spectrum)).ToVector();
+  ASSERT_EQ(full_result.size(), half_result.size());
+  for (size_t i = 0; i < half_result.size(); i++) {
+    ASSERT_NEAR(full_result[i], half_result[i], 1e-3);
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
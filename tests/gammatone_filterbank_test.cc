@@ -14,10 +14,20 @@
 
 #include "gammatone_filterbank.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <valarray>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "absl/types/span.h"
 
 #include "amatrix.h"
 #include "equivalent_rectangular_bandwidth.h"
+#include "fixed_point_gammatone_filterbank.h"
+#include "multirate_gammatone_filterbank.h"
+#include "signal_filter.h"
 
 namespace Visqol {
 namespace {
@@ -47,5 +57,158 @@ TEST(ApplyFilterTest, basic_positive_flow) {
   ASSERT_EQ(kNumBands, filtered_signal.NumRows());
 }
 
+// Ensure that the fused filter cascade produces the same output as applying
+// the four stages one band at a time with SignalFilter, and that the filter
+// conditions carry over between consecutive calls.
+TEST(ApplyFilterTest, matches_per_band_cascade) {
+  auto filter_bank = GammatoneFilterBank{kNumBands, kMinFreq};
+  auto erb = EquivalentRectangularBandwidth::MakeFilters(kSampleRate,
+                                                         kNumBands, kMinFreq,
+                                                         kSampleRate / 2);
+  AMatrix<double> filter_coeffs = AMatrix<double>(erb.filterCoeffs);
+  filter_coeffs = filter_coeffs.FlipUpDown();
+  filter_bank.SetFilterCoefficients(filter_coeffs);
+  filter_bank.ResetFilterConditions();
+
+  const std::valarray<double> signal = k10Samples.GetColumn(0).ToValArray();
+  auto first = filter_bank.ApplyFilter(signal);
+  auto second = filter_bank.ApplyFilter(signal);
+
+  for (size_t band = 0; band < kNumBands; band++) {
+    const double gain = filter_coeffs(band, 9);
+    const std::valarray<double> b{filter_coeffs(band, 6),
+                                  filter_coeffs(band, 7),
+                                  filter_coeffs(band, 8)};
+    std::valarray<std::valarray<double>> conds({0.0, 0.0}, 4);
+    for (const auto &result : {first, second}) {
+      std::valarray<double> x = signal;
+      for (size_t stage = 0; stage < 4; stage++) {
+        const double scale = (stage == 0) ? gain : 1.0;
+        const std::valarray<double> a{filter_coeffs(band, 0) / scale,
+                                      filter_coeffs(band, 1 + stage) / scale,
+                                      filter_coeffs(band, 5) / scale};
+        auto fltr_rslt = SignalFilter::Filter(a, b, x, conds[stage]);
+        conds[stage] = fltr_rslt.finalConditions;
+        x = fltr_rslt.filteredSignal;
+      }
+      for (size_t i = 0; i < signal.size(); i++) {
+        ASSERT_NEAR(x[i], result(band, i), 1e-12);
+      }
+    }
+  }
+}
+
+// Ensure that the per band RMS accumulated while filtering matches the RMS
+// of the full filtered output.
+TEST(ApplyFilterTest, rms_matches_filtered_output) {
+  auto filter_bank = GammatoneFilterBank{kNumBands, kMinFreq};
+  auto erb = EquivalentRectangularBandwidth::MakeFilters(kSampleRate,
+                                                         kNumBands, kMinFreq,
+                                                         kSampleRate / 2);
+  AMatrix<double> filter_coeffs = AMatrix<double>(erb.filterCoeffs);
+  filter_coeffs = filter_coeffs.FlipUpDown();
+  filter_bank.SetFilterCoefficients(filter_coeffs);
+
+  const std::valarray<double> signal = k10Samples.GetColumn(0).ToValArray();
+  filter_bank.ResetFilterConditions();
+  auto filtered_signal = filter_bank.ApplyFilter(signal);
+  filter_bank.ResetFilterConditions();
+  auto band_rms = filter_bank.ApplyFilterRms(
+      absl::Span<const double>(std::begin(signal), signal.size()));
+
+  ASSERT_EQ(kNumBands, band_rms.size());
+  for (size_t band = 0; band < kNumBands; band++) {
+    double sum_sq = 0.0;
+    for (size_t i = 0; i < filtered_signal.NumCols(); i++) {
+      sum_sq += filtered_signal(band, i) * filtered_signal(band, i);
+    }
+    ASSERT_NEAR(std::sqrt(sum_sq / signal.size()), band_rms[band], 1e-12);
+  }
+}
+
+// Ensure that the multirate filter bank filters the low bands at a reduced
+// rate, and that the band energies stay close to the full rate filter bank.
+TEST(ApplyFilterTest, multirate_matches_full_rate) {
+  auto erb = EquivalentRectangularBandwidth::MakeFilters(kSampleRate,
+                                                         kNumBands, kMinFreq,
+                                                         kSampleRate / 2);
+  auto filter_bank = GammatoneFilterBank{kNumBands, kMinFreq};
+  filter_bank.SetFilterCoefficients(
+      AMatrix<double>(erb.filterCoeffs).FlipUpDown());
+  const std::vector<double> center_freqs(erb.centerFreqs.rbegin(),
+                                         erb.centerFreqs.rend());
+  auto multirate_bank = MultirateGammatoneFilterBank{kNumBands, kMinFreq};
+  multirate_bank.SetCenterFrequencies(kSampleRate, center_freqs);
+  ASSERT_EQ(MultirateGammatoneFilterBank::kMaxDecimationLevel,
+            multirate_bank.GetDecimationLevel(0));
+  ASSERT_EQ(0, multirate_bank.GetDecimationLevel(kNumBands - 1));
+
+  // A sum of tones spread across the bands.
+  std::vector<double> signal(3840);
+  for (size_t i = 0; i < signal.size(); i++) {
+    const double t = static_cast<double>(i) / kSampleRate;
+    signal[i] = sin(2 * M_PI * 100 * t) + sin(2 * M_PI * 700 * t) +
+        sin(2 * M_PI * 3000 * t) + sin(2 * M_PI * 12000 * t);
+  }
+  filter_bank.ResetFilterConditions();
+  auto rms = filter_bank.ApplyFilterRms(signal);
+  multirate_bank.ResetFilterConditions();
+  auto multirate_rms = multirate_bank.ApplyFilterRms(signal);
+  ASSERT_EQ(kNumBands, multirate_rms.size());
+  // the skirts of the filters differ slightly at the lower rates, so the
+  // error is measured relative to the loudest band.
+  const double max_rms = *std::max_element(rms.begin(), rms.end());
+  for (size_t band = 0; band < kNumBands; band++) {
+    EXPECT_NEAR(rms[band], multirate_rms[band], 0.01 * max_rms)
+        << "band " << band;
+  }
+}
+
+// Ensure that the fixed-point filter bank tracks the band levels of the
+// floating point filter bank, for loud and for quiet 16 bit signals, and that
+// 16 bit samples convert to fixed point exactly.
+TEST(ApplyFilterTest, fixed_point_matches_floating_point) {
+  auto erb = EquivalentRectangularBandwidth::MakeFilters(kSampleRate,
+                                                         kNumBands, kMinFreq,
+                                                         kSampleRate / 2);
+  const AMatrix<double> filter_coeffs =
+      AMatrix<double>(erb.filterCoeffs).FlipUpDown();
+  const std::vector<double> center_freqs(erb.centerFreqs.rbegin(),
+                                         erb.centerFreqs.rend());
+  auto filter_bank = GammatoneFilterBank{kNumBands, kMinFreq};
+  filter_bank.SetFilterCoefficients(filter_coeffs);
+  auto fixed_point_bank = FixedPointGammatoneFilterBank{kNumBands, kMinFreq};
+  fixed_point_bank.SetFilterCoefficients(filter_coeffs, center_freqs,
+                                         kSampleRate);
+  ASSERT_EQ(int32_t{-12345} << (FixedPointGammatoneFilterBank::
+                                    kSignalFracBits - 15),
+            FixedPointGammatoneFilterBank::ToFixedPoint(-12345 / 32768.0));
+
+  for (const double level : {0.5, 0.005}) {
+    // A sum of tones spread across the bands, quantized to 16 bits.
+    std::vector<double> signal(3840);
+    std::vector<int32_t> fixed_signal(signal.size());
+    for (size_t i = 0; i < signal.size(); i++) {
+      const double t = static_cast<double>(i) / kSampleRate;
+      const double sample = level * (sin(2 * M_PI * 100 * t) +
+          sin(2 * M_PI * 700 * t) + sin(2 * M_PI * 3000 * t) +
+          sin(2 * M_PI * 12000 * t)) / 4;
+      signal[i] = std::round(sample * 32768) / 32768;
+      fixed_signal[i] = FixedPointGammatoneFilterBank::ToFixedPoint(
+          signal[i]);
+    }
+    filter_bank.ResetFilterConditions();
+    auto rms = filter_bank.ApplyFilterRms(signal);
+    std::vector<double> fixed_point_rms(kNumBands);
+    fixed_point_bank.ResetFilterConditions();
+    fixed_point_bank.ApplyFilterRms(fixed_signal,
+                                    absl::MakeSpan(fixed_point_rms));
+    for (size_t band = 0; band < kNumBands; band++) {
+      EXPECT_NEAR(rms[band], fixed_point_rms[band], 1e-3 * rms[band] + 1e-7)
+          << "level " << level << " band " << band;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
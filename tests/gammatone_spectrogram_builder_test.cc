@@ -14,15 +14,23 @@
 
 #include "gammatone_filterbank.h"
 
+#include <cmath>
+#include <memory>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
 
 #include "amatrix.h"
 #include "analysis_window.h"
 #include "equivalent_rectangular_bandwidth.h"
+#include "erb_filter_cache.h"
+#include "erb_stft_spectrogram_builder.h"
+#include "fixed_point_gammatone_spectrogram_builder.h"
 #include "gammatone_spectrogram_builder.h"
 #include "file_path.h"
 #include "misc_audio.h"
+#include "multirate_gammatone_filterbank.h"
 #include "spectrogram.h"
 #include "spectrogram_builder.h"
 
@@ -70,5 +78,227 @@ TEST(BuildSpectrogramTest, basic_positive_flow) {
   ASSERT_EQ(kNumBands, spectrogram_deg.Data().NumRows());
 }
 
+// Ensure that building the spectrogram columns across several threads gives
+// the same result as building them on a single thread.
+TEST(BuildSpectrogramTest, multithreaded_matches_single_threaded) {
+  FilePath stereo_file_ref{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"};
+  const AudioSignal signal_ref = MiscAudio::LoadAsMono(stereo_file_ref);
+  const AnalysisWindow window{signal_ref.sample_rate, kOverlap};
+
+  GammatoneSpectrogramBuilder single_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  GammatoneSpectrogramBuilder multi_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false, 4);
+  Spectrogram single = single_builder.Build(signal_ref, window).ValueOrDie();
+  Spectrogram multi = multi_builder.Build(signal_ref, window).ValueOrDie();
+
+  ASSERT_EQ(kRefSpectroNumCols, multi.Data().NumCols());
+  ASSERT_EQ(kNumBands, multi.Data().NumRows());
+  for (size_t i = 0; i < single.Data().NumElements(); i++) {
+    ASSERT_EQ(single.Data()(i), multi.Data()(i));
+  }
+  ASSERT_EQ(single.GetCenterFreqBands(), multi.GetCenterFreqBands());
+}
+
+// Ensure that building some columns of the spectrogram, on one thread or
+// several, fills them as a full build does, and leaves the others at zero.
+TEST(BuildSpectrogramTest, column_ranges_match_full_build) {
+  FilePath stereo_file_ref{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"};
+  const AudioSignal signal_ref = MiscAudio::LoadAsMono(stereo_file_ref);
+  const AnalysisWindow window{signal_ref.sample_rate, kOverlap};
+  const SpectrogramColumnRanges columns{{10, 50}, {300, 420}, {790, 900}};
+
+  GammatoneSpectrogramBuilder single_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  GammatoneSpectrogramBuilder multi_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false, 4);
+  Spectrogram full = single_builder.Build(signal_ref, window).ValueOrDie();
+  for (const SpectrogramBuilder *builder : {&single_builder, &multi_builder}) {
+    Spectrogram partial = builder->BuildColumnRanges(signal_ref, window,
+                                                     columns).ValueOrDie();
+    ASSERT_EQ(kRefSpectroNumCols, partial.Data().NumCols());
+    ASSERT_EQ(kNumBands, partial.Data().NumRows());
+    for (size_t col = 0; col < kRefSpectroNumCols; col++) {
+      const bool is_built = (col >= 10 && col < 50) ||
+                            (col >= 300 && col < 420) || col >= 790;
+      for (size_t band = 0; band < kNumBands; band++) {
+        ASSERT_EQ(is_built ? full.Data()(band, col) : 0.0,
+                  partial.Data()(band, col));
+      }
+    }
+  }
+}
+
+// Ensure that the cached ERB filter set matches a freshly built one, and that
+// repeated requests for the same configuration share the same instance.
+TEST(BuildSpectrogramTest, erb_filter_cache) {
+  const size_t sample_rate = 48000;
+  const double max_freq = sample_rate / 2.0;
+  auto filters = ErbFilterCache::GetFilters(sample_rate, kNumBands,
+                                            kMinimumFreq, max_freq);
+  auto filters_again = ErbFilterCache::GetFilters(sample_rate, kNumBands,
+                                                  kMinimumFreq, max_freq);
+  ASSERT_EQ(filters.get(), filters_again.get());
+
+  ErbFiltersResult erb_rslt = EquivalentRectangularBandwidth::MakeFilters(
+      sample_rate, kNumBands, kMinimumFreq, max_freq);
+  AMatrix<double> expected_coeffs =
+      AMatrix<double>(erb_rslt.filterCoeffs).FlipUpDown();
+  ASSERT_EQ(expected_coeffs.NumRows(), filters->filter_coeffs.NumRows());
+  ASSERT_EQ(expected_coeffs.NumCols(), filters->filter_coeffs.NumCols());
+  for (size_t i = 0; i < expected_coeffs.NumElements(); i++) {
+    ASSERT_EQ(expected_coeffs(i), filters->filter_coeffs(i));
+  }
+  ASSERT_EQ(kNumBands, filters->center_freqs.size());
+  for (size_t i = 0; i < kNumBands; i++) {
+    ASSERT_EQ(erb_rslt.centerFreqs[kNumBands - 1 - i],
+              filters->center_freqs[i]);
+  }
+
+  // A different configuration must not share the cached set.
+  auto speech_filters = ErbFilterCache::GetFilters(
+      sample_rate, kNumBands, kMinimumFreq,
+      GammatoneSpectrogramBuilder::kSpeechModeMaxFreq);
+  ASSERT_NE(filters.get(), speech_filters.get());
+}
+
+// Ensure that the cached multirate stages are shared between requests, and
+// that a filter bank set up with them filters as one that designs its own.
+TEST(BuildSpectrogramTest, multirate_filter_cache) {
+  const size_t sample_rate = 48000;
+  const double max_freq = sample_rate / 2.0;
+  auto filters = ErbFilterCache::GetMultirateFilters(sample_rate, kNumBands,
+                                                     kMinimumFreq, max_freq);
+  auto filters_again = ErbFilterCache::GetMultirateFilters(
+      sample_rate, kNumBands, kMinimumFreq, max_freq);
+  ASSERT_EQ(filters.get(), filters_again.get());
+  ASSERT_EQ(ErbFilterCache::GetFilters(sample_rate, kNumBands, kMinimumFreq,
+                                       max_freq)->center_freqs,
+            filters->center_freqs);
+
+  MultirateGammatoneFilterBank cached_bank{kNumBands, kMinimumFreq};
+  cached_bank.SetFilters(filters);
+  MultirateGammatoneFilterBank designed_bank{kNumBands, kMinimumFreq};
+  designed_bank.SetCenterFrequencies(sample_rate, filters->center_freqs);
+  std::vector<double> signal(3840);
+  for (size_t i = 0; i < signal.size(); i++) {
+    signal[i] = sin(2 * M_PI * 440 * static_cast<double>(i) / sample_rate);
+  }
+  ASSERT_EQ(designed_bank.ApplyFilterRms(signal),
+            cached_bank.ApplyFilterRms(signal));
+}
+
+// Ensure that the FFT based spectrogram has the same layout as the gammatone
+// spectrogram, and that it tracks the gammatone band levels closely.
+TEST(BuildSpectrogramTest, erb_stft_matches_gammatone_layout) {
+  FilePath stereo_file_ref{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"};
+  const AudioSignal signal_ref = MiscAudio::LoadAsMono(stereo_file_ref);
+  const AnalysisWindow window{signal_ref.sample_rate, kOverlap};
+
+  GammatoneSpectrogramBuilder gammatone_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  ErbStftSpectrogramBuilder stft_builder(kNumBands, kMinimumFreq, false);
+  Spectrogram gammatone = gammatone_builder.Build(signal_ref, window)
+      .ValueOrDie();
+  Spectrogram stft = stft_builder.Build(signal_ref, window).ValueOrDie();
+
+  ASSERT_EQ(kRefSpectroNumCols, stft.Data().NumCols());
+  ASSERT_EQ(kNumBands, stft.Data().NumRows());
+  ASSERT_EQ(gammatone.GetCenterFreqBands(), stft.GetCenterFreqBands());
+
+  // compare the mean level of each band over the whole signal in dB.
+  for (size_t band = 0; band < kNumBands; band++) {
+    double gammatone_sum = 0.0;
+    double stft_sum = 0.0;
+    for (size_t col = 0; col < kRefSpectroNumCols; col++) {
+      gammatone_sum += gammatone.Data()(band, col);
+      stft_sum += stft.Data()(band, col);
+    }
+    EXPECT_NEAR(20 * log10(gammatone_sum), 20 * log10(stft_sum), 1.5)
+        << "band " << band;
+  }
+
+  // the filters have unity gain at their center frequencies.
+  auto filters = ErbFilterCache::GetFilters(signal_ref.sample_rate, kNumBands,
+      kMinimumFreq, signal_ref.sample_rate / 2.0);
+  for (size_t band = 0; band < kNumBands; band++) {
+    ASSERT_NEAR(1.0, ErbStftSpectrogramBuilder::FilterPowerResponse(
+        filters->filter_coeffs, band, filters->center_freqs[band],
+        signal_ref.sample_rate), 1e-3);
+  }
+}
+
+// Ensure that the fixed-point spectrogram has the same layout as the gammatone
+// spectrogram, and that its cells are within a fraction of a dB of it above
+// the noise floor of 16 bit audio.
+TEST(BuildSpectrogramTest, fixed_point_matches_gammatone) {
+  FilePath stereo_file_ref{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"};
+  const AudioSignal signal_ref = MiscAudio::LoadAsMono(stereo_file_ref);
+  const AnalysisWindow window{signal_ref.sample_rate, kOverlap};
+
+  GammatoneSpectrogramBuilder gammatone_builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  FixedPointGammatoneSpectrogramBuilder fixed_point_builder(
+      FixedPointGammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  Spectrogram gammatone = gammatone_builder.Build(signal_ref, window)
+      .ValueOrDie();
+  Spectrogram fixed_point = fixed_point_builder.Build(signal_ref, window)
+      .ValueOrDie();
+
+  ASSERT_EQ(kRefSpectroNumCols, fixed_point.Data().NumCols());
+  ASSERT_EQ(kNumBands, fixed_point.Data().NumRows());
+  ASSERT_EQ(gammatone.GetCenterFreqBands(), fixed_point.GetCenterFreqBands());
+  for (size_t col = 0; col < kRefSpectroNumCols; col++) {
+    for (size_t band = 0; band < kNumBands; band++) {
+      const double expected = gammatone.Data()(band, col);
+      if (expected > 1e-4) {
+        ASSERT_NEAR(20 * log10(expected),
+                    20 * log10(fixed_point.Data()(band, col)), 0.05)
+            << "band " << band << " col " << col;
+      }
+    }
+  }
+}
+
+// Ensure that a single builder can build several spectrograms concurrently,
+// giving the same results as building them one after the other.
+TEST(BuildSpectrogramTest, concurrent_builds_match_sequential) {
+  FilePath stereo_file_ref{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"};
+  FilePath stereo_file_deg{
+      "testdata/conformance_testdata_subset/contrabassoon48_stereo_24kbps_aac."
+      "wav"};
+  const AudioSignal signal_ref = MiscAudio::LoadAsMono(stereo_file_ref);
+  const AudioSignal signal_deg = MiscAudio::LoadAsMono(stereo_file_deg);
+  const AnalysisWindow window{signal_ref.sample_rate, kOverlap};
+
+  std::vector<std::unique_ptr<SpectrogramBuilder>> builders;
+  builders.push_back(absl::make_unique<GammatoneSpectrogramBuilder>(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false));
+  builders.push_back(absl::make_unique<ErbStftSpectrogramBuilder>(
+      kNumBands, kMinimumFreq, false));
+  for (const auto &builder : builders) {
+    const Spectrogram ref = builder->Build(signal_ref, window).ValueOrDie();
+    const Spectrogram deg = builder->Build(signal_deg, window).ValueOrDie();
+    const auto pair = builder->BuildPair(signal_ref, signal_deg, window);
+    ASSERT_TRUE(pair.first.ok());
+    ASSERT_TRUE(pair.second.ok());
+    const AMatrix<double> &pair_ref = pair.first.ValueOrDie().Data();
+    const AMatrix<double> &pair_deg = pair.second.ValueOrDie().Data();
+    ASSERT_EQ(kRefSpectroNumCols, pair_ref.NumCols());
+    ASSERT_EQ(kDegSpectroNumCols, pair_deg.NumCols());
+    for (size_t i = 0; i < ref.Data().NumElements(); i++) {
+      ASSERT_EQ(ref.Data()(i), pair_ref(i));
+    }
+    for (size_t i = 0; i < deg.Data().NumElements(); i++) {
+      ASSERT_EQ(deg.Data()(i), pair_deg(i));
+    }
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
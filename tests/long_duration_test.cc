@@ -13,17 +13,25 @@
 // limitations under the License.
 
 #include "visqol_manager.h"
+#include <cmath>
 #include <iostream>
 #include "gtest/gtest.h"
 
+#include "conformance.h"
 #include "similarity_result.h"
 #include "test_utility.h"
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
 
 namespace Visqol {
 namespace {
 
 const double kMinMoslqo = 1.0;
 
+const char kRef1Min[] =
+    "testdata/long_duration/1_min/guitar48_stereo_ref_1min.wav";
+const char kDeg1Min[] =
+    "testdata/long_duration/1_min/guitar48_stereo_deg_1min.wav";
+
 // Confirm that a run can succesfully complete with a long file. In this test,
 // file duration is 1 min.
 TEST(LongFiles, 1_min) {
@@ -47,5 +55,56 @@ TEST(LongFiles, 1_min) {
   ASSERT_TRUE(status_or.ValueOrDie().moslqo() > kMinMoslqo);
 }
 
+// Compare the long files in tiles, and ensure that the score is close to
+// that of comparing them whole, and that the patches of every tile are kept.
+TEST(LongFiles, Tiled) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper(kRef1Min,
+                                                                 kDeg1Min);
+  VisqolConfig::VisqolOptions options;
+  Visqol::VisqolManager whole_visqol;
+  ASSERT_TRUE(whole_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  auto whole_result = whole_visqol.Run(FilePath(kRef1Min), FilePath(kDeg1Min));
+  ASSERT_TRUE(whole_result.ok());
+
+  options.set_tile_duration(20.0);
+  Visqol::VisqolManager tiled_visqol;
+  ASSERT_TRUE(tiled_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  auto tiled_result = tiled_visqol.Run(FilePath(kRef1Min), FilePath(kDeg1Min));
+  ASSERT_TRUE(tiled_result.ok());
+  const auto &whole = whole_result.ValueOrDie();
+  const auto &tiled = tiled_result.ValueOrDie();
+  EXPECT_NEAR(whole.moslqo(), tiled.moslqo(), kTiledMoslqoTolerance);
+  EXPECT_NEAR(whole.global_lag(), tiled.global_lag(),
+              kTiledGlobalLagTolerance);
+  // Each tile may leave out the patch at its end that the whole files would
+  // compare across the end of the tile.
+  const int kNumTiles = 3;
+  EXPECT_LE(tiled.patch_sims_size(), whole.patch_sims_size());
+  EXPECT_GE(tiled.patch_sims_size(), whole.patch_sims_size() - kNumTiles);
+  for (int i = 1; i < tiled.patch_sims_size(); i++) {
+    EXPECT_LT(tiled.patch_sims(i - 1).ref_patch_start_time(),
+              tiled.patch_sims(i).ref_patch_start_time());
+  }
+  EXPECT_GT(tiled.patch_sims(tiled.patch_sims_size() - 1)
+                .ref_patch_start_time(), 50.0);
+}
+
+// Ensure that a memory limit that the whole files do not fit in compares
+// them in tiles.
+TEST(LongFiles, MemoryLimit) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper(kRef1Min,
+                                                                 kDeg1Min);
+  VisqolConfig::VisqolOptions options;
+  options.set_max_memory_mb(100);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                          options).ok());
+  auto result = visqol.Run(FilePath(kRef1Min), FilePath(kDeg1Min));
+  ASSERT_TRUE(result.ok());
+  EXPECT_GT(result.ValueOrDie().moslqo(), kMinMoslqo);
+}
+
 } // namespace
 } // namespace Visqol
\ No newline at end of file
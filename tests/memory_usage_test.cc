@@ -0,0 +1,85 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "memory_usage.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "parallel_executor.h"
+
+namespace Visqol {
+namespace {
+
+const size_t kAllocSize = 1000;
+
+// Allocate and free a buffer through the global operator new, which the
+// optimizer cannot elide.
+void AllocateBuffer() {
+  std::unique_ptr<std::vector<char>> buffer(
+      new std::vector<char>(kAllocSize));
+  ASSERT_EQ(kAllocSize, buffer->size());
+}
+
+// Ensure that the counting allocator is linked into the test.
+TEST(MemoryUsageTest, AllocatorIsHooked) {
+  EXPECT_TRUE(AllocationCounter::IsHooked());
+}
+
+// Ensure that the allocations of the calling thread are counted, along with
+// the peak RSS, and that no more are counted once the counter is stopped.
+TEST(MemoryUsageTest, CountsAllocations) {
+  MemoryUsage usage;
+  {
+    AllocationCounter counter(&usage);
+    AllocateBuffer();
+    counter.Stop();
+    AllocateBuffer();
+  }
+  EXPECT_GE(usage.bytes_allocated, kAllocSize);
+  EXPECT_GE(usage.num_allocations, 2u);
+  EXPECT_LT(usage.bytes_allocated, 2 * kAllocSize);
+  EXPECT_GT(usage.peak_rss_kb, 0u);
+}
+
+// Ensure that a counter without a usage counts nothing, and does not hide
+// the allocations from an enclosing counter.
+TEST(MemoryUsageTest, NullUsageCountsNothing) {
+  MemoryUsage usage;
+  AllocationCounter counter(&usage);
+  {
+    AllocationCounter null_counter(nullptr);
+    AllocateBuffer();
+  }
+  counter.Stop();
+  EXPECT_GE(usage.bytes_allocated, kAllocSize);
+}
+
+// Ensure that the allocations of the workers of a parallel loop are counted
+// with the thread that runs the loop.
+TEST(MemoryUsageTest, CountsWorkerAllocations) {
+  const size_t kNumTasks = 8;
+  MemoryUsage usage;
+  {
+    AllocationCounter counter(&usage);
+    ParallelExecutor::ForEach(kNumTasks, 4, [](size_t) { AllocateBuffer(); });
+  }
+  EXPECT_GE(usage.bytes_allocated, kNumTasks * kAllocSize);
+  EXPECT_GE(usage.num_allocations, 2 * kNumTasks);
+}
+}  // namespace
+}  // namespace Visqol
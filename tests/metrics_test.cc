@@ -0,0 +1,104 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "metrics.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "stage_timer.h"
+
+namespace Visqol {
+namespace {
+
+// Ensure that counters are summed by their labels, and exported as plain
+// text.
+TEST(MetricsTest, FormatsCountersAsText) {
+  MetricsRegistry registry;
+  registry.IncrementCounter("visqol_pairs_total", {{"code", "OK"}}, 2);
+  registry.IncrementCounter("visqol_pairs_total", {{"code", "OK"}}, 1);
+  registry.IncrementCounter("visqol_pairs_total", {{"code", "CANCELLED"}}, 1);
+  registry.ObserveLatency("visqol_pair_seconds", {}, 1.0);
+  registry.ObserveLatency("visqol_pair_seconds", {}, 3.0);
+  const std::string text = registry.FormatText();
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_pairs_total{code=\"OK\"} 3\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_pairs_total{code=\"CANCELLED\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_pair_seconds count=2 mean=2 max=3\n"));
+}
+
+// Ensure that latencies are exported as cumulative Prometheus histograms.
+TEST(MetricsTest, FormatsHistogramsForPrometheus) {
+  MetricsRegistry registry;
+  registry.ObserveLatency("visqol_stage_seconds", {{"stage", "load"}}, 0.002);
+  registry.ObserveLatency("visqol_stage_seconds", {{"stage", "load"}}, 0.2);
+  registry.ObserveLatency("visqol_stage_seconds", {{"stage", "load"}}, 1000);
+  const std::string text = registry.FormatPrometheus();
+  EXPECT_NE(std::string::npos,
+            text.find("# TYPE visqol_stage_seconds histogram\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_stage_seconds_bucket{stage=\"load\",le=\"0.001\"} 0\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_stage_seconds_bucket{stage=\"load\",le=\"0.0025\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_stage_seconds_bucket{stage=\"load\",le=\"300\"} 2\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_stage_seconds_bucket{stage=\"load\",le=\"+Inf\"} 3\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_stage_seconds_count{stage=\"load\"} 3\n"));
+}
+
+// Ensure that the metrics of ViSQOL only reach a sink once it is set, and
+// that the stage timers report their stages.
+TEST(MetricsTest, ReportsToSink) {
+  MetricsRegistry registry;
+  Metrics::ReportPair(0, 1.0);
+  EXPECT_FALSE(Metrics::IsEnabled());
+  Metrics::SetSink(&registry);
+  Metrics::ReportPair(0, 1.0);
+  Metrics::ReportPair(8, 1.0);
+  Metrics::ReportDroppedPatches(4);
+  Metrics::ReportReferenceCacheLookup(true);
+  {
+    ScopedStageTimer timer(nullptr, &StageTimings::fine_alignment);
+  }
+  Metrics::SetSink(nullptr);
+  Metrics::ReportPair(0, 1.0);
+
+  const std::string text = registry.FormatText();
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_pairs_total{code=\"OK\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_pairs_total{code=\"RESOURCE_EXHAUSTED\"} 1\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("visqol_dropped_patches_total 4\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_reference_cache_lookups_total{result=\"hit\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find(
+      "visqol_stage_seconds{stage=\"fine_alignment\"} count=1"));
+}
+
+// Ensure that label values are escaped.
+TEST(MetricsTest, EscapesLabelValues) {
+  MetricsRegistry registry;
+  registry.IncrementCounter("c", {{"path", "a\"b\\c"}}, 1);
+  EXPECT_NE(std::string::npos,
+            registry.FormatPrometheus().find("c{path=\"a\\\"b\\\\c\"} 1\n"));
+}
+}  // namespace
+}  // namespace Visqol
@@ -14,9 +14,18 @@
 
 #include "misc_audio.h"
 
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
 #include "gtest/gtest.h"
 
+#include "amatrix.h"
+#include "audio_signal.h"
 #include "file_path.h"
+#include "misc_math.h"
+#include "wav_reader.h"
 
 namespace Visqol {
 namespace {
@@ -58,5 +67,86 @@ TEST(LoadAsMono, Stereo) {
               kDurationTolerance);
 }
 
+// Ensure that decoding a stereo file in a single pass gives exactly the same
+// samples as decoding its channels and then mixing them down.
+TEST(LoadAsMono, StereoMatchesMixedChannels) {
+  FilePath stereo_file{
+      "testdata/conformance_testdata_subset/guitar48_stereo.wav"};
+  std::ifstream wav_file(stereo_file.Path().c_str(), std::ios::binary);
+  WavReader wav_reader(&wav_file);
+  ASSERT_TRUE(wav_reader.IsHeaderValid());
+  std::vector<int16_t> interleaved(wav_reader.GetNumTotalSamples());
+  ASSERT_EQ(interleaved.size(),
+            wav_reader.ReadSamples(interleaved.size(), interleaved.data()));
+  const std::vector<double> normalized =
+      MiscMath::NormalizeInt16ToDouble(interleaved);
+  const size_t num_channels = wav_reader.GetNumChannels();
+  ASSERT_EQ(2, num_channels);
+  // The channels are mixed down as MiscAudio::ToMono does.
+  std::vector<double> expected(normalized.size() / num_channels, 0.0);
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (size_t channel = 0; channel < num_channels; channel++) {
+      expected[i] += normalized[i * num_channels + channel];
+    }
+    expected[i] /= num_channels;
+  }
+
+  const AudioSignal loaded = MiscAudio::LoadAsMono(stereo_file);
+  ASSERT_EQ(expected.size(), loaded.data_matrix.NumRows());
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(expected[i], loaded.data_matrix(i));
+  }
+}
+
+// Ensure that scaling the degraded signal in place scales it so that its RMS
+// matches that of the reference, as the copying overload does.
+TEST(ScaleToMatchSoundPressureLevel, InPlace) {
+  const auto rms = [](const AudioSignal &signal) {
+    double sum = 0.0;
+    for (size_t i = 0; i < signal.data_matrix.NumElements(); i++) {
+      sum += signal.data_matrix(i) * signal.data_matrix(i);
+    }
+    return std::sqrt(sum / signal.data_matrix.NumElements());
+  };
+  const AudioSignal reference = MiscAudio::LoadAsMono(
+      FilePath("testdata/clean_speech/CA01_01.wav"));
+  AudioSignal degraded = MiscAudio::LoadAsMono(
+      FilePath("testdata/clean_speech/transcoded_CA01_01.wav"));
+  const double scale_factor = rms(reference) / rms(degraded);
+  const AudioSignal scaled =
+      MiscAudio::ScaleToMatchSoundPressureLevel(reference, degraded);
+  const AMatrix<double> original = degraded.data_matrix;
+  MiscAudio::ScaleToMatchSoundPressureLevel(reference, &degraded);
+  ASSERT_EQ(original.NumRows(), degraded.data_matrix.NumRows());
+  for (size_t i = 0; i < original.NumElements(); i++) {
+    ASSERT_EQ(scaled.data_matrix(i), degraded.data_matrix(i));
+    ASSERT_NEAR(original(i) * scale_factor, degraded.data_matrix(i), 1e-12);
+  }
+}
+
+// Ensure that a degraded signal matches the reference once scaled if it only
+// differs by its level, and only matches a different signal within the
+// tolerance.
+TEST(MatchesAfterScaling, ScaledCopies) {
+  const AudioSignal reference = MiscAudio::LoadAsMono(
+      FilePath("testdata/clean_speech/CA01_01.wav"));
+  EXPECT_TRUE(MiscAudio::MatchesAfterScaling(reference, reference, 0.0));
+
+  AudioSignal quieter = reference;
+  for (double &sample : quieter.data_matrix) {
+    sample *= 0.5;
+  }
+  EXPECT_TRUE(MiscAudio::MatchesAfterScaling(reference, quieter, 1e-12));
+
+  AudioSignal changed = reference;
+  changed.data_matrix(changed.data_matrix.NumRows() / 2) += 1e-3;
+  EXPECT_FALSE(MiscAudio::MatchesAfterScaling(reference, changed, 0.0));
+  EXPECT_TRUE(MiscAudio::MatchesAfterScaling(reference, changed, 1e-2));
+
+  const AudioSignal other = MiscAudio::LoadAsMono(
+      FilePath("testdata/clean_speech/transcoded_CA01_01.wav"));
+  EXPECT_FALSE(MiscAudio::MatchesAfterScaling(reference, other, 1e-2));
+}
+
 }  // namespace
 }  // namespace Visqol
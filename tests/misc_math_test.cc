@@ -14,7 +14,12 @@
 
 #include "misc_math.h"
 
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "absl/types/span.h"
 
 namespace Visqol {
 namespace {
@@ -30,5 +35,41 @@ TEST(MiscMath, NextPowTwoTest) {
   }
 }
 
+// Ensure that FastLog10 stays within its error bound across the range of
+// doubles, and matches std::log10 for the values it does not approximate.
+TEST(MiscMath, FastLog10Test) {
+  std::vector<double> inputs = {1.0, 2.0, 0.5, 10.0, 1e-3, 1.4142135623730951,
+      1.4142135623730950, 0.7071067811865476, 2.220446049250313e-16,
+      std::numeric_limits<double>::min(), std::numeric_limits<double>::max()};
+  for (double x = 1e-300; x < 1e300; x *= 1.37) {
+    inputs.push_back(x);
+  }
+  for (const double x : inputs) {
+    EXPECT_NEAR(std::log10(x), MiscMath::FastLog10(x),
+                MiscMath::kFastLog10MaxError) << x;
+  }
+
+  const std::vector<double> special = {0.0, 1e-310,
+      std::numeric_limits<double>::infinity()};
+  for (const double x : special) {
+    EXPECT_EQ(std::log10(x), MiscMath::FastLog10(x)) << x;
+  }
+  EXPECT_TRUE(std::isnan(MiscMath::FastLog10(-1.0)));
+  EXPECT_TRUE(std::isnan(MiscMath::FastLog10(
+      std::numeric_limits<double>::quiet_NaN())));
+
+  // The span version must match the scalar version, including when some lanes
+  // need the fallback, and when run in place.
+  inputs.insert(inputs.begin() + 3, special.begin(), special.end());
+  std::vector<double> outputs(inputs.size());
+  MiscMath::FastLog10(inputs, absl::MakeSpan(outputs));
+  for (size_t i = 0; i < inputs.size(); i++) {
+    EXPECT_EQ(MiscMath::FastLog10(inputs[i]), outputs[i]) << inputs[i];
+  }
+  std::vector<double> in_place = inputs;
+  MiscMath::FastLog10(in_place, absl::MakeSpan(in_place));
+  EXPECT_EQ(outputs, in_place);
+}
+
 }  // namespace
 }  // namespace Visqol
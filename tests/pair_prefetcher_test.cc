@@ -0,0 +1,104 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pair_prefetcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+const size_t kNumPairs = 7;
+
+std::vector<ReferenceDegradedPathPair> MakePairs() {
+  std::vector<ReferenceDegradedPathPair> pairs;
+  for (size_t i = 0; i < kNumPairs; i++) {
+    pairs.push_back({FilePath("ref" + std::to_string(i)),
+                     FilePath("deg" + std::to_string(i))});
+  }
+  return pairs;
+}
+
+// Counts the loads that are in progress at once, and returns a signal whose
+// sample rate identifies the file that was loaded.
+class FakeLoader {
+ public:
+  AudioSignal Load(const FilePath &path) {
+    const size_t num_loading = ++num_loading_;
+    size_t max = max_loading_;
+    while (num_loading > max &&
+           !max_loading_.compare_exchange_weak(max, num_loading)) {}
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    num_loading_--;
+    const std::string name = path.Path();
+    const size_t index = std::stoul(name.substr(3));
+    return AudioSignal{AMatrix<double>(std::vector<double>(1, 0.0)),
+                       (name[0] == 'r' ? 1000 : 2000) + index};
+  }
+
+  size_t MaxLoading() const { return max_loading_; }
+
+ private:
+  std::atomic<size_t> num_loading_{0};
+  std::atomic<size_t> max_loading_{0};
+};
+
+// Ensure that the pairs are read in order, whether or not they are
+// prefetched, and that no more than the given number of pairs are loading at
+// once.
+TEST(PairPrefetcherTest, ReadsPairsInOrder) {
+  const std::vector<ReferenceDegradedPathPair> pairs = MakePairs();
+  for (const size_t num_prefetch_pairs : {0, 1, 3, 10}) {
+    FakeLoader loader;
+    {
+      PairPrefetcher prefetcher(pairs, num_prefetch_pairs,
+          [&loader](const FilePath &path) { return loader.Load(path); });
+      for (size_t i = 0; i < kNumPairs; i++) {
+        ASSERT_TRUE(prefetcher.HasNext());
+        const PairPrefetcher::LoadedPair loaded = prefetcher.Next();
+        EXPECT_EQ(1000 + i, loaded.reference.sample_rate);
+        EXPECT_EQ(2000 + i, loaded.degraded.sample_rate);
+      }
+      EXPECT_FALSE(prefetcher.HasNext());
+    }
+    // The reference and degraded files of a pair are loaded in turn.
+    EXPECT_LE(loader.MaxLoading(), std::max<size_t>(num_prefetch_pairs, 1));
+  }
+}
+
+// Ensure that a prefetcher that is destroyed before every pair has been read
+// waits for the pairs that are still loading.
+TEST(PairPrefetcherTest, StopsEarly) {
+  const std::vector<ReferenceDegradedPathPair> pairs = MakePairs();
+  FakeLoader loader;
+  {
+    PairPrefetcher prefetcher(pairs, 4,
+        [&loader](const FilePath &path) { return loader.Load(path); });
+    EXPECT_EQ(1000, prefetcher.Next().reference.sample_rate);
+  }
+  EXPECT_LE(loader.MaxLoading(), 4);
+}
+}  // namespace
+}  // namespace Visqol
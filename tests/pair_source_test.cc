@@ -0,0 +1,123 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "pair_source.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+// Read every pair of a source.
+std::vector<ReferenceDegradedPathPair> ReadAll(PairSource *source) {
+  std::vector<ReferenceDegradedPathPair> pairs;
+  ReferenceDegradedPathPair pair;
+  while (source->Next(&pair)) {
+    pairs.push_back(pair);
+  }
+  return pairs;
+}
+
+// Create an empty file.
+void Touch(const boost::filesystem::path &path) {
+  std::ofstream file(path.string());
+}
+
+// Ensure that the pairs of a batch CSV file are read in order, with their
+// header, line endings, extra columns and blank lines ignored.
+TEST(ManifestPairSource, ReadsThePairsInOrder) {
+  const std::string path = ::testing::TempDir() + "/manifest.csv";
+  {
+    std::ofstream manifest(path);
+    manifest << "reference,degraded,moslqs\r\n"
+             << "ref1.wav,deg1.wav\r\n"
+             << "\n"
+             << "ref2.wav,deg2.wav,4.1\n";
+  }
+  ManifestPairSource source{FilePath(path)};
+  const auto pairs = ReadAll(&source);
+  ASSERT_EQ(2, pairs.size());
+  EXPECT_EQ("ref1.wav", pairs[0].reference.Path());
+  EXPECT_EQ("deg1.wav", pairs[0].degraded.Path());
+  EXPECT_EQ("ref2.wav", pairs[1].reference.Path());
+  EXPECT_EQ("deg2.wav", pairs[1].degraded.Path());
+}
+
+// Ensure that a batch CSV file that does not exist has no pairs.
+TEST(ManifestPairSource, MissingFileHasNoPairs) {
+  ManifestPairSource source{FilePath("does_not_exist.csv")};
+  ReferenceDegradedPathPair pair;
+  EXPECT_FALSE(source.Next(&pair));
+}
+
+// Ensure that the files of a reference directory that match the pattern are
+// paired with the degraded files of the same name, and that the files
+// without a degraded file are skipped.
+TEST(DirectoryPairSource, PairsFilesByName) {
+  const boost::filesystem::path root =
+      boost::filesystem::path(::testing::TempDir()) / "pair_source_dirs";
+  const boost::filesystem::path ref_dir = root / "ref";
+  const boost::filesystem::path deg_dir = root / "deg";
+  boost::filesystem::remove_all(root);
+  boost::filesystem::create_directories(ref_dir / "nested.wav");
+  boost::filesystem::create_directories(deg_dir);
+  for (const char *name : {"a.wav", "b.wav", "c.wav", "notes.txt"}) {
+    Touch(ref_dir / name);
+  }
+  for (const char *name : {"a.wav", "c.wav", "notes.txt"}) {
+    Touch(deg_dir / name);
+  }
+
+  DirectoryPairSource source(FilePath(ref_dir.string()),
+                             FilePath(deg_dir.string()), "*.wav");
+  auto pairs = ReadAll(&source);
+  std::sort(pairs.begin(), pairs.end(),
+            [](const ReferenceDegradedPathPair &a,
+               const ReferenceDegradedPathPair &b) {
+              return a.reference.Path() < b.reference.Path();
+            });
+  ASSERT_EQ(2, pairs.size());
+  EXPECT_EQ((ref_dir / "a.wav").string(), pairs[0].reference.Path());
+  EXPECT_EQ((deg_dir / "a.wav").string(), pairs[0].degraded.Path());
+  EXPECT_EQ((ref_dir / "c.wav").string(), pairs[1].reference.Path());
+  EXPECT_EQ((deg_dir / "c.wav").string(), pairs[1].degraded.Path());
+}
+
+// Ensure that `*` matches any run of characters and `?` any one character,
+// and that the whole name must match.
+TEST(DirectoryPairSource, MatchesPatterns) {
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern("a.wav", "*.wav"));
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern(".wav", "*.wav"));
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern("a.wav.wav", "*.wav"));
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern("take_01.wav", "take_??.*"));
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern("abcbd", "a*b*d"));
+  EXPECT_TRUE(DirectoryPairSource::MatchesPattern("anything", "*"));
+  EXPECT_FALSE(DirectoryPairSource::MatchesPattern("a.wave", "*.wav"));
+  EXPECT_FALSE(DirectoryPairSource::MatchesPattern("take_1.wav", "take_??.*"));
+  EXPECT_FALSE(DirectoryPairSource::MatchesPattern("abcb", "a*b*d"));
+  EXPECT_FALSE(DirectoryPairSource::MatchesPattern("a", ""));
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,85 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "patch_view.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "image_patch_creator.h"
+#include "neurogram_similiarity_index_measure.h"
+
+namespace Visqol {
+namespace {
+
+// A 3 row matrix where each value encodes its own row and column.
+AMatrix<double> MakeMatrix(size_t num_cols) {
+  AMatrix<double> matrix(3, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < 3; r++) {
+      matrix(r, c) = 10.0 * (c + 1) + r;
+    }
+  }
+  return matrix;
+}
+
+// Ensure that a view reads the viewed columns, and silence outside them.
+TEST(PatchViewTest, ViewWithSilence) {
+  const AMatrix<double> matrix = MakeMatrix(5);
+  const PatchView view(matrix, -2, 9);
+  ASSERT_EQ(3, view.NumRows());
+  ASSERT_EQ(9, view.NumCols());
+  for (size_t c = 0; c < view.NumCols(); c++) {
+    const int matrix_col = static_cast<int>(c) - 2;
+    for (size_t r = 0; r < view.NumRows(); r++) {
+      const double expected = (matrix_col < 0 || matrix_col >= 5) ? 0.0 :
+          matrix(r, matrix_col);
+      EXPECT_EQ(expected, view(r, c));
+    }
+  }
+
+  const AMatrix<double> copy = view.ToMatrix();
+  ASSERT_EQ(3, copy.NumRows());
+  ASSERT_EQ(9, copy.NumCols());
+  EXPECT_EQ(0.0, copy(1, 1));
+  EXPECT_EQ(matrix(1, 0), copy(1, 2));
+  EXPECT_EQ(matrix(2, 4), copy(2, 6));
+  EXPECT_EQ(0.0, copy(0, 8));
+}
+
+// Ensure that the patches created from indices view the spectrogram, and so
+// compare the same as copies of those columns.
+TEST(PatchViewTest, PatchesFromIndices) {
+  const AMatrix<double> spectrogram = MakeMatrix(12);
+  ImagePatchCreator creator(4);
+  const std::vector<size_t> indices{1, 5};
+  const std::vector<PatchView> patches =
+      creator.CreatePatchesFromIndices(spectrogram, indices);
+  ASSERT_EQ(2, patches.size());
+
+  NeurogramSimiliarityIndexMeasure nsim;
+  for (size_t i = 0; i < patches.size(); i++) {
+    const AMatrix<double> copy = spectrogram.GetColumns(indices[i],
+                                                        indices[i] + 3);
+    EXPECT_EQ(copy, patches[i].ToMatrix());
+    const AMatrix<double> other = MakeMatrix(4) * 0.5;
+    EXPECT_EQ(nsim.MeasurePatchSimilarity(copy, other).similarity,
+              nsim.MeasurePatchSimilarity(patches[i], other).similarity);
+  }
+}
+
+}  // namespace
+}  // namespace Visqol
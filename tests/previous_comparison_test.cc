@@ -0,0 +1,135 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "previous_comparison.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "patch_similarity_comparator.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kNumBlocks = 40;
+const size_t kPatchSize = 30;
+const double kFrameDuration = 0.01;
+const double kWindowDuration = 0.02;
+const uint64_t kRefHash = 0x1234;
+const uint64_t kConfigHash = 0x5678;
+
+// An earlier result with patches at reference frames 0, 100 and 200.
+SimilarityResultMsg MakePreviousResult() {
+  SimilarityResultMsg result;
+  result.set_reference_hash(kRefHash);
+  result.set_config_hash(kConfigHash);
+  for (size_t block = 0; block < kNumBlocks; block++) {
+    result.add_degraded_block_hashes(block);
+  }
+  for (const size_t index : {0, 100, 200}) {
+    auto patch = result.add_patch_sims();
+    patch->set_similarity(0.5 + index / 1000.0);
+    patch->add_freq_band_means(0.25);
+    patch->add_freq_band_means(0.75);
+    patch->set_ref_patch_start_time(index * kFrameDuration);
+    patch->set_ref_patch_end_time((index + kPatchSize) * kFrameDuration);
+    patch->set_deg_patch_start_time(index * kFrameDuration);
+    patch->set_deg_patch_end_time((index + kPatchSize) * kFrameDuration);
+  }
+  return result;
+}
+
+std::vector<uint64_t> UnchangedHashes() {
+  std::vector<uint64_t> hashes;
+  for (size_t block = 0; block < kNumBlocks; block++) {
+    hashes.push_back(block);
+  }
+  return hashes;
+}
+
+// Ensure that only the patches whose search reads a changed block are
+// compared again, and that the others reuse their earlier results.
+TEST(PreviousComparison, ReusesPatchesAwayFromChanges) {
+  std::vector<uint64_t> hashes = UnchangedHashes();
+  // Block 12 covers 1.024 to 1.109 seconds, which the search of the patch at
+  // frame 100 reads.
+  hashes[12] = 1000;
+  const auto previous = PreviousComparison::Create(MakePreviousResult(),
+      hashes, kRefHash, kConfigHash, kSampleRate);
+  ASSERT_NE(nullptr, previous);
+  ASSERT_EQ(1, previous->ChangedRanges().size());
+
+  std::vector<PatchSimilarityResult> reused;
+  const std::vector<size_t> to_compare = previous->SplitPatches(
+      {0, 100, 200, 300}, kPatchSize, kFrameDuration, kWindowDuration,
+      &reused);
+  // The patch at frame 300 has no earlier result.
+  EXPECT_EQ(std::vector<size_t>({100, 300}), to_compare);
+  ASSERT_EQ(2, reused.size());
+  EXPECT_DOUBLE_EQ(0.5, reused[0].similarity);
+  EXPECT_DOUBLE_EQ(0.7, reused[1].similarity);
+  EXPECT_DOUBLE_EQ(2.0, reused[1].ref_patch_start_time);
+  ASSERT_EQ(2, reused[1].freq_band_means.NumElements());
+  EXPECT_DOUBLE_EQ(0.75, reused[1].freq_band_means(1));
+}
+
+// Ensure that a degraded signal that grew changes the patches at its end.
+TEST(PreviousComparison, LongerSignalChangesItsEnd) {
+  std::vector<uint64_t> hashes = UnchangedHashes();
+  hashes.push_back(kNumBlocks);
+  const auto previous = PreviousComparison::Create(MakePreviousResult(),
+      hashes, kRefHash, kConfigHash, kSampleRate);
+  ASSERT_NE(nullptr, previous);
+  ASSERT_EQ(1, previous->ChangedRanges().size());
+  EXPECT_DOUBLE_EQ(kNumBlocks * PreviousComparison::kBlockSamples /
+                   static_cast<double>(kSampleRate),
+                   previous->ChangedRanges()[0].first);
+  EXPECT_TRUE(previous->SplitPatches({0, 100, 200}, kPatchSize,
+      kFrameDuration, kWindowDuration, nullptr).empty());
+}
+
+// Ensure that the patches are only reused at the earlier lag, and that a
+// result without block hashes cannot be reused.
+TEST(PreviousComparison, RequiresHashesAndTheSameLag) {
+  SimilarityResultMsg result = MakePreviousResult();
+  result.set_global_lag(0.25);
+  const auto previous = PreviousComparison::Create(result, UnchangedHashes(),
+      kRefHash, kConfigHash, kSampleRate);
+  ASSERT_NE(nullptr, previous);
+  EXPECT_TRUE(previous->MatchesGlobalLag(0.25));
+  EXPECT_FALSE(previous->MatchesGlobalLag(0.25 + 1.0 / kSampleRate));
+
+  result.clear_degraded_block_hashes();
+  EXPECT_EQ(nullptr, PreviousComparison::Create(result, UnchangedHashes(),
+      kRefHash, kConfigHash, kSampleRate));
+}
+
+// Ensure that a result of another reference, or of other options, such as
+// those of speech mode with fewer bands, is not reused.
+TEST(PreviousComparison, RequiresTheSameReferenceAndOptions) {
+  const SimilarityResultMsg result = MakePreviousResult();
+  EXPECT_EQ(nullptr, PreviousComparison::Create(result, UnchangedHashes(),
+      kRefHash + 1, kConfigHash, kSampleRate));
+  EXPECT_EQ(nullptr, PreviousComparison::Create(result, UnchangedHashes(),
+      kRefHash, kConfigHash + 1, kSampleRate));
+  EXPECT_NE(nullptr, PreviousComparison::Create(result, UnchangedHashes(),
+      kRefHash, kConfigHash, kSampleRate));
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,89 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference_cache.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+std::shared_ptr<const ReferenceCache::Entry> MakeEntry(size_t sample_rate) {
+  auto entry = std::make_shared<ReferenceCache::Entry>();
+  entry->signal.sample_rate = sample_rate;
+  return entry;
+}
+
+// Ensure that the least recently used reference is dropped once the cache is
+// full, where finding a reference counts as using it.
+TEST(ReferenceCacheTest, DropsLeastRecentlyUsed) {
+  ReferenceCache cache(2);
+  cache.Insert("a", MakeEntry(1));
+  cache.Insert("b", MakeEntry(2));
+  ASSERT_NE(nullptr, cache.Find("a"));
+  cache.Insert("c", MakeEntry(3));
+
+  EXPECT_EQ(2u, cache.Size());
+  EXPECT_EQ(nullptr, cache.Find("b"));
+  ASSERT_NE(nullptr, cache.Find("a"));
+  EXPECT_EQ(1u, cache.Find("a")->signal.sample_rate);
+  ASSERT_NE(nullptr, cache.Find("c"));
+  EXPECT_EQ(3u, cache.Find("c")->signal.sample_rate);
+
+  // Replacing a reference does not grow the cache.
+  cache.Insert("c", MakeEntry(4));
+  EXPECT_EQ(2u, cache.Size());
+  EXPECT_EQ(4u, cache.Find("c")->signal.sample_rate);
+}
+
+// Ensure that a cache with no capacity, and files that cannot be read, keep
+// nothing.
+TEST(ReferenceCacheTest, KeepsNothingWithoutCapacityOrKey) {
+  ReferenceCache empty_cache(0);
+  empty_cache.Insert("a", MakeEntry(1));
+  EXPECT_EQ(0u, empty_cache.Size());
+
+  const FilePath missing(::testing::TempDir() + "/missing_reference.wav");
+  EXPECT_EQ("", ReferenceCache::KeyOf(missing));
+  ReferenceCache cache(1);
+  cache.Insert(ReferenceCache::KeyOf(missing), MakeEntry(1));
+  EXPECT_EQ(0u, cache.Size());
+}
+
+// Ensure that a file is keyed by its contents as well as its path, so that a
+// rewritten file is not found in the cache.
+TEST(ReferenceCacheTest, KeyChangesWhenFileIsRewritten) {
+  const std::string path = ::testing::TempDir() + "/cached_reference.wav";
+  {
+    std::ofstream out(path, std::ios_base::trunc);
+    out << "short";
+  }
+  const std::string key = ReferenceCache::KeyOf(FilePath(path));
+  EXPECT_NE("", key);
+  EXPECT_EQ(key, ReferenceCache::KeyOf(FilePath(path)));
+  {
+    std::ofstream out(path, std::ios_base::trunc);
+    out << "longer contents";
+  }
+  EXPECT_NE(key, ReferenceCache::KeyOf(FilePath(path)));
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,117 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference_feature_store.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "file_path.h"
+#include "spectrogram.h"
+#include "visqol.h"
+
+namespace Visqol {
+namespace {
+
+const uint64_t kConfigHash = 1234;
+const char kReferenceKey[] = "ref.wav\n100\n200";
+
+ReferenceFeatures MakeFeatures() {
+  ReferenceFeatures features;
+  features.spectrogram = Spectrogram(AMatrix<double>(
+      2, 3, std::vector<double>{1.0, 2.0, 3.0, 4.0, 5.0, 6.0}));
+  features.spectrogram.SetCenterFreqBands({50.0, 150.0});
+  features.patch_indices = {0, 2};
+  features.upper_envelope = {0.5, 0.25};
+  return features;
+}
+
+AudioSignal MakeSignal() {
+  return AudioSignal{AMatrix<double>(std::vector<double>(8, 0.0)), 48000};
+}
+
+// Ensure that saved features are loaded back as they were.
+TEST(ReferenceFeatureStoreTest, SaveAndLoad) {
+  const ReferenceFeatureStore store(::testing::TempDir(), kConfigHash);
+  const FilePath reference("golden/ref.wav");
+  const AudioSignal signal = MakeSignal();
+  ASSERT_TRUE(store.Save(reference, kReferenceKey, signal, MakeFeatures()));
+
+  auto loaded = store.Load(reference, kReferenceKey, signal);
+  ASSERT_NE(nullptr, loaded);
+  const ReferenceFeatures expected = MakeFeatures();
+  EXPECT_EQ(expected.spectrogram.Data().ToVector(),
+            loaded->spectrogram.Data().ToVector());
+  EXPECT_EQ(2u, loaded->spectrogram.Data().NumRows());
+  EXPECT_EQ(3u, loaded->spectrogram.Data().NumCols());
+  EXPECT_EQ(expected.spectrogram.GetCenterFreqBands(),
+            loaded->spectrogram.GetCenterFreqBands());
+  EXPECT_EQ(expected.patch_indices, loaded->patch_indices);
+  EXPECT_EQ(expected.upper_envelope, loaded->upper_envelope);
+}
+
+// Ensure that features are ignored if they are missing, or were built with
+// other options, from another version of the file or from another signal.
+TEST(ReferenceFeatureStoreTest, IgnoresMissingAndStaleFeatures) {
+  const ReferenceFeatureStore store(::testing::TempDir(), kConfigHash);
+  const FilePath reference("golden/stale_ref.wav");
+  const AudioSignal signal = MakeSignal();
+  EXPECT_EQ(nullptr, store.Load(reference, kReferenceKey, signal));
+  ASSERT_TRUE(store.Save(reference, kReferenceKey, signal, MakeFeatures()));
+
+  EXPECT_EQ(nullptr, store.Load(reference, "ref.wav\n100\n300", signal));
+  const AudioSignal longer{AMatrix<double>(std::vector<double>(9, 0.0)),
+                           48000};
+  EXPECT_EQ(nullptr, store.Load(reference, kReferenceKey, longer));
+  const ReferenceFeatureStore other_store(::testing::TempDir(),
+                                          kConfigHash + 1);
+  EXPECT_EQ(nullptr, other_store.Load(reference, kReferenceKey, signal));
+  EXPECT_NE(nullptr, store.Load(reference, kReferenceKey, signal));
+}
+
+// Ensure that messages whose bands or patches do not match their spectrogram
+// are not converted back to features.
+TEST(ReferenceFeatureStoreTest, RejectsInconsistentMessages) {
+  const ReferenceFeaturesMsg msg = ReferenceFeatureStore::ToMsg(
+      kReferenceKey, MakeSignal(), MakeFeatures());
+  EXPECT_NE(nullptr, ReferenceFeatureStore::FromMsg(msg));
+
+  ReferenceFeaturesMsg missing_band = msg;
+  missing_band.mutable_center_freq_bands()->RemoveLast();
+  EXPECT_EQ(nullptr, ReferenceFeatureStore::FromMsg(missing_band));
+
+  ReferenceFeaturesMsg missing_values = msg;
+  missing_values.mutable_spectrogram()->RemoveLast();
+  EXPECT_EQ(nullptr, ReferenceFeatureStore::FromMsg(missing_values));
+
+  ReferenceFeaturesMsg late_patch = msg;
+  late_patch.add_patch_indices(msg.num_frames());
+  EXPECT_EQ(nullptr, ReferenceFeatureStore::FromMsg(late_patch));
+}
+
+// Ensure that references with different paths are saved to different files.
+TEST(ReferenceFeatureStoreTest, PathsDependOnReference) {
+  const ReferenceFeatureStore store("features", kConfigHash);
+  EXPECT_NE(store.PathFor(FilePath("a/ref.wav")),
+            store.PathFor(FilePath("b/ref.wav")));
+  EXPECT_EQ(store.PathFor(FilePath("a/ref.wav")),
+            store.PathFor(FilePath("a/ref.wav")));
+  EXPECT_EQ(0u, store.PathFor(FilePath("a/ref.wav")).find("features/"));
+}
+
+}  // namespace
+}  // namespace Visqol
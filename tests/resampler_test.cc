@@ -0,0 +1,99 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resampler.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+
+namespace Visqol {
+namespace {
+
+// The samples at the start and end of a resampled signal that are affected
+// by the zero padding.
+const size_t kEdgeSamples = 200;
+
+std::vector<double> Sine(double freq, size_t sample_rate, size_t num_samples) {
+  std::vector<double> samples(num_samples);
+  for (size_t i = 0; i < num_samples; i++) {
+    samples[i] = std::sin(2.0 * M_PI * freq * i / sample_rate);
+  }
+  return samples;
+}
+
+// The RMS of a signal, away from its edges.
+double InteriorRms(const std::vector<double> &samples) {
+  double sum = 0.0;
+  for (size_t i = kEdgeSamples; i < samples.size() - kEdgeSamples; i++) {
+    sum += samples[i] * samples[i];
+  }
+  return std::sqrt(sum / (samples.size() - 2 * kEdgeSamples));
+}
+
+std::vector<double> Resample(const std::vector<double> &samples,
+                             size_t input_rate, size_t output_rate) {
+  const Resampler resampler(input_rate, output_rate);
+  std::vector<double> output(resampler.GetNumOutputSamples(samples.size()));
+  resampler.Process(samples, absl::MakeSpan(output));
+  return output;
+}
+
+// Ensure that a tone resampled from 44.1k to 48k matches the same tone
+// generated at 48k.
+TEST(ResamplerTest, UpsampledToneMatchesGeneratedTone) {
+  const std::vector<double> resampled = Resample(Sine(1000.0, 44100, 44100),
+                                                 44100, 48000);
+  ASSERT_EQ(48000, resampled.size());
+  const std::vector<double> expected = Sine(1000.0, 48000, 48000);
+  for (size_t i = kEdgeSamples; i < resampled.size() - kEdgeSamples; i++) {
+    ASSERT_NEAR(expected[i], resampled[i], 1e-3);
+  }
+}
+
+// Ensure that downsampling from 48k to 16k keeps a tone below the new
+// Nyquist frequency and removes one above it, rather than aliasing it.
+TEST(ResamplerTest, DownsamplingRemovesTonesAboveNyquist) {
+  const std::vector<double> kept = Resample(Sine(1000.0, 48000, 48000),
+                                            48000, 16000);
+  const std::vector<double> removed = Resample(Sine(12000.0, 48000, 48000),
+                                               48000, 16000);
+  ASSERT_EQ(16000, kept.size());
+  EXPECT_NEAR(std::sqrt(0.5), InteriorRms(kept), 1e-3);
+  EXPECT_LT(InteriorRms(removed), 1e-3);
+}
+
+// Ensure that a signal at the target rate is returned as is, and that the
+// rate of a resampled signal is updated.
+TEST(ResamplerTest, ResampleAudioSignal) {
+  const std::vector<double> samples(1000, 0.25);
+  const AudioSignal signal{AMatrix<double>(samples), 48000};
+  const AudioSignal same = Resampler::Resample(signal, 48000);
+  EXPECT_EQ(48000, same.sample_rate);
+  ASSERT_EQ(1000, same.data_matrix.NumRows());
+  EXPECT_EQ(0.25, same.data_matrix(500));
+
+  const AudioSignal resampled = Resampler::Resample(signal, 16000);
+  EXPECT_EQ(16000, resampled.sample_rate);
+  ASSERT_EQ(334, resampled.data_matrix.NumRows());
+  // The filter has unity gain at DC.
+  EXPECT_NEAR(0.25, resampled.data_matrix(167), 1e-12);
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,147 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "result_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "audio_signal.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+AudioSignal MakeSignal(double scale) {
+  std::vector<double> samples(100);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = scale * i;
+  }
+  return AudioSignal{AMatrix<double>(samples), 48000};
+}
+
+SimilarityResultMsg MakeResult(double moslqo) {
+  SimilarityResultMsg sim_res_msg;
+  sim_res_msg.set_reference_filepath("ref.wav");
+  sim_res_msg.set_degraded_filepath("deg.wav");
+  sim_res_msg.set_moslqo(moslqo);
+  sim_res_msg.add_fvnsim(0.5);
+  sim_res_msg.mutable_timings()->set_coarse_search(0.25);
+  return sim_res_msg;
+}
+
+// Ensure that the hash of a signal depends on its samples and rate only.
+TEST(ResultCacheTest, HashSignal) {
+  EXPECT_EQ(ResultCache::HashSignal(MakeSignal(1.0)),
+            ResultCache::HashSignal(MakeSignal(1.0)));
+  EXPECT_NE(ResultCache::HashSignal(MakeSignal(1.0)),
+            ResultCache::HashSignal(MakeSignal(2.0)));
+  AudioSignal resampled = MakeSignal(1.0);
+  resampled.sample_rate = 16000;
+  EXPECT_NE(ResultCache::HashSignal(MakeSignal(1.0)),
+            ResultCache::HashSignal(resampled));
+}
+
+// Ensure that only the blocks whose samples differ have different hashes,
+// and that the last block may be shorter.
+TEST(ResultCacheTest, HashSignalBlocks) {
+  const AudioSignal signal = MakeSignal(1.0);
+  AudioSignal edited = signal;
+  edited.data_matrix(45) = -1.0;
+  const auto hashes = ResultCache::HashSignalBlocks(signal, 30);
+  const auto edited_hashes = ResultCache::HashSignalBlocks(edited, 30);
+  ASSERT_EQ(4, hashes.size());
+  ASSERT_EQ(4, edited_hashes.size());
+  EXPECT_EQ(hashes[0], edited_hashes[0]);
+  EXPECT_NE(hashes[1], edited_hashes[1]);
+  EXPECT_EQ(hashes[2], edited_hashes[2]);
+  EXPECT_EQ(hashes[3], edited_hashes[3]);
+}
+
+// Ensure that results are found by their key, without their paths and
+// timings, and that they are found again once the file is reopened.
+TEST(ResultCacheTest, FindsResultsAcrossRuns) {
+  const std::string path = ::testing::TempDir() + "/results.vqcache";
+  std::remove(path.c_str());
+  const auto key = ResultCache::KeyOf(1, MakeSignal(1.0), MakeSignal(2.0));
+  const auto other_config = ResultCache::KeyOf(2, MakeSignal(1.0),
+                                               MakeSignal(2.0));
+  {
+    ResultCache cache(path);
+    ASSERT_TRUE(cache.ok());
+    SimilarityResultMsg sim_res_msg;
+    EXPECT_FALSE(cache.Find(key, &sim_res_msg));
+    cache.Insert(key, MakeResult(4.5));
+    cache.Insert(key, MakeResult(1.0));
+    ASSERT_TRUE(cache.Find(key, &sim_res_msg));
+    EXPECT_EQ(4.5, sim_res_msg.moslqo());
+    EXPECT_FALSE(cache.Find(other_config, &sim_res_msg));
+  }
+
+  ResultCache cache(path);
+  EXPECT_EQ(1u, cache.size());
+  SimilarityResultMsg sim_res_msg;
+  ASSERT_TRUE(cache.Find(key, &sim_res_msg));
+  EXPECT_EQ(4.5, sim_res_msg.moslqo());
+  ASSERT_EQ(1, sim_res_msg.fvnsim_size());
+  EXPECT_EQ("", sim_res_msg.reference_filepath());
+  EXPECT_FALSE(sim_res_msg.has_timings());
+}
+
+// Ensure that a partial record at the end of the file, left by a run that was
+// killed, does not lose the results before it or those added after it.
+TEST(ResultCacheTest, RecoversFromPartialRecord) {
+  const std::string path = ::testing::TempDir() + "/partial.vqcache";
+  std::remove(path.c_str());
+  const auto first = ResultCache::KeyOf(1, MakeSignal(1.0), MakeSignal(2.0));
+  const auto second = ResultCache::KeyOf(1, MakeSignal(1.0), MakeSignal(3.0));
+  {
+    ResultCache cache(path);
+    cache.Insert(first, MakeResult(4.5));
+  }
+  {
+    std::ofstream file(path, std::ios_base::binary | std::ios_base::app);
+    file << '\x40' << "partial";
+  }
+  {
+    ResultCache cache(path);
+    ASSERT_TRUE(cache.ok());
+    EXPECT_EQ(1u, cache.size());
+    cache.Insert(second, MakeResult(2.5));
+  }
+
+  ResultCache cache(path);
+  EXPECT_EQ(2u, cache.size());
+  SimilarityResultMsg sim_res_msg;
+  ASSERT_TRUE(cache.Find(second, &sim_res_msg));
+  EXPECT_EQ(2.5, sim_res_msg.moslqo());
+}
+
+// Ensure that the instances that open the same file share a cache.
+TEST(ResultCacheTest, OpenSharesCache) {
+  const std::string path = ::testing::TempDir() + "/shared.vqcache";
+  std::remove(path.c_str());
+  const auto first = ResultCache::Open(path);
+  const auto second = ResultCache::Open(path);
+  ASSERT_NE(nullptr, first);
+  EXPECT_EQ(first, second);
+}
+}  // namespace
+}  // namespace Visqol
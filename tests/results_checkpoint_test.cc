@@ -0,0 +1,87 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "results_checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+std::string WriteFile(const std::string &name, const std::string &contents) {
+  const std::string path = ::testing::TempDir() + "/" + name;
+  std::ofstream out(path, std::ios_base::trunc);
+  out << contents;
+  return path;
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+std::vector<std::string> Degraded(
+    const std::vector<ReferenceDegradedPathPair> &pairs) {
+  std::vector<std::string> degraded;
+  for (const auto &pair : pairs) {
+    degraded.push_back(pair.degraded.Path());
+  }
+  return degraded;
+}
+
+const std::vector<ReferenceDegradedPathPair> kPairs = {
+    {FilePath("r"), FilePath("d0")},
+    {FilePath("r"), FilePath("d1")},
+    {FilePath("r"), FilePath("d1")},
+    {FilePath("r"), FilePath("d2")},
+    {FilePath("r"), FilePath("d3")},
+};
+
+// Ensure that scored pairs are skipped, counting repeated pairs, and that a
+// partial final row is truncated from the file.
+TEST(ResultsCheckpointTest, SkipsScoredPairs) {
+  const std::string path = WriteFile("checkpoint.csv",
+      "reference,degraded,moslqo\nr,d2,3\nr,d1,2\nr,d3,");
+  const auto remaining = ResultsCheckpoint::RemoveScoredPairs(kPairs,
+                                                              FilePath(path));
+  EXPECT_EQ(std::vector<std::string>({"d0", "d1", "d3"}), Degraded(remaining));
+  EXPECT_EQ("reference,degraded,moslqo\nr,d2,3\nr,d1,2\n", ReadFile(path));
+  std::remove(path.c_str());
+}
+
+// Ensure that every pair is kept when there is no checkpoint, and that a
+// file without a complete header is removed.
+TEST(ResultsCheckpointTest, KeepsPairsWithoutResults) {
+  const std::string path = ::testing::TempDir() + "/no_checkpoint.csv";
+  std::remove(path.c_str());
+  EXPECT_EQ(kPairs.size(), ResultsCheckpoint::RemoveScoredPairs(
+      kPairs, FilePath(path)).size());
+
+  WriteFile("no_checkpoint.csv", "reference,degr");
+  EXPECT_EQ(kPairs.size(), ResultsCheckpoint::RemoveScoredPairs(
+      kPairs, FilePath(path)).size());
+  EXPECT_FALSE(FilePath(path).Exists());
+}
+
+}  // namespace
+}  // namespace Visqol
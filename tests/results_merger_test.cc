@@ -0,0 +1,106 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "results_merger.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+std::string WriteFile(const std::string &name, const std::string &contents) {
+  const std::string path = ::testing::TempDir() + "/" + name;
+  std::ofstream out(path, std::ios_base::trunc);
+  out << contents;
+  return path;
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+// Ensure that the shard results are merged under a single header, in the
+// order of the batch.
+TEST(ResultsMergerTest, MergesInBatchOrder) {
+  const std::string batch = WriteFile("batch.csv",
+      "reference,degraded\nr,d0\nr,d1\nr,d2\nr,d3\n");
+  const std::string shard0 = WriteFile("shard0.csv",
+      "reference,degraded,moslqo\nr,d1,2\nr,d3,4\n");
+  const std::string shard1 = WriteFile("shard1.csv",
+      "reference,degraded,moslqo\r\nr,d0,1\r\nr,d2,3\r\nr,extra,5\r\n");
+  const std::string empty = WriteFile("shard2.csv", "");
+  const std::string merged = ::testing::TempDir() + "/merged.csv";
+
+  ASSERT_TRUE(ResultsMerger::MergeResultsCSVs(
+      {FilePath(shard0), FilePath(shard1), FilePath(empty)}, FilePath(batch),
+      FilePath(merged)).ok());
+  EXPECT_EQ("reference,degraded,moslqo\nr,d0,1\nr,d1,2\nr,d2,3\nr,d3,4\n"
+            "r,extra,5\n", ReadFile(merged));
+
+  // Without the batch, the shards are merged in order.
+  ASSERT_TRUE(ResultsMerger::MergeResultsCSVs(
+      {FilePath(shard0), FilePath(shard1)}, FilePath(""),
+      FilePath(merged)).ok());
+  EXPECT_EQ("reference,degraded,moslqo\nr,d1,2\nr,d3,4\nr,d0,1\nr,d2,3\n"
+            "r,extra,5\n", ReadFile(merged));
+
+  for (const auto &path : {batch, shard0, shard1, empty, merged}) {
+    std::remove(path.c_str());
+  }
+}
+
+// Ensure that shards with different columns are not merged.
+TEST(ResultsMergerTest, RejectsMismatchedHeaders) {
+  const std::string shard0 = WriteFile("header0.csv",
+      "reference,degraded,moslqo\nr,d0,1\n");
+  const std::string shard1 = WriteFile("header1.csv",
+      "reference,degraded,moslqo,fvnsim0\nr,d1,2,0.5\n");
+  const std::string merged = ::testing::TempDir() + "/header_merged.csv";
+  EXPECT_FALSE(ResultsMerger::MergeResultsCSVs(
+      {FilePath(shard0), FilePath(shard1)}, FilePath(""),
+      FilePath(merged)).ok());
+  EXPECT_FALSE(ResultsMerger::MergeResultsCSVs(
+      {FilePath(shard0), FilePath(::testing::TempDir() + "/missing.csv")},
+      FilePath(""), FilePath(merged)).ok());
+  for (const auto &path : {shard0, shard1, merged}) {
+    std::remove(path.c_str());
+  }
+}
+
+// Ensure that the debug outputs are concatenated in shard order.
+TEST(ResultsMergerTest, ConcatenatesDebugOutputs) {
+  const std::string shard0 = WriteFile("debug0.json", "{\"a\":1}");
+  const std::string shard1 = WriteFile("debug1.json", "");
+  const std::string shard2 = WriteFile("debug2.json", "{\"b\":2}");
+  const std::string merged = ::testing::TempDir() + "/debug_merged.json";
+  ASSERT_TRUE(ResultsMerger::ConcatenateFiles(
+      {FilePath(shard0), FilePath(shard1), FilePath(shard2)},
+      FilePath(merged)).ok());
+  EXPECT_EQ("{\"a\":1}{\"b\":2}", ReadFile(merged));
+  for (const auto &path : {shard0, shard1, shard2, merged}) {
+    std::remove(path.c_str());
+  }
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,124 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "results_proto_stream.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "sim_results_writer.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+SimilarityResultMsg MakeResult(const std::string &degraded, double moslqo) {
+  SimilarityResultMsg sim_res_msg;
+  sim_res_msg.set_reference_filepath("ref.wav");
+  sim_res_msg.set_degraded_filepath(degraded);
+  sim_res_msg.set_moslqo(moslqo);
+  sim_res_msg.add_fvnsim(0.5);
+  sim_res_msg.add_fvnsim(0.75);
+  return sim_res_msg;
+}
+
+// Ensure that the records that are written are read back, in order, and that
+// a second writer appends to the file.
+TEST(ResultsProtoStreamTest, RoundTrip) {
+  const std::string path = ::testing::TempDir() + "/round_trip.binpb";
+  std::remove(path.c_str());
+  {
+    ResultsProtoWriter writer{FilePath(path)};
+    ASSERT_TRUE(writer.ok());
+    writer.Write(MakeResult("deg1.wav", 4.5));
+    writer.Write(SimilarityResultMsg());
+    writer.Flush();
+    writer.Write(MakeResult("deg2.wav", 3.25));
+  }
+  {
+    ResultsProtoWriter writer{FilePath(path)};
+    writer.WriteSerialized(MakeResult("deg3.wav", 1.5).SerializeAsString());
+  }
+
+  ResultsProtoReader reader{FilePath(path)};
+  SimilarityResultMsg sim_res_msg;
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("deg1.wav", sim_res_msg.degraded_filepath());
+  EXPECT_EQ(4.5, sim_res_msg.moslqo());
+  ASSERT_EQ(2, sim_res_msg.fvnsim_size());
+  EXPECT_EQ(0.75, sim_res_msg.fvnsim(1));
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("", sim_res_msg.degraded_filepath());
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("deg2.wav", sim_res_msg.degraded_filepath());
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("deg3.wav", sim_res_msg.degraded_filepath());
+  EXPECT_FALSE(reader.Next(&sim_res_msg));
+  EXPECT_TRUE(reader.ok());
+}
+
+// Ensure that a truncated record is reported as an error, and a missing file
+// as well.
+TEST(ResultsProtoStreamTest, TruncatedRecord) {
+  const std::string path = ::testing::TempDir() + "/truncated.binpb";
+  std::remove(path.c_str());
+  {
+    ResultsProtoWriter writer{FilePath(path)};
+    writer.Write(MakeResult("deg1.wav", 4.5));
+  }
+  {
+    std::ofstream file(path, std::ios_base::binary | std::ios_base::app);
+    file << '\x20' << "partial";
+  }
+
+  ResultsProtoReader reader{FilePath(path)};
+  SimilarityResultMsg sim_res_msg;
+  EXPECT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_FALSE(reader.Next(&sim_res_msg));
+  EXPECT_FALSE(reader.ok());
+
+  ResultsProtoReader missing{FilePath(::testing::TempDir() + "/missing.binpb")};
+  EXPECT_FALSE(missing.Next(&sim_res_msg));
+  EXPECT_FALSE(missing.ok());
+}
+
+// Ensure that the results stream writes the records in the order of their
+// pairs, and no record for a skipped pair.
+TEST(ResultsProtoStreamTest, ResultsStreamWritesRecords) {
+  const std::string path = ::testing::TempDir() + "/results_stream.binpb";
+  std::remove(path.c_str());
+  {
+    SimilarityResultsStream stream(false, FilePath(), FilePath(), false, true,
+                                   FilePath(path));
+    stream.Write(2, MakeResult("deg2.wav", 2.0));
+    stream.Skip(1);
+    stream.Write(0, MakeResult("deg0.wav", 4.0));
+  }
+
+  ResultsProtoReader reader{FilePath(path)};
+  SimilarityResultMsg sim_res_msg;
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("deg0.wav", sim_res_msg.degraded_filepath());
+  ASSERT_TRUE(reader.Next(&sim_res_msg));
+  EXPECT_EQ("deg2.wav", sim_res_msg.degraded_filepath());
+  EXPECT_FALSE(reader.Next(&sim_res_msg));
+  EXPECT_TRUE(reader.ok());
+}
+}  // namespace
+}  // namespace Visqol
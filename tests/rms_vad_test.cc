@@ -14,6 +14,8 @@
 
 #include "rms_vad.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <vector>
 
@@ -123,5 +125,49 @@ TEST(RmsVadTest, ProcessChunk) {
   RmsVad vad;
   ASSERT_NEAR(kChunkRms, vad.ProcessChunk(kChunk), kTolerance);
 }
+
+/**
+ * Ensure that a chunk of a normalized signal is measured exactly as the 16
+ * bit samples that it converts to, including the samples that are clamped.
+ */
+TEST(RmsVadTest, ProcessNormalizedChunk) {
+  std::vector<double> chunk;
+  std::vector<int16_t> converted;
+  for (size_t i = 0; i < 37; i++) {
+    const double value = 1.2 * std::sin(0.37 * i);
+    chunk.push_back(value);
+    converted.push_back(std::max(-1.0 * (1 << 15),
+                                 std::min(1.0 * ((1 << 15) - 1),
+                                          value * (1 << 15))));
+  }
+  RmsVad vad;
+  RmsVad converted_vad;
+  vad.Reserve(2);
+  EXPECT_EQ(converted_vad.ProcessChunk(converted), vad.ProcessChunk(chunk));
+  const std::vector<double> quiet(16, 0.01);
+  const std::vector<int16_t> converted_quiet(16, 327);
+  EXPECT_EQ(converted_vad.ProcessChunk(converted_quiet),
+            vad.ProcessChunk(quiet));
+  EXPECT_EQ(converted_vad.GetVadResults(), vad.GetVadResults());
+}
+
+/**
+ * Ensure that a chunk that is measured with its peak is measured exactly as
+ * the chunk normalized by the peak.
+ */
+TEST(RmsVadTest, ProcessChunkWithPeak) {
+  const double kPeak = 0.37;
+  std::vector<double> chunk;
+  std::vector<double> normalized;
+  for (size_t i = 0; i < 37; i++) {
+    const double value = kPeak * std::sin(0.37 * i);
+    chunk.push_back(value);
+    normalized.push_back(value / kPeak);
+  }
+  RmsVad vad;
+  RmsVad normalized_vad;
+  EXPECT_EQ(normalized_vad.ProcessChunk(normalized),
+            vad.ProcessChunk(chunk, kPeak));
+}
 }  // namespace
 }  // namespace Visqol
@@ -0,0 +1,111 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sim_results_writer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+SimilarityResultMsg MakeResult(const std::string &degraded, double moslqo) {
+  SimilarityResultMsg result;
+  result.set_reference_filepath("ref.wav");
+  result.set_degraded_filepath(degraded);
+  result.set_moslqo(moslqo);
+  return result;
+}
+
+std::vector<std::string> ReadLines(const std::string &path) {
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// Ensure that results that complete out of order are written in the order of
+// their pairs, and that a skipped pair does not hold back the later ones.
+TEST(SimilarityResultsStreamTest, OrderedResultsFollowPairOrder) {
+  const std::string path = ::testing::TempDir() + "/ordered_results.csv";
+  std::remove(path.c_str());
+  {
+    SimilarityResultsStream stream(false, FilePath(path), FilePath(""), false);
+    stream.Write(2, MakeResult("deg2.wav", 3.0));
+    stream.Write(0, MakeResult("deg0.wav", 1.0));
+    stream.Skip(1);
+    stream.Write(3, MakeResult("deg3.wav", 4.0));
+  }
+  const std::vector<std::string> expected = {
+      "reference,degraded,moslqo",
+      "ref.wav,deg0.wav,1",
+      "ref.wav,deg2.wav,3",
+      "ref.wav,deg3.wav,4",
+  };
+  EXPECT_EQ(expected, ReadLines(path));
+  std::remove(path.c_str());
+}
+
+// Ensure that unordered results are written as they are received, and that
+// the header is only written to a new file.
+TEST(SimilarityResultsStreamTest, UnorderedResultsFollowArrivalOrder) {
+  const std::string path = ::testing::TempDir() + "/unordered_results.csv";
+  std::remove(path.c_str());
+  {
+    SimilarityResultsStream stream(false, FilePath(path), FilePath(""), false,
+                                   false);
+    stream.Write(1, MakeResult("deg1.wav", 2.0));
+  }
+  {
+    SimilarityResultsStream stream(false, FilePath(path), FilePath(""), false,
+                                   false);
+    stream.Write(0, MakeResult("deg0.wav", 1.0));
+  }
+  const std::vector<std::string> expected = {
+      "reference,degraded,moslqo",
+      "ref.wav,deg1.wav,2",
+      "ref.wav,deg0.wav,1",
+  };
+  EXPECT_EQ(expected, ReadLines(path));
+  std::remove(path.c_str());
+}
+
+// Ensure that results held back for a pair that never completes are still
+// written when the stream is flushed.
+TEST(SimilarityResultsStreamTest, FlushWritesHeldBackResults) {
+  const std::string path = ::testing::TempDir() + "/flushed_results.csv";
+  std::remove(path.c_str());
+  SimilarityResultsStream stream(false, FilePath(path), FilePath(""), false);
+  stream.Write(1, MakeResult("deg1.wav", 2.0));
+  stream.Flush();
+  const std::vector<std::string> expected = {
+      "reference,degraded,moslqo",
+      "ref.wav,deg1.wav,2",
+  };
+  EXPECT_EQ(expected, ReadLines(path));
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,155 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "simd_dispatch.h"
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "simd_kernels.h"
+
+namespace Visqol {
+namespace {
+
+// An odd number of bands, so that every lane width leaves a remainder.
+const size_t kNumBands = 13;
+const size_t kNumSamples = 257;
+const size_t kNumCoeffs = kGammatoneCascadeStages * 3 + 2;
+const size_t kNumStates = kGammatoneCascadeStages * 2;
+
+std::vector<double> RandomValues(const size_t n, const double min,
+                                 const double max, const unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> dist(min, max);
+  std::vector<double> values(n);
+  for (auto &v : values) {
+    v = dist(gen);
+  }
+  return values;
+}
+
+// The kernel sets in the build that the host can run, other than the
+// baseline.
+std::vector<const SimdKernels *> WiderKernels() {
+  std::vector<const SimdKernels *> sets;
+  const SimdIsa host_isa = SimdDispatch::HostIsa();
+  if (host_isa == SimdIsa::kAvx512 && GetAvx512SimdKernels() != nullptr) {
+    sets.push_back(GetAvx512SimdKernels());
+  }
+  if ((host_isa == SimdIsa::kAvx512 || host_isa == SimdIsa::kAvx2) &&
+      GetAvx2SimdKernels() != nullptr) {
+    sets.push_back(GetAvx2SimdKernels());
+  }
+  return sets;
+}
+
+/**
+ * Ensure that the kernels picked for the host are one of the sets in the
+ * build, and that the host supports them.
+ */
+TEST(SimdDispatch, PicksSupportedKernels) {
+  const SimdKernels &kernels = SimdDispatch::Kernels();
+  EXPECT_EQ(&kernels, &SimdDispatch::Kernels());
+  const SimdIsa host_isa = SimdDispatch::HostIsa();
+  if (kernels.isa == SimdIsa::kAvx512) {
+    EXPECT_EQ(SimdIsa::kAvx512, host_isa);
+  } else if (kernels.isa == SimdIsa::kAvx2) {
+    EXPECT_TRUE(host_isa == SimdIsa::kAvx512 || host_isa == SimdIsa::kAvx2);
+  } else {
+    EXPECT_EQ(GetBaselineSimdKernels(), &kernels);
+  }
+  EXPECT_STRNE("unknown", SimdDispatch::IsaName(kernels.isa));
+}
+
+/**
+ * Ensure that every kernel set the host can run gives the same gammatone
+ * filter output and state as the baseline.
+ */
+TEST(SimdDispatch, GammatoneMatchesBaseline) {
+  const std::vector<double> coeffs =
+      RandomValues(kNumCoeffs * kNumBands, -0.5, 0.5, 1);
+  const std::vector<double> signal = RandomValues(kNumSamples, -1.0, 1.0, 2);
+  const SimdKernels *baseline = GetBaselineSimdKernels();
+
+  std::vector<double> expected_state(kNumStates * kNumBands, 0.0);
+  std::vector<double> expected_out(kNumBands * kNumSamples);
+  baseline->gammatone_filter(coeffs.data(), expected_state.data(), kNumBands,
+                             signal.data(), kNumSamples, expected_out.data());
+  std::vector<double> expected_energy(kNumBands, 0.0);
+  baseline->gammatone_energy(coeffs.data(), expected_state.data(), kNumBands,
+                             signal.data(), kNumSamples,
+                             expected_energy.data());
+
+  for (const SimdKernels *kernels : WiderKernels()) {
+    SCOPED_TRACE(SimdDispatch::IsaName(kernels->isa));
+    std::vector<double> state(kNumStates * kNumBands, 0.0);
+    std::vector<double> out(kNumBands * kNumSamples);
+    kernels->gammatone_filter(coeffs.data(), state.data(), kNumBands,
+                              signal.data(), kNumSamples, out.data());
+    std::vector<double> energy(kNumBands, 0.0);
+    kernels->gammatone_energy(coeffs.data(), state.data(), kNumBands,
+                              signal.data(), kNumSamples, energy.data());
+    EXPECT_EQ(expected_out, out);
+    EXPECT_EQ(expected_energy, energy);
+    EXPECT_EQ(expected_state, state);
+  }
+}
+
+/**
+ * Ensure that every kernel set the host can run gives the same sum of squared
+ * samples as the baseline, including for samples that clip.
+ */
+TEST(SimdDispatch, SumOfSquaredSamplesMatchesBaseline) {
+  const std::vector<double> chunk = RandomValues(kNumSamples, -1.5, 1.5, 3);
+  const double peak = 1.25;
+  const double expected = GetBaselineSimdKernels()->sum_of_squared_samples(
+      chunk.data(), chunk.size(), peak);
+  for (const SimdKernels *kernels : WiderKernels()) {
+    SCOPED_TRACE(SimdDispatch::IsaName(kernels->isa));
+    EXPECT_EQ(expected, kernels->sum_of_squared_samples(chunk.data(),
+                                                        chunk.size(), peak));
+  }
+}
+
+/**
+ * Ensure that every kernel set the host can run gives the same log10 as the
+ * baseline, including for the values that fall back to std::log10.
+ */
+TEST(SimdDispatch, FastLog10MatchesBaseline) {
+  std::vector<double> input = RandomValues(kNumSamples, 1e-9, 1e9, 4);
+  input[5] = 0.0;
+  input[17] = -1.0;
+  input[30] = INFINITY;
+  std::vector<double> expected(input.size());
+  GetBaselineSimdKernels()->fast_log10(input.data(), expected.data(),
+                                       input.size());
+  for (const SimdKernels *kernels : WiderKernels()) {
+    SCOPED_TRACE(SimdDispatch::IsaName(kernels->isa));
+    std::vector<double> output(input.size());
+    kernels->fast_log10(input.data(), output.data(), input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+      if (std::isnan(expected[i])) {
+        EXPECT_TRUE(std::isnan(output[i]));
+      } else {
+        EXPECT_EQ(expected[i], output[i]);
+      }
+    }
+  }
+}
+}  // namespace
+}  // namespace Visqol
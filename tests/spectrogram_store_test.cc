@@ -0,0 +1,97 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spectrogram_store.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "amatrix.h"
+#include "neurogram_similiarity_index_measure.h"
+#include "patch_view.h"
+
+namespace Visqol {
+namespace {
+
+// A 3 row matrix where each value encodes its own row and column.
+AMatrix<double> MakeMatrix(size_t num_cols) {
+  AMatrix<double> matrix(3, num_cols);
+  for (size_t c = 0; c < num_cols; c++) {
+    for (size_t r = 0; r < 3; r++) {
+      matrix(r, c) = 10.0 * (c + 1) + r;
+    }
+  }
+  return matrix;
+}
+
+// Ensure that the bands are contiguous and aligned, and that a window reads
+// the same values as a view of the matrix, with silence in the pad frames.
+TEST(SpectrogramStoreTest, WindowMatchesView) {
+  const AMatrix<double> matrix = MakeMatrix(5);
+  const SpectrogramStore store(matrix, 4);
+  ASSERT_EQ(3, store.NumBands());
+  ASSERT_EQ(5, store.NumFrames());
+  EXPECT_EQ(0, store.Stride() % SpectrogramStore::kRowAlignment);
+  EXPECT_GE(store.Stride(), 13);
+  EXPECT_EQ(matrix(1, 0), store.Band(1)[0]);
+  EXPECT_EQ(matrix(1, 4), store.Band(1)[4]);
+
+  EXPECT_TRUE(store.Covers(-4, 13));
+  EXPECT_FALSE(store.Covers(-5, 3));
+  EXPECT_FALSE(store.Covers(2, 8));
+  const SpectrogramStore::Window window = store.GetWindow(-2, 9);
+  const PatchView view(matrix, -2, 9);
+  ASSERT_EQ(view.NumRows(), window.NumRows());
+  ASSERT_EQ(view.NumCols(), window.NumCols());
+  for (size_t c = 0; c < view.NumCols(); c++) {
+    for (size_t r = 0; r < view.NumRows(); r++) {
+      EXPECT_EQ(view(r, c), window(r, c));
+    }
+  }
+}
+
+// Ensure that the sliding NSIM comparator gives the same results whether or
+// not its maps are padded for the patches that extend past either end of the
+// degraded spectrogram.
+TEST(SpectrogramStoreTest, PaddedSlidingNsimMatchesUnpadded) {
+  const size_t patch_size = 20;
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> dist(0.0, 60.0);
+  AMatrix<double> ref_spectro(32, 40);
+  AMatrix<double> deg_spectro(32, 40);
+  for (size_t i = 0; i < ref_spectro.NumElements(); i++) {
+    ref_spectro(i) = dist(gen);
+    deg_spectro(i) = 0.7 * ref_spectro(i) + 0.3 * dist(gen);
+  }
+  const PatchView ref_patch(ref_spectro, 10, patch_size);
+
+  for (const bool use_float_search : {false, true}) {
+    const NeurogramSimiliarityIndexMeasure nsim(use_float_search);
+    const auto unpadded = nsim.CreateSlidingComparator(deg_spectro);
+    const auto padded = nsim.CreateSlidingComparator(deg_spectro, patch_size);
+    // The first and last offsets extend past the pad frames.
+    const auto expected = unpadded->MeasureSlidingPatchSimilarity(ref_patch,
+                                                                  -25, 45);
+    const auto results = padded->MeasureSlidingPatchSimilarity(ref_patch,
+                                                               -25, 45);
+    ASSERT_EQ(expected.size(), results.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_EQ(expected[i].similarity, results[i].similarity);
+    }
+  }
+}
+}  // namespace
+}  // namespace Visqol
@@ -14,6 +14,9 @@
 
 #include "spectrogram.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "test_utility.h"
@@ -76,5 +79,39 @@ TEST(SpectrogramTest, SubtractFloorTest) {
                                   kTolerance, &fail_msg)) << fail_msg;
 }
 
+// Ensure that the fused dB conversion and floor raising gives the same result
+// as the separate passes, including for spectrograms of different lengths.
+TEST(SpectrogramTest, ConvertToDbAndRaiseFloorsTest) {
+  const double abs_floor = -45.0;
+  const double rel_floor = 20.0;
+  const AMatrix<double> ref_mat{3, 4, std::vector<double>{0.5, 0.001, 0,
+      2.0, 0.2, 0.0001, 1e-9, 0.3, 0.04, 0.7, 0, 0.06}};
+  const AMatrix<double> deg_mat{3, 3, std::vector<double>{0.4, 0.002, 0.01,
+      1e-3, 0.5, 0.2, 0.03, 1e-6, 0.3}};
+
+  Spectrogram ref_separate{AMatrix<double>{ref_mat}};
+  Spectrogram deg_separate{AMatrix<double>{deg_mat}};
+  ref_separate.ConvertToDb();
+  deg_separate.ConvertToDb();
+  ref_separate.RaiseFloor(abs_floor);
+  deg_separate.RaiseFloor(abs_floor);
+  ref_separate.RaiseFloorPerFrame(rel_floor, deg_separate);
+  const double lowest_separate = std::min(ref_separate.Minimum(),
+                                          deg_separate.Minimum());
+
+  Spectrogram ref_fused{AMatrix<double>{ref_mat}};
+  Spectrogram deg_fused{AMatrix<double>{deg_mat}};
+  const double lowest_fused = ref_fused.ConvertToDbAndRaiseFloors(
+      abs_floor, rel_floor, deg_fused);
+
+  ASSERT_EQ(lowest_separate, lowest_fused);
+  for (size_t i = 0; i < ref_mat.NumElements(); i++) {
+    ASSERT_EQ(ref_separate.Data()(i), ref_fused.Data()(i));
+  }
+  for (size_t i = 0; i < deg_mat.NumElements(); i++) {
+    ASSERT_EQ(deg_separate.Data()(i), deg_fused.Data()(i));
+  }
+}
+
 }  // namespace
 }  // namespace Visqol
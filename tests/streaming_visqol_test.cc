@@ -0,0 +1,127 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_visqol.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+
+#include "commandline_parser.h"
+#include "file_path.h"
+#include "misc_audio.h"
+#include "test_utility.h"
+#include "visqol_manager.h"
+
+namespace Visqol {
+namespace {
+
+const char kGuitarRef[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo.wav";
+const char kGuitarDeg[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav";
+const size_t kChunkSize = 960;  // 20ms at 48kHz.
+const size_t kNumGuitarSegments = 4;
+const double kTolerance = 0.0001;
+
+// Push the signals of a pair into a stream in small chunks, alternating
+// between the reference and the degraded signal, as a live call would.
+void PushInChunks(const std::vector<double> &ref,
+                  const std::vector<double> &deg, StreamingVisqol *stream) {
+  for (size_t i = 0; i < std::max(ref.size(), deg.size()); i += kChunkSize) {
+    if (i < ref.size()) {
+      ASSERT_TRUE(stream->PushReference(absl::MakeConstSpan(ref).subspan(
+          i, kChunkSize)).ok());
+    }
+    if (i < deg.size()) {
+      ASSERT_TRUE(stream->PushDegraded(absl::MakeConstSpan(deg).subspan(
+          i, kChunkSize)).ok());
+    }
+  }
+  ASSERT_TRUE(stream->Finish().ok());
+}
+
+// Ensure that a stream scores each segment as it completes, with patch times
+// from the start of the stream and a running score that is the patch weighted
+// mean of the segment scores.
+TEST(StreamingVisqolTest, ScoresSegmentsAsTheyComplete) {
+  const auto cmd_args = CommandLineArgsHelper(kGuitarRef, kGuitarDeg);
+  VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+      VisqolCommandLineParser::BuildVisqolOptions(cmd_args)).ok());
+  const auto ref = MiscAudio::LoadAsMono(FilePath(kGuitarRef))
+      .data_matrix.ToVector();
+  const auto deg = MiscAudio::LoadAsMono(FilePath(kGuitarDeg))
+      .data_matrix.ToVector();
+
+  std::vector<StreamingVisqolResult> results;
+  StreamingVisqol stream(&visqol, 48000,
+      StreamingVisqol::kDefaultSegmentDuration,
+      StreamingVisqol::kDefaultLookahead,
+      [&results](const StreamingVisqolResult &result) {
+        results.push_back(result);
+      });
+  PushInChunks(ref, deg, &stream);
+
+  ASSERT_EQ(kNumGuitarSegments, results.size());
+  EXPECT_EQ(kNumGuitarSegments, stream.NumSegments());
+  double weighted_sum = 0.0;
+  size_t num_patches = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto &result = results[i];
+    EXPECT_EQ(i, result.segment_index);
+    EXPECT_NEAR(i * StreamingVisqol::kDefaultSegmentDuration,
+                result.start_time, kTolerance);
+    ASSERT_GT(result.segment.patch_sims_size(), 0);
+    for (const auto &patch : result.segment.patch_sims()) {
+      EXPECT_GE(patch.ref_patch_start_time(), result.start_time);
+    }
+    weighted_sum += result.segment.moslqo() * result.segment.patch_sims_size();
+    num_patches += result.segment.patch_sims_size();
+    EXPECT_EQ(num_patches, result.num_patches);
+    EXPECT_NEAR(weighted_sum / num_patches, result.running_moslqo, kTolerance);
+  }
+  EXPECT_NEAR(results.back().running_moslqo, stream.RunningMoslqo(),
+              kTolerance);
+}
+
+// Ensure that a stream of identical signals scores at least as well as a
+// degraded stream.
+TEST(StreamingVisqolTest, IdenticalStreamScoresHigher) {
+  const auto cmd_args = CommandLineArgsHelper(kGuitarRef, kGuitarDeg);
+  VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+      VisqolCommandLineParser::BuildVisqolOptions(cmd_args)).ok());
+  const auto ref = MiscAudio::LoadAsMono(FilePath(kGuitarRef))
+      .data_matrix.ToVector();
+  const auto deg = MiscAudio::LoadAsMono(FilePath(kGuitarDeg))
+      .data_matrix.ToVector();
+
+  StreamingVisqol identical(&visqol, 48000,
+      StreamingVisqol::kDefaultSegmentDuration,
+      StreamingVisqol::kDefaultLookahead, [](const StreamingVisqolResult &) {});
+  PushInChunks(ref, ref, &identical);
+  StreamingVisqol degraded(&visqol, 48000,
+      StreamingVisqol::kDefaultSegmentDuration,
+      StreamingVisqol::kDefaultLookahead, [](const StreamingVisqolResult &) {});
+  PushInChunks(ref, deg, &degraded);
+
+  EXPECT_GE(identical.RunningMoslqo(), degraded.RunningMoslqo());
+  EXPECT_GT(degraded.RunningMoslqo(), 1.0);
+}
+
+}  // namespace
+}  // namespace Visqol
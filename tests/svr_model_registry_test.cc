@@ -0,0 +1,101 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "svr_model_registry.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "support_vector_regression_model.h"
+
+namespace Visqol {
+namespace {
+
+const char kDefaultModel[] = "/model/libsvm_nu_svr_model.txt";
+const char kTestModel[] = "/testdata/test_model/cpp_model.txt";
+
+// An observation of the 32 band similarities of an audio mode comparison.
+const std::vector<double> kObservation(32, 0.8);
+
+void CopyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+// Ensure that concurrent users of a model file share a single model.
+TEST(SvrModelRegistryTest, ConcurrentUsersShareModel) {
+  const FilePath path(FilePath::currentWorkingDir() + kDefaultModel);
+  std::vector<std::shared_ptr<const SupportVectorRegressionModel>> models(4);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < models.size(); i++) {
+    threads.emplace_back([&, i]() {
+      auto model_or = SvrModelRegistry::Get(path);
+      ASSERT_TRUE(model_or.ok());
+      models[i] = model_or.ValueOrDie();
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &model : models) {
+    ASSERT_NE(nullptr, model);
+    EXPECT_EQ(models[0], model);
+  }
+}
+
+// Ensure that a model file that is rewritten is loaded again, while the users
+// of the old model keep it.
+TEST(SvrModelRegistryTest, RewrittenFileIsReloaded) {
+  const std::string path = ::testing::TempDir() + "/svr_registry_model.txt";
+  CopyFile(FilePath::currentWorkingDir() + kDefaultModel, path);
+  auto first_or = SvrModelRegistry::Get(FilePath(path));
+  ASSERT_TRUE(first_or.ok());
+  const auto first = first_or.ValueOrDie();
+  const double first_prediction = first->Predict(kObservation);
+
+  CopyFile(FilePath::currentWorkingDir() + kTestModel, path);
+  auto second_or = SvrModelRegistry::Get(FilePath(path));
+  ASSERT_TRUE(second_or.ok());
+  EXPECT_NE(first, second_or.ValueOrDie());
+  EXPECT_EQ(first_prediction, first->Predict(kObservation));
+  std::remove(path.c_str());
+}
+
+// Ensure that a missing model file is an error.
+TEST(SvrModelRegistryTest, MissingFileIsError) {
+  EXPECT_FALSE(SvrModelRegistry::Get(FilePath("does_not_exist.txt")).ok());
+}
+
+// Ensure that the embedded model is shared, and predicts as the default model
+// file does.
+TEST(SvrModelRegistryTest, EmbeddedModelMatchesDefaultModel) {
+  const auto embedded = SvrModelRegistry::GetEmbedded();
+  ASSERT_NE(nullptr, embedded);
+  EXPECT_EQ(embedded, SvrModelRegistry::GetEmbedded());
+  auto model_or = SvrModelRegistry::Get(
+      FilePath(FilePath::currentWorkingDir() + kDefaultModel));
+  ASSERT_TRUE(model_or.ok());
+  EXPECT_EQ(model_or.ValueOrDie()->Predict(kObservation),
+            embedded->Predict(kObservation));
+}
+}  // namespace
+}  // namespace Visqol
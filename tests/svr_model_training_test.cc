@@ -19,6 +19,7 @@
 #include "file_path.h"
 #include "training_data_file_reader.h"
 #include "misc_vector.h"
+#include "svr_grid_search.h"
 
 namespace Visqol {
 namespace {
@@ -70,5 +71,44 @@ TEST(SupportVectorRegressionModel_Test, vs_model_file) {
   // Don't expect the values to be anywhere near each other.
   EXPECT_NEAR(prediction_model_file, prediction_targ_obv, kTolerance);
 }
+
+/**
+ * Ensure that a grid search scores every point as a serial search does, and
+ * that training with the best point's parameters still predicts close to the
+ * default model.
+ */
+TEST(SupportVectorRegressionModel_Test, grid_search) {
+  const auto targets_mat = TrainingDataFileReader::Read(kTargetsPath, ',');
+  const auto observations = TrainingDataFileReader::Read(kObservationsPath,
+                                                         ',');
+  const auto targets = MiscVector::ConvertVecOfVecToVec(targets_mat);
+  const std::vector<double> costs{0.4, 4.0};
+  const std::vector<double> nus{0.6};
+  const std::vector<double> gammas{0.0, 0.01};
+
+  const auto points = SvrGridSearch::Search(observations, targets, costs, nus,
+                                            gammas, 4, 4, 20);
+  ASSERT_EQ(costs.size() * nus.size() * gammas.size(), points.size());
+  EXPECT_EQ(4.0, points[2].params.cost);
+  EXPECT_EQ(0.01, points[1].params.gamma);
+  for (const auto &point : points) {
+    EXPECT_EQ(20, point.params.cache_size_mb);
+    EXPECT_EQ(SvrGridSearch::CrossValidate(observations, targets,
+                                           point.params, 4),
+              point.mean_squared_error);
+    EXPECT_GT(point.mean_squared_error, 0.0);
+  }
+
+  const SvrGridPoint best = SvrGridSearch::Best(points);
+  for (const auto &point : points) {
+    EXPECT_LE(best.mean_squared_error, point.mean_squared_error);
+  }
+  SupportVectorRegressionModel model_default;
+  ASSERT_TRUE(model_default.Init(kDefaultAudioModelFile).ok());
+  SupportVectorRegressionModel model_best;
+  model_best.Init(observations, targets, best.params);
+  EXPECT_NEAR(model_default.Predict(kSampleObservation),
+              model_best.Predict(kSampleObservation), kTolerance);
+}
 }  // namespace
 }  // namespace Visqol
@@ -0,0 +1,74 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_graph.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace Visqol {
+namespace {
+
+// Ensure that a single worker runs the tasks in the order that they were
+// added.
+TEST(TaskGraph, SingleWorkerRunsInOrder) {
+  std::vector<size_t> order;
+  TaskGraph graph;
+  for (size_t i = 0; i < 5; i++) {
+    graph.AddTask([&order, i]() { order.push_back(i); });
+  }
+  ASSERT_EQ(5, graph.NumTasks());
+  graph.Run(1);
+  EXPECT_EQ(std::vector<size_t>({0, 1, 2, 3, 4}), order);
+}
+
+// Ensure that no task starts before the tasks that it depends on have
+// completed, when the tasks are spread over several workers.
+TEST(TaskGraph, DependenciesCompleteFirst) {
+  // Two chains of loads and builds that meet in a final task, run many times
+  // to give the workers a chance to interleave them.
+  for (int run = 0; run < 100; run++) {
+    std::atomic<int> step(0);
+    std::vector<int> completed_at(5, -1);
+    TaskGraph graph;
+    auto record = [&](size_t task) {
+      return [&, task]() { completed_at[task] = step++; };
+    };
+    const size_t ref_load = graph.AddTask(record(0));
+    const size_t deg_load = graph.AddTask(record(1));
+    const size_t ref_build = graph.AddTask(record(2), {ref_load});
+    const size_t deg_build = graph.AddTask(record(3), {deg_load});
+    graph.AddTask(record(4), {ref_build, deg_build});
+    graph.Run(4);
+    for (int completed : completed_at) {
+      ASSERT_GE(completed, 0);
+    }
+    EXPECT_LT(completed_at[0], completed_at[2]);
+    EXPECT_LT(completed_at[1], completed_at[3]);
+    EXPECT_LT(completed_at[2], completed_at[4]);
+    EXPECT_LT(completed_at[3], completed_at[4]);
+  }
+}
+
+// Ensure that an empty graph can be run.
+TEST(TaskGraph, EmptyGraph) {
+  TaskGraph graph;
+  graph.Run(4);
+  EXPECT_EQ(0, graph.NumTasks());
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,100 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "thread_pinning.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "visqol_config.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+// Ensure that the ranges and single CPUs of a CPU list are expanded, and
+// that lists that are not valid give no CPUs.
+TEST(ThreadPinning, ParsesCpuLists) {
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}),
+            ThreadPinning::ParseCpuList("0-3,8,10-11"));
+  EXPECT_EQ(std::vector<int>({5}), ThreadPinning::ParseCpuList("5"));
+  EXPECT_TRUE(ThreadPinning::ParseCpuList("").empty());
+  EXPECT_TRUE(ThreadPinning::ParseCpuList("3-1").empty());
+  EXPECT_TRUE(ThreadPinning::ParseCpuList("a-b").empty());
+}
+
+// Ensure that the CPUs of the nodes are read in the order of the nodes, and
+// that nodes without CPUs are left out.
+TEST(ThreadPinning, ReadsTheCpusOfEachNode) {
+  const boost::filesystem::path root =
+      boost::filesystem::path(::testing::TempDir()) / "thread_pinning_nodes";
+  boost::filesystem::remove_all(root);
+  const std::vector<std::string> cpu_lists = {"0-1,4-5", "", "2-3,6-7"};
+  for (size_t node = 0; node < cpu_lists.size(); node++) {
+    const auto node_dir = root / ("node" + std::to_string(node));
+    boost::filesystem::create_directories(node_dir);
+    std::ofstream((node_dir / "cpulist").string()) << cpu_lists[node] << "\n";
+  }
+
+  const auto node_cpus = ThreadPinning::NodeCpus(root.string());
+  ASSERT_EQ(2, node_cpus.size());
+  EXPECT_EQ(std::vector<int>({0, 1, 4, 5}), node_cpus[0]);
+  EXPECT_EQ(std::vector<int>({2, 3, 6, 7}), node_cpus[1]);
+}
+
+// Ensure that a machine without readable nodes is treated as a single node.
+TEST(ThreadPinning, MissingNodesAreASingleNode) {
+  const auto node_cpus = ThreadPinning::NodeCpus(
+      ::testing::TempDir() + "/no_such_nodes");
+  EXPECT_EQ(1, node_cpus.size());
+}
+
+// Ensure that the workers alternate between the nodes, and that the workers
+// pinned to cores take the CPUs of their node in turn.
+TEST(ThreadPinning, SpreadsWorkersAcrossNodes) {
+  const std::vector<std::vector<int>> node_cpus = {{0, 1}, {2, 3}};
+  EXPECT_TRUE(ThreadPinning::WorkerCpus(
+      0, VisqolConfig::VisqolOptions::NO_PINNING, node_cpus).empty());
+  EXPECT_EQ(std::vector<int>({2, 3}), ThreadPinning::WorkerCpus(
+      1, VisqolConfig::VisqolOptions::PIN_TO_NODE, node_cpus));
+  const std::vector<std::vector<int>> expected_cores = {
+      {0}, {2}, {1}, {3}, {0}};
+  for (size_t worker = 0; worker < expected_cores.size(); worker++) {
+    EXPECT_EQ(expected_cores[worker], ThreadPinning::WorkerCpus(
+        worker, VisqolConfig::VisqolOptions::PIN_TO_CORE, node_cpus));
+  }
+}
+
+#if defined(__linux__)
+// Ensure that a thread is pinned for the lifetime of the scope, and that its
+// CPUs are restored afterwards.
+TEST(ScopedThreadPin, RestoresTheCpusOfTheThread) {
+  const std::vector<int> cpus = ThreadPinning::CurrentThreadCpus();
+  ASSERT_FALSE(cpus.empty());
+  {
+    const ScopedThreadPin pin({cpus.front()});
+    EXPECT_EQ(std::vector<int>({cpus.front()}),
+              ThreadPinning::CurrentThreadCpus());
+  }
+  EXPECT_EQ(cpus, ThreadPinning::CurrentThreadCpus());
+}
+#endif
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,83 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "trace_writer.h"
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "stage_timer.h"
+
+namespace Visqol {
+namespace {
+
+// The thread id of the event that starts at a position of a trace.
+std::string ThreadIdAt(const std::string &trace, size_t pos) {
+  const size_t tid = trace.find("\"tid\":", pos) + 6;
+  return trace.substr(tid, trace.find_first_of(",}", tid) - tid);
+}
+
+// Ensure that nothing is recorded before the trace is started.
+TEST(TraceWriterTest, NothingRecordedWhenOff) {
+  TraceWriter::StopAndFormat();
+  {
+    ScopedTraceEvent event("pair", "ignored");
+  }
+  EXPECT_FALSE(TraceWriter::IsEnabled());
+  EXPECT_EQ(std::string::npos,
+            TraceWriter::StopAndFormat().find("ignored"));
+}
+
+// Ensure that pair and stage events are recorded with their categories, in
+// the order that they started, and with the ids of their threads.
+TEST(TraceWriterTest, RecordsPairsAndStages) {
+  TraceWriter::Start();
+  EXPECT_TRUE(TraceWriter::IsEnabled());
+  {
+    ScopedTraceEvent pair_event("pair", "deg.wav", {{"reference", "ref.wav"}});
+    ScopedStageTimer timer(nullptr, &StageTimings::coarse_search);
+  }
+  std::thread([]() { ScopedTraceEvent event("io", "decode"); }).join();
+  const std::string trace = TraceWriter::StopAndFormat();
+  EXPECT_FALSE(TraceWriter::IsEnabled());
+
+  const size_t pair = trace.find("\"name\":\"deg.wav\",\"cat\":\"pair\"");
+  const size_t stage =
+      trace.find("\"name\":\"coarse_search\",\"cat\":\"stage\"");
+  const size_t decode = trace.find("\"name\":\"decode\",\"cat\":\"io\"");
+  ASSERT_NE(std::string::npos, pair);
+  ASSERT_NE(std::string::npos, stage);
+  ASSERT_NE(std::string::npos, decode);
+  EXPECT_LT(pair, stage);
+  EXPECT_LT(stage, decode);
+  EXPECT_NE(std::string::npos, trace.find("\"args\":{\"reference\":"
+                                          "\"ref.wav\"}"));
+  EXPECT_EQ(ThreadIdAt(trace, pair), ThreadIdAt(trace, stage));
+  EXPECT_NE(ThreadIdAt(trace, pair), ThreadIdAt(trace, decode));
+}
+
+// Ensure that names are escaped in the JSON.
+TEST(TraceWriterTest, EscapesNames) {
+  TraceWriter::Start();
+  {
+    ScopedTraceEvent event("pair", "a\"b\\c");
+  }
+  EXPECT_NE(std::string::npos,
+            TraceWriter::StopAndFormat().find("\"a\\\"b\\\\c\""));
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,75 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "training_data_file_reader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+
+namespace Visqol {
+namespace {
+
+const FilePath kObservationsPath = FilePath(
+    "testdata/svr_training/training_mat_tcdaudio14_aacvopus15_fvnsims.txt");
+
+// Write a file to the test directory and return its path.
+std::string WriteFile(const std::string &name, const std::string &contents) {
+  const std::string path = ::testing::TempDir() + "/" + name;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << contents;
+  return path;
+}
+
+// Ensure that each line is a row, and that values are parsed as atof does.
+TEST(TrainingDataFileReaderTest, ParsesRows) {
+  const std::string path = WriteFile("training_rows.txt",
+      "0.5,1e-3,-2\n"
+      " 4,,+7,\n"
+      "\n"
+      "3.25,x");
+  const auto values = TrainingDataFileReader::Read(FilePath(path), ',');
+  ASSERT_EQ(4u, values.size());
+  EXPECT_EQ((std::vector<double>{0.5, 1e-3, -2.0}), values[0]);
+  EXPECT_EQ((std::vector<double>{4.0, 0.0, 7.0}), values[1]);
+  EXPECT_TRUE(values[2].empty());
+  EXPECT_EQ((std::vector<double>{3.25, 0.0}), values[3]);
+  std::remove(path.c_str());
+}
+
+// Ensure that empty and missing files have no rows.
+TEST(TrainingDataFileReaderTest, EmptyAndMissingFiles) {
+  const std::string path = WriteFile("training_empty.txt", "");
+  EXPECT_TRUE(TrainingDataFileReader::Read(FilePath(path), ',').empty());
+  EXPECT_TRUE(TrainingDataFileReader::Read(
+      FilePath("does_not_exist.txt"), ',').empty());
+  std::remove(path.c_str());
+}
+
+// Ensure that every row of the training observations has the 32 bands.
+TEST(TrainingDataFileReaderTest, ReadsTrainingObservations) {
+  const auto values = TrainingDataFileReader::Read(kObservationsPath, ',');
+  ASSERT_EQ(120u, values.size());
+  for (const auto &row : values) {
+    EXPECT_EQ(32u, row.size());
+  }
+  EXPECT_EQ(0.997688956727337, values[1][0]);
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,100 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "training_data_writer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "file_path.h"
+#include "similarity_result.pb.h"  // Generated by cc_proto_library rule
+#include "training_data_file_reader.h"
+
+namespace Visqol {
+namespace {
+
+// Make a result of a pair with the given FVNSIM.
+SimilarityResultMsg MakeResult(const std::string &reference,
+                               const std::string &degraded,
+                               const std::vector<double> &fvnsim) {
+  SimilarityResultMsg msg;
+  msg.set_reference_filepath(reference);
+  msg.set_degraded_filepath(degraded);
+  for (const double value : fvnsim) {
+    msg.add_fvnsim(value);
+  }
+  return msg;
+}
+
+// Ensure that the MOS-LQS is read from the third column of a batch CSV file,
+// and that pairs without a valid one are left out.
+TEST(TrainingDataWriterTest, ReadTargets) {
+  const std::string path = ::testing::TempDir() + "/training_batch.csv";
+  {
+    std::ofstream out(path, std::ios::trunc);
+    out << "reference,degraded,moslqs\r\n"
+        << "ref1.wav,deg1.wav,4.5\r\n"
+        << "ref1.wav,deg2.wav\n"
+        << "ref2.wav,deg3.wav,bad\n"
+        << "ref2.wav,deg4.wav,1.25\n"
+        << "ref1.wav,deg1.wav,3.0\n";
+  }
+  const auto targets = TrainingDataWriter::ReadTargets(FilePath(path));
+  ASSERT_EQ(2u, targets.size());
+  EXPECT_EQ(4.5, targets.at({"ref1.wav", "deg1.wav"}));
+  EXPECT_EQ(1.25, targets.at({"ref2.wav", "deg4.wav"}));
+  std::remove(path.c_str());
+}
+
+// Ensure that rows are written in the order of their pairs, that pairs
+// without a MOS-LQS or a result are left out, and that the files are read back
+// with the exact values by TrainingDataFileReader.
+TEST(TrainingDataWriterTest, WritesRowsInOrder) {
+  const std::string prefix = ::testing::TempDir() + "/training_data";
+  const std::vector<double> fvnsim0{0.1, 1.0 / 3.0, 0.999999999999};
+  const std::vector<double> fvnsim2{0.5, 0.25, 2.0 / 7.0};
+  {
+    TrainingDataWriter::TargetMap targets;
+    targets[{"ref.wav", "deg0.wav"}] = 4.1;
+    targets[{"ref.wav", "deg2.wav"}] = 1.0 / 3.0;
+    TrainingDataWriter writer(prefix, std::move(targets));
+    writer.Write(2, MakeResult("ref.wav", "deg2.wav", fvnsim2));
+    writer.Write(3, MakeResult("ref.wav", "deg3.wav", fvnsim0));
+    EXPECT_EQ(0u, writer.NumRows());
+    writer.Skip(1);
+    EXPECT_EQ(0u, writer.NumRows());
+    writer.Write(0, MakeResult("ref.wav", "deg0.wav", fvnsim0));
+    EXPECT_EQ(2u, writer.NumRows());
+    EXPECT_TRUE(writer.Flush());
+  }
+
+  const auto observations = TrainingDataFileReader::Read(
+      FilePath(prefix + TrainingDataWriter::kObservationsSuffix), ',');
+  const auto targets = TrainingDataFileReader::Read(
+      FilePath(prefix + TrainingDataWriter::kTargetsSuffix), ',');
+  ASSERT_EQ(2u, observations.size());
+  ASSERT_EQ(2u, targets.size());
+  EXPECT_EQ(fvnsim0, observations[0]);
+  EXPECT_EQ(fvnsim2, observations[1]);
+  EXPECT_EQ(std::vector<double>{4.1}, targets[0]);
+  EXPECT_EQ(std::vector<double>{1.0 / 3.0}, targets[1]);
+  std::remove((prefix + TrainingDataWriter::kObservationsSuffix).c_str());
+  std::remove((prefix + TrainingDataWriter::kTargetsSuffix).c_str());
+}
+}  // namespace
+}  // namespace Visqol
@@ -81,6 +81,20 @@ TEST(VadPatchCreatorTest, PatchIndices) {
   ASSERT_TRUE(kCA01_01Patches == patches);
 }
 
-
+/**
+ * Test that a patch budget selects evenly spaced patches, and that every
+ * patch is kept when there is no budget or it is not exceeded.
+ */
+TEST(VadPatchCreatorTest, SelectPatchIndices) {
+  const std::vector<size_t> indices{9, 29, 49, 69, 89, 109, 129, 149, 169,
+                                    189};
+  EXPECT_EQ(indices, VadPatchCreator(kPatchSize).SelectPatchIndices(indices));
+  EXPECT_EQ(indices,
+            VadPatchCreator(kPatchSize, 10).SelectPatchIndices(indices));
+  EXPECT_EQ((std::vector<size_t>{29, 109, 169}),
+            VadPatchCreator(kPatchSize, 3).SelectPatchIndices(indices));
+  EXPECT_EQ((std::vector<size_t>{109}),
+            VadPatchCreator(kPatchSize, 1).SelectPatchIndices(indices));
+}
 
 }  // namespace Visqol
@@ -14,8 +14,18 @@
 
 #include "visqol_api.h"
 
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "absl/types/span.h"
 #include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
 
 #include "audio_signal.h"
 #include "commandline_parser.h"
@@ -124,6 +134,85 @@ TEST(VisqolApi, happy_path_default_model) {
   }
 }
 
+/**
+ * Test that an instance that is warmed up on creation, and again on several
+ * threads, still gives the conformance results, and that a warm-up without a
+ * duration is an error.
+ */
+TEST(VisqolApi, warmup_does_not_change_results) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+  auto ref_span = absl::Span<double>(ref_data);
+  auto deg_span = absl::Span<double>(deg_data);
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  config.mutable_options()->set_warmup_duration(
+      static_cast<double>(ref_data.size()) / kSampleRate);
+
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  ASSERT_TRUE(visqol.Warmup(config.options().warmup_duration(), 2).ok());
+  ASSERT_FALSE(visqol.Warmup(0.0).ok());
+  auto result = visqol.Measure(ref_span, deg_span);
+
+  ASSERT_TRUE(result.ok());
+  auto sim_result = result.ValueOrDie();
+  ASSERT_NEAR(kConformanceContrabassoon24aac, sim_result.moslqo(), kTolerance);
+  ASSERT_NEAR(kContrabassoonVnsim, sim_result.vnsim(), kTolerance);
+}
+
+/**
+ *  Test that the single precision and 16 bit inputs give the same results as
+ *  the double precision input, which is not modified by the comparison. The
+ *  samples of the 16 bit wav files are exactly representable in each type.
+ */
+TEST(VisqolApi, float_and_int16_inputs_match_double) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  // The mono signals are the means of the stereo channels, which are rounded
+  // back to 16 bits here.
+  std::vector<int16_t> ref_int16;
+  std::vector<int16_t> deg_int16;
+  std::vector<double> ref_data;
+  std::vector<double> deg_data;
+  for (double sample : ref_signal.data_matrix.ToVector()) {
+    ref_int16.push_back(std::lround(sample * 32768.0));
+    ref_data.push_back(ref_int16.back() / 32768.0);
+  }
+  for (double sample : deg_signal.data_matrix.ToVector()) {
+    deg_int16.push_back(std::lround(sample * 32768.0));
+    deg_data.push_back(deg_int16.back() / 32768.0);
+  }
+  const std::vector<float> ref_float(ref_data.begin(), ref_data.end());
+  const std::vector<float> deg_float(deg_data.begin(), deg_data.end());
+  const std::vector<double> ref_before = ref_data;
+  const std::vector<double> deg_before = deg_data;
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  auto double_result = visqol.Measure(absl::Span<double>(ref_data),
+                                      absl::Span<double>(deg_data));
+  auto float_result = visqol.Measure(absl::MakeConstSpan(ref_float),
+                                     absl::MakeConstSpan(deg_float));
+  auto int16_result = visqol.Measure(absl::MakeConstSpan(ref_int16),
+                                     absl::MakeConstSpan(deg_int16));
+
+  ASSERT_TRUE(double_result.ok());
+  ASSERT_TRUE(float_result.ok());
+  ASSERT_TRUE(int16_result.ok());
+  EXPECT_EQ(ref_before, ref_data);
+  EXPECT_EQ(deg_before, deg_data);
+  const double moslqo = double_result.ValueOrDie().moslqo();
+  EXPECT_NEAR(kConformanceContrabassoon24aac, moslqo, 0.01);
+  EXPECT_EQ(moslqo, float_result.ValueOrDie().moslqo());
+  EXPECT_EQ(moslqo, int16_result.ValueOrDie().moslqo());
+}
+
 /**
  *  Test calling the ViSQOL API without sample rate data for the input signals.
  */
@@ -286,5 +375,219 @@ TEST(VisqolApi, speech_mode_with_unscaled_mapping) {
   ASSERT_NEAR(kCA01_01UnscaledPerfectScore, sim_result.moslqo(), kTolerance);
 }
 
+/**
+ * Test that several asynchronous comparisons in flight on one instance, on
+ * the default executor and on a supplied one, match the synchronous result.
+ */
+TEST(VisqolApi, async_measurements_match_measure) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  auto result = visqol.Measure(absl::Span<double>(ref_data),
+                               absl::Span<double>(deg_data));
+  ASSERT_TRUE(result.ok());
+  const double moslqo = result.ValueOrDie().moslqo();
+
+  std::vector<
+      std::future<google::protobuf::util::StatusOr<SimilarityResultMsg>>>
+      futures;
+  for (int i = 0; i < 3; i++) {
+    futures.push_back(visqol.MeasureAsync(ref_data, deg_data));
+  }
+  for (auto &future : futures) {
+    auto async_result = future.get();
+    ASSERT_TRUE(async_result.ok());
+    EXPECT_EQ(moslqo, async_result.ValueOrDie().moslqo());
+  }
+
+  // The supplied executor runs the tasks once they have all been queued.
+  std::vector<std::function<void()>> tasks;
+  visqol.SetExecutor([&tasks](std::function<void()> task) {
+    tasks.push_back(std::move(task));
+  });
+  std::vector<double> callback_moslqos(2, 0.0);
+  for (size_t i = 0; i < callback_moslqos.size(); i++) {
+    visqol.MeasureAsync(ref_data, deg_data,
+        [&callback_moslqos, i](
+            google::protobuf::util::StatusOr<SimilarityResultMsg> async_result) {
+          ASSERT_TRUE(async_result.ok());
+          callback_moslqos[i] = async_result.ValueOrDie().moslqo();
+        });
+  }
+  ASSERT_EQ(callback_moslqos.size(), tasks.size());
+  std::vector<std::thread> threads;
+  for (auto &task : tasks) {
+    threads.emplace_back(task);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(std::vector<double>(callback_moslqos.size(), moslqo),
+            callback_moslqos);
+}
+
+/**
+ * Test that a batch with a shared reference, compared on several threads,
+ * gives each pair the result of Measure, in the order of the pairs.
+ */
+TEST(VisqolApi, measure_batch_matches_measure) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  auto deg_result = visqol.Measure(absl::Span<double>(ref_data),
+                                   absl::Span<double>(deg_data));
+  auto ref_result = visqol.Measure(absl::Span<double>(ref_data),
+                                   absl::Span<double>(ref_data));
+  ASSERT_TRUE(deg_result.ok());
+  ASSERT_TRUE(ref_result.ok());
+
+  const absl::Span<double> ref(ref_data);
+  const absl::Span<double> deg(deg_data);
+  const std::vector<VisqolApi::SignalPair> pairs{
+      {ref, deg}, {ref, ref}, {deg, deg}, {ref, deg}};
+  auto results = visqol.MeasureBatch(pairs, 2);
+  ASSERT_EQ(pairs.size(), results.size());
+  for (const auto &result : results) {
+    ASSERT_TRUE(result.ok());
+  }
+  EXPECT_NEAR(deg_result.ValueOrDie().moslqo(),
+              results[0].ValueOrDie().moslqo(), kTolerance);
+  EXPECT_NEAR(ref_result.ValueOrDie().moslqo(),
+              results[1].ValueOrDie().moslqo(), kTolerance);
+  EXPECT_NEAR(deg_result.ValueOrDie().moslqo(),
+              results[3].ValueOrDie().moslqo(), kTolerance);
+  EXPECT_GT(results[2].ValueOrDie().moslqo(),
+            results[0].ValueOrDie().moslqo());
+}
+
+/**
+ * Test that a batch of short clips that each have their own reference, which
+ * are mapped to quality together, gives each clip the result of Measure.
+ */
+TEST(VisqolApi, measure_batch_of_clips_matches_measure) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+
+  // Three second clips from the start, the middle and the end of the pair,
+  // and a clip that is compared with itself.
+  const size_t clip_samples = 3 * kSampleRate;
+  ASSERT_GE(ref_data.size(), 3 * clip_samples);
+  ASSERT_GE(deg_data.size(), 3 * clip_samples);
+  std::vector<VisqolApi::SignalPair> pairs;
+  for (const size_t start : {size_t{0}, clip_samples, 2 * clip_samples}) {
+    pairs.push_back({absl::Span<double>(ref_data.data() + start,
+                                        clip_samples),
+                     absl::Span<double>(deg_data.data() + start,
+                                        clip_samples)});
+  }
+  pairs.push_back({absl::Span<double>(deg_data.data(), clip_samples),
+                   absl::Span<double>(deg_data.data(), clip_samples)});
+
+  auto results = visqol.MeasureBatch(pairs, 2);
+  ASSERT_EQ(pairs.size(), results.size());
+  for (size_t i = 0; i < pairs.size(); i++) {
+    auto result = visqol.Measure(pairs[i].reference, pairs[i].degraded);
+    ASSERT_TRUE(result.ok());
+    ASSERT_TRUE(results[i].ok());
+    EXPECT_DOUBLE_EQ(result.ValueOrDie().moslqo(),
+                     results[i].ValueOrDie().moslqo());
+    EXPECT_DOUBLE_EQ(result.ValueOrDie().vnsim(),
+                     results[i].ValueOrDie().vnsim());
+  }
+}
+
+/**
+ * Test that comparing many degraded signals against one reference, on several
+ * threads, gives each degraded signal the result of Measure, in order.
+ */
+TEST(VisqolApi, measure_many_matches_measure) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  auto deg_result = visqol.Measure(absl::Span<double>(ref_data),
+                                   absl::Span<double>(deg_data));
+  auto ref_result = visqol.Measure(absl::Span<double>(ref_data),
+                                   absl::Span<double>(ref_data));
+  ASSERT_TRUE(deg_result.ok());
+  ASSERT_TRUE(ref_result.ok());
+
+  const absl::Span<double> ref(ref_data);
+  const absl::Span<double> deg(deg_data);
+  const std::vector<absl::Span<double>> degraded{deg, ref, deg};
+  auto results = visqol.MeasureMany(ref, degraded, 2);
+  ASSERT_EQ(degraded.size(), results.size());
+  for (const auto &result : results) {
+    ASSERT_TRUE(result.ok());
+  }
+  EXPECT_NEAR(deg_result.ValueOrDie().moslqo(),
+              results[0].ValueOrDie().moslqo(), kTolerance);
+  EXPECT_NEAR(ref_result.ValueOrDie().moslqo(),
+              results[1].ValueOrDie().moslqo(), kTolerance);
+  EXPECT_NEAR(deg_result.ValueOrDie().moslqo(),
+              results[2].ValueOrDie().moslqo(), kTolerance);
+}
+
+/**
+ * Test that concurrent calls to Measure on one instance each give the result
+ * of a call on its own.
+ */
+TEST(VisqolApi, concurrent_measure_matches_measure) {
+  AudioSignal ref_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonRef));
+  AudioSignal deg_signal = MiscAudio::LoadAsMono(FilePath(kContrabassoonDeg));
+  auto ref_data = ref_signal.data_matrix.ToVector();
+  auto deg_data = deg_signal.data_matrix.ToVector();
+
+  VisqolConfig config;
+  config.mutable_audio()->set_sample_rate(kSampleRate);
+  VisqolApi visqol;
+  ASSERT_TRUE(visqol.Create(config).ok());
+  auto result = visqol.Measure(absl::Span<double>(ref_data),
+                               absl::Span<double>(deg_data));
+  ASSERT_TRUE(result.ok());
+  const double moslqo = result.ValueOrDie().moslqo();
+
+  std::vector<double> concurrent_moslqos(4, 0.0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < concurrent_moslqos.size(); i++) {
+    threads.emplace_back([&, i]() {
+      auto concurrent_result = visqol.Measure(absl::Span<double>(ref_data),
+                                              absl::Span<double>(deg_data));
+      if (concurrent_result.ok()) {
+        concurrent_moslqos[i] = concurrent_result.ValueOrDie().moslqo();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(std::vector<double>(concurrent_moslqos.size(), moslqo),
+            concurrent_moslqos);
+}
+
 }  // namespace
 }  // namespace Visqol
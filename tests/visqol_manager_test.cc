@@ -14,10 +14,17 @@
 
 #include "visqol_manager.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "commandline_parser.h"
 #include "conformance.h"
+#include "file_path.h"
+#include "reference_feature_store.h"
 #include "similarity_result.h"
 #include "test_utility.h"
 
@@ -79,6 +86,584 @@ TEST(RegressionTest, Stereo) {
   EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(), kTolerance);
 }
 
+/**
+ * Ensure that searching and realigning the patches on several workers gives
+ * the same score.
+ */
+TEST(RegressionTest, ParallelPatches) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  Visqol::VisqolManager visqol;
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  options.set_num_patch_workers(4);
+  auto status = visqol.Init(cmd_args.sim_to_quality_mapper_model, options);
+  ASSERT_TRUE(status.ok());
+
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(), kTolerance);
+}
+
+/**
+ * Ensure that building the spectrograms in segments on several workers gives
+ * the same results as building them on the calling thread.
+ */
+TEST(RegressionTest, ParallelSegments) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+
+  Visqol::VisqolManager serial_visqol;
+  ASSERT_TRUE(serial_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                 options).ok());
+  auto serial_result = serial_visqol.Run(files_to_compare[0].reference,
+                                         files_to_compare[0].degraded);
+  ASSERT_TRUE(serial_result.ok());
+
+  options.set_num_segment_workers(4);
+  Visqol::VisqolManager segmented_visqol;
+  ASSERT_TRUE(segmented_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                    options).ok());
+  auto segmented_result = segmented_visqol.Run(files_to_compare[0].reference,
+                                               files_to_compare[0].degraded);
+  ASSERT_TRUE(segmented_result.ok());
+
+  const auto &serial = serial_result.ValueOrDie();
+  const auto &segmented = segmented_result.ValueOrDie();
+  EXPECT_EQ(serial.moslqo(), segmented.moslqo());
+  ASSERT_EQ(serial.fvnsim_size(), segmented.fvnsim_size());
+  for (int i = 0; i < serial.fvnsim_size(); i++) {
+    EXPECT_EQ(serial.fvnsim(i), segmented.fvnsim(i));
+  }
+  ASSERT_EQ(serial.patch_sims_size(), segmented.patch_sims_size());
+  for (int i = 0; i < serial.patch_sims_size(); i++) {
+    EXPECT_EQ(serial.patch_sims(i).similarity(),
+              segmented.patch_sims(i).similarity());
+    EXPECT_EQ(serial.patch_sims(i).deg_patch_start_time(),
+              segmented.patch_sims(i).deg_patch_start_time());
+  }
+}
+
+/**
+ * Ensure that the patches of identical signals skip the fine realignment when
+ * a realign skip similarity is set, without changing the score, and that every
+ * patch is realigned by default.
+ */
+TEST(RegressionTest, SkipRealignOfIdenticalPatches) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/castanets48_stereo.wav",
+       "testdata/conformance_testdata_subset/castanets48_stereo.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model, options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_EQ(0, status_or.ValueOrDie().num_realign_skipped_patches());
+
+  options.set_realign_skip_similarity(0.98);
+  Visqol::VisqolManager skipping_visqol;
+  ASSERT_TRUE(skipping_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                   options).ok());
+  auto skipped_status_or = skipping_visqol.Run(files_to_compare[0].reference,
+                                               files_to_compare[0].degraded);
+  ASSERT_TRUE(skipped_status_or.ok());
+  const auto &skipped_result = skipped_status_or.ValueOrDie();
+  EXPECT_EQ(skipped_result.patch_sims_size(),
+            skipped_result.num_realign_skipped_patches());
+  EXPECT_NEAR(kConformanceCastanetsIdentity, skipped_result.moslqo(),
+              kTolerance);
+}
+
+/**
+ * Ensure that the global lag is reported, and that searching around it as a
+ * hint, or reusing it across comparisons, finds the same lag and score.
+ */
+TEST(RegressionTest, GlobalLagHint) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model, options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const double global_lag = status_or.ValueOrDie().global_lag();
+
+  options.set_global_lag_hint(global_lag);
+  options.set_global_lag_search_window(0.01);
+  options.set_reuse_global_lag(true);
+  Visqol::VisqolManager hinted_visqol;
+  ASSERT_TRUE(hinted_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                 options).ok());
+  for (int run = 0; run < 2; run++) {
+    auto hinted_status_or = hinted_visqol.Run(files_to_compare[0].reference,
+                                              files_to_compare[0].degraded);
+    ASSERT_TRUE(hinted_status_or.ok());
+    EXPECT_EQ(global_lag, hinted_status_or.ValueOrDie().global_lag());
+    EXPECT_NEAR(kConformanceGuitar64aac,
+                hinted_status_or.ValueOrDie().moslqo(), kTolerance);
+  }
+}
+
+/**
+ * Ensure that comparisons that reuse a cached reference, including ones with
+ * another reference in between, give the conformance score.
+ */
+TEST(RegressionTest, ReferenceCache) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  const ReferenceDegradedPathPair other_pair{
+      FilePath("testdata/conformance_testdata_subset/contrabassoon48_stereo.wav"),
+      FilePath("testdata/conformance_testdata_subset/"
+               "contrabassoon48_stereo_24kbps_aac.wav")};
+  const std::vector<ReferenceDegradedPathPair> pairs{
+      files_to_compare[0], files_to_compare[0], other_pair,
+      files_to_compare[0]};
+
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  options.set_reference_cache_size(2);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model, options).ok());
+  auto results = visqol.Run(pairs);
+  ASSERT_EQ(pairs.size(), results.size());
+  EXPECT_NEAR(kConformanceGuitar64aac, results[0].moslqo(), kTolerance);
+  EXPECT_NEAR(kConformanceGuitar64aac, results[1].moslqo(), kTolerance);
+  EXPECT_NEAR(kConformanceContrabassoon24aac, results[2].moslqo(), kTolerance);
+  EXPECT_NEAR(kConformanceGuitar64aac, results[3].moslqo(), kTolerance);
+}
+
+/**
+ * Ensure that comparing several degraded files against one reference, on
+ * several threads, gives each the conformance score and its file paths.
+ */
+TEST(RegressionTest, RunMany) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  const std::vector<FilePath> deg_paths(3, files_to_compare[0].degraded);
+
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+      VisqolCommandLineParser::BuildVisqolOptions(cmd_args)).ok());
+  auto results = visqol.RunMany(files_to_compare[0].reference, deg_paths, 2);
+  ASSERT_EQ(deg_paths.size(), results.size());
+  for (const auto &result : results) {
+    ASSERT_TRUE(result.ok());
+    EXPECT_NEAR(kConformanceGuitar64aac, result.ValueOrDie().moslqo(),
+                kTolerance);
+    EXPECT_EQ(files_to_compare[0].reference.Path(),
+              result.ValueOrDie().reference_filepath());
+    EXPECT_EQ(files_to_compare[0].degraded.Path(),
+              result.ValueOrDie().degraded_filepath());
+  }
+}
+
+/**
+ * Ensure that the timeline groups every patch of a comparison into windows,
+ * without changing the overall score, and that a single window covering the
+ * whole comparison has the overall score.
+ */
+TEST(RegressionTest, Timeline) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  options.set_timeline_window(3.0);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model, options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto &result = status_or.ValueOrDie();
+  EXPECT_NEAR(kConformanceGuitar64aac, result.moslqo(), kTolerance);
+  ASSERT_GT(result.timeline_size(), 1);
+  int num_patches = 0;
+  double prev_start_time = -1.0;
+  for (const auto &window : result.timeline()) {
+    EXPECT_GT(window.start_time(), prev_start_time);
+    EXPECT_NEAR(3.0, window.end_time() - window.start_time(), kTolerance);
+    EXPECT_GT(window.num_patches(), 0);
+    EXPECT_GE(window.moslqo(), 1.0);
+    EXPECT_LE(window.moslqo(), 5.0);
+    prev_start_time = window.start_time();
+    num_patches += window.num_patches();
+  }
+  EXPECT_EQ(result.patch_sims_size(), num_patches);
+
+  options.set_timeline_window(60.0);
+  Visqol::VisqolManager whole_visqol;
+  ASSERT_TRUE(whole_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  status_or = whole_visqol.Run(files_to_compare[0].reference,
+                               files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  ASSERT_EQ(1, status_or.ValueOrDie().timeline_size());
+  EXPECT_NEAR(kConformanceGuitar64aac,
+              status_or.ValueOrDie().timeline(0).moslqo(), kTolerance);
+}
+
+/**
+ * Ensure that a patch budget compares that many patches, and reports how many
+ * were available and the standard error of each FVNSIM score, which is 0 when
+ * every patch is compared.
+ */
+TEST(RegressionTest, MaxPatches) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  Visqol::VisqolManager full_visqol;
+  ASSERT_TRUE(full_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                               options).ok());
+  auto status_or = full_visqol.Run(files_to_compare[0].reference,
+                                   files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto full_result = status_or.ValueOrDie();
+  EXPECT_NEAR(kConformanceGuitar64aac, full_result.moslqo(), kTolerance);
+  EXPECT_EQ(kGuitarNumPatches, full_result.num_patches());
+  EXPECT_EQ(kGuitarNumPatches, full_result.num_available_patches());
+  ASSERT_EQ(full_result.fvnsim_size(), full_result.fvnsim_stderr_size());
+  for (const double stderr_value : full_result.fvnsim_stderr()) {
+    EXPECT_EQ(0.0, stderr_value);
+  }
+
+  options.set_max_patches(5);
+  Visqol::VisqolManager budget_visqol;
+  ASSERT_TRUE(budget_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                 options).ok());
+  status_or = budget_visqol.Run(files_to_compare[0].reference,
+                                files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto budget_result = status_or.ValueOrDie();
+  EXPECT_EQ(5, budget_result.num_patches());
+  EXPECT_EQ(5, budget_result.patch_sims_size());
+  EXPECT_EQ(kGuitarNumPatches, budget_result.num_available_patches());
+  ASSERT_EQ(budget_result.fvnsim_size(), budget_result.fvnsim_stderr_size());
+  double max_stderr = 0.0;
+  for (int band = 0; band < budget_result.fvnsim_size(); band++) {
+    EXPECT_GE(budget_result.fvnsim_stderr(band), 0.0);
+    max_stderr = std::max(max_stderr, budget_result.fvnsim_stderr(band));
+  }
+  EXPECT_GT(max_stderr, 0.0);
+}
+
+/**
+ * Ensure that a loose target standard error stops the comparison after the
+ * first round of patches, and that a tight one compares every patch.
+ */
+TEST(RegressionTest, TargetVnsimStderr) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+
+  options.set_target_vnsim_stderr(1.0);
+  Visqol::VisqolManager loose_visqol;
+  ASSERT_TRUE(loose_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  auto status_or = loose_visqol.Run(files_to_compare[0].reference,
+                                    files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto loose_result = status_or.ValueOrDie();
+  // One round of patches is compared.
+  EXPECT_EQ(8, loose_result.num_patches());
+  EXPECT_EQ(kGuitarNumPatches, loose_result.num_available_patches());
+  for (int i = 1; i < loose_result.patch_sims_size(); i++) {
+    EXPECT_LT(loose_result.patch_sims(i - 1).ref_patch_start_time(),
+              loose_result.patch_sims(i).ref_patch_start_time());
+  }
+
+  options.set_target_vnsim_stderr(1e-9);
+  Visqol::VisqolManager tight_visqol;
+  ASSERT_TRUE(tight_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  status_or = tight_visqol.Run(files_to_compare[0].reference,
+                               files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_EQ(kGuitarNumPatches, status_or.ValueOrDie().num_patches());
+  EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(),
+              kTolerance);
+}
+
+/**
+ * Ensure that building only the searched columns of the degraded spectrogram
+ * gives the same results, in speech mode, where the silent patches are
+ * discarded, and in audio mode.
+ */
+TEST(RegressionTest, LazyDegradedSpectrogram) {
+  const Visqol::CommandLineArgs speech_args = CommandLineArgsHelper
+      ("testdata/clean_speech/CA01_01.wav",
+       "testdata/clean_speech/transcoded_CA01_01.wav");
+  auto files_to_compare =
+      VisqolCommandLineParser::BuildFilePairPaths(speech_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(speech_args);
+  options.set_use_speech_scoring(true);
+  Visqol::VisqolManager full_visqol;
+  ASSERT_TRUE(full_visqol.Init(speech_args.sim_to_quality_mapper_model,
+                               options).ok());
+  auto status_or = full_visqol.Run(files_to_compare[0].reference,
+                                   files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto full_result = status_or.ValueOrDie();
+
+  options.set_lazy_degraded_spectrogram(true);
+  Visqol::VisqolManager lazy_visqol;
+  ASSERT_TRUE(lazy_visqol.Init(speech_args.sim_to_quality_mapper_model,
+                               options).ok());
+  status_or = lazy_visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const auto lazy_result = status_or.ValueOrDie();
+  EXPECT_DOUBLE_EQ(full_result.moslqo(), lazy_result.moslqo());
+  EXPECT_DOUBLE_EQ(full_result.vnsim(), lazy_result.vnsim());
+  EXPECT_EQ(full_result.patch_sims_size(), lazy_result.patch_sims_size());
+
+  const Visqol::CommandLineArgs audio_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(audio_args);
+  options = VisqolCommandLineParser::BuildVisqolOptions(audio_args);
+  options.set_lazy_degraded_spectrogram(true);
+  Visqol::VisqolManager audio_visqol;
+  ASSERT_TRUE(audio_visqol.Init(audio_args.sim_to_quality_mapper_model,
+                                options).ok());
+  status_or = audio_visqol.Run(files_to_compare[0].reference,
+                               files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(),
+              kTolerance);
+}
+
+/**
+ * Ensure that features saved by one run are loaded by a later run, and give
+ * the conformance score.
+ */
+TEST(RegressionTest, SavedReferenceFeatures) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  options.set_ref_features_dir(::testing::TempDir());
+  options.set_write_ref_features(true);
+  const ReferenceFeatureStore store(options.ref_features_dir(), 0);
+  const std::string saved_path = store.PathFor(files_to_compare[0].reference);
+  std::remove(saved_path.c_str());
+
+  Visqol::VisqolManager writing_visqol;
+  ASSERT_TRUE(writing_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                  options).ok());
+  auto status_or = writing_visqol.Run(files_to_compare[0].reference,
+                                      files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(),
+              kTolerance);
+  ASSERT_TRUE(FilePath(saved_path).Exists());
+
+  options.set_write_ref_features(false);
+  Visqol::VisqolManager reading_visqol;
+  ASSERT_TRUE(reading_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                  options).ok());
+  status_or = reading_visqol.Run(files_to_compare[0].reference,
+                                 files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_NEAR(kConformanceGuitar64aac, status_or.ValueOrDie().moslqo(),
+              kTolerance);
+}
+
+/**
+ * Ensure that the multichannel option scores each channel, after aligning
+ * every channel by the lag of the downmix, and reports their mean, and that
+ * a mono file is scored as it is without the option.
+ */
+TEST(RegressionTest, Multichannel) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/conformance_testdata_subset/guitar48_stereo.wav",
+       "testdata/conformance_testdata_subset/guitar48_stereo_64kbps_aac.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  options.set_multichannel(true);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                          options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const SimilarityResultMsg result = status_or.ValueOrDie();
+  ASSERT_EQ(2, result.channels_size());
+  EXPECT_EQ(files_to_compare[0].reference.Path(), result.reference_filepath());
+  EXPECT_EQ(files_to_compare[0].degraded.Path(), result.degraded_filepath());
+  double moslqo_sum = 0.0;
+  int num_patches = 0;
+  for (const SimilarityResultMsg &channel : result.channels()) {
+    EXPECT_EQ(kGuitarNumPatches, channel.patch_sims_size());
+    EXPECT_EQ(result.global_lag(), channel.global_lag());
+    EXPECT_EQ(result.fvnsim_size(), channel.fvnsim_size());
+    EXPECT_GT(channel.moslqo(), 1.0);
+    EXPECT_LE(channel.moslqo(), kPerfectScore);
+    moslqo_sum += channel.moslqo();
+    num_patches += channel.num_patches();
+  }
+  EXPECT_NEAR(moslqo_sum / 2, result.moslqo(), kTolerance);
+  EXPECT_EQ(num_patches, result.num_patches());
+
+  const Visqol::CommandLineArgs mono_args = CommandLineArgsHelper
+      ("testdata/clean_speech/CA01_01.wav",
+       "testdata/clean_speech/transcoded_CA01_01.wav");
+  files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(mono_args);
+  options = VisqolCommandLineParser::BuildVisqolOptions(mono_args);
+  options.set_multichannel(true);
+  Visqol::VisqolManager mono_visqol;
+  ASSERT_TRUE(mono_visqol.Init(mono_args.sim_to_quality_mapper_model,
+                               options).ok());
+  status_or = mono_visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  ASSERT_EQ(1, status_or.ValueOrDie().channels_size());
+  EXPECT_NEAR(kMonoKnownMos, status_or.ValueOrDie().moslqo(), kTolerance);
+}
+
+/**
+ * Ensure that the stages of a comparison are only timed if asked to, and that
+ * timing them does not change the score.
+ */
+TEST(RegressionTest, StageTimings) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/clean_speech/CA01_01.wav",
+       "testdata/clean_speech/transcoded_CA01_01.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                          options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  EXPECT_FALSE(status_or.ValueOrDie().has_timings());
+
+  options.set_record_stage_timings(true);
+  Visqol::VisqolManager timed_visqol;
+  ASSERT_TRUE(timed_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                                options).ok());
+  auto timed_status_or = timed_visqol.Run(files_to_compare[0].reference,
+                                          files_to_compare[0].degraded);
+  ASSERT_TRUE(timed_status_or.ok());
+  const SimilarityResultMsg &result = timed_status_or.ValueOrDie();
+  EXPECT_NEAR(kMonoKnownMos, result.moslqo(), kTolerance);
+  ASSERT_TRUE(result.has_timings());
+  const auto &timings = result.timings();
+  EXPECT_GT(timings.load(), 0.0);
+  EXPECT_GT(timings.global_alignment(), 0.0);
+  EXPECT_GT(timings.spl_scaling(), 0.0);
+  EXPECT_GT(timings.spectrograms(), 0.0);
+  EXPECT_GT(timings.spectrogram_prep(), 0.0);
+  EXPECT_GT(timings.patch_indices(), 0.0);
+  EXPECT_GT(timings.coarse_search(), 0.0);
+  EXPECT_GT(timings.fine_alignment(), 0.0);
+  EXPECT_GT(timings.mapping(), 0.0);
+}
+
+/**
+ * Ensure that the bands and patches are only copied into the result at the
+ * detail that asks for them, and that the detail does not change the score.
+ */
+TEST(RegressionTest, ResultDetail) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/clean_speech/CA01_01.wav",
+       "testdata/clean_speech/transcoded_CA01_01.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  SimilarityResultMsg results[3];
+  const VisqolConfig::VisqolOptions::ResultDetail details[3] = {
+      VisqolConfig::VisqolOptions::FULL, VisqolConfig::VisqolOptions::BANDS,
+      VisqolConfig::VisqolOptions::SUMMARY};
+  for (size_t i = 0; i < 3; i++) {
+    options.set_result_detail(details[i]);
+    Visqol::VisqolManager visqol;
+    ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                            options).ok());
+    auto status_or = visqol.Run(files_to_compare[0].reference,
+                                files_to_compare[0].degraded);
+    ASSERT_TRUE(status_or.ok());
+    results[i] = status_or.ValueOrDie();
+    EXPECT_NEAR(kMonoKnownMos, results[i].moslqo(), kTolerance);
+    EXPECT_EQ(results[0].num_patches(), results[i].num_patches());
+  }
+
+  EXPECT_EQ(results[0].num_patches(), results[0].patch_sims_size());
+  EXPECT_GT(results[0].fvnsim_size(), 0);
+
+  EXPECT_EQ(0, results[1].patch_sims_size());
+  ASSERT_EQ(results[0].fvnsim_size(), results[1].fvnsim_size());
+  for (int band = 0; band < results[0].fvnsim_size(); band++) {
+    EXPECT_EQ(results[0].fvnsim(band), results[1].fvnsim(band));
+  }
+  EXPECT_EQ(results[0].center_freq_bands_size(),
+            results[1].center_freq_bands_size());
+
+  EXPECT_EQ(0, results[2].patch_sims_size());
+  EXPECT_EQ(0, results[2].fvnsim_size());
+  EXPECT_EQ(0, results[2].center_freq_bands_size());
+  EXPECT_EQ(results[0].vnsim(), results[2].vnsim());
+}
+
+/**
+ * Ensure that a file compared to itself with the identical signal detection
+ * is flagged as identical without comparing any patches, and scores as the
+ * full comparison does.
+ */
+TEST(RegressionTest, IdenticalSignals) {
+  const Visqol::CommandLineArgs cmd_args = CommandLineArgsHelper
+      ("testdata/clean_speech/CA01_01.wav",
+       "testdata/clean_speech/CA01_01.wav");
+  auto files_to_compare = VisqolCommandLineParser::BuildFilePairPaths(cmd_args);
+  auto options = VisqolCommandLineParser::BuildVisqolOptions(cmd_args);
+  Visqol::VisqolManager full_visqol;
+  ASSERT_TRUE(full_visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                               options).ok());
+  auto full_or = full_visqol.Run(files_to_compare[0].reference,
+                                 files_to_compare[0].degraded);
+  ASSERT_TRUE(full_or.ok());
+  const SimilarityResultMsg full = full_or.ValueOrDie();
+  EXPECT_FALSE(full.identical_signals());
+
+  options.set_detect_identical_signals(true);
+  Visqol::VisqolManager visqol;
+  ASSERT_TRUE(visqol.Init(cmd_args.sim_to_quality_mapper_model,
+                          options).ok());
+  auto status_or = visqol.Run(files_to_compare[0].reference,
+                              files_to_compare[0].degraded);
+  ASSERT_TRUE(status_or.ok());
+  const SimilarityResultMsg result = status_or.ValueOrDie();
+  EXPECT_TRUE(result.identical_signals());
+  EXPECT_EQ(0, result.num_patches());
+  EXPECT_EQ(1.0, result.vnsim());
+  EXPECT_NEAR(full.moslqo(), result.moslqo(), kTolerance);
+  ASSERT_EQ(full.fvnsim_size(), result.fvnsim_size());
+  ASSERT_EQ(full.center_freq_bands_size(), result.center_freq_bands_size());
+  for (int band = 0; band < full.center_freq_bands_size(); band++) {
+    EXPECT_EQ(full.center_freq_bands(band), result.center_freq_bands(band));
+  }
+}
+
 /**
  * Pass an invalid model to VisqolManager and ensure an INVALID_ARGUMENT
  * status is returned.
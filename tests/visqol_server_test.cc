@@ -0,0 +1,268 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "visqol_server.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "google/protobuf/stubs/status.h"
+
+#include "audio_signal.h"
+#include "conformance.h"
+#include "file_path.h"
+#include "misc_audio.h"
+#include "visqol_service.pb.h"  // Generated by cc_proto_library rule
+
+namespace Visqol {
+namespace {
+
+const size_t kSampleRate = 48000;
+const char kContrabassoonRef[] =
+  "testdata/conformance_testdata_subset/contrabassoon48_stereo.wav";
+const char kContrabassoonDeg[] =
+  "testdata/conformance_testdata_subset/contrabassoon48_stereo_24kbps_aac.wav";
+
+// The seals that the server requires of the descriptors of shared samples.
+const int kSharedSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+
+// Ensure that requests for files and for inline samples are served over the
+// socket, on the same warm instance, with the same results.
+TEST(VisqolServerTest, ServesPathsAndInlineSamples) {
+  // Socket paths are limited to around 100 characters, which the test
+  // directory may exceed.
+  const std::string socket_path = "/tmp/visqol_server_test_" +
+      std::to_string(getpid()) + ".sock";
+  VisqolServer server(1, 4);
+  google::protobuf::util::Status serve_status;
+  std::thread serve_thread([&]() { serve_status = server.Serve(socket_path); });
+
+  VisqolRequest path_request;
+  path_request.set_reference_path(kContrabassoonRef);
+  path_request.set_degraded_path(kContrabassoonDeg);
+  // The server may still be starting up.
+  auto path_response_or = VisqolServer::Call(socket_path, path_request);
+  for (int attempt = 0; !path_response_or.ok() && attempt < 100; attempt++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    path_response_or = VisqolServer::Call(socket_path, path_request);
+  }
+  ASSERT_TRUE(path_response_or.ok());
+  const VisqolResponse &path_response = path_response_or.ValueOrDie();
+  ASSERT_EQ(0, path_response.error_code()) << path_response.error_message();
+  const double moslqo = path_response.result().moslqo();
+  EXPECT_NEAR(kConformanceContrabassoon24aac, moslqo, 0.01);
+
+  // The mono samples are means of 16 bit samples, so they are exact as
+  // floats.
+  VisqolRequest inline_request;
+  inline_request.mutable_config()->mutable_audio()->set_sample_rate(
+      kSampleRate);
+  const AudioSignal ref_signal = MiscAudio::LoadAsMono(
+      FilePath(kContrabassoonRef));
+  const AudioSignal deg_signal = MiscAudio::LoadAsMono(
+      FilePath(kContrabassoonDeg));
+  for (double sample : ref_signal.data_matrix.ToVector()) {
+    inline_request.add_reference_samples(sample);
+  }
+  for (double sample : deg_signal.data_matrix.ToVector()) {
+    inline_request.add_degraded_samples(sample);
+  }
+  auto inline_response_or = VisqolServer::Call(socket_path, inline_request);
+  ASSERT_TRUE(inline_response_or.ok());
+  EXPECT_EQ(0, inline_response_or.ValueOrDie().error_code());
+  EXPECT_EQ(moslqo, inline_response_or.ValueOrDie().result().moslqo());
+
+  server.Shutdown();
+  serve_thread.join();
+  EXPECT_TRUE(serve_status.ok());
+}
+
+// Ensure that samples that are shared through a descriptor passed over the
+// socket are compared as the same inline samples are.
+TEST(VisqolServerTest, ServesSharedSamples) {
+  const std::string socket_path = "/tmp/visqol_server_shared_test_" +
+      std::to_string(getpid()) + ".sock";
+  VisqolServer server(1, 4);
+  google::protobuf::util::Status serve_status;
+  std::thread serve_thread([&]() { serve_status = server.Serve(socket_path); });
+
+  // The reference is shared as doubles and the degraded signal as floats
+  // that follow it in the same file, which are both exact.
+  const std::vector<double> ref_samples = MiscAudio::LoadAsMono(
+      FilePath(kContrabassoonRef)).data_matrix.ToVector();
+  const std::vector<double> deg_doubles = MiscAudio::LoadAsMono(
+      FilePath(kContrabassoonDeg)).data_matrix.ToVector();
+  const std::vector<float> deg_samples(deg_doubles.begin(), deg_doubles.end());
+  const int shared_fd = memfd_create("visqol_shared", MFD_ALLOW_SEALING);
+  ASSERT_GE(shared_fd, 0);
+  const size_t ref_bytes = ref_samples.size() * sizeof(double);
+  const size_t deg_bytes = deg_samples.size() * sizeof(float);
+  ASSERT_EQ(static_cast<ssize_t>(ref_bytes),
+            write(shared_fd, ref_samples.data(), ref_bytes));
+  ASSERT_EQ(static_cast<ssize_t>(deg_bytes),
+            write(shared_fd, deg_samples.data(), deg_bytes));
+  ASSERT_EQ(0, fcntl(shared_fd, F_ADD_SEALS, kSharedSeals));
+
+  VisqolRequest shared_request;
+  shared_request.mutable_config()->mutable_audio()->set_sample_rate(
+      kSampleRate);
+  auto ref_shared = shared_request.mutable_reference_shared();
+  ref_shared->set_num_samples(ref_samples.size());
+  auto deg_shared = shared_request.mutable_degraded_shared();
+  deg_shared->set_offset(ref_bytes);
+  deg_shared->set_num_samples(deg_samples.size());
+  deg_shared->set_format(SharedSamples::FLOAT32);
+  VisqolRequest inline_request = shared_request;
+  inline_request.clear_reference_shared();
+  inline_request.clear_degraded_shared();
+  for (double sample : ref_samples) {
+    inline_request.add_reference_samples(sample);
+  }
+  for (float sample : deg_samples) {
+    inline_request.add_degraded_samples(sample);
+  }
+
+  // The server may still be starting up.
+  auto shared_response_or = VisqolServer::Call(socket_path, shared_request,
+                                               {shared_fd});
+  for (int attempt = 0; !shared_response_or.ok() && attempt < 100;
+       attempt++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    shared_response_or = VisqolServer::Call(socket_path, shared_request,
+                                            {shared_fd});
+  }
+  ASSERT_TRUE(shared_response_or.ok());
+  const VisqolResponse &shared_response = shared_response_or.ValueOrDie();
+  ASSERT_EQ(0, shared_response.error_code())
+      << shared_response.error_message();
+  auto inline_response_or = VisqolServer::Call(socket_path, inline_request);
+  ASSERT_TRUE(inline_response_or.ok());
+  EXPECT_EQ(inline_response_or.ValueOrDie().result().moslqo(),
+            shared_response.result().moslqo());
+
+  // Samples beyond the end of the file are rejected.
+  deg_shared->set_num_samples(deg_samples.size() + 1);
+  shared_response_or = VisqolServer::Call(socket_path, shared_request,
+                                          {shared_fd});
+  ASSERT_TRUE(shared_response_or.ok());
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            shared_response_or.ValueOrDie().error_code());
+
+  close(shared_fd);
+  server.Shutdown();
+  serve_thread.join();
+  EXPECT_TRUE(serve_status.ok());
+}
+
+// Ensure that shared samples are only mapped from a descriptor that the
+// client can no longer truncate, as truncating a mapped descriptor during a
+// comparison would kill the server with SIGBUS.
+TEST(VisqolServerTest, RequiresSealedSharedSamples) {
+  VisqolServer server(1, 0);
+  // Three seconds of a tone, compared with itself.
+  std::vector<double> samples(3 * kSampleRate);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = 0.5 * std::sin(2.0 * M_PI * 440.0 * i / kSampleRate);
+  }
+  const size_t num_bytes = samples.size() * sizeof(double);
+  const int shared_fd = memfd_create("visqol_unsealed", MFD_ALLOW_SEALING);
+  ASSERT_GE(shared_fd, 0);
+  ASSERT_EQ(static_cast<ssize_t>(num_bytes),
+            write(shared_fd, samples.data(), num_bytes));
+
+  VisqolRequest request;
+  request.mutable_config()->mutable_audio()->set_sample_rate(kSampleRate);
+  request.mutable_reference_shared()->set_num_samples(samples.size());
+  request.mutable_degraded_shared()->set_num_samples(samples.size());
+
+  // An unsealed descriptor can be truncated, so it is rejected.
+  ASSERT_EQ(0, ftruncate(shared_fd, num_bytes / 2));
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            server.Handle(request, {shared_fd}).error_code());
+  ASSERT_EQ(0, ftruncate(shared_fd, num_bytes));
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            server.Handle(request, {shared_fd}).error_code());
+
+  // Sealing it against shrinking alone does not keep it from being written.
+  ASSERT_EQ(0, fcntl(shared_fd, F_ADD_SEALS, F_SEAL_SHRINK));
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            server.Handle(request, {shared_fd}).error_code());
+
+  // Once sealed, the descriptor can no longer be truncated.
+  ASSERT_EQ(0, fcntl(shared_fd, F_ADD_SEALS, kSharedSeals));
+  EXPECT_EQ(-1, ftruncate(shared_fd, 0));
+  EXPECT_EQ(EPERM, errno);
+  const VisqolResponse response = server.Handle(request, {shared_fd});
+  EXPECT_EQ(0, response.error_code()) << response.error_message();
+  close(shared_fd);
+}
+
+// Ensure that a message larger than the chunks that its body is read in
+// arrives whole, and that a size prefix beyond the limit is rejected.
+TEST(VisqolServerTest, ReadsMessagesInChunks) {
+  int sockets[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  VisqolRequest request;
+  request.set_reference_path(std::string(3 << 20, 'r'));
+  VisqolRequest received;
+  std::thread writer([&]() {
+    EXPECT_TRUE(VisqolServer::WriteMessage(sockets[0], request));
+  });
+  ASSERT_TRUE(VisqolServer::ReadMessage(sockets[1], &received));
+  writer.join();
+  EXPECT_EQ(request.reference_path(), received.reference_path());
+
+  const unsigned char too_large[4] = {0xff, 0xff, 0xff, 0xff};
+  ASSERT_EQ(4, write(sockets[0], too_large, sizeof(too_large)));
+  EXPECT_FALSE(VisqolServer::ReadMessage(sockets[1], &received));
+  close(sockets[0]);
+  close(sockets[1]);
+}
+
+// Ensure that the errors of a request are returned in its response.
+TEST(VisqolServerTest, ReturnsErrors) {
+  VisqolServer server(1, 0);
+  VisqolRequest request;
+  request.add_reference_samples(0.0f);
+  request.add_degraded_samples(0.0f);
+  const VisqolResponse response = server.Handle(request);
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            response.error_code());
+
+  // Shared samples must refer to a descriptor that was passed.
+  VisqolRequest shared_request = request;
+  shared_request.mutable_config()->mutable_audio()->set_sample_rate(
+      kSampleRate);
+  shared_request.mutable_reference_shared()->set_fd_index(1);
+  shared_request.mutable_reference_shared()->set_num_samples(1);
+  EXPECT_EQ(google::protobuf::util::error::Code::INVALID_ARGUMENT,
+            server.Handle(shared_request).error_code());
+
+  request.mutable_config()->mutable_options()->set_svr_model_path(
+      "/does/not/exist.txt");
+  EXPECT_NE(0, server.Handle(request).error_code());
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,163 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "visqol_workspace.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+
+#include "amatrix.h"
+#include "analysis_window.h"
+#include "audio_signal.h"
+#include "audio_signal_view.h"
+#include "gammatone_filterbank.h"
+#include "gammatone_spectrogram_builder.h"
+#include "spectrogram.h"
+
+namespace Visqol {
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kNumBands = 32;
+const double kMinimumFreq = 50;
+const double kOverlap = 0.25;
+
+// Allocate the buffers of a pretend comparison, which need several blocks.
+void AllocateComparison(VisqolWorkspace *workspace) {
+  for (size_t i = 1; i <= 8; i++) {
+    absl::Span<double> doubles = workspace->Allocate<double>(i * 4000);
+    doubles[doubles.size() - 1] = 1.0;
+    absl::Span<float> floats = workspace->Allocate<float>(i * 3);
+    floats[floats.size() - 1] = 1.0f;
+  }
+}
+
+// Test that buffers do not overlap and are aligned for their type.
+TEST(VisqolWorkspace, BuffersAreDistinctAndAligned) {
+  VisqolWorkspace workspace;
+  const absl::Span<float> first = workspace.Allocate<float>(3);
+  const absl::Span<double> second = workspace.Allocate<double>(5);
+  const absl::Span<double> third = workspace.Allocate<double>(
+      VisqolWorkspace::kMinBlockBytes);
+
+  EXPECT_EQ(3u, first.size());
+  EXPECT_EQ(5u, second.size());
+  EXPECT_EQ(VisqolWorkspace::kMinBlockBytes, third.size());
+  EXPECT_LE(reinterpret_cast<const char *>(first.data() + first.size()),
+            reinterpret_cast<const char *>(second.data()));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(second.data()) % alignof(double));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(third.data()) % alignof(double));
+  // The third buffer does not fit in the first block.
+  EXPECT_EQ(2u, workspace.NumBlockAllocations());
+}
+
+// Test that once a comparison has been run, resetting the workspace keeps
+// enough memory for another comparison of the same size.
+TEST(VisqolWorkspace, SteadyStateAllocatesNoBlocks) {
+  VisqolWorkspace workspace;
+  AllocateComparison(&workspace);
+  ASSERT_GT(workspace.NumBlockAllocations(), 1u);
+  workspace.Reset();
+
+  const size_t num_block_allocations = workspace.NumBlockAllocations();
+  const size_t capacity = workspace.Capacity();
+  for (size_t i = 0; i < 4; i++) {
+    AllocateComparison(&workspace);
+    workspace.Reset();
+  }
+  EXPECT_EQ(num_block_allocations, workspace.NumBlockAllocations());
+  EXPECT_EQ(capacity, workspace.Capacity());
+}
+
+// Test that a recycled matrix is taken again for a matrix of the same size,
+// and only for that size.
+TEST(VisqolWorkspace, TakeMatrixReusesRecycledMatrix) {
+  VisqolWorkspace workspace;
+  AMatrix<double> matrix = workspace.TakeMatrix(kNumBands, 100);
+  const double *buffer = matrix.MemPtr();
+  workspace.RecycleMatrix(std::move(matrix));
+  workspace.Reset();
+
+  const AMatrix<double> same_size = workspace.TakeMatrix(kNumBands, 100);
+  EXPECT_EQ(buffer, same_size.MemPtr());
+  EXPECT_EQ(kNumBands, same_size.NumRows());
+  EXPECT_EQ(100u, same_size.NumCols());
+  EXPECT_EQ(1u, workspace.NumMatrixAllocations());
+
+  const AMatrix<double> other_size = workspace.TakeMatrix(kNumBands, 50);
+  EXPECT_EQ(50u, other_size.NumCols());
+  EXPECT_EQ(2u, workspace.NumMatrixAllocations());
+}
+
+// Test that building a spectrogram with a workspace gives the same result as
+// building it from the heap, and that rebuilding it after a reset allocates
+// no blocks. The view has leading silence, so the builder copies the signal
+// into the workspace.
+TEST(VisqolWorkspace, BuildSpectrogramWithWorkspace) {
+  std::vector<double> samples(kSampleRate);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = std::sin(2.0 * M_PI * 440.0 * i / kSampleRate) +
+        0.5 * std::sin(2.0 * M_PI * 3000.0 * i / kSampleRate);
+  }
+  const AudioSignal signal{AMatrix<double>(samples), kSampleRate};
+  const AudioSignalView view(signal, -1000, samples.size());
+  const AnalysisWindow window{kSampleRate, kOverlap};
+  const GammatoneSpectrogramBuilder builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+
+  const Spectrogram expected = builder.Build(view, window).ValueOrDie();
+  VisqolWorkspace workspace;
+  const Spectrogram first = builder.Build(view, window, &workspace)
+      .ValueOrDie();
+  workspace.Reset();
+  const size_t num_block_allocations = workspace.NumBlockAllocations();
+  const Spectrogram second = builder.Build(view, window, &workspace)
+      .ValueOrDie();
+  workspace.Reset();
+
+  EXPECT_GT(num_block_allocations, 0u);
+  EXPECT_EQ(num_block_allocations, workspace.NumBlockAllocations());
+  ASSERT_EQ(expected.Data().NumElements(), first.Data().NumElements());
+  for (size_t i = 0; i < expected.Data().NumElements(); i++) {
+    ASSERT_EQ(expected.Data()(i), first.Data()(i));
+    ASSERT_EQ(expected.Data()(i), second.Data()(i));
+  }
+}
+// Test that a spectrogram of a clip of the same length as the last one is
+// built into the recycled matrix of the last one.
+TEST(VisqolWorkspace, BuildSpectrogramReusesRecycledMatrix) {
+  const std::vector<double> samples(kSampleRate, 0.5);
+  const AudioSignal signal{AMatrix<double>(samples), kSampleRate};
+  const AnalysisWindow window{kSampleRate, kOverlap};
+  const GammatoneSpectrogramBuilder builder(
+      GammatoneFilterBank{kNumBands, kMinimumFreq}, false);
+  VisqolWorkspace workspace;
+
+  Spectrogram first = builder.Build(signal, window, &workspace).ValueOrDie();
+  const double *buffer = first.Data().MemPtr();
+  workspace.RecycleMatrix(first.ReleaseData());
+  workspace.Reset();
+  const Spectrogram second = builder.Build(signal, window, &workspace)
+      .ValueOrDie();
+
+  EXPECT_EQ(buffer, second.Data().MemPtr());
+  EXPECT_EQ(1u, workspace.NumMatrixAllocations());
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,200 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "wav_reader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "misc_audio.h"
+
+namespace Visqol {
+namespace {
+
+const char kStereoFile[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo.wav";
+const char kMonoFile[] = "testdata/clean_speech/CA01_01.wav";
+
+// The block size is not a multiple of the decoder's internal block, so the
+// last block of the file is a partial one.
+const size_t kBlockSize = 10007;
+
+// Stream a file in fixed size blocks of the given type.
+template <typename T>
+std::vector<T> StreamMono(const char *path) {
+  std::ifstream wav_file(FilePath(path).Path().c_str(), std::ios::binary);
+  WavReader wav_reader(&wav_file);
+  EXPECT_TRUE(wav_reader.IsHeaderValid());
+  std::vector<T> samples;
+  std::vector<T> block(kBlockSize);
+  size_t num_frames_read;
+  while ((num_frames_read = wav_reader.ReadMonoBlock(
+      absl::MakeSpan(block))) > 0) {
+    samples.insert(samples.end(), block.begin(),
+                   block.begin() + num_frames_read);
+  }
+  return samples;
+}
+
+// Ensure that streaming a file in blocks gives the same samples as loading
+// the whole file, for both a stereo and a mono file.
+TEST(WavReaderTest, StreamedBlocksMatchLoadAsMono) {
+  for (const char *path : {kStereoFile, kMonoFile}) {
+    const AudioSignal loaded = MiscAudio::LoadAsMono(FilePath(path));
+    const std::vector<double> streamed = StreamMono<double>(path);
+    ASSERT_EQ(loaded.data_matrix.NumRows(), streamed.size());
+    for (size_t i = 0; i < streamed.size(); i++) {
+      ASSERT_EQ(loaded.data_matrix(i), streamed[i]);
+    }
+  }
+}
+
+// Ensure that the single precision blocks are the rounded double precision
+// samples.
+TEST(WavReaderTest, FloatBlocksMatchDouble) {
+  const std::vector<double> expected = StreamMono<double>(kStereoFile);
+  const std::vector<float> streamed = StreamMono<float>(kStereoFile);
+  ASSERT_EQ(expected.size(), streamed.size());
+  for (size_t i = 0; i < streamed.size(); i++) {
+    ASSERT_EQ(static_cast<float>(expected[i]), streamed[i]);
+  }
+}
+
+// The encodings of a WAV file's samples.
+enum class Encoding { kInt24, kInt32, kFloat32 };
+
+// Append a little endian value of the given number of bytes.
+void AppendBytes(uint32_t value, size_t num_bytes, std::string *bytes) {
+  for (size_t i = 0; i < num_bytes; i++) {
+    bytes->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+// Encode 16 bit samples as a WAV file of another encoding with the same
+// normalized values, optionally in the extensible format. A 'fact' chunk is
+// written before the data, as some encoders do.
+std::string EncodeWav(const std::vector<int16_t> &samples, size_t num_channels,
+                      Encoding encoding, bool extensible) {
+  const size_t bytes_per_sample = encoding == Encoding::kInt24 ? 3 : 4;
+  const uint16_t format_tag = encoding == Encoding::kFloat32 ? 3 : 1;
+  std::string data;
+  for (const int16_t sample : samples) {
+    if (encoding == Encoding::kFloat32) {
+      const float value = sample / 32768.0f;
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      AppendBytes(bits, 4, &data);
+    } else {
+      const int32_t value = static_cast<int32_t>(sample) *
+          (encoding == Encoding::kInt24 ? 256 : 65536);
+      AppendBytes(static_cast<uint32_t>(value), bytes_per_sample, &data);
+    }
+  }
+
+  std::string format;
+  AppendBytes(extensible ? 0xfffe : format_tag, 2, &format);
+  AppendBytes(num_channels, 2, &format);
+  AppendBytes(48000, 4, &format);
+  AppendBytes(48000 * num_channels * bytes_per_sample, 4, &format);
+  AppendBytes(num_channels * bytes_per_sample, 2, &format);
+  AppendBytes(8 * bytes_per_sample, 2, &format);
+  if (extensible) {
+    AppendBytes(22, 2, &format);
+    AppendBytes(8 * bytes_per_sample, 2, &format);
+    AppendBytes(0, 4, &format);
+    // The sub format GUID, KSDATAFORMAT_SUBTYPE_PCM or _IEEE_FLOAT.
+    AppendBytes(format_tag, 2, &format);
+    format += std::string("\x00\x00\x00\x00\x10\x00\x80\x00\x00\xaa\x00"
+                          "\x38\x9b\x71", 14);
+  }
+
+  std::string wav = "RIFF";
+  AppendBytes(4 + 8 + format.size() + 12 + 8 + data.size(), 4, &wav);
+  wav += "WAVEfmt ";
+  AppendBytes(format.size(), 4, &wav);
+  wav += format;
+  wav += "fact";
+  AppendBytes(4, 4, &wav);
+  AppendBytes(samples.size() / num_channels, 4, &wav);
+  wav += "data";
+  AppendBytes(data.size(), 4, &wav);
+  return wav + data;
+}
+
+// Ensure that 24 and 32 bit PCM and 32 bit float files, in both the plain
+// and the extensible formats, decode to the same samples as the 16 bit file
+// that they encode.
+TEST(WavReaderTest, DecodesHighResolutionFormats) {
+  std::ifstream wav_file(FilePath(kStereoFile).Path().c_str(),
+                         std::ios::binary);
+  WavReader wav_reader(&wav_file);
+  ASSERT_TRUE(wav_reader.IsHeaderValid());
+  std::vector<int16_t> samples(wav_reader.GetNumTotalSamples());
+  ASSERT_EQ(samples.size(),
+            wav_reader.ReadSamples(samples.size(), samples.data()));
+  const std::vector<double> expected = StreamMono<double>(kStereoFile);
+
+  for (const Encoding encoding :
+       {Encoding::kInt24, Encoding::kInt32, Encoding::kFloat32}) {
+    for (const bool extensible : {false, true}) {
+      std::istringstream stream(EncodeWav(samples, 2, encoding, extensible));
+      WavReader reader(&stream);
+      ASSERT_TRUE(reader.IsHeaderValid());
+      EXPECT_EQ(2, reader.GetNumChannels());
+      EXPECT_EQ(48000, reader.GetSampleRateHz());
+      ASSERT_EQ(samples.size(), reader.GetNumTotalSamples());
+      // Only 16 bit files can be read as 16 bit samples.
+      int16_t sample;
+      EXPECT_EQ(0, reader.ReadSamples(1, &sample));
+
+      std::vector<double> decoded(expected.size());
+      ASSERT_EQ(expected.size(),
+                reader.ReadMonoSamples(decoded.size(), decoded.data()));
+      for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i], decoded[i]);
+      }
+    }
+  }
+}
+
+// Ensure that an 8 bit file is rejected.
+TEST(WavReaderTest, RejectsUnsupportedSampleSize) {
+  std::string wav = "RIFF";
+  AppendBytes(4 + 24 + 8 + 2, 4, &wav);
+  wav += "WAVEfmt ";
+  AppendBytes(16, 4, &wav);
+  AppendBytes(1, 2, &wav);
+  AppendBytes(1, 2, &wav);
+  AppendBytes(48000, 4, &wav);
+  AppendBytes(48000, 4, &wav);
+  AppendBytes(1, 2, &wav);
+  AppendBytes(8, 2, &wav);
+  wav += "data";
+  AppendBytes(2, 4, &wav);
+  wav += std::string("\x80\x80", 2);
+  std::istringstream stream(wav);
+  const WavReader reader(&stream);
+  EXPECT_FALSE(reader.IsHeaderValid());
+}
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,82 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "wav_tile_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "audio_signal.h"
+#include "file_path.h"
+#include "misc_audio.h"
+
+namespace Visqol {
+namespace {
+
+const char kStereoPath[] =
+    "testdata/conformance_testdata_subset/guitar48_stereo.wav";
+
+// Ensure that the ranges read from a file, including those that overlap,
+// skip ahead or lie partly outside of it, hold the samples that loading the
+// whole file as mono gives.
+TEST(WavTileReader, ReadsRangesOfTheMonoSamples) {
+  const AudioSignal whole = MiscAudio::LoadAsMono(FilePath(kStereoPath));
+  const std::vector<double> samples = whole.data_matrix.ToVector();
+  const int64_t num_samples = samples.size();
+
+  WavTileReader reader{FilePath(kStereoPath)};
+  ASSERT_TRUE(reader.ok());
+  EXPECT_EQ(whole.sample_rate, reader.SampleRate());
+  EXPECT_EQ(samples.size(), reader.NumSamples());
+
+  const struct {
+    int64_t first_sample;
+    size_t num_samples;
+  } ranges[] = {
+      {-100, 1000},
+      {500, 2000},
+      {1500, 100},
+      {100000, 5000},
+      {num_samples - 10, 100},
+      {num_samples + 10, 100},
+  };
+  for (const auto &range : ranges) {
+    int64_t signal_first_sample;
+    const AudioSignal tile = reader.Read(range.first_sample,
+        range.num_samples, &signal_first_sample);
+    const int64_t begin = std::min(std::max<int64_t>(range.first_sample, 0),
+                                   num_samples);
+    const int64_t end = std::max(begin, std::min<int64_t>(
+        range.first_sample + range.num_samples, num_samples));
+    EXPECT_EQ(begin, signal_first_sample);
+    EXPECT_EQ(whole.sample_rate, tile.sample_rate);
+    ASSERT_EQ(static_cast<size_t>(end - begin), tile.data_matrix.NumRows());
+    const std::vector<double> tile_samples = tile.data_matrix.ToVector();
+    EXPECT_TRUE(std::equal(tile_samples.begin(), tile_samples.end(),
+                           samples.begin() + begin));
+  }
+}
+
+// Ensure that a missing file is not ok.
+TEST(WavTileReader, MissingFile) {
+  WavTileReader reader{FilePath("testdata/missing.wav")};
+  EXPECT_FALSE(reader.ok());
+}
+
+}  // namespace
+}  // namespace Visqol
@@ -0,0 +1,65 @@
+// Copyright 2019 Google LLC, Andrew Hines
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "worker_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "parallel_executor.h"
+#include "task_graph.h"
+
+namespace Visqol {
+namespace {
+
+// Ensure that the jobs that are queued when the pool is destroyed are run
+// before its threads stop.
+TEST(WorkerPool, RunsQueuedJobs) {
+  std::atomic<int> num_run(0);
+  {
+    WorkerPool pool(2);
+    ASSERT_EQ(2, pool.NumThreads());
+    for (int i = 0; i < 100; i++) {
+      pool.Submit([&num_run]() { num_run++; });
+    }
+  }
+  EXPECT_EQ(100, num_run);
+}
+
+// Ensure that executors nested in the tasks of each other, which all take
+// their workers from the shared pool, run every task and complete.
+TEST(WorkerPool, NestedExecutorsComplete) {
+  for (int run = 0; run < 20; run++) {
+    std::vector<std::atomic<int>> counts(8);
+    ParallelExecutor::ForEach(counts.size(), counts.size(), [&](size_t i) {
+      TaskGraph graph;
+      for (int t = 0; t < 4; t++) {
+        graph.AddTask([&counts, i]() {
+          ParallelExecutor::ForEach(25, 8, [&counts, i](size_t) {
+            counts[i]++;
+          });
+        });
+      }
+      graph.Run(4);
+    });
+    for (const auto &count : counts) {
+      EXPECT_EQ(100, count);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace Visqol
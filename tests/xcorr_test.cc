@@ -14,6 +14,9 @@
 
 #include "xcorr.h"
 
+#include <random>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace Visqol {
@@ -79,5 +82,52 @@ TEST(XCorr, NegativeBestLag) {
   ASSERT_EQ(kBestLagNegative2, best_lag);
 }
 
+// Test signals that are shorter than the smallest FFT, whose negative lags
+// wrap around to the end of the whole FFT, and that the batched calculation
+// gives the same lags.
+TEST(XCorr, BestLagShorterThanFft) {
+  const std::vector<AMatrix<double>> refs{
+      AMatrix<double>{std::valarray<double>{0.0, 0.0, 0.0, 1.0, 0.0}},
+      AMatrix<double>{std::valarray<double>{0.0, 1.0, 0.0, 0.0, 0.0}}};
+  const std::vector<AMatrix<double>> degs{
+      AMatrix<double>{std::valarray<double>{0.0, 1.0, 0.0, 0.0, 0.0}},
+      AMatrix<double>{std::valarray<double>{0.0, 0.0, 0.0, 1.0, 0.0}}};
+  ASSERT_EQ(kBestLagPositive2, XCorr::CalcBestLag(refs[0], degs[0]));
+  ASSERT_EQ(kBestLagNegative2, XCorr::CalcBestLag(refs[1], degs[1]));
+  ASSERT_EQ(std::vector<int64_t>({kBestLagPositive2, kBestLagNegative2}),
+            XCorr::CalcBestLags(refs, degs));
+}
+
+// Test the bounded lag calculation on short signals, which are correlated
+// directly in the time domain.
+TEST(XCorr, BestLagWithinDirect) {
+  ASSERT_EQ(kBestLagPositive2,
+            XCorr::CalcBestLagWithin(kRefSignal, kDegSignalLag2, 4));
+  ASSERT_EQ(kBestLagNegative2,
+            XCorr::CalcBestLagWithin(kRefSignal, kDegSignalNegativeLag2, 4));
+  // A lag range that excludes the best lag overall.
+  ASSERT_EQ(1, XCorr::CalcBestLagWithin(kRefSignal, kDegSignalLag2, 1));
+}
+
+// Test the bounded lag calculation on long signals with a wide lag range,
+// which are correlated by overlap-save FFT.
+TEST(XCorr, BestLagWithinOverlapSave) {
+  const int64_t kLag = -1234;
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> ref(20000);
+  for (auto &sample : ref) {
+    sample = dist(gen);
+  }
+  std::vector<double> deg(ref.size(), 0.0);
+  for (size_t i = 0; i < deg.size(); i++) {
+    const int64_t n = i + kLag;
+    deg[i] = n >= 0 ? ref[n] : 0.0;
+  }
+  ASSERT_EQ(kLag, XCorr::CalcBestLagInRange(ref, deg, -2000, 2000));
+  ASSERT_EQ(kLag, XCorr::CalcBestLagWithin(AMatrix<double>(ref),
+                                           AMatrix<double>(deg), 2000));
+}
+
 }  // namespace
 }  // namespace Visqol